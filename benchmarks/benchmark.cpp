@@ -0,0 +1,673 @@
+// Timings of the MeshProcessing kernels and the mesh readers and writers on
+// the meshes of data/ and on synthetic height field grids of growing size.
+//
+//   mesh_benchmark [--filter TEXT] [--min-time SECONDS] [--max-faces N]
+//                  [--data DIR] [--no-synthetic] [--save-baseline FILE]
+//                  [--baseline FILE] [--tolerance FRACTION] [--counters]
+//                  [mesh...]
+//
+// Every benchmark runs until min-time has passed, but at least once, on a
+// fresh copy of the mesh; the table lists the median time of one call.
+// GB/s is the bytes one pass over the data involved moves at least (the
+// connectivity, the positions and the attributes written, see traffic())
+// divided by that time, a lower bound of the actual memory traffic that is
+// meant for comparing builds. For the memory-bound kernels, calc_weights and
+// uniform_smooth, %triad relates it to the bandwidth a STREAM triad reaches
+// on this machine, measured at start, which is their roofline bound; as the
+// traffic is a lower bound so is the fraction, near 100% the kernel is at
+// the hardware limit. Peak MB is the resident memory the calls added.
+//
+// --save-baseline FILE stores the median time, its spread (the median
+// absolute deviation), the peak memory and the GB/s of every benchmark as
+// JSON. --baseline FILE compares the run with such a file and exits with 1
+// if a benchmark got slower than
+//   baseline * (1 + tolerance) + 3 * (spread of the baseline + of the run)
+// or its peak memory grew by more than the tolerance and 1 MB; the
+// tolerance is 10% by default. Both run every benchmark at least 5 times.
+//
+// --counters adds the hardware counters of the calls where perf_event can
+// count (Linux with a PMU, see surface_mesh::Perf_counters): instructions
+// per cycle and the last level cache, data TLB and branch misses per
+// vertex and call, which show what a vertex reordering or the SoA kernels
+// did to the memory accesses.
+// Configure with -DGP_BUILD_BENCHMARKS=ON -DCMAKE_BUILD_TYPE=Release and run
+// from the build directory, where data/ is copied to.
+
+#include <surface_mesh/IO.h>
+#include <surface_mesh/Perf_counters.h>
+#include <surface_mesh/Surface_mesh.h>
+#include "draw_order.h"
+#include "frozen_mesh.h"
+#include "geometry_kernels.h"
+#include "mesh_hash.h"
+#include "mesh_processing.h"
+#include "resident_memory.h"
+#include "streaming_mesh.h"
+#include "vertex_packing.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using surface_mesh::Perf_counters;
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+using mesh_processing::MeshProcessing;
+using mesh_processing::StreamingMesh;
+using std::string;
+
+namespace {
+
+struct Options {
+    string filter;
+    double min_time = 0.5;
+    size_t max_faces = 2100000;
+    string data_dir = "data";
+    bool synthetic = true;
+    std::vector<string> meshes;
+    string save_baseline;
+    string baseline;
+    double tolerance = 0.1;
+    bool counters = false;
+};
+
+Options options;
+
+// what --save-baseline stores of one benchmark
+struct Record {
+    string name;
+    double seconds = 0.0;
+    // median absolute deviation of the calls
+    double spread = 0.0;
+    size_t calls = 0;
+    // peak resident bytes the calls added, negative if unknown
+    double peak = -1.0;
+    double gbs = 0.0;
+    // per call, with --counters
+    Perf_counters::Sample counters;
+};
+
+std::vector<Record> records;
+// GB/s of the STREAM triad, see measure_triad()
+double triad_gbs = 0.0;
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds_since(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// minimum bytes touched by one pass over the connectivity and positions of
+// mesh plus bytes_per_vertex/edge written per element
+double traffic(const Mesh& mesh, const double bytes_per_vertex, const double bytes_per_edge) {
+    return mesh.n_vertices() * (sizeof(Mesh::Vertex_connectivity) + sizeof(Point) + bytes_per_vertex)
+         + mesh.n_halfedges() * double(sizeof(Mesh::Halfedge_connectivity))
+         + mesh.n_faces() * double(sizeof(Mesh::Face_connectivity))
+         + mesh.n_edges() * bytes_per_edge;
+}
+
+// a[i] = b[i] + s c[i] on all threads over arrays well beyond the caches,
+// best of 5; 24 bytes per element as STREAM counts them
+double measure_triad() {
+    const long n = 1L << 23;
+    std::unique_ptr<double[]> a(new double[n]), b(new double[n]), c(new double[n]);
+    // the pages are first touched by the threads that stream them later
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; ++i) a[i] = 0.0, b[i] = 1.0, c[i] = 2.0;
+    double best = 0.0;
+    for (int repetition = 0; repetition < 5; ++repetition) {
+        const Clock::time_point start = Clock::now();
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < n; ++i) a[i] = b[i] + 3.0 * c[i];
+        best = std::max(best, 24.0 * n / seconds_since(start) * 1e-9);
+    }
+    // keeps the loop from being dropped
+    if (a[n / 2] != 7.0) fprintf(stderr, "triad went wrong\n");
+    return best;
+}
+
+// the kernels %triad is printed for
+bool memory_bound(const string& name) {
+    auto ends_with = [&](const string& suffix) {
+        return name.size() >= suffix.size() &&
+               name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    return ends_with("/calc_weights") || ends_with("/uniform_smooth/10");
+}
+
+void format_time(const double t, char* text, const size_t size) {
+    if (t < 1e-3) snprintf(text, size, "%.1f us", t * 1e6);
+    else if (t < 1.0) snprintf(text, size, "%.2f ms", t * 1e3);
+    else snprintf(text, size, "%.3f s", t);
+}
+
+void print_header() {
+    printf("SIMD kernels: %s\n",
+           mesh_processing::simd_level_name(mesh_processing::geometry_kernels().level));
+    printf("STREAM triad: %.1f GB/s\n", triad_gbs);
+    if (options.counters) {
+        printf("%-52s %14s %10s %12s %9s %9s %7s %6s %9s %9s %9s\n", "Benchmark", "Time",
+               "Iterations", "ns/vertex", "GB/s", "Peak MB", "%triad", "IPC", "LLC/vtx",
+               "dTLB/vtx", "br/vtx");
+        printf("%s\n", string(159, '-').c_str());
+        return;
+    }
+    printf("%-52s %14s %10s %12s %9s %9s %7s\n", "Benchmark", "Time", "Iterations", "ns/vertex",
+           "GB/s", "Peak MB", "%triad");
+    printf("%s\n", string(119, '-').c_str());
+}
+
+// misses of counter c per vertex and call, "-" where it is not counted
+void format_misses(const Record& record, const Perf_counters::Counter c, const size_t n_vertices,
+                   char* text, const size_t size) {
+    if (!Perf_counters::available(c)) snprintf(text, size, "-");
+    else snprintf(text, size, "%.3f", record.counters.value[c] / std::max<size_t>(n_vertices, 1));
+}
+
+// times body until options.min_time has passed, setup runs untimed before
+// every call
+void run(const string& name, const size_t n_vertices, const double bytes,
+         const std::function<void()>& setup, const std::function<void()>& body) {
+    if (!options.filter.empty() && name.find(options.filter) == string::npos) return;
+
+    // a spread needs a few calls
+    const size_t min_calls = options.baseline.empty() && options.save_baseline.empty() ? 1 : 5;
+    const bool tracked = mesh_processing::reset_peak_resident_memory();
+    const size_t before = mesh_processing::resident_memory();
+    std::vector<double> times;
+    double total = 0.0;
+    Record record;
+    do {
+        if (setup) setup();
+        const Perf_counters::Sample counters = Perf_counters::read();
+        const Clock::time_point start = Clock::now();
+        body();
+        times.push_back(seconds_since(start));
+        record.counters += Perf_counters::read() - counters;
+        total += times.back();
+    } while (total < options.min_time || times.size() < min_calls);
+
+    record.name = name;
+    record.calls = times.size();
+    for (double& count : record.counters.value) count /= record.calls;
+    if (tracked && before > 0) {
+        record.peak = std::max(0.0, double(mesh_processing::peak_resident_memory()) - double(before));
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    const double t = record.seconds = times[times.size() / 2];
+    for (double& time : times) time = std::abs(time - t);
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    record.spread = times[times.size() / 2];
+    record.gbs = bytes / t * 1e-9;
+    records.push_back(record);
+
+    char time[32], peak[16] = "-", triad[16] = "";
+    format_time(t, time, sizeof(time));
+    if (record.peak >= 0.0) snprintf(peak, sizeof(peak), "%.1f", record.peak / (1 << 20));
+    if (memory_bound(name) && triad_gbs > 0.0) {
+        snprintf(triad, sizeof(triad), "%.0f%%", 100.0 * record.gbs / triad_gbs);
+    }
+    printf("%-52s %14s %10zu %12.1f %9.2f %9s %7s", name.c_str(), time, record.calls,
+           t * 1e9 / std::max<size_t>(n_vertices, 1), record.gbs, peak, triad);
+    if (options.counters) {
+        char ipc[16] = "-", cache[16], tlb[16], branch[16];
+        if (Perf_counters::available(Perf_counters::CYCLES) &&
+            Perf_counters::available(Perf_counters::INSTRUCTIONS)) {
+            snprintf(ipc, sizeof(ipc), "%.2f", record.counters.ipc());
+        }
+        format_misses(record, Perf_counters::CACHE_MISSES, n_vertices, cache, sizeof(cache));
+        format_misses(record, Perf_counters::TLB_MISSES, n_vertices, tlb, sizeof(tlb));
+        format_misses(record, Perf_counters::BRANCH_MISSES, n_vertices, branch, sizeof(branch));
+        printf(" %6s %9s %9s %9s", ipc, cache, tlb, branch);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// n x n grid over the unit square with a bump, 2 (n-1)^2 triangles
+void make_grid(const int n, Mesh& mesh) {
+    mesh.clear();
+    mesh.reserve(n * n, 3 * (n - 1) * (n - 1) + 2 * (n - 1), 2 * (n - 1) * (n - 1));
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i) {
+            const Scalar x = Scalar(i) / (n - 1), y = Scalar(j) / (n - 1);
+            mesh.add_vertex(Point(x, y, 0.1f * std::sin(6.0f * x) * std::sin(6.0f * y)));
+        }
+    }
+    std::vector<unsigned int> indices;
+    indices.reserve(6 * (n - 1) * (n - 1));
+    for (int j = 0; j + 1 < n; ++j) {
+        for (int i = 0; i + 1 < n; ++i) {
+            const unsigned int v = j * n + i;
+            const unsigned int quad[6] = { v, v + 1, v + n + 1, v, v + n + 1, v + n };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    mesh.add_faces(indices, std::vector<unsigned int>(indices.size() / 3, 3));
+}
+
+long file_size(const string& filename) {
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+void run_reader(const string& label, const string& filename, const size_t n_vertices) {
+    Mesh mesh;
+    run(label + "/read", n_vertices, file_size(filename), nullptr, [&]() {
+        if (!mesh.read(filename)) {
+            fprintf(stderr, "cannot read %s\n", filename.c_str());
+            exit(-1);
+        }
+    });
+}
+
+// the text and binary OFF writers, GB/s counts the bytes written
+void run_writers(const string& label, const Mesh& mesh) {
+    const string filename = "mesh_benchmark_write.off";
+    auto write = [&](const bool binary) {
+        const bool ok = binary ? surface_mesh::write_off_binary(mesh, filename)
+                               : surface_mesh::write_off(mesh, filename);
+        if (!ok) {
+            fprintf(stderr, "cannot write %s\n", filename.c_str());
+            exit(-1);
+        }
+    };
+    write(false);
+    run(label + "/write", mesh.n_vertices(), file_size(filename), nullptr, [&]() { write(false); });
+    write(true);
+    run(label + "/write/binary", mesh.n_vertices(), file_size(filename), nullptr, [&]() { write(true); });
+    remove(filename.c_str());
+}
+
+// all kernels on mesh, each one starts from a fresh MeshProcessing
+void run_kernels(const string& label, const Mesh& mesh) {
+    const size_t n = mesh.n_vertices();
+    const double scalar = sizeof(Scalar), point = sizeof(Point);
+    MeshProcessing processing(mesh);
+    auto fresh = [&]() { processing.set_mesh(mesh); };
+
+    // the workspace is kept across runs, as a caller that computes the
+    // weights repeatedly would
+    MeshProcessing::CotanWeights weights;
+    run(label + "/calc_weights", n, traffic(mesh, scalar, scalar), fresh,
+        [&]() { processing.calc_weights(weights); });
+    run(label + "/calc_uniform_mean_curvature", n, traffic(mesh, scalar, 0), fresh,
+        [&]() { processing.calc_uniform_mean_curvature(); });
+    // the cotan curvatures read the weights
+    auto weighted = [&]() { fresh(); processing.calc_weights(weights); };
+    run(label + "/calc_mean_curvature", n, traffic(mesh, 2 * scalar, scalar), weighted,
+        [&]() { processing.calc_mean_curvature(weights); });
+    // and the angle defect the corner angles
+    auto angled = [&]() { weighted(); processing.calc_corner_angles(weights); };
+    run(label + "/calc_gauss_curvature", n, traffic(mesh, 2 * scalar, 0), angled,
+        [&]() { processing.calc_gauss_curvature(weights); });
+
+    const unsigned int iterations = 10;
+    run(label + "/uniform_smooth/10", n, iterations * traffic(mesh, point, 0), fresh,
+        [&]() { processing.uniform_smooth(iterations); });
+    processing.set_gauss_seidel_smoothing(true);
+    run(label + "/uniform_smooth/10/gauss-seidel", n, iterations * traffic(mesh, point, 0), fresh,
+        [&]() { processing.uniform_smooth(iterations); });
+    processing.set_gauss_seidel_smoothing(false);
+    // the equivalent of 500 iterations, the traffic is that of the 70 fine
+    // iterations it costs about
+    run(label + "/uniform_smooth/500/multiresolution", n, 70 * traffic(mesh, point, 0), fresh,
+        [&]() { processing.multiresolution_smooth(500); });
+    run(label + "/taubin_smooth/10", n, 2 * iterations * traffic(mesh, point, 0), fresh,
+        [&]() { processing.taubin_smooth(iterations); });
+    run(label + "/smooth/10", n, iterations * traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.smooth(iterations); });
+    // every neighbor of the one-rings next to the weight of its edge
+    processing.set_interleaved_one_rings(true);
+    run(label + "/smooth/10/interleaved", n, iterations * traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.smooth(iterations); });
+    processing.set_interleaved_one_rings(false);
+    run(label + "/smooth/10/features", n, iterations * traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.feature_preserving_smooth(iterations); });
+    run(label + "/uniform_enhance/10", n, iterations * traffic(mesh, point, 0), fresh,
+        [&]() { processing.uniform_laplacian_enhance_feature(iterations, 2.0f); });
+    run(label + "/laplace_beltrami_enhance/10", n, iterations * traffic(mesh, point + scalar, scalar),
+        fresh, [&]() { processing.laplace_beltrami_enhance_feature(iterations, 2.0f); });
+    // the same iterations out of core, clusters of 64k vertices
+    const string stream_file = "mesh_benchmark.stream";
+    StreamingMesh stream;
+    auto converted = [&]() {
+        stream.close();
+        StreamingMesh::write(mesh, stream_file);
+        stream.open(stream_file);
+    };
+    run(label + "/smooth/10/streaming", n, iterations * traffic(mesh, point + scalar, scalar),
+        converted, [&]() { stream.smooth(iterations, true); });
+    stream.close();
+    remove(stream_file.c_str());
+    remove((stream_file + ".xyz").c_str());
+    run(label + "/implicit_smoothing", n, traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.implicit_smoothing(1e-5); });
+    processing.set_solver(MeshProcessing::DIRECT_LDLT_FLOAT);
+    run(label + "/implicit_smoothing/ldlt-float", n, traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.implicit_smoothing(1e-5); });
+    processing.set_solver(MeshProcessing::CG_MULTIGRID);
+    run(label + "/implicit_smoothing/multigrid", n, traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.implicit_smoothing(1e-5); });
+    processing.set_solver(MeshProcessing::CG_SCHWARZ);
+    run(label + "/implicit_smoothing/schwarz", n, traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.implicit_smoothing(1e-5); });
+    processing.set_solver(MeshProcessing::CG_JACOBI);
+    run(label + "/implicit_smoothing/cg", n, traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.implicit_smoothing(1e-5); });
+    processing.set_solver(MeshProcessing::CG_MATRIX_FREE);
+    run(label + "/implicit_smoothing/matrix-free", n, traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.implicit_smoothing(1e-5); });
+    processing.set_interleaved_one_rings(true);
+    run(label + "/implicit_smoothing/matrix-free/interleaved", n,
+        traffic(mesh, point + scalar, scalar), fresh, [&]() { processing.implicit_smoothing(1e-5); });
+    processing.set_interleaved_one_rings(false);
+    processing.set_solver(MeshProcessing::DIRECT_LDLT);
+    run(label + "/minimal_surface", n, traffic(mesh, point + scalar, scalar), fresh,
+        [&]() { processing.minimal_surface(); });
+    // queries from new sources with the factors of the first one
+    {
+        std::vector<float> distances;
+        int source = 0;
+        processing.set_mesh(mesh);
+        processing.geodesic_distances(std::vector<Mesh::Vertex>(1, Mesh::Vertex(0)), distances);
+        run(label + "/geodesic_distances", n, traffic(mesh, point, scalar), nullptr, [&]() {
+            const Mesh::Vertex v((source++ * 7919) % int(mesh.n_vertices()));
+            processing.geodesic_distances(std::vector<Mesh::Vertex>(1, v), distances);
+        });
+    }
+    // the viewer's level of detail hierarchy, once per connectivity
+    run(label + "/lod_build", n, traffic(mesh, 0, 0), nullptr, [&]() {
+        mesh_processing::LodHierarchy lod;
+        lod.build(mesh);
+    });
+    // the identity of the connectivity and the positions, one pass over them
+    {
+        mesh_processing::MeshHash hash;
+        run(label + "/mesh_hash", n, traffic(mesh, 0, 0), nullptr,
+            [&]() { hash = mesh_processing::mesh_hash(mesh); });
+    }
+    // the read-only copy and a query over it
+    {
+        mesh_processing::FrozenMesh frozen;
+        run(label + "/freeze", n, traffic(mesh, point, 0), nullptr, [&]() { frozen.freeze(mesh); });
+        frozen.freeze(mesh);
+        std::vector<Point> normals;
+        run(label + "/frozen/vertex_normals", n, traffic(mesh, 2 * point, 0), nullptr,
+            [&]() { frozen.vertex_normals(normals); });
+    }
+    // the viewer's index buffer, reordered once per connectivity
+    {
+        std::vector<uint32_t> faces, indices;
+        for (auto f : mesh.faces()) {
+            for (auto v : mesh.vertices(f)) faces.push_back(v.idx());
+        }
+        const int n_triangles = int(faces.size() / 3);
+        run(label + "/draw_order", n, traffic(mesh, 0, 0), [&]() { indices = faces; }, [&]() {
+            mesh_processing::optimize_draw_order(processing.get_points(), indices.data(), n_triangles);
+        });
+    }
+    // the viewer's vertex buffers: read positions, normals and a scalar,
+    // write the packed attributes
+    {
+        mesh_processing::PackedPositions positions;
+        mesh_processing::PackedNormals normals;
+        mesh_processing::PackedScalars scalars;
+        Eigen::Vector3f box_min, box_extent;
+        float lo = 0.0f, hi = 0.0f;
+        const double bytes = n * (2.0 * point + scalar + 11.0);
+        // the attributes themselves are computed beforehand
+        processing.get_normals();
+        processing.get_scalars(MeshProcessing::SCALAR_UNICURVATURE, lo, hi);
+        run(label + "/pack_attributes", n, bytes, nullptr, [&]() {
+            mesh_processing::pack_positions(processing.get_points(), positions, box_min, box_extent);
+            mesh_processing::pack_normals(processing.get_normals(), normals);
+            mesh_processing::pack_scalars(processing.get_scalars(MeshProcessing::SCALAR_UNICURVATURE, lo, hi),
+                                          lo, hi, scalars);
+        });
+    }
+    // what the viewer does after every operation: record the step and
+    // refresh the displayed attributes
+    run(label + "/compute_mesh_properties", n, traffic(mesh, 5 * scalar + 2 * point, scalar), fresh,
+        [&]() {
+            processing.compute_mesh_properties();
+            processing.get_normals();
+            processing.get_color_curvature();
+        });
+}
+
+void run_file(const string& filename) {
+    const size_t slash = filename.find_last_of("/\\");
+    const string label = slash == string::npos ? filename : filename.substr(slash + 1);
+    Mesh mesh;
+    if (!mesh.read(filename)) {
+        fprintf(stderr, "cannot read %s\n", filename.c_str());
+        exit(-1);
+    }
+    run_reader(label, filename, mesh.n_vertices());
+    run_writers(label, mesh);
+    run_kernels(label, mesh);
+}
+
+void run_synthetic() {
+    const string filename = "mesh_benchmark_grid.off";
+    for (int n = 129; size_t(2) * (n - 1) * (n - 1) <= options.max_faces; n = 2 * n - 1) {
+        Mesh mesh;
+        make_grid(n, mesh);
+        char label[32];
+        snprintf(label, sizeof(label), "grid_%uf", mesh.n_faces());
+        mesh.write(filename);
+        run_reader(label, filename, mesh.n_vertices());
+        remove(filename.c_str());
+        run_writers(label, mesh);
+        run_kernels(label, mesh);
+    }
+}
+
+// the part of JSON the baselines use: objects, strings and numbers, arrays
+// and literals are skipped
+struct Json {
+    double number = 0.0;
+    string text;
+    std::map<string, Json> members;
+
+    double get(const string& key, const double fallback) const {
+        auto member = members.find(key);
+        return member == members.end() ? fallback : member->second.number;
+    }
+};
+
+void skip_space(const char*& p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') ++p;
+}
+
+bool parse_string(const char*& p, string& text) {
+    if (*p++ != '"') return false;
+    for (; *p && *p != '"'; ++p) {
+        if (*p == '\\' && p[1]) ++p;
+        text += *p;
+    }
+    return *p++ == '"';
+}
+
+bool parse_json(const char*& p, Json& value) {
+    skip_space(p);
+    if (*p == '"') return parse_string(p, value.text);
+    if (*p == '{' || *p == '[') {
+        const bool object = *p++ == '{';
+        skip_space(p);
+        if (*p == (object ? '}' : ']')) return ++p, true;
+        for (;;) {
+            Json member;
+            if (object) {
+                string key;
+                skip_space(p);
+                if (!parse_string(p, key)) return false;
+                skip_space(p);
+                if (*p++ != ':' || !parse_json(p, value.members[key])) return false;
+            } else if (!parse_json(p, member)) {
+                return false;
+            }
+            skip_space(p);
+            if (*p == ',') ++p;
+            else return *p++ == (object ? '}' : ']');
+        }
+    }
+    char* end = nullptr;
+    value.number = strtod(p, &end);
+    if (end != p) return p = end, true;
+    // true, false and null
+    while (*p >= 'a' && *p <= 'z') ++p;
+    return true;
+}
+
+string json_escaped(const string& text) {
+    string escaped;
+    for (const char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+bool save_baseline(const string& filename) {
+    FILE* f = fopen(filename.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "{\n  \"simd\": \"%s\",\n  \"triad_gbs\": %.6g,\n  \"benchmarks\": {\n",
+            mesh_processing::simd_level_name(mesh_processing::geometry_kernels().level), triad_gbs);
+    for (size_t i = 0; i < records.size(); ++i) {
+        const Record& r = records[i];
+        fprintf(f, "    \"%s\": { \"seconds\": %.6g, \"spread\": %.6g, \"calls\": %zu, "
+                   "\"peak_mb\": %.6g, \"gbs\": %.6g",
+                json_escaped(r.name).c_str(), r.seconds, r.spread, r.calls,
+                r.peak >= 0.0 ? r.peak / (1 << 20) : -1.0, r.gbs);
+        // per call, for reading along; the gate does not compare them
+        for (int c = 0; c < Perf_counters::N_COUNTERS; ++c) {
+            if (!Perf_counters::available(Perf_counters::Counter(c))) continue;
+            fprintf(f, ", \"%s\": %.6g", Perf_counters::name(Perf_counters::Counter(c)),
+                    r.counters.value[c]);
+        }
+        fprintf(f, " }%s\n", i + 1 < records.size() ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+    return fclose(f) == 0;
+}
+
+// the benchmarks that regressed against the baseline in filename, -1 if it
+// cannot be read
+int compare_baseline(const string& filename) {
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f) return -1;
+    string contents;
+    char buffer[4096];
+    for (size_t read; (read = fread(buffer, 1, sizeof(buffer), f)) > 0;) contents.append(buffer, read);
+    fclose(f);
+    Json root;
+    const char* p = contents.c_str();
+    if (!parse_json(p, root) || !root.members.count("benchmarks")) return -1;
+    const Json& baseline = root.members["benchmarks"];
+
+    printf("\nCompared with %s, tolerance %.0f%%\n", filename.c_str(), 100.0 * options.tolerance);
+    const double baseline_triad = root.get("triad_gbs", 0.0);
+    if (baseline_triad > 0.0 && std::abs(triad_gbs / baseline_triad - 1.0) > 0.2) {
+        printf("warning: the baseline saw a STREAM triad of %.1f GB/s, likely another machine\n",
+               baseline_triad);
+    }
+    int regressions = 0, compared = 0, missing = 0;
+    for (const Record& r : records) {
+        auto entry = baseline.members.find(r.name);
+        if (entry == baseline.members.end()) {
+            ++missing;
+            continue;
+        }
+        ++compared;
+        const Json& b = entry->second;
+        const double seconds = b.get("seconds", 0.0);
+        const double limit = seconds * (1.0 + options.tolerance) +
+                             3.0 * (b.get("spread", 0.0) + r.spread);
+        if (r.seconds > limit) {
+            char before[32], after[32], allowed[32];
+            format_time(seconds, before, sizeof(before));
+            format_time(r.seconds, after, sizeof(after));
+            format_time(limit, allowed, sizeof(allowed));
+            printf("REGRESSION %s: %s -> %s (%+.0f%%, limit %s)\n", r.name.c_str(), before, after,
+                   100.0 * (r.seconds / seconds - 1.0), allowed);
+            ++regressions;
+        }
+        const double peak = b.get("peak_mb", -1.0), now = r.peak / (1 << 20);
+        if (peak >= 0.0 && r.peak >= 0.0 && now > peak * (1.0 + options.tolerance) + 1.0) {
+            printf("REGRESSION %s: peak memory %.1f MB -> %.1f MB\n", r.name.c_str(), peak, now);
+            ++regressions;
+        }
+    }
+    printf("%d benchmarks compared, %d regressions, %d not in the baseline\n", compared,
+           regressions, missing);
+    return regressions;
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--filter TEXT] [--min-time SECONDS] [--max-faces N]\n"
+            "       [--data DIR] [--no-synthetic] [--save-baseline FILE]\n"
+            "       [--baseline FILE] [--tolerance FRACTION] [--counters] [mesh...]\n"
+            "without meshes the ones of the data directory are used\n", program);
+    exit(-1);
+}
+
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--filter" && has_value) options.filter = argv[++i];
+        else if (arg == "--min-time" && has_value) options.min_time = atof(argv[++i]);
+        else if (arg == "--max-faces" && has_value) options.max_faces = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--data" && has_value) options.data_dir = argv[++i];
+        else if (arg == "--no-synthetic") options.synthetic = false;
+        else if (arg == "--save-baseline" && has_value) options.save_baseline = argv[++i];
+        else if (arg == "--baseline" && has_value) options.baseline = argv[++i];
+        else if (arg == "--tolerance" && has_value) options.tolerance = atof(argv[++i]);
+        else if (arg == "--counters") options.counters = true;
+        else if (!arg.empty() && arg[0] == '-') usage(argv[0]);
+        else options.meshes.push_back(arg);
+    }
+    if (options.meshes.empty()) {
+        const char* shipped[] = { "bunny.off", "max.off", "cylinder_soap_bubble.obj" };
+        for (const char* name : shipped) options.meshes.push_back(options.data_dir + "/" + name);
+    }
+
+    if (options.counters && !Perf_counters::open()) {
+        fprintf(stderr, "hardware counters unavailable, perf_event cannot count here\n");
+        options.counters = false;
+    }
+    triad_gbs = measure_triad();
+    print_header();
+    for (const string& filename : options.meshes) run_file(filename);
+    if (options.synthetic) run_synthetic();
+
+    if (!options.save_baseline.empty() && !save_baseline(options.save_baseline)) {
+        fprintf(stderr, "cannot write %s\n", options.save_baseline.c_str());
+        return -1;
+    }
+    if (!options.baseline.empty()) {
+        const int regressions = compare_baseline(options.baseline);
+        if (regressions < 0) {
+            fprintf(stderr, "cannot read %s\n", options.baseline.c_str());
+            return -1;
+        }
+        if (regressions > 0) return 1;
+    }
+    return 0;
+}
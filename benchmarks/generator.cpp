@@ -0,0 +1,87 @@
+// Writes the synthetic meshes of the scaling runs, see synthetic_mesh.h.
+//
+//   mesh_generator sphere|torus|plane FACES OUTPUT [--noise A] [--seed S]
+//
+// FACES may end in k or M. An .off OUTPUT is streamed as OFF BINARY without
+// building the mesh, which stays within a few hundred MB at 100M faces;
+// other formats go through surface_mesh::Surface_mesh::write(). The noise
+// is relative to the edge length, 0.25 for the plane and 0 otherwise by
+// default.
+
+#include "synthetic_mesh.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using mesh_processing::SyntheticMesh;
+using std::string;
+
+namespace {
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s sphere|torus|plane FACES OUTPUT [--noise A] [--seed S]\n"
+            "FACES may end in k or M, .off outputs are streamed as OFF BINARY\n", program);
+    exit(-1);
+}
+
+// 250k, 1.5M or a plain count, 0 on error
+unsigned long long parse_faces(const string& text) {
+    char* end = nullptr;
+    const double value = strtod(text.c_str(), &end);
+    double scale = 1.0;
+    if (*end == 'k' || *end == 'K') scale = 1e3, ++end;
+    else if (*end == 'm' || *end == 'M') scale = 1e6, ++end;
+    if (end == text.c_str() || *end != '\0' || !(value > 0.0)) return 0;
+    return (unsigned long long) (value * scale + 0.5);
+}
+
+bool has_extension(const string& filename, const string& extension) {
+    return filename.size() >= extension.size() &&
+           filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) usage(argv[0]);
+    SyntheticMesh::SHAPE shape;
+    if (!SyntheticMesh::parse_shape(argv[1], shape)) usage(argv[0]);
+    const unsigned long long faces = parse_faces(argv[2]);
+    if (faces == 0) usage(argv[0]);
+    const string output = argv[3];
+    float noise = shape == SyntheticMesh::PLANE ? 0.25f : 0.0f;
+    unsigned long seed = 1;
+    for (int i = 4; i < argc; ++i) {
+        const string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--noise" && has_value) noise = float(atof(argv[++i]));
+        else if (arg == "--seed" && has_value) seed = strtoul(argv[++i], nullptr, 10);
+        else usage(argv[0]);
+    }
+
+    const SyntheticMesh generator(shape, faces, noise, uint32_t(seed));
+    if (generator.n_vertices() > 0xffffffffull) {
+        fprintf(stderr, "%llu faces exceed the 32-bit vertex indices\n", faces);
+        return -1;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    bool ok;
+    if (has_extension(output, ".off")) {
+        ok = generator.write_off_binary(output);
+    } else {
+        surface_mesh::Surface_mesh mesh;
+        generator.build(mesh);
+        ok = mesh.write(output);
+    }
+    if (!ok) {
+        fprintf(stderr, "cannot write %s\n", output.c_str());
+        return -1;
+    }
+    printf("%s: %s with %llu vertices and %llu faces in %.2f s\n", output.c_str(),
+           SyntheticMesh::shape_name(shape), (unsigned long long) generator.n_vertices(),
+           (unsigned long long) generator.n_faces(),
+           std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return 0;
+}
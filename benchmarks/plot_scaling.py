@@ -0,0 +1,75 @@
+"""Plots the rows of mesh_scaling --csv FILE, needs matplotlib.
+
+    python plot_scaling.py scaling.csv [output prefix]
+
+Writes <prefix><shape>.png per shape: the time and the memory of every
+operation over the face count on log-log axes, one line per operation and
+thread count. The super-linear steps mesh_scaling flagged are circled, a
+dotted line of slope 1 through the smallest size marks linear scaling.
+"""
+
+import csv
+import sys
+from collections import defaultdict
+
+import matplotlib
+
+matplotlib.use("Agg")
+import matplotlib.pyplot as plt
+
+CLIFF = 1.25
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    prefix = sys.argv[2] if len(sys.argv) > 2 else "scaling_"
+
+    # shape -> (operation, threads) -> rows by size
+    series = defaultdict(lambda: defaultdict(list))
+    with open(sys.argv[1], newline="") as f:
+        for row in csv.DictReader(f):
+            series[row["shape"]][(row["operation"], int(row["threads"]))].append(row)
+
+    for shape, lines in sorted(series.items()):
+        fig, (time_axis, memory_axis) = plt.subplots(1, 2, figsize=(16, 7))
+        for (operation, threads), rows in sorted(lines.items()):
+            rows.sort(key=lambda r: int(r["faces"]))
+            faces = [int(r["faces"]) for r in rows]
+            seconds = [float(r["seconds"]) for r in rows]
+            # the peak where the platform reports one, else the retained memory
+            memory = [float(r["peak_mb"]) if float(r["peak_mb"]) >= 0 else float(r["memory_mb"])
+                      for r in rows]
+            style = "-" if threads == 1 else "--"
+            label = "%s, %d thread%s" % (operation, threads, "" if threads == 1 else "s")
+            line, = time_axis.plot(faces, seconds, style, marker=".", label=label)
+            memory_axis.plot(faces, memory, style, marker=".", color=line.get_color())
+            for r, x, t, m in zip(rows, faces, seconds, memory):
+                if float(r["time_exponent"]) > CLIFF:
+                    time_axis.plot(x, t, "o", mfc="none", ms=12, color=line.get_color())
+                if float(r["memory_exponent"]) > CLIFF:
+                    memory_axis.plot(x, m, "o", mfc="none", ms=12, color=line.get_color())
+            if faces and seconds[0] > 0:
+                time_axis.plot([faces[0], faces[-1]],
+                               [seconds[0], seconds[0] * faces[-1] / faces[0]],
+                               ":", color="gray", lw=0.5)
+
+        for axis, title, unit in ((time_axis, "time", "seconds"),
+                                  (memory_axis, "memory", "MB")):
+            axis.set_xscale("log")
+            axis.set_yscale("log")
+            axis.set_xlabel("faces")
+            axis.set_ylabel(unit)
+            axis.set_title("%s: %s" % (shape, title))
+            axis.grid(True, which="both", lw=0.3)
+        time_axis.legend(fontsize=6, loc="upper left")
+        fig.tight_layout()
+        fig.savefig(prefix + shape + ".png", dpi=120)
+        plt.close(fig)
+        print("wrote %s%s.png" % (prefix, shape))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
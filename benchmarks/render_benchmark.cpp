@@ -0,0 +1,512 @@
+// GPU cost of the viewer's mesh passes, drawn offscreen with the shaders of
+// mesh_shaders.h into a framebuffer of the viewer's format, on the meshes
+// of data/ and on the synthetic meshes of synthetic_mesh.h.
+//
+//   render_benchmark [--data DIR] [--shapes sphere,torus,plane]
+//                    [--sizes 100k,1M] [--resolution WxH] [--views N]
+//                    [--frames N] [--filter TEXT] [--csv FILE] [mesh...]
+//
+// Every pass is drawn from views evenly spaced on two orbits around the
+// mesh: "far" sees all of it as the viewer centers it, "near" zooms in 4x,
+// so that frustum culling and the LOD hierarchy skip most of the mesh.
+// Every view is drawn frames times after one untimed frame per pass. GPU ms
+// is the median GL_TIME_ELAPSED of a frame, CPU ms the median time the
+// frame took to submit, the cluster selection included, without waiting
+// for the GPU. Triangles is the mean count a frame drew, Mtri/s that count
+// over the GPU time; ACMR the vertex shader invocations per triangle of the
+// index buffer in a FIFO cache of 16, see average_cache_miss_ratio().
+//
+// The passes, one per candidate of the viewer's render path:
+//   shaded      packed attributes, the triangles of get_indices() in the
+//               order of optimize_draw_order(), one call for all of them;
+//               the viewer while a job runs
+//   face-order  the same in the order of the faces, what the vertex cache
+//               and overdraw optimization saves
+//   float       float attributes as the GPU smoothing uploads them, what
+//               the packing of vertex_packing.h saves
+//   culled      the runs of DrawClusters in the view frustum, the viewer's
+//               default path
+//   lod         the LodHierarchy clusters at an error of a pixel, the
+//               viewer's LOD option
+//   wireframe   culled with the wireframe of the fragment shader
+//   normals     a line along the normal of every vertex
+// Configure with -DGP_BUILD_BENCHMARKS=ON -DCMAKE_BUILD_TYPE=Release and an
+// offscreen context (GP_OFFSCREEN) and run from the build directory.
+
+#include "camera.h"
+#include "draw_order.h"
+#include "mesh_processing.h"
+#include "mesh_shaders.h"
+#include "offscreen_context.h"
+#include "synthetic_mesh.h"
+#include "vertex_packing.h"
+#include <nanogui/glutil.h>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using mesh_processing::LodHierarchy;
+using mesh_processing::MeshProcessing;
+using mesh_processing::SyntheticMesh;
+using std::string;
+
+namespace {
+
+struct Options {
+    string data_dir = "data";
+    std::vector<string> meshes;
+    std::vector<SyntheticMesh::SHAPE> shapes = { SyntheticMesh::SPHERE };
+    std::vector<unsigned long long> sizes = { 100000, 1000000 };
+    Eigen::Vector2i resolution = Eigen::Vector2i(1280, 720);
+    int views = 8;
+    int frames = 5;
+    string filter;
+    string csv;
+};
+
+Options options;
+
+typedef std::chrono::steady_clock Clock;
+
+enum PASS { SHADED, FACE_ORDER, FLOAT, CULLED, LOD, WIREFRAME, NORMALS, N_PASSES };
+const char* PASS_NAMES[N_PASSES] = { "shaded", "face-order", "float", "culled", "lod",
+                                     "wireframe", "normals" };
+
+struct Orbit {
+    const char* name;
+    float zoom;
+};
+const Orbit ORBITS[] = { { "far", 1.0f }, { "near", 4.0f } };
+
+// the shaders of all passes and the framebuffer, for the lifetime of the
+// context
+struct Renderer {
+    // the viewer's shader_ with the packed attributes and the optimized
+    // index buffer, the others share what they do not change
+    nanogui::GLShader packed;
+    nanogui::GLShader face_order;
+    nanogui::GLShader floats;
+    nanogui::GLShader lod;
+    nanogui::GLShader normals;
+    GLuint framebuffer = 0, color = 0, depth = 0;
+    bool timer = false;
+    std::vector<LodHierarchy::Range> ranges;
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+};
+
+// what the passes draw of one mesh
+struct Scene {
+    string label;
+    MeshProcessing* mesh;
+    uint32_t n_triangles = 0, n_vertices = 0;
+    Eigen::Vector3f box_min, box_extent;
+    Eigen::Vector3f center;
+    float radius = 1.0f;
+    double acmr = 0.0, face_order_acmr = 0.0;
+};
+
+std::ofstream csv;
+
+bool init(Renderer& renderer) {
+    if (!renderer.packed.init("packed", MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER,
+                              MESH_GEOMETRY_SHADER) ||
+        !renderer.face_order.init("face_order", MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER,
+                                  MESH_GEOMETRY_SHADER) ||
+        !renderer.floats.init("floats", MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER,
+                              MESH_GEOMETRY_SHADER) ||
+        !renderer.lod.init("lod", MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER, MESH_GEOMETRY_SHADER) ||
+        !renderer.normals.init("normals", NORMAL_VERTEX_SHADER, NORMAL_FRAGMENT_SHADER)) {
+        return false;
+    }
+    // the scene framebuffer of the viewer, single sampled
+    const Eigen::Vector2i& size = options.resolution;
+    glGenFramebuffers(1, &renderer.framebuffer);
+    glGenRenderbuffers(1, &renderer.color);
+    glGenRenderbuffers(1, &renderer.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderer.color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x(), size.y());
+    glBindRenderbuffer(GL_RENDERBUFFER, renderer.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.x(), size.y());
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderer.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderer.color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderer.depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return false;
+    // a driver may offer the queries without a counter behind them
+    GLint bits = 0;
+    glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &bits);
+    renderer.timer = bits > 0;
+    return true;
+}
+
+void free_gl(Renderer& renderer) {
+    if (renderer.framebuffer != 0) {
+        glDeleteFramebuffers(1, &renderer.framebuffer);
+        glDeleteRenderbuffers(1, &renderer.color);
+        glDeleteRenderbuffers(1, &renderer.depth);
+    }
+    for (nanogui::GLShader* shader : { &renderer.packed, &renderer.face_order, &renderer.floats,
+                                       &renderer.lod, &renderer.normals }) {
+        shader->free();
+    }
+}
+
+// the uniforms refresh_mesh() and drawContents() set, shading without
+// colors
+void set_uniforms(nanogui::GLShader& shader, const Scene& scene) {
+    shader.bind();
+    shader.setUniform("box_min", scene.box_min);
+    shader.setUniform("box_extent", scene.box_extent);
+    shader.setUniform("color_mode", 0, false);
+    shader.setUniform("intensity", Eigen::Vector3f(1.0f, 1.5f, 1.0f), false);
+    shader.setUniform("wire_intensity", Eigen::Vector3f(0.5f, 0.7f, 0.5f), false);
+    shader.setUniform("scalar_range", Eigen::Vector2f(0.0f, 1.0f), false);
+    shader.setUniform("scalar_decode", Eigen::Vector2f(0.0f, 1.0f), false);
+    shader.setUniform("splat", 0, false);
+}
+
+// the buffers of every pass, uploaded as the viewer does
+void upload(Renderer& renderer, Scene& scene) {
+    MeshProcessing& mesh = *scene.mesh;
+    const MatrixXu& indices = *mesh.get_indices();
+    scene.n_triangles = uint32_t(indices.cols());
+    scene.n_vertices = mesh.get_number_of_vertices();
+    mesh_processing::PackedPositions positions;
+    mesh_processing::pack_positions(mesh.get_points(), positions, scene.box_min, scene.box_extent);
+    mesh_processing::PackedNormals normals;
+    mesh_processing::pack_normals(mesh.get_normals(), normals);
+    const mesh_processing::PackedScalars scalars =
+        mesh_processing::PackedScalars::Zero(1, scene.n_vertices);
+
+    nanogui::GLShader& packed = renderer.packed;
+    packed.bind();
+    packed.uploadAttrib("indices", indices);
+    packed.uploadAttrib("position", positions);
+    packed.uploadAttrib("normal", normals);
+    packed.uploadAttrib("scalar", scalars);
+
+    // the faces as they are stored, before optimize_draw_order()
+    const surface_mesh::Surface_mesh& surface = mesh.get_mesh();
+    MatrixXu faces(3, scene.n_triangles);
+    int j = 0;
+    for (auto f : surface.faces()) {
+        int k = 0;
+        for (auto v : surface.vertices(f)) faces(k++, j) = v.idx();
+        ++j;
+    }
+    renderer.face_order.bind();
+    renderer.face_order.uploadAttrib("indices", faces);
+    for (const char* name : { "position", "normal", "scalar" }) {
+        renderer.face_order.shareAttrib(packed, name);
+    }
+    scene.acmr = mesh_processing::average_cache_miss_ratio(indices.data(), int(scene.n_triangles),
+                                                           int(scene.n_vertices));
+    scene.face_order_acmr = mesh_processing::average_cache_miss_ratio(
+        faces.data(), int(scene.n_triangles), int(scene.n_vertices));
+
+    // the same box coordinates as floats
+    renderer.floats.bind();
+    renderer.floats.shareAttrib(packed, "indices");
+    renderer.floats.uploadAttrib("position", Eigen::Matrix3Xf(positions.cast<float>() / 65535.0f));
+    renderer.floats.uploadAttrib("normal", Eigen::Matrix2Xf(normals.cast<float>() / 32767.0f));
+    renderer.floats.uploadAttrib("scalar", Eigen::RowVectorXf(Eigen::RowVectorXf::Zero(scene.n_vertices)));
+
+    const std::vector<uint32_t>& levels = mesh.get_lod().indices();
+    renderer.lod.bind();
+    renderer.lod.uploadAttrib("indices", Eigen::Map<const MatrixXu>(levels.data(), 3, levels.size() / 3));
+    for (const char* name : { "position", "normal", "scalar" }) {
+        renderer.lod.shareAttrib(packed, name);
+    }
+    mesh.get_draw_clusters();
+
+    // one instance per vertex, see Viewer::draw_normals()
+    renderer.normals.bind();
+    for (const char* name : { "position", "normal" }) {
+        renderer.normals.shareAttrib(packed, name);
+        glVertexAttribDivisor(renderer.normals.attrib(name), 1);
+    }
+
+    for (nanogui::GLShader* shader : { &renderer.packed, &renderer.face_order, &renderer.floats,
+                                       &renderer.lod, &renderer.normals }) {
+        set_uniforms(*shader, scene);
+    }
+}
+
+// the ranges of the bound index buffer in one call, as Viewer::draw_ranges();
+// returns the triangles drawn
+uint32_t draw_ranges(Renderer& renderer) {
+    const std::vector<LodHierarchy::Range>& ranges = renderer.ranges;
+    renderer.counts.resize(ranges.size());
+    renderer.offsets.resize(ranges.size());
+    uint32_t triangles = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        renderer.counts[i] = GLsizei(3 * ranges[i].count);
+        renderer.offsets[i] = (const void*) (3 * size_t(ranges[i].first) * sizeof(uint32_t));
+        triangles += ranges[i].count;
+    }
+    if (!ranges.empty()) {
+        glMultiDrawElements(GL_TRIANGLES, renderer.counts.data(), GL_UNSIGNED_INT,
+                            renderer.offsets.data(), GLsizei(ranges.size()));
+    }
+    return triangles;
+}
+
+// one frame of pass, returns the triangles drawn, or the lines of the
+// normals
+uint32_t draw(Renderer& renderer, Scene& scene, const PASS pass, const Eigen::Matrix4f& mv,
+              const Eigen::Matrix4f& p) {
+    nanogui::GLShader& shader = pass == FACE_ORDER ? renderer.face_order :
+                                pass == FLOAT ? renderer.floats :
+                                pass == LOD ? renderer.lod :
+                                pass == NORMALS ? renderer.normals : renderer.packed;
+    shader.bind();
+    shader.setUniform("MV", mv);
+    shader.setUniform("P", p);
+    if (pass == NORMALS) {
+        glDrawArraysInstanced(GL_LINES, 0, 2, GLsizei(scene.n_vertices));
+        return scene.n_vertices;
+    }
+    shader.setUniform("wireframe", int(pass == WIREFRAME));
+    if (pass == CULLED || pass == WIREFRAME) {
+        scene.mesh->get_draw_clusters().select(mv, p, renderer.ranges);
+        return draw_ranges(renderer);
+    }
+    if (pass == LOD) {
+        scene.mesh->get_lod().select(mv, p, float(options.resolution.y()), 1.0f, renderer.ranges);
+        return draw_ranges(renderer);
+    }
+    shader.drawIndexed(GL_TRIANGLES, 0, scene.n_triangles);
+    return scene.n_triangles;
+}
+
+double median(std::vector<double> values) {
+    if (values.empty()) return 0.0;
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+void run(Renderer& renderer, Scene& scene, const PASS pass, const Orbit& orbit) {
+    const string name = scene.label + "/" + PASS_NAMES[pass] + "/" + orbit.name;
+    if (!options.filter.empty() && name.find(options.filter) == string::npos) return;
+
+    const Eigen::Vector2i& size = options.resolution;
+    mesh_processing::CameraParameters camera;
+    center_camera(camera, size, scene.center, scene.radius);
+    camera.zoom = orbit.zoom;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, renderer.framebuffer);
+    glViewport(0, 0, size.x(), size.y());
+    glClearColor(0.3f, 0.3f, 0.32f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+
+    const int n = options.views * options.frames;
+    std::vector<GLuint> queries(renderer.timer ? n : 0);
+    if (!queries.empty()) glGenQueries(GLsizei(n), queries.data());
+    std::vector<double> cpu;
+    double triangles = 0.0;
+    // the first frame compiles and uploads what the driver defers
+    for (int frame = -1; frame < n; ++frame) {
+        // the views turn about the vertical axis, seen slightly from above
+        const int view_index = std::max(frame, 0) / options.frames;
+        const float angle = float(2.0 * M_PI) * view_index / options.views;
+        camera.arcball.setState(Eigen::Quaternionf(Eigen::AngleAxisf(0.35f, Eigen::Vector3f::UnitX()) *
+                                                   Eigen::AngleAxisf(angle, Eigen::Vector3f::UnitY())));
+        Eigen::Matrix4f model, view, proj;
+        camera_matrices(camera, size, model, view, proj);
+        const Eigen::Matrix4f mv = view * model;
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (frame < 0) {
+            draw(renderer, scene, pass, mv, proj);
+            glFinish();
+            continue;
+        }
+        const Clock::time_point start = Clock::now();
+        if (!queries.empty()) glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+        triangles += draw(renderer, scene, pass, mv, proj);
+        if (!queries.empty()) glEndQuery(GL_TIME_ELAPSED);
+        cpu.push_back(std::chrono::duration<double>(Clock::now() - start).count() * 1e3);
+    }
+    glFinish();
+    std::vector<double> gpu;
+    for (const GLuint query : queries) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        gpu.push_back(ns * 1e-6);
+    }
+    if (!queries.empty()) glDeleteQueries(GLsizei(n), queries.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    triangles /= n;
+    const double gpu_ms = median(gpu), cpu_ms = median(cpu);
+    const double acmr = pass == FACE_ORDER ? scene.face_order_acmr :
+                        pass == LOD || pass == NORMALS ? 0.0 : scene.acmr;
+    char gpu_text[16] = "-", rate[16] = "-", acmr_text[16] = "-";
+    if (!gpu.empty()) {
+        snprintf(gpu_text, sizeof(gpu_text), "%.3f", gpu_ms);
+        if (pass != NORMALS && gpu_ms > 0.0) snprintf(rate, sizeof(rate), "%.1f", triangles / gpu_ms * 1e-3);
+    }
+    if (acmr > 0.0) snprintf(acmr_text, sizeof(acmr_text), "%.3f", acmr);
+    printf("%-40s %10u %12.0f %10s %10.3f %9s %7s\n", name.c_str(), scene.n_triangles, triangles,
+           gpu_text, cpu_ms, rate, acmr_text);
+    fflush(stdout);
+
+    if (csv.is_open()) {
+        csv << scene.label << ',' << PASS_NAMES[pass] << ',' << orbit.name << ','
+            << scene.n_triangles << ',' << scene.n_vertices << ',' << triangles << ','
+            << (gpu.empty() ? -1.0 : gpu_ms) << ',' << cpu_ms << ',' << acmr << '\n';
+        csv.flush();
+    }
+}
+
+void run_mesh(Renderer& renderer, const string& label, MeshProcessing& mesh) {
+    Scene scene;
+    scene.label = label;
+    scene.mesh = &mesh;
+    const surface_mesh::Point center = mesh.get_mesh_center();
+    scene.center = Eigen::Vector3f(center.x, center.y, center.z);
+    scene.radius = mesh.get_dist_max();
+    if (!(scene.radius > 0.0f)) scene.radius = 1.0f;
+    upload(renderer, scene);
+    for (const Orbit& orbit : ORBITS) {
+        for (int pass = 0; pass < N_PASSES; ++pass) run(renderer, scene, PASS(pass), orbit);
+    }
+}
+
+// "10k,1.5M,300000"
+bool parse_sizes(const string& text, std::vector<unsigned long long>& sizes) {
+    sizes.clear();
+    std::istringstream list(text);
+    string item;
+    while (std::getline(list, item, ',')) {
+        char* end = nullptr;
+        const double value = strtod(item.c_str(), &end);
+        double scale = 1.0;
+        if (*end == 'k' || *end == 'K') scale = 1e3, ++end;
+        else if (*end == 'm' || *end == 'M') scale = 1e6, ++end;
+        if (end == item.c_str() || *end != '\0' || !(value > 0.0)) return false;
+        sizes.push_back((unsigned long long) (value * scale + 0.5));
+    }
+    std::sort(sizes.begin(), sizes.end());
+    return true;
+}
+
+bool parse_shapes(const string& text, std::vector<SyntheticMesh::SHAPE>& shapes) {
+    shapes.clear();
+    std::istringstream list(text);
+    string item;
+    while (std::getline(list, item, ',')) {
+        SyntheticMesh::SHAPE shape;
+        if (!SyntheticMesh::parse_shape(item, shape)) return false;
+        shapes.push_back(shape);
+    }
+    return true;
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--data DIR] [--shapes sphere,torus,plane] [--sizes 100k,1M]\n"
+            "       [--resolution WxH] [--views N] [--frames N] [--filter TEXT]\n"
+            "       [--csv FILE] [mesh...]\n"
+            "without meshes the ones of the data directory are used; an empty\n"
+            "list of sizes leaves out the synthetic meshes\n", program);
+    exit(-1);
+}
+
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--data" && has_value) {
+            options.data_dir = argv[++i];
+        } else if (arg == "--shapes" && has_value) {
+            if (!parse_shapes(argv[++i], options.shapes)) usage(argv[0]);
+        } else if (arg == "--sizes" && has_value) {
+            if (!parse_sizes(argv[++i], options.sizes)) usage(argv[0]);
+        } else if (arg == "--resolution" && has_value) {
+            int width = 0, height = 0;
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                usage(argv[0]);
+            }
+            options.resolution = Eigen::Vector2i(width, height);
+        } else if (arg == "--views" && has_value) {
+            options.views = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--frames" && has_value) {
+            options.frames = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--csv" && has_value) {
+            options.csv = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+        } else {
+            options.meshes.push_back(arg);
+        }
+    }
+    if (options.meshes.empty()) {
+        const char* shipped[] = { "bunny.off", "max.off", "cylinder_soap_bubble.obj" };
+        for (const char* name : shipped) options.meshes.push_back(options.data_dir + "/" + name);
+    }
+
+    mesh_processing::OffscreenContext context;
+    string error;
+    if (!context.create(error)) {
+        fprintf(stderr, "no offscreen context: %s\n", error.c_str());
+        return -1;
+    }
+    Renderer renderer;
+    if (!init(renderer)) {
+        fprintf(stderr, "the mesh shaders or the framebuffer are not supported\n");
+        free_gl(renderer);
+        return -1;
+    }
+    if (!renderer.timer) fprintf(stderr, "no GPU timer, only the CPU times are measured\n");
+    if (!options.csv.empty()) {
+        csv.open(options.csv.c_str());
+        if (!csv) {
+            fprintf(stderr, "cannot write %s\n", options.csv.c_str());
+            return -1;
+        }
+        csv << "mesh,pass,orbit,faces,vertices,triangles,gpu_ms,cpu_ms,acmr\n";
+    }
+
+    printf("%s, %dx%d\n", (const char*) glGetString(GL_RENDERER), options.resolution.x(),
+           options.resolution.y());
+    printf("%-40s %10s %12s %10s %10s %9s %7s\n", "Pass", "Faces", "Triangles", "GPU ms",
+           "CPU ms", "Mtri/s", "ACMR");
+    printf("%s\n", string(104, '-').c_str());
+    for (const string& filename : options.meshes) {
+        MeshProcessing mesh;
+        if (!mesh.read_mesh(filename)) {
+            fprintf(stderr, "cannot read %s\n", filename.c_str());
+            continue;
+        }
+        const size_t slash = filename.find_last_of("/\\");
+        run_mesh(renderer, slash == string::npos ? filename : filename.substr(slash + 1), mesh);
+    }
+    for (const SyntheticMesh::SHAPE shape : options.shapes) {
+        for (const unsigned long long size : options.sizes) {
+            const float noise = shape == SyntheticMesh::PLANE ? 0.25f : 0.0f;
+            Mesh synthetic;
+            SyntheticMesh(shape, size, noise).build(synthetic);
+            MeshProcessing mesh(synthetic);
+            char label[48];
+            snprintf(label, sizeof(label), "%s_%uf", SyntheticMesh::shape_name(shape),
+                     synthetic.n_faces());
+            run_mesh(renderer, label, mesh);
+        }
+    }
+    free_gl(renderer);
+    return 0;
+}
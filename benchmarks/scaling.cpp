@@ -0,0 +1,323 @@
+// How the MeshProcessing operations scale with the mesh size and the number
+// of threads, on the synthetic meshes of synthetic_mesh.h.
+//
+//   mesh_scaling [--shapes sphere,torus,plane] [--sizes 10k,100k,1M]
+//                [--threads 1,8] [--filter TEXT] [--min-time SECONDS]
+//                [--cliff EXPONENT] [--csv FILE]
+//
+// Every operation runs on a fresh copy of the mesh until min-time has
+// passed, but at least once; the table lists the median time of one call,
+// the memory MeshProcessing::memory_report() holds afterwards and, on
+// Linux, the peak resident memory the call added. Between two sizes the
+// exponent k of time ~ faces^k is printed, and of the peak memory, or of
+// the retained one where the peak is unknown; an exponent above the cliff
+// (1.25) marks a super-linear step, e.g. the fill-in of the LDLT factors,
+// and is listed again at the end. --csv writes the rows for plot_scaling.py, which draws time and
+// memory over the size per operation and thread count.
+
+#include "mesh_processing.h"
+#include "resident_memory.h"
+#include "synthetic_mesh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using mesh_processing::MeshProcessing;
+using mesh_processing::SyntheticMesh;
+using std::string;
+
+namespace {
+
+struct Options {
+    std::vector<SyntheticMesh::SHAPE> shapes = { SyntheticMesh::SPHERE, SyntheticMesh::TORUS,
+                                                 SyntheticMesh::PLANE };
+    std::vector<unsigned long long> sizes = { 10000, 30000, 100000, 300000, 1000000 };
+    std::vector<int> threads;
+    string filter;
+    double min_time = 0.2;
+    double cliff = 1.25;
+    string csv;
+};
+
+Options options;
+
+typedef std::chrono::steady_clock Clock;
+
+// one operation, setup runs untimed before every call
+struct Operation {
+    string name;
+    // minimal_surface needs a boundary
+    bool needs_boundary;
+    std::function<void(MeshProcessing&)> body;
+};
+
+std::vector<Operation> operations() {
+    auto implicit = [](const MeshProcessing::SOLVER_TYPE solver) {
+        return [solver](MeshProcessing& mesh) {
+            mesh.set_solver(solver);
+            mesh.implicit_smoothing(1e-5);
+        };
+    };
+    return {
+        { "compute_mesh_properties", false, [](MeshProcessing& mesh) {
+            mesh.compute_mesh_properties();
+            mesh.get_normals();
+            mesh.compute_attributes();
+        } },
+        { "uniform_smooth/10", false, [](MeshProcessing& mesh) { mesh.uniform_smooth(10); } },
+        { "smooth/10", false, [](MeshProcessing& mesh) { mesh.smooth(10); } },
+        { "multiresolution_smooth/500", false,
+          [](MeshProcessing& mesh) { mesh.multiresolution_smooth(500); } },
+        { "implicit_smoothing/ldlt", false, implicit(MeshProcessing::DIRECT_LDLT) },
+        { "implicit_smoothing/ldlt-float", false, implicit(MeshProcessing::DIRECT_LDLT_FLOAT) },
+        { "implicit_smoothing/cg", false, implicit(MeshProcessing::CG_JACOBI) },
+        { "implicit_smoothing/multigrid", false, implicit(MeshProcessing::CG_MULTIGRID) },
+        { "implicit_smoothing/matrix-free", false, implicit(MeshProcessing::CG_MATRIX_FREE) },
+        { "minimal_surface", true, [](MeshProcessing& mesh) {
+            mesh.set_solver(MeshProcessing::DIRECT_LDLT);
+            mesh.minimal_surface();
+        } },
+        { "geodesic_distances", false, [](MeshProcessing& mesh) {
+            std::vector<float> distances;
+            mesh.geodesic_distances(std::vector<Mesh::Vertex>(1, Mesh::Vertex(0)), distances);
+        } },
+        { "decimate/half", false, [](MeshProcessing& mesh) {
+            mesh_processing::DecimationOptions decimation;
+            decimation.target_faces = mesh.get_mesh().n_faces() / 2;
+            mesh.decimate(decimation);
+        } },
+        { "remesh/1", false, [](MeshProcessing& mesh) {
+            mesh_processing::RemeshingOptions remeshing;
+            remeshing.iterations = 1;
+            mesh.remesh(remeshing);
+        } },
+    };
+}
+
+struct Result {
+    double faces = 0.0;
+    double seconds = 0.0;
+    // peak resident bytes the call added, or the retained ones
+    double memory = 0.0;
+};
+
+struct Cliff {
+    string what;
+    double exponent;
+};
+
+std::vector<Cliff> cliffs;
+std::map<string, Result> previous;
+std::ofstream csv;
+
+// k of y ~ x^k between the last and this size, 0 without a last size or
+// below the noise floor
+double exponent(const double x0, const double y0, const double x1, const double y1,
+                const double floor) {
+    if (x0 <= 0.0 || x1 <= x0 || y0 < floor || y1 < floor) return 0.0;
+    return std::log(y1 / y0) / std::log(x1 / x0);
+}
+
+void run(const string& shape, const Mesh& mesh, const Operation& operation, const int threads) {
+    const string name = shape + "/" + operation.name;
+    if (!options.filter.empty() && name.find(options.filter) == string::npos) return;
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+
+    MeshProcessing processing(mesh);
+    std::vector<double> times;
+    double total = 0.0, peak = -1.0;
+    size_t retained = 0;
+    do {
+        processing.set_mesh(mesh);
+        const bool tracked = mesh_processing::reset_peak_resident_memory();
+        const size_t before = mesh_processing::resident_memory();
+        const Clock::time_point start = Clock::now();
+        operation.body(processing);
+        times.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+        total += times.back();
+        if (tracked && before > 0) {
+            peak = std::max(peak, double(mesh_processing::peak_resident_memory()) - double(before));
+        }
+        retained = processing.memory_report().total();
+    } while (total < options.min_time);
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    const double t = times[times.size() / 2];
+
+    // against the last size of the same operation and thread count
+    char key[32];
+    snprintf(key, sizeof(key), "/%d", threads);
+    Result& last = previous[name + key];
+    const double faces = double(mesh.n_faces());
+    const double time_exponent = exponent(last.faces, last.seconds, faces, t, 1e-3);
+    // the retained memory where the peak is unknown
+    const double memory = peak >= 0.0 ? peak : double(retained);
+    const double memory_exponent = exponent(last.faces, last.memory, faces, memory, 1 << 20);
+    last.faces = faces;
+    last.seconds = t;
+    last.memory = memory;
+
+    char flags[64] = "";
+    auto flag = [&](const char* what, const double k) {
+        if (k <= options.cliff) return;
+        char entry[160];
+        snprintf(entry, sizeof(entry), "%s, %d threads, %u faces: %s ~ faces^%.2f",
+                 name.c_str(), threads, mesh.n_faces(), what, k);
+        cliffs.push_back({ entry, k });
+        strncat(flags, flags[0] ? ", " : "  super-linear ", sizeof(flags) - strlen(flags) - 1);
+        strncat(flags, what, sizeof(flags) - strlen(flags) - 1);
+    };
+    flag("time", time_exponent);
+    flag("memory", memory_exponent);
+
+    char time[32];
+    if (t < 1e-3) snprintf(time, sizeof(time), "%.1f us", t * 1e6);
+    else if (t < 1.0) snprintf(time, sizeof(time), "%.2f ms", t * 1e3);
+    else snprintf(time, sizeof(time), "%.3f s", t);
+    char peak_text[16] = "-";
+    if (peak >= 0.0) snprintf(peak_text, sizeof(peak_text), "%.1f", peak / (1 << 20));
+    char time_k[16] = "", memory_k[16] = "";
+    if (time_exponent != 0.0) snprintf(time_k, sizeof(time_k), "%.2f", time_exponent);
+    if (memory_exponent != 0.0) snprintf(memory_k, sizeof(memory_k), "%.2f", memory_exponent);
+    printf("%-44s %10u %7d %12s %11.1f %9s %7s %7s%s\n", name.c_str(), mesh.n_faces(), threads,
+           time, retained / double(1 << 20), peak_text, time_k, memory_k, flags);
+    fflush(stdout);
+
+    if (csv.is_open()) {
+        csv << shape << ',' << operation.name << ',' << threads << ',' << mesh.n_faces() << ','
+            << mesh.n_vertices() << ',' << t << ',' << retained / double(1 << 20) << ','
+            << (peak >= 0.0 ? peak / (1 << 20) : -1.0) << ',' << time_exponent << ','
+            << memory_exponent << '\n';
+        csv.flush();
+    }
+}
+
+// "10k,1.5M,300000"
+bool parse_sizes(const string& text, std::vector<unsigned long long>& sizes) {
+    sizes.clear();
+    std::istringstream list(text);
+    string item;
+    while (std::getline(list, item, ',')) {
+        char* end = nullptr;
+        const double value = strtod(item.c_str(), &end);
+        double scale = 1.0;
+        if (*end == 'k' || *end == 'K') scale = 1e3, ++end;
+        else if (*end == 'm' || *end == 'M') scale = 1e6, ++end;
+        if (end == item.c_str() || *end != '\0' || !(value > 0.0)) return false;
+        sizes.push_back((unsigned long long) (value * scale + 0.5));
+    }
+    std::sort(sizes.begin(), sizes.end());
+    return !sizes.empty();
+}
+
+bool parse_threads(const string& text, std::vector<int>& threads) {
+    threads.clear();
+    std::istringstream list(text);
+    string item;
+    while (std::getline(list, item, ',')) {
+        const int n = atoi(item.c_str());
+        if (n <= 0) return false;
+        threads.push_back(n);
+    }
+    return !threads.empty();
+}
+
+bool parse_shapes(const string& text, std::vector<SyntheticMesh::SHAPE>& shapes) {
+    shapes.clear();
+    std::istringstream list(text);
+    string item;
+    while (std::getline(list, item, ',')) {
+        SyntheticMesh::SHAPE shape;
+        if (!SyntheticMesh::parse_shape(item, shape)) return false;
+        shapes.push_back(shape);
+    }
+    return !shapes.empty();
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--shapes sphere,torus,plane] [--sizes 10k,100k,1M]\n"
+            "       [--threads 1,8] [--filter TEXT] [--min-time SECONDS]\n"
+            "       [--cliff EXPONENT] [--csv FILE]\n"
+            "sizes are face counts, by default 10k to 1M; threads 1 and all\n", program);
+    exit(-1);
+}
+
+}
+
+int main(int argc, char** argv) {
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    options.threads = { 1 };
+    if (max_threads > 1) options.threads.push_back(max_threads);
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--shapes" && has_value) {
+            if (!parse_shapes(argv[++i], options.shapes)) usage(argv[0]);
+        } else if (arg == "--sizes" && has_value) {
+            if (!parse_sizes(argv[++i], options.sizes)) usage(argv[0]);
+        } else if (arg == "--threads" && has_value) {
+            if (!parse_threads(argv[++i], options.threads)) usage(argv[0]);
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && has_value) {
+            options.min_time = atof(argv[++i]);
+        } else if (arg == "--cliff" && has_value) {
+            options.cliff = atof(argv[++i]);
+        } else if (arg == "--csv" && has_value) {
+            options.csv = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!options.csv.empty()) {
+        csv.open(options.csv.c_str());
+        if (!csv) {
+            fprintf(stderr, "cannot write %s\n", options.csv.c_str());
+            return -1;
+        }
+        csv << "shape,operation,threads,faces,vertices,seconds,memory_mb,peak_mb,"
+               "time_exponent,memory_exponent\n";
+    }
+
+    printf("%-44s %10s %7s %12s %11s %9s %7s %7s\n", "Operation", "Faces", "Threads", "Time",
+           "Memory MB", "Peak MB", "k time", "k mem");
+    printf("%s\n", string(114, '-').c_str());
+    const std::vector<Operation> ops = operations();
+    for (const SyntheticMesh::SHAPE shape : options.shapes) {
+        const string shape_name = SyntheticMesh::shape_name(shape);
+        for (const unsigned long long size : options.sizes) {
+            const float noise = shape == SyntheticMesh::PLANE ? 0.25f : 0.0f;
+            Mesh mesh;
+            SyntheticMesh(shape, size, noise).build(mesh);
+            for (const Operation& operation : ops) {
+                if (operation.needs_boundary && shape != SyntheticMesh::PLANE) continue;
+                for (const int threads : options.threads) {
+                    run(shape_name, mesh, operation, threads);
+                }
+            }
+        }
+    }
+
+    if (!cliffs.empty()) {
+        printf("\nsuper-linear steps, exponent above %.2f:\n", options.cliff);
+        for (const Cliff& cliff : cliffs) printf("  %s\n", cliff.what.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,321 @@
+#include "synthetic_mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+
+namespace mesh_processing {
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// the icosahedron, faces counter-clockwise from outside
+const double PHI = 1.6180339887498949;
+const double ICOSAHEDRON_VERTICES[12][3] = {
+    { -1, PHI, 0 }, { 1, PHI, 0 }, { -1, -PHI, 0 }, { 1, -PHI, 0 },
+    { 0, -1, PHI }, { 0, 1, PHI }, { 0, -1, -PHI }, { 0, 1, -PHI },
+    { PHI, 0, -1 }, { PHI, 0, 1 }, { -PHI, 0, -1 }, { -PHI, 0, 1 }
+};
+const int ICOSAHEDRON_FACES[20][3] = {
+    { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+    { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+    { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+    { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+};
+
+// the 30 edges of the icosahedron numbered in the order the faces list
+// them, with the lower corner first
+struct IcosahedronEdges {
+    int id[12][12];
+    int corners[30][2];
+
+    IcosahedronEdges() {
+        int n = 0;
+        for (int a = 0; a < 12; ++a) {
+            for (int b = 0; b < 12; ++b) id[a][b] = -1;
+        }
+        for (int f = 0; f < 20; ++f) {
+            for (int k = 0; k < 3; ++k) {
+                const int a = std::min(ICOSAHEDRON_FACES[f][k], ICOSAHEDRON_FACES[f][(k + 1) % 3]);
+                const int b = std::max(ICOSAHEDRON_FACES[f][k], ICOSAHEDRON_FACES[f][(k + 1) % 3]);
+                if (id[a][b] >= 0) continue;
+                id[a][b] = id[b][a] = n;
+                corners[n][0] = a;
+                corners[n][1] = b;
+                ++n;
+            }
+        }
+    }
+};
+
+const IcosahedronEdges& icosahedron_edges() {
+    static const IcosahedronEdges edges;
+    return edges;
+}
+
+Point corner(const int c) {
+    return Point(Scalar(ICOSAHEDRON_VERTICES[c][0]), Scalar(ICOSAHEDRON_VERTICES[c][1]),
+                 Scalar(ICOSAHEDRON_VERTICES[c][2]));
+}
+
+// uniform in [-1, 1] from the seed and the index (splitmix64)
+float hash_noise(const uint32_t seed, const uint64_t i) {
+    uint64_t z = (uint64_t(seed) << 40) + i + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    return float(double(z >> 11) * (2.0 / 9007199254740992.0) - 1.0);
+}
+
+// the largest s with s * s <= x
+uint64_t isqrt(const uint64_t x) {
+    uint64_t s = uint64_t(std::sqrt(double(x)));
+    while (s * s > x) --s;
+    while ((s + 1) * (s + 1) <= x) ++s;
+    return s;
+}
+
+// interior points of an icosahedron face before row j, rows j >= 1 hold
+// the points i = 1 .. f-1-j
+uint64_t interior_offset(const uint64_t f, const uint64_t j) {
+    return (j - 1) * (f - 1) - (j - 1) * j / 2;
+}
+
+// vertices and faces computed per chunk, in parallel
+const int64_t CHUNK = 1 << 16;
+
+}
+
+SyntheticMesh::SyntheticMesh(const SHAPE shape, const uint64_t faces, const float noise,
+                             const uint32_t seed)
+    : shape_(shape), noise_(noise), seed_(seed) {
+    const double target = double(std::max<uint64_t>(faces, 1));
+    switch (shape) {
+    case SPHERE: {
+        const uint64_t f = std::max<uint64_t>(1, uint64_t(std::sqrt(target / 20.0) + 0.5));
+        resolution_ = int(f);
+        n_vertices_ = 10 * f * f + 2;
+        n_faces_ = 20 * f * f;
+        // the icosahedron edge on the unit sphere over f
+        edge_length_ = float(1.0514622242382672 / f);
+        break;
+    }
+    case TORUS: {
+        const uint64_t m = std::max<uint64_t>(3, uint64_t(std::sqrt(target / 6.0) + 0.5));
+        resolution_ = int(m);
+        n_vertices_ = 3 * m * m;
+        n_faces_ = 6 * m * m;
+        edge_length_ = float(2.0 * PI / (3.0 * m));
+        break;
+    }
+    case PLANE: {
+        const uint64_t n = std::max<uint64_t>(2, uint64_t(std::sqrt(target / 2.0) + 0.5) + 1);
+        resolution_ = int(n);
+        n_vertices_ = n * n;
+        n_faces_ = 2 * (n - 1) * (n - 1);
+        edge_length_ = float(1.0 / (n - 1));
+        break;
+    }
+    }
+}
+
+Point SyntheticMesh::vertex(const uint64_t i) const {
+    const float offset = noise_ != 0.0f ? noise_ * edge_length_ * hash_noise(seed_, i) : 0.0f;
+    switch (shape_) {
+    case SPHERE: {
+        const Point p = sphere_vertex(i);
+        return p * (1.0f + offset);
+    }
+    case TORUS: {
+        const uint64_t n = 3 * uint64_t(resolution_);
+        const double u = 2.0 * PI * double(i % n) / double(n);
+        const double v = 2.0 * PI * double(i / n) / double(resolution_);
+        const double r = 1.0 / 3.0 + offset;
+        return Point(Scalar((1.0 + r * std::cos(v)) * std::cos(u)),
+                     Scalar((1.0 + r * std::cos(v)) * std::sin(u)),
+                     Scalar(r * std::sin(v)));
+    }
+    case PLANE:
+    default: {
+        const uint64_t n = uint64_t(resolution_);
+        return Point(Scalar(double(i % n) / double(n - 1)),
+                     Scalar(double(i / n) / double(n - 1)), offset);
+    }
+    }
+}
+
+void SyntheticMesh::triangle(const uint64_t f, uint32_t v[3]) const {
+    if (shape_ == SPHERE) {
+        sphere_triangle(f, v);
+        return;
+    }
+    // quads of the grid, two triangles each; the torus wraps around
+    const bool torus = shape_ == TORUS;
+    const uint64_t columns = torus ? 3 * uint64_t(resolution_) : uint64_t(resolution_) - 1;
+    const uint64_t rows = torus ? uint64_t(resolution_) : uint64_t(resolution_) - 1;
+    const uint64_t stride = torus ? columns : columns + 1;
+    const uint64_t q = f / 2, a = q % columns, b = q / columns;
+    const uint64_t a1 = torus ? (a + 1) % columns : a + 1;
+    const uint64_t b1 = torus ? (b + 1) % rows : b + 1;
+    const uint32_t v00 = uint32_t(b * stride + a), v10 = uint32_t(b * stride + a1);
+    const uint32_t v01 = uint32_t(b1 * stride + a), v11 = uint32_t(b1 * stride + a1);
+    if (f % 2 == 0) {
+        v[0] = v00;
+        v[1] = v10;
+        v[2] = v11;
+    } else {
+        v[0] = v00;
+        v[1] = v11;
+        v[2] = v01;
+    }
+}
+
+Point SyntheticMesh::sphere_vertex(const uint64_t i) const {
+    const uint64_t f = uint64_t(resolution_);
+    if (i < 12) return normalize(corner(int(i)));
+
+    // on an edge, t steps from its lower corner
+    const uint64_t on_edges = 30 * (f - 1);
+    if (i < 12 + on_edges) {
+        const IcosahedronEdges& edges = icosahedron_edges();
+        const uint64_t e = (i - 12) / (f - 1), t = (i - 12) % (f - 1) + 1;
+        const Point a = corner(edges.corners[e][0]), b = corner(edges.corners[e][1]);
+        return normalize(a + (b - a) * Scalar(double(t) / double(f)));
+    }
+
+    // inside a face, row j holds the points i = 1 .. f-1-j
+    const uint64_t per_face = (f - 1) * (f - 2) / 2;
+    const uint64_t k = i - 12 - on_edges;
+    const int face = int(k / per_face);
+    const uint64_t l = k % per_face;
+    // the last row with interior_offset(j) <= l: with x = j - 1 the offset
+    // is x (f - 3/2) - x^2 / 2, the root is corrected for the rounding
+    const double h = double(f) - 1.5;
+    const double x = h - std::sqrt(std::max(0.0, h * h - 2.0 * double(l)));
+    uint64_t j = std::max<uint64_t>(1, std::min<uint64_t>(uint64_t(x) + 1, f - 2));
+    while (j > 1 && interior_offset(f, j) > l) --j;
+    while (j + 1 <= f - 2 && interior_offset(f, j + 1) <= l) ++j;
+    const uint64_t s = l - interior_offset(f, j) + 1;
+    const Point c0 = corner(ICOSAHEDRON_FACES[face][0]);
+    const Point c1 = corner(ICOSAHEDRON_FACES[face][1]);
+    const Point c2 = corner(ICOSAHEDRON_FACES[face][2]);
+    return normalize(c0 + (c1 - c0) * Scalar(double(s) / double(f)) +
+                     (c2 - c0) * Scalar(double(j) / double(f)));
+}
+
+uint32_t SyntheticMesh::sphere_edge_index(const int a, const int b, const int t) const {
+    const int f = resolution_;
+    const int e = icosahedron_edges().id[a][b];
+    const int steps = a < b ? t : f - t;
+    return uint32_t(12 + uint64_t(e) * (f - 1) + steps - 1);
+}
+
+uint32_t SyntheticMesh::sphere_index(const int face, const int i, const int j) const {
+    const int f = resolution_;
+    const int* c = ICOSAHEDRON_FACES[face];
+    if (i == 0 && j == 0) return uint32_t(c[0]);
+    if (i == f) return uint32_t(c[1]);
+    if (j == f) return uint32_t(c[2]);
+    if (j == 0) return sphere_edge_index(c[0], c[1], i);
+    if (i == 0) return sphere_edge_index(c[0], c[2], j);
+    if (i + j == f) return sphere_edge_index(c[1], c[2], j);
+    const uint64_t per_face = uint64_t(f - 1) * (f - 2) / 2;
+    return uint32_t(12 + 30 * uint64_t(f - 1) + face * per_face + interior_offset(f, j) + i - 1);
+}
+
+void SyntheticMesh::sphere_triangle(const uint64_t t, uint32_t v[3]) const {
+    // row r of a face starts at f^2 - (f-r)^2 and holds 2 (f-r) - 1
+    // triangles, pointing up and down in turn
+    const uint64_t f = uint64_t(resolution_);
+    const int face = int(t / (f * f));
+    const uint64_t k = t % (f * f);
+    uint64_t s = isqrt(f * f - k);
+    if (s * s < f * f - k) ++s;
+    const uint64_t r = f - s;
+    const uint64_t in_row = k - (f * f - s * s);
+    const int m = int(in_row / 2), row = int(r);
+    if (in_row % 2 == 0) {
+        v[0] = sphere_index(face, m, row);
+        v[1] = sphere_index(face, m + 1, row);
+        v[2] = sphere_index(face, m, row + 1);
+    } else {
+        v[0] = sphere_index(face, m + 1, row);
+        v[1] = sphere_index(face, m + 1, row + 1);
+        v[2] = sphere_index(face, m, row + 1);
+    }
+}
+
+void SyntheticMesh::build(surface_mesh::Surface_mesh& mesh) const {
+    mesh.clear();
+    mesh.reserve(surface_mesh::Index_type(n_vertices_),
+                 surface_mesh::Index_type(n_vertices_ + n_faces_),
+                 surface_mesh::Index_type(n_faces_));
+    std::vector<Point> points(n_vertices_);
+    const int64_t nv = int64_t(n_vertices_), nf = int64_t(n_faces_);
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < nv; ++i) points[i] = vertex(uint64_t(i));
+    for (const Point& p : points) mesh.add_vertex(p);
+    std::vector<Point>().swap(points);
+
+    std::vector<unsigned int> indices(3 * n_faces_);
+#pragma omp parallel for schedule(static)
+    for (int64_t f = 0; f < nf; ++f) {
+        uint32_t v[3];
+        triangle(uint64_t(f), v);
+        for (int k = 0; k < 3; ++k) indices[3 * f + k] = v[k];
+    }
+    mesh.add_faces(indices, std::vector<unsigned int>(n_faces_, 3));
+}
+
+bool SyntheticMesh::write_off_binary(const std::string& filename) const {
+    FILE* out = fopen(filename.c_str(), "wb");
+    if (!out) return false;
+    const char header[] = "OFF BINARY\n";
+    const uint32_t counts[3] = { uint32_t(n_vertices_), uint32_t(n_faces_), 0 };
+    bool ok = fwrite(header, 1, sizeof(header) - 1, out) == sizeof(header) - 1 &&
+              fwrite(counts, sizeof(counts), 1, out) == 1;
+
+    // every chunk is computed in parallel, then written
+    std::vector<Point> points;
+    for (uint64_t begin = 0; ok && begin < n_vertices_; begin += CHUNK) {
+        const int64_t count = int64_t(std::min<uint64_t>(CHUNK, n_vertices_ - begin));
+        points.resize(count);
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < count; ++i) points[i] = vertex(begin + i);
+        ok = fwrite(points.data(), sizeof(Point), count, out) == size_t(count);
+    }
+    std::vector<uint32_t> records;
+    for (uint64_t begin = 0; ok && begin < n_faces_; begin += CHUNK) {
+        const int64_t count = int64_t(std::min<uint64_t>(CHUNK, n_faces_ - begin));
+        records.resize(4 * count);
+#pragma omp parallel for schedule(static)
+        for (int64_t f = 0; f < count; ++f) {
+            records[4 * f] = 3;
+            triangle(begin + f, &records[4 * f + 1]);
+        }
+        ok = fwrite(records.data(), sizeof(uint32_t), records.size(), out) == records.size();
+    }
+    return fclose(out) == 0 && ok;
+}
+
+bool SyntheticMesh::parse_shape(const std::string& name, SHAPE& shape) {
+    if (name == "sphere") shape = SPHERE;
+    else if (name == "torus") shape = TORUS;
+    else if (name == "plane") shape = PLANE;
+    else return false;
+    return true;
+}
+
+const char* SyntheticMesh::shape_name(const SHAPE shape) {
+    switch (shape) {
+    case SPHERE: return "sphere";
+    case TORUS: return "torus";
+    default: return "plane";
+    }
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef SYNTHETIC_MESH_H
+#define SYNTHETIC_MESH_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <cstdint>
+#include <string>
+
+namespace mesh_processing {
+
+// Triangle meshes of any size for the scaling runs, with well shaped faces
+// and valence 6 almost everywhere:
+//  - SPHERE, the icosahedron with every face split into f^2 triangles and
+//    the vertices projected onto the unit sphere, 20 f^2 faces,
+//  - TORUS, a periodic m x 3m grid on the torus of radii 1 and 1/3, 6 m^2
+//    faces,
+//  - PLANE, an n x n grid over the unit square, 2 (n-1)^2 faces, open.
+// The resolution is the one closest to the requested face count. Vertices
+// and triangles are computed by index, so the mesh is built or written in
+// parallel chunks without holding the face list, which keeps 100M faces
+// within reach. Noise moves every vertex along the surface normal by up to
+// noise times the edge length, from a hash of the seed and the vertex
+// index, so every run of a size gets the same mesh.
+class SyntheticMesh {
+
+public:
+    enum SHAPE { SPHERE, TORUS, PLANE };
+
+    SyntheticMesh(const SHAPE shape, const uint64_t faces, const float noise = 0.0f,
+                  const uint32_t seed = 1);
+
+    uint64_t n_vertices() const { return n_vertices_; }
+    uint64_t n_faces() const { return n_faces_; }
+    // the position of vertex i
+    surface_mesh::Point vertex(const uint64_t i) const;
+    // the vertices of face f, counter-clockwise seen from outside
+    void triangle(const uint64_t f, uint32_t v[3]) const;
+
+    // replaces the contents of mesh
+    void build(surface_mesh::Surface_mesh& mesh) const;
+    // streams the mesh to an OFF BINARY file as surface_mesh::write_off_binary()
+    // writes it, false if it cannot be written
+    bool write_off_binary(const std::string& filename) const;
+
+    // "sphere", "torus" or "plane", false for other names
+    static bool parse_shape(const std::string& name, SHAPE& shape);
+    static const char* shape_name(const SHAPE shape);
+
+private:
+    surface_mesh::Point sphere_vertex(const uint64_t i) const;
+    void sphere_triangle(const uint64_t f, uint32_t v[3]) const;
+    // index of the point i steps towards corner 1 and j towards corner 2
+    // from corner 0 of icosahedron face face
+    uint32_t sphere_index(const int face, const int i, const int j) const;
+    // index of the point t steps from corner a on the edge to corner b
+    uint32_t sphere_edge_index(const int a, const int b, const int t) const;
+
+    SHAPE shape_;
+    float noise_;
+    uint32_t seed_;
+    // f of the sphere, m of the torus, n of the plane
+    int resolution_;
+    uint64_t n_vertices_;
+    uint64_t n_faces_;
+    // the edge length noise_ is relative to
+    float edge_length_;
+};
+
+}
+
+#endif // SYNTHETIC_MESH_H
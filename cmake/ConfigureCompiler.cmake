@@ -8,3 +8,128 @@ else()
     set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -std=c++11")
     set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -w") # disable all warnings (not ideal but...)
 endif()
+
+### OpenMP is optional: without it the parallel loops simply run serially
+find_package(OpenMP)
+if(OPENMP_FOUND)
+    set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${OpenMP_CXX_FLAGS}")
+endif()
+
+### Optional: target the instruction set of the build machine (AVX2, NEON...)
+### for the vectorized kernels; FMA contraction stays off so results match
+### the portable build bit for bit
+option(GP_NATIVE_ARCH "Compile for the instruction set of the build machine" OFF)
+if(GP_NATIVE_ARCH)
+    if(MSVC)
+        set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} /arch:AVX2 /fp:precise")
+    else()
+        set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -march=native -ffp-contract=off")
+    endif()
+endif()
+
+### Optional: scoped timers around the processing phases, written as Chrome
+### traces with --trace FILE; compiled out by default
+option(GP_TRACING "Record SURFACE_MESH_TRACE_ZONE timers" OFF)
+if(GP_TRACING)
+    add_definitions(-DSURFACE_MESH_TRACING)
+endif()
+
+### Optional: count the operator new calls of the process and of every
+### trace zone, for driving steady-state loops to zero allocations; replaces
+### the global operator new, so it is off by default
+option(GP_ALLOCATION_TRACKING "Count allocations per trace zone" OFF)
+if(GP_ALLOCATION_TRACKING)
+    add_definitions(-DSURFACE_MESH_ALLOCATION_TRACKING)
+endif()
+
+### Optional: 64-bit handles and connectivity for meshes beyond 2^32 - 1
+### halfedges; the default 32-bit indices keep the connectivity half the size
+option(GP_64BIT_INDICES "Store Surface_mesh indices in 64 bits" OFF)
+if(GP_64BIT_INDICES)
+    add_definitions(-DSURFACE_MESH_64BIT_INDICES)
+endif()
+
+### Optional: property arrays in 64-byte aligned storage, arrays of 2 MB and
+### more on huge pages where the system has them
+option(GP_HUGE_PAGES "Allocate the Surface_mesh property arrays on huge pages" OFF)
+if(GP_HUGE_PAGES)
+    add_definitions(-DSURFACE_MESH_HUGE_PAGES)
+endif()
+
+### Optional: the storage of large property arrays is first written by all
+### threads in the static partition of the parallel loops, so on NUMA systems
+### every thread finds its part of an array on its own node
+option(GP_FIRST_TOUCH "Place the Surface_mesh property arrays by parallel first touch" OFF)
+if(GP_FIRST_TOUCH)
+    add_definitions(-DSURFACE_MESH_FIRST_TOUCH)
+endif()
+
+### Optional: property arrays can take over storage they did not allocate,
+### map_poly() opens poly files and mesh caches in constant time by leaving
+### the arrays in a copy-on-write mapping of the file
+option(GP_MAPPED_MESH "Let map_poly() map the Surface_mesh property arrays from the file" OFF)
+if(GP_MAPPED_MESH)
+    add_definitions(-DSURFACE_MESH_MAPPED_STORAGE)
+endif()
+
+### Optional: the valences and curvatures computed for display are stored as
+### 16 bit floats, half the memory of the largest per-vertex properties
+option(GP_HALF_SCALARS "Store the derived display scalars in half precision" OFF)
+if(GP_HALF_SCALARS)
+    add_definitions(-DMESH_PROCESSING_HALF_SCALARS)
+endif()
+
+### Optional: surface_mesh as a static library, so that LTO can inline its
+### accessors (position, to_vertex, halfedge...) and the circulators into
+### mesh_processing; across the shared library boundary they stay calls
+option(GP_STATIC_SURFACE_MESH "Build surface_mesh as a static library" OFF)
+
+### Optional: link time optimization of all targets
+option(GP_LTO "Link time optimization" OFF)
+if(GP_LTO)
+    if(POLICY CMP0069)
+        cmake_policy(SET CMP0069 NEW)
+    endif()
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT GP_LTO_SUPPORTED OUTPUT GP_LTO_ERROR)
+    if(GP_LTO_SUPPORTED)
+        set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+    else()
+        message(WARNING "GP_LTO: link time optimization not supported: ${GP_LTO_ERROR}")
+    endif()
+endif()
+
+### Optional: profile guided optimization in two passes over one build
+### directory. GENERATE builds instrumented binaries, the pgo_training target
+### runs mesh_benchmark over the data meshes and writes the profiles to
+### GP_PGO_DIR; reconfiguring with USE rebuilds with them. The object paths
+### of the two passes must match, hence the same build directory.
+set(GP_PGO "OFF" CACHE STRING "Profile guided optimization: OFF, GENERATE or USE")
+set_property(CACHE GP_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(GP_PGO_DIR "${CMAKE_BINARY_DIR}/pgo-profile" CACHE PATH "Profiles of GP_PGO")
+if(NOT GP_PGO STREQUAL "OFF")
+    if(MSVC)
+        message(WARNING "GP_PGO: only GCC and Clang are supported, ignored")
+    elseif(GP_PGO STREQUAL "GENERATE")
+        # the OpenMP loops update the counters from several threads
+        if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+            set(GP_PGO_FLAGS "-fprofile-generate=${GP_PGO_DIR}")
+        else()
+            set(GP_PGO_FLAGS "-fprofile-generate=${GP_PGO_DIR} -fprofile-update=prefer-atomic")
+        endif()
+    elseif(GP_PGO STREQUAL "USE")
+        # Clang reads the profiles pgo_training merged with llvm-profdata,
+        # GCC one .gcda per object; code the training missed stays as is
+        if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+            set(GP_PGO_FLAGS "-fprofile-use=${GP_PGO_DIR}/default.profdata")
+        else()
+            set(GP_PGO_FLAGS "-fprofile-use=${GP_PGO_DIR} -fprofile-partial-training")
+        endif()
+    else()
+        message(FATAL_ERROR "GP_PGO must be OFF, GENERATE or USE, not ${GP_PGO}")
+    endif()
+    set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${GP_PGO_FLAGS}")
+    set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${GP_PGO_FLAGS}")
+    set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} ${GP_PGO_FLAGS}")
+    set(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} ${GP_PGO_FLAGS}")
+endif()
@@ -0,0 +1,15 @@
+# Try to find the AmgX library of NVIDIA, under $AMGX_DIR by default.
+# Once done this will define
+#
+# AMGX_FOUND
+# AMGX_INCLUDE_DIR
+# AMGX_LIBRARIES
+#
+
+find_path(AMGX_INCLUDE_DIR amgx_c.h HINTS $ENV{AMGX_DIR}/include)
+find_library(AMGX_LIBRARY amgxsh HINTS $ENV{AMGX_DIR}/lib)
+set(AMGX_LIBRARIES ${AMGX_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(AmgX DEFAULT_MSG AMGX_INCLUDE_DIR AMGX_LIBRARY)
+mark_as_advanced(AMGX_INCLUDE_DIR AMGX_LIBRARY)
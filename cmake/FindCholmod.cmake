@@ -0,0 +1,28 @@
+# Try to find CHOLMOD of SuiteSparse together with the libraries it needs.
+# Once done this will define
+#
+# CHOLMOD_FOUND
+# CHOLMOD_INCLUDE_DIR
+# CHOLMOD_LIBRARIES
+#
+
+find_path(CHOLMOD_INCLUDE_DIR cholmod.h PATH_SUFFIXES suitesparse ufsparse)
+find_library(CHOLMOD_LIBRARY cholmod)
+
+set(CHOLMOD_LIBRARIES ${CHOLMOD_LIBRARY})
+foreach(lib amd colamd camd ccolamd suitesparseconfig)
+    find_library(CHOLMOD_${lib}_LIBRARY ${lib})
+    if(CHOLMOD_${lib}_LIBRARY)
+        list(APPEND CHOLMOD_LIBRARIES ${CHOLMOD_${lib}_LIBRARY})
+    endif()
+endforeach()
+
+# the supernodal factorization calls BLAS and LAPACK
+find_package(LAPACK QUIET)
+if(LAPACK_FOUND)
+    list(APPEND CHOLMOD_LIBRARIES ${LAPACK_LIBRARIES})
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Cholmod DEFAULT_MSG CHOLMOD_INCLUDE_DIR CHOLMOD_LIBRARY)
+mark_as_advanced(CHOLMOD_INCLUDE_DIR CHOLMOD_LIBRARY)
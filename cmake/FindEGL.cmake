@@ -0,0 +1,16 @@
+# Try to find EGL, for OpenGL contexts without a window.
+# Once done this will define
+#
+# EGL_FOUND
+# EGL_INCLUDE_DIR
+# EGL_LIBRARIES
+#
+
+find_path(EGL_INCLUDE_DIR EGL/egl.h)
+find_library(EGL_LIBRARY EGL)
+
+set(EGL_LIBRARIES ${EGL_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(EGL DEFAULT_MSG EGL_INCLUDE_DIR EGL_LIBRARY)
+mark_as_advanced(EGL_INCLUDE_DIR EGL_LIBRARY)
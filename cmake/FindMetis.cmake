@@ -0,0 +1,16 @@
+# Try to find the METIS graph partitioning library.
+# Once done this will define
+#
+# METIS_FOUND
+# METIS_INCLUDE_DIR
+# METIS_LIBRARIES
+#
+
+find_path(METIS_INCLUDE_DIR metis.h PATH_SUFFIXES metis)
+find_library(METIS_LIBRARY metis)
+
+set(METIS_LIBRARIES ${METIS_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Metis DEFAULT_MSG METIS_INCLUDE_DIR METIS_LIBRARY)
+mark_as_advanced(METIS_INCLUDE_DIR METIS_LIBRARY)
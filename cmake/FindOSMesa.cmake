@@ -0,0 +1,16 @@
+# Try to find OSMesa, Mesa's off-screen OpenGL rendering.
+# Once done this will define
+#
+# OSMESA_FOUND
+# OSMESA_INCLUDE_DIR
+# OSMESA_LIBRARIES
+#
+
+find_path(OSMESA_INCLUDE_DIR GL/osmesa.h)
+find_library(OSMESA_LIBRARY OSMesa)
+
+set(OSMESA_LIBRARIES ${OSMESA_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(OSMesa DEFAULT_MSG OSMESA_INCLUDE_DIR OSMESA_LIBRARY)
+mark_as_advanced(OSMESA_INCLUDE_DIR OSMESA_LIBRARY)
@@ -0,0 +1,26 @@
+# Try to find the Pardiso solver of Intel MKL, under $MKLROOT by default.
+# Once done this will define
+#
+# PARDISO_FOUND
+# PARDISO_INCLUDE_DIR
+# PARDISO_LIBRARIES
+#
+
+find_path(PARDISO_INCLUDE_DIR mkl_pardiso.h HINTS $ENV{MKLROOT}/include)
+
+# LP64 interface with the GNU OpenMP threading layer
+set(PARDISO_LIBRARIES)
+foreach(lib mkl_intel_lp64 mkl_gnu_thread mkl_core)
+    find_library(PARDISO_${lib}_LIBRARY ${lib} HINTS $ENV{MKLROOT}/lib/intel64 $ENV{MKLROOT}/lib)
+    if(PARDISO_${lib}_LIBRARY)
+        list(APPEND PARDISO_LIBRARIES ${PARDISO_${lib}_LIBRARY})
+    endif()
+endforeach()
+if(UNIX)
+    list(APPEND PARDISO_LIBRARIES gomp m dl)
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Pardiso DEFAULT_MSG PARDISO_INCLUDE_DIR
+                                  PARDISO_mkl_intel_lp64_LIBRARY PARDISO_mkl_core_LIBRARY)
+mark_as_advanced(PARDISO_INCLUDE_DIR)
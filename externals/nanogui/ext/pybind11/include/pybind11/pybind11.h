@@ -1376,6 +1376,26 @@ inline function get_type_overload(const void *this_ptr, const detail::type_info
     }
 
     /* Don't call dispatch code if invoked from overridden function */
+#if PY_VERSION_HEX >= 0x030b0000
+    /* the frame and code objects are opaque since Python 3.11 */
+    PyFrameObject *frame = PyThreadState_GetFrame(PyThreadState_Get());
+    if (frame) {
+        PyCodeObject *code = PyFrame_GetCode(frame);
+        object name_obj(PyObject_GetAttrString((PyObject *) code, "co_name"), false);
+        if ((std::string) name_obj.str() == name && code->co_argcount > 0) {
+            object varnames(PyCode_GetVarnames(code), false);
+            object locals(PyFrame_GetLocals(frame), false);
+            PyObject *self_caller = PyDict_GetItem(locals.ptr(), PyTuple_GET_ITEM(varnames.ptr(), 0));
+            if (self_caller == py_object.ptr()) {
+                Py_DECREF(code);
+                Py_DECREF(frame);
+                return function();
+            }
+        }
+        Py_DECREF(code);
+        Py_DECREF(frame);
+    }
+#else
     PyFrameObject *frame = PyThreadState_Get()->frame;
     if (frame && (std::string) pybind11::handle(frame->f_code->co_name).str() == name &&
         frame->f_code->co_argcount > 0) {
@@ -1385,6 +1405,7 @@ inline function get_type_overload(const void *this_ptr, const detail::type_info
         if (self_caller == py_object.ptr())
             return function();
     }
+#endif
     return overload;
 }
 
@@ -106,6 +106,17 @@ public:
                        const std::string &fragment_fname,
                        const std::string &geometry_fname = "");
 
+    /**
+     * \brief Cache the linked programs of init() in \c directory, which must
+     * exist; an empty directory (the default) disables the cache.
+     *
+     * A program is stored under its name and a hash of its sources, its
+     * definitions and the GL vendor, renderer and version, so a changed
+     * shader or driver compiles again. Without program binary support in
+     * the driver the shaders are always compiled.
+     */
+    static void setProgramCache(const std::string &directory);
+
     /// Return the name of the shader
     const std::string &name() const { return mName; }
 
@@ -124,7 +135,8 @@ public:
     /// Return the handle of a uniform attribute (-1 if it does not exist)
     GLint uniform(const std::string &name, bool warn = true) const;
 
-    /// Upload an Eigen matrix as a vertex buffer object (refreshing it as needed)
+    /// Upload an Eigen matrix as a vertex buffer object (refreshing it as needed,
+    /// a buffer of unchanged size and layout is updated in place)
     template <typename Matrix> void uploadAttrib(const std::string &name, const Matrix &M, int version = -1) {
         uint32_t compSize = sizeof(typename Matrix::Scalar);
         GLuint glType = (GLuint) detail::type_traits<typename Matrix::Scalar>::type;
@@ -134,6 +146,19 @@ public:
                      glType, integral, (const uint8_t *) M.data(), version);
     }
 
+    /// Overwrite the columns [first, first + M.cols()) of an attribute uploaded
+    /// before with the same layout, false (and nothing is written) otherwise
+    template <typename Matrix> bool uploadAttribRange(const std::string &name, uint32_t first,
+                                                      const Matrix &M, int version = -1) {
+        uint32_t compSize = sizeof(typename Matrix::Scalar);
+        GLuint glType = (GLuint) detail::type_traits<typename Matrix::Scalar>::type;
+        bool integral = (bool) detail::type_traits<typename Matrix::Scalar>::integral;
+
+        return uploadAttribRange(name, first * (uint32_t) M.rows(), (uint32_t) M.size(),
+                                 (int) M.rows(), compSize, glType, integral,
+                                 (const uint8_t *) M.data(), version);
+    }
+
     /// Download a vertex buffer object into an Eigen matrix
     template <typename Matrix> void downloadAttrib(const std::string &name, Matrix &M) {
         uint32_t compSize = sizeof(typename Matrix::Scalar);
@@ -253,13 +278,16 @@ public:
     size_t bufferSize() const {
         size_t size = 0;
         for (auto const &buf : mBufferObjects)
-            size += buf.second.size;
+            size += (size_t) buf.second.size * buf.second.compSize;
         return size;
     }
 protected:
     void uploadAttrib(const std::string &name, uint32_t size, int dim,
                        uint32_t compSize, GLuint glType, bool integral,
                        const uint8_t *data, int version = -1);
+    bool uploadAttribRange(const std::string &name, uint32_t offset, uint32_t size, int dim,
+                           uint32_t compSize, GLuint glType, bool integral,
+                           const uint8_t *data, int version = -1);
     void downloadAttrib(const std::string &name, uint32_t size, int dim,
                        uint32_t compSize, GLuint glType, uint8_t *data);
 protected:
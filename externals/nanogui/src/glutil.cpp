@@ -12,6 +12,10 @@
 #include <nanogui/glutil.h>
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <vector>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -83,6 +87,70 @@ bool GLShader::initFromFiles(
                 file_to_string(geometry_fname));
 }
 
+namespace {
+
+#if defined(_WIN32)
+#  define NANOGUI_GL_APIENTRY __stdcall
+#else
+#  define NANOGUI_GL_APIENTRY
+#endif
+
+// ARB_get_program_binary, core since OpenGL 4.1; loaded at run time since
+// the 3.3 context and glad do not declare it
+const GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+const GLenum PROGRAM_BINARY_LENGTH = 0x8741;
+const GLenum NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
+
+struct ProgramBinaryApi {
+    typedef void (NANOGUI_GL_APIENTRY *GetProgramBinary)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
+    typedef void (NANOGUI_GL_APIENTRY *ProgramBinary)(GLuint, GLenum, const void *, GLsizei);
+    typedef void (NANOGUI_GL_APIENTRY *ProgramParameteri)(GLuint, GLenum, GLint);
+
+    bool loaded = false;
+    GetProgramBinary getProgramBinary = nullptr;
+    ProgramBinary programBinary = nullptr;
+    ProgramParameteri programParameteri = nullptr;
+    // hash of the vendor, renderer and version strings
+    uint64_t driver = 0;
+
+    bool available() {
+        if (!loaded) {
+            loaded = true;
+            GLint formats = 0;
+            glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &formats);
+            while (glGetError() != GL_NO_ERROR) { }
+            if (formats > 0) {
+                getProgramBinary = (GetProgramBinary) glfwGetProcAddress("glGetProgramBinary");
+                programBinary = (ProgramBinary) glfwGetProcAddress("glProgramBinary");
+                programParameteri = (ProgramParameteri) glfwGetProcAddress("glProgramParameteri");
+            }
+            for (GLenum e : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+                const char *str = (const char *) glGetString(e);
+                driver = hash(str ? str : "", driver);
+            }
+        }
+        return getProgramBinary && programBinary && programParameteri;
+    }
+
+    // FNV-1a
+    static uint64_t hash(const std::string &str, uint64_t h = 14695981039346656037ull) {
+        for (unsigned char c : str) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+};
+
+ProgramBinaryApi programBinaryApi;
+std::string programCacheDirectory;
+
+}
+
+void GLShader::setProgramCache(const std::string &directory) {
+    programCacheDirectory = directory;
+}
+
 bool GLShader::init(const std::string &name,
                     const std::string &vertex_str,
                     const std::string &fragment_str,
@@ -93,6 +161,37 @@ bool GLShader::init(const std::string &name,
 
     glGenVertexArrays(1, &mVertexArrayObject);
     mName = name;
+
+    // the binary of this program from an earlier run on the same driver
+    std::string cacheFile;
+    if (!programCacheDirectory.empty() && programBinaryApi.available()) {
+        uint64_t h = programBinaryApi.driver;
+        const std::string *sources[] = { &defines, &vertex_str, &fragment_str, &geometry_str };
+        for (const std::string *str : sources)
+            h = ProgramBinaryApi::hash(*str + '\0', h);
+        char key[17];
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long) h);
+        cacheFile = programCacheDirectory + "/" + name + "-" + key + ".bin";
+
+        std::ifstream in(cacheFile, std::ios::binary);
+        GLenum format = 0;
+        std::vector<char> binary((std::istreambuf_iterator<char>(in.rdbuf())), std::istreambuf_iterator<char>());
+        if (binary.size() > sizeof(GLenum)) {
+            memcpy(&format, binary.data(), sizeof(GLenum));
+            mProgramShader = glCreateProgram();
+            programBinaryApi.programBinary(mProgramShader, format, binary.data() + sizeof(GLenum),
+                                           (GLsizei) (binary.size() - sizeof(GLenum)));
+            GLint status = GL_FALSE;
+            glGetProgramiv(mProgramShader, GL_LINK_STATUS, &status);
+            // a driver update may reject the binary, it is compiled then
+            if (status == GL_TRUE)
+                return true;
+            glDeleteProgram(mProgramShader);
+            mProgramShader = 0;
+            while (glGetError() != GL_NO_ERROR) { }
+        }
+    }
+
     mVertexShader =
         createShader_helper(GL_VERTEX_SHADER, name, defines, vertex_str);
     mGeometryShader =
@@ -113,6 +212,8 @@ bool GLShader::init(const std::string &name,
     if (mGeometryShader)
         glAttachShader(mProgramShader, mGeometryShader);
 
+    if (!cacheFile.empty())
+        programBinaryApi.programParameteri(mProgramShader, PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(mProgramShader);
 
     GLint status;
@@ -126,6 +227,29 @@ bool GLShader::init(const std::string &name,
         throw std::runtime_error("Shader linking failed!");
     }
 
+    if (!cacheFile.empty()) {
+        GLint length = 0;
+        glGetProgramiv(mProgramShader, PROGRAM_BINARY_LENGTH, &length);
+        if (length > 0) {
+            std::vector<char> binary(sizeof(GLenum) + length);
+            GLenum format = 0;
+            programBinaryApi.getProgramBinary(mProgramShader, length, &length, &format,
+                                              binary.data() + sizeof(GLenum));
+            memcpy(binary.data(), &format, sizeof(GLenum));
+            // a reader never sees a partly written binary
+            const std::string temporary = cacheFile + ".tmp";
+            std::ofstream out(temporary, std::ios::binary);
+            out.write(binary.data(), (std::streamsize) (sizeof(GLenum) + length));
+            out.close();
+            if (out) {
+                std::remove(cacheFile.c_str());
+                std::rename(temporary.c_str(), cacheFile.c_str());
+            } else {
+                std::remove(temporary.c_str());
+            }
+        }
+    }
+
     return true;
 }
 
@@ -169,13 +293,21 @@ void GLShader::uploadAttrib(const std::string &name, uint32_t size, int dim,
     }
 
     GLuint bufferID;
+    bool reuseStorage = false;
     auto it = mBufferObjects.find(name);
     if (it != mBufferObjects.end()) {
         Buffer &buffer = it->second;
         bufferID = it->second.id;
+        /* Same layout and size: overwrite the existing storage in place
+           instead of reallocating it */
+        reuseStorage = buffer.size == size && buffer.compSize == compSize &&
+                       buffer.glType == glType && buffer.dim == (GLuint) dim &&
+                       size > 0;
         buffer.version = version;
         buffer.size = size;
         buffer.compSize = compSize;
+        buffer.glType = glType;
+        buffer.dim = dim;
     } else {
         glGenBuffers(1, &bufferID);
         Buffer buffer;
@@ -191,10 +323,16 @@ void GLShader::uploadAttrib(const std::string &name, uint32_t size, int dim,
 
     if (name == "indices") {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferID);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalSize, data, GL_DYNAMIC_DRAW);
+        if (reuseStorage)
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, totalSize, data);
+        else
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalSize, data, GL_DYNAMIC_DRAW);
     } else {
         glBindBuffer(GL_ARRAY_BUFFER, bufferID);
-        glBufferData(GL_ARRAY_BUFFER, totalSize, data, GL_DYNAMIC_DRAW);
+        if (reuseStorage)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, totalSize, data);
+        else
+            glBufferData(GL_ARRAY_BUFFER, totalSize, data, GL_DYNAMIC_DRAW);
         if (size == 0) {
             glDisableVertexAttribArray(attribID);
         } else {
@@ -204,6 +342,29 @@ void GLShader::uploadAttrib(const std::string &name, uint32_t size, int dim,
     }
 }
 
+bool GLShader::uploadAttribRange(const std::string &name, uint32_t offset, uint32_t size,
+                                 int dim, uint32_t compSize, GLuint glType, bool integral,
+                                 const uint8_t *data, int version) {
+    auto it = mBufferObjects.find(name);
+    if (name == "indices" || it == mBufferObjects.end())
+        return false;
+    Buffer &buffer = it->second;
+    if (buffer.compSize != compSize || buffer.glType != glType ||
+        buffer.dim != (GLuint) dim || offset + size > buffer.size)
+        return false;
+    int attribID = attrib(name);
+    if (attribID < 0)
+        return false;
+    buffer.version = version;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.id);
+    glBufferSubData(GL_ARRAY_BUFFER, (size_t) offset * compSize, (size_t) size * compSize, data);
+    /* The attribute may have been pointed at another buffer in between */
+    glEnableVertexAttribArray(attribID);
+    glVertexAttribPointer(attribID, dim, glType, integral, 0, 0);
+    return true;
+}
+
 void GLShader::downloadAttrib(const std::string &name, uint32_t size, int /* dim */,
                              uint32_t compSize, GLuint /* glType */, uint8_t *data) {
     auto it = mBufferObjects.find(name);
@@ -238,7 +399,10 @@ void GLShader::shareAttrib(const GLShader &otherShader, const std::string &name,
             return;
         glEnableVertexAttribArray(attribID);
         glBindBuffer(GL_ARRAY_BUFFER, buffer.id);
-        glVertexAttribPointer(attribID, buffer.dim, buffer.glType, buffer.compSize == 1 ? GL_TRUE : GL_FALSE, 0, 0);
+        /* Integer buffers are normalized, as in uploadAttrib() */
+        const bool integral = buffer.glType != GL_FLOAT && buffer.glType != GL_DOUBLE &&
+                              buffer.glType != GL_HALF_FLOAT;
+        glVertexAttribPointer(attribID, buffer.dim, buffer.glType, integral ? GL_TRUE : GL_FALSE, 0, 0);
     } else {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.id);
     }
@@ -0,0 +1,153 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Allocation_tracker.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+#ifdef SURFACE_MESH_ALLOCATION_TRACKING
+
+
+namespace {
+
+
+// the counts of one thread on a cache line of its own; the threads beyond
+// the last slot share it. No containers here, they would allocate.
+struct Slot
+{
+    std::atomic<long long>  allocations;
+    std::atomic<long long>  bytes;
+    char                    padding[64 - 2 * sizeof(std::atomic<long long>)];
+};
+
+const int         max_slots_ = 256;
+Slot              slots_[max_slots_];
+std::atomic<int>  n_slots_(0);
+
+
+Slot& thread_slot()
+{
+    static thread_local Slot* local = 0;
+    if (!local)
+    {
+        const int i = n_slots_.fetch_add(1, std::memory_order_relaxed);
+        local = &slots_[i < max_slots_ ? i : max_slots_ - 1];
+    }
+    return *local;
+}
+
+
+void* allocate(std::size_t size)
+{
+    Slot& slot = thread_slot();
+    slot.allocations.fetch_add(1, std::memory_order_relaxed);
+    slot.bytes.fetch_add((long long) size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Allocation_tracker::enabled() { return true; }
+
+
+//-----------------------------------------------------------------------------
+
+
+Allocation_tracker::Counts Allocation_tracker::read()
+{
+    Counts c;
+    int n = n_slots_.load(std::memory_order_relaxed);
+    if (n > max_slots_) n = max_slots_;
+    for (int i=0; i<n; ++i)
+    {
+        c.allocations += slots_[i].allocations.load(std::memory_order_relaxed);
+        c.bytes       += slots_[i].bytes.load(std::memory_order_relaxed);
+    }
+    return c;
+}
+
+
+#else
+
+
+bool Allocation_tracker::enabled() { return false; }
+
+Allocation_tracker::Counts Allocation_tracker::read() { return Counts(); }
+
+
+#endif
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+
+
+#ifdef SURFACE_MESH_ALLOCATION_TRACKING
+
+
+//== REPLACEMENT OPERATORS ====================================================
+
+
+// the nothrow and sized forms of the standard library call these
+
+
+void* operator new(std::size_t size)
+{
+    void* p = surface_mesh::allocate(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+
+void* operator new[](std::size_t size)
+{
+    void* p = surface_mesh::allocate(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return surface_mesh::allocate(size);
+}
+
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return surface_mesh::allocate(size);
+}
+
+
+void operator delete(void* p) noexcept   { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, const std::nothrow_t&) noexcept   { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+
+#endif
+
+
+//=============================================================================
@@ -0,0 +1,64 @@
+//=============================================================================
+#ifndef SURFACE_MESH_ALLOCATION_TRACKER_H
+#define SURFACE_MESH_ALLOCATION_TRACKER_H
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// Counts the allocations of operator new and new[] of the whole process,
+/// for hunting allocator churn in loops that should not allocate at all.
+/// The counting operators replace the global ones only when
+/// SURFACE_MESH_ALLOCATION_TRACKING is defined (cmake
+/// -DGP_ALLOCATION_TRACKING=ON); they call malloc() and free() and add a
+/// per-thread increment. Direct malloc() calls, e.g. Eigen's dense
+/// matrices, are not counted. Trace zones record the allocations over
+/// their interval, see Trace.
+class Allocation_tracker
+{
+public:
+
+    /// allocations and bytes requested since the start of the process, or
+    /// their difference
+    struct Counts
+    {
+        long long allocations;
+        long long bytes;
+
+        Counts() : allocations(0), bytes(0) {}
+
+        Counts operator-(const Counts& c) const
+        {
+            Counts d;
+            d.allocations = allocations - c.allocations;
+            d.bytes       = bytes - c.bytes;
+            return d;
+        }
+
+        Counts& operator+=(const Counts& c)
+        {
+            allocations += c.allocations;
+            bytes       += c.bytes;
+            return *this;
+        }
+    };
+
+    /// are the counting operators compiled in?
+    static bool enabled();
+
+    /// the counts of all threads, zero unless enabled()
+    static Counts read();
+};
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_ALLOCATION_TRACKER_H
+//=============================================================================
@@ -0,0 +1,274 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Block_reader.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#  include <fcntl.h>
+#  include <io.h>
+#  include <malloc.h>
+#  include <sys/stat.h>
+#else
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+// direct I/O needs buffers, offsets and lengths aligned to the logical
+// block size of the device, 4096 covers the common ones
+static const size_t block_alignment = 4096;
+
+
+static char* allocate_aligned(size_t n)
+{
+#if defined(_WIN32)
+    return (char*) _aligned_malloc(n, block_alignment);
+#else
+    void* p = 0;
+    return posix_memalign(&p, block_alignment, n) == 0 ? (char*) p : 0;
+#endif
+}
+
+
+static void free_aligned(char* p)
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+
+// read up to n bytes at offset, repeats short reads; bytes read or -1
+static long long read_at(int fd, char* buffer, size_t n, size_t offset, bool direct)
+{
+    size_t got = 0;
+    while (got < n)
+    {
+#if defined(_WIN32)
+        (void) direct;
+        if (_lseeki64(fd, (long long) (offset + got), SEEK_SET) < 0) return -1;
+        const int r = _read(fd, buffer + got, (unsigned int) std::min(n - got, size_t(1) << 30));
+#else
+        const ssize_t r = pread(fd, buffer + got, n - got, (off_t) (offset + got));
+#  if defined(O_DIRECT)
+        // the file system accepted O_DIRECT on open but not on read,
+        // continue through the page cache
+        if (r < 0 && errno == EINVAL && direct)
+        {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+            direct = false;
+            continue;
+        }
+#  endif
+#endif
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return -1;
+        if (r == 0) break;
+        got += (size_t) r;
+    }
+    return (long long) got;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Block_reader::
+Block_reader(size_t block_size)
+    : fd_(-1), direct_(false), size_(0),
+      block_size_(std::max(block_alignment,
+                           (block_size + block_alignment - 1) / block_alignment * block_alignment)),
+      offset_(0), consumed_(0), current_(0), pos_(0), end_(0), pending_(0)
+{
+    buffers_[0] = buffers_[1] = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Block_reader::
+~Block_reader()
+{
+    close();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Block_reader::
+open(const std::string& filename)
+{
+    close();
+
+#if defined(_WIN32)
+    fd_ = _open(filename.c_str(), _O_RDONLY | _O_BINARY | _O_SEQUENTIAL);
+    if (fd_ < 0) return false;
+    struct _stat64 st;
+    if (_fstat64(fd_, &st) != 0) { close(); return false; }
+#else
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) return false;
+    struct stat st;
+    if (fstat(fd_, &st) != 0) { close(); return false; }
+#endif
+    size_ = (size_t) st.st_size;
+
+#if defined(O_DIRECT)
+    // large files bypass the page cache, the file system may refuse
+    if (size_ >= direct_threshold)
+    {
+        const int fd = ::open(filename.c_str(), O_RDONLY | O_DIRECT);
+        if (fd >= 0)
+        {
+            ::close(fd_);
+            fd_ = fd;
+            direct_ = true;
+        }
+    }
+#endif
+
+    buffers_[0] = allocate_aligned(block_size_);
+    buffers_[1] = allocate_aligned(block_size_);
+    if (!buffers_[0] || !buffers_[1]) { close(); return false; }
+
+    // the first block goes to the back buffer, read() picks it up
+    current_ = 0;
+    start_read();
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Block_reader::
+close()
+{
+    if (thread_.joinable()) thread_.join();
+    if (fd_ >= 0)
+    {
+#if defined(_WIN32)
+        _close(fd_);
+#else
+        ::close(fd_);
+#endif
+    }
+    if (buffers_[0]) free_aligned(buffers_[0]);
+    if (buffers_[1]) free_aligned(buffers_[1]);
+    buffers_[0] = buffers_[1] = 0;
+    fd_       = -1;
+    direct_   = false;
+    size_     = 0;
+    offset_   = 0;
+    consumed_ = 0;
+    pos_ = end_ = 0;
+    pending_  = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Block_reader::
+start_read()
+{
+    if (offset_ >= size_) { pending_ = 0; return; }
+
+    char* buffer = buffers_[1 - current_];
+    const size_t offset = offset_;
+    offset_ += block_size_;
+    thread_ = std::thread([this, buffer, offset]()
+    {
+        pending_ = read_at(fd_, buffer, block_size_, offset, direct_);
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Block_reader::
+next_block()
+{
+    if (fd_ < 0) return false;
+    if (thread_.joinable()) thread_.join();
+    if (pending_ <= 0) return false;
+
+    current_ = 1 - current_;
+    pos_ = buffers_[current_];
+    end_ = pos_ + pending_;
+    start_read();
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Block_reader::
+read(void* dst, size_t n)
+{
+    char* out = (char*) dst;
+    while (n)
+    {
+        if (pos_ == end_ && !next_block()) return false;
+        const size_t k = std::min(n, size_t(end_ - pos_));
+        memcpy(out, pos_, k);
+        out += k;
+        pos_ += k;
+        consumed_ += k;
+        n -= k;
+    }
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Block_reader::
+skip(size_t n)
+{
+    while (n)
+    {
+        if (pos_ == end_ && !next_block()) return false;
+        const size_t k = std::min(n, size_t(end_ - pos_));
+        pos_ += k;
+        consumed_ += k;
+        n -= k;
+    }
+    return true;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
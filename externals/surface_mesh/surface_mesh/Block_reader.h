@@ -0,0 +1,93 @@
+//=============================================================================
+#ifndef SURFACE_MESH_BLOCK_READER_H
+#define SURFACE_MESH_BLOCK_READER_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <cstddef>
+#include <string>
+#include <thread>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// Sequential reader of a whole file for the binary mesh formats. The file
+/// is read in large blocks into two aligned buffers: while the caller
+/// copies out of one of them, a background thread reads the next block
+/// into the other. On Linux, files of at least \c direct_threshold bytes
+/// are opened with O_DIRECT and bypass the page cache, smaller ones and
+/// file systems without direct I/O use plain reads.
+class Block_reader
+{
+public:
+
+    /// files from this size on are read with direct I/O where supported
+    static const size_t direct_threshold = size_t(64) << 20;
+
+    explicit Block_reader(size_t block_size = size_t(4) << 20);
+    ~Block_reader();
+
+    /// open \c filename and start reading its first block
+    bool open(const std::string& filename);
+
+    /// wait for the pending read and close the file
+    void close();
+
+    /// size of the file in bytes
+    size_t size() const { return size_; }
+
+    /// bytes not yet read or skipped
+    size_t remaining() const { return size_ - consumed_; }
+
+    /// true if the file bypasses the page cache
+    bool is_direct() const { return direct_; }
+
+    /// copy the next \c n bytes to \c dst, false if the file ends first or
+    /// a read fails
+    bool read(void* dst, size_t n);
+
+    /// skip the next \c n bytes, false as read()
+    bool skip(size_t n);
+
+private:
+
+    Block_reader(const Block_reader&);
+    Block_reader& operator=(const Block_reader&);
+
+    // wait for the back buffer, make it current and start the next read
+    bool next_block();
+
+    // read the block at offset_ into the back buffer in the background
+    void start_read();
+
+    int          fd_;
+    bool         direct_;
+    size_t       size_;
+    size_t       block_size_;
+    size_t       offset_;     // file offset of the next block to read
+    size_t       consumed_;   // bytes handed out by read() and skip()
+
+    char*        buffers_[2];
+    int          current_;    // buffer parsed by the caller
+    const char*  pos_;        // next byte in the current buffer
+    const char*  end_;        // end of the data in the current buffer
+
+    std::thread  thread_;     // reads into buffers_[1-current_]
+    long long    pending_;    // bytes that read, -1 on an error
+};
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_BLOCK_READER_H
+//=============================================================================
@@ -0,0 +1,100 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Half.h>
+
+#include <string.h>
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#  include <immintrin.h>
+#  define SURFACE_MESH_F16C
+#endif
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+uint16_t
+Half::
+float_to_half(float f)
+{
+#ifdef SURFACE_MESH_F16C
+    return (uint16_t) _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const uint32_t a    = x & 0x7fffffff;
+
+    // infinity and NaN, which stays quiet
+    if (a >= 0x7f800000)
+        return (uint16_t) (sign | 0x7c00 | (a > 0x7f800000 ? 0x200 : 0));
+
+    // 65520 and more round to infinity
+    if (a >= 0x477ff000)
+        return (uint16_t) (sign | 0x7c00);
+
+    // below 2^-14 the result is subnormal, multiples of 2^-24
+    if (a < 0x38800000)
+    {
+        if (a <= 0x33000000) return (uint16_t) sign;
+        const uint32_t m     = (a & 0x7fffff) | 0x800000;
+        const int      shift = 126 - int(a >> 23);
+        uint32_t       r     = m >> shift;
+        const uint32_t rest  = m & ((1u << shift) - 1);
+        const uint32_t tie   = 1u << (shift - 1);
+        if (rest > tie || (rest == tie && (r & 1))) ++r;
+        return (uint16_t) (sign | r);
+    }
+
+    // rebias the exponent, a carry out of the mantissa increments it
+    uint32_t       r    = (a - 0x38000000) >> 13;
+    const uint32_t rest = a & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (r & 1))) ++r;
+    return (uint16_t) (sign | r);
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+float
+Half::
+half_to_float(uint16_t h)
+{
+#ifdef SURFACE_MESH_F16C
+    return _cvtsh_ss(h);
+#else
+    const uint32_t sign = uint32_t(h & 0x8000) << 16;
+    const uint32_t e    = (h >> 10) & 0x1f;
+    const uint32_t m    = h & 0x3ff;
+
+    if (e == 0)
+    {
+        // zero and subnormals, exact in float
+        const float f = float(m) * 5.9604644775390625e-8f;
+        return sign ? -f : f;
+    }
+
+    const uint32_t x = sign | (e == 0x1f ? 0x7f800000 | (m << 13)
+                                         : ((e + 112) << 23) | (m << 13));
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+#endif
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -0,0 +1,53 @@
+//=============================================================================
+#ifndef SURFACE_MESH_HALF_H
+#define SURFACE_MESH_HALF_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <stdint.h>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// IEEE 754 binary16 float for properties that need neither the range nor
+/// the precision of Scalar, e.g. derived values for display: half the size,
+/// about three significant digits. Converts to and from float implicitly,
+/// rounding to nearest even.
+class Half
+{
+public:
+
+    Half() : bits_(0) {}
+
+    Half(float f) : bits_(float_to_half(f)) {}
+
+    operator float() const { return half_to_float(bits_); }
+
+    /// the binary16 encoding
+    uint16_t bits() const { return bits_; }
+
+    /// conversion of one value, with the F16C instructions where the build
+    /// targets them
+    static uint16_t float_to_half(float f);
+    static float    half_to_float(uint16_t h);
+
+private:
+
+    uint16_t bits_;
+};
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_HALF_H
+//=============================================================================
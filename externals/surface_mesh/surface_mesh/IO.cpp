@@ -3,6 +3,7 @@
 //== INCLUDES =================================================================
 
 #include <surface_mesh/IO.h>
+#include <surface_mesh/Trace.h>
 
 #include <clocale>
 
@@ -16,8 +17,11 @@ namespace surface_mesh {
 //== IMPLEMENTATION ===========================================================
 
 
-bool read_mesh(Surface_mesh& mesh, const std::string& filename)
+bool read_mesh(Surface_mesh& mesh, const std::string& filename, Vertex_bounds* bounds,
+               unsigned int attributes)
 {
+    // the readers' own time is parsing, add_faces() shows up as "build"
+    SURFACE_MESH_TRACE_ZONE("parse");
     std::setlocale(LC_NUMERIC, "C");
 
     // clear mesh before reading from file
@@ -32,15 +36,27 @@ bool read_mesh(Surface_mesh& mesh, const std::string& filename)
     // extension determines reader
     if (ext == "off")
     {
-        return read_off(mesh, filename);
+        return read_off(mesh, filename, bounds);
     }
     else if (ext == "obj")
     {
-        return read_obj(mesh, filename);
+        return read_obj(mesh, filename, bounds, attributes);
     }
     else if (ext == "stl")
     {
-        return read_stl(mesh, filename);
+        return read_stl(mesh, filename, 0.0f, bounds);
+    }
+    else if (ext == "poly")
+    {
+        return read_poly(mesh, filename);
+    }
+    else if (ext == "ply")
+    {
+        return read_ply(mesh, filename, bounds, attributes);
+    }
+    else if (ext == "smc")
+    {
+        return read_smc(mesh, filename, bounds);
     }
 
     // we didn't find a reader module
@@ -53,6 +69,7 @@ bool read_mesh(Surface_mesh& mesh, const std::string& filename)
 
 bool write_mesh(const Surface_mesh& mesh, const std::string& filename)
 {
+    SURFACE_MESH_TRACE_ZONE("write");
     // extract file extension
     std::string::size_type dot(filename.rfind("."));
     if (dot == std::string::npos) return false;
@@ -69,6 +86,18 @@ bool write_mesh(const Surface_mesh& mesh, const std::string& filename)
     {
         return write_obj(mesh, filename);
     }
+    else if (ext == "poly")
+    {
+        return write_poly(mesh, filename);
+    }
+    else if (ext == "ply")
+    {
+        return write_ply(mesh, filename);
+    }
+    else if (ext == "smc")
+    {
+        return write_smc(mesh, filename);
+    }
 
     // we didn't find a writer module
     return false;
@@ -10,6 +10,7 @@
 #include <surface_mesh/Surface_mesh.h>
 
 #include <string>
+#include <vector>
 
 
 //== NAMESPACE ================================================================
@@ -21,14 +22,122 @@ namespace surface_mesh {
 //=============================================================================
 
 
-bool read_mesh(Surface_mesh& mesh, const std::string& filename);
-bool read_off(Surface_mesh& mesh, const std::string& filename);
-bool read_obj(Surface_mesh& mesh, const std::string& filename);
-bool read_stl(Surface_mesh& mesh, const std::string& filename);
+/// bounding box and centroid of the positions a reader added, accumulated
+/// while parsing so that they cost no pass over the vertices afterwards
+struct Vertex_bounds
+{
+    Point         min, max;
+    double        sum[3];
+    unsigned int  n;  ///< positions added, 0 if the reader does not track them
+
+    Vertex_bounds() : min(0.0f, 0.0f, 0.0f), max(0.0f, 0.0f, 0.0f), n(0)
+    {
+        sum[0] = sum[1] = sum[2] = 0.0;
+    }
+
+    void add(const Point& p)
+    {
+        if (n == 0) min = max = p;
+        min.minimize(p);
+        max.maximize(p);
+        for (int k = 0; k < 3; ++k) sum[k] += p[k];
+        ++n;
+    }
+
+    Point centroid() const
+    {
+        if (n == 0) return Point(0.0f, 0.0f, 0.0f);
+        return Point(float(sum[0] / n), float(sum[1] / n), float(sum[2] / n));
+    }
+};
+
+
+/// the optional attributes a reader loads besides the positions and the
+/// faces, or-ed together. Skipped attributes are still scanned over but no
+/// property is allocated for them, e.g. READ_GEOMETRY for meshes whose
+/// normals are computed again anyway.
+enum Read_attributes
+{
+    READ_GEOMETRY   = 0,
+    READ_NORMALS    = 1 << 0,  ///< PLY v:normal
+    READ_COLORS     = 1 << 1,  ///< PLY v:color
+    READ_TEX_COORDS = 1 << 2,  ///< OBJ h:texcoord, PLY v:texcoord
+    READ_EXTRA      = 1 << 3,  ///< the other scalar PLY vertex properties
+    READ_ALL        = (1 << 4) - 1
+};
+
+
+/// \c bounds, if given, receives the bounds of the vertices as they are
+/// read; read_poly() copies the arrays as a whole and leaves it empty.
+/// \c attributes are the Read_attributes of the OBJ and PLY readers.
+bool read_mesh(Surface_mesh& mesh, const std::string& filename,
+               Vertex_bounds* bounds = NULL, unsigned int attributes = READ_ALL);
+bool read_off(Surface_mesh& mesh, const std::string& filename,
+              Vertex_bounds* bounds = NULL);
+bool read_obj(Surface_mesh& mesh, const std::string& filename,
+              Vertex_bounds* bounds = NULL, unsigned int attributes = READ_ALL);
+
+/// corners closer than \c weld_tolerance share a vertex, 0 merges equal positions,
+/// see weld_positions()
+bool read_stl(Surface_mesh& mesh, const std::string& filename,
+              float weld_tolerance = 0.0f, Vertex_bounds* bounds = NULL);
+bool read_poly(Surface_mesh& mesh, const std::string& filename);
+/// read_poly() in constant time: the property arrays are left in a
+/// copy-on-write mapping of the file and paged in as they are accessed,
+/// processes mapping the same file share the pages they only read. An array
+/// is copied into memory of its own when it grows or shrinks, a written
+/// page alone when it is changed in place; the file itself never changes,
+/// but must not be truncated while the mesh uses it, write a new file and
+/// rename it over the old one instead. The arrays are 8 byte aligned, not
+/// 64 as allocated ones. Needs SURFACE_MESH_MAPPED_STORAGE, read_poly() is
+/// called without it and for files in the legacy layout.
+bool map_poly(Surface_mesh& mesh, const std::string& filename);
+/// read_poly() from \c size bytes at \c src, as written by the overload of
+/// write_poly() below. false for the legacy layout.
+bool read_poly(Surface_mesh& mesh, const char* src, size_t size);
+bool read_ply(Surface_mesh& mesh, const std::string& filename,
+              Vertex_bounds* bounds = NULL, unsigned int attributes = READ_ALL);
+bool read_smc(Surface_mesh& mesh, const std::string& filename,
+              Vertex_bounds* bounds = NULL);
+/// read_smc() from \c size bytes at \c src
+bool read_smc(Surface_mesh& mesh, const char* src, size_t size,
+              Vertex_bounds* bounds = NULL);
 
 bool write_mesh(const Surface_mesh& mesh, const std::string& filename);
 bool write_off(const Surface_mesh& mesh, const std::string& filename);
+/// OFF BINARY in the native byte order, as read_off() reads it
+bool write_off_binary(const Surface_mesh& mesh, const std::string& filename);
 bool write_obj(const Surface_mesh& mesh, const std::string& filename);
+bool write_poly(const Surface_mesh& mesh, const std::string& filename);
+/// the poly file into \c capacity bytes at \c dst. returns the size it
+/// needs, nothing is complete if that exceeds \c capacity.
+size_t write_poly(const Surface_mesh& mesh, char* dst, size_t capacity);
+bool write_ply(const Surface_mesh& mesh, const std::string& filename);
+/// the elements write_arrow() writes a row for
+enum Arrow_rows { ARROW_VERTICES, ARROW_HALFEDGES, ARROW_EDGES, ARROW_FACES };
+/// the \c properties of the elements \c rows of \c mesh as the columns of
+/// an Apache Arrow IPC file (Feather V2), every property of a supported
+/// type if \c properties is empty. row i is element i, deleted ones
+/// included. the property arrays are written as they are, without a copy:
+/// float, double and Half as floating point, int, unsigned int and unsigned
+/// char as integers, handles as signed indices (-1 if invalid), the Vector
+/// types as fixed size lists; only bool is packed into bits. false if a
+/// property does not exist or has none of these types, or the file cannot
+/// be written.
+bool write_arrow(const Surface_mesh& mesh, const std::string& filename,
+                 Arrow_rows rows = ARROW_VERTICES,
+                 const std::vector<std::string>& properties = std::vector<std::string>());
+/// compressed triangle mesh: Edgebreaker connectivity and positions on a
+/// grid of 2^bits cells along the longest side of the bounding box,
+/// parallelogram predicted, range coded unless \c entropy_coded is false.
+/// only positions are kept, the vertices come back in traversal order,
+/// polygons triangulated and a vertex with several fans of faces split.
+/// false for an edge with more than two faces.
+bool write_smc(const Surface_mesh& mesh, const std::string& filename,
+               unsigned int bits = 14, bool entropy_coded = true);
+/// write_smc() into \c out, which is replaced
+bool write_smc(const Surface_mesh& mesh, std::vector<unsigned char>& out,
+               unsigned int bits = 14, bool entropy_coded = true);
 
 
 //=============================================================================
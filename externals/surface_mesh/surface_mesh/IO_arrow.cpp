@@ -0,0 +1,554 @@
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/IO.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+//== NAMESPACES ===============================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+// Layout of an Arrow IPC file, see the Arrow columnar format specification:
+//
+//   char[8]     magic "ARROW1\0\0"
+//   message     the schema, one field per property
+//   message     one record batch of all rows
+//   uint32[2]   end of stream 0xffffffff, 0
+//   footer      the schema again and where the record batch is
+//   int32       size of the footer
+//   char[6]     magic "ARROW1"
+//
+// A message is the marker 0xffffffff, the int32 size of its metadata, the
+// metadata as a flatbuffer padded so that the body starts 64 byte aligned,
+// and the body with the buffers of the columns, each padded to 64 bytes.
+// The flatbuffers are built by the few lines below, every table is written
+// before the objects it refers to, so all offsets point forward. The
+// buffers of the columns are the property arrays, written as they are.
+
+
+static const char        arrow_magic[8] = { 'A','R','R','O','W','1','\0','\0' };
+static const size_t      arrow_alignment = 64;
+// MetadataVersion V5
+static const int16_t     arrow_version = 4;
+
+
+//-----------------------------------------------------------------------------
+
+
+// a flatbuffer under construction
+struct Flat_buffer
+{
+    std::vector<unsigned char> bytes;
+
+    size_t align(size_t n)
+    {
+        bytes.resize((bytes.size() + n - 1) / n * n, 0);
+        return bytes.size();
+    }
+
+    template <class T> size_t put(const T& value)
+    {
+        const size_t at = align(sizeof(T));
+        bytes.resize(at + sizeof(T));
+        memcpy(&bytes[at], &value, sizeof(T));
+        return at;
+    }
+
+    // the uoffset at position at refers to target
+    void refer(size_t at, size_t target)
+    {
+        const uint32_t offset = (uint32_t) (target - at);
+        memcpy(&bytes[at], &offset, sizeof(offset));
+    }
+};
+
+
+// writes an object into the buffer, returns its position
+typedef std::function<size_t(Flat_buffer&)> Flat_object;
+
+
+// a table of scalars and offsets to objects, which are written after it
+class Flat_table
+{
+public:
+
+    template <class T> Flat_table& scalar(int id, T value)
+    {
+        Field field;
+        field.id   = id;
+        field.size = sizeof(T);
+        memcpy(field.bits, &value, sizeof(T));
+        fields_.push_back(field);
+        return *this;
+    }
+
+    Flat_table& object(int id, const Flat_object& object)
+    {
+        Field field;
+        field.id     = id;
+        field.size   = sizeof(uint32_t);
+        field.object = object;
+        fields_.push_back(field);
+        return *this;
+    }
+
+    // the vtable, then the table, then the objects; returns the table
+    size_t write(Flat_buffer& buffer) const
+    {
+        // the fields largest first after the vtable offset, aligned to
+        // their size from a table start aligned to 8
+        std::vector<size_t> offsets(fields_.size());
+        size_t size = sizeof(int32_t);
+        int    ids  = 0;
+        for (size_t s = 8; s > 0; s /= 2)
+            for (size_t i = 0; i < fields_.size(); ++i)
+                if (fields_[i].size == s)
+                {
+                    offsets[i] = size;
+                    size += s;
+                }
+        for (size_t i = 0; i < fields_.size(); ++i)
+            ids = std::max(ids, fields_[i].id + 1);
+
+        std::vector<uint16_t> vtable(2 + ids, 0);
+        vtable[0] = (uint16_t) (sizeof(uint16_t) * vtable.size());
+        vtable[1] = (uint16_t) size;
+        for (size_t i = 0; i < fields_.size(); ++i)
+            vtable[2 + fields_[i].id] = (uint16_t) offsets[i];
+        const size_t vtable_at = buffer.align(sizeof(uint16_t));
+        for (size_t i = 0; i < vtable.size(); ++i)
+            buffer.put(vtable[i]);
+
+        const size_t table = buffer.align(8);
+        buffer.put((int32_t) (table - vtable_at));
+        buffer.bytes.resize(table + size, 0);
+        for (size_t i = 0; i < fields_.size(); ++i)
+            if (!fields_[i].object)
+                memcpy(&buffer.bytes[table + offsets[i]], fields_[i].bits, fields_[i].size);
+
+        for (size_t i = 0; i < fields_.size(); ++i)
+            if (fields_[i].object)
+                buffer.refer(table + offsets[i], fields_[i].object(buffer));
+        return table;
+    }
+
+private:
+
+    struct Field
+    {
+        int           id;
+        size_t        size;
+        unsigned char bits[8];
+        Flat_object   object;
+    };
+
+    std::vector<Field> fields_;
+};
+
+
+static Flat_object flat_string(const std::string& text)
+{
+    return [text](Flat_buffer& buffer)
+    {
+        const size_t at = buffer.put((uint32_t) text.size());
+        buffer.bytes.insert(buffer.bytes.end(), text.begin(), text.end());
+        buffer.bytes.push_back(0);
+        return at;
+    };
+}
+
+
+static Flat_object flat_tables(const std::vector<Flat_table>& tables)
+{
+    return [tables](Flat_buffer& buffer)
+    {
+        const size_t at = buffer.put((uint32_t) tables.size());
+        buffer.bytes.resize(at + sizeof(uint32_t) * (1 + tables.size()), 0);
+        for (size_t i = 0; i < tables.size(); ++i)
+            buffer.refer(at + sizeof(uint32_t) * (1 + i), tables[i].write(buffer));
+        return at;
+    };
+}
+
+
+// a vector of structs of 8 byte alignment, given by their bytes
+static Flat_object flat_structs(const std::vector<int64_t>& words, size_t count)
+{
+    return [words, count](Flat_buffer& buffer)
+    {
+        while ((buffer.bytes.size() + sizeof(uint32_t)) % 8) buffer.bytes.push_back(0);
+        const size_t at = buffer.put((uint32_t) count);
+        const unsigned char* p = (const unsigned char*) words.data();
+        buffer.bytes.insert(buffer.bytes.end(), p, p + sizeof(int64_t) * words.size());
+        return at;
+    };
+}
+
+
+// the buffer with a root table
+static Flat_buffer flat_root(const Flat_table& root)
+{
+    Flat_buffer buffer;
+    buffer.put((uint32_t) 0);
+    buffer.refer(0, root.write(buffer));
+    buffer.align(8);
+    return buffer;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// tags of the Type union of the Arrow schema
+enum Arrow_type { ARROW_INT = 2, ARROW_FLOATING_POINT = 3, ARROW_BOOL = 6,
+                  ARROW_FIXED_SIZE_LIST = 16 };
+
+
+// the type of a column, or of the values of a fixed size list
+struct Arrow_value
+{
+    unsigned char type;
+    Flat_table    table;
+};
+
+
+static Arrow_value arrow_int(int bits, bool is_signed)
+{
+    Arrow_value value = { ARROW_INT, Flat_table() };
+    value.table.scalar(0, (int32_t) bits).scalar(1, (uint8_t) is_signed);
+    return value;
+}
+
+
+// precision 0 half, 1 single, 2 double
+static Arrow_value arrow_float(int16_t precision)
+{
+    Arrow_value value = { ARROW_FLOATING_POINT, Flat_table() };
+    value.table.scalar(0, precision);
+    return value;
+}
+
+
+template <class T> struct Arrow_traits;
+template <> struct Arrow_traits<float>         { static Arrow_value value() { return arrow_float(1); } };
+template <> struct Arrow_traits<double>        { static Arrow_value value() { return arrow_float(2); } };
+template <> struct Arrow_traits<Half>          { static Arrow_value value() { return arrow_float(0); } };
+template <> struct Arrow_traits<int>           { static Arrow_value value() { return arrow_int(32, true); } };
+template <> struct Arrow_traits<unsigned int>  { static Arrow_value value() { return arrow_int(32, false); } };
+template <> struct Arrow_traits<unsigned char> { static Arrow_value value() { return arrow_int(8, false); } };
+
+
+// a column: its type and the bytes of its values
+struct Arrow_column
+{
+    std::string                name;
+    // the type of the column, of the list items if list_size > 0
+    Arrow_value                value;
+    int                        list_size;
+    // the property array
+    const void*                data;
+    size_t                     bytes;
+};
+
+
+template <class T> void arrow_fill(Arrow_column& column, const Property_vector<T>& values)
+{
+    column.value     = Arrow_traits<T>::value();
+    column.list_size = 0;
+    column.data      = values.data();
+    column.bytes     = sizeof(T) * values.size();
+}
+
+
+template <class S, int N>
+void arrow_fill(Arrow_column& column, const Property_vector< Vector<S,N> >& values)
+{
+    static_assert(sizeof(Vector<S,N>) == N * sizeof(S), "Vector is not packed");
+    column.value     = Arrow_traits<S>::value();
+    column.list_size = N;
+    column.data      = values.data();
+    column.bytes     = sizeof(Vector<S,N>) * values.size();
+}
+
+
+// handles as their signed indices, invalid ones are -1
+template <class H> void arrow_fill_handles(Arrow_column& column, const Property_vector<H>& values)
+{
+    static_assert(sizeof(H) == sizeof(Index_type), "handle is not an index");
+    column.value     = arrow_int(8 * sizeof(Index_type), true);
+    column.list_size = 0;
+    column.data      = values.data();
+    column.bytes     = sizeof(H) * values.size();
+}
+
+static void arrow_fill(Arrow_column& c, const Property_vector<Surface_mesh::Vertex>& v)   { arrow_fill_handles(c, v); }
+static void arrow_fill(Arrow_column& c, const Property_vector<Surface_mesh::Halfedge>& v) { arrow_fill_handles(c, v); }
+static void arrow_fill(Arrow_column& c, const Property_vector<Surface_mesh::Edge>& v)     { arrow_fill_handles(c, v); }
+static void arrow_fill(Arrow_column& c, const Property_vector<Surface_mesh::Face>& v)     { arrow_fill_handles(c, v); }
+
+
+// the words of a Bit_vector are the bits of an Arrow boolean column on a
+// little-endian host, like the other columns are written as they are
+static void arrow_fill(Arrow_column& column, const Bit_vector& values)
+{
+    column.value     = Arrow_value { ARROW_BOOL, Flat_table() };
+    column.list_size = 0;
+    column.data      = values.words();
+    column.bytes     = (values.size() + 7) / 8;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+inline size_t arrow_padded(size_t n)
+{
+    return (n + arrow_alignment - 1) / arrow_alignment * arrow_alignment;
+}
+
+
+static Flat_table arrow_field(const std::string& name, const Arrow_value& value,
+                              const std::vector<Flat_table>& children)
+{
+    const Flat_table type = value.table;
+    Flat_table field;
+    field.object(0, flat_string(name))
+         .scalar(1, (uint8_t) 0)
+         .scalar(2, (uint8_t) value.type)
+         .object(3, [type](Flat_buffer& buffer) { return type.write(buffer); })
+         .object(5, flat_tables(children));
+    return field;
+}
+
+
+static Flat_table arrow_schema(const std::vector<Arrow_column>& columns)
+{
+    std::vector<Flat_table> fields;
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        const Arrow_column& c = columns[i];
+        if (c.list_size == 0)
+        {
+            fields.push_back(arrow_field(c.name, c.value, std::vector<Flat_table>()));
+            continue;
+        }
+        Arrow_value list = { ARROW_FIXED_SIZE_LIST, Flat_table() };
+        list.table.scalar(0, (int32_t) c.list_size);
+        const std::vector<Flat_table> item(1, arrow_field("item", c.value, std::vector<Flat_table>()));
+        fields.push_back(arrow_field(c.name, list, item));
+    }
+
+    const uint16_t probe = 1;
+    const int16_t  endianness = *(const unsigned char*) &probe ? 0 : 1;
+    Flat_table schema;
+    schema.scalar(0, endianness).object(1, flat_tables(fields));
+    return schema;
+}
+
+
+// a message of header type 1 schema or 3 record batch
+static Flat_buffer arrow_message(uint8_t type, const Flat_table& header, int64_t body)
+{
+    Flat_table message;
+    message.scalar(0, arrow_version)
+           .scalar(1, type)
+           .object(2, [header](Flat_buffer& buffer) { return header.write(buffer); })
+           .scalar(3, body);
+    return flat_root(message);
+}
+
+
+// where the file is written and how far
+struct Arrow_output
+{
+    explicit Arrow_output(FILE* out) : out_(out), at_(0) {}
+
+    void write(const void* data, size_t n)
+    {
+        if (n) fwrite(data, 1, n, out_);
+        at_ += n;
+    }
+
+    void pad(size_t n)
+    {
+        static const char zeros[arrow_alignment] = { 0 };
+        while (n > 0)
+        {
+            const size_t k = std::min(n, arrow_alignment);
+            write(zeros, k);
+            n -= k;
+        }
+    }
+
+    // marker, size and metadata padded so that a body starts aligned;
+    // returns the length of all three
+    size_t message(const Flat_buffer& metadata)
+    {
+        const size_t begin = at_;
+        const size_t end   = arrow_padded(begin + 2 * sizeof(int32_t) + metadata.bytes.size());
+        const uint32_t prefix[2] = { 0xffffffffu,
+                                     (uint32_t) (end - begin - 2 * sizeof(int32_t)) };
+        write(prefix, sizeof(prefix));
+        write(metadata.bytes.data(), metadata.bytes.size());
+        pad(end - at_);
+        return end - begin;
+    }
+
+    FILE*  out_;
+    size_t at_;
+};
+
+
+// the writer of write_arrow(), a friend of Surface_mesh
+class Arrow_writer
+{
+public:
+
+    static bool write(const Surface_mesh& mesh, const std::string& filename, Arrow_rows rows,
+                      const std::vector<std::string>& properties)
+    {
+        // the containers are only read from
+        Surface_mesh& m = const_cast<Surface_mesh&>(mesh);
+        Property_container* containers[4] = { &m.vprops_, &m.hprops_, &m.eprops_, &m.fprops_ };
+        Property_container& props = *containers[rows];
+
+        // every property of a supported type, or exactly those asked for
+        const bool all = properties.empty();
+        const std::vector<std::string> names = all ? props.properties() : properties;
+        std::vector<Arrow_column> columns;
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            Arrow_column column;
+            column.name = names[i];
+            if (fill(props, column)) columns.push_back(column);
+            else if (!all)
+            {
+                std::cerr << "[write_arrow] property " << names[i]
+                          << (props.get_type(names[i]) == typeid(void) ? " does not exist"
+                                                                       : " has no Arrow type")
+                          << std::endl;
+                return false;
+            }
+        }
+        const size_t n = props.size();
+
+        // the buffers of the columns in the body, in the order of the
+        // fields and their children; no nulls, so empty validity bitmaps
+        std::vector<int64_t> nodes, buffers;
+        size_t body = 0;
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            const Arrow_column& c = columns[i];
+            const size_t sizes[3] = { 0, 0, c.bytes };
+            nodes.push_back((int64_t) n);
+            nodes.push_back(0);
+            if (c.list_size > 0)
+            {
+                nodes.push_back((int64_t) (n * c.list_size));
+                nodes.push_back(0);
+            }
+            for (int j = c.list_size > 0 ? 0 : 1; j < 3; ++j)
+            {
+                buffers.push_back((int64_t) body);
+                buffers.push_back((int64_t) sizes[j]);
+                body += arrow_padded(sizes[j]);
+            }
+        }
+
+        FILE* out = fopen(filename.c_str(), "wb");
+        if (!out) return false;
+        Arrow_output output(out);
+        output.write(arrow_magic, sizeof(arrow_magic));
+
+        const Flat_table schema = arrow_schema(columns);
+        output.message(arrow_message(1, schema, 0));
+
+        Flat_table batch;
+        batch.scalar(0, (int64_t) n)
+             .object(1, flat_structs(nodes, nodes.size() / 2))
+             .object(2, flat_structs(buffers, buffers.size() / 2));
+        const int64_t block_offset = (int64_t) output.at_;
+        const size_t  metadata = output.message(arrow_message(3, batch, (int64_t) body));
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            const Arrow_column& c = columns[i];
+            output.write(c.data, c.bytes);
+            output.pad(arrow_padded(c.bytes) - c.bytes);
+        }
+        const uint32_t end_of_stream[2] = { 0xffffffffu, 0 };
+        output.write(end_of_stream, sizeof(end_of_stream));
+
+        // Block: offset, int32 metadata length padded to 8, body length
+        std::vector<int64_t> block(3);
+        block[0] = block_offset;
+        const int32_t length = (int32_t) metadata;
+        memcpy(&block[1], &length, sizeof(length));
+        block[2] = (int64_t) body;
+        Flat_table footer;
+        footer.scalar(0, arrow_version)
+              .object(1, [schema](Flat_buffer& buffer) { return schema.write(buffer); })
+              .object(2, flat_structs(std::vector<int64_t>(), 0))
+              .object(3, flat_structs(block, 1));
+        const Flat_buffer footer_buffer = flat_root(footer);
+        output.write(footer_buffer.bytes.data(), footer_buffer.bytes.size());
+        const int32_t footer_size = (int32_t) footer_buffer.bytes.size();
+        output.write(&footer_size, sizeof(footer_size));
+        output.write(arrow_magic, 6);
+
+        const bool ok = !ferror(out);
+        fclose(out);
+        return ok;
+    }
+
+private:
+
+    template <class T> static bool fill_as(Property_container& props, Arrow_column& column)
+    {
+        if (props.get_type(column.name) != typeid(T)) return false;
+        arrow_fill(column, props.get<T>(column.name).vector());
+        return true;
+    }
+
+    static bool fill(Property_container& props, Arrow_column& column)
+    {
+        return fill_as<float>(props, column)         || fill_as<double>(props, column)       ||
+               fill_as<Half>(props, column)          || fill_as<int>(props, column)          ||
+               fill_as<unsigned int>(props, column)  || fill_as<unsigned char>(props, column)||
+               fill_as<bool>(props, column)          || fill_as<Vec2f>(props, column)        ||
+               fill_as<Vec3f>(props, column)         || fill_as<Vec4f>(props, column)        ||
+               fill_as<Vec3d>(props, column)         || fill_as<Color8>(props, column)       ||
+               fill_as<Surface_mesh::Vertex>(props, column)   ||
+               fill_as<Surface_mesh::Halfedge>(props, column) ||
+               fill_as<Surface_mesh::Edge>(props, column)     ||
+               fill_as<Surface_mesh::Face>(props, column);
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+bool write_arrow(const Surface_mesh& mesh, const std::string& filename, Arrow_rows rows,
+                 const std::vector<std::string>& properties)
+{
+    return Arrow_writer::write(mesh, filename, rows, properties);
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -0,0 +1,161 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/IO_async.h>
+#include <surface_mesh/Threads.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+
+// threads taking tasks in the order they were queued, started on first
+// use and joined at exit once the queue is empty
+class Io_pool
+{
+public:
+
+    static Io_pool& instance()
+    {
+        static Io_pool pool;
+        return pool;
+    }
+
+    void set_size(unsigned int n)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (threads_.empty()) size_ = std::max(n, 1u);
+    }
+
+    std::future<bool> submit(const std::function<bool()>& task)
+    {
+        // a packaged_task cannot be copied into a std::function
+        std::shared_ptr< std::packaged_task<bool()> > job =
+            std::make_shared< std::packaged_task<bool()> >(task);
+        std::future<bool> result = job->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (threads_.empty()) start();
+            queue_.push_back([job]() { (*job)(); });
+        }
+        wake_.notify_one();
+        return result;
+    }
+
+    ~Io_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (size_t i = 0; i < threads_.size(); ++i) threads_[i].join();
+    }
+
+private:
+
+    Io_pool() : size_(worker_threads()), stop_(false) {}
+
+    // called with mutex_ held
+    void start()
+    {
+        const int share = std::max(int(worker_threads() / size_), 1);
+        for (unsigned int i = 0; i < size_; ++i)
+            threads_.push_back(std::thread(&Io_pool::run, this, share));
+    }
+
+    void run(int omp_threads)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(omp_threads);
+#else
+        (void) omp_threads;
+#endif
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (!stop_ && queue_.empty()) wake_.wait(lock);
+                if (queue_.empty()) return;
+                task.swap(queue_.front());
+                queue_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex                          mutex_;
+    std::condition_variable             wake_;
+    std::deque< std::function<void()> > queue_;
+    std::vector<std::thread>            threads_;
+    unsigned int                        size_;
+    bool                                stop_;
+};
+
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+std::future<bool> read_mesh_async(Surface_mesh& mesh, const std::string& filename,
+                                  Vertex_bounds* bounds, unsigned int attributes)
+{
+    Surface_mesh* m = &mesh;
+    return Io_pool::instance().submit([m, filename, bounds, attributes]()
+    {
+        return read_mesh(*m, filename, bounds, attributes);
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+std::future<bool> write_mesh_async(const Surface_mesh& mesh, const std::string& filename)
+{
+    const Surface_mesh* m = &mesh;
+    return Io_pool::instance().submit([m, filename]()
+    {
+        return write_mesh(*m, filename);
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void set_io_threads(unsigned int n)
+{
+    Io_pool::instance().set_size(n);
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
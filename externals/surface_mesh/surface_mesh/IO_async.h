@@ -0,0 +1,47 @@
+//=============================================================================
+#ifndef SURFACE_MESH_IO_ASYNC_H
+#define SURFACE_MESH_IO_ASYNC_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/IO.h>
+
+#include <future>
+#include <string>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//=============================================================================
+
+
+/// read_mesh() on a pool of I/O threads, so that one caller keeps several
+/// loads in flight instead of blocking in each of them. The future becomes
+/// ready with the result of read_mesh(); \c mesh and \c bounds must stay
+/// alive and untouched until then. The readers parse in parallel, every
+/// pool thread runs them on its share of the OpenMP threads so that
+/// concurrent loads do not oversubscribe the cores.
+std::future<bool> read_mesh_async(Surface_mesh& mesh, const std::string& filename,
+                                  Vertex_bounds* bounds = NULL,
+                                  unsigned int attributes = READ_ALL);
+
+/// write_mesh() on the pool of read_mesh_async(), \c mesh must not change
+/// until the future is ready
+std::future<bool> write_mesh_async(const Surface_mesh& mesh, const std::string& filename);
+
+/// the number of pool threads, worker_threads() by default. The pool
+/// is started by the first asynchronous call, later calls have no effect.
+void set_io_threads(unsigned int n);
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_IO_ASYNC_H
+//=============================================================================
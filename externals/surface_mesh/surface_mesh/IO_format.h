@@ -0,0 +1,216 @@
+//=============================================================================
+#ifndef SURFACE_MESH_IO_FORMAT_H
+#define SURFACE_MESH_IO_FORMAT_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+// Locale independent number formatting for the writers, the counterpart of
+// IO_parse.h. The format_* functions write to p, which must have room for
+// the max_*_chars below, and return one past the last character written.
+
+
+/// characters format_int() writes at most
+const int max_int_chars = 11;
+
+/// characters format_float() writes at most, e.g. -0.0000123456789
+const int max_float_chars = 16;
+
+
+/// decimal digits of value
+inline char* format_uint(char* p, unsigned int value)
+{
+    char digits[10];
+    int  n = 0;
+    do { digits[n++] = char('0' + value % 10); value /= 10; } while (value);
+    while (n) *p++ = digits[--n];
+    return p;
+}
+
+
+/// decimal digits of value with a leading '-' if negative
+inline char* format_int(char* p, int value)
+{
+    if (value < 0)
+    {
+        *p++ = '-';
+        return format_uint(p, 0u - (unsigned int) value);
+    }
+    return format_uint(p, (unsigned int) value);
+}
+
+
+/// v * 10^e, correctly rounded for |e| <= 22
+inline double scale_by_power_of_ten(double v, int e)
+{
+    static const double powers[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                     1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                     1e18, 1e19, 1e20, 1e21, 1e22 };
+    if (e >= 0 && e <= 22)  return v * powers[e];
+    if (e < 0 && e >= -22)  return v / powers[-e];
+    return v * std::pow(10.0, e);
+}
+
+
+/// the shortest decimal that reads back as value, in fixed notation for
+/// magnitudes in [1e-5, 1e9) and in scientific notation otherwise.
+///
+/// The candidates with 6, 7 and 8 significant digits are tried in turn, the
+/// first that lies inside the rounding interval of value is taken, 9 digits
+/// always are. A normal float interval is narrower than the spacing of
+/// 6-digit decimals, so no shorter decimal is missed; subnormals start at 1. Candidates are only accepted
+/// well inside the interval, so that parse_float() rounding through double
+/// and a correctly rounding strtof() both get value back; the rare decimal
+/// at the very edge of the interval costs a digit more than necessary.
+inline char* format_float(char* p, float value)
+{
+    if (value != value)
+    {
+        memcpy(p, "nan", 3);
+        return p + 3;
+    }
+    if (std::signbit(value)) { *p++ = '-'; value = -value; }
+    if (value == 0.0f) { *p++ = '0'; return p; }
+    if (value > 3.40282347e38f)
+    {
+        memcpy(p, "inf", 3);
+        return p + 3;
+    }
+
+    // rounding interval (lo, hi) of value, exact in double
+    const double a    = value;
+    const double down = std::nextafter(value, 0.0f);
+    const double up   = value < 3.40282347e38f ? (double) std::nextafter(value, HUGE_VALF)
+                                               : a + (a - down);
+    const double margin = a * (1.0 / 281474976710656.0); // 2^-48
+    const double lo = 0.5 * (down + a) + margin;
+    const double hi = 0.5 * (a + up) - margin;
+
+    // decimal exponent of the leading digit, or one less
+    int e2;
+    std::frexp(a, &e2);
+    const int e10_low = (int) std::floor((e2 - 1) * 0.30102999566398120);
+
+    static const double limits[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    unsigned int digits = 0;
+    int          e10    = 0;
+    int          n      = value < 1.17549435e-38f ? 1 : 6;
+    for (;; ++n)
+    {
+        e10 = e10_low;
+        const double limit = limits[n];
+        double scaled = scale_by_power_of_ten(a, n - 1 - e10);
+        if (scaled + 0.5 >= limit)
+        {
+            // value >= 10^(e10+1), or it rounds up to it
+            ++e10;
+            scaled = scale_by_power_of_ten(a, n - 1 - e10);
+        }
+        digits = (unsigned int) (scaled + 0.5);
+        if (n == 9) break;
+        const double candidate = scale_by_power_of_ten((double) digits, e10 - n + 1);
+        if (candidate > lo && candidate < hi) break;
+    }
+
+    // significant digits without the trailing zeros
+    char text[10];
+    char* end = format_uint(text, digits);
+    while (end > text + 1 && end[-1] == '0') --end;
+    const int count = int(end - text);
+
+    if (e10 >= -5 && e10 < 0)
+    {
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = -1; i > e10; --i) *p++ = '0';
+        memcpy(p, text, count);
+        p += count;
+    }
+    else if (e10 >= 0 && e10 < 9)
+    {
+        for (int i = 0; i <= e10; ++i) *p++ = i < count ? text[i] : '0';
+        if (count > e10 + 1)
+        {
+            *p++ = '.';
+            memcpy(p, text + e10 + 1, count - e10 - 1);
+            p += count - e10 - 1;
+        }
+    }
+    else
+    {
+        *p++ = text[0];
+        if (count > 1)
+        {
+            *p++ = '.';
+            memcpy(p, text + 1, count - 1);
+            p += count - 1;
+        }
+        *p++ = 'e';
+        p = format_int(p, e10);
+    }
+    return p;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Formats the elements [0, n) in chunks of chunk_size and writes the chunks
+/// to out in order. format(begin, end, text) appends the output of the
+/// elements [begin, end) to text; with OpenMP it runs on several chunks at a
+/// time, so it may only read shared state. Chunks are written one fwrite
+/// each, unbuffered streams thus get a few large writes.
+template <typename Format>
+bool write_chunks(FILE* out, size_t n, size_t chunk_size, Format format)
+{
+    // formatted chunks held in memory at a time
+    const size_t round = 64;
+
+    const size_t n_chunks = (n + chunk_size - 1) / chunk_size;
+    std::vector<std::string> texts(std::min(round, n_chunks));
+    for (size_t first = 0; first < n_chunks; first += round)
+    {
+        const int count = (int) std::min(round, n_chunks - first);
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int i = 0; i < count; ++i)
+        {
+            const size_t begin = (first + i) * chunk_size;
+            texts[i].clear();
+            format(begin, std::min(begin + chunk_size, n), texts[i]);
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (fwrite(texts[i].data(), 1, texts[i].size(), out) != texts[i].size())
+                return false;
+        }
+    }
+    return true;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_IO_FORMAT_H
+//=============================================================================
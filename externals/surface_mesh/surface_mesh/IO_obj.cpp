@@ -3,8 +3,15 @@
 //== INCLUDES =================================================================
 
 #include <surface_mesh/IO.h>
+#include <surface_mesh/IO_parse.h>
+#include <surface_mesh/IO_format.h>
+#include <surface_mesh/Mapped_file.h>
 
 #include <cstdio>
+#include <vector>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
 
 
 //== NAMESPACES ===============================================================
@@ -16,159 +23,245 @@ namespace surface_mesh {
 //== IMPLEMENTATION ===========================================================
 
 
-bool read_obj(Surface_mesh& mesh, const std::string& filename)
+// records of a line-aligned part of an OBJ file
+struct Obj_chunk
 {
-    char   s[200];
-    float  x, y, z;
-    std::vector<Surface_mesh::Vertex>  vertices;
-    std::vector<Texture_coordinate> all_tex_coords;   //individual texture coordinates
-    std::vector<int> halfedge_tex_idx; //texture coordinates sorted for halfedges
-    Surface_mesh::Halfedge_property <Texture_coordinate> tex_coords = mesh.halfedge_property<Texture_coordinate>("h:texcoord");
-    bool with_tex_coord=false;
-
-    // clear mesh
-    mesh.clear();
+    std::vector<Point> positions;         // per vertex
+    std::vector<float> tex_coords;        // u v per texture coordinate
+    std::vector<int>   face_sizes;        // #corners per face
+    std::vector<int>   face_vertex_count; // #vertices in the chunk before the face
+    std::vector<int>   face_tex_count;    // #tex coords in the chunk before the face
+    std::vector<int>   corner_vertices;   // OBJ vertex index per corner, 1-based or relative
+    std::vector<int>   corner_tex_coords; // OBJ tex coord index per corner, 0 if none;
+                                          // empty if they are skipped
+};
 
 
-    // open file (in ASCII mode)
-    FILE* in = fopen(filename.c_str(), "r");
-    if (!in) return false;
-
+//-----------------------------------------------------------------------------
 
-    // clear line once
-    memset(&s, 0, 200);
 
+// texture coordinates and the indices of the corners into them only if
+// tex_coords is set
+static void parse_obj_chunk(const char* lp, const char* end, bool tex_coords,
+                            Obj_chunk& chunk)
+{
+    float x, y, z;
 
-    // parse line by line (currently only supports vertex positions & faces
-    while(in && !feof(in) && fgets(s, 200, in))
+    while (lp != end)
     {
-        // comment
-        if (s[0] == '#' || isspace(s[0])) continue;
+        const char* eol = find_line_end(lp, end);
+        lp = skip_blanks(lp, eol);
 
         // vertex
-        else if (strncmp(s, "v ", 2) == 0)
+        if (eol - lp > 1 && lp[0] == 'v' && lp[1] == ' ')
         {
-            if (sscanf(s, "v %f %f %f", &x, &y, &z))
+            lp += 2;
+            if (parse_float(lp, eol, x) && parse_float(lp, eol, y) && parse_float(lp, eol, z))
             {
-                mesh.add_vertex(Point(x,y,z));
+                chunk.positions.push_back(Point(x, y, z));
             }
         }
-        // normal
-        else if (strncmp(s, "vn ", 3) == 0)
-        {
-          if (sscanf(s, "vn %f %f %f", &x, &y, &z))
-          {
-            // problematic as it can be either a vertex property when interpolated
-            // or a halfedge property for hard edges
-          }
-        }
 
         // texture coordinate
-        else if (strncmp(s, "vt ", 3) == 0)
+        else if (tex_coords && eol - lp > 2 && lp[0] == 'v' && lp[1] == 't' && lp[2] == ' ')
         {
-          if (sscanf(s, "vt %f %f", &x, &y))
-          {
-            z=1;
-            all_tex_coords.push_back(Texture_coordinate(x,y,z));
-          }
+            lp += 3;
+            if (parse_float(lp, eol, x) && parse_float(lp, eol, y))
+            {
+                chunk.tex_coords.push_back(x);
+                chunk.tex_coords.push_back(y);
+            }
         }
 
-        // face
-        else if (strncmp(s, "f ", 2) == 0)
+        // face: v, v/t, v/t/n or v//n per corner
+        else if (eol - lp > 1 && lp[0] == 'f' && lp[1] == ' ')
         {
-          int component(0), nV(0);
-          bool endOfVertex(false);
-          char *p0, *p1(s+1);
+            lp += 2;
+            int n = 0, idx;
+            while (parse_int(lp, eol, idx))
+            {
+                int tex = 0;
+                if (lp != eol && *lp == '/')
+                {
+                    ++lp;
+                    if (!parse_int(lp, eol, tex)) tex = 0;
+                    if (lp != eol && *lp == '/')
+                    {
+                        ++lp;
+                        int normal;
+                        parse_int(lp, eol, normal);
+                    }
+                }
+                chunk.corner_vertices.push_back(idx);
+                if (tex_coords) chunk.corner_tex_coords.push_back(tex);
+                ++n;
+            }
+            chunk.face_sizes.push_back(n);
+            chunk.face_vertex_count.push_back(chunk.positions.size());
+            chunk.face_tex_count.push_back(chunk.tex_coords.size() / 2);
+        }
 
-          vertices.clear();
-          halfedge_tex_idx.clear();
+        // comments, normals, groups, materials, ... are ignored
+        lp = (eol == end) ? end : eol + 1;
+    }
+}
 
-          // skip white-spaces
-          while (*p1==' ') ++p1;
 
-          while (p1)
-          {
-            p0 = p1;
+//-----------------------------------------------------------------------------
 
-            // overwrite next separator
 
-            // skip '/', '\n', ' ', '\0', '\r' <-- don't forget Windows
-            while (*p1!='/' && *p1!='\r' && *p1!='\n' && *p1!=' ' && *p1!='\0') ++p1;
+bool read_obj(Surface_mesh& mesh, const std::string& filename, Vertex_bounds* bounds,
+              unsigned int attributes)
+{
+    // clear mesh
+    mesh.clear();
 
-            // detect end of vertex
-            if (*p1 != '/')
-            {
-              endOfVertex = true;
-            }
 
-            // replace separator by '\0'
-            if (*p1 != '\0')
-            {
-              *p1 = '\0';
-              p1++; // point to next token
-            }
+    // map the file
+    Mapped_file file;
+    if (!file.open(filename)) return false;
+
+
+    // split into line-aligned chunks, one per thread for large files
+    int n_chunks = 1;
+#ifdef _OPENMP
+    if (file.size() > (1 << 20)) n_chunks = omp_get_max_threads();
+#endif
+    std::vector<const char*> starts(n_chunks + 1, file.end());
+    starts[0] = file.begin();
+    for (int i = 1; i < n_chunks; ++i)
+    {
+        const char* p = file.begin() + file.size() / n_chunks * i;
+        starts[i] = std::max(starts[i-1], next_line(p, file.end()));
+    }
+
+
+    // parse all chunks in parallel
+    const bool with_tex_coords = (attributes & READ_TEX_COORDS) != 0;
+    std::vector<Obj_chunk> chunks(n_chunks);
+#pragma omp parallel for schedule(static, 1)
+    for (int i = 0; i < n_chunks; ++i)
+    {
+        parse_obj_chunk(starts[i], starts[i+1], with_tex_coords, chunks[i]);
+    }
+
+
+    // global offsets of the chunks' vertices and texture coordinates
+    std::vector<int> vertex_offset(n_chunks + 1, 0), tex_offset(n_chunks + 1, 0);
+    unsigned int n_faces = 0, n_corners = 0;
+    for (int i = 0; i < n_chunks; ++i)
+    {
+        vertex_offset[i+1] = vertex_offset[i] + chunks[i].positions.size();
+        tex_offset[i+1]    = tex_offset[i]    + chunks[i].tex_coords.size() / 2;
+        n_faces           += chunks[i].face_sizes.size();
+        n_corners         += chunks[i].corner_vertices.size();
+    }
+    const int n_vertices = vertex_offset[n_chunks];
+    const int n_tex      = tex_offset[n_chunks];
+
+
+    // vertices, one block per chunk
+    mesh.reserve(n_vertices, std::max(3u*n_vertices, n_corners/2), n_faces);
+    for (int i = 0; i < n_chunks; ++i)
+    {
+        const std::vector<Point>& pos = chunks[i].positions;
+        mesh.add_vertices(pos.data(), pos.size());
+        if (bounds)
+            for (size_t j = 0; j < pos.size(); ++j) bounds->add(pos[j]);
+    }
+
+
+    // individual texture coordinates
+    std::vector<Texture_coordinate> all_tex_coords;
+    all_tex_coords.reserve(n_tex);
+    for (int i = 0; i < n_chunks; ++i)
+    {
+        const std::vector<float>& tex = chunks[i].tex_coords;
+        for (size_t j = 0; j < tex.size(); j += 2)
+            all_tex_coords.push_back(Texture_coordinate(tex[j], tex[j+1], 1.0f));
+    }
+
 
-            // detect end of line and break
-            if (*p1 == '\0' || *p1 == '\n')
+    // faces, indices are 1-based or relative to the last vertex read so far
+    std::vector<unsigned int> indices, valences;
+    std::vector<int> halfedge_tex_idx;
+    for (int i = 0; i < n_chunks; ++i)
+    {
+        const Obj_chunk& chunk = chunks[i];
+        size_t corner = 0;
+        for (size_t f = 0; f < chunk.face_sizes.size(); ++f)
+        {
+            const int n = chunk.face_sizes[f];
+            const int v_last = vertex_offset[i] + chunk.face_vertex_count[f];
+            const int t_last = tex_offset[i] + chunk.face_tex_count[f];
+            const size_t start = indices.size();
+
+            bool valid = true;
+            for (int k = 0; k < n; ++k, ++corner)
             {
-              p1 = 0;
+                const int raw = chunk.corner_vertices[corner];
+                const int idx = raw > 0 ? raw - 1 : v_last + raw;
+                if (idx < 0 || idx >= n_vertices) valid = false;
+                indices.push_back(idx);
+                if (n_tex == 0) continue;
+
+                const int raw_tex = chunk.corner_tex_coords[corner];
+                const int tex = raw_tex > 0 ? raw_tex - 1 : (raw_tex < 0 ? t_last + raw_tex : -1);
+                halfedge_tex_idx.push_back(tex >= 0 && tex < n_tex ? tex : -1);
             }
-
-            // read next vertex component
-            if (*p0 != '\0')
+            if (!valid || n < 3)
             {
-              switch (component)
-              {
-                case 0: // vertex
-                {
-                  vertices.push_back( Surface_mesh::Vertex(atoi(p0) - 1) );
-                  break;
-                }
-                case 1: // texture coord
-                {
-                  int idx = atoi(p0)-1;
-                  halfedge_tex_idx.push_back(idx);
-                  with_tex_coord=true;
-                  break;
-                }
-                case 2: // normal
-                  break;
-              }
+                indices.resize(start);
+                if (n_tex > 0) halfedge_tex_idx.resize(start);
+                continue;
             }
+            valences.push_back(n);
+        }
+    }
 
-            ++component;
 
-            if (endOfVertex)
+    // without texture coordinates all faces are connected at once
+    if (n_tex == 0)
+    {
+        mesh.add_faces(indices, valences);
+        return true;
+    }
+
+
+    // texture coordinates need the handle of each face
+    Surface_mesh::Halfedge_property<Texture_coordinate> tex_coords =
+        mesh.halfedge_property<Texture_coordinate>("h:texcoord");
+    std::vector<Surface_mesh::Vertex> vertices;
+    size_t corner = 0;
+    for (size_t f = 0; f < valences.size(); corner += valences[f++])
+    {
+        const unsigned int n = valences[f];
+        vertices.resize(n);
+        bool has_tex = true;
+        for (unsigned int k = 0; k < n; ++k)
+        {
+            vertices[k] = Surface_mesh::Vertex(indices[corner + k]);
+            if (halfedge_tex_idx[corner + k] < 0) has_tex = false;
+        }
+
+        Surface_mesh::Face face = mesh.add_face(vertices);
+
+        // add texture coordinates
+        if (face.is_valid() && has_tex)
+        {
+            Surface_mesh::Halfedge_around_face_circulator h_fit = mesh.halfedges(face);
+            Surface_mesh::Halfedge_around_face_circulator h_end = h_fit;
+            unsigned v_idx = 0;
+            do
             {
-              component = 0;
-              nV++;
-              endOfVertex = false;
+                tex_coords[*h_fit] = all_tex_coords[halfedge_tex_idx[corner + v_idx]];
+                ++v_idx;
+                ++h_fit;
             }
-          }
-
-          Surface_mesh::Face f=mesh.add_face(vertices);
-
-
-          // add texture coordinates
-          if(with_tex_coord)
-          {
-              Surface_mesh::Halfedge_around_face_circulator h_fit = mesh.halfedges(f);
-              Surface_mesh::Halfedge_around_face_circulator h_end = h_fit;
-              unsigned v_idx =0;
-              do
-              {
-                  tex_coords[*h_fit]=all_tex_coords.at(halfedge_tex_idx.at(v_idx));
-                  ++v_idx;
-                  ++h_fit;
-              }
-              while(h_fit!=h_end);
-          }
+            while (h_fit != h_end);
         }
-        // clear line
-        memset(&s, 0, 200);
     }
 
-    fclose(in);
     return true;
 }
 
@@ -176,83 +269,115 @@ bool read_obj(Surface_mesh& mesh, const std::string& filename)
 //-----------------------------------------------------------------------------
 
 
+// elements formatted per chunk, see write_chunks()
+static const size_t obj_chunk_size = 16384;
+
+
+//-----------------------------------------------------------------------------
+
+
+// "<prefix> x y z\n" for the elements [begin, end) of a Vec3 property
+template <typename Handle>
+static void format_vec3_lines(const Surface_mesh& mesh, const Property<Vec3>& values,
+                              const char* prefix, size_t begin, size_t end,
+                              std::string& text)
+{
+    const size_t prefix_size = strlen(prefix);
+    char line[8 + 3 * (max_float_chars + 1)];
+    memcpy(line, prefix, prefix_size);
+    for (size_t i = begin; i < end; ++i)
+    {
+        Handle h((int) i);
+        if (mesh.is_deleted(h)) continue;
+
+        const Vec3& v = values[(int) i];
+        char* p = line + prefix_size;
+        *p++ = ' '; p = format_float(p, v[0]);
+        *p++ = ' '; p = format_float(p, v[1]);
+        *p++ = ' '; p = format_float(p, v[2]);
+        *p++ = '\n';
+        text.append(line, p - line);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 bool write_obj(const Surface_mesh& mesh, const std::string& filename)
 {
-    FILE* out = fopen(filename.c_str(), "w");
+    FILE* out = fopen(filename.c_str(), "wb");
     if (!out)
         return false;
 
+    // the chunks are large already, write them without copying through stdio
+    setvbuf(out, NULL, _IONBF, 0);
+
     // comment
-    fprintf(out, "# OBJ export from Surface_mesh\n");
+    const char comment[] = "# OBJ export from Surface_mesh\n";
+    bool ok = fwrite(comment, 1, sizeof(comment) - 1, out) == sizeof(comment) - 1;
 
     //vertices
     Surface_mesh::Vertex_property<Point> points = mesh.get_vertex_property<Point>("v:point");
-    for (Surface_mesh::Vertex_iterator vit=mesh.vertices_begin(); vit!=mesh.vertices_end(); ++vit)
+    ok = ok && write_chunks(out, mesh.vertices_size(), obj_chunk_size,
+                            [&](size_t begin, size_t end, std::string& text)
     {
-        const Point& p = points[*vit];
-        fprintf(out, "v %.10f %.10f %.10f\n", p[0], p[1], p[2]);
-    }
-
-    //normals
-    Surface_mesh::Vertex_property<Point> normals = mesh.get_vertex_property<Point>("v:normal");
-    for (Surface_mesh::Vertex_iterator vit=mesh.vertices_begin(); vit!=mesh.vertices_end(); ++vit)
-    {
-        const Point& p = normals[*vit];
-        fprintf(out, "vn %.10f %.10f %.10f\n", p[0], p[1], p[2]);
-    }
+        format_vec3_lines<Surface_mesh::Vertex>(mesh, points, "v", begin, end, text);
+    });
 
-    //optionally texture coordinates
-    // do we have them?
-    std::vector<std::string> h_props= mesh.halfedge_properties();
-    bool with_tex_coord = false;
-    std::vector<std::string>::iterator h_prop_end = h_props.end();
-    std::vector<std::string>::iterator h_prop_start= h_props.begin();
-    while(h_prop_start!=h_prop_end)
+    //normals, their indices are the vertex indices
+    Surface_mesh::Vertex_property<Normal> normals = mesh.get_vertex_property<Normal>("v:normal");
+    const bool with_normals = normals;
+    if (with_normals)
     {
-        if(0==(*h_prop_start).compare("h:texcoord"))
+        ok = ok && write_chunks(out, mesh.vertices_size(), obj_chunk_size,
+                                [&](size_t begin, size_t end, std::string& text)
         {
-            with_tex_coord=true;
-        }
-        ++h_prop_start;
+            format_vec3_lines<Surface_mesh::Vertex>(mesh, normals, "vn", begin, end, text);
+        });
     }
 
-    //if so then add
-    if(with_tex_coord)
+    //optionally texture coordinates, one per halfedge
+    Surface_mesh::Halfedge_property<Texture_coordinate> tex_coord = mesh.get_halfedge_property<Texture_coordinate>("h:texcoord");
+    const bool with_tex_coord = tex_coord;
+    if (with_tex_coord)
     {
-        Surface_mesh::Halfedge_property<Texture_coordinate> tex_coord = mesh.get_halfedge_property<Texture_coordinate>("h:texcoord");
-        for (Surface_mesh::Halfedge_iterator hit=mesh.halfedges_begin(); hit!=mesh.halfedges_end(); ++hit)
+        ok = ok && write_chunks(out, mesh.halfedges_size(), obj_chunk_size,
+                                [&](size_t begin, size_t end, std::string& text)
         {
-            const Texture_coordinate& pt = tex_coord[*hit];
-            fprintf(out, "vt %.10f %.10f %.10f\n", pt[0], pt[1], pt[2]);
-        }
+            format_vec3_lines<Surface_mesh::Halfedge>(mesh, tex_coord, "vt", begin, end, text);
+        });
     }
 
-    //faces
-    for (Surface_mesh::Face_iterator fit=mesh.faces_begin(); fit!=mesh.faces_end(); ++fit)
+    //faces: vertex index [/tex_coord index] [/normal index], 1-based
+    ok = ok && write_chunks(out, mesh.faces_size(), obj_chunk_size,
+                            [&](size_t begin, size_t end, std::string& text)
     {
-        fprintf(out, "f");
-        Surface_mesh::Vertex_around_face_circulator fvit=mesh.vertices(*fit), fvend=fvit;
-        Surface_mesh::Halfedge_around_face_circulator fhit=mesh.halfedges(*fit);
-        do
+        char corner[3 * (max_int_chars + 1) + 1];
+        for (size_t i = begin; i < end; ++i)
         {
-            if(with_tex_coord)
-            {
-                // write vertex index, tex_coord index and normal index
-                fprintf(out, " %d/%d/%d", (*fvit).idx()+1, (*fhit).idx()+1, (*fvit).idx()+1);
-                ++fhit;
-            }
-            else
+            Surface_mesh::Face f((int) i);
+            if (mesh.is_deleted(f)) continue;
+
+            text.push_back('f');
+            Surface_mesh::Halfedge_around_face_circulator fhit=mesh.halfedges(f), fhend=fhit;
+            do
             {
-                // write vertex index and normal index
-                fprintf(out, " %d//%d", (*fvit).idx()+1, (*fvit).idx()+1);
+                const int v = mesh.to_vertex(*fhit).idx() + 1;
+                char* p = corner;
+                *p++ = ' ';
+                p = format_int(p, v);
+                if (with_tex_coord || with_normals) *p++ = '/';
+                if (with_tex_coord) p = format_int(p, (*fhit).idx() + 1);
+                if (with_normals) { *p++ = '/'; p = format_int(p, v); }
+                text.append(corner, p - corner);
             }
+            while (++fhit != fhend);
+            text.push_back('\n');
         }
-        while (++fvit != fvend);
-        fprintf(out, "\n");
-    }
+    });
 
-    fclose(out);
-    return true;
+    return fclose(out) == 0 && ok;
 }
 
 
@@ -21,6 +21,9 @@
 
 
 #include <surface_mesh/IO.h>
+#include <surface_mesh/IO_parse.h>
+#include <surface_mesh/IO_format.h>
+#include <surface_mesh/Mapped_file.h>
 
 #include <cstdio>
 
@@ -46,106 +49,123 @@ template <typename T> void read(FILE* in, T& t)
 
 
 bool read_off_ascii(Surface_mesh& mesh,
-                    FILE* in,
+                    const char* lp,
+                    const char* end,
                     const bool has_normals,
                     const bool has_texcoords,
-                    const bool has_colors)
+                    const bool has_colors,
+                    Vertex_bounds* bounds)
 {
-    char                 line[200], *lp;
-    int                  nc;
-    unsigned int         i, j, items, idx;
-    unsigned int         nV, nF, nE;
-    Vec3f                p, n, c;
+    const char*          eol;
+    int                  nV, nF, nE, n, idx;
+    int                  i, j;
+    Vec3f                nrm, c;
     Vec2f                t;
-    Surface_mesh::Vertex v;
-
-
-    // properties
-    Surface_mesh::Vertex_property<Normal>              normals;
-    Surface_mesh::Vertex_property<Texture_coordinate>  texcoords;
-    Surface_mesh::Vertex_property<Color>               colors;
-    if (has_normals)   normals   = mesh.vertex_property<Normal>("v:normal");
-    if (has_texcoords) texcoords = mesh.vertex_property<Texture_coordinate>("v:texcoord");
-    if (has_colors)    colors    = mesh.vertex_property<Color>("v:color");
 
 
     // #Vertice, #Faces, #Edges
-    items = fscanf(in, "%d %d %d\n", (int*)&nV, (int*)&nF, (int*)&nE);
+    lp = skip_space_and_comments(lp, end);
+    if (!parse_int(lp, end, nV) || !parse_int(lp, end, nF)) return false;
+    if (!parse_int(lp, end, nE)) nE = 0;
+    if (nV < 0 || nF < 0) return false;
     mesh.clear();
     mesh.reserve(nV, std::max(3*nV, nE), nF);
 
 
-    // read vertices: pos [normal] [color] [texcoord]
-    for (i=0; i<nV && !feof(in); ++i)
+    // per-vertex arrays, moved into the mesh once all vertices are read
+    std::vector<Point>                   points(nV);
+    Property_vector<Normal>              vnormals(has_normals ? nV : 0);
+    Property_vector<Texture_coordinate>  vtexcoords(has_texcoords ? nV : 0);
+    Property_vector<Color>               vcolors(has_colors ? nV : 0);
+
+
+    // read vertices: pos [normal] [color] [texcoord], one per line
+    for (i=0; i<nV; ++i)
     {
-        // read line
-        lp = fgets(line, 200, in);
-        lp = line;
+        lp  = skip_space_and_comments(lp, end);
+        eol = find_line_end(lp, end);
+        if (lp == end) return false;
 
         // position
-        items = sscanf(lp, "%f %f %f%n", &p[0], &p[1], &p[2], &nc);
-        assert(items==3);
-        v = mesh.add_vertex((Point)p);
-        lp += nc;
+        Point& p = points[i];
+        if (!parse_float(lp, eol, p[0]) ||
+            !parse_float(lp, eol, p[1]) ||
+            !parse_float(lp, eol, p[2]))
+            return false;
+        if (bounds) bounds->add(p);
 
         // normal
         if (has_normals)
         {
-            if (sscanf(lp, "%f %f %f%n", &n[0], &n[1], &n[2], &nc) == 3)
+            if (parse_float(lp, eol, nrm[0]) &&
+                parse_float(lp, eol, nrm[1]) &&
+                parse_float(lp, eol, nrm[2]))
             {
-                normals[v] = n;
+                vnormals[i] = nrm;
             }
-            lp += nc;
         }
 
         // color
         if (has_colors)
         {
-            if (sscanf(lp, "%f %f %f%n", &c[0], &c[1], &c[2], &nc) == 3)
+            if (parse_float(lp, eol, c[0]) &&
+                parse_float(lp, eol, c[1]) &&
+                parse_float(lp, eol, c[2]))
             {
                 if (c[0]>1.0f || c[1]>1.0f || c[2]>1.0f) c *= (1.0/255.0);
-                colors[v] = c;
+                vcolors[i] = c;
             }
-            lp += nc;
         }
 
         // tex coord
         if (has_texcoords)
         {
-            items = sscanf(lp, "%f %f%n", &t[0], &t[1], &nc);
-            assert(items == 2);
-            texcoords[v][0] = t[0];
-            texcoords[v][1] = t[1];
-            lp += nc;
+            if (parse_float(lp, eol, t[0]) && parse_float(lp, eol, t[1]))
+            {
+                vtexcoords[i][0] = t[0];
+                vtexcoords[i][1] = t[1];
+            }
         }
+
+        lp = eol;
     }
 
 
+    // all vertices at once, then the properties as whole arrays
+    mesh.add_vertices(points.data(), nV);
+    if (has_normals)
+        mesh.vertex_property<Normal>("v:normal").vector().swap(vnormals);
+    if (has_texcoords)
+        mesh.vertex_property<Texture_coordinate>("v:texcoord").vector().swap(vtexcoords);
+    if (has_colors)
+        mesh.vertex_property<Color>("v:color").vector().swap(vcolors);
+
+
 
     // read faces: #N v[1] v[2] ... v[n-1]
-    std::vector<Surface_mesh::Vertex> vertices;
+    std::vector<unsigned int> indices, valences;
+    indices.reserve(3*nF);
+    valences.reserve(nF);
     for (i=0; i<nF; ++i)
     {
-        // read line
-        lp = fgets(line, 200, in);
-        lp = line;
+        lp = skip_space_and_comments(lp, end);
 
         // #vertices
-        items = sscanf(lp, "%d%n", (int*)&nV, &nc);
-        assert(items == 1);
-        vertices.resize(nV);
-        lp += nc;
+        if (!parse_int(lp, end, n) || n < 0) return false;
+        valences.push_back(n);
 
-        // indices
-        for (j=0; j<nV; ++j)
+        // indices, may wrap over lines
+        for (j=0; j<n; ++j)
         {
-            items = sscanf(lp, "%d%n", (int*)&idx, &nc);
-            assert(items == 1);
-            vertices[j] = Surface_mesh::Vertex(idx);
-            lp += nc;
+            lp = skip_space_and_comments(lp, end);
+            if (!parse_int(lp, end, idx) || idx < 0 || idx >= nV) return false;
+            indices.push_back(idx);
         }
-        mesh.add_face(vertices);
+
+        // skip per-face colors
+        lp = next_line(lp, end);
     }
+    mesh.add_faces(indices, valences);
 
 
     return true;
@@ -159,26 +179,19 @@ bool read_off_binary(Surface_mesh& mesh,
                      FILE* in,
                      const bool has_normals,
                      const bool has_texcoords,
-                     const bool has_colors)
+                     const bool has_colors,
+                     Vertex_bounds* bounds)
 {
     unsigned int       i, j, idx;
     unsigned int       nV, nF, nE;
-    Vec3f              p, n, c;
+    Vec3f              n;
     Vec2f              t;
-    Surface_mesh::Vertex  v;
 
 
     // binary cannot (yet) read colors
     if (has_colors) return false;
 
 
-    // properties
-    Surface_mesh::Vertex_property<Normal>              normals;
-    Surface_mesh::Vertex_property<Texture_coordinate>  texcoords;
-    if (has_normals)   normals   = mesh.vertex_property<Normal>("v:normal");
-    if (has_texcoords) texcoords = mesh.vertex_property<Texture_coordinate>("v:texcoord");
-
-
     // #Vertice, #Faces, #Edges
     read(in, nV);
     read(in, nF);
@@ -187,43 +200,69 @@ bool read_off_binary(Surface_mesh& mesh,
     mesh.reserve(nV, std::max(3*nV, nE), nF);
 
 
-    // read vertices: pos [normal] [color] [texcoord]
-    for (i=0; i<nV && !feof(in); ++i)
+    // read vertices: pos [normal] [color] [texcoord], a plain list of
+    // positions in a single read
+    std::vector<Point>                   points(nV);
+    Property_vector<Normal>              vnormals;
+    Property_vector<Texture_coordinate>  vtexcoords;
+    if (!has_normals && !has_texcoords)
     {
-        // position
-        read(in, p);
-        v = mesh.add_vertex((Point)p);
-
-        // normal
-        if (has_normals)
+        if (nV) nV = fread(points.data(), sizeof(Point), nV, in);
+        points.resize(nV);
+    }
+    else
+    {
+        for (i=0; i<nV && !feof(in); ++i)
         {
-            read(in, n);
-            normals[v] = n;
-        }
+            // position
+            read(in, points[i]);
 
-        // tex coord
-        if (has_texcoords)
-        {
-            read(in, t);
-            texcoords[v][0] = t[0];
-            texcoords[v][1] = t[1];
+            // normal
+            if (has_normals)
+            {
+                read(in, n);
+                vnormals.push_back(n);
+            }
+
+            // tex coord
+            if (has_texcoords)
+            {
+                read(in, t);
+                vtexcoords.push_back(Texture_coordinate(t[0], t[1], 0.0f));
+            }
         }
+        points.resize(i);
+    }
+    if (bounds)
+        for (i=0; i<points.size(); ++i) bounds->add(points[i]);
+    mesh.add_vertices(points.data(), points.size());
+    if (has_normals)
+    {
+        vnormals.resize(points.size());
+        mesh.vertex_property<Normal>("v:normal").vector().swap(vnormals);
+    }
+    if (has_texcoords)
+    {
+        vtexcoords.resize(points.size());
+        mesh.vertex_property<Texture_coordinate>("v:texcoord").vector().swap(vtexcoords);
     }
 
 
     // read faces: #N v[1] v[2] ... v[n-1]
-    std::vector<Surface_mesh::Vertex> vertices;
+    std::vector<unsigned int> indices, valences;
+    indices.reserve(3*nF);
+    valences.reserve(nF);
     for (i=0; i<nF; ++i)
     {
         read(in, nV);
-        vertices.resize(nV);
+        valences.push_back(nV);
         for (j=0; j<nV; ++j)
         {
             read(in, idx);
-            vertices[j] = Surface_mesh::Vertex(idx);
+            indices.push_back(idx);
         }
-        mesh.add_face(vertices);
     }
+    mesh.add_faces(indices, valences);
 
 
     return true;
@@ -233,7 +272,7 @@ bool read_off_binary(Surface_mesh& mesh,
 //-----------------------------------------------------------------------------
 
 
-bool read_off(Surface_mesh& mesh, const std::string& filename)
+bool read_off(Surface_mesh& mesh, const std::string& filename, Vertex_bounds* bounds)
 {
     char  line[200];
     bool  has_texcoords = false;
@@ -244,47 +283,47 @@ bool read_off(Surface_mesh& mesh, const std::string& filename)
     bool  is_binary     = false;
 
 
-    // open file (in ASCII mode)
-    FILE* in = fopen(filename.c_str(), "r");
-    if (!in) return false;
+    // map the whole file, ASCII files are parsed in place
+    Mapped_file file;
+    if (!file.open(filename)) return false;
 
 
     // read header: [ST][C][N][4][n]OFF BINARY
-    char *c = fgets(line, 200, in);
-    assert(c != NULL);
-    c = line;
+    const char* c   = skip_space_and_comments(file.begin(), file.end());
+    const char* eol = find_line_end(c, file.end());
+    if (eol - c < 3) return false;
     if (c[0] == 'S' && c[1] == 'T') { has_texcoords = true; c += 2; }
     if (c[0] == 'C') { has_colors  = true; ++c; }
     if (c[0] == 'N') { has_normals = true; ++c; }
     if (c[0] == '4') { has_hcoords = true; ++c; }
     if (c[0] == 'n') { has_dim     = true; ++c; }
-    if (strncmp(c, "OFF", 3) != 0) { fclose(in); return false; } // no OFF
-    if (strncmp(c+4, "BINARY", 6) == 0) is_binary = true;
+    if (eol - c < 3 || strncmp(c, "OFF", 3) != 0) return false; // no OFF
+    if (eol - c >= 10 && strncmp(c+4, "BINARY", 6) == 0) is_binary = true;
 
 
     // homogeneous coords, and vertex dimension != 3 are not supported
     if (has_hcoords || has_dim)
     {
-        fclose(in);
         return false;
     }
 
 
-    // if binary: reopen file in binary mode
-    if (is_binary)
+    // read as ASCII from the mapping
+    if (!is_binary)
     {
-        fclose(in);
-        in = fopen(filename.c_str(), "rb");
-        c = fgets(line, 200, in);
-        assert(c != NULL);
+        return read_off_ascii(mesh, c+3, file.end(),
+                              has_normals, has_texcoords, has_colors, bounds);
     }
 
 
-    // read as ASCII or binary
-    bool ok = (is_binary ?
-               read_off_binary(mesh, in, has_normals, has_texcoords, has_colors) :
-               read_off_ascii(mesh, in, has_normals, has_texcoords, has_colors));
+    // binary: read through stdio, after the header line
+    file.close();
+    FILE* in = fopen(filename.c_str(), "rb");
+    if (!in) return false;
+    char *lc = fgets(line, 200, in);
+    assert(lc != NULL);
 
+    bool ok = read_off_binary(mesh, in, has_normals, has_texcoords, has_colors, bounds);
 
     fclose(in);
     return ok;
@@ -294,12 +333,22 @@ bool read_off(Surface_mesh& mesh, const std::string& filename)
 //-----------------------------------------------------------------------------
 
 
+// vertices and faces formatted per chunk, see write_chunks()
+static const size_t off_chunk_size = 16384;
+
+
+//-----------------------------------------------------------------------------
+
+
 bool write_off(const Surface_mesh& mesh, const std::string& filename)
 {
-    FILE* out = fopen(filename.c_str(), "w");
+    FILE* out = fopen(filename.c_str(), "wb");
     if (!out)
         return false;
 
+    // the chunks are large already, write them without copying through stdio
+    setvbuf(out, NULL, _IONBF, 0);
+
 
     bool  has_normals   = false;
     bool  has_texcoords = false;
@@ -310,52 +359,149 @@ bool write_off(const Surface_mesh& mesh, const std::string& filename)
 
 
     // header
-    if(has_texcoords)
-        fprintf(out, "ST");
-    if(has_normals)
-        fprintf(out, "N");
-    fprintf(out, "OFF\n%d %d 0\n", mesh.n_vertices(), mesh.n_faces());
+    char header[64];
+    char* h = header;
+    if (has_texcoords) { *h++ = 'S'; *h++ = 'T'; }
+    if (has_normals)   { *h++ = 'N'; }
+    h += sprintf(h, "OFF\n%d %d 0\n", mesh.n_vertices(), mesh.n_faces());
+    bool ok = fwrite(header, 1, h - header, out) == size_t(h - header);
 
 
     // vertices, and optionally normals and texture coordinates
     Surface_mesh::Vertex_property<Point> points = mesh.get_vertex_property<Point>("v:point");
-    for (Surface_mesh::Vertex_iterator vit=mesh.vertices_begin(); vit!=mesh.vertices_end(); ++vit)
+    ok = ok && write_chunks(out, mesh.vertices_size(), off_chunk_size,
+                            [&](size_t begin, size_t end, std::string& text)
     {
-        const Point& p = points[*vit];
-        fprintf(out, "%.10f %.10f %.10f", p[0], p[1], p[2]);
-
-        if (has_normals)
+        char line[8 * (max_float_chars + 1)];
+        for (size_t i = begin; i < end; ++i)
         {
-            const Normal& n = normals[*vit];
-            fprintf(out, " %.10f %.10f %.10f", n[0], n[1], n[2]);
+            Surface_mesh::Vertex v((int) i);
+            if (mesh.is_deleted(v)) continue;
+
+            char* p = line;
+            const Point& q = points[v];
+            p = format_float(p, q[0]); *p++ = ' ';
+            p = format_float(p, q[1]); *p++ = ' ';
+            p = format_float(p, q[2]);
+
+            if (has_normals)
+            {
+                const Normal& n = normals[v];
+                *p++ = ' '; p = format_float(p, n[0]);
+                *p++ = ' '; p = format_float(p, n[1]);
+                *p++ = ' '; p = format_float(p, n[2]);
+            }
+
+            if (has_texcoords)
+            {
+                const Texture_coordinate& t = texcoords[v];
+                *p++ = ' '; p = format_float(p, t[0]);
+                *p++ = ' '; p = format_float(p, t[1]);
+            }
+
+            *p++ = '\n';
+            text.append(line, p - line);
         }
+    });
 
-        if (has_texcoords)
+
+    // faces
+    ok = ok && write_chunks(out, mesh.faces_size(), off_chunk_size,
+                            [&](size_t begin, size_t end, std::string& text)
+    {
+        char index[max_int_chars + 1];
+        for (size_t i = begin; i < end; ++i)
         {
-            const Texture_coordinate& t = texcoords[*vit];
-            fprintf(out, "% .10f %.10f", t[0], t[1]);
+            Surface_mesh::Face f((int) i);
+            if (mesh.is_deleted(f)) continue;
+
+            text.append(index, format_uint(index, mesh.valence(f)));
+            Surface_mesh::Vertex_around_face_circulator fvit=mesh.vertices(f), fvend=fvit;
+            do
+            {
+                index[0] = ' ';
+                text.append(index, format_int(index + 1, (*fvit).idx()));
+            }
+            while (++fvit != fvend);
+            text.push_back('\n');
         }
+    });
 
-        fprintf(out, "\n");
-    }
+    return fclose(out) == 0 && ok;
+}
 
 
-    // faces
-    for (Surface_mesh::Face_iterator fit=mesh.faces_begin(); fit!=mesh.faces_end(); ++fit)
+//-----------------------------------------------------------------------------
+
+
+bool write_off_binary(const Surface_mesh& mesh, const std::string& filename)
+{
+    FILE* out = fopen(filename.c_str(), "wb");
+    if (!out)
+        return false;
+    setvbuf(out, NULL, _IONBF, 0);
+
+
+    bool  has_normals   = false;
+    bool  has_texcoords = false;
+    Surface_mesh::Vertex_property<Normal> normals = mesh.get_vertex_property<Normal>("v:normal");
+    Surface_mesh::Vertex_property<Texture_coordinate>  texcoords = mesh.get_vertex_property<Texture_coordinate>("v:texcoord");
+    if (normals)   has_normals = true;
+    if (texcoords) has_texcoords = true;
+
+
+    // header line, then #vertices #faces #edges, in the layout
+    // read_off_binary() expects
+    std::string header;
+    if (has_texcoords) header += "ST";
+    if (has_normals)   header += "N";
+    header += "OFF BINARY\n";
+    const unsigned int counts[3] = { mesh.n_vertices(), mesh.n_faces(), 0 };
+    header.append((const char*) counts, sizeof(counts));
+    bool ok = fwrite(header.data(), 1, header.size(), out) == header.size();
+
+
+    // vertices: pos [normal] [texcoord]
+    Surface_mesh::Vertex_property<Point> points = mesh.get_vertex_property<Point>("v:point");
+    ok = ok && write_chunks(out, mesh.vertices_size(), off_chunk_size,
+                            [&](size_t begin, size_t end, std::string& text)
     {
-        int nV = mesh.valence(*fit);
-        fprintf(out, "%d", nV);
-        Surface_mesh::Vertex_around_face_circulator fvit=mesh.vertices(*fit), fvend=fvit;
-        do
+        for (size_t i = begin; i < end; ++i)
         {
-            fprintf(out, " %d", (*fvit).idx());
+            Surface_mesh::Vertex v((int) i);
+            if (mesh.is_deleted(v)) continue;
+
+            text.append((const char*) &points[v], sizeof(Point));
+            if (has_normals)
+                text.append((const char*) &normals[v], sizeof(Normal));
+            if (has_texcoords)
+                text.append((const char*) &texcoords[v], 2 * sizeof(Scalar));
         }
-        while (++fvit != fvend);
-        fprintf(out, "\n");
-    }
+    });
 
-    fclose(out);
-    return true;
+
+    // faces: #N v[1] v[2] ... v[n-1]
+    ok = ok && write_chunks(out, mesh.faces_size(), off_chunk_size,
+                            [&](size_t begin, size_t end, std::string& text)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            Surface_mesh::Face f((int) i);
+            if (mesh.is_deleted(f)) continue;
+
+            const unsigned int valence = mesh.valence(f);
+            text.append((const char*) &valence, sizeof(valence));
+            Surface_mesh::Vertex_around_face_circulator fvit=mesh.vertices(f), fvend=fvit;
+            do
+            {
+                const unsigned int idx = (*fvit).idx();
+                text.append((const char*) &idx, sizeof(idx));
+            }
+            while (++fvit != fvend);
+        }
+    });
+
+    return fclose(out) == 0 && ok;
 }
 
 
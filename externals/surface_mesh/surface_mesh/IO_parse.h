@@ -0,0 +1,160 @@
+//=============================================================================
+#ifndef SURFACE_MESH_IO_PARSE_H
+#define SURFACE_MESH_IO_PARSE_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+// Locale independent number parsing on [p, end) ranges of a mapped file.
+// The parse_* functions skip leading blanks, advance p past the number and
+// return false without moving p if there is none.
+
+
+/// skip spaces, tabs and carriage returns, but not line breaks
+inline const char* skip_blanks(const char* p, const char* end)
+{
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p;
+}
+
+
+/// position of the next '\n' in [p, end), or end
+inline const char* find_line_end(const char* p, const char* end)
+{
+    const char* eol = (const char*) memchr(p, '\n', end - p);
+    return eol ? eol : end;
+}
+
+
+/// first character of the next line
+inline const char* next_line(const char* p, const char* end)
+{
+    p = find_line_end(p, end);
+    return p == end ? end : p + 1;
+}
+
+
+/// skip whitespace including line breaks, and '#' comments up to the line end
+inline const char* skip_space_and_comments(const char* p, const char* end)
+{
+    while (p != end)
+    {
+        if (*p == '#') p = next_line(p, end);
+        else if (isspace((unsigned char) *p)) ++p;
+        else break;
+    }
+    return p;
+}
+
+
+/// parse a decimal integer with optional sign
+inline bool parse_int(const char*& p, const char* end, int& value)
+{
+    const char* q = skip_blanks(p, end);
+    bool negative = false;
+    if (q != end && (*q == '-' || *q == '+')) negative = (*q++ == '-');
+    if (q == end || *q < '0' || *q > '9') return false;
+
+    long long v = 0;
+    while (q != end && *q >= '0' && *q <= '9') v = v*10 + (*q++ - '0');
+    value = (int) (negative ? -v : v);
+    p = q;
+    return true;
+}
+
+
+/// parse a float in fixed or scientific notation, falls back to strtod for
+/// nan, inf and hexadecimal numbers
+inline bool parse_float(const char*& p, const char* end, float& value)
+{
+    static const double powers[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                     1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                     1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char* q = skip_blanks(p, end);
+    const char* start = q;
+    bool negative = false;
+    if (q != end && (*q == '-' || *q == '+')) negative = (*q++ == '-');
+
+    // up to 19 significant digits fit into the mantissa
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    while (q != end && *q >= '0' && *q <= '9')
+    {
+        if (digits < 19) { mantissa = mantissa*10 + (*q - '0'); if (mantissa) ++digits; }
+        else ++exponent;
+        ++q; any = true;
+    }
+    if (q != end && *q == '.')
+    {
+        ++q;
+        while (q != end && *q >= '0' && *q <= '9')
+        {
+            if (digits < 19) { mantissa = mantissa*10 + (*q - '0'); if (mantissa) ++digits; --exponent; }
+            ++q; any = true;
+        }
+    }
+
+    if (!any || (q != end && (*q == 'x' || *q == 'X' || *q == 'n' || *q == 'N' ||
+                              *q == 'i' || *q == 'I')))
+    {
+        // rare spellings, copy into a terminated buffer for strtod
+        char buffer[64];
+        size_t n = std::min((size_t) (end - start), sizeof(buffer) - 1);
+        memcpy(buffer, start, n);
+        buffer[n] = 0;
+        char* stop;
+        double v = strtod(buffer, &stop);
+        if (stop == buffer) return false;
+        value = (float) v;
+        p = start + (stop - buffer);
+        return true;
+    }
+
+    if (q != end && (*q == 'e' || *q == 'E'))
+    {
+        const char* e = q + 1;
+        int exp10;
+        if (e != end && *e != ' ' && *e != '\t' && parse_int(e, end, exp10))
+        {
+            exponent += exp10;
+            q = e;
+        }
+    }
+
+    double v = (double) mantissa;
+    if (exponent < 0)
+        v = (-exponent <= 22) ? v / powers[-exponent] : v * std::pow(10.0, exponent);
+    else if (exponent > 0)
+        v = (exponent <= 22) ? v * powers[exponent] : v * std::pow(10.0, exponent);
+
+    value = (float) (negative ? -v : v);
+    p = q;
+    return true;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_IO_PARSE_H
+//=============================================================================
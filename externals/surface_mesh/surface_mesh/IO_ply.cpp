@@ -0,0 +1,613 @@
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/IO.h>
+#include <surface_mesh/IO_parse.h>
+#include <surface_mesh/Mapped_file.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+// Reader for ASCII, binary little endian and binary big endian PLY files.
+// The file is mapped and every element is decoded in place, vertices go
+// through their fixed record layout. Vertex properties besides position,
+// normal, color and texture coordinate are stored as float properties
+// "v:<name>", e.g. v:confidence. Other elements than vertex and face are
+// skipped.
+
+
+enum Ply_type
+{
+    PLY_NONE, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16,
+    PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64
+};
+
+enum Ply_format
+{
+    PLY_ASCII, PLY_BINARY_LE, PLY_BINARY_BE
+};
+
+
+struct Ply_property
+{
+    std::string name;
+    Ply_type    type;        // value type
+    Ply_type    count_type;  // PLY_NONE for scalars, count type of lists
+    size_t      offset;      // offset in a fixed size binary record
+};
+
+
+struct Ply_element
+{
+    std::string                name;
+    unsigned int               count;
+    std::vector<Ply_property>  properties;
+    size_t                     stride;     // record size, 0 if it has lists
+
+    int find(const char* name) const
+    {
+        for (size_t i = 0; i < properties.size(); ++i)
+            if (properties[i].name == name && properties[i].count_type == PLY_NONE)
+                return (int) i;
+        return -1;
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+static Ply_type ply_type(const std::string& s)
+{
+    if (s == "char"   || s == "int8")    return PLY_INT8;
+    if (s == "uchar"  || s == "uint8")   return PLY_UINT8;
+    if (s == "short"  || s == "int16")   return PLY_INT16;
+    if (s == "ushort" || s == "uint16")  return PLY_UINT16;
+    if (s == "int"    || s == "int32")   return PLY_INT32;
+    if (s == "uint"   || s == "uint32")  return PLY_UINT32;
+    if (s == "float"  || s == "float32") return PLY_FLOAT32;
+    if (s == "double" || s == "float64") return PLY_FLOAT64;
+    return PLY_NONE;
+}
+
+
+static size_t ply_type_size(Ply_type t)
+{
+    static const size_t sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+    return sizes[t];
+}
+
+
+static bool host_is_little_endian()
+{
+    const unsigned int one = 1;
+    return *((const unsigned char*) &one) == 1;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// decodes one binary value of type t at p
+inline double ply_decode(const char* p, Ply_type t, bool swap)
+{
+    char b[8];
+    const size_t n = ply_type_size(t);
+    if (swap) for (size_t i = 0; i < n; ++i) b[i] = p[n-1-i];
+    else      memcpy(b, p, n);
+
+    switch (t)
+    {
+        case PLY_INT8:    { signed char    v; memcpy(&v, b, 1); return v; }
+        case PLY_UINT8:   { unsigned char  v; memcpy(&v, b, 1); return v; }
+        case PLY_INT16:   { short          v; memcpy(&v, b, 2); return v; }
+        case PLY_UINT16:  { unsigned short v; memcpy(&v, b, 2); return v; }
+        case PLY_INT32:   { int            v; memcpy(&v, b, 4); return v; }
+        case PLY_UINT32:  { unsigned int   v; memcpy(&v, b, 4); return v; }
+        case PLY_FLOAT32: { float          v; memcpy(&v, b, 4); return v; }
+        case PLY_FLOAT64: { double         v; memcpy(&v, b, 8); return v; }
+        default:          return 0.0;
+    }
+}
+
+
+// sequential reader over the body of a PLY file
+class Ply_cursor
+{
+public:
+
+    Ply_cursor(const char* p, const char* end, Ply_format format)
+        : p_(p), end_(end), format_(format),
+          swap_((format == PLY_BINARY_LE) != host_is_little_endian()) {}
+
+    /// read one value of type t
+    bool read(Ply_type t, double& value)
+    {
+        if (format_ == PLY_ASCII)
+        {
+            while (p_ != end_ && isspace((unsigned char) *p_)) ++p_;
+            if (t == PLY_FLOAT32 || t == PLY_FLOAT64)
+            {
+                float f;
+                if (!parse_float(p_, end_, f)) return false;
+                value = f;
+            }
+            else
+            {
+                int i;
+                if (!parse_int(p_, end_, i)) return false;
+                value = i;
+            }
+            return true;
+        }
+
+        const size_t n = ply_type_size(t);
+        if (size_t(end_ - p_) < n) return false;
+        value = ply_decode(p_, t, swap_);
+        p_ += n;
+        return true;
+    }
+
+    /// fixed size binary record of n bytes, or 0 past the end
+    const char* record(size_t n)
+    {
+        if (size_t(end_ - p_) < n) return 0;
+        const char* r = p_;
+        p_ += n;
+        return r;
+    }
+
+    /// skip one element with all its properties
+    bool skip(const Ply_element& e)
+    {
+        if (format_ != PLY_ASCII && e.stride) return record(e.stride) != 0;
+
+        double v;
+        for (size_t i = 0; i < e.properties.size(); ++i)
+        {
+            const Ply_property& prop = e.properties[i];
+            if (prop.count_type == PLY_NONE)
+            {
+                if (!read(prop.type, v)) return false;
+            }
+            else
+            {
+                if (!read(prop.count_type, v)) return false;
+                for (int j = 0, n = (int) v; j < n; ++j)
+                    if (!read(prop.type, v)) return false;
+            }
+        }
+        return true;
+    }
+
+    bool binary() const { return format_ != PLY_ASCII; }
+    bool swap()   const { return swap_; }
+
+private:
+
+    const char* p_;
+    const char* end_;
+    Ply_format  format_;
+    bool        swap_;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+static bool read_ply_vertices(Surface_mesh& mesh, const Ply_element& e, Ply_cursor& in,
+                              Vertex_bounds* bounds, unsigned int attributes)
+{
+    const int x  = e.find("x"),  y  = e.find("y"),  z  = e.find("z");
+    const int nx = e.find("nx"), ny = e.find("ny"), nz = e.find("nz");
+    const int r  = e.find("red"), g = e.find("green"), b = e.find("blue");
+    int u = e.find("u"), v = e.find("v");
+    if (u < 0 || v < 0) { u = e.find("s"); v = e.find("t"); }
+    if (u < 0 || v < 0) { u = e.find("texture_u"); v = e.find("texture_v"); }
+    if (x < 0 || y < 0 || z < 0) return false;
+
+    const bool has_normals   = (nx >= 0 && ny >= 0 && nz >= 0) && (attributes & READ_NORMALS);
+    const bool has_colors    = (r >= 0 && g >= 0 && b >= 0) && (attributes & READ_COLORS);
+    const bool has_texcoords = (u >= 0 && v >= 0) && (attributes & READ_TEX_COORDS);
+
+    Surface_mesh::Vertex_property<Normal>              normals;
+    Surface_mesh::Vertex_property<Color>               colors;
+    Surface_mesh::Vertex_property<Texture_coordinate>  texcoords;
+    if (has_normals)   normals   = mesh.vertex_property<Normal>("v:normal");
+    if (has_colors)    colors    = mesh.vertex_property<Color>("v:color");
+    if (has_texcoords) texcoords = mesh.vertex_property<Texture_coordinate>("v:texcoord");
+
+    // 8 bit colors are scaled to [0,1]
+    const float color_scale = (has_colors && e.properties[r].type == PLY_UINT8) ? 1.0f/255.0f : 1.0f;
+
+    // all other scalar properties become float properties
+    std::vector<int> used(e.properties.size(), 0);
+    const int known[] = { x, y, z, nx, ny, nz, r, g, b, u, v };
+    for (size_t i = 0; i < sizeof(known)/sizeof(int); ++i)
+        if (known[i] >= 0) used[known[i]] = 1;
+    std::vector<Surface_mesh::Vertex_property<float> > extra(e.properties.size());
+    if (attributes & READ_EXTRA)
+        for (size_t i = 0; i < e.properties.size(); ++i)
+            if (!used[i] && e.properties[i].count_type == PLY_NONE)
+                extra[i] = mesh.vertex_property<float>("v:" + e.properties[i].name);
+
+    // the properties that are kept, fixed size records decode only those
+    std::vector<int> decoded;
+    for (size_t i = 0; i < e.properties.size(); ++i)
+    {
+        const bool keep = (int) i == x || (int) i == y || (int) i == z ||
+            (has_normals   && ((int) i == nx || (int) i == ny || (int) i == nz)) ||
+            (has_colors    && ((int) i == r  || (int) i == g  || (int) i == b))  ||
+            (has_texcoords && ((int) i == u  || (int) i == v)) || extra[i];
+        if (keep) decoded.push_back((int) i);
+    }
+
+    std::vector<double> values(e.properties.size());
+    for (unsigned int i = 0; i < e.count; ++i)
+    {
+        // fixed size records are decoded at their offsets
+        if (in.binary() && e.stride)
+        {
+            const char* rec = in.record(e.stride);
+            if (!rec) return false;
+            for (size_t j = 0; j < decoded.size(); ++j)
+            {
+                const int k = decoded[j];
+                values[k] = ply_decode(rec + e.properties[k].offset,
+                                       e.properties[k].type, in.swap());
+            }
+        }
+        else
+        {
+            double count;
+            for (size_t k = 0; k < e.properties.size(); ++k)
+            {
+                const Ply_property& prop = e.properties[k];
+                if (prop.count_type == PLY_NONE)
+                {
+                    if (!in.read(prop.type, values[k])) return false;
+                }
+                else
+                {
+                    if (!in.read(prop.count_type, count)) return false;
+                    for (int j = 0; j < (int) count; ++j)
+                        if (!in.read(prop.type, values[k])) return false;
+                }
+            }
+        }
+
+        const Point p((float) values[x], (float) values[y], (float) values[z]);
+        Surface_mesh::Vertex vh = mesh.add_vertex(p);
+        if (bounds) bounds->add(p);
+        if (has_normals)
+            normals[vh] = Normal((float) values[nx], (float) values[ny], (float) values[nz]);
+        if (has_colors)
+            colors[vh] = Color((float) values[r], (float) values[g], (float) values[b]) * color_scale;
+        if (has_texcoords)
+            texcoords[vh] = Texture_coordinate((float) values[u], (float) values[v], 0.0f);
+        for (size_t k = 0; k < extra.size(); ++k)
+            if (extra[k]) extra[k][vh] = (float) values[k];
+    }
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+static bool read_ply_faces(Surface_mesh& mesh, const Ply_element& e, Ply_cursor& in)
+{
+    int indices = -1;
+    for (size_t i = 0; i < e.properties.size(); ++i)
+        if (e.properties[i].count_type != PLY_NONE &&
+            (e.properties[i].name == "vertex_indices" ||
+             e.properties[i].name == "vertex_index"))
+            indices = (int) i;
+    if (indices < 0)
+    {
+        for (unsigned int i = 0; i < e.count; ++i)
+            if (!in.skip(e)) return false;
+        return true;
+    }
+
+    const int nv = (int) mesh.n_vertices();
+    std::vector<unsigned int> face_indices, valences;
+    face_indices.reserve(3*e.count);
+    valences.reserve(e.count);
+
+    for (unsigned int i = 0; i < e.count; ++i)
+    {
+        double value;
+        bool   valid = true;
+        const size_t start = face_indices.size();
+
+        for (size_t k = 0; k < e.properties.size(); ++k)
+        {
+            const Ply_property& prop = e.properties[k];
+            if (prop.count_type == PLY_NONE)
+            {
+                if (!in.read(prop.type, value)) return false;
+                continue;
+            }
+
+            double count;
+            if (!in.read(prop.count_type, count)) return false;
+            for (int j = 0; j < (int) count; ++j)
+            {
+                if (!in.read(prop.type, value)) return false;
+                if ((int) k != indices) continue;
+                const int idx = (int) value;
+                if (idx < 0 || idx >= nv) valid = false;
+                face_indices.push_back(idx);
+            }
+        }
+
+        if (valid && face_indices.size() - start >= 3)
+            valences.push_back(face_indices.size() - start);
+        else
+            face_indices.resize(start);
+    }
+    mesh.add_faces(face_indices, valences);
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_ply(Surface_mesh& mesh, const std::string& filename, Vertex_bounds* bounds,
+              unsigned int attributes)
+{
+    // map the whole file
+    Mapped_file file;
+    if (!file.open(filename)) return false;
+
+    const char* p   = file.begin();
+    const char* end = file.end();
+
+
+    // header
+    Ply_format                format = PLY_ASCII;
+    std::vector<Ply_element>  elements;
+    bool                      magic = false, done = false;
+    while (p != end && !done)
+    {
+        const char* eol = find_line_end(p, end);
+        std::istringstream line(std::string(p, eol));
+        p = (eol == end) ? end : eol + 1;
+
+        std::string keyword;
+        line >> keyword;
+
+        if (!magic)
+        {
+            if (keyword != "ply") return false;
+            magic = true;
+        }
+        else if (keyword == "format")
+        {
+            std::string f;
+            line >> f;
+            if      (f == "ascii")                format = PLY_ASCII;
+            else if (f == "binary_little_endian") format = PLY_BINARY_LE;
+            else if (f == "binary_big_endian")    format = PLY_BINARY_BE;
+            else return false;
+        }
+        else if (keyword == "element")
+        {
+            Ply_element e;
+            line >> e.name >> e.count;
+            e.stride = 0;
+            elements.push_back(e);
+        }
+        else if (keyword == "property")
+        {
+            if (elements.empty()) return false;
+            Ply_property prop;
+            std::string type;
+            line >> type;
+            if (type == "list")
+            {
+                std::string count_type;
+                line >> count_type >> type;
+                prop.count_type = ply_type(count_type);
+                if (prop.count_type == PLY_NONE) return false;
+            }
+            else prop.count_type = PLY_NONE;
+            prop.type = ply_type(type);
+            if (prop.type == PLY_NONE) return false;
+            line >> prop.name;
+            prop.offset = 0;
+            elements.back().properties.push_back(prop);
+        }
+        else if (keyword == "end_header")
+        {
+            done = true;
+        }
+        // comment, obj_info and unknown keywords are ignored
+    }
+    if (!done) return false;
+
+
+    // record layout of binary elements without lists
+    for (size_t i = 0; i < elements.size(); ++i)
+    {
+        Ply_element& e = elements[i];
+        size_t offset = 0;
+        bool   fixed  = true;
+        for (size_t k = 0; k < e.properties.size(); ++k)
+        {
+            if (e.properties[k].count_type != PLY_NONE) fixed = false;
+            e.properties[k].offset = offset;
+            offset += ply_type_size(e.properties[k].type);
+        }
+        e.stride = fixed ? offset : 0;
+    }
+
+
+    // clear mesh
+    mesh.clear();
+
+
+    // body
+    Ply_cursor in(p, end, format);
+    for (size_t i = 0; i < elements.size(); ++i)
+    {
+        const Ply_element& e = elements[i];
+
+        if (e.name == "vertex")
+        {
+            // the faces of any later face element, a closed triangle mesh
+            // has about 3 edges per vertex
+            unsigned int nF = 0;
+            for (size_t j = i+1; j < elements.size(); ++j)
+                if (elements[j].name == "face") nF = elements[j].count;
+            mesh.reserve(e.count, std::max(3*e.count, 3*nF/2), nF);
+            if (!read_ply_vertices(mesh, e, in, bounds, attributes)) return false;
+        }
+        else if (e.name == "face")
+        {
+            if (!read_ply_faces(mesh, e, in)) return false;
+        }
+        else
+        {
+            for (unsigned int j = 0; j < e.count; ++j)
+                if (!in.skip(e)) return false;
+        }
+    }
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// appends the raw bytes of t to a buffer
+template <typename T> void append(std::vector<char>& buffer, const T& t)
+{
+    const char* c = (const char*) &t;
+    buffer.insert(buffer.end(), c, c + sizeof(T));
+}
+
+
+bool write_ply(const Surface_mesh& mesh, const std::string& filename)
+{
+    FILE* out = fopen(filename.c_str(), "wb");
+    if (!out)
+        return false;
+
+
+    Surface_mesh::Vertex_property<Point>               points    = mesh.get_vertex_property<Point>("v:point");
+    Surface_mesh::Vertex_property<Normal>              normals   = mesh.get_vertex_property<Normal>("v:normal");
+    Surface_mesh::Vertex_property<Color>               colors    = mesh.get_vertex_property<Color>("v:color");
+    Surface_mesh::Vertex_property<Texture_coordinate>  texcoords = mesh.get_vertex_property<Texture_coordinate>("v:texcoord");
+
+    // other float vertex properties are written under their name
+    std::vector<std::string> names;
+    std::vector<Surface_mesh::Vertex_property<float> > extra;
+    const std::vector<std::string> props = mesh.vertex_properties();
+    for (size_t i = 0; i < props.size(); ++i)
+    {
+        Surface_mesh::Vertex_property<float> prop = mesh.get_vertex_property<float>(props[i]);
+        if (prop && props[i].compare(0, 2, "v:") == 0)
+        {
+            names.push_back(props[i].substr(2));
+            extra.push_back(prop);
+        }
+    }
+
+
+    // header, binary in the byte order of this machine
+    fprintf(out, "ply\n");
+    fprintf(out, "format %s 1.0\n", host_is_little_endian() ? "binary_little_endian"
+                                                            : "binary_big_endian");
+    fprintf(out, "element vertex %d\n", mesh.n_vertices());
+    fprintf(out, "property float x\nproperty float y\nproperty float z\n");
+    if (normals)
+        fprintf(out, "property float nx\nproperty float ny\nproperty float nz\n");
+    if (colors)
+        fprintf(out, "property uchar red\nproperty uchar green\nproperty uchar blue\n");
+    if (texcoords)
+        fprintf(out, "property float u\nproperty float v\n");
+    for (size_t i = 0; i < names.size(); ++i)
+        fprintf(out, "property float %s\n", names[i].c_str());
+    fprintf(out, "element face %d\n", mesh.n_faces());
+    fprintf(out, "property list uchar int vertex_indices\n");
+    fprintf(out, "end_header\n");
+
+
+    // vertices, written as one block
+    std::vector<char> buffer;
+    buffer.reserve(mesh.n_vertices() * (12 + (normals ? 12 : 0) + (colors ? 3 : 0) +
+                                        (texcoords ? 8 : 0) + 4*extra.size()));
+    for (Surface_mesh::Vertex_iterator vit=mesh.vertices_begin(); vit!=mesh.vertices_end(); ++vit)
+    {
+        const Point& p = points[*vit];
+        append(buffer, p[0]); append(buffer, p[1]); append(buffer, p[2]);
+
+        if (normals)
+        {
+            const Normal& n = normals[*vit];
+            append(buffer, n[0]); append(buffer, n[1]); append(buffer, n[2]);
+        }
+
+        if (colors)
+        {
+            const Color& c = colors[*vit];
+            for (int k = 0; k < 3; ++k)
+            {
+                const float s = std::min(std::max(c[k], 0.0f), 1.0f);
+                append(buffer, (unsigned char) (s * 255.0f + 0.5f));
+            }
+        }
+
+        if (texcoords)
+        {
+            const Texture_coordinate& t = texcoords[*vit];
+            append(buffer, t[0]); append(buffer, t[1]);
+        }
+
+        for (size_t i = 0; i < extra.size(); ++i)
+            append(buffer, extra[i][*vit]);
+    }
+    if (!buffer.empty()) fwrite(&buffer[0], 1, buffer.size(), out);
+
+
+    // faces
+    buffer.clear();
+    for (Surface_mesh::Face_iterator fit=mesh.faces_begin(); fit!=mesh.faces_end(); ++fit)
+    {
+        append(buffer, (unsigned char) mesh.valence(*fit));
+        Surface_mesh::Vertex_around_face_circulator fvit=mesh.vertices(*fit), fvend=fvit;
+        do
+        {
+            append(buffer, (int) (*fvit).idx());
+        }
+        while (++fvit != fvend);
+    }
+    if (!buffer.empty()) fwrite(&buffer[0], 1, buffer.size(), out);
+
+    const bool ok = !ferror(out);
+    fclose(out);
+    return ok;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
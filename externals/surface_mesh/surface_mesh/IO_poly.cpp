@@ -1,12 +1,17 @@
-
-
-
 //== INCLUDES =================================================================
 
 
 #include <surface_mesh/IO.h>
+#include <surface_mesh/Block_reader.h>
+#include <surface_mesh/Mapped_file.h>
 
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 
 //== NAMESPACES ===============================================================
@@ -18,61 +23,738 @@ namespace surface_mesh {
 //== IMPLEMENTATION ===========================================================
 
 
-// helper function
-template <typename T> size_t read(FILE* in, T& t)
+// Layout of a poly file, in host byte order:
+//
+//   char[8]     magic "SMPOLY\n\0"
+//   uint32      version
+//   uint32      number of vertices, edges, faces
+//   uint32      number of deleted vertices, edges, faces
+//   uint32      number of property records
+//
+// followed by one record per property:
+//
+//   uint32      element kind 'v', 'h', 'e' or 'f'
+//   uint32      type id, see visit_type()
+//   uint32      size of one element in bytes
+//   uint32      length of the name
+//   char[]      name, zero padded to a multiple of 8
+//   byte[]      raw array of the property, zero padded to a multiple of 8
+//
+// Every array starts 8 byte aligned. The reader streams the file through a
+// Block_reader and copies each array straight into its property, map_poly()
+// leaves the arrays where they are in a mapping of the file. Files without
+// the magic are read in the old layout of three counts followed by the
+// connectivity and point arrays.
+
+
+static const char         poly_magic[8] = { 'S','M','P','O','L','Y','\n','\0' };
+static const unsigned int poly_version  = 1;
+
+
+//-----------------------------------------------------------------------------
+
+
+// element kinds and their property containers
+struct Poly_container
+{
+    unsigned int        kind;
+    Property_container* props;
+};
+
+
+// call f.apply<T>() for the property type with the given id. the ids are
+// part of the file format, only append to this list.
+template <class F> bool visit_type(unsigned int id, F& f)
 {
-    return fread((char*)&t, 1, sizeof(t), in);
+    switch (id)
+    {
+        case  0: f.template apply<bool>();                                 return true;
+        case  1: f.template apply<Surface_mesh::Vertex_connectivity>();    return true;
+        case  2: f.template apply<Surface_mesh::Halfedge_connectivity>();  return true;
+        case  3: f.template apply<Surface_mesh::Face_connectivity>();      return true;
+        case  4: f.template apply<Surface_mesh::Vertex>();                 return true;
+        case  5: f.template apply<Surface_mesh::Halfedge>();               return true;
+        case  6: f.template apply<Surface_mesh::Edge>();                   return true;
+        case  7: f.template apply<Surface_mesh::Face>();                   return true;
+        case  8: f.template apply<unsigned char>();                        return true;
+        case  9: f.template apply<int>();                                  return true;
+        case 10: f.template apply<unsigned int>();                         return true;
+        case 11: f.template apply<float>();                                return true;
+        case 12: f.template apply<double>();                               return true;
+        case 13: f.template apply<Vec2f>();                                return true;
+        case 14: f.template apply<Vec3f>();                                return true;
+        case 15: f.template apply<Vec4f>();                                return true;
+        case 16: f.template apply<Vec3d>();                                return true;
+        case 17: f.template apply<Half>();                                 return true;
+    }
+    return false;
 }
 
+static const unsigned int n_poly_types = 18;
+
+
+// size of one element of type T in the file
+template <class T> size_t poly_element_size()       { return sizeof(T); }
+template <>        size_t poly_element_size<bool>() { return 1; }
+
+
+// finds the type id and element size of a property
+struct Poly_type_of
+{
+    Poly_type_of(const std::type_info& type) : type_(type), match_(false), size_(0) {}
+
+    template <class T> void apply()
+    {
+        match_ = (typeid(T) == type_);
+        size_  = poly_element_size<T>();
+    }
+
+    const std::type_info& type_;
+    bool                  match_;
+    size_t                size_;
+};
+
 
 //-----------------------------------------------------------------------------
 
 
-bool read_poly(Surface_mesh& mesh, const std::string& filename)
+inline size_t poly_padding(size_t n)
 {
-    unsigned int n_items;
+    return (8 - n % 8) % 8;
+}
 
-    // open file (in binary mode)
-    FILE* in = fopen(filename.c_str(), "rb");
-    if (!in) return false;
+
+// where the writer puts the bytes, a file or a block of memory
+struct Poly_output
+{
+    virtual ~Poly_output() {}
+    virtual void write(const void* data, size_t n) = 0;
+};
 
 
-    // clear mesh
-    mesh.clear();
+struct Poly_file_output : public Poly_output
+{
+    explicit Poly_file_output(FILE* out) : out_(out) {}
+    void write(const void* data, size_t n) { if (n) fwrite(data, 1, n, out_); }
+    FILE* out_;
+};
+
+
+// counts the bytes and copies only as many as fit
+struct Poly_memory_output : public Poly_output
+{
+    Poly_memory_output(char* dst, size_t capacity)
+        : dst_(dst), capacity_(capacity), size_(0) {}
+
+    void write(const void* data, size_t n)
+    {
+        if (size_ + n <= capacity_ && n) memcpy(dst_ + size_, data, n);
+        size_ += n;
+    }
+
+    char*  dst_;
+    size_t capacity_;
+    size_t size_;
+};
+
+
+// writes one property array and its record header
+struct Poly_writer
+{
+    Poly_writer(Poly_output& out, const Poly_container& c, const std::string& name,
+                unsigned int type)
+        : out_(out), c_(c), name_(name), type_(type) {}
+
+    template <class T> void apply()
+    {
+        Property<T> p = c_.props->get<T>(name_);
+        const Property_vector<T>& data = p.vector();
 
+        const unsigned int header[4] = { c_.kind, type_,
+                                         (unsigned int) poly_element_size<T>(),
+                                         (unsigned int) name_.size() };
+        out_.write(header, sizeof(header));
+        out_.write(name_.c_str(), name_.size());
+        pad(name_.size());
+
+        if (!data.empty())
+            out_.write(&data[0], sizeof(T) * data.size());
+        pad(sizeof(T) * data.size());
+    }
+
+    void pad(size_t n)
+    {
+        static const char zeros[8] = { 0 };
+        out_.write(zeros, poly_padding(n));
+    }
+
+    Poly_output&          out_;
+    const Poly_container& c_;
+    const std::string&    name_;
+    unsigned int          type_;
+};
+
+
+// bools are packed into bits, write one byte per element
+template <> void Poly_writer::apply<bool>()
+{
+    Property<bool> p = c_.props->get<bool>(name_);
+    const Bit_vector& data = p.vector();
+    std::vector<unsigned char> bytes(data.size(), 0);
+    data.for_each_set([&](size_t i) { bytes[i] = 1; });
+
+    const unsigned int header[4] = { c_.kind, type_, 1, (unsigned int) name_.size() };
+    out_.write(header, sizeof(header));
+    out_.write(name_.c_str(), name_.size());
+    pad(name_.size());
+
+    if (!bytes.empty())
+        out_.write(&bytes[0], bytes.size());
+    pad(bytes.size());
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// reads from a block of memory with the interface of Block_reader
+struct Poly_memory_input
+{
+    Poly_memory_input(const char* src, size_t size) : p_(src), remaining_(size) {}
+
+    size_t remaining() const { return remaining_; }
+
+    bool read(void* dst, size_t n)
+    {
+        if (n > remaining_) return false;
+        memcpy(dst, p_, n);
+        p_ += n; remaining_ -= n;
+        return true;
+    }
+
+    bool skip(size_t n)
+    {
+        if (n > remaining_) return false;
+        p_ += n; remaining_ -= n;
+        return true;
+    }
+
+    const char* p_;
+    size_t      remaining_;
+};
+
+
+// reads one property array from the input straight into the property
+template <class Input>
+struct Poly_reader
+{
+    Poly_reader(const Poly_container& c, const std::string& name, size_t, bool, Input& in)
+        : c_(c), name_(name), in_(in), ok_(false), read_(false) {}
+
+    // the arrays are read into containers of their final size
+    static void prepare(const Poly_container containers[4], const size_t sizes[4])
+    {
+        for (int i = 0; i < 4; ++i) containers[i].props->resize(sizes[i]);
+    }
+    static void finish(const Poly_container[4], const size_t[4]) {}
+
+    template <class T> void apply()
+    {
+        Property<T> p = c_.props->template get<T>(name_);
+        if (!p)
+        {
+            // keep an existing property of another type
+            if (c_.props->get_type(name_) != typeid(void)) return;
+            p = c_.props->template add<T>(name_);
+        }
+        read_ = true;
+        ok_ = read_array(p.vector());
+    }
+
+    template <class T> bool read_array(Property_vector<T>& v)
+    {
+        return v.empty() || in_.read(&v[0], sizeof(T) * v.size());
+    }
+
+    // one byte per element, see Poly_writer
+    bool read_array(Bit_vector& v)
+    {
+        std::vector<char> bytes(v.size());
+        if (!bytes.empty() && !in_.read(&bytes[0], bytes.size())) return false;
+        uint64_t* words = v.words();
+        for (size_t w = 0; w < Bit_vector::n_words(v.size()); ++w)
+        {
+            uint64_t word = 0;
+            const size_t end = std::min(v.size(), 64 * (w + 1));
+            for (size_t i = 64 * w; i < end; ++i)
+                word |= uint64_t(bytes[i] != 0) << (i & 63);
+            words[w] = word;
+        }
+        return true;
+    }
+
+    const Poly_container& c_;
+    const std::string&    name_;
+    Input&                in_;
+    bool                  ok_;    // property read
+    bool                  read_;  // data consumed, successfully or not
+};
+
+
+#ifdef SURFACE_MESH_MAPPED_STORAGE
+
+// a copy-on-write mapping read like a block of memory, which the arrays
+// can take over
+struct Poly_mapped_input : public Poly_memory_input
+{
+    explicit Poly_mapped_input(const std::shared_ptr<Mapped_file>& file)
+        : Poly_memory_input(file->begin(), file->size()), file_(file) {}
+
+    // the next bytes, writable
+    char* position() const { return file_->writable() + (p_ - file_->begin()); }
+
+    std::shared_ptr<Mapped_file> file_;
+};
+
+
+// hands one property array its bytes in the mapping; arrays that cannot
+// take them over are copied, those of bool converted
+struct Poly_mapper
+{
+    Poly_mapper(const Poly_container& c, const std::string& name, size_t n, bool unset,
+                Poly_mapped_input& in)
+        : c_(c), name_(name), n_(n), unset_(unset), in_(in), ok_(false), read_(false) {}
+
+    // the containers get their size, and the arrays that are not in the
+    // file their elements, after the others were taken over
+    static void prepare(const Poly_container[4], const size_t[4]) {}
+    static void finish(const Poly_container containers[4], const size_t sizes[4])
+    {
+        for (int i = 0; i < 4; ++i) containers[i].props->resize(sizes[i]);
+    }
+
+    template <class T> void apply()
+    {
+        Property<T> p = c_.props->template get<T>(name_);
+        if (!p)
+        {
+            if (c_.props->get_type(name_) != typeid(void)) return;
+            p = c_.props->template add<T>(name_);
+        }
+        read_ = true;
+        ok_ = map_array(p);
+    }
+
+    template <class T> bool map_array(Property<T>& p)
+    {
+        char* data = in_.position();
+        const bool aligned = reinterpret_cast<size_t>(data) % std::alignment_of<T>::value == 0;
+        if (aligned && p.adopt(data, n_, in_.file_)) return in_.skip(sizeof(T) * n_);
+
+        p.vector().resize(n_);
+        Poly_reader<Poly_mapped_input> reader(c_, name_, n_, false, in_);
+        return reader.read_array(p.vector());
+    }
+
+    // flags, e.g. the deleted ones, are mostly unset: only the words of the
+    // file that are not 0 are looked at, none if all are known to be unset
+    bool map_array(Property<bool>& p)
+    {
+        Bit_vector& v = p.vector();
+        v.assign(n_, false);
+        if (unset_) return in_.skip(n_);
+        const char* bytes = in_.p_;
+        size_t i = 0;
+        for (; i + 8 <= n_; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i, sizeof(word));
+            if (word == 0) continue;
+            for (size_t k = i; k < i + 8; ++k) v[k] = (bytes[k] != 0);
+        }
+        for (; i < n_; ++i) v[i] = (bytes[i] != 0);
+        return in_.skip(n_);
+    }
+
+    const Poly_container& c_;
+    const std::string&    name_;
+    size_t                n_;
+    bool                  unset_;
+    Poly_mapped_input&    in_;
+    bool                  ok_;
+    bool                  read_;
+};
+
+#endif
+
+
+
+//-----------------------------------------------------------------------------
+
+
+// reads the layout of files written before the poly format had a header:
+// the element counts followed by the connectivity and point arrays
+static bool read_poly_legacy(const Poly_container containers[4], const Mapped_file& file)
+{
+    typedef Surface_mesh::Vertex_connectivity    Vertex_connectivity;
+    typedef Surface_mesh::Halfedge_connectivity  Halfedge_connectivity;
+    typedef Surface_mesh::Face_connectivity      Face_connectivity;
+
+    const char* p = file.begin();
+    if (file.size() < 3*sizeof(unsigned int)) return false;
 
     // how many elements?
     unsigned int nv, ne, nh, nf;
-    read(in, nv);
-    read(in, ne);
-    read(in, nf);
+    memcpy(&nv, p,   sizeof(unsigned int));
+    memcpy(&ne, p+4, sizeof(unsigned int));
+    memcpy(&nf, p+8, sizeof(unsigned int));
     nh = 2*ne;
+    p += 12;
+
+    const size_t n_bytes = 12 +
+        nv * sizeof(Vertex_connectivity) +
+        nh * sizeof(Halfedge_connectivity) +
+        nf * sizeof(Face_connectivity) +
+        nv * sizeof(Point);
+    if (file.size() < n_bytes) return false;
 
 
     // resize containers
-    mesh.vprops_.resize(nv);
-    mesh.hprops_.resize(nh);
-    mesh.eprops_.resize(ne);
-    mesh.fprops_.resize(nf);
+    containers[0].props->resize(nv);
+    containers[1].props->resize(nh);
+    containers[2].props->resize(ne);
+    containers[3].props->resize(nf);
 
 
     // get properties
-    Surface_mesh::Vertex_property<Surface_mesh::Vertex_connectivity>      vconn = mesh.vertex_property<Surface_mesh::Vertex_connectivity>("v:connectivity");
-    Surface_mesh::Halfedge_property<Surface_mesh::Halfedge_connectivity>  hconn = mesh.halfedge_property<Surface_mesh::Halfedge_connectivity>("h:connectivity");
-    Surface_mesh::Face_property<Surface_mesh::Face_connectivity>          fconn = mesh.face_property<Surface_mesh::Face_connectivity>("f:connectivity");
-    Surface_mesh::Vertex_property<Point>                                  point = mesh.vertex_property<Point>("v:point");
-
-    // read properties from file
-    n_items = fread((char*)vconn.data(), sizeof(Surface_mesh::Vertex_connectivity),   nv, in);
-    n_items = fread((char*)hconn.data(), sizeof(Surface_mesh::Halfedge_connectivity), nh, in);
-    n_items = fread((char*)fconn.data(), sizeof(Surface_mesh::Face_connectivity),     nf, in);
-    n_items = fread((char*)point.data(), sizeof(Point),                               nv, in);
-
-    fclose(in);
+    Property<Vertex_connectivity>    vconn = containers[0].props->get<Vertex_connectivity>("v:connectivity");
+    Property<Halfedge_connectivity>  hconn = containers[1].props->get<Halfedge_connectivity>("h:connectivity");
+    Property<Face_connectivity>      fconn = containers[3].props->get<Face_connectivity>("f:connectivity");
+    Property<Point>                  point = containers[0].props->get<Point>("v:point");
+
+    // copy properties from file
+    if (nv) memcpy(&vconn.vector()[0], p, nv * sizeof(Vertex_connectivity));
+    p += nv * sizeof(Vertex_connectivity);
+    if (nh) memcpy(&hconn.vector()[0], p, nh * sizeof(Halfedge_connectivity));
+    p += nh * sizeof(Halfedge_connectivity);
+    if (nf) memcpy(&fconn.vector()[0], p, nf * sizeof(Face_connectivity));
+    p += nf * sizeof(Face_connectivity);
+    if (nv) memcpy(&point.vector()[0], p, nv * sizeof(Point));
+
     return true;
 }
 
 
+//-----------------------------------------------------------------------------
+
+
+// the deleted flags of elements none of which are deleted by the header,
+// all of them are unset
+static bool unset_flags(unsigned int kind, const std::string& name, const unsigned int header[8])
+{
+    const int i = kind == 'v' ? 4 : kind == 'e' ? 5 : kind == 'f' ? 6 : 0;
+    return i && header[i] == 0 && name.size() == 9 && name[0] == char(kind) &&
+           name.compare(1, 8, ":deleted") == 0;
+}
+
+
+// reads the header and the property records that follow the magic, each
+// array with a Reader. the numbers of deleted vertices, edges and faces go
+// to \c deleted.
+template <class Input, class Reader>
+static bool read_poly_records(const Poly_container containers[4],
+                              unsigned int deleted[3], Input& in)
+{
+    // header
+    unsigned int header[8];
+    if (!in.read(header, sizeof(header))) return false;
+    if (header[0] != poly_version)
+    {
+        std::cerr << "[read_poly] unsupported version " << header[0] << std::endl;
+        return false;
+    }
+    const unsigned int nv = header[1], ne = header[2], nf = header[3];
+    const unsigned int n_records = header[7];
+
+
+    // the elements of the containers, in the order v, h, e, f
+    const size_t sizes[4] = { nv, 2*size_t(ne), ne, nf };
+    Reader::prepare(containers, sizes);
+
+
+    // property records
+    for (unsigned int r = 0; r < n_records; ++r)
+    {
+        unsigned int record[4];
+        if (!in.read(record, sizeof(record))) return false;
+
+        const unsigned int kind = record[0], type = record[1];
+        const size_t element_size = record[2], name_size = record[3];
+
+        const Poly_container* c = 0;
+        size_t                n = 0;
+        for (int i = 0; i < 4; ++i)
+            if (containers[i].kind == kind) { c = &containers[i]; n = sizes[i]; }
+        if (!c) return false;
+
+        if (in.remaining() < name_size + poly_padding(name_size)) return false;
+        std::string name(name_size, '\0');
+        if (name_size) in.read(&name[0], name_size);
+        in.skip(poly_padding(name_size));
+
+        const size_t data_size = element_size * n;
+        if (in.remaining() < data_size) return false;
+
+        // skip unknown types and types whose size differs on this platform
+        Poly_type_of  type_of(typeid(void));
+        Reader        reader(*c, name, n, unset_flags(kind, name, header), in);
+        if (visit_type(type, type_of) && type_of.size_ == element_size)
+            visit_type(type, reader);
+        if (reader.read_ && !reader.ok_) return false;
+        if (!reader.ok_)
+        {
+            std::cerr << "[read_poly] skipping property " << name << std::endl;
+            in.skip(data_size);
+        }
+
+        in.skip(poly_padding(data_size));
+    }
+    Reader::finish(containers, sizes);
+
+    deleted[0] = header[4];
+    deleted[1] = header[5];
+    deleted[2] = header[6];
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_poly(Surface_mesh& mesh, const std::string& filename)
+{
+    // read the whole file front to back, in blocks
+    Block_reader in;
+    if (!in.open(filename)) return false;
+
+
+    // clear mesh
+    mesh.clear();
+
+    const Poly_container containers[4] = { { 'v', &mesh.vprops_ },
+                                           { 'h', &mesh.hprops_ },
+                                           { 'e', &mesh.eprops_ },
+                                           { 'f', &mesh.fprops_ } };
+
+
+    // old files start with the element counts, they are read from a mapping
+    char magic[sizeof(poly_magic)];
+    if (!in.read(magic, sizeof(magic)) ||
+        memcmp(magic, poly_magic, sizeof(poly_magic)) != 0)
+    {
+        in.close();
+        Mapped_file file;
+        if (!file.open(filename)) return false;
+        return read_poly_legacy(containers, file);
+    }
+
+    unsigned int deleted[3];
+    if (!read_poly_records<Block_reader, Poly_reader<Block_reader> >(containers, deleted, in))
+        return false;
+
+
+    // deleted elements
+    mesh.deleted_vertices_ = deleted[0];
+    mesh.deleted_edges_    = deleted[1];
+    mesh.deleted_faces_    = deleted[2];
+    mesh.garbage_ = (deleted[0] || deleted[1] || deleted[2]);
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_poly(Surface_mesh& mesh, const char* src, size_t size)
+{
+    mesh.clear();
+
+    const Poly_container containers[4] = { { 'v', &mesh.vprops_ },
+                                           { 'h', &mesh.hprops_ },
+                                           { 'e', &mesh.eprops_ },
+                                           { 'f', &mesh.fprops_ } };
+
+    Poly_memory_input in(src, size);
+    char magic[sizeof(poly_magic)];
+    if (!in.read(magic, sizeof(magic)) ||
+        memcmp(magic, poly_magic, sizeof(poly_magic)) != 0)
+        return false;
+
+    unsigned int deleted[3];
+    if (!read_poly_records<Poly_memory_input, Poly_reader<Poly_memory_input> >(containers,
+                                                                               deleted, in))
+        return false;
+
+    mesh.deleted_vertices_ = deleted[0];
+    mesh.deleted_edges_    = deleted[1];
+    mesh.deleted_faces_    = deleted[2];
+    mesh.garbage_ = (deleted[0] || deleted[1] || deleted[2]);
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool map_poly(Surface_mesh& mesh, const std::string& filename)
+{
+#ifdef SURFACE_MESH_MAPPED_STORAGE
+    std::shared_ptr<Mapped_file> file = std::make_shared<Mapped_file>();
+    if (!file->open(filename, true)) return false;
+
+    // old files are read as by read_poly()
+    if (file->size() < sizeof(poly_magic) ||
+        memcmp(file->begin(), poly_magic, sizeof(poly_magic)) != 0)
+    {
+        file->close();
+        return read_poly(mesh, filename);
+    }
+
+    mesh.clear();
+
+    const Poly_container containers[4] = { { 'v', &mesh.vprops_ },
+                                           { 'h', &mesh.hprops_ },
+                                           { 'e', &mesh.eprops_ },
+                                           { 'f', &mesh.fprops_ } };
+
+    // the arrays that take over their bytes keep the mapping alive
+    Poly_mapped_input in(file);
+    in.skip(sizeof(poly_magic));
+
+    unsigned int deleted[3];
+    if (!read_poly_records<Poly_mapped_input, Poly_mapper>(containers, deleted, in))
+    {
+        mesh.clear();
+        return false;
+    }
+
+    mesh.deleted_vertices_ = deleted[0];
+    mesh.deleted_edges_    = deleted[1];
+    mesh.deleted_faces_    = deleted[2];
+    mesh.garbage_ = (deleted[0] || deleted[1] || deleted[2]);
+
+    return true;
+#else
+    return read_poly(mesh, filename);
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// writes the magic, the header and every property of a supported type
+static void write_poly_records(const Poly_container containers[4],
+                               const unsigned int deleted[3], Poly_output& out)
+{
+    // collect the properties we know how to store
+    std::vector< std::pair<const Poly_container*, std::string> > records;
+    std::vector<unsigned int> types;
+    for (int i = 0; i < 4; ++i)
+    {
+        const std::vector<std::string> names = containers[i].props->properties();
+        for (size_t j = 0; j < names.size(); ++j)
+        {
+            Poly_type_of type_of(containers[i].props->get_type(names[j]));
+            unsigned int type = 0;
+            for (; type < n_poly_types; ++type)
+                if (visit_type(type, type_of) && type_of.match_) break;
+
+            if (type == n_poly_types)
+            {
+                std::cerr << "[write_poly] skipping property " << names[j]
+                          << " of unsupported type" << std::endl;
+                continue;
+            }
+            records.push_back(std::make_pair(&containers[i], names[j]));
+            types.push_back(type);
+        }
+    }
+
+
+    // header
+    const unsigned int header[8] = { poly_version,
+                                     (unsigned int) containers[0].props->size(),
+                                     (unsigned int) containers[2].props->size(),
+                                     (unsigned int) containers[3].props->size(),
+                                     deleted[0],
+                                     deleted[1],
+                                     deleted[2],
+                                     (unsigned int) records.size() };
+    out.write(poly_magic, sizeof(poly_magic));
+    out.write(header, sizeof(header));
+
+
+    // property records
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        Poly_writer writer(out, *records[i].first, records[i].second, types[i]);
+        visit_type(types[i], writer);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool write_poly(const Surface_mesh& mesh, const std::string& filename)
+{
+    // open file (in binary mode)
+    FILE* out = fopen(filename.c_str(), "wb");
+    if (!out) return false;
+
+
+    // the containers are only read from
+    Surface_mesh& m = const_cast<Surface_mesh&>(mesh);
+    const Poly_container containers[4] = { { 'v', &m.vprops_ },
+                                           { 'h', &m.hprops_ },
+                                           { 'e', &m.eprops_ },
+                                           { 'f', &m.fprops_ } };
+    const unsigned int deleted[3] = { m.deleted_vertices_,
+                                      m.deleted_edges_,
+                                      m.deleted_faces_ };
+
+    Poly_file_output output(out);
+    write_poly_records(containers, deleted, output);
+
+    const bool ok = !ferror(out);
+    fclose(out);
+    return ok;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+size_t write_poly(const Surface_mesh& mesh, char* dst, size_t capacity)
+{
+    Surface_mesh& m = const_cast<Surface_mesh&>(mesh);
+    const Poly_container containers[4] = { { 'v', &m.vprops_ },
+                                           { 'h', &m.hprops_ },
+                                           { 'e', &m.eprops_ },
+                                           { 'f', &m.fprops_ } };
+    const unsigned int deleted[3] = { m.deleted_vertices_,
+                                      m.deleted_edges_,
+                                      m.deleted_faces_ };
+
+    Poly_memory_output output(dst, capacity);
+    write_poly_records(containers, deleted, output);
+    return output.size_;
+}
+
+
 //=============================================================================
 } // namespace surface_mesh
 //=============================================================================
@@ -0,0 +1,1110 @@
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/IO.h>
+#include <surface_mesh/Mapped_file.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+
+//== NAMESPACES ===============================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+// Layout of a compressed mesh file, in host byte order:
+//
+//   char[8]     magic "SMCMPR\n\0"
+//   uint32      version
+//   uint32      flags, smc_entropy_coded if the payload is range coded
+//   uint32      quantization bits per coordinate
+//   uint32      number of vertices, triangles and hole vertices of the
+//               closed triangle mesh that is coded
+//   float[4]    origin and cell size of the quantization grid
+//   uint32[]    traversal numbers of the hole vertices
+//   uint32      size of the payload in bytes
+//   byte[]      payload
+//
+// The writer triangulates the faces, gives a vertex one copy per fan of
+// faces around it and closes every hole by a fan of triangles around an
+// added hole vertex. That closed mesh is coded by Edgebreaker (Rossignac):
+// a traversal from triangle to triangle labels each one by what it shares
+// with the triangles before it, and numbers the vertices as it reaches
+// them. Both sides keep the boundary of the triangles so far as loops of
+// edges, the current one is the gate the next triangle is entered over:
+//
+//   C   the third vertex is new, it goes into the loop
+//   L   the third vertex is the one before the gate on the loop
+//   R   the third vertex is the one after the gate on the loop
+//   E   the triangle closes a loop of three edges
+//   S   the third vertex is further along the loop, given by its offset,
+//       it splits the loop in two
+//   M   the third vertex is on another loop, given by the number of its
+//       edge, the loops join (once per handle)
+//
+// The positions are quantized to a grid over the bounding box, each new
+// vertex is predicted by the parallelogram rule from the triangle on the
+// other side of the gate. The payload is the labels, offsets and position
+// residuals in traversal order, coded by an adaptive binary range coder or
+// packed as plain bits.
+
+
+static const char         smc_magic[8]      = { 'S','M','C','M','P','R','\n','\0' };
+static const unsigned int smc_version       = 1;
+static const unsigned int smc_entropy_coded = 1;
+
+
+//-----------------------------------------------------------------------------
+
+
+// labels of the triangles, SMC_START is the context of a component's first
+enum Smc_op { SMC_C, SMC_L, SMC_R, SMC_E, SMC_S, SMC_M, SMC_START };
+
+static const unsigned int smc_op_bits     = 3;
+static const unsigned int smc_n_contexts  = SMC_START + 1;
+// numbers are coded as their bit length, then the bits below the leading one
+static const unsigned int smc_length_bits = 6;
+// number models: offsets and edge numbers, then one per coordinate
+static const unsigned int smc_n_models    = 4;
+
+
+static inline unsigned int bit_length(uint32_t value)
+{
+    unsigned int n = 0;
+    while (value) { value >>= 1; ++n; }
+    return n;
+}
+
+
+static inline uint32_t zigzag(int32_t value)
+{
+    return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+
+static inline int32_t unzigzag(uint32_t value)
+{
+    return int32_t(value >> 1) ^ -int32_t(value & 1);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// adaptive binary range coder of LZMA, probabilities of a 0 in 11 bits
+static const unsigned int rc_prob_bits = 11;
+static const unsigned int rc_move_bits = 5;
+static const uint32_t     rc_top       = 1u << 24;
+static const uint16_t     rc_half      = 1u << (rc_prob_bits - 1);
+
+
+class Range_encoder
+{
+public:
+
+    explicit Range_encoder(std::vector<unsigned char>& out)
+        : out_(out), low_(0), range_(0xFFFFFFFFu), cache_(0), cache_size_(1)
+    {
+        std::fill(&op_probs_[0][0], &op_probs_[0][0] + smc_n_contexts * (1u << smc_op_bits), rc_half);
+        std::fill(&length_probs_[0][0], &length_probs_[0][0] + smc_n_models * (1u << smc_length_bits), rc_half);
+    }
+
+    void op(unsigned int op, unsigned int context)
+    {
+        encode_tree(op_probs_[context], smc_op_bits, op);
+    }
+
+    void number(uint32_t value, unsigned int model)
+    {
+        const unsigned int length = bit_length(value);
+        encode_tree(length_probs_[model], smc_length_bits, length);
+        if (length > 1) encode_direct(value, length - 1);
+    }
+
+    void finish()
+    {
+        for (int i = 0; i < 5; ++i) shift_low();
+    }
+
+private:
+
+    void encode_bit(uint16_t& prob, unsigned int bit)
+    {
+        const uint32_t bound = (range_ >> rc_prob_bits) * prob;
+        if (!bit)
+        {
+            range_ = bound;
+            prob += ((1u << rc_prob_bits) - prob) >> rc_move_bits;
+        }
+        else
+        {
+            low_   += bound;
+            range_ -= bound;
+            prob   -= prob >> rc_move_bits;
+        }
+        while (range_ < rc_top) { range_ <<= 8; shift_low(); }
+    }
+
+    // the low n bits of value at probability 1/2, highest first
+    void encode_direct(uint32_t value, unsigned int n)
+    {
+        while (n--)
+        {
+            range_ >>= 1;
+            if ((value >> n) & 1) low_ += range_;
+            while (range_ < rc_top) { range_ <<= 8; shift_low(); }
+        }
+    }
+
+    void encode_tree(uint16_t* probs, unsigned int n, unsigned int value)
+    {
+        unsigned int m = 1;
+        while (n--)
+        {
+            const unsigned int bit = (value >> n) & 1;
+            encode_bit(probs[m], bit);
+            m = (m << 1) | bit;
+        }
+    }
+
+    // bytes of low leave once a carry cannot reach them any more
+    void shift_low()
+    {
+        if (uint32_t(low_) < 0xFF000000u || (low_ >> 32) != 0)
+        {
+            unsigned char byte = cache_;
+            do
+            {
+                out_.push_back((unsigned char)(byte + (unsigned char)(low_ >> 32)));
+                byte = 0xFF;
+            }
+            while (--cache_size_ != 0);
+            cache_ = (unsigned char)(uint32_t(low_) >> 24);
+        }
+        ++cache_size_;
+        low_ = uint32_t(uint32_t(low_) << 8);
+    }
+
+    std::vector<unsigned char>& out_;
+    uint64_t       low_;
+    uint32_t       range_;
+    unsigned char  cache_;
+    uint64_t       cache_size_;
+    uint16_t       op_probs_[smc_n_contexts][1u << smc_op_bits];
+    uint16_t       length_probs_[smc_n_models][1u << smc_length_bits];
+};
+
+
+class Range_decoder
+{
+public:
+
+    Range_decoder(const unsigned char* begin, const unsigned char* end)
+        : p_(begin), end_(end), range_(0xFFFFFFFFu), code_(0)
+    {
+        std::fill(&op_probs_[0][0], &op_probs_[0][0] + smc_n_contexts * (1u << smc_op_bits), rc_half);
+        std::fill(&length_probs_[0][0], &length_probs_[0][0] + smc_n_models * (1u << smc_length_bits), rc_half);
+        for (int i = 0; i < 5; ++i) code_ = (code_ << 8) | next_byte();
+    }
+
+    unsigned int op(unsigned int context)
+    {
+        return decode_tree(op_probs_[context], smc_op_bits);
+    }
+
+    uint32_t number(unsigned int model)
+    {
+        const unsigned int length = decode_tree(length_probs_[model], smc_length_bits);
+        if (length == 0 || length > 32) return 0;
+        return (uint32_t(1) << (length - 1)) | decode_direct(length - 1);
+    }
+
+private:
+
+    unsigned char next_byte() { return p_ < end_ ? *p_++ : 0; }
+
+    unsigned int decode_bit(uint16_t& prob)
+    {
+        const uint32_t bound = (range_ >> rc_prob_bits) * prob;
+        unsigned int bit;
+        if (code_ < bound)
+        {
+            range_ = bound;
+            prob += ((1u << rc_prob_bits) - prob) >> rc_move_bits;
+            bit = 0;
+        }
+        else
+        {
+            code_  -= bound;
+            range_ -= bound;
+            prob   -= prob >> rc_move_bits;
+            bit = 1;
+        }
+        while (range_ < rc_top) { range_ <<= 8; code_ = (code_ << 8) | next_byte(); }
+        return bit;
+    }
+
+    uint32_t decode_direct(unsigned int n)
+    {
+        uint32_t value = 0;
+        while (n--)
+        {
+            range_ >>= 1;
+            unsigned int bit = 0;
+            if (code_ >= range_) { code_ -= range_; bit = 1; }
+            value = (value << 1) | bit;
+            while (range_ < rc_top) { range_ <<= 8; code_ = (code_ << 8) | next_byte(); }
+        }
+        return value;
+    }
+
+    unsigned int decode_tree(uint16_t* probs, unsigned int n)
+    {
+        unsigned int m = 1;
+        for (unsigned int i = 0; i < n; ++i) m = (m << 1) | decode_bit(probs[m]);
+        return m - (1u << n);
+    }
+
+    const unsigned char* p_;
+    const unsigned char* end_;
+    uint32_t  range_;
+    uint32_t  code_;
+    uint16_t  op_probs_[smc_n_contexts][1u << smc_op_bits];
+    uint16_t  length_probs_[smc_n_models][1u << smc_length_bits];
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+// the same symbols as plain bits, highest first
+class Bit_encoder
+{
+public:
+
+    explicit Bit_encoder(std::vector<unsigned char>& out) : out_(out), bits_(0), n_(0) {}
+
+    void op(unsigned int op, unsigned int) { put(op, smc_op_bits); }
+
+    void number(uint32_t value, unsigned int)
+    {
+        const unsigned int length = bit_length(value);
+        put(length, smc_length_bits);
+        if (length > 1) put(value, length - 1);
+    }
+
+    void finish()
+    {
+        if (n_) out_.push_back((unsigned char)(bits_ << (8 - n_)));
+        n_ = 0;
+    }
+
+private:
+
+    void put(uint32_t value, unsigned int n)
+    {
+        bits_ = (bits_ << n) | (value & ((uint64_t(1) << n) - 1));
+        n_ += n;
+        while (n_ >= 8)
+        {
+            n_ -= 8;
+            out_.push_back((unsigned char)(bits_ >> n_));
+        }
+    }
+
+    std::vector<unsigned char>& out_;
+    uint64_t      bits_;
+    unsigned int  n_;
+};
+
+
+class Bit_decoder
+{
+public:
+
+    Bit_decoder(const unsigned char* begin, const unsigned char* end)
+        : p_(begin), end_(end), bits_(0), n_(0) {}
+
+    unsigned int op(unsigned int) { return get(smc_op_bits); }
+
+    uint32_t number(unsigned int)
+    {
+        const unsigned int length = get(smc_length_bits);
+        if (length == 0 || length > 32) return 0;
+        return (uint32_t(1) << (length - 1)) | get(length - 1);
+    }
+
+private:
+
+    uint32_t get(unsigned int n)
+    {
+        while (n_ < n)
+        {
+            bits_ = (bits_ << 8) | (p_ < end_ ? *p_++ : 0);
+            n_ += 8;
+        }
+        n_ -= n;
+        return uint32_t((bits_ >> n_) & ((uint64_t(1) << n) - 1));
+    }
+
+    const unsigned char* p_;
+    const unsigned char* end_;
+    uint64_t      bits_;
+    unsigned int  n_;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+// quantized position
+struct Smc_point
+{
+    int32_t x[3];
+};
+
+
+// prediction of a new vertex from the gate a, b and the vertex c across
+// it, by the parallelogram rule. a missing or hole vertex is -1 or has
+// its hole flag set; with fewer of them the midpoint of the gate, one
+// end, or the last vertex is used.
+static void smc_predict(const std::vector<Smc_point>& q, const std::vector<unsigned char>& hole,
+                        int a, int b, int c, const Smc_point& last, int32_t max, Smc_point& p)
+{
+    const bool use_a = a >= 0 && !hole[a];
+    const bool use_b = b >= 0 && !hole[b];
+    const bool use_c = c >= 0 && !hole[c];
+    for (int k = 0; k < 3; ++k)
+    {
+        if (use_a && use_b && use_c)
+            p.x[k] = std::min(std::max(q[a].x[k] + q[b].x[k] - q[c].x[k], 0), max);
+        else if (use_a && use_b)
+            p.x[k] = (q[a].x[k] + q[b].x[k]) / 2;
+        else if (use_a)
+            p.x[k] = q[a].x[k];
+        else if (use_b)
+            p.x[k] = q[b].x[k];
+        else
+            p.x[k] = last.x[k];
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// the loops of boundary edges of the triangles visited so far. the coder
+// and the decoder number the edges in the same order, so an edge number
+// names the same edge on both sides.
+struct Smc_loops
+{
+    std::vector<int>            next, prev;
+    std::vector<unsigned char>  alive;
+
+    int add()
+    {
+        next.push_back(-1);
+        prev.push_back(-1);
+        alive.push_back(1);
+        return int(next.size()) - 1;
+    }
+
+    void link(int a, int b) { next[a] = b; prev[b] = a; }
+
+    // the gate of the next loop on the stack that is not done yet, -1 if
+    // there is none
+    int pop(std::vector<int>& stack) const
+    {
+        while (!stack.empty())
+        {
+            const int e = stack.back();
+            stack.pop_back();
+            if (alive[e]) return e;
+        }
+        return -1;
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+// the closed triangle mesh that is coded: corner c of triangle c/3 is at
+// vertex V[c], O[c] is the corner across the edge opposite to c
+struct Smc_table
+{
+    std::vector<int>            V, O;
+    std::vector<Point>          points;
+    std::vector<unsigned char>  hole;
+};
+
+
+static inline int smc_next(int c) { return (c % 3 == 2) ? c - 2 : c + 1; }
+static inline int smc_prev(int c) { return (c % 3 == 0) ? c + 2 : c - 1; }
+
+
+static inline uint64_t smc_edge_key(int a, int b)
+{
+    return (uint64_t(uint32_t(a)) << 32) | uint32_t(b);
+}
+
+
+// O from V, false if an edge is used twice in the same direction. the
+// corners whose edge has no opposite go to unmatched, or fail without it.
+static bool smc_match_corners(Smc_table& table, std::vector<int>* unmatched)
+{
+    const int n = int(table.V.size());
+    std::vector< std::pair<uint64_t, int> > edges(n);
+    for (int c = 0; c < n; ++c)
+        edges[c] = std::make_pair(smc_edge_key(table.V[smc_next(c)], table.V[smc_prev(c)]), c);
+    std::sort(edges.begin(), edges.end());
+    for (int i = 1; i < n; ++i)
+        if (edges[i].first == edges[i-1].first) return false;
+
+    table.O.assign(n, -1);
+    for (int c = 0; c < n; ++c)
+    {
+        const std::pair<uint64_t, int> key(smc_edge_key(table.V[smc_prev(c)], table.V[smc_next(c)]), -1);
+        std::vector< std::pair<uint64_t, int> >::const_iterator it =
+            std::lower_bound(edges.begin(), edges.end(), key);
+        if (it != edges.end() && it->first == key.first)
+            table.O[c] = it->second;
+        else if (unmatched)
+            unmatched->push_back(c);
+        else
+            return false;
+    }
+    return true;
+}
+
+
+static int smc_find(std::vector<int>& parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+
+// the closed triangle mesh of mesh, false for an edge that has more than
+// two faces
+static bool smc_build_table(const Surface_mesh& mesh, Smc_table& table)
+{
+    // outgoing halfedges are in one fan if they are joined across the
+    // edges of their faces
+    const int n_halfedges = mesh.halfedges_size();
+    std::vector<int> parent(n_halfedges);
+    for (int i = 0; i < n_halfedges; ++i) parent[i] = i;
+
+    Surface_mesh::Face_iterator fit, fend = mesh.faces_end();
+    for (fit = mesh.faces_begin(); fit != fend; ++fit)
+    {
+        Surface_mesh::Halfedge_around_face_circulator hit = mesh.halfedges(*fit), hend = hit;
+        do
+        {
+            const int a = smc_find(parent, (*hit).idx());
+            const int b = smc_find(parent, mesh.opposite_halfedge(mesh.prev_halfedge(*hit)).idx());
+            parent[a] = b;
+        }
+        while (++hit != hend);
+    }
+
+    // one vertex per fan, corners of the faces fanned into triangles
+    std::vector<int> fan_vertex(n_halfedges, -1);
+    std::vector<int> corners;
+    for (fit = mesh.faces_begin(); fit != fend; ++fit)
+    {
+        corners.clear();
+        Surface_mesh::Halfedge_around_face_circulator hit = mesh.halfedges(*fit), hend = hit;
+        do
+        {
+            const int fan = smc_find(parent, (*hit).idx());
+            if (fan_vertex[fan] < 0)
+            {
+                fan_vertex[fan] = int(table.points.size());
+                table.points.push_back(mesh.position(mesh.from_vertex(*hit)));
+            }
+            corners.push_back(fan_vertex[fan]);
+        }
+        while (++hit != hend);
+
+        for (size_t k = 1; k + 1 < corners.size(); ++k)
+        {
+            table.V.push_back(corners[0]);
+            table.V.push_back(corners[k]);
+            table.V.push_back(corners[k+1]);
+        }
+    }
+    table.hole.assign(table.points.size(), 0);
+
+    // every hole is closed by a fan around a new vertex. the corner c of
+    // an unmatched edge a->b stands for the hole edge b->a.
+    std::vector<int> unmatched;
+    if (!smc_match_corners(table, &unmatched)) return false;
+
+    std::vector<int> hole_edge(table.points.size(), -1);
+    for (size_t i = 0; i < unmatched.size(); ++i)
+    {
+        const int b = table.V[smc_prev(unmatched[i])];
+        if (hole_edge[b] >= 0) return false;
+        hole_edge[b] = int(i);
+    }
+
+    std::vector<unsigned char> closed(unmatched.size(), 0);
+    for (size_t i = 0; i < unmatched.size(); ++i)
+    {
+        if (closed[i]) continue;
+        const int d = int(table.points.size());
+        table.points.push_back(Point(0.0f, 0.0f, 0.0f));
+        table.hole.push_back(1);
+
+        int j = int(i);
+        do
+        {
+            closed[j] = 1;
+            const int c = unmatched[j];
+            const int a = table.V[smc_next(c)], b = table.V[smc_prev(c)];
+            table.V.push_back(b);
+            table.V.push_back(a);
+            table.V.push_back(d);
+            j = hole_edge[a];
+        }
+        while (j >= 0 && !closed[j]);
+        if (j != int(i)) return false;
+    }
+
+    return unmatched.empty() || smc_match_corners(table, NULL);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// Edgebreaker on the closed mesh, calls encoder.op() and encoder.number()
+// in traversal order. holes receives the traversal numbers of the hole
+// vertices. false if the mesh is not a manifold after all.
+template <class Encoder>
+static bool smc_encode(const Smc_table& table, const std::vector<Smc_point>& q, int32_t max,
+                       Encoder& encoder, std::vector<unsigned int>& holes)
+{
+    const std::vector<int>& V = table.V;
+    const std::vector<int>& O = table.O;
+    const int n_corners = int(V.size());
+
+    std::vector<unsigned char> visited_triangle(n_corners / 3, 0);
+    std::vector<unsigned char> visited_vertex(table.points.size(), 0);
+    std::vector<int> corner_edge(n_corners, -1), edge_corner;
+    std::vector<int> stack;
+    Smc_loops loops;
+    Smc_point last = { { 0, 0, 0 } };
+    unsigned int n_numbered = 0;
+
+    // number v, code its position predicted from a, b and c
+    auto vertex = [&](int v, int a, int b, int c)
+    {
+        visited_vertex[v] = 1;
+        if (table.hole[v])
+        {
+            holes.push_back(n_numbered++);
+            return;
+        }
+        ++n_numbered;
+        Smc_point p;
+        smc_predict(q, table.hole, a, b, c, last, max, p);
+        for (int k = 0; k < 3; ++k) encoder.number(zigzag(q[v].x[k] - p.x[k]), 1 + k);
+        last = q[v];
+    };
+
+    // the boundary edge of the unvisited triangle of corner c
+    auto edge = [&](int c) -> int
+    {
+        const int e = loops.add();
+        edge_corner.push_back(c);
+        corner_edge[c] = e;
+        return e;
+    };
+
+    for (int start = 0; start < n_corners / 3; ++start)
+    {
+        if (visited_triangle[start]) continue;
+
+        // the first triangle of a component
+        const int c0 = 3 * start, c1 = c0 + 1, c2 = c0 + 2;
+        if (visited_vertex[V[c0]] || visited_vertex[V[c1]] || visited_vertex[V[c2]]) return false;
+        vertex(V[c0], -1, -1, -1);
+        vertex(V[c1], V[c0], -1, -1);
+        vertex(V[c2], V[c0], V[c1], -1);
+        visited_triangle[start] = 1;
+
+        const int e0 = edge(O[c2]), e1 = edge(O[c1]), e2 = edge(O[c0]);
+        loops.link(e0, e1);
+        loops.link(e1, e2);
+        loops.link(e2, e0);
+
+        unsigned int context = SMC_START;
+        int g = e0;
+        while (g >= 0)
+        {
+            // the gate runs from V[cn] to V[cp], the triangle of c is entered
+            const int c  = edge_corner[g];
+            const int cn = smc_next(c), cp = smc_prev(c);
+            const bool left  = visited_triangle[O[cp] / 3] != 0;
+            const bool right = visited_triangle[O[cn] / 3] != 0;
+            const int  pg = loops.prev[g], ng = loops.next[g];
+            visited_triangle[c / 3] = 1;
+
+            unsigned int op;
+            if (!visited_vertex[V[c]])
+            {
+                op = SMC_C;
+                encoder.op(op, context);
+                vertex(V[c], V[cn], V[cp], V[O[c]]);
+                const int a = edge(O[cp]), b = edge(O[cn]);
+                loops.link(pg, a);
+                loops.link(a, b);
+                loops.link(b, ng);
+                loops.alive[g] = 0;
+                g = b;
+            }
+            else if (left && right)
+            {
+                op = SMC_E;
+                if (pg != corner_edge[cp] || ng != corner_edge[cn]) return false;
+                encoder.op(op, context);
+                loops.alive[g] = loops.alive[pg] = loops.alive[ng] = 0;
+                g = loops.pop(stack);
+            }
+            else if (left)
+            {
+                op = SMC_L;
+                if (pg != corner_edge[cp]) return false;
+                encoder.op(op, context);
+                const int b = edge(O[cn]);
+                loops.link(loops.prev[pg], b);
+                loops.link(b, ng);
+                loops.alive[g] = loops.alive[pg] = 0;
+                g = b;
+            }
+            else if (right)
+            {
+                op = SMC_R;
+                if (ng != corner_edge[cn]) return false;
+                encoder.op(op, context);
+                const int a = edge(O[cp]);
+                loops.link(pg, a);
+                loops.link(a, loops.next[ng]);
+                loops.alive[g] = loops.alive[ng] = 0;
+                g = a;
+            }
+            else
+            {
+                // the boundary edge leaving V[c] that closes the fan of
+                // unvisited triangles the triangle of c is in
+                int x = cp;
+                while (!visited_triangle[O[x] / 3]) x = smc_next(O[x]);
+                const int o = corner_edge[x];
+                if (o < 0 || !loops.alive[o]) return false;
+
+                uint32_t offset = 0;
+                int y = g;
+                do { y = loops.next[y]; ++offset; } while (y != o && y != g);
+                op = (y == o) ? SMC_S : SMC_M;
+                encoder.op(op, context);
+                encoder.number(op == SMC_S ? offset : uint32_t(o), 0);
+
+                const int po = loops.prev[o];
+                const int a = edge(O[cp]), b = edge(O[cn]);
+                loops.link(pg, a);
+                loops.link(a, o);
+                loops.link(po, b);
+                loops.link(b, ng);
+                loops.alive[g] = 0;
+                if (op == SMC_S) stack.push_back(a);
+                g = b;
+            }
+            context = op;
+        }
+    }
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// the triangles of the closed mesh from the symbols, in traversal numbers
+template <class Decoder>
+static bool smc_decode(Decoder& decoder, unsigned int n_vertices, unsigned int n_triangles,
+                       const std::vector<unsigned char>& hole, int32_t max,
+                       std::vector<Smc_point>& q, std::vector<unsigned int>& triangles)
+{
+    std::vector<int> start, across, stack;
+    Smc_loops loops;
+    Smc_point last = { { 0, 0, 0 } };
+    unsigned int n_numbered = 0;
+    const size_t n_indices = size_t(n_triangles) * 3;
+
+    auto vertex = [&](int a, int b, int c) -> int
+    {
+        if (n_numbered >= n_vertices) return -1;
+        const int v = int(n_numbered++);
+        if (!hole[v])
+        {
+            Smc_point p;
+            smc_predict(q, hole, a, b, c, last, max, p);
+            for (int k = 0; k < 3; ++k) q[v].x[k] = p.x[k] + unzigzag(decoder.number(1 + k));
+            last = q[v];
+        }
+        return v;
+    };
+
+    // boundary edge from s, whose triangle has the vertex x across it
+    auto edge = [&](int s, int x) -> int
+    {
+        start.push_back(s);
+        across.push_back(x);
+        return loops.add();
+    };
+
+    auto triangle = [&](int a, int b, int c)
+    {
+        triangles.push_back(a);
+        triangles.push_back(b);
+        triangles.push_back(c);
+    };
+
+    while (triangles.size() < n_indices)
+    {
+        const int v0 = vertex(-1, -1, -1);
+        const int v1 = vertex(v0, -1, -1);
+        const int v2 = vertex(v0, v1, -1);
+        if (v0 < 0 || v1 < 0 || v2 < 0) return false;
+        triangle(v0, v1, v2);
+
+        const int e0 = edge(v1, v2), e1 = edge(v0, v1), e2 = edge(v2, v0);
+        loops.link(e0, e1);
+        loops.link(e1, e2);
+        loops.link(e2, e0);
+
+        unsigned int context = SMC_START;
+        int g = e0;
+        while (g >= 0)
+        {
+            if (triangles.size() >= n_indices) return false;
+            const unsigned int op = decoder.op(context);
+            const int pg = loops.prev[g], ng = loops.next[g];
+            const int a = start[g], b = start[ng];
+
+            switch (op)
+            {
+                case SMC_C:
+                {
+                    const int t = vertex(a, b, across[g]);
+                    if (t < 0) return false;
+                    triangle(a, b, t);
+                    const int ea = edge(a, b), eb = edge(t, a);
+                    loops.link(pg, ea);
+                    loops.link(ea, eb);
+                    loops.link(eb, ng);
+                    loops.alive[g] = 0;
+                    g = eb;
+                    break;
+                }
+                case SMC_L:
+                {
+                    const int t = start[pg];
+                    triangle(a, b, t);
+                    const int eb = edge(t, a);
+                    loops.link(loops.prev[pg], eb);
+                    loops.link(eb, ng);
+                    loops.alive[g] = loops.alive[pg] = 0;
+                    g = eb;
+                    break;
+                }
+                case SMC_R:
+                {
+                    const int nng = loops.next[ng];
+                    triangle(a, b, start[nng]);
+                    const int ea = edge(a, b);
+                    loops.link(pg, ea);
+                    loops.link(ea, nng);
+                    loops.alive[g] = loops.alive[ng] = 0;
+                    g = ea;
+                    break;
+                }
+                case SMC_E:
+                {
+                    triangle(a, b, start[pg]);
+                    loops.alive[g] = loops.alive[pg] = loops.alive[ng] = 0;
+                    g = loops.pop(stack);
+                    break;
+                }
+                case SMC_S:
+                case SMC_M:
+                {
+                    const uint32_t n = decoder.number(0);
+                    if (n >= loops.next.size()) return false;
+                    int o = g;
+                    if (op == SMC_S)
+                        for (uint32_t i = 0; i < n; ++i) o = loops.next[o];
+                    else
+                        o = int(n);
+                    if (!loops.alive[o] || o == g) return false;
+
+                    triangle(a, b, start[o]);
+                    const int po = loops.prev[o];
+                    const int ea = edge(a, b), eb = edge(start[o], a);
+                    loops.link(pg, ea);
+                    loops.link(ea, o);
+                    loops.link(po, eb);
+                    loops.link(eb, ng);
+                    loops.alive[g] = 0;
+                    if (op == SMC_S) stack.push_back(ea);
+                    g = eb;
+                    break;
+                }
+                default:
+                    return false;
+            }
+            context = op;
+        }
+    }
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class T> static void smc_append(std::vector<unsigned char>& out, const T& t)
+{
+    const unsigned char* p = (const unsigned char*) &t;
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+
+template <class T> static bool smc_take(const char*& c, const char* end, T& t)
+{
+    if (size_t(end - c) < sizeof(T)) return false;
+    memcpy(&t, c, sizeof(T));
+    c += sizeof(T);
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_smc(Surface_mesh& mesh, const std::string& filename, Vertex_bounds* bounds)
+{
+    // map the whole file
+    Mapped_file file;
+    if (!file.open(filename)) return false;
+    return read_smc(mesh, file.begin(), file.size(), bounds);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_smc(Surface_mesh& mesh, const char* src, size_t size, Vertex_bounds* bounds)
+{
+    const char* c   = src;
+    const char* end = src + size;
+
+
+    // header
+    if (size < sizeof(smc_magic) || memcmp(c, smc_magic, sizeof(smc_magic)) != 0)
+        return false;
+    c += sizeof(smc_magic);
+
+    unsigned int header[6];
+    float        grid[4];
+    for (int i = 0; i < 6; ++i)
+        if (!smc_take(c, end, header[i])) return false;
+    for (int i = 0; i < 4; ++i)
+        if (!smc_take(c, end, grid[i])) return false;
+
+    const unsigned int version     = header[0];
+    const unsigned int flags       = header[1];
+    const unsigned int bits        = header[2];
+    const unsigned int n_vertices  = header[3];
+    const unsigned int n_triangles = header[4];
+    const unsigned int n_holes     = header[5];
+    if (version != smc_version || bits < 1 || bits > 24) return false;
+    if (n_holes > n_vertices || n_vertices > 3 * size_t(n_triangles) ||
+        size_t(end - c) < size_t(n_holes) * sizeof(unsigned int))
+        return false;
+
+    std::vector<unsigned char> hole(n_vertices, 0);
+    for (unsigned int i = 0; i < n_holes; ++i)
+    {
+        unsigned int h;
+        smc_take(c, end, h);
+        if (h >= n_vertices) return false;
+        hole[h] = 1;
+    }
+
+    unsigned int payload_size;
+    if (!smc_take(c, end, payload_size) || size_t(end - c) < payload_size) return false;
+    const unsigned char* payload = (const unsigned char*) c;
+
+
+    // connectivity and positions
+    const int32_t max = int32_t((1u << bits) - 1);
+    std::vector<Smc_point> q(n_vertices);
+    std::vector<unsigned int> triangles;
+    triangles.reserve(size_t(n_triangles) * 3);
+    bool ok;
+    if (flags & smc_entropy_coded)
+    {
+        Range_decoder decoder(payload, payload + payload_size);
+        ok = smc_decode(decoder, n_vertices, n_triangles, hole, max, q, triangles);
+    }
+    else
+    {
+        Bit_decoder decoder(payload, payload + payload_size);
+        ok = smc_decode(decoder, n_vertices, n_triangles, hole, max, q, triangles);
+    }
+    if (!ok) return false;
+
+
+    // the mesh without the hole vertices and their triangles
+    mesh.clear();
+    std::vector<unsigned int> index(n_vertices, 0);
+    const Point origin(grid[0], grid[1], grid[2]);
+    const float cell = grid[3];
+    mesh.reserve(n_vertices - n_holes, 3 * n_vertices, n_triangles);
+    std::vector<Point> points;
+    points.reserve(n_vertices - n_holes);
+    for (unsigned int v = 0; v < n_vertices; ++v)
+    {
+        if (hole[v]) continue;
+        const Point p = origin + cell * Point(float(q[v].x[0]), float(q[v].x[1]), float(q[v].x[2]));
+        if (bounds) bounds->add(p);
+        index[v] = points.size();
+        points.push_back(p);
+    }
+    mesh.add_vertices(points.data(), points.size());
+
+    std::vector<unsigned int> indices;
+    indices.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        if (hole[triangles[i]] || hole[triangles[i+1]] || hole[triangles[i+2]]) continue;
+        for (int k = 0; k < 3; ++k) indices.push_back(index[triangles[i+k]]);
+    }
+    const std::vector<unsigned int> valences(indices.size() / 3, 3);
+    mesh.add_faces(indices, valences);
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool write_smc(const Surface_mesh& mesh, const std::string& filename,
+               unsigned int bits, bool entropy_coded)
+{
+    std::vector<unsigned char> out;
+    if (!write_smc(mesh, out, bits, entropy_coded)) return false;
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file) return false;
+    const bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    return fclose(file) == 0 && ok;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool write_smc(const Surface_mesh& mesh, std::vector<unsigned char>& out,
+               unsigned int bits, bool entropy_coded)
+{
+    if (bits < 1 || bits > 24) return false;
+
+    Smc_table table;
+    if (!smc_build_table(mesh, table)) return false;
+
+
+    // quantization grid over the bounding box, one cell size for all axes
+    Point bmin(0.0f, 0.0f, 0.0f), bmax(0.0f, 0.0f, 0.0f);
+    bool first = true;
+    for (size_t v = 0; v < table.points.size(); ++v)
+    {
+        if (table.hole[v]) continue;
+        if (first) { bmin = bmax = table.points[v]; first = false; }
+        bmin.minimize(table.points[v]);
+        bmax.maximize(table.points[v]);
+    }
+    const int32_t max = int32_t((1u << bits) - 1);
+    const Point extent = bmax - bmin;
+    const float largest = std::max(extent[0], std::max(extent[1], extent[2]));
+    const float cell = largest > 0.0f ? largest / float(max) : 1.0f;
+
+    std::vector<Smc_point> q(table.points.size());
+    for (size_t v = 0; v < table.points.size(); ++v)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const long x = table.hole[v] ? 0 : lround((table.points[v][k] - bmin[k]) / cell);
+            q[v].x[k] = int32_t(std::min(std::max(x, 0L), long(max)));
+        }
+    }
+
+
+    // payload
+    std::vector<unsigned char> payload;
+    std::vector<unsigned int> holes;
+    bool ok;
+    if (entropy_coded)
+    {
+        Range_encoder encoder(payload);
+        ok = smc_encode(table, q, max, encoder, holes);
+        encoder.finish();
+    }
+    else
+    {
+        Bit_encoder encoder(payload);
+        ok = smc_encode(table, q, max, encoder, holes);
+        encoder.finish();
+    }
+    if (!ok) return false;
+
+
+    // header, hole vertices, payload
+    out.assign(smc_magic, smc_magic + sizeof(smc_magic));
+    const unsigned int header[6] = { smc_version,
+                                     entropy_coded ? smc_entropy_coded : 0u,
+                                     bits,
+                                     (unsigned int) table.points.size(),
+                                     (unsigned int) (table.V.size() / 3),
+                                     (unsigned int) holes.size() };
+    const float grid[4] = { bmin[0], bmin[1], bmin[2], cell };
+    for (int i = 0; i < 6; ++i) smc_append(out, header[i]);
+    for (int i = 0; i < 4; ++i) smc_append(out, grid[i]);
+    for (size_t i = 0; i < holes.size(); ++i) smc_append(out, holes[i]);
+    smc_append(out, (unsigned int) payload.size());
+    out.insert(out.end(), payload.begin(), payload.end());
+
+    return true;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
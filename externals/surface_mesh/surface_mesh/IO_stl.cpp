@@ -3,10 +3,14 @@
 //== INCLUDES =================================================================
 
 #include <surface_mesh/IO.h>
+#include <surface_mesh/Mapped_file.h>
+#include <surface_mesh/Weld.h>
 
+#include <algorithm>
 #include <cstdio>
-#include <cfloat>
-#include <map>
+#include <cstring>
+#include <cmath>
+#include <vector>
 
 
 //== NAMESPACES ===============================================================
@@ -18,58 +22,76 @@ namespace surface_mesh {
 //== IMPLEMENTATION ===========================================================
 
 
-// helper function
-template <typename T> void read(FILE* in, T& t)
+// helper function for the STL readers: welds the corners of the triangle
+// soup with weld_positions(), the vertices in the order of their first
+// corners, and adds the triangles that are not degenerate in bulk
+static void add_welded_corners(Surface_mesh& mesh, const std::vector<Point>& corners,
+                               float weld_tolerance, Vertex_bounds* bounds)
 {
-    size_t n_items(0);
-    n_items = fread((char*)&t, 1, sizeof(t), in);
-    assert(n_items > 0);
+    std::vector<unsigned int> vertex;
+    const unsigned int nV = weld_positions(corners.data(), corners.size(),
+                                           weld_tolerance, vertex);
+
+    std::vector<Point> points;
+    points.reserve(nV);
+    for (size_t c = 0; c < corners.size(); ++c)
+    {
+        if (vertex[c] != points.size()) continue;
+        points.push_back(corners[c]);
+        if (bounds) bounds->add(corners[c]);
+    }
+    const unsigned int nT = (unsigned int) (corners.size() / 3);
+    mesh.reserve(nV, 3*nT/2, nT);
+    mesh.add_vertices(points.data(), points.size());
+
+    std::vector<unsigned int> indices;
+    indices.reserve(corners.size());
+    for (size_t c = 0; c + 2 < corners.size(); c += 3)
+    {
+        const unsigned int a = vertex[c], b = vertex[c+1], d = vertex[c+2];
+        if (a == b || a == d || b == d) continue;
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(d);
+    }
+    mesh.add_faces(indices, std::vector<unsigned int>(indices.size()/3, 3));
 }
 
 
 //-----------------------------------------------------------------------------
 
 
-// helper class for STL reader
-class CmpVec
+// corners of a binary STL, decoded in parallel from the memory-mapped file
+static bool read_stl_binary_corners(const std::string& filename, std::vector<Point>& corners)
 {
-public:
-
-    CmpVec(float _eps=FLT_MIN) : eps_(_eps) {}
-
-    bool operator()(const Vec3f& v0, const Vec3f& v1) const
-    {
-        if (fabs(v0[0] - v1[0]) <= eps_)
-        {
-            if (fabs(v0[1] - v1[1]) <= eps_)
-            {
-                return (v0[2] < v1[2] - eps_);
-            }
-            else return (v0[1] < v1[1] - eps_);
-        }
-        else return (v0[0] < v1[0] - eps_);
-    }
+    Mapped_file file;
+    if (!file.open(filename)) return false;
+    if (file.size() < 84) return false;
+    unsigned int nT;
+    memcpy(&nT, file.begin() + 80, sizeof(nT));
+    nT = (unsigned int) std::min<size_t>(nT, (file.size() - 84) / 50);
+    const char* records = file.begin() + 84;
+
+    // one 50 byte record per triangle: normal, three vertices and the
+    // attribute byte count
+    corners.resize(3 * size_t(nT));
+#pragma omp parallel for schedule(static)
+    for (int t = 0; t < (int) nT; ++t)
+        memcpy(corners[3*t].data(), records + 50*size_t(t) + 12, 36);
 
-private:
-    float eps_;
-};
+    return true;
+}
 
 
 //-----------------------------------------------------------------------------
 
 
-bool read_stl(Surface_mesh& mesh, const std::string& filename)
+bool read_stl(Surface_mesh& mesh, const std::string& filename, float weld_tolerance,
+              Vertex_bounds* bounds)
 {
-    char                            line[100], *c;
-    unsigned int                    i, nT;
-    Vec3f                           p;
-    Surface_mesh::Vertex               v;
-    std::vector<Surface_mesh::Vertex>  vertices(3);
-    size_t n_items(0);
-
-    CmpVec comp(FLT_MIN);
-    std::map<Vec3f, Surface_mesh::Vertex, CmpVec>            vMap(comp);
-    std::map<Vec3f, Surface_mesh::Vertex, CmpVec>::iterator  vMapIt;
+    char                line[100], *c;
+    Vec3f               p;
+    std::vector<Point>  corners;
 
 
     // clear mesh
@@ -91,62 +113,23 @@ bool read_stl(Surface_mesh& mesh, const std::string& filename)
     // parse binary STL
     if (binary)
     {
-        // re-open file in binary mode
         fclose(in);
-        in = fopen(filename.c_str(), "rb");
-        if (!in) return false;
-
-        // skip dummy header
-        n_items = fread(line, 1, 80, in);
-        assert(n_items > 0);
-
-        // read number of triangles
-        read(in, nT);
-
-        // read triangles
-        while (nT)
-        {
-            // skip triangle normal
-            n_items = fread(line, 1, 12, in);
-            assert(n_items > 0);
-            // triangle's vertices
-            for (i=0; i<3; ++i)
-            {
-                read(in, p);
-
-                // has vector been referenced before?
-                if ((vMapIt=vMap.find(p)) == vMap.end())
-                {
-                    // No : add vertex and remember idx/vector mapping
-                    v = mesh.add_vertex((Point)p);
-                    vertices[i] = v;
-                    vMap[p] = v;
-                }
-                else
-                {
-                    // Yes : get index from map
-                    vertices[i] = vMapIt->second;
-                }
-            }
-
-            // Add face only if it is not degenerated
-            if ((vertices[0] != vertices[1]) &&
-                (vertices[0] != vertices[2]) &&
-                (vertices[1] != vertices[2]))
-                mesh.add_face(vertices);
-
-            n_items = fread(line, 1, 2, in);
-            assert(n_items > 0);
-            --nT;
-        }
+        if (!read_stl_binary_corners(filename, corners)) return false;
     }
 
 
     // parse ASCII STL
     else
     {
+        // a facet takes about 250 bytes, estimated from the file size
+        const long start = ftell(in);
+        long size = 0;
+        if (fseek(in, 0, SEEK_END) == 0) size = ftell(in);
+        fseek(in, start, SEEK_SET);
+        corners.reserve(3 * (std::max(size, 0L) / 250));
+
         // parse line by line
-        while (in && !feof(in) && fgets(line, 100, in))
+        while (!feof(in) && fgets(line, 100, in))
         {
             // skip white-space
             for (c=line; isspace(*c) && *c!='\0'; ++c) {};
@@ -156,7 +139,7 @@ bool read_stl(Surface_mesh& mesh, const std::string& filename)
                 (strncmp(c, "OUTER", 5) == 0))
             {
                 // read three vertices
-                for (i=0; i<3; ++i)
+                for (int i=0; i<3; ++i)
                 {
                     // read line
                     c = fgets(line, 100, in);
@@ -167,33 +150,17 @@ bool read_stl(Surface_mesh& mesh, const std::string& filename)
 
                     // read x, y, z
                     sscanf(c+6, "%f %f %f", &p[0], &p[1], &p[2]);
-
-                    // has vector been referenced before?
-                    if ((vMapIt=vMap.find(p)) == vMap.end())
-                    {
-                        // No : add vertex and remember idx/vector mapping
-                        v = mesh.add_vertex((Point)p);
-                        vertices[i] = v;
-                        vMap[p] = v;
-                    }
-                    else
-                    {
-                        // Yes : get index from map
-                        vertices[i] = vMapIt->second;
-                    }
+                    corners.push_back((Point)p);
                 }
-
-                // Add face only if it is not degenerated
-                if ((vertices[0] != vertices[1]) &&
-                    (vertices[0] != vertices[2]) &&
-                    (vertices[1] != vertices[2]))
-                    mesh.add_face(vertices);
             }
         }
+        fclose(in);
     }
 
 
-    fclose(in);
+    // merge the corners into shared vertices and connect them
+    add_welded_corners(mesh, corners, weld_tolerance, bounds);
+
     return true;
 }
 
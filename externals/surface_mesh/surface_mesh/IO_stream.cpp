@@ -0,0 +1,438 @@
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/IO_stream.h>
+#include <surface_mesh/IO_parse.h>
+#include <surface_mesh/Mapped_file.h>
+#include <surface_mesh/Trace.h>
+
+#include <algorithm>
+#include <clocale>
+#include <cstring>
+#include <vector>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+// helper class of the stream readers: collects vertices and faces into
+// blocks and hands them to the visitor. Pending vertices go out before
+// pending faces, so a face block never refers to a vertex not yet seen.
+class Stream_blocks
+{
+public:
+
+    Stream_blocks(Mesh_visitor& visitor, size_t block_size)
+        : visitor_(visitor),
+          block_size_(std::max(block_size, size_t(1))),
+          n_vertices_(0),
+          begun_(false),
+          stopped_(false)
+    {
+        points_.reserve(block_size_);
+        valences_.reserve(block_size_);
+        indices_.reserve(3 * block_size_);
+    }
+
+    /// calls end() if begin() was called
+    ~Stream_blocks()
+    {
+        if (begun_) visitor_.end();
+    }
+
+    bool begin(unsigned int n_vertices, unsigned int n_faces)
+    {
+        begun_ = true;
+        if (!visitor_.begin(n_vertices, n_faces)) stopped_ = true;
+        return !stopped_;
+    }
+
+    /// false once the visitor stopped the reading
+    bool add_vertex(const Point& p)
+    {
+        points_.push_back(p);
+        ++n_vertices_;
+        if (points_.size() >= block_size_) flush_vertices();
+        return !stopped_;
+    }
+
+    bool add_face(const unsigned int* indices, unsigned int n)
+    {
+        indices_.insert(indices_.end(), indices, indices + n);
+        valences_.push_back(n);
+        if (valences_.size() >= block_size_) flush_faces();
+        return !stopped_;
+    }
+
+    /// hand out what is pending, at the end of the file
+    bool flush()
+    {
+        flush_faces();
+        flush_vertices();
+        return !stopped_;
+    }
+
+    /// vertices added so far, including the pending ones
+    unsigned int n_vertices() const { return n_vertices_; }
+
+private:
+
+    void flush_vertices()
+    {
+        if (!stopped_ && !points_.empty() &&
+            !visitor_.on_vertices(&points_[0], points_.size(),
+                                  n_vertices_ - (unsigned int) points_.size()))
+            stopped_ = true;
+        points_.clear();
+    }
+
+    void flush_faces()
+    {
+        flush_vertices();
+        if (!stopped_ && !valences_.empty() &&
+            !visitor_.on_faces(indices_.empty() ? NULL : &indices_[0],
+                               &valences_[0], valences_.size()))
+            stopped_ = true;
+        indices_.clear();
+        valences_.clear();
+    }
+
+    Mesh_visitor&              visitor_;
+    size_t                     block_size_;
+    unsigned int               n_vertices_;
+    bool                       begun_;
+    bool                       stopped_;
+    std::vector<Point>         points_;
+    std::vector<unsigned int>  indices_;
+    std::vector<unsigned int>  valences_;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+// ASCII OFF from the mapped file, behind the header keyword
+static bool stream_off_ascii(const char* lp, const char* end, Stream_blocks& blocks)
+{
+    int nV, nF, nE, n, idx;
+    Point p;
+
+    // #Vertice, #Faces, #Edges
+    lp = skip_space_and_comments(lp, end);
+    if (!parse_int(lp, end, nV) || !parse_int(lp, end, nF)) return false;
+    if (!parse_int(lp, end, nE)) nE = 0;
+    if (nV < 0 || nF < 0) return false;
+    if (!blocks.begin(nV, nF)) return true;
+
+    // vertices, one per line, normals, colors and texture coordinates
+    // after the position are skipped with the rest of the line
+    for (int i = 0; i < nV; ++i)
+    {
+        lp = skip_space_and_comments(lp, end);
+        const char* eol = find_line_end(lp, end);
+        if (lp == end) return false;
+        if (!parse_float(lp, eol, p[0]) ||
+            !parse_float(lp, eol, p[1]) ||
+            !parse_float(lp, eol, p[2]))
+            return false;
+        if (!blocks.add_vertex(p)) return true;
+        lp = eol;
+    }
+
+    // faces: #N v[1] v[2] ... v[n-1], indices may wrap over lines
+    std::vector<unsigned int> face;
+    for (int i = 0; i < nF; ++i)
+    {
+        lp = skip_space_and_comments(lp, end);
+        if (!parse_int(lp, end, n) || n < 0) return false;
+        face.resize(n);
+        for (int j = 0; j < n; ++j)
+        {
+            lp = skip_space_and_comments(lp, end);
+            if (!parse_int(lp, end, idx) || idx < 0 || idx >= nV) return false;
+            face[j] = idx;
+        }
+        if (!blocks.add_face(face.empty() ? NULL : &face[0], n)) return true;
+
+        // skip per-face colors
+        lp = next_line(lp, end);
+    }
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// OFF BINARY from the mapped file, behind the header line
+static bool stream_off_binary(const char* lp, const char* end,
+                              bool has_normals, bool has_texcoords,
+                              Stream_blocks& blocks)
+{
+    unsigned int counts[3], n, idx;
+    Point p;
+
+    // #Vertice, #Faces, #Edges
+    if (end - lp < (long) sizeof(counts)) return false;
+    memcpy(counts, lp, sizeof(counts));
+    lp += sizeof(counts);
+    const unsigned int nV = counts[0], nF = counts[1];
+    if (!blocks.begin(nV, nF)) return true;
+
+    // vertices: pos [normal] [texcoord]
+    const size_t stride = sizeof(Point) + (has_normals ? sizeof(Normal) : 0) +
+                          (has_texcoords ? 2 * sizeof(Scalar) : 0);
+    if ((size_t) (end - lp) / stride < nV) return false;
+    for (unsigned int i = 0; i < nV; ++i, lp += stride)
+    {
+        memcpy(p.data(), lp, sizeof(Point));
+        if (!blocks.add_vertex(p)) return true;
+    }
+
+    // faces: #N v[1] v[2] ... v[n-1]
+    std::vector<unsigned int> face;
+    for (unsigned int i = 0; i < nF; ++i)
+    {
+        if (end - lp < (long) sizeof(n)) return false;
+        memcpy(&n, lp, sizeof(n));
+        lp += sizeof(n);
+        if ((size_t) (end - lp) / sizeof(idx) < n) return false;
+        face.resize(n);
+        for (unsigned int j = 0; j < n; ++j, lp += sizeof(idx))
+        {
+            memcpy(&idx, lp, sizeof(idx));
+            if (idx >= nV) return false;
+            face[j] = idx;
+        }
+        if (!blocks.add_face(face.empty() ? NULL : &face[0], n)) return true;
+    }
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_off_stream(const std::string& filename, Mesh_visitor& visitor,
+                     size_t block_size)
+{
+    bool has_texcoords = false;
+    bool has_normals   = false;
+    bool has_colors    = false;
+
+    Mapped_file file;
+    if (!file.open(filename)) return false;
+
+    // header: [ST][C][N][4][n]OFF BINARY, as read_off() reads it
+    const char* c   = skip_space_and_comments(file.begin(), file.end());
+    const char* eol = find_line_end(c, file.end());
+    if (eol - c < 3) return false;
+    if (c[0] == 'S' && c[1] == 'T') { has_texcoords = true; c += 2; }
+    if (c[0] == 'C') { has_colors  = true; ++c; }
+    if (c[0] == 'N') { has_normals = true; ++c; }
+    if (c[0] == '4' || c[0] == 'n') return false;
+    if (eol - c < 3 || strncmp(c, "OFF", 3) != 0) return false;
+    const bool is_binary = (eol - c >= 10 && strncmp(c+4, "BINARY", 6) == 0);
+
+    Stream_blocks blocks(visitor, block_size);
+    bool ok;
+    if (!is_binary)
+    {
+        ok = stream_off_ascii(c+3, file.end(), blocks);
+    }
+    else
+    {
+        // binary cannot (yet) read colors
+        if (has_colors) return false;
+        ok = stream_off_binary(next_line(eol, file.end()), file.end(),
+                               has_normals, has_texcoords, blocks);
+    }
+    if (ok) blocks.flush();
+    return ok;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_obj_stream(const std::string& filename, Mesh_visitor& visitor,
+                     size_t block_size)
+{
+    Mapped_file file;
+    if (!file.open(filename)) return false;
+
+    Stream_blocks blocks(visitor, block_size);
+    if (!blocks.begin(0, 0)) return true;
+
+    // one line after the other, the faces refer to the vertices before them
+    std::vector<unsigned int> face;
+    const char* lp  = file.begin();
+    const char* end = file.end();
+    Point p;
+    while (lp != end)
+    {
+        const char* eol = find_line_end(lp, end);
+        lp = skip_blanks(lp, eol);
+
+        // vertex
+        if (eol - lp > 1 && lp[0] == 'v' && lp[1] == ' ')
+        {
+            lp += 2;
+            if (parse_float(lp, eol, p[0]) && parse_float(lp, eol, p[1]) &&
+                parse_float(lp, eol, p[2]) && !blocks.add_vertex(p))
+                return true;
+        }
+
+        // face: v, v/t, v/t/n or v//n per corner, only v is kept
+        else if (eol - lp > 1 && lp[0] == 'f' && lp[1] == ' ')
+        {
+            lp += 2;
+            const int n_vertices = (int) blocks.n_vertices();
+            bool valid = true;
+            int idx;
+            face.clear();
+            while (parse_int(lp, eol, idx))
+            {
+                while (lp != eol && (*lp == '/' || (*lp >= '0' && *lp <= '9') || *lp == '-'))
+                    ++lp;
+                idx = idx > 0 ? idx - 1 : n_vertices + idx;
+                if (idx < 0 || idx >= n_vertices) valid = false;
+                face.push_back(idx);
+            }
+            if (valid && face.size() >= 3 &&
+                !blocks.add_face(&face[0], (unsigned int) face.size()))
+                return true;
+        }
+
+        // texture coordinates, normals, groups, materials, ... are ignored
+        lp = (eol == end) ? end : eol + 1;
+    }
+
+    blocks.flush();
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_stl_stream(const std::string& filename, Mesh_visitor& visitor,
+                     size_t block_size)
+{
+    Mapped_file file;
+    if (!file.open(filename)) return false;
+    const char* lp  = file.begin();
+    const char* end = file.end();
+
+    // ASCII or binary STL, decided as read_stl() does
+    const bool binary = (file.size() < 5 ||
+                         (strncmp(lp, "SOLID", 5) != 0 && strncmp(lp, "solid", 5) != 0));
+
+    Stream_blocks blocks(visitor, block_size);
+    unsigned int triangle[3];
+    Point p;
+
+    // binary: 80 byte header, #triangles, one 50 byte record each
+    if (binary)
+    {
+        unsigned int nT;
+        if (file.size() < 84) return false;
+        memcpy(&nT, lp + 80, sizeof(nT));
+        if ((file.size() - 84) / 50 < nT) return false;
+        if (!blocks.begin(3*nT, nT)) return true;
+
+        for (const char* record = lp + 84; nT; --nT, record += 50)
+        {
+            // triangle's vertices, skip the normal
+            for (int i = 0; i < 3; ++i)
+            {
+                memcpy(p.data(), record + 12 + 12*i, 12);
+                triangle[i] = blocks.n_vertices();
+                if (!blocks.add_vertex(p)) return true;
+            }
+            if (!blocks.add_face(triangle, 3)) return true;
+        }
+    }
+
+    // ASCII: three "vertex x y z" lines after each "outer loop"
+    else
+    {
+        if (!blocks.begin(0, 0)) return true;
+        while (lp != end)
+        {
+            const char* eol = find_line_end(lp, end);
+            lp = skip_blanks(lp, eol);
+
+            if (eol - lp >= 5 && (strncmp(lp, "outer", 5) == 0 || strncmp(lp, "OUTER", 5) == 0))
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    lp  = next_line(eol, end);
+                    eol = find_line_end(lp, end);
+                    lp  = skip_blanks(lp, eol);
+                    if (eol - lp < 6) return false;
+                    lp += 6;
+                    if (!parse_float(lp, eol, p[0]) ||
+                        !parse_float(lp, eol, p[1]) ||
+                        !parse_float(lp, eol, p[2]))
+                        return false;
+                    triangle[i] = blocks.n_vertices();
+                    if (!blocks.add_vertex(p)) return true;
+                }
+                if (!blocks.add_face(triangle, 3)) return true;
+            }
+
+            lp = next_line(eol, end);
+        }
+    }
+
+    blocks.flush();
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool read_mesh_stream(const std::string& filename, Mesh_visitor& visitor,
+                      size_t block_size)
+{
+    SURFACE_MESH_TRACE_ZONE("parse");
+    std::setlocale(LC_NUMERIC, "C");
+
+    // extract file extension
+    std::string::size_type dot(filename.rfind("."));
+    if (dot == std::string::npos) return false;
+    std::string ext = filename.substr(dot+1, filename.length()-dot-1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), tolower);
+
+    // extension determines reader
+    if (ext == "off")
+    {
+        return read_off_stream(filename, visitor, block_size);
+    }
+    else if (ext == "obj")
+    {
+        return read_obj_stream(filename, visitor, block_size);
+    }
+    else if (ext == "stl")
+    {
+        return read_stl_stream(filename, visitor, block_size);
+    }
+
+    // no streaming reader for this format
+    return false;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -0,0 +1,78 @@
+//=============================================================================
+#ifndef SURFACE_MESH_IO_STREAM_H
+#define SURFACE_MESH_IO_STREAM_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/types.h>
+
+#include <cstddef>
+#include <string>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// Receiver of the vertices and faces of a mesh file while it is parsed,
+/// see read_mesh_stream(). Both come in blocks whose arrays are only valid
+/// during the call; a face block only refers to vertices of earlier
+/// blocks. Nothing is kept between the calls, so a visitor that does not
+/// keep them either reads a file of any size in constant memory. Every
+/// callback may return false to stop reading.
+class Mesh_visitor
+{
+public:
+
+    virtual ~Mesh_visitor() {}
+
+    /// the counts of the file header, 0 for formats without one (OBJ)
+    virtual bool begin(unsigned int /*n_vertices*/, unsigned int /*n_faces*/) { return true; }
+
+    /// the next \c n positions, the first of them is vertex \c first
+    virtual bool on_vertices(const Point* /*points*/, size_t /*n*/, unsigned int /*first*/)
+    {
+        return true;
+    }
+
+    /// the next \c n faces, face i has \c valences[i] zero-based vertex
+    /// indices, one face after the other in \c indices
+    virtual bool on_faces(const unsigned int* /*indices*/, const unsigned int* /*valences*/,
+                          size_t /*n*/)
+    {
+        return true;
+    }
+
+    /// after the last block, also when a callback stopped the reading
+    virtual void end() {}
+};
+
+
+/// stream the positions and faces of an OFF, OBJ or STL file into \c
+/// visitor in blocks of about \c block_size elements. Other attributes
+/// are skipped. OBJ faces with fewer than three corners or with
+/// vertices that come after them are left out, STL corners are not
+/// merged: every triangle brings its own three vertices. false if the file
+/// cannot be read or is malformed; stopping from the visitor is no error.
+bool read_mesh_stream(const std::string& filename, Mesh_visitor& visitor,
+                      size_t block_size = 4096);
+bool read_off_stream(const std::string& filename, Mesh_visitor& visitor,
+                     size_t block_size = 4096);
+bool read_obj_stream(const std::string& filename, Mesh_visitor& visitor,
+                     size_t block_size = 4096);
+bool read_stl_stream(const std::string& filename, Mesh_visitor& visitor,
+                     size_t block_size = 4096);
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_IO_STREAM_H
+//=============================================================================
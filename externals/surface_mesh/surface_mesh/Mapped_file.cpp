@@ -0,0 +1,126 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Mapped_file.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+Mapped_file::
+Mapped_file()
+    : data_(0), size_(0), copy_on_write_(false)
+#if defined(_WIN32)
+    , file_(INVALID_HANDLE_VALUE), mapping_(0)
+#else
+    , fd_(-1)
+#endif
+{
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Mapped_file::
+~Mapped_file()
+{
+    close();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Mapped_file::
+open(const std::string& filename, bool copy_on_write)
+{
+    close();
+    copy_on_write_ = copy_on_write;
+
+#if defined(_WIN32)
+
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file_ == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) { close(); return false; }
+    size_ = (size_t) size.QuadPart;
+    if (size_ == 0) return true;
+
+    mapping_ = CreateFileMappingA(file_, 0, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, 0);
+    if (!mapping_) { close(); return false; }
+    data_ = (const char*) MapViewOfFile(mapping_, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if (!data_) { close(); return false; }
+
+#else
+
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) return false;
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0) { close(); return false; }
+    size_ = (size_t) st.st_size;
+    if (size_ == 0) return true;
+
+    void* data = mmap(0, size_, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_PRIVATE, fd_, 0);
+    if (data == MAP_FAILED) { size_ = 0; close(); return false; }
+    data_ = (const char*) data;
+
+    // the readers scan front to back, the users of a writable mapping
+    // page in what they access
+    if (!copy_on_write) madvise(data, size_, MADV_SEQUENTIAL);
+
+#endif
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Mapped_file::
+close()
+{
+#if defined(_WIN32)
+    if (data_)    UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+    mapping_ = 0;
+    file_    = INVALID_HANDLE_VALUE;
+#else
+    if (data_)    munmap((void*) data_, size_);
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+#endif
+    data_ = 0;
+    size_ = 0;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -0,0 +1,76 @@
+//=============================================================================
+#ifndef SURFACE_MESH_MAPPED_FILE_H
+#define SURFACE_MESH_MAPPED_FILE_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <cstddef>
+#include <string>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// Read-only memory mapping of a whole file, used by the mesh readers to
+/// parse directly from the page cache instead of copying through stdio. A
+/// copy-on-write mapping can be written to as well: a page is copied into
+/// private memory when it is first written, the file never changes, and
+/// the pages that are only read stay shared with the page cache and other
+/// processes mapping the file.
+class Mapped_file
+{
+public:
+
+    Mapped_file();
+    ~Mapped_file();
+
+    /// map \c filename, returns false if it cannot be opened or mapped.
+    /// The file must not be truncated while it is mapped.
+    bool open(const std::string& filename, bool copy_on_write = false);
+
+    /// unmap the file
+    void close();
+
+    /// first byte of the file, not null-terminated
+    const char* begin() const { return data_; }
+
+    /// one past the last byte of the file
+    const char* end() const { return data_ + size_; }
+
+    /// size of the file in bytes
+    size_t size() const { return size_; }
+
+    /// first byte of a copy-on-write mapping, null for a read-only one
+    char* writable() { return copy_on_write_ ? const_cast<char*>(data_) : 0; }
+
+private:
+
+    Mapped_file(const Mapped_file&);
+    Mapped_file& operator=(const Mapped_file&);
+
+    const char* data_;
+    size_t      size_;
+    bool        copy_on_write_;
+
+#if defined(_WIN32)
+    void* file_;
+    void* mapping_;
+#else
+    int   fd_;
+#endif
+};
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_MAPPED_FILE_H
+//=============================================================================
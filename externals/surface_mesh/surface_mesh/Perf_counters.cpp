@@ -0,0 +1,270 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Perf_counters.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+
+const char* const names_[Perf_counters::N_COUNTERS] =
+    { "cycles", "instructions", "cache-misses", "dTLB-load-misses", "branch-misses" };
+
+
+#if defined(__linux__)
+
+
+// the counters of one thread that was running at open(), -1 where the
+// counter could not be opened
+struct Thread_counters
+{
+    int  fd[Perf_counters::N_COUNTERS];
+};
+
+
+std::mutex                    mutex_;
+bool                          open_ = false;
+bool                          available_[Perf_counters::N_COUNTERS];
+std::vector<Thread_counters>  threads_;
+
+
+void attributes(Perf_counters::Counter c, perf_event_attr& attr)
+{
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the threads a counted thread starts are counted too, and read along
+    // with it while they run (a group cannot inherit before Linux 6.12)
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (c)
+    {
+        case Perf_counters::CYCLES:        attr.config = PERF_COUNT_HW_CPU_CYCLES;    break;
+        case Perf_counters::INSTRUCTIONS:  attr.config = PERF_COUNT_HW_INSTRUCTIONS;  break;
+        case Perf_counters::CACHE_MISSES:  attr.config = PERF_COUNT_HW_CACHE_MISSES;  break;
+        case Perf_counters::BRANCH_MISSES: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        case Perf_counters::TLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        default: break;
+    }
+}
+
+
+// open the counters of thread tid, false if none opened
+bool open_thread(int tid, Thread_counters& t)
+{
+    bool opened = false;
+    for (int c=0; c<Perf_counters::N_COUNTERS; ++c)
+    {
+        perf_event_attr attr;
+        attributes(Perf_counters::Counter(c), attr);
+        t.fd[c] = (int) syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+        opened = opened || t.fd[c] >= 0;
+    }
+    return opened;
+}
+
+
+void close_thread(Thread_counters& t)
+{
+    for (int c=0; c<Perf_counters::N_COUNTERS; ++c)
+        if (t.fd[c] >= 0) ::close(t.fd[c]);
+}
+
+
+// open the counters of the running threads
+void open_threads()
+{
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return;
+    while (dirent* entry = readdir(dir))
+    {
+        const int tid = atoi(entry->d_name);
+        Thread_counters t;
+        if (tid > 0 && open_thread(tid, t)) threads_.push_back(t);
+    }
+    closedir(dir);
+}
+
+
+#endif
+
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Perf_counters::open()
+{
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_) return true;
+
+    // which counters the PMU has, tried on the calling thread
+    Thread_counters probe;
+    if (!open_thread(0, probe)) return false;
+    for (int c=0; c<N_COUNTERS; ++c)
+        available_[c] = probe.fd[c] >= 0;
+    close_thread(probe);
+
+    open_threads();
+    open_ = !threads_.empty();
+    return open_;
+#else
+    return false;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Perf_counters::close()
+{
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t t=0; t<threads_.size(); ++t)
+        close_thread(threads_[t]);
+    threads_.clear();
+    open_ = false;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Perf_counters::is_open()
+{
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_;
+#else
+    return false;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Perf_counters::available(Counter c)
+{
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_ && available_[c];
+#else
+    (void) c;
+    return false;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+const char* Perf_counters::name(Counter c)
+{
+    return names_[c];
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Perf_counters::Sample Perf_counters::read()
+{
+    Sample s;
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) return s;
+
+    // value, time enabled, time running
+    unsigned long long buffer[3];
+    for (size_t t=0; t<threads_.size(); ++t)
+    {
+        for (int c=0; c<N_COUNTERS; ++c)
+        {
+            const int fd = threads_[t].fd[c];
+            if (fd < 0 || ::read(fd, buffer, sizeof(buffer)) != ssize_t(sizeof(buffer)) ||
+                buffer[2] == 0)
+                continue;
+            s.value[c] += double(buffer[0]) * double(buffer[1]) / double(buffer[2]);
+        }
+    }
+#endif
+    return s;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+std::string Perf_counters::format(const Sample& s)
+{
+    // 1.2G, 3.4M, 56k
+    struct Count
+    {
+        static void append(std::string& text, double n, const char* what)
+        {
+            char buffer[64];
+            if (n >= 1e9)      snprintf(buffer, sizeof(buffer), ", %.1fG %s", n * 1e-9, what);
+            else if (n >= 1e6) snprintf(buffer, sizeof(buffer), ", %.1fM %s", n * 1e-6, what);
+            else if (n >= 1e3) snprintf(buffer, sizeof(buffer), ", %.0fk %s", n * 1e-3, what);
+            else               snprintf(buffer, sizeof(buffer), ", %.0f %s", n, what);
+            text += buffer;
+        }
+    };
+
+    std::string text, misses;
+    if (available(CYCLES) && available(INSTRUCTIONS))
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "IPC %.2f", s.ipc());
+        text = buffer;
+    }
+    if (available(CACHE_MISSES))  Count::append(misses, s.value[CACHE_MISSES], "cache");
+    if (available(TLB_MISSES))    Count::append(misses, s.value[TLB_MISSES], "dTLB");
+    if (available(BRANCH_MISSES)) Count::append(misses, s.value[BRANCH_MISSES], "branch");
+    if (!misses.empty())
+        text += (text.empty() ? misses.substr(2) : misses) + " misses";
+    return text.empty() ? "no counters" : text;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
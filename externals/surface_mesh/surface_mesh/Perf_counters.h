@@ -0,0 +1,100 @@
+//=============================================================================
+#ifndef SURFACE_MESH_PERF_COUNTERS_H
+#define SURFACE_MESH_PERF_COUNTERS_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <string>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// Hardware counters of the whole process through perf_event (Linux), for
+/// telling what a reordering or a data layout change did to the caches.
+/// Counting is off until open(); it needs a PMU the kernel exposes (not
+/// most virtual machines) and perf_event_paranoid <= 2. Only user space is
+/// counted. Every thread running at open() is counted together with the
+/// threads it starts later, e.g. an OpenMP pool; a read() sums them all.
+/// Counters the PMU cannot schedule all the time are scaled by the fraction
+/// they ran.
+class Perf_counters
+{
+public:
+
+    enum Counter
+    {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,    ///< last level cache misses
+        TLB_MISSES,      ///< data TLB load misses
+        BRANCH_MISSES,
+        N_COUNTERS
+    };
+
+    /// counts of all threads since open(), or their difference
+    struct Sample
+    {
+        double value[N_COUNTERS];
+
+        Sample() { for (int i=0; i<N_COUNTERS; ++i) value[i] = 0.0; }
+
+        Sample operator-(const Sample& s) const
+        {
+            Sample d;
+            for (int i=0; i<N_COUNTERS; ++i) d.value[i] = value[i] - s.value[i];
+            return d;
+        }
+
+        Sample& operator+=(const Sample& s)
+        {
+            for (int i=0; i<N_COUNTERS; ++i) value[i] += s.value[i];
+            return *this;
+        }
+
+        /// instructions per cycle, 0 without cycles
+        double ipc() const
+        {
+            return value[CYCLES] > 0.0 ? value[INSTRUCTIONS] / value[CYCLES] : 0.0;
+        }
+    };
+
+    /// start counting, false if no counter could be opened; opening twice
+    /// keeps the first counts
+    static bool open();
+
+    /// stop counting and release the counters
+    static void close();
+
+    /// is counting on?
+    static bool is_open();
+
+    /// could counter \c c be opened? The others read 0.
+    static bool available(Counter c);
+
+    /// short name of counter \c c, e.g. "cache-misses"
+    static const char* name(Counter c);
+
+    /// the counts since open(), all zero while counting is off; takes a
+    /// read per counter and thread running at open()
+    static Sample read();
+
+    /// "IPC 1.52, 3.1M cache, 120k dTLB, 40k branch misses" for a
+    /// difference of samples, the counters that are not available left out
+    static std::string format(const Sample& s);
+};
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_PERF_COUNTERS_H
+//=============================================================================
@@ -0,0 +1,307 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Reorder.h>
+#include <surface_mesh/Trace.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <stdint.h>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+
+// bits per coordinate of the curve keys, 3*21 fit into 64 bits
+const int key_bits = 21;
+
+
+// quantize the vertex positions to the integer grid [0, 2^key_bits) over the
+// bounding box
+void quantize(const Surface_mesh& mesh, std::vector<uint32_t>& grid)
+{
+    Surface_mesh::Vertex_property<Point> points = mesh.get_vertex_property<Point>("v:point");
+    const int nV = mesh.vertices_size();
+
+    Point bbmin(FLT_MAX), bbmax(-FLT_MAX);
+    for (int i=0; i<nV; ++i)
+    {
+        bbmin.minimize(points[Surface_mesh::Vertex(i)]);
+        bbmax.maximize(points[Surface_mesh::Vertex(i)]);
+    }
+
+    const double cells = (double) ((1u << key_bits) - 1);
+    double scale[3];
+    for (int k=0; k<3; ++k)
+        scale[k] = (bbmax[k] > bbmin[k]) ? cells / (bbmax[k] - bbmin[k]) : 0.0;
+
+    grid.resize(3*nV);
+    for (int i=0; i<nV; ++i)
+    {
+        const Point& p = points[Surface_mesh::Vertex(i)];
+        for (int k=0; k<3; ++k)
+            grid[3*i+k] = (uint32_t) ((p[k] - bbmin[k]) * scale[k] + 0.5);
+    }
+}
+
+
+// interleave the bits of x, y, z, x being the most significant
+uint64_t interleave(const uint32_t x[3])
+{
+    uint64_t key = 0;
+    for (int b=key_bits-1; b>=0; --b)
+        for (int k=0; k<3; ++k)
+            key = (key << 1) | ((x[k] >> b) & 1);
+    return key;
+}
+
+
+// Morton key
+uint64_t morton_key(const uint32_t* p)
+{
+    return interleave(p);
+}
+
+
+// Hilbert key, the coordinates are converted to the transposed Hilbert index
+// (J. Skilling, Programming the Hilbert curve, 2004) and then interleaved
+uint64_t hilbert_key(const uint32_t* p)
+{
+    uint32_t x[3] = { p[0], p[1], p[2] };
+    const uint32_t M = 1u << (key_bits-1);
+
+    // inverse undo
+    for (uint32_t Q=M; Q>1; Q>>=1)
+    {
+        const uint32_t P = Q-1;
+        for (int i=0; i<3; ++i)
+        {
+            if (x[i] & Q) x[0] ^= P;
+            else
+            {
+                const uint32_t t = (x[0] ^ x[i]) & P;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+
+    // Gray encode
+    for (int i=1; i<3; ++i) x[i] ^= x[i-1];
+    uint32_t t = 0;
+    for (uint32_t Q=M; Q>1; Q>>=1)
+        if (x[2] & Q) t ^= Q-1;
+    for (int i=0; i<3; ++i) x[i] ^= t;
+
+    return interleave(x);
+}
+
+
+// sort the vertices along a space filling curve
+template <typename Key>
+void curve_order(const Surface_mesh& mesh, Key key, std::vector<int>& order)
+{
+    std::vector<uint32_t> grid;
+    quantize(mesh, grid);
+
+    const int nV = mesh.vertices_size();
+    std::vector< std::pair<uint64_t,int> > keys(nV);
+    for (int i=0; i<nV; ++i)
+        keys[i] = std::make_pair(key(&grid[3*i]), i);
+    std::sort(keys.begin(), keys.end());
+
+    order.resize(nV);
+    for (int i=0; i<nV; ++i)
+        order[i] = keys[i].second;
+}
+
+
+// breadth first search from seed, appends the reached vertices to order with
+// the neighbors of each vertex sorted by increasing valence; returns the
+// number of levels, last_level is the index of the first vertex of the last
+int bfs(const Surface_mesh& mesh, Surface_mesh::Vertex seed,
+        std::vector<int>& order, std::vector<int>& visited, int stamp,
+        size_t& last_level)
+{
+    const size_t start = order.size();
+    std::vector< std::pair<unsigned int,int> > ring;
+
+    order.push_back(seed.idx());
+    visited[seed.idx()] = stamp;
+    last_level = start;
+    int depth = 1;
+
+    for (size_t head=start, level_end=start+1; head<order.size(); ++head)
+    {
+        if (head == level_end)
+        {
+            last_level = head;
+            level_end  = order.size();
+            ++depth;
+        }
+
+        ring.clear();
+        Surface_mesh::Vertex_around_vertex_circulator vc, vc_end;
+        vc = vc_end = mesh.vertices(Surface_mesh::Vertex(order[head]));
+        if (vc) do
+        {
+            if (visited[(*vc).idx()] != stamp)
+            {
+                visited[(*vc).idx()] = stamp;
+                ring.push_back(std::make_pair(mesh.valence(*vc), (*vc).idx()));
+            }
+        }
+        while (++vc != vc_end);
+
+        std::sort(ring.begin(), ring.end());
+        for (size_t i=0; i<ring.size(); ++i)
+            order.push_back(ring[i].second);
+    }
+
+    return depth;
+}
+
+
+// reverse Cuthill-McKee, per connected component from a pseudo-peripheral
+// vertex found by repeated breadth first searches
+void rcm_order(const Surface_mesh& mesh, std::vector<int>& order)
+{
+    const int nV = mesh.vertices_size();
+    std::vector<int>  visited(nV, -1);
+    std::vector<bool> done(nV, false);
+    int stamp = 0;
+
+    order.clear();
+    order.reserve(nV);
+    std::vector<int> component;
+    size_t last;
+
+    for (int s=0; s<nV; ++s)
+    {
+        if (done[s]) continue;
+
+        // move the seed to the last level while that increases the depth,
+        // preferring vertices of small valence
+        Surface_mesh::Vertex seed(s);
+        int depth = 0;
+        for (int iter=0; iter<8; ++iter)
+        {
+            component.clear();
+            int d = bfs(mesh, seed, component, visited, ++stamp, last);
+            if (d <= depth) break;
+            depth = d;
+
+            Surface_mesh::Vertex best(component[last]);
+            for (size_t i=last+1; i<component.size(); ++i)
+                if (mesh.valence(Surface_mesh::Vertex(component[i])) < mesh.valence(best))
+                    best = Surface_mesh::Vertex(component[i]);
+            seed = best;
+        }
+
+        component.clear();
+        bfs(mesh, seed, component, visited, ++stamp, last);
+        for (size_t i=0; i<component.size(); ++i)
+        {
+            done[component[i]] = true;
+            order.push_back(component[i]);
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+}
+
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+void vertex_order(const Surface_mesh& mesh, Reorder_method method, std::vector<int>& order)
+{
+    switch (method)
+    {
+        case REORDER_MORTON:  curve_order(mesh, morton_key,  order); break;
+        case REORDER_HILBERT: curve_order(mesh, hilbert_key, order); break;
+        case REORDER_RCM:     rcm_order(mesh, order); break;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void reorder(Surface_mesh& mesh, Reorder_method method)
+{
+    SURFACE_MESH_TRACE_ZONE("reorder");
+    mesh.garbage_collection();
+
+    const int nV(mesh.vertices_size()), nE(mesh.edges_size()), nF(mesh.faces_size());
+
+
+    // vertices
+    std::vector<int> vertex_order;
+    surface_mesh::vertex_order(mesh, method, vertex_order);
+
+    std::vector<int> vmap(nV);
+    for (int i=0; i<nV; ++i)
+        vmap[vertex_order[i]] = i;
+
+
+    // edges by their new endpoints
+    std::vector< std::pair<uint64_t,int> > keys(nE);
+    for (int i=0; i<nE; ++i)
+    {
+        Surface_mesh::Edge e(i);
+        uint64_t a = vmap[mesh.vertex(e, 0).idx()];
+        uint64_t b = vmap[mesh.vertex(e, 1).idx()];
+        if (a > b) std::swap(a, b);
+        keys[i] = std::make_pair((a << 32) | b, i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int> edge_order(nE);
+    for (int i=0; i<nE; ++i)
+        edge_order[i] = keys[i].second;
+
+
+    // faces by their first new vertex
+    keys.resize(nF);
+    for (int i=0; i<nF; ++i)
+    {
+        uint64_t m = nV;
+        Surface_mesh::Vertex_around_face_circulator fv, fv_end;
+        fv = fv_end = mesh.vertices(Surface_mesh::Face(i));
+        do
+        {
+            m = std::min(m, (uint64_t) vmap[(*fv).idx()]);
+        }
+        while (++fv != fv_end);
+        keys[i] = std::make_pair((m << 32) | (uint64_t) i, i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int> face_order(nF);
+    for (int i=0; i<nF; ++i)
+        face_order[i] = keys[i].second;
+
+
+    mesh.permute(vertex_order, edge_order, face_order);
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -0,0 +1,51 @@
+//=============================================================================
+
+
+#ifndef SURFACE_MESH_REORDER_H
+#define SURFACE_MESH_REORDER_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Surface_mesh.h>
+#include <vector>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//=============================================================================
+
+
+/// vertex orderings for reorder()
+enum Reorder_method
+{
+    REORDER_MORTON,   ///< Z-order curve over the bounding box
+    REORDER_HILBERT,  ///< Hilbert curve over the bounding box
+    REORDER_RCM       ///< reverse Cuthill-McKee on the vertex graph
+};
+
+
+/// The vertex order of \c method without renumbering anything: \c order[i]
+/// is the vertex that reorder() would move to index \c i. Deleted vertices
+/// are ordered like the others.
+void vertex_order(const Surface_mesh& mesh, Reorder_method method,
+                  std::vector<int>& order);
+
+
+/// Renumber vertices, edges and faces so that elements that are close on the
+/// surface are close in memory. Vertices are sorted by \c method, faces by
+/// their smallest and edges by their two new vertex indices. Runs
+/// garbage_collection() first. \sa Surface_mesh::permute()
+void reorder(Surface_mesh& mesh, Reorder_method method = REORDER_HILBERT);
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_REORDER_H
+//=============================================================================
@@ -0,0 +1,387 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Shared_mesh.h>
+#include <surface_mesh/IO.h>
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+// The segment starts with this header, the mesh follows at 64 bytes. The
+// generation is a sequence lock: publish() makes it odd, writes the mesh,
+// size and topology and makes it even again. A reader copies the mesh
+// between two loads of the generation and keeps it only if they match.
+struct Shared_mesh_writer::Header
+{
+    char                   magic[8];
+    uint32_t               version;
+    uint32_t               reserved;
+    uint64_t               capacity;             // bytes after the header
+    std::atomic<uint64_t>  generation;
+    std::atomic<uint64_t>  topology_generation;  // publish() that last changed it
+    std::atomic<uint64_t>  size;                 // bytes of the mesh
+    char                   padding[16];
+};
+
+
+static const char     shared_magic[8] = { 'S','M','S','H','A','R','E','\0' };
+static const uint32_t shared_version  = 1;
+
+
+// the mesh, behind the header
+static inline char* shared_payload(const void* header)
+{
+    return (char*) header + 64;
+}
+
+
+#if !defined(_WIN32)
+// shm_open() wants one leading slash and no other
+static std::string shm_name(const std::string& name)
+{
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+#endif
+
+
+//-----------------------------------------------------------------------------
+
+
+Shared_mesh_writer::
+Shared_mesh_writer()
+    : header_(0), capacity_(0)
+#if defined(_WIN32)
+    , mapping_(0)
+#endif
+{
+    static_assert(sizeof(Header) == 64, "the mesh starts at 64 bytes");
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Shared_mesh_writer::
+~Shared_mesh_writer()
+{
+    close();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Shared_mesh_writer::
+open(const std::string& name, size_t capacity)
+{
+    close();
+    const size_t bytes = sizeof(Header) + capacity;
+
+#if defined(_WIN32)
+
+    // reserved, publish() commits it
+    const unsigned long long n = bytes;
+    mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE | SEC_RESERVE,
+                                  (DWORD) (n >> 32), (DWORD) n, name.c_str());
+    if (!mapping_) return false;
+    void* data = MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, 0);
+    if (!data || !VirtualAlloc(data, sizeof(Header), MEM_COMMIT, PAGE_READWRITE))
+    {
+        if (data) UnmapViewOfFile(data);
+        CloseHandle(mapping_);
+        mapping_ = 0;
+        return false;
+    }
+
+#else
+
+    // a segment of an earlier writer is reused if it is large enough, so
+    // that attached readers keep seeing new generations
+    const int fd = shm_open(shm_name(name).c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        ((size_t) st.st_size < bytes && ftruncate(fd, (off_t) bytes) != 0))
+    {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+
+#endif
+
+    header_   = (Header*) data;
+    capacity_ = capacity;
+
+    if (memcmp(header_->magic, shared_magic, sizeof(shared_magic)) != 0 ||
+        header_->version != shared_version)
+    {
+        new (header_) Header();
+        header_->version = shared_version;
+        header_->generation.store(0, std::memory_order_relaxed);
+        header_->topology_generation.store(0, std::memory_order_relaxed);
+        header_->size.store(0, std::memory_order_relaxed);
+        memcpy(header_->magic, shared_magic, sizeof(shared_magic));
+    }
+    // readers map what the header announces
+    header_->capacity = capacity;
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Shared_mesh_writer::
+close()
+{
+    if (!header_) return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(header_);
+    CloseHandle(mapping_);
+    mapping_ = 0;
+#else
+    munmap(header_, sizeof(Header) + capacity_);
+#endif
+
+    header_   = 0;
+    capacity_ = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Shared_mesh_writer::
+publish(const Surface_mesh& mesh, bool topology_changed)
+{
+    if (!header_) return false;
+
+    char* payload = shared_payload(header_);
+#if defined(_WIN32)
+    // committing is idempotent, the pages of earlier meshes stay
+    VirtualAlloc(payload, capacity_, MEM_COMMIT, PAGE_READWRITE);
+#endif
+
+    const uint64_t g = header_->generation.load(std::memory_order_relaxed);
+    header_->generation.store(g + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t size = write_poly(mesh, payload, capacity_);
+    const bool fits = (size <= capacity_);
+    if (!fits)
+    {
+        std::cerr << "[Shared_mesh_writer] a mesh of " << size
+                  << " bytes exceeds the segment of " << capacity_ << std::endl;
+    }
+
+    // an empty mesh tells the readers to skip this generation
+    header_->size.store(fits ? size : 0, std::memory_order_relaxed);
+    if (topology_changed || !fits)
+        header_->topology_generation.store(g + 2, std::memory_order_relaxed);
+    header_->generation.store(g + 2, std::memory_order_release);
+
+    return fits;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+uint64_t
+Shared_mesh_writer::
+generation() const
+{
+    return header_ ? header_->generation.load(std::memory_order_relaxed) : 0;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Shared_mesh_writer::
+remove(const std::string& name)
+{
+#if defined(_WIN32)
+    // the mapping goes away with its last handle
+    (void) name;
+    return true;
+#else
+    return shm_unlink(shm_name(name).c_str()) == 0;
+#endif
+}
+
+
+//== Shared_mesh_reader =======================================================
+
+
+Shared_mesh_reader::
+Shared_mesh_reader()
+    : header_(0), capacity_(0), generation_(0)
+#if defined(_WIN32)
+    , mapping_(0)
+#endif
+{
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Shared_mesh_reader::
+~Shared_mesh_reader()
+{
+    close();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Shared_mesh_reader::
+open(const std::string& name)
+{
+    typedef Shared_mesh_writer::Header Header;
+    close();
+
+#if defined(_WIN32)
+
+    mapping_ = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (!mapping_) return false;
+    const void* data = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping_);
+        mapping_ = 0;
+        return false;
+    }
+    // the view spans the section, the writer committed the header
+    const size_t bytes = sizeof(Header) + (size_t) ((const Header*) data)->capacity;
+
+#else
+
+    const int fd = shm_open(shm_name(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header))
+    {
+        ::close(fd);
+        return false;
+    }
+    const size_t bytes = (size_t) st.st_size;
+    void* data = mmap(0, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+
+#endif
+
+    header_     = (const Header*) data;
+    capacity_   = bytes - sizeof(Header);
+    generation_ = 0;
+
+    if (bytes < sizeof(Header) ||
+        memcmp(header_->magic, shared_magic, sizeof(shared_magic)) != 0 ||
+        header_->version != shared_version)
+    {
+        std::cerr << "[Shared_mesh_reader] " << name << " is no mesh segment" << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Shared_mesh_reader::
+close()
+{
+    if (!header_) return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(header_);
+    CloseHandle(mapping_);
+    mapping_ = 0;
+#else
+    munmap((void*) header_, sizeof(Shared_mesh_writer::Header) + capacity_);
+#endif
+
+    header_   = 0;
+    capacity_ = 0;
+    std::vector<char>().swap(buffer_);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Shared_mesh_reader::
+update(Surface_mesh& mesh, bool* topology_changed)
+{
+    if (!header_) return false;
+
+    const uint64_t g = header_->generation.load(std::memory_order_acquire);
+    if (g == generation_ || (g & 1)) return false;
+
+    // a writer that was reopened with a larger capacity grew the segment
+    // beyond this mapping; its meshes fit once the reader is reopened
+    const size_t   size     = header_->size.load(std::memory_order_relaxed);
+    const uint64_t topology = header_->topology_generation.load(std::memory_order_relaxed);
+    if (size > capacity_) return false;
+
+    // copy out, the writer may start the next generation meanwhile
+    buffer_.resize(size);
+    if (size) memcpy(&buffer_[0], shared_payload(header_), size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header_->generation.load(std::memory_order_relaxed) != g) return false;
+
+    // a generation that does not parse is not tried again
+    const bool changed = (topology > generation_);
+    generation_ = g;
+    if (!size || !read_poly(mesh, &buffer_[0], size)) return false;
+
+    if (topology_changed) *topology_changed = changed;
+    return true;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -0,0 +1,127 @@
+//=============================================================================
+#ifndef SURFACE_MESH_SHARED_MESH_H
+#define SURFACE_MESH_SHARED_MESH_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Surface_mesh.h>
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// Publishes a mesh into a named shared memory segment for other processes,
+/// e.g. a batch run for a viewer. The segment holds the property arrays in
+/// the layout of write_poly() behind a generation counter that is odd
+/// while a mesh is written and grows by two with every publish().
+/// One writer per segment; the segment outlives the writer, so that a
+/// reader may attach after the run, until remove() is called.
+class Shared_mesh_writer
+{
+public:
+
+    /// 1 GB of address space, only the pages a mesh touches are backed
+    static const size_t default_capacity = size_t(1) << 30;
+
+    Shared_mesh_writer();
+    ~Shared_mesh_writer();
+
+    /// create or reuse the segment \c name with room for \c capacity bytes
+    /// of mesh. a segment that exists keeps its generation.
+    bool open(const std::string& name, size_t capacity = default_capacity);
+
+    /// unmap the segment, it stays for the readers
+    void close();
+
+    bool is_open() const { return header_ != 0; }
+
+    /// copy all properties of \c mesh of a type write_poly() knows into the
+    /// segment. \c topology_changed false promises the readers the
+    /// connectivity of the last publish(). false if the mesh does not fit.
+    bool publish(const Surface_mesh& mesh, bool topology_changed = true);
+
+    /// generation of the last publish()
+    uint64_t generation() const;
+
+    /// delete the segment \c name once every process unmapped it
+    static bool remove(const std::string& name);
+
+private:
+
+    Shared_mesh_writer(const Shared_mesh_writer&);
+    Shared_mesh_writer& operator=(const Shared_mesh_writer&);
+
+    struct Header;
+    Header* header_;
+    size_t  capacity_;
+
+#if defined(_WIN32)
+    void* mapping_;
+#endif
+
+    friend class Shared_mesh_reader;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Attaches to the segment of a Shared_mesh_writer and copies out each new
+/// generation. Polling is a load of the counter; a mesh that was written
+/// while it was copied is dropped and read by the next update().
+class Shared_mesh_reader
+{
+public:
+
+    Shared_mesh_reader();
+    ~Shared_mesh_reader();
+
+    /// map the segment \c name, false if no writer created it
+    bool open(const std::string& name);
+
+    void close();
+
+    bool is_open() const { return header_ != 0; }
+
+    /// replace \c mesh by the mesh of the segment if a generation newer than
+    /// the last one read is complete, false otherwise. \c topology_changed
+    /// tells if the writer changed the connectivity since then.
+    bool update(Surface_mesh& mesh, bool* topology_changed = NULL);
+
+    /// generation of the last update(), 0 before the first one
+    uint64_t generation() const { return generation_; }
+
+private:
+
+    Shared_mesh_reader(const Shared_mesh_reader&);
+    Shared_mesh_reader& operator=(const Shared_mesh_reader&);
+
+    const Shared_mesh_writer::Header* header_;
+    size_t                            capacity_;
+    uint64_t                          generation_;
+    std::vector<char>                 buffer_;
+
+#if defined(_WIN32)
+    void* mapping_;
+#endif
+};
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_SHARED_MESH_H
+//=============================================================================
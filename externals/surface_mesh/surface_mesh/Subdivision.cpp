@@ -0,0 +1,447 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Subdivision.h>
+#include <surface_mesh/Trace.h>
+
+#include <climits>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// The levels of subdivide(), a friend of Surface_mesh so that the
+/// connectivity of a level is allocated once and written in parallel. Every
+/// new element has a closed-form index from the old element it comes from:
+/// the old vertices keep theirs and the new vertices, edges and faces of an
+/// old edge or face follow in blocks of a fixed size.
+class Subdivider
+{
+public:
+
+    /// one level of Loop subdivision of a triangle mesh without garbage
+    static void loop(Surface_mesh& mesh);
+
+    /// one level of sqrt(3) subdivision of a triangle mesh without garbage
+    static void sqrt3(Surface_mesh& mesh);
+
+
+private:
+
+    typedef Surface_mesh::Vertex   Vertex;
+    typedef Surface_mesh::Halfedge Halfedge;
+    typedef Surface_mesh::Edge     Edge;
+    typedef Surface_mesh::Face     Face;
+
+    /// the connectivity before the level, -1 for invalid handles
+    struct Old_connectivity
+    {
+        std::vector<int> to, next, face;   // per halfedge
+        std::vector<int> face_halfedge;    // per face
+        std::vector<int> vertex_halfedge;  // per vertex
+    };
+
+    static void snapshot(const Surface_mesh& mesh, Old_connectivity& old);
+
+    /// resize the mesh to the counts of the new level; the halfedge, edge
+    /// and face properties start over from their default values
+    static void resize(Surface_mesh& mesh, int nv, int ne, int nf);
+
+    /// target vertex, face (-1 for none) and next halfedge of halfedge h
+    static void set(Surface_mesh& mesh, int h, int to, int face, int next)
+    {
+        Surface_mesh::Halfedge_connectivity& hc = mesh.hconn_[Halfedge(h)];
+        hc.vertex_        = Vertex(to);
+        hc.face_          = Face(face);
+        hc.next_halfedge_ = Halfedge(next);
+        mesh.hconn_[Halfedge(next)].prev_halfedge_ = Halfedge(h);
+    }
+
+    static void set_positions(Surface_mesh& mesh, const std::vector<Point>& points)
+    {
+        const int n = (int) points.size();
+#pragma omp parallel for schedule(static)
+        for (int i=0; i<n; ++i)
+            mesh.vpoint_[Vertex(i)] = points[i];
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+void Subdivider::snapshot(const Surface_mesh& mesh, Old_connectivity& old)
+{
+    const int nh = mesh.halfedges_size();
+    const int nf = mesh.faces_size();
+    const int nv = mesh.vertices_size();
+    old.to.resize(nh);
+    old.next.resize(nh);
+    old.face.resize(nh);
+    old.face_halfedge.resize(nf);
+    old.vertex_halfedge.resize(nv);
+
+#pragma omp parallel for schedule(static)
+    for (int h=0; h<nh; ++h)
+    {
+        const Surface_mesh::Halfedge_connectivity& hc = mesh.hconn_[Halfedge(h)];
+        old.to[h]   = (int) hc.vertex_.idx();
+        old.next[h] = (int) hc.next_halfedge_.idx();
+        old.face[h] = hc.face_.is_valid() ? (int) hc.face_.idx() : -1;
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int f=0; f<nf; ++f)
+        old.face_halfedge[f] = (int) mesh.fconn_[Face(f)].halfedge_.idx();
+
+#pragma omp parallel for schedule(static)
+    for (int v=0; v<nv; ++v)
+    {
+        const Halfedge h = mesh.vconn_[Vertex(v)].halfedge_;
+        old.vertex_halfedge[v] = h.is_valid() ? (int) h.idx() : -1;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Subdivider::resize(Surface_mesh& mesh, int nv, int ne, int nf)
+{
+    mesh.vprops_.resize(nv);
+    mesh.hprops_.resize(0);
+    mesh.hprops_.resize(2*ne);
+    mesh.eprops_.resize(0);
+    mesh.eprops_.resize(ne);
+    mesh.fprops_.resize(0);
+    mesh.fprops_.resize(nf);
+
+    mesh.deleted_vertices_ = mesh.deleted_edges_ = mesh.deleted_faces_ = 0;
+    mesh.garbage_ = false;
+    ++mesh.topology_revision_;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Subdivider::loop(Surface_mesh& mesh)
+{
+    const int nv = mesh.vertices_size();
+    const int ne = mesh.edges_size();
+    const int nf = mesh.faces_size();
+    const Surface_mesh::Vertex_property<Point>& p = mesh.vpoint_;
+
+
+    // the old vertices move, vertex nv+e is the one of edge e
+    std::vector<Point> points(nv + ne);
+
+#pragma omp parallel for schedule(static)
+    for (int i=0; i<nv; ++i)
+    {
+        const Vertex v(i);
+        const Halfedge h = mesh.halfedge(v);
+        if (!h.is_valid())
+        {
+            points[i] = p[v];
+        }
+        else if (mesh.is_boundary(h))
+        {
+            // the cubic B-spline of the boundary polygon
+            const Vertex next = mesh.to_vertex(h);
+            const Vertex prev = mesh.from_vertex(mesh.prev_halfedge(h));
+            points[i] = Scalar(0.75) * p[v] + Scalar(0.125) * (p[next] + p[prev]);
+        }
+        else
+        {
+            Point sum(0);
+            int n = 0;
+            Surface_mesh::Vertex_around_vertex_circulator vv = mesh.vertices(v), vv_end = vv;
+            do
+            {
+                sum += p[*vv];
+                ++n;
+            }
+            while (++vv != vv_end);
+            const double c = 0.375 + 0.25 * std::cos(2.0 * M_PI / n);
+            const Scalar beta = Scalar((0.625 - c * c) / n);
+            points[i] = (1 - n * beta) * p[v] + beta * sum;
+        }
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int e=0; e<ne; ++e)
+    {
+        const Halfedge h0(2*e), h1(2*e+1);
+        const Point& a = p[mesh.to_vertex(h0)];
+        const Point& b = p[mesh.to_vertex(h1)];
+        if (mesh.is_boundary(Edge(e)))
+        {
+            points[nv+e] = Scalar(0.5) * (a + b);
+        }
+        else
+        {
+            const Point& c = p[mesh.to_vertex(mesh.next_halfedge(h0))];
+            const Point& d = p[mesh.to_vertex(mesh.next_halfedge(h1))];
+            points[nv+e] = Scalar(0.375) * (a + b) + Scalar(0.125) * (c + d);
+        }
+    }
+
+
+    Old_connectivity old;
+    snapshot(mesh, old);
+    resize(mesh, nv + ne, 2*ne + 3*nf, 4*nf);
+    set_positions(mesh, points);
+
+
+    // old halfedge h = 2e+s is split into first(h) up to the vertex of e and
+    // second(h) from there; edge e becomes the edges 2e and 2e+1. the three
+    // edges inside face f are 2ne+3f+k, their halfedges start at 4ne
+    struct Split
+    {
+        static int first(int h)  { return 2*h + (h & 1); }
+        static int second(int h) { return 2*h + 2 - 3*(h & 1); }
+    };
+    const int inner = 4*ne;
+
+    // face f becomes the corner faces 4f+k at the target of its halfedge
+    // h_k and the center face 4f+3; inner halfedge 2k runs between the
+    // vertices of h_(k+1) and h_k, its twin 2k+1 back along the center face
+#pragma omp parallel for schedule(static)
+    for (int f=0; f<nf; ++f)
+    {
+        int h[3];
+        h[0] = old.face_halfedge[f];
+        h[1] = old.next[h[0]];
+        h[2] = old.next[h[1]];
+
+        for (int k=0; k<3; ++k)
+        {
+            const int hk = h[k], hn = h[(k+1)%3];
+            const int in     = inner + 6*f + 2*k;
+            const int in_prev = inner + 6*f + 2*((k+2)%3);
+            const int center_next = inner + 6*f + 2*((k+1)%3) + 1;
+
+            set(mesh, Split::second(hk), old.to[hk],      4*f + k,       Split::first(hn));
+            set(mesh, Split::first(hk),  nv + (hk >> 1),  4*f + (k+2)%3, in_prev);
+            set(mesh, in,                nv + (hk >> 1),  4*f + k,       Split::second(hk));
+            set(mesh, in + 1,            nv + (hn >> 1),  4*f + 3,       center_next);
+            mesh.fconn_[Face(4*f + k)].halfedge_ = Halfedge(Split::second(hk));
+        }
+        mesh.fconn_[Face(4*f + 3)].halfedge_ = Halfedge(inner + 6*f + 1);
+    }
+
+    // the boundary halfedges continue along the boundary
+    const int nh = 2*ne;
+#pragma omp parallel for schedule(static)
+    for (int h=0; h<nh; ++h)
+    {
+        if (old.face[h] != -1) continue;
+        set(mesh, Split::first(h),  nv + (h >> 1), -1, Split::second(h));
+        set(mesh, Split::second(h), old.to[h],     -1, Split::first(old.next[h]));
+    }
+
+    // outgoing halfedges, the boundary ones where there are
+#pragma omp parallel for schedule(static)
+    for (int v=0; v<nv; ++v)
+    {
+        const int h = old.vertex_halfedge[v];
+        if (h != -1) mesh.vconn_[Vertex(v)].halfedge_ = Halfedge(Split::first(h));
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int e=0; e<ne; ++e)
+    {
+        const int h = old.face[2*e+1] == -1 ? 2*e+1 : 2*e;
+        mesh.vconn_[Vertex(nv + e)].halfedge_ = Halfedge(Split::second(h));
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Subdivider::sqrt3(Surface_mesh& mesh)
+{
+    const int nv = mesh.vertices_size();
+    const int ne = mesh.edges_size();
+    const int nf = mesh.faces_size();
+    const Surface_mesh::Vertex_property<Point>& p = mesh.vpoint_;
+
+
+    // the interior vertices are relaxed, vertex nv+f is the centroid of
+    // face f
+    std::vector<Point> points(nv + nf);
+
+#pragma omp parallel for schedule(static)
+    for (int i=0; i<nv; ++i)
+    {
+        const Vertex v(i);
+        const Halfedge h = mesh.halfedge(v);
+        if (!h.is_valid() || mesh.is_boundary(h))
+        {
+            points[i] = p[v];
+            continue;
+        }
+        Point sum(0);
+        int n = 0;
+        Surface_mesh::Vertex_around_vertex_circulator vv = mesh.vertices(v), vv_end = vv;
+        do
+        {
+            sum += p[*vv];
+            ++n;
+        }
+        while (++vv != vv_end);
+        const Scalar alpha = Scalar((4.0 - 2.0 * std::cos(2.0 * M_PI / n)) / 9.0);
+        points[i] = (1 - alpha) * p[v] + (alpha / n) * sum;
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int f=0; f<nf; ++f)
+    {
+        const Halfedge h0 = mesh.halfedge(Face(f));
+        const Halfedge h1 = mesh.next_halfedge(h0);
+        const Halfedge h2 = mesh.next_halfedge(h1);
+        points[nv+f] = (p[mesh.to_vertex(h0)] + p[mesh.to_vertex(h1)] + p[mesh.to_vertex(h2)])
+                       / Scalar(3);
+    }
+
+
+    Old_connectivity old;
+    snapshot(mesh, old);
+
+    // the position of every halfedge in its face
+    std::vector<int> corner(old.to.size(), -1);
+#pragma omp parallel for schedule(static)
+    for (int f=0; f<nf; ++f)
+    {
+        int h = old.face_halfedge[f];
+        for (int k=0; k<3; ++k, h = old.next[h])
+            corner[h] = k;
+    }
+
+    resize(mesh, nv + nf, ne + 3*nf, 3*nf);
+    set_positions(mesh, points);
+
+
+    // the edges keep their indices, the spoke edges from the centroid c of
+    // face f to the source a_k of its halfedge h_k are ne+3f+k, with the
+    // halfedges out of c at 2ne+6f+2k and the ones into c after them.
+    // face 3f+k is the one of h_k: an interior h_k is flipped to run from
+    // the centroid of the other face to c, a boundary one stays and closes
+    // the triangle a_k, a_k+1, c
+    const int spokes = 2*ne;
+#pragma omp parallel for schedule(static)
+    for (int f=0; f<nf; ++f)
+    {
+        int h[3];
+        h[0] = old.face_halfedge[f];
+        h[1] = old.next[h[0]];
+        h[2] = old.next[h[1]];
+        const int c = nv + f;
+
+        for (int k=0; k<3; ++k)
+        {
+            const int hk = h[k], hp = h[(k+2)%3];
+            const int a = old.to[hp];
+            const int out = spokes + 6*f + 2*k;
+            const int into = out + 1;
+
+            const int t = hk ^ 1;
+            if (old.face[t] != -1)
+            {
+                const int g = old.face[t];
+                set(mesh, hk,  c, 3*f + k, out);
+                set(mesh, out, a, 3*f + k, spokes + 6*g + 2*((corner[t]+1)%3) + 1);
+            }
+            else
+            {
+                set(mesh, hk,  old.to[hk], 3*f + k, spokes + 6*f + 2*((k+1)%3) + 1);
+                set(mesh, out, a,          3*f + k, hk);
+            }
+
+            // a_k to c closes the face of the twin of h_(k-1), or of h_(k-1)
+            // itself on the boundary
+            const int tp = hp ^ 1;
+            if (old.face[tp] != -1)
+                set(mesh, into, c, 3*old.face[tp] + corner[tp], tp);
+            else
+                set(mesh, into, c, 3*f + (k+2)%3, spokes + 6*f + 2*((k+2)%3));
+
+            mesh.fconn_[Face(3*f + k)].halfedge_ = Halfedge(hk);
+        }
+        mesh.vconn_[Vertex(c)].halfedge_ = Halfedge(spokes + 6*f);
+    }
+
+    // the boundary halfedges are not touched
+    const int nh = 2*ne;
+#pragma omp parallel for schedule(static)
+    for (int h=0; h<nh; ++h)
+    {
+        if (old.face[h] == -1)
+            set(mesh, h, old.to[h], -1, old.next[h]);
+    }
+
+    // outgoing halfedges: the boundary one, or the spoke into the centroid
+    // of the face of the old one
+#pragma omp parallel for schedule(static)
+    for (int v=0; v<nv; ++v)
+    {
+        const int h = old.vertex_halfedge[v];
+        if (h == -1) continue;
+        const int out = old.face[h] == -1 ? h : spokes + 6*old.face[h] + 2*corner[h] + 1;
+        mesh.vconn_[Vertex(v)].halfedge_ = Halfedge(out);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool subdivide(Surface_mesh& mesh, Subdivision_method method, unsigned int levels)
+{
+    SURFACE_MESH_TRACE_ZONE("subdivide");
+    if (!mesh.is_triangle_mesh()) return false;
+
+    // the halfedges are the largest count, indexed with int
+    uint64_t nh = 2 * uint64_t(mesh.n_edges()), nf = mesh.n_faces();
+    for (unsigned int l=0; l<levels; ++l)
+    {
+        if (method == SUBDIVISION_LOOP)
+        {
+            nh = 2*nh + 6*nf;
+            nf = 4*nf;
+        }
+        else
+        {
+            nh = nh + 6*nf;
+            nf = 3*nf;
+        }
+        if (nh > uint64_t(INT_MAX)) return false;
+    }
+
+    if (mesh.has_garbage()) mesh.garbage_collection();
+    for (unsigned int l=0; l<levels; ++l)
+    {
+        if (method == SUBDIVISION_LOOP) Subdivider::loop(mesh);
+        else                            Subdivider::sqrt3(mesh);
+    }
+    return true;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
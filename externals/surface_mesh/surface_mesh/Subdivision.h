@@ -0,0 +1,54 @@
+//=============================================================================
+
+
+#ifndef SURFACE_MESH_SUBDIVISION_H
+#define SURFACE_MESH_SUBDIVISION_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Surface_mesh.h>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//=============================================================================
+
+
+/// triangle mesh subdivision schemes for subdivide()
+enum Subdivision_method
+{
+    SUBDIVISION_LOOP,  ///< Loop: every edge is split, a triangle becomes four
+    SUBDIVISION_SQRT3  ///< Kobbelt's sqrt(3): a vertex per face, the old edges flipped
+};
+
+
+/** Refine the triangle mesh \c mesh \c levels times. Loop subdivision
+ splits every edge at its midpoint and every triangle into four, with
+ Loop's weights for the interior and the cubic B-spline rule along the
+ boundary. sqrt(3) subdivision inserts the centroid of every triangle and
+ flips the old interior edges, which triples the faces per level; its
+ boundary edges are not split and their vertices stay, so it is meant for
+ closed meshes.
+
+ The counts of a level follow from the old ones, so all vertices,
+ halfedges, edges and faces are allocated at once and written in parallel
+ by closed-form indices instead of one split() after the other. The old
+ vertices keep their indices and their vertex properties, the new ones and
+ all halfedge, edge and face properties get the default values. Runs
+ garbage_collection() first. returns false and leaves the mesh alone if it
+ is not a triangle mesh or gets too large for the index type. */
+bool subdivide(Surface_mesh& mesh, Subdivision_method method = SUBDIVISION_LOOP,
+               unsigned int levels = 1);
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_SUBDIVISION_H
+//=============================================================================
@@ -6,8 +6,12 @@
 
 #include <surface_mesh/Surface_mesh.h>
 #include <surface_mesh/IO.h>
+#include <surface_mesh/Trace.h>
 
+#include <algorithm>
 #include <cmath>
+#include <climits>
+#include <cstring>
 
 
 //== NAMESPACE ================================================================
@@ -23,7 +27,8 @@ Surface_mesh::
 Surface_mesh()
 {
     // allocate standard properties
-    // same list is used in operator=() and assign()
+    // same list is used in operator=() and assign(); they come first in
+    // their containers, new_vertex(), new_edge() and new_face() rely on it
     vconn_    = add_vertex_property<Vertex_connectivity>("v:connectivity");
     hconn_    = add_halfedge_property<Halfedge_connectivity>("h:connectivity");
     fconn_    = add_face_property<Face_connectivity>("f:connectivity");
@@ -34,6 +39,8 @@ Surface_mesh()
 
     deleted_vertices_ = deleted_edges_ = deleted_faces_ = 0;
     garbage_ = false;
+    topology_revision_ = 0;
+    topology_batch_ = false;
 }
 
 
@@ -55,11 +62,11 @@ operator=(const Surface_mesh& rhs)
 {
     if (this != &rhs)
     {
-        // deep copy of property containers
-        vprops_ = rhs.vprops_;
-        hprops_ = rhs.hprops_;
-        eprops_ = rhs.eprops_;
-        fprops_ = rhs.fprops_;
+        // deep copy of property containers, all four in parallel
+        Property_container* dst[] = { &vprops_, &hprops_, &eprops_, &fprops_ };
+        const Property_container* src[] = { &rhs.vprops_, &rhs.hprops_,
+                                            &rhs.eprops_, &rhs.fprops_ };
+        Property_container::copy(dst, src, 4);
 
         // property handles contain pointers, have to be reassigned
         vconn_    = vertex_property<Vertex_connectivity>("v:connectivity");
@@ -79,6 +86,11 @@ operator=(const Surface_mesh& rhs)
         deleted_edges_    = rhs.deleted_edges_;
         deleted_faces_    = rhs.deleted_faces_;
         garbage_          = rhs.garbage_;
+
+        // the revision is not copied, it only has to grow monotonically
+        ++topology_revision_;
+        topology_batch_ = false;
+        batch_vertices_.clear();
     }
 
     return *this;
@@ -88,6 +100,45 @@ operator=(const Surface_mesh& rhs)
 //-----------------------------------------------------------------------------
 
 
+void
+Surface_mesh::
+swap(Surface_mesh& rhs)
+{
+    if (this == &rhs) return;
+
+    // the handles point into the arrays, they move along with them
+    vprops_.swap(rhs.vprops_);
+    hprops_.swap(rhs.hprops_);
+    eprops_.swap(rhs.eprops_);
+    fprops_.swap(rhs.fprops_);
+    std::swap(vconn_,    rhs.vconn_);
+    std::swap(hconn_,    rhs.hconn_);
+    std::swap(fconn_,    rhs.fconn_);
+    std::swap(vdeleted_, rhs.vdeleted_);
+    std::swap(edeleted_, rhs.edeleted_);
+    std::swap(fdeleted_, rhs.fdeleted_);
+    std::swap(vpoint_,   rhs.vpoint_);
+    std::swap(vnormal_,  rhs.vnormal_);
+    std::swap(fnormal_,  rhs.fnormal_);
+
+    std::swap(deleted_vertices_, rhs.deleted_vertices_);
+    std::swap(deleted_edges_,    rhs.deleted_edges_);
+    std::swap(deleted_faces_,    rhs.deleted_faces_);
+    std::swap(garbage_,          rhs.garbage_);
+    std::swap(face_report_,      rhs.face_report_);
+
+    // both connectivities changed, both revisions pass the two old ones
+    const unsigned int revision = std::max(topology_revision_, rhs.topology_revision_) + 1;
+    topology_revision_ = rhs.topology_revision_ = revision;
+    topology_batch_ = rhs.topology_batch_ = false;
+    batch_vertices_.clear();
+    rhs.batch_vertices_.clear();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 Surface_mesh&
 Surface_mesh::
 assign(const Surface_mesh& rhs)
@@ -133,6 +184,11 @@ assign(const Surface_mesh& rhs)
         deleted_edges_    = rhs.deleted_edges_;
         deleted_faces_    = rhs.deleted_faces_;
         garbage_          = rhs.garbage_;
+
+        // the revision is not copied, it only has to grow monotonically
+        ++topology_revision_;
+        topology_batch_ = false;
+        batch_vertices_.clear();
     }
 
     return *this;
@@ -180,6 +236,9 @@ clear()
 
     deleted_vertices_ = deleted_edges_ = deleted_faces_ = 0;
     garbage_ = false;
+    ++topology_revision_;
+    topology_batch_ = false;
+    batch_vertices_.clear();
 }
 
 
@@ -202,9 +261,9 @@ free_memory()
 
 void
 Surface_mesh::
-reserve(unsigned int nvertices,
-        unsigned int nedges,
-        unsigned int nfaces )
+reserve(Index_type nvertices,
+        Index_type nedges,
+        Index_type nfaces )
 {
     vprops_.reserve(nvertices);
     hprops_.reserve(2*nedges);
@@ -216,31 +275,89 @@ reserve(unsigned int nvertices,
 //-----------------------------------------------------------------------------
 
 
-void
-Surface_mesh::
-property_stats() const
+namespace {
+
+
+// sums of the used and reserved bytes of a list of arrays
+size_t used_bytes(const std::vector<Property_memory>& props)
 {
-    std::vector<std::string> props;
+    size_t bytes = 0;
+    for (unsigned int i=0; i<props.size(); ++i) bytes += props[i].used;
+    return bytes;
+}
 
-    std::cout << "vertex properties:\n";
-    props = vertex_properties();
-    for (unsigned int i=0; i<props.size(); ++i)
-        std::cout << "\t" << props[i] << std::endl;
+size_t reserved_bytes(const std::vector<Property_memory>& props)
+{
+    size_t bytes = 0;
+    for (unsigned int i=0; i<props.size(); ++i) bytes += props[i].reserved;
+    return bytes;
+}
 
-    std::cout << "halfedge properties:\n";
-    props = halfedge_properties();
-    for (unsigned int i=0; i<props.size(); ++i)
-        std::cout << "\t" << props[i] << std::endl;
 
-    std::cout << "edge properties:\n";
-    props = edge_properties();
+void print_properties(const char* title, const std::vector<Property_memory>& props)
+{
+    std::cout << title << " properties: " << used_bytes(props) << " bytes used, "
+              << reserved_bytes(props) << " reserved\n";
     for (unsigned int i=0; i<props.size(); ++i)
-        std::cout << "\t" << props[i] << std::endl;
+        std::cout << "\t" << props[i].name << ": " << props[i].used << " / "
+                  << props[i].reserved << std::endl;
+}
 
-    std::cout << "face properties:\n";
-    props = face_properties();
-    for (unsigned int i=0; i<props.size(); ++i)
-        std::cout << "\t" << props[i] << std::endl;
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+size_t
+Surface_mesh::Memory_report::
+used() const
+{
+    return used_bytes(vertex) + used_bytes(halfedge) + used_bytes(edge) + used_bytes(face);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+size_t
+Surface_mesh::Memory_report::
+reserved() const
+{
+    return reserved_bytes(vertex) + reserved_bytes(halfedge) +
+           reserved_bytes(edge) + reserved_bytes(face);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Surface_mesh::Memory_report
+Surface_mesh::
+memory_report() const
+{
+    Memory_report report;
+    report.vertex   = vprops_.memory();
+    report.halfedge = hprops_.memory();
+    report.edge     = eprops_.memory();
+    report.face     = fprops_.memory();
+    return report;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Surface_mesh::
+property_stats() const
+{
+    const Memory_report report = memory_report();
+    print_properties("vertex",   report.vertex);
+    print_properties("halfedge", report.halfedge);
+    print_properties("edge",     report.edge);
+    print_properties("face",     report.face);
 }
 
 
@@ -260,6 +377,23 @@ add_vertex(const Point& p)
 //-----------------------------------------------------------------------------
 
 
+Surface_mesh::Vertex
+Surface_mesh::
+add_vertices(const Point* points, size_t n)
+{
+    if (n == 0) return Vertex();
+
+    ++topology_revision_;
+    const size_t first = vertices_size();
+    vprops_.grow(n);
+    memcpy(&vpoint_.vector()[first], points, n * sizeof(Point));
+    return Vertex((int) first);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 Surface_mesh::Halfedge
 Surface_mesh::
 find_halfedge(Vertex start, Vertex end) const
@@ -303,6 +437,18 @@ void
 Surface_mesh::
 adjust_outgoing_halfedge(Vertex v)
 {
+    if (topology_batch_)
+    {
+        if (batch_queued_.size() <= size_t(v.idx()))
+            batch_queued_.resize(vertices_size(), false);
+        if (!batch_queued_[v.idx()])
+        {
+            batch_queued_[v.idx()] = true;
+            batch_vertices_.push_back(v);
+        }
+        return;
+    }
+
     Halfedge h  = halfedge(v);
     const Halfedge hh = h;
 
@@ -325,6 +471,37 @@ adjust_outgoing_halfedge(Vertex v)
 //-----------------------------------------------------------------------------
 
 
+void
+Surface_mesh::
+begin_topology_batch()
+{
+    topology_batch_ = true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Surface_mesh::
+end_topology_batch()
+{
+    if (!topology_batch_) return;
+    topology_batch_ = false;
+
+    // deleted vertices have no halfedge any more
+    for (Vertex v: batch_vertices_)
+    {
+        batch_queued_[v.idx()] = false;
+        if (!vdeleted_[v]) adjust_outgoing_halfedge(v);
+    }
+    batch_vertices_.clear();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 Surface_mesh::Face
 Surface_mesh::
 add_triangle(Vertex v0, Vertex v1, Vertex v2)
@@ -553,6 +730,467 @@ add_face(const std::vector<Vertex>& vertices)
 //-----------------------------------------------------------------------------
 
 
+std::string
+Face_report::
+summary() const
+{
+    std::string text;
+    auto add = [&](unsigned int n, const char* one, const char* many)
+    {
+        if (n == 0) return;
+        if (!text.empty()) text += ", ";
+        text += std::to_string(n) + " " + (n > 1 ? many : one);
+    };
+    add(out_of_range, "face out of range", "faces out of range");
+    add(degenerate, "degenerate face", "degenerate faces");
+    add(duplicates, "duplicate face", "duplicate faces");
+    add(complex_edges, "complex edge", "complex edges");
+    add(complex_vertices, "complex vertex", "complex vertices");
+    return text;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// items [0, n_items) sorted by key into the buckets [start[v], start[v+1])
+// of items, keys are vertices or -1 for none; in order within a bucket
+template <class Key>
+static void bucket_by(int nv, int n_items, std::vector<int>& start, std::vector<int>& items,
+                      const Key& key)
+{
+    start.assign(nv+1, 0);
+    for (int i = 0; i < n_items; ++i)
+        if (key(i) >= 0) ++start[key(i) + 1];
+    for (int v = 0; v < nv; ++v)
+        start[v+1] += start[v];
+    items.resize(start[nv]);
+    std::vector<int> fill(start.begin(), start.end()-1);
+    for (int i = 0; i < n_items; ++i)
+        if (key(i) >= 0) items[fill[key(i)]++] = i;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Face_report
+Surface_mesh::
+check_faces(const std::vector<unsigned int>& indices,
+            const std::vector<unsigned int>& valences) const
+{
+    SURFACE_MESH_TRACE_ZONE("check faces");
+    Face_report report;
+    // corners are numbered with int like in build_faces()
+    if (vertices_size() > Index_type(INT_MAX) || indices.size() > size_t(INT_MAX / 2))
+        return report;
+
+    const int nv = vertices_size();
+    const int nf = valences.size();
+
+    // faces that run past the index list are out of range, like the ones
+    // add_faces() stops at
+    int n_listed = 0;
+    std::vector<int> first(1, 0);
+    first.reserve(nf+1);
+    for (; n_listed < nf; ++n_listed)
+    {
+        if (first.back() + size_t(valences[n_listed]) > indices.size()) break;
+        first.push_back(first.back() + valences[n_listed]);
+    }
+    report.out_of_range = nf - n_listed;
+    const int nc = first.back();
+
+
+    // a face out of range or degenerate is left out of the other tests;
+    // corner c of a valid face f runs from indices[c] to to[c] and follows
+    // the corner from before[c], lowest[f] is its smallest vertex
+    std::vector<int> face(nc, -1), to(nc, -1), before(nc, -1);
+    std::vector<unsigned int> lowest(n_listed);
+    unsigned int out_of_range = 0, degenerate = 0;
+#pragma omp parallel for schedule(dynamic, 4096) reduction(+:out_of_range,degenerate)
+    for (int f = 0; f < n_listed; ++f)
+    {
+        const int b = first[f], e = first[f+1];
+        bool range = true, twice = e - b < 3;
+        for (int c = b; c < e; ++c)
+        {
+            if (indices[c] >= (unsigned int) nv) range = false;
+            for (int d = b; d < c; ++d)
+                if (indices[d] == indices[c]) twice = true;
+        }
+        if (!range) { ++out_of_range; continue; }
+        if (twice) { ++degenerate; continue; }
+
+        lowest[f] = *std::min_element(indices.begin() + b, indices.begin() + e);
+        for (int c = b; c < e; ++c)
+        {
+            face[c]   = f;
+            to[c]     = indices[c+1 < e ? c+1 : b];
+            before[c] = indices[c > b ? c-1 : e-1];
+        }
+    }
+    report.out_of_range += out_of_range;
+    report.degenerate = degenerate;
+
+    // two faces on the same vertices, both valid
+    auto same_vertices = [&](int f, int g)
+    {
+        if (first[f+1] - first[f] != first[g+1] - first[g]) return false;
+        for (int c = first[g]; c < first[g+1]; ++c)
+            if (std::find(indices.begin() + first[f], indices.begin() + first[f+1], indices[c]) ==
+                indices.begin() + first[f+1])
+                return false;
+        return true;
+    };
+
+    std::vector<int> start, items;
+
+
+    // complex edges: the corners of an edge in the bucket of its smaller
+    // vertex keyed by the larger one, as in build_faces()
+    typedef unsigned long long Key;
+    bucket_by(nv, nc, start, items, [&](int c)
+    {
+        return to[c] < 0 ? -1 : std::min(int(indices[c]), to[c]);
+    });
+    std::vector<Key> keys(items.size());
+    unsigned int complex_edges = 0, duplicates = 0;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(+:complex_edges,duplicates)
+    for (int v = 0; v < nv; ++v)
+    {
+        for (int i = start[v]; i < start[v+1]; ++i)
+        {
+            const int c = items[i];
+            keys[i] = (Key(std::max(int(indices[c]), to[c])) << 32) | Key(c);
+        }
+        const std::vector<Key>::iterator b = keys.begin() + start[v];
+        const std::vector<Key>::iterator e = keys.begin() + start[v+1];
+        std::sort(b, e);
+        for (std::vector<Key>::iterator i = b; i != e; )
+        {
+            std::vector<Key>::iterator j = i+1;
+            while (j != e && (*j >> 32) == (*i >> 32)) ++j;
+            if (j - i > 2 || (j - i == 2 && indices[*i & 0xffffffff] == indices[*(i+1) & 0xffffffff]))
+                ++complex_edges;
+
+            // a face on the vertices of an earlier one shares the edge from
+            // its smallest vertex with it, in the same cyclic order
+            for (std::vector<Key>::iterator k = i; k != j; ++k)
+            {
+                const int g = face[*k & 0xffffffff];
+                if (indices[*k & 0xffffffff] != lowest[g]) continue;
+                for (std::vector<Key>::iterator l = i; l != j; ++l)
+                {
+                    const int f = face[*l & 0xffffffff];
+                    if (f < g && same_vertices(f, g)) { ++duplicates; break; }
+                }
+            }
+            i = j;
+        }
+    }
+    report.complex_edges = complex_edges;
+    report.duplicates = duplicates;
+
+
+    // complex vertices: every corner at v links the vertices before and
+    // after it, the faces around v form one fan if those links connect all
+    // of them
+    bucket_by(nv, nc, start, items, [&](int c) { return to[c] < 0 ? -1 : int(indices[c]); });
+    unsigned int complex_vertices = 0;
+#pragma omp parallel reduction(+:complex_vertices)
+    {
+        // the ring of v and a union-find forest over it
+        std::vector<int> ring, parent;
+        auto slot = [&](int u)
+        {
+            const int k = int(std::find(ring.begin(), ring.end(), u) - ring.begin());
+            if (k == int(ring.size())) { ring.push_back(u); parent.push_back(k); }
+            return k;
+        };
+        auto root = [&](int k)
+        {
+            while (parent[k] != k) k = parent[k] = parent[parent[k]];
+            return k;
+        };
+
+#pragma omp for schedule(dynamic, 1024)
+        for (int v = 0; v < nv; ++v)
+        {
+            if (start[v+1] - start[v] < 2) continue;
+            ring.clear();
+            parent.clear();
+            int links = 0;
+            for (int i = start[v]; i < start[v+1]; ++i)
+            {
+                const int a = root(slot(to[items[i]]));
+                const int b = root(slot(before[items[i]]));
+                if (a != b) { parent[a] = b; ++links; }
+            }
+            if (int(ring.size()) - links > 1) ++complex_vertices;
+        }
+    }
+    report.complex_vertices = complex_vertices;
+
+    return report;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int
+Surface_mesh::
+add_faces(const std::vector<unsigned int>& indices,
+          const std::vector<unsigned int>& valences)
+{
+    face_report_ = check_faces(indices, valences);
+
+    SURFACE_MESH_TRACE_ZONE("build");
+    const unsigned int n_before = n_faces();
+
+    // the list builds at once unless check_faces() found something
+    if (faces_size() == 0 && edges_size() == 0 && face_report_.ok() &&
+        build_faces(indices, valences))
+        return n_faces() - n_before;
+
+
+    // one face at a time, add_face() skips complex faces
+    std::vector<Vertex> vertices;
+    size_t c = 0;
+    for (size_t f = 0; f < valences.size(); c += valences[f++])
+    {
+        const unsigned int n = valences[f];
+        if (c + n > indices.size()) break;
+        if (n < 3) continue;
+
+        bool valid = true;
+        vertices.resize(n);
+        for (unsigned int i = 0; i < n; ++i)
+        {
+            if (indices[c+i] >= vertices_size()) valid = false;
+            vertices[i] = Vertex(indices[c+i]);
+        }
+        if (valid) add_face(vertices);
+    }
+
+    return n_faces() - n_before;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Surface_mesh::
+build_faces(const std::vector<unsigned int>& indices,
+            const std::vector<unsigned int>& valences)
+{
+    // corners and halfedges are numbered with int, larger meshes are added
+    // face by face
+    if (vertices_size() > Index_type(INT_MAX) || indices.size() > size_t(INT_MAX / 2))
+        return false;
+
+    const int nv = vertices_size();
+    const int nf = valences.size();
+
+
+    // corners are the halfedges inside the faces, corner c runs from
+    // indices[c] to indices[next[c]]
+    std::vector<int> first(nf+1);
+    first[0] = 0;
+    for (int f = 0; f < nf; ++f)
+    {
+        if (valences[f] < 3) return false;
+        first[f+1] = first[f] + valences[f];
+    }
+    const int nc = first[nf];
+    if (size_t(nc) != indices.size()) return false;
+
+    std::vector<int> next(nc), face(nc);
+    bool valid = true;
+#pragma omp parallel for reduction(&&:valid)
+    for (int f = 0; f < nf; ++f)
+    {
+        for (int c = first[f]; c < first[f+1]; ++c)
+        {
+            next[c] = (c+1 < first[f+1]) ? c+1 : first[f];
+            face[c] = f;
+            if (indices[c] >= (unsigned int) nv) valid = false;
+
+            // no vertex twice in a face
+            for (int d = first[f]; d < c; ++d)
+                if (indices[d] == indices[c]) valid = false;
+        }
+    }
+    if (!valid) return false;
+
+    const std::vector<unsigned int>& from = indices;
+    auto to = [&](int c) { return indices[next[c]]; };
+
+
+    // bucket the corners by their smaller vertex, keyed by their larger
+    // vertex and the corner index
+    typedef unsigned long long Key;
+    std::vector<int> bucket_start(nv+1, 0);
+    std::vector<Key> bucket(nc);
+    for (int c = 0; c < nc; ++c)
+        ++bucket_start[std::min(from[c], to(c)) + 1];
+    for (int v = 0; v < nv; ++v)
+        bucket_start[v+1] += bucket_start[v];
+    {
+        std::vector<int> fill(bucket_start.begin(), bucket_start.end()-1);
+        for (int c = 0; c < nc; ++c)
+            bucket[fill[std::min(from[c], to(c))]++] = (Key(std::max(from[c], to(c))) << 32) | Key(c);
+    }
+
+
+    // within a bucket the corners of an edge share their larger vertex. an
+    // edge has one corner, or two of opposite direction.
+    std::vector<int> twin(nc, -1);
+    bool manifold = true;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(&&:manifold)
+    for (int v = 0; v < nv; ++v)
+    {
+        const std::vector<Key>::iterator b = bucket.begin() + bucket_start[v];
+        const std::vector<Key>::iterator e = bucket.begin() + bucket_start[v+1];
+        std::sort(b, e);
+
+        for (std::vector<Key>::iterator i = b; i != e; )
+        {
+            std::vector<Key>::iterator j = i+1;
+            while (j != e && (*j >> 32) == (*i >> 32)) ++j;
+
+            if (j - i == 2)
+            {
+                const int c0 = int(*i & 0xffffffff), c1 = int(*(i+1) & 0xffffffff);
+                if (from[c0] == from[c1]) manifold = false;
+                twin[c0] = c1;
+                twin[c1] = c0;
+            }
+            else if (j - i > 2) manifold = false;
+
+            i = j;
+        }
+    }
+    if (!manifold) return false;
+
+
+    // number the edges by their first corner and orient them along it, in
+    // the order add_face() would create them
+    std::vector<int> corner_halfedge(nc, -1);
+    int ne = 0;
+    for (int c = 0; c < nc; ++c)
+    {
+        if (corner_halfedge[c] != -1) continue;
+        corner_halfedge[c] = 2*ne;
+        if (twin[c] != -1) corner_halfedge[twin[c]] = 2*ne+1;
+        ++ne;
+    }
+
+
+    // the opposite of an unpaired corner is a boundary halfedge, every
+    // boundary vertex has exactly one of them leaving it
+    std::vector<int> boundary_out(nv, -1);
+    for (int c = 0; c < nc; ++c)
+    {
+        if (twin[c] != -1) continue;
+        if (boundary_out[to(c)] != -1) return false;
+        boundary_out[to(c)] = corner_halfedge[c] ^ 1;
+    }
+
+
+    // halfedge connectivity: target vertex, face and next halfedge
+    const int nh = 2*ne;
+    std::vector<int> h_to(nh), h_face(nh, -1), h_next(nh);
+    valid = true;
+#pragma omp parallel for reduction(&&:valid)
+    for (int c = 0; c < nc; ++c)
+    {
+        const int h = corner_halfedge[c];
+        h_to[h]   = to(c);
+        h_face[h] = face[c];
+        h_next[h] = corner_halfedge[next[c]];
+
+        if (twin[c] == -1)
+        {
+            // the boundary continues at the boundary halfedge leaving from[c]
+            h_to[h^1]   = from[c];
+            h_next[h^1] = boundary_out[from[c]];
+            if (boundary_out[from[c]] == -1) valid = false;
+        }
+    }
+    if (!valid) return false;
+
+
+    // outgoing halfedge of every vertex: the boundary one, or the one of the
+    // last face around the vertex, both as left behind by add_face()
+    std::vector<int> v_halfedge(nv, -1), n_out(nv, 0);
+    for (int c = 0; c < nc; ++c)
+    {
+        v_halfedge[from[c]] = corner_halfedge[c];
+        ++n_out[from[c]];
+    }
+    for (int v = 0; v < nv; ++v)
+    {
+        if (boundary_out[v] != -1)
+        {
+            v_halfedge[v] = boundary_out[v];
+            ++n_out[v];
+        }
+    }
+
+
+    // complex vertices: the outgoing halfedges form more than one fan
+    manifold = true;
+#pragma omp parallel for reduction(&&:manifold)
+    for (int v = 0; v < nv; ++v)
+    {
+        if (v_halfedge[v] == -1) continue;
+        int h = v_halfedge[v], n = 0;
+        do
+        {
+            ++n;
+            h = h_next[h^1];
+        }
+        while (h != v_halfedge[v] && n <= n_out[v]);
+        if (n != n_out[v]) manifold = false;
+    }
+    if (!manifold) return false;
+
+
+    // copy into the mesh
+    hprops_.resize(nh);
+    eprops_.resize(ne);
+    fprops_.resize(nf);
+
+#pragma omp parallel for
+    for (int h = 0; h < nh; ++h)
+    {
+        Halfedge_connectivity& hc = hconn_[Halfedge(h)];
+        hc.vertex_        = Vertex(h_to[h]);
+        hc.face_          = Face(h_face[h]);
+        hc.next_halfedge_ = Halfedge(h_next[h]);
+        hconn_[Halfedge(h_next[h])].prev_halfedge_ = Halfedge(h);
+    }
+
+#pragma omp parallel for
+    for (int f = 0; f < nf; ++f)
+        fconn_[Face(f)].halfedge_ = Halfedge(corner_halfedge[first[f+1]-1]);
+
+#pragma omp parallel for
+    for (int v = 0; v < nv; ++v)
+        vconn_[Vertex(v)].halfedge_ = Halfedge(v_halfedge[v]);
+
+    ++topology_revision_;
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 unsigned int
 Surface_mesh::
 valence(Vertex v) const
@@ -628,13 +1266,72 @@ void
 Surface_mesh::
 triangulate()
 {
-    /* The iterators will stay valid, even though new faces are added,
-     because they are now implemented index-based instead of
-     pointer-based.
-     */
-    Face_iterator fit=faces_begin(), fend=faces_end();
-    for (; fit!=fend; ++fit)
-        triangulate(*fit);
+    // the faces get their new triangles, edges and halfedges at offsets
+    // counted in face order, so the result is the one of calling
+    // triangulate(Face) for every face in order; the faces then write
+    // disjoint ranges in parallel
+    const int nF(faces_size());
+    std::vector<Index_type> first(nF + 1, 0);
+    for (int i = 0; i < nF; ++i)
+    {
+        const Face f(i);
+        first[i + 1] = first[i];
+        if (!fdeleted_[f])
+        {
+            const unsigned int n = valence(f);
+            if (n > 3) first[i + 1] += n - 3;
+        }
+    }
+    const Index_type added = first[nF];
+    if (added == 0) return;
+
+    const Index_type nE(edges_size());
+    fprops_.resize(nF + added);
+    eprops_.resize(nE + added);
+    hprops_.resize(2 * (nE + added));
+    ++topology_revision_;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < nF; ++i)
+    {
+        if (first[i + 1] == first[i]) continue;
+
+        // triangulate(Face) with the elements of new_face() and new_edge()
+        // taken from the ranges of f
+        const Face f(i);
+        Halfedge base_h  = halfedge(f);
+        Vertex   start_v = from_vertex(base_h);
+        Halfedge next_h  = next_halfedge(base_h);
+
+        for (Index_type k = first[i]; k < first[i + 1]; ++k)
+        {
+            Halfedge next_next_h(next_halfedge(next_h));
+
+            Face new_f(nF + k);
+            set_halfedge(new_f, base_h);
+
+            Halfedge new_h(2 * (nE + k));
+            set_vertex(new_h, start_v);
+            set_vertex(opposite_halfedge(new_h), to_vertex(next_h));
+
+            set_next_halfedge(base_h, next_h);
+            set_next_halfedge(next_h, new_h);
+            set_next_halfedge(new_h,  base_h);
+
+            set_face(base_h, new_f);
+            set_face(next_h, new_f);
+            set_face(new_h,  new_f);
+
+            base_h = opposite_halfedge(new_h);
+            next_h = next_next_h;
+        }
+        set_halfedge(f, base_h);
+
+        set_next_halfedge(base_h, next_h);
+        set_next_halfedge(next_halfedge(next_h), base_h);
+
+        set_face(base_h, f);
+    }
 }
 
 
@@ -698,10 +1395,14 @@ update_face_normals()
     if (!fnormal_)
         fnormal_ = face_property<Point>("f:normal");
 
-    Face_iterator fit, fend=faces_end();
+    const int nF = faces_size();
 
-    for (fit=faces_begin(); fit!=fend; ++fit)
-        fnormal_[*fit] = compute_face_normal(*fit);
+#pragma omp parallel for schedule(static)
+    for (int i=0; i<nF; ++i)
+    {
+        if (!fdeleted_[Face(i)])
+            fnormal_[Face(i)] = compute_face_normal(Face(i));
+    }
 }
 
 
@@ -756,10 +1457,73 @@ update_vertex_normals()
     if (!vnormal_)
         vnormal_ = vertex_property<Point>("v:normal");
 
-    Vertex_iterator vit, vend=vertices_end();
+    const int nV(vertices_size()), nF(faces_size());
+
+
+    // one unit normal per face and the angle of every corner, corner h is
+    // the one at to_vertex(h)
+    std::vector<Normal> face_normal(nF);
+    std::vector<Scalar> corner_angle(halfedges_size(), 0);
+
+#pragma omp parallel for schedule(static)
+    for (int i=0; i<nF; ++i)
+    {
+        const Face f(i);
+        if (fdeleted_[f]) continue;
+
+        face_normal[i] = compute_face_normal(f);
+
+        Halfedge h = halfedge(f);
+        const Halfedge hend = h;
+        Point p0 = vpoint_[from_vertex(h)];
+        Point p1 = vpoint_[to_vertex(h)];
+        do
+        {
+            const Point p2 = vpoint_[to_vertex(next_halfedge(h))];
+            const Point d0 = p0 - p1, d2 = p2 - p1;
+
+            // check whether we can robustly compute angle
+            const Scalar denom = sqrt(dot(d0,d0)*dot(d2,d2));
+            if (denom > std::numeric_limits<Scalar>::min())
+            {
+                Scalar cosine = dot(d0,d2) / denom;
+                if      (cosine < -1.0) cosine = -1.0;
+                else if (cosine >  1.0) cosine =  1.0;
+                corner_angle[h.idx()] = acos(cosine);
+            }
+
+            h  = next_halfedge(h);
+            p0 = p1;
+            p1 = p2;
+        }
+        while (h != hend);
+    }
+
+
+    // every vertex gathers the angle weighted normals of its corners
+#pragma omp parallel for schedule(static)
+    for (int i=0; i<nV; ++i)
+    {
+        const Vertex v(i);
+        if (vdeleted_[v]) continue;
+
+        Normal nn(0,0,0);
+        Halfedge h = halfedge(v);
+        if (h.is_valid())
+        {
+            const Halfedge hend = h;
+            do
+            {
+                if (!is_boundary(h))
+                    nn += face_normal[face(h).idx()] * corner_angle[prev_halfedge(h).idx()];
+                h = cw_rotated_halfedge(h);
+            }
+            while (h != hend);
 
-    for (vit=vertices_begin(); vit!=vend; ++vit)
-        vnormal_[*vit] = compute_vertex_normal(*vit);
+            nn.normalize();
+        }
+        vnormal_[v] = nn;
+    }
 }
 
 
@@ -1314,6 +2078,7 @@ remove_edge(Halfedge h)
     vdeleted_[vo]      = true; ++deleted_vertices_;
     edeleted_[edge(h)] = true; ++deleted_edges_;
     garbage_ = true;
+    ++topology_revision_;
 }
 
 
@@ -1367,6 +2132,7 @@ remove_loop(Halfedge h)
     if (fh.is_valid()) { fdeleted_[fh] = true; ++deleted_faces_; }
     edeleted_[edge(h0)] = true; ++deleted_edges_;
     garbage_ = true;
+    ++topology_revision_;
 }
 
 
@@ -1402,6 +2168,7 @@ delete_vertex(Vertex v)
     vdeleted_[v] = true;
     deleted_vertices_++;
     garbage_ = true;
+    ++topology_revision_;
 }
 
 
@@ -1537,6 +2304,19 @@ delete_face(Face f)
         adjust_outgoing_halfedge(*v_it);
 
     garbage_ = true;
+    ++topology_revision_;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// append the indices of the unset flags in increasing order, words of set
+// flags are skipped at once
+static void append_unset(const Bit_vector& flags, std::vector<int>& indices)
+{
+    for (size_t i = flags.find_next_unset(0); i < flags.size(); i = flags.find_next_unset(i + 1))
+        indices.push_back(int(i));
 }
 
 
@@ -1547,138 +2327,122 @@ void
 Surface_mesh::
 garbage_collection()
 {
-    int  i, i0, i1,
-    nV(vertices_size()),
-    nE(edges_size()),
-    nH(halfedges_size()),
-    nF(faces_size());
+    end_topology_batch();
 
-    Vertex    v;
-    Halfedge  h;
-    Face      f;
+    if (!garbage_ && !deleted_vertices_ && !deleted_edges_ && !deleted_faces_)
+        return;
 
+    SURFACE_MESH_TRACE_ZONE("garbage collection");
 
-    // setup handle mapping
-    Vertex_property<Vertex>      vmap = add_vertex_property<Vertex>("v:garbage-collection");
-    Halfedge_property<Halfedge>  hmap = add_halfedge_property<Halfedge>("h:garbage-collection");
-    Face_property<Face>          fmap = add_face_property<Face>("f:garbage-collection");
-    for (i=0; i<nV; ++i)
-        vmap[Vertex(i)] = Vertex(i);
-    for (i=0; i<nH; ++i)
-        hmap[Halfedge(i)] = Halfedge(i);
-    for (i=0; i<nF; ++i)
-        fmap[Face(i)] = Face(i);
+    const int nV(vertices_size()), nE(edges_size()), nF(faces_size());
 
 
+    // the remaining elements keep their relative order
+    std::vector<int> vertex_order, edge_order, face_order;
+    vertex_order.reserve(nV - deleted_vertices_);
+    edge_order.reserve(nE - deleted_edges_);
+    face_order.reserve(nF - deleted_faces_);
+    append_unset(vdeleted_.vector(), vertex_order);
+    append_unset(edeleted_.vector(), edge_order);
+    append_unset(fdeleted_.vector(), face_order);
 
-    // remove deleted vertices
-    if (nV > 0)
-    {
-        i0=0;  i1=nV-1;
+    gather(vertex_order, edge_order, face_order);
 
-        while (1)
-        {
-            // find first deleted and last un-deleted
-            while (!vdeleted_[Vertex(i0)] && i0 < i1)  ++i0;
-            while ( vdeleted_[Vertex(i1)] && i0 < i1)  --i1;
-            if (i0 >= i1) break;
+    deleted_vertices_ = deleted_edges_ = deleted_faces_ = 0;
+    garbage_ = false;
+}
 
-            // swap
-            vprops_.swap(i0, i1);
-        };
 
-        // remember new size
-        nV = vdeleted_[Vertex(i0)] ? i0 : i0+1;
-    }
+//-----------------------------------------------------------------------------
 
 
-    // remove deleted edges
-    if (nE > 0)
-    {
-        i0=0;  i1=nE-1;
+void
+Surface_mesh::
+permute(const std::vector<int>& vertex_order,
+        const std::vector<int>& edge_order,
+        const std::vector<int>& face_order)
+{
+    assert(!garbage_);
+    assert(vertex_order.size() == vertices_size());
+    assert(edge_order.size() == edges_size());
+    assert(face_order.size() == faces_size());
 
-        while (1)
-        {
-            // find first deleted and last un-deleted
-            while (!edeleted_[Edge(i0)] && i0 < i1)  ++i0;
-            while ( edeleted_[Edge(i1)] && i0 < i1)  --i1;
-            if (i0 >= i1) break;
-
-            // swap
-            eprops_.swap(i0, i1);
-            hprops_.swap(2*i0,   2*i1);
-            hprops_.swap(2*i0+1, 2*i1+1);
-        };
+    gather(vertex_order, edge_order, face_order);
+}
 
-        // remember new size
-        nE = edeleted_[Edge(i0)] ? i0 : i0+1;
-        nH = 2*nE;
-    }
 
+//-----------------------------------------------------------------------------
 
-    // remove deleted faces
-    if (nF > 0)
-    {
-        i0=0;  i1=nF-1;
 
-        while (1)
-        {
-            // find 1st deleted and last un-deleted
-            while (!fdeleted_[Face(i0)] && i0 < i1)  ++i0;
-            while ( fdeleted_[Face(i1)] && i0 < i1)  --i1;
-            if (i0 >= i1) break;
+void
+Surface_mesh::
+gather(const std::vector<int>& vertex_order,
+       const std::vector<int>& edge_order,
+       const std::vector<int>& face_order)
+{
+    const int nV(vertex_order.size()), nE(edge_order.size()), nH(2*nE), nF(face_order.size());
 
-            // swap
-            fprops_.swap(i0, i1);
-        };
 
-        // remember new size
-        nF = fdeleted_[Face(i0)] ? i0 : i0+1;
+    // halfedges follow their edges
+    std::vector<int> halfedge_order(nH);
+#pragma omp parallel for
+    for (int i=0; i<nE; ++i)
+    {
+        halfedge_order[2*i]   = 2*edge_order[i];
+        halfedge_order[2*i+1] = 2*edge_order[i]+1;
     }
 
 
+    // old index -> new index, dropped elements are not referenced by the
+    // remaining ones
+    std::vector<int> vmap(vertices_size(), -1), hmap(halfedges_size(), -1), fmap(faces_size(), -1);
+#pragma omp parallel for
+    for (int i=0; i<nV; ++i) vmap[vertex_order[i]]   = i;
+#pragma omp parallel for
+    for (int i=0; i<nH; ++i) hmap[halfedge_order[i]] = i;
+#pragma omp parallel for
+    for (int i=0; i<nF; ++i) fmap[face_order[i]]     = i;
+
+
+    // move all properties, this also shrinks the arrays
+    vprops_.permute(vertex_order);
+    hprops_.permute(halfedge_order);
+    eprops_.permute(edge_order);
+    fprops_.permute(face_order);
+
+
     // update vertex connectivity
-    for (i=0; i<nV; ++i)
+#pragma omp parallel for
+    for (int i=0; i<nV; ++i)
     {
-        v = Vertex(i);
-        if (!is_isolated(v))
-            set_halfedge(v, hmap[halfedge(v)]);
+        Vertex_connectivity& vc = vconn_[Vertex(i)];
+        if (vc.halfedge_.is_valid())
+            vc.halfedge_ = Halfedge(hmap[vc.halfedge_.idx()]);
     }
 
 
     // update halfedge connectivity
-    for (i=0; i<nH; ++i)
+#pragma omp parallel for
+    for (int i=0; i<nH; ++i)
     {
-        h = Halfedge(i);
-        set_vertex(h, vmap[to_vertex(h)]);
-        set_next_halfedge(h, hmap[next_halfedge(h)]);
-        if (!is_boundary(h))
-            set_face(h, fmap[face(h)]);
+        Halfedge_connectivity& hc = hconn_[Halfedge(i)];
+        hc.vertex_        = Vertex(vmap[hc.vertex_.idx()]);
+        hc.next_halfedge_ = Halfedge(hmap[hc.next_halfedge_.idx()]);
+        hc.prev_halfedge_ = Halfedge(hmap[hc.prev_halfedge_.idx()]);
+        if (hc.face_.is_valid())
+            hc.face_ = Face(fmap[hc.face_.idx()]);
     }
 
 
     // update handles of faces
-    for (i=0; i<nF; ++i)
+#pragma omp parallel for
+    for (int i=0; i<nF; ++i)
     {
-        f = Face(i);
-        set_halfedge(f, hmap[halfedge(f)]);
+        Face_connectivity& fc = fconn_[Face(i)];
+        fc.halfedge_ = Halfedge(hmap[fc.halfedge_.idx()]);
     }
 
-
-    // remove handle maps
-    remove_vertex_property(vmap);
-    remove_halfedge_property(hmap);
-    remove_face_property(fmap);
-
-
-    // finally resize arrays
-    vprops_.resize(nV); vprops_.free_memory();
-    hprops_.resize(nH); hprops_.free_memory();
-    eprops_.resize(nE); eprops_.free_memory();
-    fprops_.resize(nF); fprops_.free_memory();
-
-    deleted_vertices_ = deleted_edges_ = deleted_faces_ = 0;
-    garbage_ = false;
+    ++topology_revision_;
 }
 
 
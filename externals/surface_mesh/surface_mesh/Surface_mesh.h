@@ -20,6 +20,30 @@ namespace surface_mesh {
 //== CLASS DEFINITION =========================================================
 
 
+/// Problems of a face list as Surface_mesh::add_faces() takes it, found by
+/// Surface_mesh::check_faces() before any halfedge is built.
+struct Face_report
+{
+    unsigned int out_of_range;      ///< faces with an index past the vertices or the list
+    unsigned int degenerate;        ///< faces with fewer than 3 vertices or one twice
+    unsigned int duplicates;        ///< faces on the vertices of an earlier face, in its cyclic order
+    unsigned int complex_edges;     ///< edges of more than two faces or of two in one direction
+    unsigned int complex_vertices;  ///< vertices whose faces form more than one fan
+
+    Face_report()
+    : out_of_range(0), degenerate(0), duplicates(0), complex_edges(0), complex_vertices(0)
+    {}
+
+    bool ok() const
+    {
+        return !out_of_range && !degenerate && !duplicates && !complex_edges && !complex_vertices;
+    }
+
+    /// e.g. "2 complex edges, 1 duplicate face", empty if ok()
+    std::string summary() const;
+};
+
+
 /// A halfedge data structure for polygonal meshes.
 class Surface_mesh
 {
@@ -28,22 +52,23 @@ public: //------------------------------------------------------ topology types
 
 
     /// Base class for all topology types (internally it is basically an index)
+    /// of type Index_type, the invalid index -1 is the largest Index_type.
     /// \sa Vertex, Halfedge, Edge, Face
     class Base_handle
     {
     public:
 
         /// constructor
-        explicit Base_handle(int _idx=-1) : idx_(_idx) {}
+        explicit Base_handle(Index_type _idx=Index_type(-1)) : idx_(_idx) {}
 
         /// Get the underlying index of this handle
-        int idx() const { return idx_; }
+        Index_type idx() const { return idx_; }
 
         /// reset handle to be invalid (index=-1)
-        void reset() { idx_=-1; }
+        void reset() { idx_=Index_type(-1); }
 
         /// return whether the handle is valid, i.e., the index is not equal to -1.
-        bool is_valid() const { return idx_ != -1; }
+        bool is_valid() const { return idx_ != Index_type(-1); }
 
         /// are two handles equal?
         bool operator==(const Base_handle& _rhs) const {
@@ -66,7 +91,7 @@ public: //------------------------------------------------------ topology types
         friend class Edge_iterator;
         friend class Face_iterator;
         friend class Surface_mesh;
-        int idx_;
+        Index_type idx_;
     };
 
 
@@ -75,7 +100,7 @@ public: //------------------------------------------------------ topology types
     struct Vertex : public Base_handle
     {
         /// default constructor (with invalid index)
-        explicit Vertex(int _idx=-1) : Base_handle(_idx) {}
+        explicit Vertex(Index_type _idx=Index_type(-1)) : Base_handle(_idx) {}
         std::ostream& operator<<(std::ostream& os) const { return os << 'v' << idx(); }
     };
 
@@ -85,7 +110,7 @@ public: //------------------------------------------------------ topology types
     struct Halfedge : public Base_handle
     {
         /// default constructor (with invalid index)
-        explicit Halfedge(int _idx=-1) : Base_handle(_idx) {}
+        explicit Halfedge(Index_type _idx=Index_type(-1)) : Base_handle(_idx) {}
     };
 
 
@@ -94,7 +119,7 @@ public: //------------------------------------------------------ topology types
     struct Edge : public Base_handle
     {
         /// default constructor (with invalid index)
-        explicit Edge(int _idx=-1) : Base_handle(_idx) {}
+        explicit Edge(Index_type _idx=Index_type(-1)) : Base_handle(_idx) {}
     };
 
 
@@ -103,7 +128,7 @@ public: //------------------------------------------------------ topology types
     struct Face : public Base_handle
     {
         /// default constructor (with invalid index)
-        explicit Face(int _idx=-1) : Base_handle(_idx) {}
+        explicit Face(Index_type _idx=Index_type(-1)) : Base_handle(_idx) {}
     };
 
 
@@ -120,7 +145,7 @@ public: //-------------------------------------------------- connectivity types
     };
 
 
-    /// This type stores the halfedge connectivity
+    /// This type stores the halfedge connectivity, four packed indices
     /// \sa Vertex_connectivity, Face_connectivity
     struct Halfedge_connectivity
     {
@@ -258,7 +283,7 @@ public: //------------------------------------------------------ iterator types
         /// Default constructor
         Vertex_iterator(Vertex v=Vertex(), const Surface_mesh* m=NULL) : hnd_(v), mesh_(m)
         {
-            if (mesh_ && mesh_->garbage()) while (mesh_->is_valid(hnd_) && mesh_->is_deleted(hnd_)) ++hnd_.idx_;
+            if (mesh_ && mesh_->garbage() && mesh_->is_valid(hnd_)) hnd_ = mesh_->next_undeleted(hnd_);
         }
 
         /// get the vertex the iterator refers to
@@ -281,7 +306,7 @@ public: //------------------------------------------------------ iterator types
         {
             ++hnd_.idx_;
             assert(mesh_);
-            while (mesh_->garbage() && mesh_->is_valid(hnd_) && mesh_->is_deleted(hnd_)) ++hnd_.idx_;
+            if (mesh_->garbage() && mesh_->is_valid(hnd_)) hnd_ = mesh_->next_undeleted(hnd_);
             return *this;
         }
 
@@ -310,7 +335,7 @@ public: //------------------------------------------------------ iterator types
         /// Default constructor
         Halfedge_iterator(Halfedge h=Halfedge(), const Surface_mesh* m=NULL) : hnd_(h), mesh_(m)
         {
-            if (mesh_ && mesh_->garbage()) while (mesh_->is_valid(hnd_) && mesh_->is_deleted(hnd_)) ++hnd_.idx_;
+            if (mesh_ && mesh_->garbage() && mesh_->is_valid(hnd_)) hnd_ = mesh_->next_undeleted(hnd_);
         }
 
         /// get the halfedge the iterator refers to
@@ -333,7 +358,7 @@ public: //------------------------------------------------------ iterator types
         {
             ++hnd_.idx_;
             assert(mesh_);
-            while (mesh_->garbage() && mesh_->is_valid(hnd_) && mesh_->is_deleted(hnd_)) ++hnd_.idx_;
+            if (mesh_->garbage() && mesh_->is_valid(hnd_)) hnd_ = mesh_->next_undeleted(hnd_);
             return *this;
         }
 
@@ -362,7 +387,7 @@ public: //------------------------------------------------------ iterator types
         /// Default constructor
         Edge_iterator(Edge e=Edge(), const Surface_mesh* m=NULL) : hnd_(e), mesh_(m)
         {
-            if (mesh_ && mesh_->garbage()) while (mesh_->is_valid(hnd_) && mesh_->is_deleted(hnd_)) ++hnd_.idx_;
+            if (mesh_ && mesh_->garbage() && mesh_->is_valid(hnd_)) hnd_ = mesh_->next_undeleted(hnd_);
         }
 
         /// get the edge the iterator refers to
@@ -385,7 +410,7 @@ public: //------------------------------------------------------ iterator types
         {
             ++hnd_.idx_;
             assert(mesh_);
-            while (mesh_->garbage() && mesh_->is_valid(hnd_) && mesh_->is_deleted(hnd_)) ++hnd_.idx_;
+            if (mesh_->garbage() && mesh_->is_valid(hnd_)) hnd_ = mesh_->next_undeleted(hnd_);
             return *this;
         }
 
@@ -414,7 +439,7 @@ public: //------------------------------------------------------ iterator types
         /// Default constructor
         Face_iterator(Face f=Face(), const Surface_mesh* m=NULL) : hnd_(f), mesh_(m)
         {
-            if (mesh_ && mesh_->garbage()) while (mesh_->is_valid(hnd_) && mesh_->is_deleted(hnd_)) ++hnd_.idx_;
+            if (mesh_ && mesh_->garbage() && mesh_->is_valid(hnd_)) hnd_ = mesh_->next_undeleted(hnd_);
         }
 
         /// get the face the iterator refers to
@@ -437,7 +462,7 @@ public: //------------------------------------------------------ iterator types
         {
             ++hnd_.idx_;
             assert(mesh_);
-            while (mesh_->garbage() && mesh_->is_valid(hnd_) && mesh_->is_deleted(hnd_)) ++hnd_.idx_;
+            if (mesh_->garbage() && mesh_->is_valid(hnd_)) hnd_ = mesh_->next_undeleted(hnd_);
             return *this;
         }
 
@@ -518,6 +543,41 @@ public: //-------------------------- containers for C++11 range-based for loops
     };
 
 
+    /// this class iterates over the indices [begin, end) of a mesh without
+    /// garbage, the increment does not look at the deleted flags
+    /// \sa Index_range
+    template <class Handle>
+    class Index_iterator
+    {
+    public:
+        explicit Index_iterator(Index_type _idx=0) : idx_(_idx) {}
+        Handle operator*() const { return Handle(idx_); }
+        bool operator==(const Index_iterator& rhs) const { return idx_ == rhs.idx_; }
+        bool operator!=(const Index_iterator& rhs) const { return idx_ != rhs.idx_; }
+        Index_iterator& operator++() { ++idx_; return *this; }
+        Index_iterator& operator--() { --idx_; return *this; }
+    private:
+        Index_type idx_;
+    };
+
+
+
+    /// this helper class is a container for range-based for-loops over all
+    /// elements of a mesh without garbage
+    /// \sa compact_vertices(), compact_halfedges(), compact_edges(), compact_faces()
+    template <class Handle>
+    class Index_range
+    {
+    public:
+        explicit Index_range(Index_type _size) : size_(_size) {}
+        Index_iterator<Handle> begin() const { return Index_iterator<Handle>(0); }
+        Index_iterator<Handle> end()   const { return Index_iterator<Handle>(size_); }
+        Index_type size() const { return size_; }
+    private:
+        Index_type size_;
+    };
+
+
 
 
 
@@ -877,6 +937,11 @@ public: //-------------------------------------------- constructor / destructor
     /// assign \c rhs to \c *this. does not copy custom properties.
     Surface_mesh& assign(const Surface_mesh& rhs);
 
+    /// exchange the contents of \c *this and \c rhs without copying, e.g.
+    /// to hand a mesh from a worker to a viewer. property handles move with
+    /// their arrays, both topology revisions change.
+    void swap(Surface_mesh& rhs);
+
     //@}
 
 
@@ -908,6 +973,11 @@ public: //----------------------------------------------- add new vertex / face
     /// add a new vertex with position \c p
     Vertex add_vertex(const Point& p);
 
+    /// add \c n vertices with the positions \c points at once. every vertex
+    /// property is resized a single time and the positions are copied as
+    /// one block. returns the first new vertex, invalid if \c n is 0
+    Vertex add_vertices(const Point* points, size_t n);
+
     /// add a new face with vertex list \c vertices
     /// \sa add_triangle, add_quad
     Face add_face(const std::vector<Vertex>& vertices);
@@ -920,6 +990,26 @@ public: //----------------------------------------------- add new vertex / face
     /// \sa add_triangle, add_face
     Face add_quad(Vertex v1, Vertex v2, Vertex v3, Vertex v4);
 
+    /** add faces from a flat index buffer, face \c i uses the next \c valences[i]
+     entries of \c indices. The list is checked by check_faces() first, the
+     report is kept as face_report(). On a mesh without faces all halfedges
+     of a list without problems are built at once from the sorted edges;
+     other lists, and meshes that already have faces, go through add_face()
+     one face at a time. returns the number of faces added.
+     \sa add_face, check_faces */
+    unsigned int add_faces(const std::vector<unsigned int>& indices,
+                           const std::vector<unsigned int>& valences);
+
+    /** check a face list for add_faces() against the vertices of the mesh,
+     in parallel and without building anything: indices out of range,
+     degenerate and duplicate faces, complex edges and complex vertices.
+     \sa add_faces */
+    Face_report check_faces(const std::vector<unsigned int>& indices,
+                            const std::vector<unsigned int>& valences) const;
+
+    /// the check_faces() report of the last add_faces() call
+    const Face_report& face_report() const { return face_report_; }
+
     //@}
 
 
@@ -931,28 +1021,33 @@ public: //--------------------------------------------------- memory management
     //@{
 
     /// returns number of (deleted and valid) vertices in the mesh
-    unsigned int vertices_size() const { return (unsigned int) vprops_.size(); }
+    Index_type vertices_size() const { return (Index_type) vprops_.size(); }
     /// returns number of (deleted and valid)halfedge in the mesh
-    unsigned int halfedges_size() const { return (unsigned int) hprops_.size(); }
+    Index_type halfedges_size() const { return (Index_type) hprops_.size(); }
     /// returns number of (deleted and valid)edges in the mesh
-    unsigned int edges_size() const { return (unsigned int) eprops_.size(); }
+    Index_type edges_size() const { return (Index_type) eprops_.size(); }
     /// returns number of (deleted and valid)faces in the mesh
-    unsigned int faces_size() const { return (unsigned int) fprops_.size(); }
+    Index_type faces_size() const { return (Index_type) fprops_.size(); }
 
 
     /// returns number of vertices in the mesh
-    unsigned int n_vertices() const { return vertices_size() - deleted_vertices_; }
+    Index_type n_vertices() const { return vertices_size() - deleted_vertices_; }
     /// returns number of halfedge in the mesh
-    unsigned int n_halfedges() const { return halfedges_size() - 2*deleted_edges_; }
+    Index_type n_halfedges() const { return halfedges_size() - 2*deleted_edges_; }
     /// returns number of edges in the mesh
-    unsigned int n_edges() const { return edges_size() - deleted_edges_; }
+    Index_type n_edges() const { return edges_size() - deleted_edges_; }
     /// returns number of faces in the mesh
-    unsigned int n_faces() const { return faces_size() - deleted_faces_; }
+    Index_type n_faces() const { return faces_size() - deleted_faces_; }
 
 
     /// returns true iff the mesh is empty, i.e., has no vertices
     unsigned int empty() const { return n_vertices() == 0; }
 
+    /// returns a counter that is incremented whenever the connectivity of the
+    /// mesh changes, e.g. to validate data cached for a fixed topology.
+    /// moving vertices does not change it.
+    unsigned int topology_revision() const { return topology_revision_; }
+
 
     /// clear mesh: remove all vertices, edges, faces
     void clear();
@@ -960,61 +1055,76 @@ public: //--------------------------------------------------- memory management
     /// remove unused memory from vectors
     void free_memory();
 
-    /// reserve memory (mainly used in file readers)
-    void reserve(unsigned int nvertices,
-                 unsigned int nedges,
-                 unsigned int nfaces );
+    /// reserve memory (mainly used in file readers), twice as many
+    /// halfedges as edges are reserved
+    void reserve(Index_type nvertices,
+                 Index_type nedges,
+                 Index_type nfaces );
 
 
     /// remove deleted vertices/edges/faces
     void garbage_collection();
 
+    /** reorder the elements: vertex \c i becomes the old vertex \c vertex_order[i],
+     likewise for edges and faces, the two halfedges of an edge move with it.
+     all property arrays are permuted and the connectivity is remapped, handles
+     stored in custom properties are not. the mesh must not contain garbage.
+     \sa reorder() */
+    void permute(const std::vector<int>& vertex_order,
+                 const std::vector<int>& edge_order,
+                 const std::vector<int>& face_order);
+
+
+    /// are there deleted vertices, edges or faces? without garbage nothing is
+    /// deleted and the compact ranges may be used
+    /// \sa garbage_collection(), compact_vertices()
+    bool has_garbage() const { return garbage_; }
 
     /// returns whether vertex \c v is deleted
     /// \sa garbage_collection()
     bool is_deleted(Vertex v) const
     {
-        return vdeleted_[v];
+        return garbage_ && vdeleted_[v];
     }
     /// returns whether halfedge \c h is deleted
     /// \sa garbage_collection()
     bool is_deleted(Halfedge h) const
     {
-        return edeleted_[edge(h)];
+        return garbage_ && edeleted_[edge(h)];
     }
     /// returns whether edge \c e is deleted
     /// \sa garbage_collection()
     bool is_deleted(Edge e) const
     {
-        return edeleted_[e];
+        return garbage_ && edeleted_[e];
     }
     /// returns whether face \c f is deleted
     /// \sa garbage_collection()
     bool is_deleted(Face f) const
     {
-        return fdeleted_[f];
+        return garbage_ && fdeleted_[f];
     }
 
 
     /// return whether vertex \c v is valid, i.e. the index is stores it within the array bounds.
     bool is_valid(Vertex v) const
     {
-        return (0 <= v.idx()) && (v.idx() < (int)vertices_size());
+        return v.idx() < vertices_size();
     }
     /// return whether halfedge \c h is valid, i.e. the index is stores it within the array bounds.
     bool is_valid(Halfedge h) const
     {
-        return (0 <= h.idx()) && (h.idx() < (int)halfedges_size());
+        return h.idx() < halfedges_size();
     }
     /// return whether edge \c e is valid, i.e. the index is stores it within the array bounds.
     bool is_valid(Edge e) const
     {
-        return (0 <= e.idx()) && (e.idx() < (int)edges_size());
+        return e.idx() < edges_size();
     }
     /// return whether face \c f is valid, i.e. the index is stores it within the array bounds.
     bool is_valid(Face f) const
     {
-        return (0 <= f.idx()) && (f.idx() < (int)faces_size());
+        return f.idx() < faces_size();
     }
 
     //@}
@@ -1038,6 +1148,7 @@ public: //---------------------------------------------- low-level connectivity
     void set_halfedge(Vertex v, Halfedge h)
     {
         vconn_[v].halfedge_ = h;
+        ++topology_revision_;
     }
 
     /// returns whether \c v is a boundary vertex
@@ -1085,6 +1196,7 @@ public: //---------------------------------------------- low-level connectivity
     void set_vertex(Halfedge h, Vertex v)
     {
         hconn_[h].vertex_ = v;
+        ++topology_revision_;
     }
 
     /// returns the face incident to halfedge \c h
@@ -1097,6 +1209,7 @@ public: //---------------------------------------------- low-level connectivity
     void set_face(Halfedge h, Face f)
     {
         hconn_[h].face_ = f;
+        ++topology_revision_;
     }
 
     /// returns the next halfedge within the incident face
@@ -1110,6 +1223,7 @@ public: //---------------------------------------------- low-level connectivity
     {
         hconn_[h].next_halfedge_ = nh;
         hconn_[nh].prev_halfedge_ = h;
+        ++topology_revision_;
     }
 
     /// returns the previous halfedge within the incident face
@@ -1189,6 +1303,7 @@ public: //---------------------------------------------- low-level connectivity
     void set_halfedge(Face f, Halfedge h)
     {
         fconn_[f].halfedge_ = h;
+        ++topology_revision_;
     }
 
     /// returns whether \c f is a boundary face, i.e., it one of its edges is a boundary edge.
@@ -1298,6 +1413,52 @@ public: //--------------------------------------------------- property handling
     }
 
 
+    /** get the vertex property of \c key. unlike the lookup by name this is an
+     array access. \sa Property_key */
+    template <class T> Vertex_property<T> get_vertex_property(const Property_key& key) const
+    {
+        return Vertex_property<T>(vprops_.get<T>(key));
+    }
+    /// get the halfedge property of \c key
+    template <class T> Halfedge_property<T> get_halfedge_property(const Property_key& key) const
+    {
+        return Halfedge_property<T>(hprops_.get<T>(key));
+    }
+    /// get the edge property of \c key
+    template <class T> Edge_property<T> get_edge_property(const Property_key& key) const
+    {
+        return Edge_property<T>(eprops_.get<T>(key));
+    }
+    /// get the face property of \c key
+    template <class T> Face_property<T> get_face_property(const Property_key& key) const
+    {
+        return Face_property<T>(fprops_.get<T>(key));
+    }
+
+
+    /** if a vertex property of type \c T with key \c key exists, it is returned.
+     otherwise this property is added (with default value \c t) */
+    template <class T> Vertex_property<T> vertex_property(const Property_key& key, const T t=T())
+    {
+        return Vertex_property<T>(vprops_.get_or_add<T>(key, t));
+    }
+    /// get or add the halfedge property of \c key
+    template <class T> Halfedge_property<T> halfedge_property(const Property_key& key, const T t=T())
+    {
+        return Halfedge_property<T>(hprops_.get_or_add<T>(key, t));
+    }
+    /// get or add the edge property of \c key
+    template <class T> Edge_property<T> edge_property(const Property_key& key, const T t=T())
+    {
+        return Edge_property<T>(eprops_.get_or_add<T>(key, t));
+    }
+    /// get or add the face property of \c key
+    template <class T> Face_property<T> face_property(const Property_key& key, const T t=T())
+    {
+        return Face_property<T>(fprops_.get_or_add<T>(key, t));
+    }
+
+
     /// remove the vertex property \c p
     template <class T> void remove_vertex_property(Vertex_property<T>& p)
     {
@@ -1366,9 +1527,23 @@ public: //--------------------------------------------------- property handling
     {
         return fprops_.properties();
     }
-    /// prints the names of all properties
+    /// prints the names and memory of all properties
     void property_stats() const;
 
+    /// memory of the property arrays per element type, see Property_memory
+    struct Memory_report
+    {
+        std::vector<Property_memory> vertex, halfedge, edge, face;
+
+        /// bytes used by the elements of all arrays
+        size_t used() const;
+        /// bytes reserved by the capacity of all arrays
+        size_t reserved() const;
+    };
+
+    /// returns the memory of all property arrays
+    Memory_report memory_report() const;
+
     //@}
 
 
@@ -1451,6 +1626,36 @@ public: //--------------------------------------------- iterators & circulators
         return Face_container(faces_begin(), faces_end());
     }
 
+    /// returns the vertex indices for range-based for-loops, which do not
+    /// skip deleted vertices: the mesh must not contain garbage
+    /// \sa has_garbage()
+    Index_range<Vertex> compact_vertices() const
+    {
+        assert(!garbage_);
+        return Index_range<Vertex>(vertices_size());
+    }
+
+    /// returns the halfedge indices of a mesh without garbage
+    Index_range<Halfedge> compact_halfedges() const
+    {
+        assert(!garbage_);
+        return Index_range<Halfedge>(halfedges_size());
+    }
+
+    /// returns the edge indices of a mesh without garbage
+    Index_range<Edge> compact_edges() const
+    {
+        assert(!garbage_);
+        return Index_range<Edge>(edges_size());
+    }
+
+    /// returns the face indices of a mesh without garbage
+    Index_range<Face> compact_faces() const
+    {
+        assert(!garbage_);
+        return Index_range<Face>(faces_size());
+    }
+
     /// returns circulator for vertices around vertex \c v
     Vertex_around_vertex_circulator vertices(Vertex v) const
     {
@@ -1501,7 +1706,9 @@ public: //--------------------------------------------- higher-level operations
     /// each face, and therefore is not very efficient.
     bool is_quad_mesh() const;
 
-    /// triangulate the entire mesh, by calling triangulate(Face) for each face.
+    /// triangulate the entire mesh, with the result of calling
+    /// triangulate(Face) for each face; the element arrays are resized once
+    /// and the faces are split in parallel.
     /// \sa trianglate(Face)
     void triangulate();
 
@@ -1527,6 +1734,25 @@ public: //--------------------------------------------- higher-level operations
     void collapse(Halfedge h);
 
 
+    /** Start a batch of topology edits. Until end_topology_batch(), collapse()
+     and the other operators only queue the vertices whose outgoing halfedge
+     may have to be moved to the boundary, instead of searching their one-ring
+     after every edit; the batch repairs every queued vertex once. Inside a
+     batch is_boundary(Vertex) and the tests that use it, e.g.
+     is_collapse_ok(), may be wrong for the vertices an edit of the batch
+     touched, so evaluate the edits before applying them.
+     \sa end_topology_batch()
+     */
+    void begin_topology_batch();
+
+    /// repair the outgoing halfedges of the vertices the batch touched and
+    /// end it; garbage_collection() ends an open batch first
+    void end_topology_batch();
+
+    /// is a batch of topology edits open?
+    bool in_topology_batch() const { return topology_batch_; }
+
+
     /** Split the face \c f by first adding point \c p to the mesh and then
      inserting edges between \c p and the vertices of \c f. For a triangle
      this is a standard one-to-three split.
@@ -1645,7 +1871,10 @@ public: //------------------------------------------ geometry-related functions
     Point& position(Vertex v) { return vpoint_[v]; }
 
     /// vector of vertex positions
-    std::vector<Point>& points() { return vpoint_.vector(); }
+    Property_vector<Point>& points() { return vpoint_.vector(); }
+
+    /// vector of vertex positions (read only)
+    const Property_vector<Point>& points() const { return vpoint_.vector(); }
 
     /// compute face normals by calling compute_face_normal(Face) for each face.
     void update_face_normals();
@@ -1653,7 +1882,10 @@ public: //------------------------------------------ geometry-related functions
     /// compute normal vector of face \c f.
     Normal compute_face_normal(Face f) const;
 
-    /// compute vertex normals by calling compute_vertex_normal(Vertex) for each vertex.
+    /// compute angle weighted vertex normals for all vertices. the face normals
+    /// and corner angles are computed once per face and then gathered per vertex,
+    /// so the result may differ from compute_vertex_normal(Vertex) in the last
+    /// bits and, for non-planar polygons, by the use of the polygon normal.
     void update_vertex_normals();
 
     /// compute normal vector of vertex \c v.
@@ -1672,7 +1904,13 @@ private: //---------------------------------------------- allocate new elements
     /// allocate a new vertex, resize vertex properties accordingly.
     Vertex new_vertex()
     {
-        vprops_.push_back();
+        ++topology_revision_;
+        assert(vprops_.array(0) == vconn_.parray_ && vprops_.array(1) == vpoint_.parray_ &&
+               vprops_.array(2) == vdeleted_.parray_);
+        vprops_.push_back_after(3);
+        vconn_.array().push_back();
+        vpoint_.array().push_back();
+        vdeleted_.array().push_back();
         return Vertex(vertices_size()-1);
     }
 
@@ -1680,10 +1918,15 @@ private: //---------------------------------------------- allocate new elements
     Halfedge new_edge(Vertex start, Vertex end)
     {
         assert(start != end);
+        assert(eprops_.array(0) == edeleted_.parray_ && hprops_.array(0) == hconn_.parray_);
 
-        eprops_.push_back();
-        hprops_.push_back();
-        hprops_.push_back();
+        eprops_.push_back_after(1);
+        edeleted_.array().push_back();
+        for (int i = 0; i < 2; ++i)
+        {
+            hprops_.push_back_after(1);
+            hconn_.array().push_back();
+        }
 
         Halfedge h0(halfedges_size()-2);
         Halfedge h1(halfedges_size()-1);
@@ -1697,7 +1940,11 @@ private: //---------------------------------------------- allocate new elements
     /// allocate a new face, resize face properties accordingly.
     Face new_face()
     {
-        fprops_.push_back();
+        ++topology_revision_;
+        assert(fprops_.array(0) == fconn_.parray_ && fprops_.array(1) == fdeleted_.parray_);
+        fprops_.push_back_after(2);
+        fconn_.array().push_back();
+        fdeleted_.array().push_back();
         return Face(faces_size()-1);
     }
 
@@ -1716,14 +1963,52 @@ private: //--------------------------------------------------- helper functions
     /// Helper for halfedge collapse
     void remove_loop(Halfedge h);
 
+    /// Helper for add_faces(): builds the connectivity of a mesh without
+    /// faces, returns false and leaves the mesh unchanged if it is not manifold
+    bool build_faces(const std::vector<unsigned int>& indices,
+                     const std::vector<unsigned int>& valences);
+
+    /// Helper for permute() and garbage_collection(): element i becomes the
+    /// old element order[i], elements that are not listed are dropped
+    void gather(const std::vector<int>& vertex_order,
+                const std::vector<int>& edge_order,
+                const std::vector<int>& face_order);
+
     /// are there deleted vertices, edges or faces?
     bool garbage() const { return garbage_; }
 
+    /// the first element at or after the valid handle that is not deleted,
+    /// the end of its range if there is none. Runs of deleted elements are
+    /// skipped a word of their flags at a time.
+    Vertex next_undeleted(Vertex v) const
+    {
+        return Vertex(Index_type(vdeleted_.vector().find_next_unset(v.idx())));
+    }
+    Halfedge next_undeleted(Halfedge h) const
+    {
+        const Index_type e = Index_type(edeleted_.vector().find_next_unset(h.idx() >> 1));
+        return (e == (h.idx() >> 1)) ? h : Halfedge(2 * e);
+    }
+    Edge next_undeleted(Edge e) const
+    {
+        return Edge(Index_type(edeleted_.vector().find_next_unset(e.idx())));
+    }
+    Face next_undeleted(Face f) const
+    {
+        return Face(Index_type(fdeleted_.vector().find_next_unset(f.idx())));
+    }
+
 
 
 private: //------------------------------------------------------- private data
 
     friend bool read_poly(Surface_mesh& mesh, const std::string& filename);
+    friend bool map_poly(Surface_mesh& mesh, const std::string& filename);
+    friend bool write_poly(const Surface_mesh& mesh, const std::string& filename);
+    friend bool read_poly(Surface_mesh& mesh, const char* src, size_t size);
+    friend size_t write_poly(const Surface_mesh& mesh, char* dst, size_t capacity);
+    friend class Subdivider;
+    friend class Arrow_writer;
 
     Property_container vprops_;
     Property_container hprops_;
@@ -1742,10 +2027,18 @@ private: //------------------------------------------------------- private data
     Vertex_property<Normal>  vnormal_;
     Face_property<Normal>    fnormal_;
 
-    unsigned int deleted_vertices_;
-    unsigned int deleted_edges_;
-    unsigned int deleted_faces_;
+    Index_type deleted_vertices_;
+    Index_type deleted_edges_;
+    Index_type deleted_faces_;
     bool garbage_;
+    unsigned int topology_revision_;
+
+    Face_report face_report_;
+
+    // vertices queued by adjust_outgoing_halfedge() in a topology batch
+    bool                     topology_batch_;
+    std::vector<Vertex>      batch_vertices_;
+    std::vector<bool>        batch_queued_;
 
     // helper data for add_face()
     typedef std::pair<Halfedge, Halfedge>  NextCacheEntry;
@@ -1758,6 +2051,14 @@ private: //------------------------------------------------------- private data
 };
 
 
+// the connectivity stays packed indices for either Index_type
+static_assert(sizeof(Surface_mesh::Halfedge_connectivity) == 4 * sizeof(Index_type),
+              "Halfedge_connectivity must be four packed indices");
+static_assert(sizeof(Surface_mesh::Vertex_connectivity) == sizeof(Index_type) &&
+              sizeof(Surface_mesh::Face_connectivity) == sizeof(Index_type),
+              "vertex and face connectivity must be one index");
+
+
 //------------------------------------------------------------ output operators
 
 
@@ -0,0 +1,148 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Threads.h>
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+#ifdef __linux__
+#  include <sched.h>
+#endif
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+
+std::mutex     options_mutex;
+Thread_options options;
+
+
+// the CPUs the process may run on, as it was started; pinned threads would
+// report their own CPU only
+const std::vector<int>& process_cpus()
+{
+    static const std::vector<int> cpus = []()
+    {
+        std::vector<int> list;
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                if (CPU_ISSET(cpu, &set)) list.push_back(cpu);
+#endif
+        if (list.empty())
+        {
+            const int n = std::max(int(std::thread::hardware_concurrency()), 1);
+            for (int cpu = 0; cpu < n; ++cpu) list.push_back(cpu);
+        }
+        return list;
+    }();
+    return cpus;
+}
+
+
+// the CPU of thread i of a team of n
+int cpu_of(const Thread_options& o, int i, int n)
+{
+    const std::vector<int>& cpus = process_cpus();
+    const int size     = int(cpus.size());
+    const int reserved = std::min(int(o.reserved), size - 1);
+    const int free     = size - reserved;
+    const int k = o.affinity == AFFINITY_SPREAD ? int(long(i) * free / n) % free : i % free;
+    return cpus[reserved + k];
+}
+
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+void set_thread_options(const Thread_options& o)
+{
+    process_cpus();
+    {
+        std::lock_guard<std::mutex> lock(options_mutex);
+        options = o;
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(int(worker_threads()));
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Thread_options thread_options()
+{
+    std::lock_guard<std::mutex> lock(options_mutex);
+    return options;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int worker_threads()
+{
+    const Thread_options o = thread_options();
+    if (o.threads > 0) return o.threads;
+    const unsigned int cpus = (unsigned int) process_cpus().size();
+    return cpus > o.reserved ? cpus - o.reserved : 1u;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void enter_worker_thread()
+{
+    const Thread_options o = thread_options();
+    const int n = int(worker_threads());
+#ifdef _OPENMP
+    omp_set_num_threads(n);
+#endif
+
+#if defined(__linux__) && defined(_OPENMP)
+    // the runtime keeps the threads of the team for the next loops of this
+    // thread, pinning them once pins those loops
+    if (o.affinity != AFFINITY_NONE)
+    {
+#pragma omp parallel num_threads(n)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu_of(o, omp_get_thread_num(), n), &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+    }
+#else
+    (void) o;
+    (void) n;
+#endif
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -0,0 +1,65 @@
+//=============================================================================
+#ifndef SURFACE_MESH_THREADS_H
+#define SURFACE_MESH_THREADS_H
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//=============================================================================
+
+
+/// where the threads of a parallel team run
+enum Thread_affinity
+{
+    AFFINITY_NONE,     ///< wherever the scheduler puts them
+    AFFINITY_COMPACT,  ///< one CPU each, neighboring CPUs
+    AFFINITY_SPREAD    ///< one CPU each, evenly spaced over the CPUs
+};
+
+
+/// the process-wide settings of the parallel loops of surface_mesh and of
+/// the code built on it. The loops are OpenMP loops, their threads are
+/// those the OpenMP runtime keeps per calling thread; Eigen takes its
+/// thread count from OpenMP as well, so nothing else starts compute
+/// threads of its own.
+struct Thread_options
+{
+    unsigned int    threads;   ///< threads of a team, 0 for the CPUs left after reserved
+    unsigned int    reserved;  ///< CPUs kept free for other work, e.g. a UI thread
+    Thread_affinity affinity;
+
+    Thread_options() : threads(0), reserved(0), affinity(AFFINITY_NONE) {}
+};
+
+
+/// set the options for the threads that enter_worker_thread() later, the
+/// calling thread only takes the thread count: it is not pinned, so that a
+/// UI thread calling it runs wherever there is room
+void set_thread_options(const Thread_options& options);
+
+/// the options of set_thread_options(), the defaults until it is called
+Thread_options thread_options();
+
+/// the threads of a team: Thread_options::threads, or the CPUs the process
+/// may run on minus the reserved ones, at least one
+unsigned int worker_threads();
+
+/// apply the options to the calling thread: the OpenMP loops it starts run
+/// on worker_threads() threads, pinned to the CPUs after the reserved ones
+/// with an affinity (Linux only). The calling thread is the first of its
+/// team and pinned as well, threads it starts afterwards inherit its CPU.
+/// For threads that run the parallel loops and live long, e.g. the worker
+/// of an interactive application, since every such thread gets a team of
+/// its own.
+void enter_worker_thread();
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_THREADS_H
+//=============================================================================
@@ -0,0 +1,227 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Trace.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+
+struct Event
+{
+    const char*            name;
+    long long              begin, end;
+    bool                        counted;
+    Perf_counters::Sample       counters;
+    bool                        tracked;
+    Allocation_tracker::Counts  allocations;
+};
+
+
+// the zones of one thread, appended without locking by their thread
+struct Thread_events
+{
+    int                 tid;
+    std::vector<Event>  events;
+};
+
+
+std::atomic<bool>             recording_(false);
+std::atomic<bool>             counting_(false);
+std::mutex                    mutex_;
+std::vector<Thread_events*>   threads_;   // never freed, threads may outlive main
+
+
+Thread_events& thread_events()
+{
+    static thread_local Thread_events* local = 0;
+    if (!local)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        local = new Thread_events;
+        local->tid = (int) threads_.size();
+        threads_.push_back(local);
+    }
+    return *local;
+}
+
+
+// JSON string contents, zone names are literals but may contain quotes
+void write_escaped(FILE* out, const char* s)
+{
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+}
+
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+void Trace::start()     { recording_ = true;  }
+void Trace::stop()      { recording_ = false; }
+bool Trace::recording() { return recording_;  }
+bool Trace::counting()  { return counting_;   }
+void Trace::stop_counting() { counting_ = false; }
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Trace::start_counting()
+{
+    if (!Perf_counters::open()) return false;
+    counting_ = true;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Trace::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i=0; i<threads_.size(); ++i)
+        threads_[i]->events.clear();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+long long Trace::now()
+{
+    typedef std::chrono::steady_clock Clock;
+    static const Clock::time_point origin = Clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Trace::record(const char* name, long long begin, long long end,
+                   const Perf_counters::Sample* counters,
+                   const Allocation_tracker::Counts* allocations)
+{
+    Event e;
+    e.name    = name;
+    e.begin   = begin;
+    e.end     = end;
+    e.counted = counters != 0;
+    if (counters) e.counters = *counters;
+    e.tracked = allocations != 0;
+    if (allocations) e.allocations = *allocations;
+    thread_events().events.push_back(e);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Trace::totals(long long begin, long long end, std::vector<Total>& totals)
+{
+    totals.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t t=0; t<threads_.size(); ++t)
+    {
+        const std::vector<Event>& events = threads_[t]->events;
+        for (size_t i=0; i<events.size(); ++i)
+        {
+            if (events[i].begin < begin || events[i].end > end) continue;
+
+            // few distinct names, a scan is fine
+            size_t k = 0;
+            while (k < totals.size() && totals[k].name != events[i].name) ++k;
+            if (k == totals.size())
+            {
+                totals.push_back(Total());
+                totals[k].name = events[i].name;
+                totals[k].milliseconds = 0.0;
+            }
+            totals[k].milliseconds += (events[i].end - events[i].begin) * 1e-6;
+            if (events[i].counted) totals[k].counters += events[i].counters;
+            if (events[i].tracked) totals[k].allocations += events[i].allocations;
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Trace::write(const std::string& filename)
+{
+    FILE* out = fopen(filename.c_str(), "w");
+    if (!out) return false;
+
+    // complete events ("ph":"X") with microsecond timestamps
+    std::lock_guard<std::mutex> lock(mutex_);
+    fprintf(out, "{\"traceEvents\":[");
+    bool first = true;
+    for (size_t t=0; t<threads_.size(); ++t)
+    {
+        const std::vector<Event>& events = threads_[t]->events;
+        for (size_t i=0; i<events.size(); ++i)
+        {
+            fprintf(out, "%s\n{\"name\":\"", first ? "" : ",");
+            write_escaped(out, events[i].name);
+            fprintf(out, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    threads_[t]->tid, events[i].begin * 1e-3,
+                    (events[i].end - events[i].begin) * 1e-3);
+            if (events[i].counted || events[i].tracked)
+            {
+                const char* separator = "";
+                fprintf(out, ",\"args\":{");
+                if (events[i].counted)
+                {
+                    const Perf_counters::Sample& s = events[i].counters;
+                    fprintf(out, "\"ipc\":%.3f", s.ipc());
+                    for (int c=0; c<Perf_counters::N_COUNTERS; ++c)
+                        if (Perf_counters::available(Perf_counters::Counter(c)))
+                            fprintf(out, ",\"%s\":%.0f",
+                                    Perf_counters::name(Perf_counters::Counter(c)), s.value[c]);
+                    separator = ",";
+                }
+                if (events[i].tracked)
+                    fprintf(out, "%s\"allocations\":%lld,\"allocated_bytes\":%lld", separator,
+                            events[i].allocations.allocations, events[i].allocations.bytes);
+                fprintf(out, "}");
+            }
+            fprintf(out, "}");
+            first = false;
+        }
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    return fclose(out) == 0;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -0,0 +1,151 @@
+//=============================================================================
+
+
+#ifndef SURFACE_MESH_TRACE_H
+#define SURFACE_MESH_TRACE_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Allocation_tracker.h>
+#include <surface_mesh/Perf_counters.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// Scoped timers for profiling. A Trace_zone records the interval between its
+/// construction and destruction while recording is on; the zones of all
+/// threads are written as a Chrome trace (chrome://tracing, Perfetto).
+/// Zones are placed with SURFACE_MESH_TRACE_ZONE(name), which compiles to
+/// nothing unless SURFACE_MESH_TRACING is defined (cmake -DGP_TRACING=ON).
+/// While counting is on as well, every zone also records the Perf_counters
+/// of the process over its interval, and in builds with
+/// SURFACE_MESH_ALLOCATION_TRACKING the Allocation_tracker counts.
+class Trace
+{
+public:
+
+    /// the zones of one name, see totals()
+    struct Total
+    {
+        std::string                 name;
+        double                      milliseconds;
+        Perf_counters::Sample       counters;
+        Allocation_tracker::Counts  allocations;
+    };
+
+    /// start recording zones, previously recorded zones are kept
+    static void start();
+
+    /// stop recording zones
+    static void stop();
+
+    /// is recording on?
+    static bool recording();
+
+    /// record the hardware counters of the zones too, false if they cannot
+    /// be opened, see Perf_counters
+    static bool start_counting();
+
+    /// stop recording the counters, Perf_counters stay open
+    static void stop_counting();
+
+    /// is counting on?
+    static bool counting();
+
+    /// drop all recorded zones
+    static void clear();
+
+    /// write the recorded zones in the Chrome trace event format, the
+    /// counters and allocations as arguments of the zones that have them;
+    /// returns false if the file could not be written; call when no other
+    /// thread records zones
+    static bool write(const std::string& filename);
+
+    /// milliseconds, counters and allocations per zone name of the zones of
+    /// all threads that lie within [begin, end], summed in the order the
+    /// names first occur; call when no other thread records zones
+    static void totals(long long begin, long long end, std::vector<Total>& totals);
+
+    /// record a zone, \c name must have static storage duration; times are
+    /// nanoseconds of now(), \c counters and \c allocations the counts over
+    /// the zone if any
+    static void record(const char* name, long long begin, long long end,
+                       const Perf_counters::Sample* counters = 0,
+                       const Allocation_tracker::Counts* allocations = 0);
+
+    /// nanoseconds since the first call
+    static long long now();
+};
+
+
+/// records the lifetime of the object as zone \c name, see Trace
+class Trace_zone
+{
+public:
+
+    explicit Trace_zone(const char* name)
+        : name_(Trace::recording() ? name : 0), begin_(name_ ? Trace::now() : 0),
+          counting_(name_ && Trace::counting())
+    {
+        if (counting_) counters_ = Perf_counters::read();
+        if (name_ && Allocation_tracker::enabled()) allocations_ = Allocation_tracker::read();
+    }
+
+    ~Trace_zone()
+    {
+        if (!name_) return;
+        const long long end = Trace::now();
+        Perf_counters::Sample counters;
+        if (counting_) counters = Perf_counters::read() - counters_;
+        Allocation_tracker::Counts allocations;
+        if (Allocation_tracker::enabled()) allocations = Allocation_tracker::read() - allocations_;
+        Trace::record(name_, begin_, end, counting_ ? &counters : 0,
+                      Allocation_tracker::enabled() ? &allocations : 0);
+    }
+
+private:
+
+    Trace_zone(const Trace_zone&);
+    Trace_zone& operator=(const Trace_zone&);
+
+    const char*            name_;
+    long long              begin_;
+    bool                        counting_;
+    Perf_counters::Sample       counters_;
+    Allocation_tracker::Counts  allocations_;
+};
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+
+
+#define SURFACE_MESH_TRACE_CONCAT_(a, b) a##b
+#define SURFACE_MESH_TRACE_CONCAT(a, b)  SURFACE_MESH_TRACE_CONCAT_(a, b)
+
+#ifdef SURFACE_MESH_TRACING
+/// time the rest of the enclosing scope as zone \c name (a string literal)
+#define SURFACE_MESH_TRACE_ZONE(name) \
+    surface_mesh::Trace_zone SURFACE_MESH_TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#else
+#define SURFACE_MESH_TRACE_ZONE(name)
+#endif
+
+
+//=============================================================================
+#endif // SURFACE_MESH_TRACE_H
+//=============================================================================
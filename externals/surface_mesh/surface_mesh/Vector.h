@@ -667,27 +667,18 @@ inline Scalar dot(const Vector<Scalar,3>& v0, const Vector<Scalar,3>& v1)
 template <typename Scalar>
 inline Scalar sqrdist(const Vector<Scalar,3>& v0, const Vector<Scalar,3>& v1)
 {
-    Scalar dist(0), d;
-    for (int i=0; i<3; ++i)
-    {
-        d = v0[i] - v1[i];
-        d *= d;
-        dist += d;
-    }
+    // unrolled, summed in the order of the loops of the generic version
+    const Scalar dx = v0.x - v1.x, dy = v0.y - v1.y, dz = v0.z - v1.z;
+    Scalar dist = dx*dx;
+    dist += dy*dy;
+    dist += dz*dz;
     return dist;
 }
 
 template <typename Scalar>
 inline Scalar distance(const Vector<Scalar,3>& v0, const Vector<Scalar,3>& v1)
 {
-    Scalar dist(0), d;
-    for (int i=0; i<3; ++i)
-    {
-        d = v0[i] - v1[i];
-        d *= d;
-        dist += d;
-    }
-    return (Scalar)sqrt(dist);
+    return (Scalar)sqrt(sqrdist(v0, v1));
 }
 
 #endif
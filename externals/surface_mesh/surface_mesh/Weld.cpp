@@ -0,0 +1,313 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Weld.h>
+#include <surface_mesh/Trace.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <utility>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+
+struct Cell
+{
+    int x, y, z;
+    bool operator==(const Cell& c) const { return x==c.x && y==c.y && z==c.z; }
+};
+
+
+// grid coordinate of x, far away and non-finite positions are clamped so
+// that the neighbors of a cell stay in range
+inline int grid(float x)
+{
+    const float f = std::floor(x);
+    if (!(f > -1e9f)) return -1000000000;
+    if (f > 1e9f)     return  1000000000;
+    return (int) f;
+}
+
+
+// the cell of p: cells of the size of the tolerance, or the bit pattern of
+// the position for tolerance 0, where adding 0 turns -0 into +0
+inline Cell cell_of(const Point& p, float inv_cell)
+{
+    Cell c;
+    if (inv_cell > 0.0f)
+    {
+        c.x = grid(p[0] * inv_cell);
+        c.y = grid(p[1] * inv_cell);
+        c.z = grid(p[2] * inv_cell);
+    }
+    else
+    {
+        const float x = p[0] + 0.0f, y = p[1] + 0.0f, z = p[2] + 0.0f;
+        memcpy(&c.x, &x, sizeof(float));
+        memcpy(&c.y, &y, sizeof(float));
+        memcpy(&c.z, &z, sizeof(float));
+    }
+    return c;
+}
+
+
+inline uint64_t hash_of(const Cell& c)
+{
+    uint64_t h = (unsigned int) c.x;
+    h = h * 0x9E3779B97F4A7C15ull ^ (unsigned int) c.y;
+    h = h * 0x9E3779B97F4A7C15ull ^ (unsigned int) c.z;
+    return (h ^ (h >> 29)) * 0xBF58476D1CE4E5B9ull;
+}
+
+
+// open addressing tables from a cell to the first position in it, one per
+// thread. Every thread owns the cells whose hash selects it and builds its
+// table from a scan over all positions, so the first positions do not
+// depend on the number of threads.
+class Cell_table
+{
+public:
+
+    Cell_table(const std::vector<Cell>& cells, const std::vector<uint64_t>& hashes)
+        : cells_(cells)
+    {
+        const int n = (int) cells.size();
+        first_.resize(n);
+#pragma omp parallel
+        {
+            int n_threads = 1, thread = 0;
+#ifdef _OPENMP
+            n_threads = omp_get_num_threads();
+            thread    = omp_get_thread_num();
+#endif
+#pragma omp single
+            parts_.resize(n_threads);
+
+            size_t n_owned = 0;
+            for (int i = 0; i < n; ++i)
+                if (part(hashes[i]) == thread) ++n_owned;
+
+            size_t size = 16;
+            while (size < 2 * n_owned) size *= 2;
+            std::vector<int> table(size, -1);
+            for (int i = 0; i < n; ++i)
+            {
+                if (part(hashes[i]) != thread) continue;
+                size_t slot = hashes[i] & (size - 1);
+                while (table[slot] != -1 && !(cells_[table[slot]] == cells_[i]))
+                    slot = (slot + 1) & (size - 1);
+                if (table[slot] == -1) table[slot] = i;
+                first_[i] = table[slot];
+            }
+            parts_[thread].swap(table);
+        }
+    }
+
+    // the first position in the cell of position i
+    int first(int i) const { return first_[i]; }
+
+    // the first position in cell c, -1 if there is none
+    int find(const Cell& c) const
+    {
+        const uint64_t h = hash_of(c);
+        const std::vector<int>& table = parts_[part(h)];
+        const size_t mask = table.size() - 1;
+        for (size_t slot = h & mask; table[slot] != -1; slot = (slot + 1) & mask)
+            if (cells_[table[slot]] == c) return table[slot];
+        return -1;
+    }
+
+private:
+
+    int part(uint64_t h) const { return int((h >> 40) % parts_.size()); }
+
+    const std::vector<Cell>&        cells_;
+    std::vector< std::vector<int> > parts_;
+    std::vector<int>                first_;
+};
+
+
+} // anonymous namespace
+
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int weld_positions(const Point* points, size_t n, float tolerance,
+                            std::vector<unsigned int>& vertex)
+{
+    SURFACE_MESH_TRACE_ZONE("weld_positions");
+    const int   nP       = (int) n;
+    const float inv_cell = tolerance > 0.0f ? 1.0f / tolerance : 0.0f;
+
+    std::vector<Cell>     cells(nP);
+    std::vector<uint64_t> hashes(nP);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < nP; ++i)
+    {
+        cells[i]  = cell_of(points[i], inv_cell);
+        hashes[i] = hash_of(cells[i]);
+    }
+    const Cell_table table(cells, hashes);
+
+
+    // the position every one joins, an earlier one or itself
+    std::vector<int> joins(nP);
+    if (inv_cell == 0.0f)
+    {
+        // a cell holds equal positions only
+        for (int i = 0; i < nP; ++i) joins[i] = table.first(i);
+    }
+    else
+    {
+        // the positions of every cell in ascending order, a counting sort
+        // by the first position of the cell
+        std::vector<int> start(nP + 1, 0), members(nP);
+        for (int i = 0; i < nP; ++i) ++start[table.first(i) + 1];
+        for (int i = 0; i < nP; ++i) start[i + 1] += start[i];
+        {
+            std::vector<int> fill(start.begin(), start.end() - 1);
+            for (int i = 0; i < nP; ++i) members[fill[table.first(i)]++] = i;
+        }
+
+        // the earlier positions j within the tolerance of position i and
+        // their squared distances d as (d, j) into out unless it is NULL,
+        // returns their number; a position closer than the tolerance is at
+        // most one cell away
+        const float tol2 = tolerance * tolerance;
+        auto candidates_of = [&](int i, std::pair<float, int>* out)
+        {
+            int count = 0;
+            Cell n;
+            for (n.x = cells[i].x-1; n.x <= cells[i].x+1; ++n.x)
+                for (n.y = cells[i].y-1; n.y <= cells[i].y+1; ++n.y)
+                    for (n.z = cells[i].z-1; n.z <= cells[i].z+1; ++n.z)
+                    {
+                        const int head = table.find(n);
+                        if (head == -1) continue;
+                        for (int k = start[head]; k < start[head + 1]; ++k)
+                        {
+                            const int j = members[k];
+                            if (j >= i) break;
+                            const float d = sqrnorm(points[j] - points[i]);
+                            if (d > tol2) continue;
+                            if (out) out[count] = std::make_pair(d, j);
+                            ++count;
+                        }
+                    }
+            return count;
+        };
+
+        // the candidates of every position by distance, in parallel
+        std::vector<int> offset(nP + 1, 0);
+#pragma omp parallel for schedule(dynamic, 4096)
+        for (int i = 0; i < nP; ++i)
+            offset[i + 1] = candidates_of(i, NULL);
+        for (int i = 0; i < nP; ++i) offset[i + 1] += offset[i];
+        std::vector< std::pair<float, int> > candidates(offset[nP]);
+#pragma omp parallel for schedule(dynamic, 4096)
+        for (int i = 0; i < nP; ++i)
+        {
+            std::pair<float, int>* c = candidates.data() + offset[i];
+            std::sort(c, c + candidates_of(i, c));
+        }
+
+        // in order, every position joins its closest candidate that
+        // started a vertex
+        for (int i = 0; i < nP; ++i)
+        {
+            joins[i] = i;
+            for (int k = offset[i]; k < offset[i + 1]; ++k)
+            {
+                const int j = candidates[k].second;
+                if (joins[j] == j) { joins[i] = j; break; }
+            }
+        }
+    }
+
+
+    // the vertices in the order of their first positions
+    vertex.resize(nP);
+    unsigned int nV = 0;
+    for (int i = 0; i < nP; ++i)
+        vertex[i] = joins[i] == i ? nV++ : vertex[joins[i]];
+    return nV;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int weld_vertices(Surface_mesh& mesh, float tolerance)
+{
+    SURFACE_MESH_TRACE_ZONE("weld_vertices");
+    if (mesh.has_garbage()) mesh.garbage_collection();
+
+    const unsigned int nV = mesh.n_vertices();
+    const Point* points = mesh.get_vertex_property<Point>("v:point").data();
+    std::vector<unsigned int> vertex;
+    const unsigned int n_welded = weld_positions(points, nV, tolerance, vertex);
+    if (n_welded == nV) return 0;
+
+    // the first position of every vertex
+    std::vector<Point> welded(n_welded);
+    for (unsigned int i = nV; i-- > 0; )
+        welded[vertex[i]] = points[i];
+
+
+    // the faces on the welded vertices, a vertex repeated around a face is
+    // kept once, faces with fewer than three left or a vertex twice dropped
+    std::vector<unsigned int> indices, valences;
+    indices.reserve(3 * mesh.n_faces());
+    valences.reserve(mesh.n_faces());
+    for (auto f : mesh.compact_faces())
+    {
+        const size_t begin = indices.size();
+        for (auto v : mesh.vertices(f))
+        {
+            const unsigned int w = vertex[v.idx()];
+            if (indices.size() == begin || indices.back() != w) indices.push_back(w);
+        }
+        if (indices.size() - begin > 1 && indices.back() == indices[begin]) indices.pop_back();
+
+        bool keep = indices.size() - begin >= 3;
+        for (size_t a = begin; keep && a < indices.size(); ++a)
+            for (size_t b = a + 1; keep && b < indices.size(); ++b)
+                keep = indices[a] != indices[b];
+        if (keep) valences.push_back((unsigned int) (indices.size() - begin));
+        else      indices.resize(begin);
+    }
+
+
+    // the connectivity in bulk
+    const unsigned int nF = (unsigned int) valences.size();
+    mesh.clear();
+    mesh.reserve(n_welded, (unsigned int) indices.size() / 2, nF);
+    mesh.add_vertices(welded.data(), welded.size());
+    mesh.add_faces(indices, valences);
+
+    return nV - n_welded;
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -0,0 +1,51 @@
+//=============================================================================
+
+
+#ifndef SURFACE_MESH_WELD_H
+#define SURFACE_MESH_WELD_H
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/Surface_mesh.h>
+
+#include <vector>
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//=============================================================================
+
+
+/// Weld \c n positions into shared vertices: \c vertex[i] receives the vertex
+/// of position \c i, the vertices numbered by their first position. Every
+/// position joins the closest earlier vertex within \c tolerance or starts
+/// a new one, so the result is that of adding the positions one by one.
+/// With \c tolerance 0 only positions equal up to the sign of zero merge.
+/// The positions are bucketed in a spatial hash of cells of the size of the
+/// tolerance in parallel, which keeps the time linear in \c n; only the
+/// final pass over the candidates of every position is sequential.
+/// returns the number of vertices.
+unsigned int weld_positions(const Point* points, size_t n, float tolerance,
+                            std::vector<unsigned int>& vertex);
+
+
+/// Merge the vertices of \c mesh closer than \c tolerance, e.g. the
+/// duplicated seam vertices of OBJ and OFF exports, with weld_positions().
+/// The connectivity is rebuilt in bulk from the welded faces, faces that
+/// collapse to fewer than three vertices are dropped. Only the positions
+/// are kept, like the STL reader does. returns the number of vertices
+/// removed, the mesh is left alone if that is 0.
+unsigned int weld_vertices(Surface_mesh& mesh, float tolerance = 0.0f);
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
+#endif // SURFACE_MESH_WELD_H
+//=============================================================================
@@ -0,0 +1,140 @@
+//=============================================================================
+
+
+//== INCLUDES =================================================================
+
+
+#include <surface_mesh/properties.h>
+#include <atomic>
+#include <cstdlib>
+#if defined(_WIN32)
+#  include <malloc.h>
+#elif defined(__linux__)
+#  include <sys/mman.h>
+#endif
+
+
+//== NAMESPACE ================================================================
+
+
+namespace surface_mesh {
+
+
+//== IMPLEMENTATION ==========================================================
+
+
+static const size_t SIMD_ALIGNMENT = 64;
+static const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+static const size_t PAGE_SIZE = size_t(4) << 10;
+#if defined(SURFACE_MESH_HUGE_PAGES) || defined(SURFACE_MESH_FIRST_TOUCH)
+static const bool huge_blocks = true;
+#else
+static const bool huge_blocks = false;
+#endif
+
+
+#ifdef SURFACE_MESH_MAPPED_STORAGE
+
+namespace {
+
+// the owners of the adopted blocks that are in use, by their first byte;
+// the count spares the lock in the common case of none
+std::mutex                                       adopted_mutex;
+std::unordered_map<void*, std::shared_ptr<void> > adopted_blocks;
+std::atomic<size_t>                              n_adopted(0);
+
+} // anonymous namespace
+
+
+Adopted_storage*& Adopted_storage::pending()
+{
+    static thread_local Adopted_storage* storage = NULL;
+    return storage;
+}
+
+#endif
+
+
+void* allocate_property_storage(size_t bytes)
+{
+#ifdef SURFACE_MESH_MAPPED_STORAGE
+    Adopted_storage* adopted = Adopted_storage::pending();
+    if (adopted && !adopted->taken && adopted->bytes == bytes)
+    {
+        std::lock_guard<std::mutex> lock(adopted_mutex);
+        adopted_blocks[adopted->data] = adopted->owner;
+        n_adopted = adopted_blocks.size();
+        adopted->taken = true;
+        return adopted->data;
+    }
+#endif
+
+    if (bytes == 0) bytes = 1;
+    const bool huge = huge_blocks && bytes >= HUGE_PAGE_SIZE;
+    const size_t alignment = huge ? HUGE_PAGE_SIZE : SIMD_ALIGNMENT;
+    // whole huge pages, the tail would otherwise share one with other data
+    if (huge) bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+    void* p = NULL;
+#if defined(_WIN32)
+    p = _aligned_malloc(bytes, alignment);
+#else
+    if (posix_memalign(&p, alignment, bytes) != 0) p = NULL;
+#endif
+    if (!p) throw std::bad_alloc();
+
+#if defined(SURFACE_MESH_HUGE_PAGES) && defined(__linux__) && defined(MADV_HUGEPAGE)
+    // a hint for transparent huge pages in madvise mode, failures are harmless
+    if (huge) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+
+#ifdef SURFACE_MESH_FIRST_TOUCH
+    // the first write to a page places it on the node of the writing thread;
+    // the vector fills the elements afterwards on one thread, but the pages
+    // stay where this loop put them. The partition of the pages is the one
+    // of a schedule(static) loop over the elements of the array.
+    if (huge)
+    {
+        char* c = static_cast<char*>(p);
+        const long pages = long(bytes / PAGE_SIZE);
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < pages; ++i)
+            c[i * PAGE_SIZE] = 0;
+    }
+#endif
+    return p;
+}
+
+
+void free_property_storage(void* p)
+{
+#ifdef SURFACE_MESH_MAPPED_STORAGE
+    if (n_adopted > 0)
+    {
+        std::shared_ptr<void> owner;
+        {
+            std::lock_guard<std::mutex> lock(adopted_mutex);
+            std::unordered_map<void*, std::shared_ptr<void> >::iterator it = adopted_blocks.find(p);
+            if (it != adopted_blocks.end())
+            {
+                owner.swap(it->second);
+                adopted_blocks.erase(it);
+                n_adopted = adopted_blocks.size();
+            }
+        }
+        // the owner, e.g. a mapping, goes outside of the lock
+        if (owner) return;
+    }
+#endif
+
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+
+//=============================================================================
+} // namespace surface_mesh
+//=============================================================================
@@ -11,6 +11,17 @@
 #include <string>
 #include <algorithm>
 #include <typeinfo>
+#include <mutex>
+#include <unordered_map>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 
 //== NAMESPACE ================================================================
@@ -22,6 +33,503 @@ namespace surface_mesh {
 //== CLASS DEFINITION =========================================================
 
 
+/// storage of at least \c bytes, aligned to 64 bytes for SIMD loads; with
+/// SURFACE_MESH_HUGE_PAGES or SURFACE_MESH_FIRST_TOUCH blocks of 2 MB and more
+/// are aligned to 2 MB and backed by huge pages where the system offers
+/// them, so one-ring gathers over large arrays stay within few TLB entries.
+/// With SURFACE_MESH_FIRST_TOUCH the pages of such blocks are written first
+/// by the threads of a static parallel loop, which places each part of an
+/// array on the NUMA node of the thread that later works on it. With
+/// SURFACE_MESH_MAPPED_STORAGE a pending Adopted_storage is handed out
+/// instead, as it is. Throws std::bad_alloc.
+void* allocate_property_storage(size_t bytes);
+void free_property_storage(void* p);
+
+
+#ifdef SURFACE_MESH_MAPPED_STORAGE
+
+/// Storage a property array takes over as its elements without copying or
+/// writing them, e.g. a part of a copy-on-write mapping of a file, see
+/// Property_array::adopt(). \c owner keeps it alive and is released with
+/// the last array on it, when those arrays are freed or reallocated.
+struct Adopted_storage
+{
+    void*                 data;
+    size_t                bytes;
+    std::shared_ptr<void> owner;
+    bool                  taken;  ///< the allocation was handed out
+
+    /// the storage allocate_property_storage() hands to the next request
+    /// of exactly \c bytes on this thread, null for none
+    static Adopted_storage*& pending();
+};
+
+#endif
+
+
+/// std::allocator replacement with the storage above, the element storage of
+/// property arrays if SURFACE_MESH_HUGE_PAGES, SURFACE_MESH_FIRST_TOUCH or
+/// SURFACE_MESH_MAPPED_STORAGE is defined
+template <class T>
+class Property_allocator
+{
+public:
+
+    typedef T value_type;
+
+    Property_allocator() {}
+    template <class U> Property_allocator(const Property_allocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(allocate_property_storage(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        free_property_storage(p);
+    }
+
+#ifdef SURFACE_MESH_MAPPED_STORAGE
+    /// the elements of adopted storage are already there
+    template <class U, class... Args> void construct(U* p, Args&&... args)
+    {
+        const Adopted_storage* adopted = Adopted_storage::pending();
+        if (adopted && adopted->taken) return;
+        ::new((void*) p) U(std::forward<Args>(args)...);
+    }
+#endif
+
+    template <class U> struct rebind { typedef Property_allocator<U> other; };
+
+    bool operator==(const Property_allocator&) const { return true; }
+    bool operator!=(const Property_allocator&) const { return false; }
+};
+
+
+/// the element storage of a property array
+#if defined(SURFACE_MESH_HUGE_PAGES) || defined(SURFACE_MESH_FIRST_TOUCH) || \
+    defined(SURFACE_MESH_MAPPED_STORAGE)
+template <class T> using Property_vector = std::vector<T, Property_allocator<T> >;
+#else
+template <class T> using Property_vector = std::vector<T>;
+#endif
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// number of set bits of \c w
+inline unsigned int bit_count(uint64_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int) __builtin_popcountll(w);
+#else
+    w = w - ((w >> 1) & 0x5555555555555555ull);
+    w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+    w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (unsigned int) ((w * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/// index of the lowest set bit of \c w, which must not be 0
+inline unsigned int lowest_bit(uint64_t w)
+{
+    assert(w != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int) __builtin_ctzll(w);
+#else
+    unsigned int i = 0;
+    while (!(w & 1)) { w >>= 1; ++i; }
+    return i;
+#endif
+}
+
+
+/// The storage of bool properties: their bits packed into 64-bit words, with
+/// the interface of std::vector<bool> that the property arrays use. Unlike
+/// std::vector<bool> the words are accessible, so flags and selections are
+/// counted by popcount and scanned by skipping words without set, or unset,
+/// bits instead of testing every element. The bits past size() are always
+/// 0.
+class Bit_vector
+{
+public:
+
+    typedef bool                    value_type;
+    typedef bool                    const_reference;
+    typedef Property_vector<uint64_t> word_vector;
+
+    /// proxy of a single bit
+    class reference
+    {
+    public:
+        reference(uint64_t& word, uint64_t mask) : word_(word), mask_(mask) {}
+
+        operator bool() const { return (word_ & mask_) != 0; }
+
+        reference& operator=(bool b)
+        {
+            if (b) word_ |= mask_; else word_ &= ~mask_;
+            return *this;
+        }
+
+        reference& operator=(const reference& r) { return *this = bool(r); }
+
+    private:
+        uint64_t& word_;
+        uint64_t  mask_;
+    };
+
+    Bit_vector() : size_(0) {}
+    Bit_vector(size_t n, bool b) : words_(n_words(n), b ? ~uint64_t(0) : 0), size_(n) { clear_tail(); }
+
+    size_t size() const     { return size_; }
+    bool   empty() const    { return size_ == 0; }
+    size_t capacity() const { return words_.capacity() * 64; }
+
+    void reserve(size_t n) { words_.reserve(n_words(n)); }
+
+    void resize(size_t n, bool b = false)
+    {
+        const size_t old = size_;
+        words_.resize(n_words(n), b ? ~uint64_t(0) : 0);
+        if (b && n > old && (old & 63))
+            words_[old >> 6] |= ~uint64_t(0) << (old & 63);
+        size_ = n;
+        clear_tail();
+    }
+
+    void assign(size_t n, bool b)
+    {
+        words_.assign(n_words(n), b ? ~uint64_t(0) : 0);
+        size_ = n;
+        clear_tail();
+    }
+
+    void push_back(bool b)
+    {
+        if (!(size_ & 63)) words_.push_back(0);
+        if (b) words_.back() |= uint64_t(1) << (size_ & 63);
+        ++size_;
+    }
+
+    void clear() { words_.clear(); size_ = 0; }
+
+    void swap(Bit_vector& rhs)
+    {
+        words_.swap(rhs.words_);
+        std::swap(size_, rhs.size_);
+    }
+
+    reference operator[](size_t i)
+    {
+        assert(i < size_);
+        return reference(words_[i >> 6], uint64_t(1) << (i & 63));
+    }
+
+    bool operator[](size_t i) const
+    {
+        assert(i < size_);
+        return (words_[i >> 6] >> (i & 63)) & 1;
+    }
+
+
+    /// the words, bit i in bit i % 64 of word i / 64
+    const uint64_t* words() const { return words_.data(); }
+    uint64_t* words() { return words_.data(); }
+
+    /// the number of words of n bits
+    static size_t n_words(size_t n) { return (n + 63) >> 6; }
+
+    /// the number of set bits
+    size_t count() const
+    {
+        size_t n = 0;
+        for (size_t w = 0; w < words_.size(); ++w)
+            n += bit_count(words_[w]);
+        return n;
+    }
+
+    /// the first set bit at or after \c i, size() if there is none
+    size_t find_next(size_t i) const
+    {
+        if (i >= size_) return size_;
+        size_t   w    = i >> 6;
+        uint64_t word = words_[w] & (~uint64_t(0) << (i & 63));
+        while (!word)
+        {
+            if (++w == words_.size()) return size_;
+            word = words_[w];
+        }
+        return (w << 6) + lowest_bit(word);
+    }
+
+    /// the first unset bit at or after \c i, size() if there is none
+    size_t find_next_unset(size_t i) const
+    {
+        if (i >= size_) return size_;
+        size_t   w    = i >> 6;
+        uint64_t word = ~words_[w] & (~uint64_t(0) << (i & 63));
+        while (!word)
+        {
+            if (++w == words_.size()) return size_;
+            word = ~words_[w];
+        }
+        return std::min(size_, (w << 6) + lowest_bit(word));
+    }
+
+    /// call \c f with the index of every set bit, in increasing order
+    template <class F> void for_each_set(F f) const
+    {
+        for (size_t w = 0; w < words_.size(); ++w)
+            for (uint64_t word = words_[w]; word; word &= word - 1)
+                f((w << 6) + lowest_bit(word));
+    }
+
+    /// copy the bits [begin, end) of \c src, of the same size. Whole words
+    /// are copied at once, so threads may copy ranges that start at
+    /// multiples of 64 and end at such or at size() in parallel.
+    void copy(const Bit_vector& src, size_t begin, size_t end)
+    {
+        assert(src.size_ == size_ && end <= size_);
+        for (; begin < end && (begin & 63); ++begin)
+            (*this)[begin] = src[begin];
+        const size_t w_end = (end == size_) ? words_.size() : (end >> 6);
+        if (begin < end && (begin >> 6) < w_end)
+        {
+            std::memcpy(&words_[begin >> 6], &src.words_[begin >> 6],
+                        (w_end - (begin >> 6)) * sizeof(uint64_t));
+            begin = std::min(end, w_end << 6);
+        }
+        for (; begin < end; ++begin)
+            (*this)[begin] = src[begin];
+    }
+
+private:
+
+    void clear_tail()
+    {
+        if (size_ & 63) words_.back() &= (uint64_t(1) << (size_ & 63)) - 1;
+    }
+
+private:
+    word_vector words_;
+    size_t      size_;
+};
+
+
+/// Wrapper of the element type of properties that few elements carry, e.g.
+/// add_vertex_property< Sparse<Vec3f> >("v:feature"). Their arrays keep the
+/// elements that were assigned in a hash map, the others read as the
+/// default value, see Sparse_vector.
+template <class T>
+struct Sparse
+{
+    Sparse(const T& t = T()) : value(t) {}
+    T value;
+};
+
+
+/// The storage of Sparse<T> properties: the size and default value of an
+/// array and the elements assigned to, hashed by index. Memory and the cost
+/// of resizing follow the number of assigned elements, not size(); each
+/// access is a hash lookup. Writes are not thread-safe, the arrays are not
+/// copied in blocks and the file writers skip them.
+template <class T>
+class Sparse_vector
+{
+public:
+
+    typedef Sparse<T>                     value_type;
+    typedef const T&                      const_reference;
+    typedef std::unordered_map<size_t, T> map_type;
+
+    /// proxy of an element, assigning a value stores it
+    class reference
+    {
+    public:
+        reference(Sparse_vector& v, size_t i) : v_(v), i_(i) {}
+
+        operator const T&() const { return static_cast<const Sparse_vector&>(v_)[i_]; }
+
+        reference& operator=(const T& t)          { v_.values_[i_] = t; return *this; }
+        reference& operator=(const value_type& t) { return *this = t.value; }
+
+        // copies whether the element is stored, so that swaps and
+        // permutations keep the array sparse
+        reference& operator=(const reference& r)
+        {
+            typename map_type::const_iterator it = r.v_.values_.find(r.i_);
+            if (it == r.v_.values_.end()) v_.values_.erase(i_);
+            else { const T t = it->second; v_.values_[i_] = t; }
+            return *this;
+        }
+
+    private:
+        Sparse_vector& v_;
+        size_t         i_;
+    };
+
+    Sparse_vector() : size_(0) {}
+    Sparse_vector(size_t n, const value_type& t) : size_(n), default_(t.value) {}
+
+    size_t size() const     { return size_; }
+    bool   empty() const    { return size_ == 0; }
+    size_t capacity() const { return size_; }
+
+    void reserve(size_t) {}
+
+    void resize(size_t n, const value_type& t = value_type())
+    {
+        default_ = t.value;
+        if (n < size_)
+        {
+            for (typename map_type::iterator it = values_.begin(); it != values_.end(); )
+                if (it->first >= n) it = values_.erase(it); else ++it;
+        }
+        size_ = n;
+    }
+
+    void push_back(const value_type& t)
+    {
+        default_ = t.value;
+        ++size_;
+    }
+
+    void clear() { values_.clear(); size_ = 0; }
+
+    void swap(Sparse_vector& rhs)
+    {
+        values_.swap(rhs.values_);
+        std::swap(size_, rhs.size_);
+        std::swap(default_, rhs.default_);
+    }
+
+    reference operator[](size_t i)
+    {
+        assert(i < size_);
+        return reference(*this, i);
+    }
+
+    const T& operator[](size_t i) const
+    {
+        assert(i < size_);
+        typename map_type::const_iterator it = values_.find(i);
+        return it == values_.end() ? default_ : it->second;
+    }
+
+    /// exchange the elements \c i0 and \c i1, also whether they are stored
+    void swap_elements(size_t i0, size_t i1)
+    {
+        typename map_type::iterator a = values_.find(i0), b = values_.find(i1);
+        if (a != values_.end() && b != values_.end()) std::swap(a->second, b->second);
+        else if (a != values_.end()) { const T t = a->second; values_.erase(a); values_[i1] = t; }
+        else if (b != values_.end()) { const T t = b->second; values_.erase(b); values_[i0] = t; }
+    }
+
+    /// is element \c i stored, i.e. assigned and not erased?
+    bool contains(size_t i) const { return values_.count(i) != 0; }
+
+    /// reset element \c i to the default value
+    void erase(size_t i) { values_.erase(i); }
+
+    /// the number of stored elements
+    size_t n_stored() const { return values_.size(); }
+
+    /// the stored elements by index, in no particular order
+    const map_type& values() const { return values_; }
+
+    const T& default_value() const { return default_; }
+
+private:
+    map_type values_;
+    size_t   size_;
+    T        default_;
+};
+
+
+/// the element storage of Property_array<T>: a Property_vector of the
+/// elements, a Bit_vector for bool and a Sparse_vector for Sparse<T>.
+/// \c contiguous tells whether the elements are a plain array.
+template <class T>
+struct Property_storage
+{
+    typedef Property_vector<T> type;
+    static const bool contiguous = true;
+};
+
+template <>
+struct Property_storage<bool>
+{
+    typedef Bit_vector type;
+    static const bool contiguous = false;
+};
+
+template <class T>
+struct Property_storage< Sparse<T> >
+{
+    typedef Sparse_vector<T> type;
+    static const bool contiguous = false;
+};
+
+
+/// exchange the elements \c i0 and \c i1 of \c v
+template <class V>
+void swap_elements(V& v, size_t i0, size_t i1)
+{
+    const typename V::value_type d(v[i0]);
+    v[i0] = v[i1];
+    v[i1] = d;
+}
+
+template <class T>
+void swap_elements(Sparse_vector<T>& v, size_t i0, size_t i1)
+{
+    v.swap_elements(i0, i1);
+}
+
+
+/// bytes \c used by the elements of \c v and \c reserved by its capacity
+template <class T, class A>
+void storage_memory(const std::vector<T, A>& v, size_t& used, size_t& reserved)
+{
+    used     = v.size() * sizeof(T);
+    reserved = v.capacity() * sizeof(T);
+}
+
+inline void storage_memory(const Bit_vector& v, size_t& used, size_t& reserved)
+{
+    used     = Bit_vector::n_words(v.size()) * sizeof(uint64_t);
+    reserved = v.capacity() / 8;
+}
+
+/// the node size of the hash map is estimated
+template <class T>
+void storage_memory(const Sparse_vector<T>& v, size_t& used, size_t& reserved)
+{
+    used     = v.n_stored() * (sizeof(typename Sparse_vector<T>::map_type::value_type) + 2 * sizeof(void*));
+    reserved = used + v.values().bucket_count() * sizeof(void*);
+}
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// memory of one property array in bytes: \c used by its elements and
+/// \c reserved by its capacity. Elements that own heap memory themselves are
+/// counted with their sizeof only.
+struct Property_memory
+{
+    std::string  name;
+    size_t       used;
+    size_t       reserved;
+};
+
+
+//== CLASS DEFINITION =========================================================
+
+
 class Base_property_array
 {
 public:
@@ -47,12 +555,31 @@ public:
     /// Let two elements swap their storage place.
     virtual void swap(size_t i0, size_t i1) = 0;
 
+    /// Reorder the elements, element i becomes the old element order[i].
+    virtual void permute(const std::vector<int>& order) = 0;
+
     /// Return a deep copy of self.
     virtual Base_property_array* clone () const = 0;
 
+    /// Return a copy of self whose elements are only allocated if they are
+    /// block_copyable(), to be filled by copy_block(); a deep copy otherwise.
+    virtual Base_property_array* clone_storage() const = 0;
+
+    /// Can the elements be copied by copy_block()?
+    virtual bool block_copyable() const = 0;
+
+    /// Copy the elements [begin, end) of \c src, an array of the same type.
+    virtual void copy_block(const Base_property_array& src, size_t begin, size_t end) = 0;
+
+    /// Return the number of elements.
+    virtual size_t size() const = 0;
+
     /// Return the type_info of the property
     virtual const std::type_info& type() = 0;
 
+    /// Return the bytes used by the elements and reserved by the capacity
+    virtual Property_memory memory() const = 0;
+
     /// Return the name of the property
     const std::string& name() const { return name_; }
 
@@ -67,13 +594,15 @@ protected:
 //== CLASS DEFINITION =========================================================
 
 
+// final, so that calls through a typed Property_array<T>* do not go
+// through the vtable, see Property_container::push_back_after()
 template <class T>
-class Property_array : public Base_property_array
+class Property_array final : public Base_property_array
 {
 public:
 
     typedef T                                       value_type;
-    typedef std::vector<value_type>                 vector_type;
+    typedef typename Property_storage<T>::type      vector_type;
     typedef typename vector_type::reference         reference;
     typedef typename vector_type::const_reference   const_reference;
 
@@ -104,9 +633,15 @@ public: // virtual interface of Base_property_array
 
     virtual void swap(size_t i0, size_t i1)
     {
-        T d(data_[i0]);
-        data_[i0]=data_[i1];
-        data_[i1]=d;
+        swap_elements(data_, i0, i1);
+    }
+
+    virtual void permute(const std::vector<int>& order)
+    {
+        vector_type p(order.size(), value_);
+        for (size_t i=0; i<order.size(); ++i)
+            p[i] = data_[order[i]];
+        data_.swap(p);
     }
 
     virtual Base_property_array* clone() const
@@ -116,12 +651,63 @@ public: // virtual interface of Base_property_array
         return p;
     }
 
+    virtual Base_property_array* clone_storage() const
+    {
+        if (!block_copyable()) return clone();
+        Property_array<T>* p = new Property_array<T>(name_, value_);
+        p->data_.resize(data_.size());
+        return p;
+    }
+
+    // bools are copied in whole words, blocks start at multiples of 64
+    virtual bool block_copyable() const
+    {
+        return plain_array::value || std::is_same<T, bool>::value;
+    }
+
+    virtual void copy_block(const Base_property_array& src, size_t begin, size_t end)
+    {
+        copy_elements(static_cast<const Property_array<T>&>(src), begin, end, plain_array());
+    }
+
+    virtual size_t size() const { return data_.size(); }
+
     virtual const std::type_info& type() { return typeid(T); }
 
 
 public:
 
-    /// Get pointer to array (does not work for T==bool)
+#ifdef SURFACE_MESH_MAPPED_STORAGE
+    /// make the \c n elements at \c p the elements of the array, as they
+    /// are, with the capacity n: the array writes to them in place and
+    /// copies them into storage of its own when it grows or shrinks. \c p
+    /// must be aligned for T and stay valid as long as \c owner. False, and
+    /// the array is left empty, for elements that are not a plain array of
+    /// trivially copyable T, e.g. bool.
+    bool adopt(void* p, size_t n, const std::shared_ptr<void>& owner)
+    {
+        vector_type().swap(data_);
+        if (!plain_array::value || n == 0) return n == 0;
+        Adopted_storage adopted = { p, n * sizeof(T), owner, false };
+        Adopted_storage::pending() = &adopted;
+        data_.resize(n, value_);
+        Adopted_storage::pending() = NULL;
+        if (!adopted.taken) vector_type().swap(data_);
+        return adopted.taken;
+    }
+#endif
+
+    virtual Property_memory memory() const
+    {
+        Property_memory m = { name_, 0, 0 };
+        storage_memory(data_, m.used, m.reserved);
+        return m;
+    }
+
+
+public:
+
+    /// Get pointer to array (not for bool and Sparse<T>)
     const T* data() const
     {
         return &data_[0];
@@ -129,7 +715,7 @@ public:
 
 
     /// Get reference to the underlying vector
-    std::vector<T>& vector()
+    vector_type& vector()
     {
         return data_;
     }
@@ -151,6 +737,19 @@ public:
 
 
 
+private:
+    typedef std::integral_constant<bool, Property_storage<T>::contiguous &&
+                                         std::is_trivially_copyable<T>::value> plain_array;
+
+    void copy_elements(const Property_array<T>& src, size_t begin, size_t end, std::true_type)
+    {
+        if (begin < end)
+            std::memcpy(&data_[begin], &src.data_[begin], (end - begin) * sizeof(T));
+    }
+
+    void copy_elements(const Property_array<T>&, size_t, size_t, std::false_type) {}
+
+
 private:
     vector_type data_;
     value_type  value_;
@@ -167,6 +766,15 @@ Property_array<bool>::data() const
 }
 
 
+// specialization for bool properties, their words are copied
+template <>
+inline void
+Property_array<bool>::copy_block(const Base_property_array& src, size_t begin, size_t end)
+{
+    data_.copy(static_cast<const Property_array<bool>&>(src).data_, begin, end);
+}
+
+
 
 //== CLASS DEFINITION =========================================================
 
@@ -216,7 +824,22 @@ public:
     }
 
 
-    std::vector<T>& vector()
+    typename Property_array<T>::vector_type& vector()
+    {
+        assert(parray_ != NULL);
+        return parray_->vector();
+    }
+
+#ifdef SURFACE_MESH_MAPPED_STORAGE
+    /// see Property_array::adopt()
+    bool adopt(void* p, size_t n, const std::shared_ptr<void>& owner)
+    {
+        assert(parray_ != NULL);
+        return parray_->adopt(p, n, owner);
+    }
+#endif
+
+    const typename Property_array<T>::vector_type& vector() const
     {
         assert(parray_ != NULL);
         return parray_->vector();
@@ -244,6 +867,49 @@ private:
 
 
 
+//== CLASS DEFINITION =========================================================
+
+
+/// A property name interned into a process wide table. Property containers
+/// also index their arrays by key id, so a lookup through a Property_key is
+/// a vector access without string compares or temporaries. Keys are meant to
+/// live in static storage next to the code using them, e.g.
+/// \code static const Property_key weight_key("v:weight"); \endcode
+class Property_key
+{
+public:
+
+    explicit Property_key(const std::string& name) : name_(name), id_(intern(name, true)) {}
+
+    /// the property name
+    const std::string& name() const { return name_; }
+
+    /// the interned id
+    int id() const { return id_; }
+
+    /// id of \c name. unknown names get a new id if \c insert is set,
+    /// otherwise -1 is returned since no container can have them.
+    static int intern(const std::string& name, bool insert)
+    {
+        static std::mutex                            mutex;
+        static std::unordered_map<std::string, int>  ids;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<std::string, int>::const_iterator it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        if (!insert) return -1;
+        const int id = (int) ids.size();
+        ids[name] = id;
+        return id;
+    }
+
+private:
+    std::string name_;
+    int         id_;
+};
+
+
+
 //== CLASS DEFINITION =========================================================
 
 
@@ -252,7 +918,7 @@ class Property_container
 public:
 
     // default constructor
-    Property_container() : size_(0) {}
+    Property_container() : size_(0), capacity_(0) {}
 
     // destructor (deletes all property arrays)
     virtual ~Property_container() { clear(); }
@@ -263,15 +929,68 @@ public:
     // assignment: performs deep copy of property arrays
     Property_container& operator=(const Property_container& _rhs)
     {
-        if (this != &_rhs)
+        Property_container* dst = this;
+        const Property_container* src = &_rhs;
+        copy(&dst, &src, 1);
+        return *this;
+    }
+
+    // deep copy of the containers src[i] to dst[i], e.g. the four of a mesh
+    // at once: the arrays are allocated in parallel, then the elements of
+    // all block copyable arrays are copied in parallel blocks, so a single
+    // large array, like the halfedge connectivity, is not copied by one
+    // thread
+    static void copy(Property_container* const* dst, const Property_container* const* src, int n)
+    {
+        std::vector<Base_property_array**> targets;
+        std::vector<const Base_property_array*> sources;
+        for (int c=0; c<n; ++c)
         {
-            clear();
-            parrays_.resize(_rhs.n_properties());
-            size_ = _rhs.size();
-            for (unsigned int i=0; i<parrays_.size(); ++i)
-                parrays_[i] = _rhs.parrays_[i]->clone();
+            if (dst[c] == src[c]) continue;
+            dst[c]->clear();
+            dst[c]->parrays_.resize(src[c]->n_properties());
+            dst[c]->size_ = dst[c]->capacity_ = src[c]->size();
+            dst[c]->slots_ = src[c]->slots_;
+            for (unsigned int i=0; i<dst[c]->parrays_.size(); ++i)
+            {
+                targets.push_back(&dst[c]->parrays_[i]);
+                sources.push_back(src[c]->parrays_[i]);
+            }
+        }
+
+        const int n_arrays = targets.size();
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int i=0; i<n_arrays; ++i)
+            *targets[i] = sources[i]->clone_storage();
+
+        // blocks of 64K elements, numbered across all arrays
+        const size_t block = size_t(1) << 16;
+        std::vector<size_t> first_block(n_arrays + 1, 0);
+        for (int i=0; i<n_arrays; ++i)
+        {
+            const size_t blocks = sources[i]->block_copyable()
+                                      ? (sources[i]->size() + block - 1) / block : 0;
+            first_block[i + 1] = first_block[i] + blocks;
+        }
+        const long n_blocks = long(first_block[n_arrays]);
+#pragma omp parallel for schedule(static)
+        for (long b=0; b<n_blocks; ++b)
+        {
+            const int i = int(std::upper_bound(first_block.begin(), first_block.end(),
+                                               size_t(b)) - first_block.begin()) - 1;
+            const size_t begin = (size_t(b) - first_block[i]) * block;
+            const size_t end = std::min(begin + block, sources[i]->size());
+            (*targets[i])->copy_block(*sources[i], begin, end);
         }
-        return *this;
+    }
+
+    // exchange the arrays with \c _rhs, handles to them stay valid
+    void swap(Property_container& _rhs)
+    {
+        parrays_.swap(_rhs.parrays_);
+        slots_.swap(_rhs.slots_);
+        std::swap(size_, _rhs.size_);
+        std::swap(capacity_, _rhs.capacity_);
     }
 
     // returns the current size of the property arrays
@@ -290,29 +1009,42 @@ public:
     }
 
 
+    // returns the memory of all property arrays
+    std::vector<Property_memory> memory() const
+    {
+        std::vector<Property_memory> stats;
+        for (unsigned int i=0; i<parrays_.size(); ++i)
+            stats.push_back(parrays_[i]->memory());
+        return stats;
+    }
+
+
     // add a property with name \c name and default value \c t
     template <class T> Property<T> add(const std::string& name, const T t=T())
     {
+        const int id = Property_key::intern(name, true);
+
         // if a property with this name already exists, return an invalid property
-        for (unsigned int i=0; i<parrays_.size(); ++i)
+        if (find(id) != -1)
         {
-            if (parrays_[i]->name() == name)
-            {
-                std::cerr << "[Property_container] A property with name \""
-                          << name << "\" already exists. Returning invalid property.\n";
-                return Property<T>();
-            }
+            std::cerr << "[Property_container] A property with name \""
+                      << name << "\" already exists. Returning invalid property.\n";
+            return Property<T>();
         }
 
         // otherwise add the property
         Property_array<T>* p = new Property_array<T>(name, t);
+        p->reserve(capacity_);
         p->resize(size_);
+        if (slots_.size() <= size_t(id)) slots_.resize(id+1, -1);
+        slots_[id] = (int) parrays_.size();
         parrays_.push_back(p);
         return Property<T>(p);
     }
 
 
     // get a property by its name. returns invalid property if it does not exist.
+    // a scan is cheaper than the interning for the few properties of a mesh.
     template <class T> Property<T> get(const std::string& name) const
     {
         for (unsigned int i=0; i<parrays_.size(); ++i)
@@ -321,6 +1053,12 @@ public:
         return Property<T>();
     }
 
+    // get a property by its key, without string lookup
+    template <class T> Property<T> get(const Property_key& key) const
+    {
+        return get<T>(key.id());
+    }
+
 
     // returns a property if it exists, otherwise it creates it first.
     template <class T> Property<T> get_or_add(const std::string& name, const T t=T())
@@ -330,6 +1068,14 @@ public:
         return p;
     }
 
+    // returns a property if it exists, otherwise it creates it first.
+    template <class T> Property<T> get_or_add(const Property_key& key, const T t=T())
+    {
+        Property<T> p = get<T>(key.id());
+        if (!p) p = add<T>(key.name(), t);
+        return p;
+    }
+
 
     // get the type of property by its name. returns typeid(void) if it does not exist.
     const std::type_info& get_type(const std::string& name)
@@ -352,6 +1098,7 @@ public:
                 delete *it;
                 parrays_.erase(it);
                 h.reset();
+                reindex();
                 break;
             }
         }
@@ -364,7 +1111,8 @@ public:
         for (unsigned int i=0; i<parrays_.size(); ++i)
             delete parrays_[i];
         parrays_.clear();
-        size_ = 0;
+        slots_.clear();
+        size_ = capacity_ = 0;
     }
 
 
@@ -373,31 +1121,61 @@ public:
     {
         for (unsigned int i=0; i<parrays_.size(); ++i)
             parrays_[i]->reserve(n);
+        capacity_ = std::max(capacity_, n);
     }
 
     // resize all arrays to size n
     void resize(size_t n)
     {
+        if (n > capacity_) reserve(n);
         for (unsigned int i=0; i<parrays_.size(); ++i)
             parrays_[i]->resize(n);
         size_ = n;
     }
 
+    // add n new elements to each vector at once, the capacity grows as in
+    // push_back() so that repeated calls stay linear
+    void grow(size_t n)
+    {
+        if (size_ + n > capacity_) reserve(std::max(size_ + n, 2 * size_));
+        resize(size_ + n);
+    }
+
     // free unused space in all arrays
     void free_memory() const
     {
         for (unsigned int i=0; i<parrays_.size(); ++i)
             parrays_[i]->free_memory();
+        capacity_ = size_;
     }
 
-    // add a new element to each vector
+    // add a new element to each vector. the arrays grow together, all of
+    // them are reallocated to twice the size in the same call instead of
+    // each at its own capacity
     void push_back()
     {
+        if (size_ == capacity_) reserve(std::max(size_t(16), 2 * size_));
         for (unsigned int i=0; i<parrays_.size(); ++i)
             parrays_[i]->push_back();
         ++size_;
     }
 
+    // push_back() of all but the first n arrays, which the caller appends
+    // itself right after through their typed handles. Surface_mesh adds its
+    // connectivity, point and deleted arrays first, so it grows them without
+    // a virtual call per element; only the properties added later pay one
+    void push_back_after(size_t n)
+    {
+        assert(n <= parrays_.size());
+        if (size_ == capacity_) reserve(std::max(size_t(16), 2 * size_));
+        for (size_t i=n; i<parrays_.size(); ++i)
+            parrays_[i]->push_back();
+        ++size_;
+    }
+
+    // the i-th array, in the order the properties were added
+    const Base_property_array* array(size_t i) const { return parrays_[i]; }
+
     // swap elements i0 and i1 in all arrays
     void swap(size_t i0, size_t i1) const
     {
@@ -405,10 +1183,47 @@ public:
             parrays_[i]->swap(i0, i1);
     }
 
+    // reorder all arrays, element i becomes the old element order[i] and
+    // the arrays get the size of order; the arrays are gathered in parallel
+    void permute(const std::vector<int>& order)
+    {
+        const int n = parrays_.size();
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int i=0; i<n; ++i)
+            parrays_[i]->permute(order);
+        size_ = capacity_ = order.size();
+    }
+
+
+private:
+
+    // index of the array with key id \c id, -1 if there is none
+    int find(int id) const
+    {
+        return (id >= 0 && size_t(id) < slots_.size()) ? slots_[id] : -1;
+    }
+
+    template <class T> Property<T> get(int id) const
+    {
+        const int i = find(id);
+        if (i == -1) return Property<T>();
+        return Property<T>(dynamic_cast<Property_array<T>*>(parrays_[i]));
+    }
+
+    // rebuild slots_ after arrays moved
+    void reindex()
+    {
+        std::fill(slots_.begin(), slots_.end(), -1);
+        for (unsigned int i=0; i<parrays_.size(); ++i)
+            slots_[Property_key::intern(parrays_[i]->name(), false)] = i;
+    }
+
 
 private:
     std::vector<Base_property_array*>  parrays_;
+    std::vector<int>                   slots_;  // key id -> index in parrays_
     size_t  size_;
+    mutable size_t  capacity_;  // reserved in all arrays
 };
 
 
@@ -8,6 +8,8 @@
 
 
 #include <surface_mesh/Vector.h>
+#include <surface_mesh/Half.h>
+#include <stdint.h>
 
 
 //=============================================================================
@@ -34,9 +36,20 @@ typedef Vector<Scalar,3> Normal;
 /// Color type
 typedef Vector<Scalar,3> Color;
 
+/// 8 bit RGBA color type, a quarter of the size of Color with alpha
+typedef Vector<unsigned char,4> Color8;
+
 /// Texture coordinate type
 typedef Vector<Scalar,3> Texture_coordinate;
 
+/// Index type of the handles and the connectivity: 32 bits unsigned, 64 bits
+/// if SURFACE_MESH_64BIT_INDICES is defined for huge meshes
+#ifdef SURFACE_MESH_64BIT_INDICES
+typedef uint64_t Index_type;
+#else
+typedef uint32_t Index_type;
+#endif
+
 
 //=============================================================================
 } // namespace surface_mesh
@@ -0,0 +1,77 @@
+#include "async_job.h"
+#include <surface_mesh/Threads.h>
+
+namespace mesh_processing {
+
+void PositionSnapshots::publish() {
+    back_ = middle_.exchange(back_ | FRESH) & ~FRESH;
+}
+
+bool PositionSnapshots::take() {
+    if (!(middle_.load() & FRESH)) return false;
+    front_ = middle_.exchange(front_) & ~FRESH;
+    return true;
+}
+
+AsyncJob::~AsyncJob() {
+    cancel_and_wait();
+    if (!worker_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    worker_.join();
+}
+
+bool AsyncJob::start(const Task& task) {
+    if (pending()) return false;
+
+    progress_.reset();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = task;
+        running_ = true;
+    }
+    if (!worker_.joinable()) worker_ = std::thread(&AsyncJob::run, this);
+    wake_.notify_one();
+    return true;
+}
+
+void AsyncJob::run() {
+    surface_mesh::enter_worker_thread();
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        while (!quit_ && !task_) wake_.wait(lock);
+        if (!task_) return;
+        Task task;
+        task.swap(task_);
+        lock.unlock();
+        task(progress_);
+        // its captures go before the owner sees the job end
+        task = Task();
+        lock.lock();
+        // in this order pending() never sees the job idle in between
+        finished_ = true;
+        running_ = false;
+        done_.notify_all();
+    }
+}
+
+bool AsyncJob::poll_finished() {
+    if (!finished_) return false;
+
+    finished_ = false;
+    return true;
+}
+
+void AsyncJob::cancel_and_wait() {
+    if (!pending()) return;
+
+    progress_.cancel();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) done_.wait(lock);
+    finished_ = false;
+}
+
+}
@@ -0,0 +1,138 @@
+#ifndef ASYNC_JOB_H
+#define ASYNC_JOB_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mesh_processing {
+
+// progress, cancellation and time budget shared between a running job and
+// its owner
+class JobProgress {
+
+public:
+    JobProgress() : progress_(0.0f), cancelled_(false), deadline_(0) {}
+
+    // called from the job with a fraction in [0, 1], returns false once
+    // cancellation was requested or the budget ran out and the job should
+    // stop
+    bool report(const float fraction) {
+        progress_ = fraction;
+        return !stopped();
+    }
+
+    float progress() const { return progress_; }
+    bool cancelled() const { return cancelled_; }
+    // the budget of set_time_budget() ran out; unlike a cancelled job, an
+    // expired one keeps what it reached where that is a usable result
+    bool expired() const {
+        const int64_t deadline = deadline_;
+        return deadline != 0 && now() >= deadline;
+    }
+    // cancelled or expired, polled by the iterations of the long operations
+    bool stopped() const { return cancelled_ || expired(); }
+    void cancel() { cancelled_ = true; }
+    // the job expires seconds from now, 0 or less removes the budget
+    void set_time_budget(const double seconds) {
+        deadline_ = seconds > 0.0 ? now() + int64_t(seconds * 1e9) : 0;
+    }
+    void reset() { progress_ = 0.0f; cancelled_ = false; deadline_ = 0; }
+
+private:
+    // steady clock in nanoseconds, never 0 after the start of the system
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::atomic<float> progress_;
+    std::atomic<bool> cancelled_;
+    // of now(), 0 without a budget
+    std::atomic<int64_t> deadline_;
+};
+
+// intermediate positions a running job hands to its owner to show, x y z
+// per vertex. Three buffers: the job fills one, the owner reads another
+// and the third holds the newest complete snapshot. publish() and take()
+// only exchange buffer indices, so neither side waits for the other and
+// the owner never reads a snapshot that is half written.
+class PositionSnapshots {
+
+public:
+    PositionSnapshots() : interval_(0), back_(0), front_(1), middle_(2) {}
+
+    // a snapshot every interval iterations of the explicit smoothers, 0
+    // for none
+    void set_interval(const unsigned int interval) { interval_ = interval; }
+    unsigned int interval() const { return interval_; }
+
+    // the job: fill back(), then publish() it; a snapshot the owner has not
+    // taken yet is replaced
+    std::vector<float>& back() { return buffers_[back_]; }
+    void publish();
+    // the owner: true if a snapshot arrived since the last call, front()
+    // holds it then and stays valid until the next take()
+    bool take();
+    const std::vector<float>& front() const { return buffers_[front_]; }
+
+private:
+    // set in middle_ while its buffer holds a snapshot not taken yet
+    static const int FRESH = 4;
+
+    std::atomic<unsigned int> interval_;
+    std::vector<float> buffers_[3];
+    // back_ belongs to the job, front_ to the owner
+    int back_, front_;
+    std::atomic<int> middle_;
+};
+
+// runs one task at a time on a worker thread, the owner polls for completion.
+// The worker is started by the first task and kept for the next ones, with
+// surface_mesh::enter_worker_thread() applied, so the parallel loops of all
+// tasks share one OpenMP team on the configured CPUs
+class AsyncJob {
+
+public:
+    typedef std::function<void(JobProgress&)> Task;
+
+    AsyncJob() : running_(false), finished_(false), quit_(false) {}
+    ~AsyncJob();
+
+    // returns false if the previous job has not been collected yet
+    bool start(const Task& task);
+    // true exactly once after a job ended, what it wrote is visible then
+    bool poll_finished();
+    // requests cancellation and blocks until the task returned
+    void cancel_and_wait();
+
+    bool running() const { return running_; }
+    // running, or ended and not collected by poll_finished() yet
+    bool pending() const { return running_ || finished_; }
+    void cancel() { progress_.cancel(); }
+    float progress() const { return progress_.progress(); }
+    JobProgress* progress_state() { return &progress_; }
+
+private:
+    void run();
+
+    std::thread worker_;
+    std::mutex mutex_;
+    // wakes the worker for task_ or quit_, and the owner when a task ended
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    Task task_;
+    std::atomic<bool> running_;
+    std::atomic<bool> finished_;
+    bool quit_;
+    JobProgress progress_;
+};
+
+}
+
+#endif // ASYNC_JOB_H
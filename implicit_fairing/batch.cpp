@@ -0,0 +1,1110 @@
+#include "batch.h"
+#include "metrics.h"
+#include "progressive_mesh.h"
+#include <surface_mesh/Allocation_tracker.h>
+#include <surface_mesh/IO_stream.h>
+#include <surface_mesh/Shared_mesh.h>
+#include <surface_mesh/Trace.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace mesh_processing {
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+bool is_batch_command(int argc, char** argv) {
+    return argc > 1 && strcmp(argv[1], "--batch") == 0;
+}
+
+static bool parse_number(const char* text, double& value) {
+    char* end = nullptr;
+    value = strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+static bool parse_count(const char* text, unsigned int& value) {
+    char* end = nullptr;
+    const long n = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || n < 1) return false;
+    value = (unsigned int) n;
+    return true;
+}
+
+bool parse_batch_options(int argc, char** argv, BatchOptions& options, string& error) {
+    for (int i = 2; i < argc; ++i) {
+        const string arg = argv[i];
+        // number of values following arg
+        auto values = [&](const int n) {
+            if (i + n < argc) return true;
+            error = arg + " expects " + std::to_string(n) + " value(s)";
+            return false;
+        };
+        BatchStep step = { BatchStep::MINIMAL_SURFACE, 0.0, 1 };
+        if (arg == "--implicit") {
+            // --implicit DT [N]: N implicit smoothing steps of size DT
+            if (!values(1)) return false;
+            step.type = BatchStep::IMPLICIT_SMOOTHING;
+            if (!parse_number(argv[++i], step.timestep) || step.timestep <= 0.0) {
+                error = "invalid time step " + string(argv[i]);
+                return false;
+            }
+            if (i + 1 < argc && argv[i + 1][0] != '-' &&
+                parse_count(argv[i + 1], step.iterations)) {
+                ++i;
+            }
+            options.steps.push_back(step);
+        } else if (arg == "--implicit-adaptive") {
+            if (!values(1)) return false;
+            step.type = BatchStep::ADAPTIVE_IMPLICIT;
+            if (!parse_number(argv[++i], step.timestep) || step.timestep <= 0.0) {
+                error = "invalid total time " + string(argv[i]);
+                return false;
+            }
+            options.steps.push_back(step);
+        } else if (arg == "--minimal-surface") {
+            options.steps.push_back(step);
+        } else if (arg == "--parameterize") {
+            step.type = BatchStep::PARAMETERIZE;
+            options.steps.push_back(step);
+        } else if (arg == "--uniform-smooth" || arg == "--smooth" || arg == "--feature-smooth" ||
+                   arg == "--multires-smooth" || arg == "--taubin-smooth") {
+            if (!values(1)) return false;
+            step.type = arg == "--smooth" ? BatchStep::SMOOTH
+                      : arg == "--feature-smooth" ? BatchStep::FEATURE_SMOOTH
+                      : arg == "--multires-smooth" ? BatchStep::MULTIRESOLUTION_SMOOTH
+                      : arg == "--taubin-smooth" ? BatchStep::TAUBIN_SMOOTH
+                      : BatchStep::UNIFORM_SMOOTH;
+            if (!parse_count(argv[++i], step.iterations)) {
+                error = "invalid iteration count " + string(argv[i]);
+                return false;
+            }
+            options.steps.push_back(step);
+        } else if (arg == "--weld") {
+            if (!values(1)) return false;
+            step.type = BatchStep::WELD;
+            if (!parse_number(argv[++i], step.timestep) || step.timestep < 0.0) {
+                error = "invalid weld tolerance " + string(argv[i]);
+                return false;
+            }
+            options.steps.push_back(step);
+        } else if (arg == "--decimate") {
+            if (!values(1)) return false;
+            step.type = BatchStep::DECIMATE;
+            if (!parse_count(argv[++i], step.iterations)) {
+                error = "invalid face count " + string(argv[i]);
+                return false;
+            }
+            options.steps.push_back(step);
+        } else if (arg == "--subdivide" || arg == "--subdivide-sqrt3") {
+            if (!values(1)) return false;
+            step.type = arg == "--subdivide" ? BatchStep::SUBDIVIDE : BatchStep::SUBDIVIDE_SQRT3;
+            if (!parse_count(argv[++i], step.iterations)) {
+                error = "invalid level count " + string(argv[i]);
+                return false;
+            }
+            options.steps.push_back(step);
+        } else if (arg == "--remesh") {
+            if (!values(1)) return false;
+            step.type = BatchStep::REMESH;
+            if (!parse_count(argv[++i], step.iterations)) {
+                error = "invalid iteration count " + string(argv[i]);
+                return false;
+            }
+            options.steps.push_back(step);
+        } else if (arg == "--spectral") {
+            if (!values(1)) return false;
+            step.type = BatchStep::SPECTRAL_SMOOTH;
+            if (!parse_count(argv[++i], step.iterations)) {
+                error = "invalid eigenvector count " + string(argv[i]);
+                return false;
+            }
+            options.steps.push_back(step);
+        } else if (arg == "--solver") {
+            if (!values(1)) return false;
+            const string name = argv[++i];
+            if (name == "ldlt") options.solver = MeshProcessing::DIRECT_LDLT;
+            else if (name == "ldlt-float") options.solver = MeshProcessing::DIRECT_LDLT_FLOAT;
+            else if (name == "cholmod") options.solver = MeshProcessing::DIRECT_CHOLMOD;
+            else if (name == "pardiso") options.solver = MeshProcessing::DIRECT_PARDISO;
+            else if (name == "cg") options.solver = MeshProcessing::CG_JACOBI;
+            else if (name == "ichol") options.solver = MeshProcessing::CG_INCOMPLETE_CHOLESKY;
+            else if (name == "multigrid") options.solver = MeshProcessing::CG_MULTIGRID;
+            else if (name == "schwarz") options.solver = MeshProcessing::CG_SCHWARZ;
+            else if (name == "matrix-free") options.solver = MeshProcessing::CG_MATRIX_FREE;
+            else if (name == "cusolver") options.solver = MeshProcessing::DIRECT_CUSOLVER;
+            else if (name == "amgx") options.solver = MeshProcessing::CG_AMGX;
+            else {
+                error = "unknown solver " + name;
+                return false;
+            }
+            if (!MeshProcessing::solver_available(options.solver)) {
+                error = "solver " + name + " was not found at configure time";
+                return false;
+            }
+        } else if (arg == "--ordering") {
+            if (!values(1)) return false;
+            const string name = argv[++i];
+            if (name == "amd") options.ordering = MeshProcessing::ORDERING_AMD;
+            else if (name == "colamd") options.ordering = MeshProcessing::ORDERING_COLAMD;
+            else if (name == "metis") options.ordering = MeshProcessing::ORDERING_METIS;
+            else if (name == "morton") options.ordering = MeshProcessing::ORDERING_MORTON;
+            else if (name == "auto") options.ordering = MeshProcessing::ORDERING_AUTO;
+            else {
+                error = "unknown ordering " + name;
+                return false;
+            }
+            if (!MeshProcessing::ordering_available(options.ordering)) {
+                error = "ordering " + name + " was not found at configure time";
+                return false;
+            }
+        } else if (arg == "--output-dir") {
+            if (!values(1)) return false;
+            options.output_dir = argv[++i];
+        } else if (arg == "--thumbnails") {
+            if (!values(1)) return false;
+            options.thumbnail_dir = argv[++i];
+        } else if (arg == "--thumbnail-size") {
+            if (!values(1)) return false;
+            if (!parse_count(argv[++i], options.thumbnail_size) || options.thumbnail_size == 0 ||
+                options.thumbnail_size > 4096) {
+                error = "invalid thumbnail size " + string(argv[i]);
+                return false;
+            }
+        } else if (arg == "--binary") {
+            options.binary_off = true;
+        } else if (arg == "--progressive") {
+            if (!values(1)) return false;
+            if (!parse_count(argv[++i], options.progressive_faces)) {
+                error = "invalid face count " + string(argv[i]);
+                return false;
+            }
+        } else if (arg == "--columns") {
+            options.columns = true;
+        } else if (arg == "--strict") {
+            options.strict = true;
+        } else if (arg == "--geometry-only") {
+            options.geometry_only = true;
+        } else if (arg == "--info") {
+            options.info = true;
+        } else if (arg == "--template") {
+            options.fixed_topology = true;
+        } else if (arg == "--pipeline") {
+            options.pipeline = true;
+        } else if (arg == "--pipeline-memory") {
+            if (!values(1)) return false;
+            double mb;
+            if (!parse_number(argv[++i], mb) || mb < 0.0) {
+                error = "invalid memory cap " + string(argv[i]);
+                return false;
+            }
+            options.pipeline = true;
+            options.pipeline_memory = size_t(mb * 1024.0 * 1024.0);
+        } else if (arg == "--tolerance") {
+            if (!values(1)) return false;
+            double tolerance;
+            if (!parse_number(argv[++i], tolerance) || tolerance < 0.0) {
+                error = "invalid tolerance " + string(argv[i]);
+                return false;
+            }
+            options.smoothing_tolerance = float(tolerance);
+        } else if (arg == "--chebyshev") {
+            options.chebyshev = true;
+        } else if (arg == "--gauss-seidel") {
+            options.gauss_seidel = true;
+        } else if (arg == "--preserve-volume") {
+            options.preserve_volume = true;
+        } else if (arg == "--max-cotan") {
+            if (!values(1)) return false;
+            double max_cotan;
+            if (!parse_number(argv[++i], max_cotan) || !(max_cotan > 0.0)) {
+                error = "invalid cotangent bound " + string(argv[i]);
+                return false;
+            }
+            options.max_cotan = float(max_cotan);
+        } else if (arg == "--threads-per-mesh") {
+            if (!values(1)) return false;
+            if (!parse_count(argv[++i], options.threads_per_mesh)) {
+                error = "invalid thread count " + string(argv[i]);
+                return false;
+            }
+        } else if (arg == "--threads") {
+            if (!values(1)) return false;
+            if (!parse_count(argv[++i], options.threads)) {
+                error = "invalid thread count " + string(argv[i]);
+                return false;
+            }
+        } else if (arg == "--affinity") {
+            if (!values(1)) return false;
+            const string mode = argv[++i];
+            if (mode == "none") options.affinity = surface_mesh::AFFINITY_NONE;
+            else if (mode == "compact") options.affinity = surface_mesh::AFFINITY_COMPACT;
+            else if (mode == "spread") options.affinity = surface_mesh::AFFINITY_SPREAD;
+            else {
+                error = "invalid affinity " + mode;
+                return false;
+            }
+        } else if (arg == "--time-budget") {
+            if (!values(1)) return false;
+            if (!parse_number(argv[++i], options.time_budget) || options.time_budget < 0.0) {
+                error = "invalid time budget " + string(argv[i]);
+                return false;
+            }
+        } else if (arg == "--share") {
+            if (!values(1)) return false;
+            options.share = argv[++i];
+        } else if (arg == "--memory") {
+            options.memory_report = true;
+        } else if (arg == "--deviation") {
+            options.deviation = true;
+        } else if (arg == "--self-intersections") {
+            options.self_intersections = true;
+        } else if (arg == "--trace") {
+            if (!values(1)) return false;
+            options.trace_file = argv[++i];
+        } else if (arg == "--metrics") {
+            if (!values(1)) return false;
+            options.metrics_file = argv[++i];
+        } else if (arg == "--counters") {
+            options.counters = true;
+        } else if (arg == "--allocations") {
+            if (!surface_mesh::Allocation_tracker::enabled()) {
+                error = "--allocations needs a GP_ALLOCATION_TRACKING build";
+                return false;
+            }
+            options.allocations = true;
+        } else if (arg == "--suffix") {
+            if (!values(1)) return false;
+            options.suffix = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            error = "unknown option " + arg;
+            return false;
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
+    if (options.inputs.empty()) {
+        error = "no input meshes";
+        return false;
+    }
+    if (options.fixed_topology) {
+        for (const BatchStep& step : options.steps) {
+            if (step.type == BatchStep::DECIMATE || step.type == BatchStep::REMESH ||
+                step.type == BatchStep::WELD || step.type == BatchStep::SUBDIVIDE ||
+                step.type == BatchStep::SUBDIVIDE_SQRT3) {
+                error = "--template cannot be combined with --decimate, --remesh, --weld "
+                        "or --subdivide";
+                return false;
+            }
+        }
+    }
+    if (options.fixed_topology && options.pipeline) {
+        error = "--template cannot be combined with --pipeline";
+        return false;
+    }
+    if (options.affinity != surface_mesh::AFFINITY_NONE && !options.fixed_topology &&
+        !options.pipeline) {
+        error = "--affinity expects --pipeline or --template";
+        return false;
+    }
+    if (options.output_dir.empty() && options.suffix.empty()) {
+        error = "an empty --suffix needs --output-dir, inputs would be overwritten";
+        return false;
+    }
+    return true;
+}
+
+string batch_output_path(const BatchOptions& options, const string& input) {
+    const size_t slash = input.find_last_of("/\\");
+    const size_t dot = input.find_last_of('.');
+    const bool has_ext = dot != string::npos && (slash == string::npos || dot > slash);
+    if (!options.output_dir.empty()) {
+        const string name = slash == string::npos ? input : input.substr(slash + 1);
+        const char last = options.output_dir.back();
+        return options.output_dir + (last == '/' || last == '\\' ? "" : "/") + name;
+    }
+    if (!has_ext) return input + options.suffix;
+    return input.substr(0, dot) + options.suffix + input.substr(dot);
+}
+
+string batch_thumbnail_path(const BatchOptions& options, const string& input) {
+    const size_t slash = input.find_last_of("/\\");
+    const size_t dot = input.find_last_of('.');
+    const bool has_ext = dot != string::npos && (slash == string::npos || dot > slash);
+    const size_t begin = slash == string::npos ? 0 : slash + 1;
+    const string name = input.substr(begin, (has_ext ? dot : input.size()) - begin);
+    const char last = options.thumbnail_dir.back();
+    return options.thumbnail_dir + (last == '/' || last == '\\' ? "" : "/") + name + ".png";
+}
+
+// the result path with the extension of a file written next to it
+static string sibling_output_path(const string& output, const char* extension) {
+    const size_t slash = output.find_last_of("/\\");
+    const size_t dot = output.find_last_of('.');
+    const bool has_ext = dot != string::npos && (slash == string::npos || dot > slash);
+    return (has_ext ? output.substr(0, dot) : output) + extension;
+}
+
+// vertices per thread of the loops and solves of one mesh when
+// BatchOptions::threads_per_mesh is automatic
+static const unsigned int VERTICES_PER_THREAD = 50000;
+
+// The threads of a batch, shared by the meshes processed at the same time.
+// A mesh holds one thread while it is read and as many as its size asks for
+// while the steps run, a mesh that asks for more waits until enough are free.
+class ThreadBudget {
+public:
+    explicit ThreadBudget(const int threads) : free_(threads) {}
+    void acquire(const int n) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        released_.wait(lock, [&] { return free_ >= n; });
+        free_ -= n;
+    }
+    void release(const int n) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_ += n;
+        released_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable released_;
+    int free_;
+};
+
+// the threads of one mesh, given back when it is done
+class ThreadShare {
+public:
+    explicit ThreadShare(ThreadBudget& budget) : budget_(budget), held_(1) { budget_.acquire(1); }
+    ~ThreadShare() { budget_.release(held_); }
+    // nothing is held while waiting, two growing meshes cannot block each other
+    void resize(const int n) {
+        budget_.release(held_);
+        held_ = 0;
+        budget_.acquire(n);
+        held_ = n;
+    }
+
+private:
+    ThreadBudget& budget_;
+    int held_;
+};
+
+// counts, bounding box and face sizes of a file, gathered while it is
+// streamed; the mesh itself is never built
+class InfoVisitor : public surface_mesh::Mesh_visitor {
+public:
+    bool on_vertices(const surface_mesh::Point* points, size_t n, unsigned int) override {
+        for (size_t i = 0; i < n; ++i) bounds.add(points[i]);
+        return true;
+    }
+    bool on_faces(const unsigned int*, const unsigned int* valences, size_t n) override {
+        for (size_t i = 0; i < n; ++i) {
+            ++(valences[i] == 3 ? triangles : valences[i] == 4 ? quads : polygons);
+        }
+        return true;
+    }
+    surface_mesh::Vertex_bounds bounds;
+    size_t triangles = 0, quads = 0, polygons = 0;
+};
+
+static bool print_info(const string& input) {
+    InfoVisitor info;
+    if (!surface_mesh::read_mesh_stream(input, info)) {
+        cerr << input << ": cannot read" << endl;
+        return false;
+    }
+    const surface_mesh::Point& a = info.bounds.min;
+    const surface_mesh::Point& b = info.bounds.max;
+    char text[512];
+    snprintf(text, sizeof(text), "%s: %u vertices, %zu faces (%zu triangles, %zu quads, "
+             "%zu other), box [%g %g %g] - [%g %g %g]", input.c_str(), info.bounds.n,
+             info.triangles + info.quads + info.polygons, info.triangles, info.quads,
+             info.polygons, a[0], a[1], a[2], b[0], b[1], b[2]);
+#pragma omp critical
+    cout << text << endl;
+    return true;
+}
+
+// the surface_mesh::Read_attributes the inputs are read with
+static unsigned int read_attributes(const BatchOptions& options) {
+    return options.geometry_only ? surface_mesh::READ_GEOMETRY : surface_mesh::READ_ALL;
+}
+
+static void configure(MeshProcessing& mesh, const BatchOptions& options) {
+    // the steps are destructive, a batch has no use for undo
+    mesh.set_history_budget(0);
+    mesh.set_solver(options.solver);
+    mesh.set_fill_ordering(options.ordering);
+    mesh.set_smoothing_tolerance(options.smoothing_tolerance);
+    mesh.set_chebyshev_smoothing(options.chebyshev);
+    mesh.set_gauss_seidel_smoothing(options.gauss_seidel);
+    mesh.set_volume_preservation(options.preserve_volume);
+    mesh.set_max_cotan(options.max_cotan);
+}
+
+// --share: the segment the meshes are published to, one at a time; a
+// different mesh than the last one is new connectivity for the readers
+class MeshPublisher {
+public:
+    explicit MeshPublisher(const string& name) {
+        if (!name.empty() && !writer_.open(name)) cerr << name << ": cannot share" << endl;
+    }
+    void publish(MeshProcessing& mesh, const bool topology_changed) {
+        if (!writer_.is_open()) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        writer_.publish(mesh.get_mesh(), topology_changed || &mesh != last_);
+        last_ = &mesh;
+    }
+
+private:
+    surface_mesh::Shared_mesh_writer writer_;
+    std::mutex mutex_;
+    const MeshProcessing* last_ = nullptr;
+};
+
+// the option that adds a step, for messages
+static const char* step_option(const BatchStep::TYPE type) {
+    switch (type) {
+    case BatchStep::IMPLICIT_SMOOTHING: return "--implicit";
+    case BatchStep::ADAPTIVE_IMPLICIT: return "--implicit-adaptive";
+    case BatchStep::MINIMAL_SURFACE: return "--minimal-surface";
+    case BatchStep::PARAMETERIZE: return "--parameterize";
+    case BatchStep::UNIFORM_SMOOTH: return "--uniform-smooth";
+    case BatchStep::SMOOTH: return "--smooth";
+    case BatchStep::FEATURE_SMOOTH: return "--feature-smooth";
+    case BatchStep::MULTIRESOLUTION_SMOOTH: return "--multires-smooth";
+    case BatchStep::TAUBIN_SMOOTH: return "--taubin-smooth";
+    case BatchStep::DECIMATE: return "--decimate";
+    case BatchStep::WELD: return "--weld";
+    case BatchStep::REMESH: return "--remesh";
+    case BatchStep::SUBDIVIDE: return "--subdivide";
+    case BatchStep::SUBDIVIDE_SQRT3: return "--subdivide-sqrt3";
+    case BatchStep::SPECTRAL_SMOOTH: return "--spectral";
+    }
+    return "";
+}
+
+// one step of options, false if it failed
+static bool run_step(MeshProcessing& mesh, const BatchStep& step, const BatchOptions& options,
+                     const string& input, MeshPublisher& publisher, const JobProgress& progress) {
+    const surface_mesh::Allocation_tracker::Counts allocations =
+        surface_mesh::Allocation_tracker::read();
+    // labelled by the option without its dashes
+    Metrics::Operation operation(step_option(step.type) + 2, mesh.get_number_of_vertices());
+    switch (step.type) {
+    case BatchStep::IMPLICIT_SMOOTHING:
+        for (unsigned int k = 0; k < step.iterations && !progress.expired(); ++k) {
+            mesh.implicit_smoothing(step.timestep);
+        }
+        break;
+    case BatchStep::ADAPTIVE_IMPLICIT:
+        mesh.adaptive_implicit_smoothing(step.timestep);
+        break;
+    case BatchStep::MINIMAL_SURFACE:
+        mesh.minimal_surface();
+        break;
+    case BatchStep::PARAMETERIZE:
+        if (!mesh.harmonic_parameterization()) {
+            operation.fail();
+            cerr << input << ": parameterization failed" << endl;
+            return false;
+        }
+        break;
+    case BatchStep::UNIFORM_SMOOTH:
+        mesh.uniform_smooth(step.iterations);
+        break;
+    case BatchStep::SMOOTH:
+        mesh.smooth(step.iterations);
+        break;
+    case BatchStep::FEATURE_SMOOTH:
+        mesh.feature_preserving_smooth(step.iterations);
+        break;
+    case BatchStep::MULTIRESOLUTION_SMOOTH:
+        mesh.multiresolution_smooth(step.iterations);
+        break;
+    case BatchStep::TAUBIN_SMOOTH:
+        mesh.taubin_smooth(step.iterations);
+        break;
+    case BatchStep::WELD:
+        mesh.weld_vertices(float(step.timestep));
+        break;
+    case BatchStep::DECIMATE: {
+        DecimationOptions decimation;
+        decimation.target_faces = step.iterations;
+        mesh.decimate(decimation);
+        break;
+    }
+    case BatchStep::SUBDIVIDE:
+        mesh.subdivide(surface_mesh::SUBDIVISION_LOOP, step.iterations);
+        break;
+    case BatchStep::SUBDIVIDE_SQRT3:
+        mesh.subdivide(surface_mesh::SUBDIVISION_SQRT3, step.iterations);
+        break;
+    case BatchStep::REMESH: {
+        RemeshingOptions remeshing;
+        remeshing.iterations = step.iterations;
+        mesh.remesh(remeshing);
+        break;
+    }
+    case BatchStep::SPECTRAL_SMOOTH: {
+        // the basis is cached next to the input and reused by later runs
+        const string cache = input + ".eigen";
+        if (mesh.get_eigenbasis_size() < int(step.iterations) &&
+            (!mesh.load_eigenbasis(cache) ||
+             mesh.get_eigenbasis_size() < int(step.iterations))) {
+            if (!mesh.compute_eigenbasis(step.iterations)) {
+                operation.fail();
+                cerr << input << ": eigenbasis failed" << endl;
+                return false;
+            }
+            if (!mesh.save_eigenbasis(cache)) cerr << cache << ": cannot write" << endl;
+        }
+        mesh.spectral_smoothing(step.iterations);
+        break;
+    }
+    }
+    if (options.allocations) {
+        // of the whole process, the other meshes of the batch included
+        const surface_mesh::Allocation_tracker::Counts c =
+            surface_mesh::Allocation_tracker::read() - allocations;
+        char text[256];
+        snprintf(text, sizeof(text), "%s: %s %lld allocations, %.1f MB", input.c_str(),
+                 step_option(step.type), c.allocations, c.bytes / (1024.0 * 1024.0));
+#pragma omp critical
+        cout << text << endl;
+    }
+    publisher.publish(mesh, step.type == BatchStep::DECIMATE ||
+                            step.type == BatchStep::REMESH);
+    return true;
+}
+
+// --self-intersections: the faces crossing others after step
+static void print_self_intersections(MeshProcessing& mesh, const BatchStep& step,
+                                     const string& input) {
+    Metrics::Operation operation("self-intersections", mesh.get_number_of_vertices());
+    const MeshProcessing::SelfIntersectionReport r = mesh.self_intersections();
+    char text[256];
+    snprintf(text, sizeof(text), "%s: %s %d self-intersecting faces, %d crossing pairs",
+             input.c_str(), step_option(step.type), r.faces, r.pairs);
+#pragma omp critical
+    cout << text << endl;
+}
+
+// the steps of options after the first publish, until progress expired
+static bool run_steps(MeshProcessing& mesh, const BatchOptions& options, const string& input,
+                      MeshPublisher& publisher, const JobProgress& progress) {
+    for (const BatchStep& step : options.steps) {
+        if (progress.expired()) break;
+        if (!run_step(mesh, step, options, input, publisher, progress)) return false;
+        if (options.self_intersections) print_self_intersections(mesh, step, input);
+    }
+    return true;
+}
+
+// false if a step failed, the message is printed
+static bool run_steps(MeshProcessing& mesh, const BatchOptions& options, const string& input,
+                      MeshPublisher& publisher) {
+    publisher.publish(mesh, true);
+    JobProgress progress;
+    if (options.time_budget > 0.0) {
+        progress.set_time_budget(options.time_budget);
+        mesh.set_progress(&progress);
+    }
+    const bool ok = run_steps(mesh, options, input, publisher, progress);
+    mesh.set_progress(nullptr);
+    if (progress.expired()) cerr << input << ": steps stopped by the time budget" << endl;
+    return ok;
+}
+
+// memory report, deviation, symbolic cache and the result of input
+static bool finish(MeshProcessing& mesh, const BatchOptions& options, const string& input) {
+    if (options.deviation) {
+        const MeshProcessing::DeviationReport d = mesh.deviation();
+        char text[256];
+        snprintf(text, sizeof(text), "%s: Hausdorff %g, forward max %g mean %g, "
+                 "backward max %g mean %g", input.c_str(), d.hausdorff(), d.forward_max,
+                 d.forward_mean, d.backward_max, d.backward_mean);
+#pragma omp critical
+        cout << text << endl;
+    }
+    if (options.memory_report) {
+        const MeshProcessing::MemoryReport m = mesh.memory_report();
+        const double mb = 1.0 / (1024.0 * 1024.0);
+        char text[256];
+        snprintf(text, sizeof(text), "%s: %.1f MB total, mesh %.1f MB (%.1f used), "
+                 "derived %.1f MB, peak solve %.1f MB", input.c_str(), m.total() * mb,
+                 m.mesh.reserved() * mb, m.mesh.used() * mb,
+                 (m.total() - m.mesh.reserved()) * mb, m.peak_solver * mb);
+#pragma omp critical
+        cout << text << endl;
+    }
+    if (!mesh.save_symbolic_cache(input)) {
+        cerr << MeshProcessing::symbolic_cache_path(input) << ": cannot write" << endl;
+    }
+    const string output = batch_output_path(options, input);
+    Metrics::Operation operation("save", mesh.get_number_of_vertices());
+    if (!mesh.save_mesh(output, options.binary_off)) {
+        operation.fail();
+        cerr << output << ": cannot write" << endl;
+        return false;
+    }
+    if (options.progressive_faces > 0) {
+        const string progressive = sibling_output_path(output, ".pm");
+        if (!write_progressive_mesh(mesh.get_mesh(), progressive, options.progressive_faces)) {
+            cerr << progressive << ": cannot write" << endl;
+            return false;
+        }
+    }
+    if (options.columns) {
+        const string columns = sibling_output_path(output, ".arrow");
+        if (!mesh.save_vertex_columns(columns)) {
+            cerr << columns << ": cannot write" << endl;
+            return false;
+        }
+    }
+    if (options.thumbnails) {
+        options.thumbnails->render(mesh, batch_thumbnail_path(options, input));
+    }
+    return true;
+}
+
+static bool process(const BatchOptions& options, const string& input, ThreadBudget& budget,
+                    const int threads, MeshPublisher& publisher) {
+    // load_mesh() exits on unreadable files, skip them instead
+    if (!std::ifstream(input.c_str()).good()) {
+        cerr << input << ": cannot open" << endl;
+        return false;
+    }
+    SURFACE_MESH_TRACE_ZONE("process");
+    if (options.info) return print_info(input);
+    ThreadShare share(budget);
+#ifdef _OPENMP
+    omp_set_num_threads(1);
+#endif
+    MeshProcessing mesh(input, read_attributes(options));
+    // read_mesh() printed what is wrong
+    if (options.strict && !mesh.get_face_report().ok()) {
+        cerr << input << ": skipped, --strict" << endl;
+        return false;
+    }
+    // wide loops and solves for large meshes, one thread for small ones so
+    // that more of them run side by side
+    const int wanted = options.threads_per_mesh > 0 ? int(options.threads_per_mesh)
+                     : int(mesh.get_number_of_vertices() / VERTICES_PER_THREAD);
+    const int width = std::min(std::max(wanted, 1), threads);
+    share.resize(width);
+#ifdef _OPENMP
+    omp_set_num_threads(width);
+#endif
+    configure(mesh, options);
+    // the orderings of the LDLT solves are cached next to the input like
+    // the eigenbasis, a later run on the same connectivity skips the analysis
+    mesh.set_symbolic_cache(true);
+    mesh.load_symbolic_cache(input);
+    return run_steps(mesh, options, input, publisher) && finish(mesh, options, input);
+}
+
+// the positions of a file with the connectivity of the template, compared
+// face by face while they are streamed
+class PositionsVisitor : public surface_mesh::Mesh_visitor {
+public:
+    explicit PositionsVisitor(const MatrixXu& faces) : faces_(faces) {}
+    bool on_vertices(const surface_mesh::Point* p, size_t n, unsigned int) override {
+        points.insert(points.end(), p, p + n);
+        return true;
+    }
+    bool on_faces(const unsigned int* indices, const unsigned int* valences, size_t n) override {
+        for (size_t i = 0; i < n; ++i, indices += 3, ++face_) {
+            if (valences[i] != 3 || face_ >= size_t(faces_.cols()) ||
+                indices[0] != faces_(0, face_) || indices[1] != faces_(1, face_) ||
+                indices[2] != faces_(2, face_)) {
+                return matches_ = false;
+            }
+        }
+        return true;
+    }
+    bool matches() const { return matches_ && face_ == size_t(faces_.cols()); }
+    std::vector<surface_mesh::Point> points;
+
+private:
+    const MatrixXu& faces_;
+    size_t face_ = 0;
+    bool matches_ = true;
+};
+
+// --template: one MeshProcessing for all inputs, one after the other with
+// all threads; the first input is read as a mesh, the others only bring
+// their positions, so the connectivity and what is derived from it are
+// built once
+static int run_template_batch(const BatchOptions& options, MeshPublisher& publisher) {
+    const string& first = options.inputs[0];
+    if (!std::ifstream(first.c_str()).good()) {
+        cerr << first << ": cannot open" << endl;
+        return int(options.inputs.size());
+    }
+    MeshProcessing mesh(first, read_attributes(options));
+    if (options.strict && !mesh.get_face_report().ok()) {
+        cerr << first << ": skipped, --strict" << endl;
+        return int(options.inputs.size());
+    }
+    configure(mesh, options);
+    mesh.set_symbolic_cache(true);
+    mesh.load_symbolic_cache(first);
+    // one team for all inputs, pinned with an affinity
+    surface_mesh::enter_worker_thread();
+    // copied, the steps do not change the connectivity
+    const MatrixXu faces = *mesh.get_indices();
+    int failed = 0;
+    for (size_t i = 0; i < options.inputs.size(); ++i) {
+        const string& input = options.inputs[i];
+        SURFACE_MESH_TRACE_ZONE("process");
+        if (i > 0) {
+            PositionsVisitor positions(faces);
+            positions.points.reserve(mesh.get_number_of_vertices());
+            if (!surface_mesh::read_mesh_stream(input, positions)) {
+                cerr << input << ": cannot read" << endl;
+                ++failed;
+                continue;
+            }
+            if (!positions.matches() || !mesh.replace_positions(positions.points)) {
+                cerr << input << ": skipped, connectivity differs from " << first << endl;
+                ++failed;
+                continue;
+            }
+        }
+        if (!run_steps(mesh, options, input, publisher) || !finish(mesh, options, input)) ++failed;
+    }
+    return failed;
+}
+
+// meshes handed from one stage of a --pipeline batch to the next; push()
+// waits while capacity of them are queued, pop() returns false once the
+// queue is closed and empty
+class MeshQueue {
+public:
+    struct Item {
+        string input;
+        std::unique_ptr<MeshProcessing> mesh;
+        // charged to the MemoryBudget
+        size_t bytes = 0;
+    };
+    explicit MeshQueue(const size_t capacity) : capacity_(capacity) {}
+    void push(Item item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        changed_.notify_all();
+    }
+    bool pop(Item& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.erase(items_.begin());
+        changed_.notify_all();
+        return true;
+    }
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        changed_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<Item> items_;
+    const size_t capacity_;
+    bool closed_ = false;
+};
+
+// the memory of the meshes in a --pipeline batch, MeshProcessing::memory_report()
+// after reading and after the steps; the next mesh is only read while they
+// take less than the cap, so one always fits
+class MemoryBudget {
+public:
+    explicit MemoryBudget(const size_t cap) : cap_(cap) {}
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        released_.wait(lock, [&] { return cap_ == 0 || used_ < cap_; });
+    }
+    // a mesh that took old_bytes now takes new_bytes
+    void update(const size_t old_bytes, const size_t new_bytes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        used_ += new_bytes;
+        used_ -= old_bytes;
+        released_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable released_;
+    const size_t cap_;
+    size_t used_ = 0;
+};
+
+// --pipeline: the meshes in input order, one at a time with all threads.
+// A reader thread builds the next mesh and a writer thread saves the last
+// one while the steps run, so the parsing and the disk overlap with the
+// solves; one mesh waits in each queue at most, fewer under the memory cap.
+static int run_pipeline_batch(const BatchOptions& options, MeshPublisher& publisher) {
+    MemoryBudget memory(options.pipeline_memory);
+    MeshQueue read(1), processed(1);
+    int read_failed = 0, write_failed = 0, failed = 0;
+
+    std::thread reader([&]() {
+#ifdef _OPENMP
+        omp_set_num_threads(1);
+#endif
+        for (const string& input: options.inputs) {
+            // load_mesh() exits on unreadable files, skip them instead
+            if (!std::ifstream(input.c_str()).good()) {
+                cerr << input << ": cannot open" << endl;
+                ++read_failed;
+                continue;
+            }
+            memory.wait();
+            MeshQueue::Item item;
+            item.input = input;
+            {
+                SURFACE_MESH_TRACE_ZONE("read");
+                item.mesh.reset(new MeshProcessing(input, read_attributes(options)));
+            }
+            if (options.strict && !item.mesh->get_face_report().ok()) {
+                cerr << input << ": skipped, --strict" << endl;
+                ++read_failed;
+                continue;
+            }
+            item.bytes = item.mesh->memory_report().total();
+            memory.update(0, item.bytes);
+            read.push(std::move(item));
+        }
+        read.close();
+    });
+    std::thread writer([&]() {
+#ifdef _OPENMP
+        omp_set_num_threads(1);
+#endif
+        MeshQueue::Item item;
+        while (processed.pop(item)) {
+            SURFACE_MESH_TRACE_ZONE("write");
+            if (!finish(*item.mesh, options, item.input)) ++write_failed;
+            item.mesh.reset();
+            memory.update(item.bytes, 0);
+        }
+    });
+
+    // the steps on one team, pinned with an affinity; the reader and the
+    // writer started before keep the CPUs of the process
+    surface_mesh::enter_worker_thread();
+    MeshQueue::Item item;
+    while (read.pop(item)) {
+        MeshProcessing& mesh = *item.mesh;
+        bool ok;
+        {
+            SURFACE_MESH_TRACE_ZONE("process");
+            configure(mesh, options);
+            mesh.set_symbolic_cache(true);
+            mesh.load_symbolic_cache(item.input);
+            ok = run_steps(mesh, options, item.input, publisher);
+        }
+        const size_t bytes = ok ? mesh.memory_report().total() : 0;
+        memory.update(item.bytes, bytes);
+        item.bytes = bytes;
+        if (!ok) {
+            ++failed;
+            item.mesh.reset();
+            continue;
+        }
+        processed.push(std::move(item));
+    }
+    processed.close();
+    reader.join();
+    writer.join();
+    return read_failed + failed + write_failed;
+}
+
+// the trace and the metrics of the run start recording
+static void start_reports(const BatchOptions& options) {
+    if (!options.metrics_file.empty()) Metrics::enable();
+    if (options.trace_file.empty()) return;
+    surface_mesh::Trace::start();
+    if (options.counters && !surface_mesh::Trace::start_counting()) {
+        cerr << "hardware counters unavailable, the trace has none" << endl;
+    }
+}
+
+// the trace and the metrics of the run
+static void write_reports(const BatchOptions& options) {
+    if (!options.trace_file.empty() && !surface_mesh::Trace::write(options.trace_file)) {
+        cerr << options.trace_file << ": cannot write" << endl;
+    }
+    if (!options.metrics_file.empty() && !Metrics::write_openmetrics(options.metrics_file)) {
+        cerr << options.metrics_file << ": cannot write" << endl;
+    }
+}
+
+int run_batch(const BatchOptions& options) {
+    surface_mesh::Thread_options config;
+    config.threads = options.threads;
+    config.affinity = options.affinity;
+    surface_mesh::set_thread_options(config);
+    MeshPublisher publisher(options.info ? string() : options.share);
+    if (options.fixed_topology && !options.info) {
+        start_reports(options);
+        const int failed = run_template_batch(options, publisher);
+        write_reports(options);
+        return failed;
+    }
+    if (options.pipeline && !options.info) {
+        start_reports(options);
+        const int failed = run_pipeline_batch(options, publisher);
+        write_reports(options);
+        return failed;
+    }
+    const int n = (int) options.inputs.size();
+    int failed = 0;
+    start_reports(options);
+    // largest files first, the small ones fill the gaps at the end
+    std::vector<std::pair<long long, int> > order(n);
+    for (int i = 0; i < n; ++i) {
+        std::ifstream file(options.inputs[i].c_str(), std::ios::binary | std::ios::ate);
+        order[i] = std::make_pair(-(long long) file.tellg(), i);
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    // one mesh per thread of the outer loop, idle threads take the next
+    // mesh of the queue; the threads of the loops inside MeshProcessing
+    // come out of the same budget
+    const int threads = int(surface_mesh::worker_threads());
+#ifdef _OPENMP
+    const int levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(2);
+#endif
+    ThreadBudget budget(threads);
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:failed) num_threads(threads)
+    for (int i = 0; i < n; ++i) {
+        if (!process(options, options.inputs[order[i].second], budget, threads, publisher)) ++failed;
+    }
+#ifdef _OPENMP
+    omp_set_max_active_levels(levels);
+#endif
+    write_reports(options);
+    return failed;
+}
+
+void print_batch_usage(const char* program) {
+    cerr << "usage: " << program << " --batch [steps] [options] mesh...\n"
+         << "steps, applied in the given order:\n"
+         << "  --implicit DT [N]    N implicit smoothing steps of size DT (N = 1)\n"
+         << "  --implicit-adaptive T  implicit smoothing for a total time T in steps\n"
+         << "                       sized by their displacement and volume change\n"
+         << "  --minimal-surface    minimal surface with the boundary fixed\n"
+         << "  --parameterize       harmonic disk texture coordinates, written by the\n"
+         << "                       .off and .ply results\n"
+         << "  --uniform-smooth N   N explicit uniform Laplacian steps\n"
+         << "  --smooth N           N explicit cotan Laplacian steps\n"
+         << "  --feature-smooth N   N cotan steps that keep edges sharper than 30 degrees\n"
+         << "  --multires-smooth N  about N uniform steps, most of them on coarse levels\n"
+         << "  --taubin-smooth N    N uniform lambda|mu step pairs, without shrinking\n"
+         << "  --weld T             merge the vertices closer than T, e.g. duplicated\n"
+         << "                       seams of OBJ and OFF exports; 0 merges equal ones\n"
+         << "  --decimate F         quadric error edge collapses down to F faces\n"
+         << "  --subdivide N        N levels of Loop subdivision\n"
+         << "  --subdivide-sqrt3 N  N levels of sqrt(3) subdivision, for closed meshes\n"
+         << "  --remesh N           N isotropic remeshing iterations, mean edge length\n"
+         << "  --spectral K         keep the K lowest Laplacian eigenvectors, the basis\n"
+         << "                       is cached in <input>.eigen\n"
+         << "options:\n"
+         << "  --solver ldlt|ldlt-float|cg|ichol|multigrid|schwarz|matrix-free|cholmod|pardiso|\n"
+         << "           cusolver|amgx\n"
+         << "                          linear solver of the implicit steps, cholmod,\n"
+         << "                          pardiso and the CUDA solvers cusolver and amgx\n"
+         << "                          if found at configure time; matrix-free is cg\n"
+         << "                          without the assembled matrix\n"
+         << "  --ordering amd|colamd|metis|morton|auto\n"
+         << "                          fill-reducing ordering of ldlt and ldlt-float,\n"
+         << "                          metis if found at configure time; auto keeps\n"
+         << "                          the one with the sparsest factor per pattern (amd)\n"
+         << "  --output-dir DIR        write results to DIR/<input name>\n"
+         << "  --suffix S              otherwise write <input>S.<ext> (_faired)\n"
+         << "  --thumbnails DIR        a picture of every result colored by its mean\n"
+         << "                          curvature, DIR/<input name>.png; needs the\n"
+         << "                          viewer built with GP_OFFSCREEN EGL or OSMESA\n"
+         << "  --thumbnail-size N      N x N pixels of the thumbnails (256)\n"
+         << "  --binary                write .off results as OFF BINARY\n"
+         << "  --progressive F         also write every result as a progressive mesh\n"
+         << "                          <result>.pm with a base of F faces, which the\n"
+         << "                          viewer shows while the rest is read\n"
+         << "  --columns               also write the positions, valences, curvatures\n"
+         << "                          and deviations of the vertices of every result\n"
+         << "                          as the columns of an Arrow file <result>.arrow\n"
+         << "  --strict                skip inputs with complex, degenerate or duplicate\n"
+         << "                          faces instead of building what add_face() accepts\n"
+         << "  --geometry-only         skip texture coordinates and the optional PLY\n"
+         << "                          attributes when reading, they are not written\n"
+         << "  --info                  print counts and bounds of .off, .obj and .stl\n"
+         << "                          inputs, streamed without building the mesh, and\n"
+         << "                          skip the steps\n"
+         << "  --template              the inputs share the connectivity of the first,\n"
+         << "                          which is built once; the others only bring their\n"
+         << "                          positions (.off or .obj triangle meshes)\n"
+         << "  --pipeline              one mesh at a time with all threads, the next one\n"
+         << "                          is read and the last one written meanwhile\n"
+         << "  --pipeline-memory MB    --pipeline, the next mesh waits to be read while\n"
+         << "                          the meshes in flight take MB or more\n"
+         << "  --tolerance T           smoothing steps stop once an iteration moves the\n"
+         << "                          vertices less than T times the first (RMS)\n"
+         << "  --chebyshev             Chebyshev acceleration of --uniform-smooth\n"
+         << "  --gauss-seidel          --uniform-smooth and --smooth update the vertices\n"
+         << "                          in place, by colors of independent vertices\n"
+         << "  --preserve-volume       rescale the smoothing results to the volume of\n"
+         << "                          before about the center of the input\n"
+         << "  --max-cotan C           clamp the cotan weights of every corner to [-C, C]\n"
+         << "                          (1e5), against degenerate triangles\n"
+         << "  --threads-per-mesh N    threads of the steps of one mesh, by default one\n"
+         << "                          per 50000 vertices\n"
+         << "  --threads N             threads of the batch, all CPUs by default\n"
+         << "  --affinity MODE         none, compact or spread: pin the threads of the\n"
+         << "                          steps to neighboring or evenly spaced CPUs, with\n"
+         << "                          --pipeline or --template\n"
+         << "  --time-budget S         stop the steps of a mesh after S seconds and\n"
+         << "                          write what they reached\n"
+         << "  --share NAME            publish every mesh after loading and after each\n"
+         << "                          step to the shared memory segment NAME, for\n"
+         << "                          a viewer started with --attach NAME\n"
+         << "  --memory                print the memory of every mesh after the steps\n"
+         << "  --deviation             print the Hausdorff distance of every mesh to its\n"
+         << "                          input after the steps, same connectivity only\n"
+         << "  --self-intersections    print the faces that cross other faces of every\n"
+         << "                          mesh after each step\n"
+         << "  --trace FILE            write a Chrome trace, needs a GP_TRACING build\n"
+         << "  --metrics FILE          write the durations, sizes and peak memory of\n"
+         << "                          the steps, the solver iterations and the cache\n"
+         << "                          hits in the OpenMetrics text format\n"
+         << "  --counters              add the hardware counters of every zone to the\n"
+         << "                          trace, Linux perf_event\n"
+         << "  --allocations           print the allocations of every step, needs a\n"
+         << "                          GP_ALLOCATION_TRACKING build; the counts are of\n"
+         << "                          the process, pass one mesh for exact ones\n"
+         << "Without --batch the viewer is started, --attach NAME shows the meshes\n"
+         << "a batch run publishes with --share NAME as they change. --serve starts\n"
+         << "a server that smooths the meshes of other processes over TCP.\n"
+         << "--record FILE logs the actions of the viewer, --replay FILE runs and\n"
+         << "times them without it." << endl;
+}
+
+}
@@ -0,0 +1,139 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+#include "mesh_processing.h"
+#include <surface_mesh/Threads.h>
+
+namespace mesh_processing {
+
+// one step of a headless pipeline, applied to every input mesh in order
+struct BatchStep {
+    enum TYPE : int { IMPLICIT_SMOOTHING, MINIMAL_SURFACE, UNIFORM_SMOOTH, SMOOTH,
+                      SPECTRAL_SMOOTH, FEATURE_SMOOTH, MULTIRESOLUTION_SMOOTH, TAUBIN_SMOOTH,
+                      DECIMATE, REMESH, PARAMETERIZE, ADAPTIVE_IMPLICIT, WELD, SUBDIVIDE,
+                      SUBDIVIDE_SQRT3 };
+    TYPE type;
+    // IMPLICIT_SMOOTHING, the total time of ADAPTIVE_IMPLICIT, the distance
+    // below which WELD merges vertices
+    double timestep;
+    // repetitions of IMPLICIT_SMOOTHING, smoothing iterations, eigenvectors
+    // kept by SPECTRAL_SMOOTH, target faces of DECIMATE, iterations of REMESH,
+    // levels of SUBDIVIDE and SUBDIVIDE_SQRT3
+    unsigned int iterations;
+};
+
+// Draws a picture of every result, for builds with a GL context without a
+// window; see ThumbnailRenderer of the viewer build
+class BatchThumbnails {
+public:
+    virtual ~BatchThumbnails() {}
+    // queues a picture of mesh for the file path, called by the thread
+    // that ran the steps; the mesh may change once it returns
+    virtual void render(MeshProcessing& mesh, const std::string& path) = 0;
+};
+
+struct BatchOptions {
+    std::vector<std::string> inputs;
+    std::vector<BatchStep> steps;
+    // results go to output_dir/<input name>, or next to the input with
+    // suffix inserted before the extension when output_dir is empty
+    std::string output_dir;
+    std::string suffix = "_faired";
+    MeshProcessing::SOLVER_TYPE solver = MeshProcessing::DIRECT_LDLT;
+    MeshProcessing::FILL_ORDERING ordering = MeshProcessing::ORDERING_AMD;
+    // print MeshProcessing::memory_report() of every mesh after the steps
+    bool memory_report = false;
+    // print MeshProcessing::deviation() of every mesh after the steps
+    bool deviation = false;
+    // print MeshProcessing::self_intersections() of every mesh after each
+    // step
+    bool self_intersections = false;
+    // Chrome trace of the run, only recorded when built with GP_TRACING
+    std::string trace_file;
+    // OpenMetrics text of the run, see Metrics, for a Prometheus textfile
+    // collector
+    std::string metrics_file;
+    // the hardware counters of every zone in the trace, Linux perf_event
+    bool counters = false;
+    // print the operator new calls of every step, needs a build with
+    // GP_ALLOCATION_TRACKING
+    bool allocations = false;
+    // write .off results as OFF BINARY
+    bool binary_off = false;
+    // faces of the base of a progressive mesh written next to every result,
+    // see write_progressive_mesh(); 0 for none
+    unsigned int progressive_faces = 0;
+    // write the per-vertex valences, curvatures and deviations of every
+    // result as the columns of an Arrow file <result>.arrow, see
+    // MeshProcessing::save_vertex_columns()
+    bool columns = false;
+    // skip the inputs whose faces are not a valid manifold list, see
+    // MeshProcessing::get_face_report()
+    bool strict = false;
+    // read the inputs without their optional attributes, see
+    // surface_mesh::Read_attributes
+    bool geometry_only = false;
+    // only print the counts and bounds of every input, streamed with
+    // surface_mesh::read_mesh_stream(), no steps run and nothing is written
+    bool info = false;
+    // --template: the inputs are shapes of the connectivity of the first
+    // one, processed one after the other with one MeshProcessing whose
+    // positions are replaced, see MeshProcessing::replace_positions()
+    bool fixed_topology = false;
+    // MeshProcessing::set_smoothing_tolerance(), set_chebyshev_smoothing()
+    // and set_gauss_seidel_smoothing() of the smoothing steps
+    float smoothing_tolerance = 0.0f;
+    bool chebyshev = false;
+    bool gauss_seidel = false;
+    // MeshProcessing::set_volume_preservation()
+    bool preserve_volume = false;
+    // MeshProcessing::set_max_cotan()
+    float max_cotan = DEFAULT_MAX_COTAN;
+    // threads of the steps of one mesh, 0 chooses by the number of vertices
+    unsigned int threads_per_mesh = 0;
+    // threads of the whole batch, 0 for all CPUs, and where they run; the
+    // affinity pins one team and needs --pipeline or --template, the teams
+    // of meshes processed side by side would inherit a single CPU
+    unsigned int threads = 0;
+    surface_mesh::Thread_affinity affinity = surface_mesh::AFFINITY_NONE;
+    // --pipeline: one mesh at a time with all threads, the next one read and
+    // the last one written on threads of their own meanwhile
+    bool pipeline = false;
+    // bytes of the meshes in a --pipeline at which the next one waits to be
+    // read, 0 for no cap
+    size_t pipeline_memory = 0;
+    // --thumbnails: a size x size picture of every result colored by its
+    // mean curvature, thumbnail_dir/<input name>.png, drawn by thumbnails,
+    // which main() sets when it can draw offscreen
+    std::string thumbnail_dir;
+    unsigned int thumbnail_size = 256;
+    BatchThumbnails* thumbnails = nullptr;
+    // named shared memory segment the mesh is published to after loading
+    // and after every step, see surface_mesh::Shared_mesh_writer; several
+    // meshes side by side take turns
+    std::string share;
+    // seconds for the steps of every mesh, 0 for none: once they are up the
+    // running step stops with what it reached, see
+    // MeshProcessing::set_progress(), the remaining ones are skipped and
+    // the mesh is written as it is
+    double time_budget = 0.0;
+};
+
+// true if argv asks for the headless mode, i.e. starts with --batch
+bool is_batch_command(int argc, char** argv);
+// parses the arguments after --batch, false and a message on error
+bool parse_batch_options(int argc, char** argv, BatchOptions& options, std::string& error);
+// runs the pipeline on all inputs, several meshes at a time when OpenMP is
+// enabled, the largest first; returns the number of inputs that failed
+int run_batch(const BatchOptions& options);
+// the name of the result file of input
+std::string batch_output_path(const BatchOptions& options, const std::string& input);
+// the name of the thumbnail of input
+std::string batch_thumbnail_path(const BatchOptions& options, const std::string& input);
+void print_batch_usage(const char* program);
+
+}
+
+#endif
@@ -0,0 +1,468 @@
+#include "bvh.h"
+#include "geometry_kernels.h"
+#include <algorithm>
+#include <limits>
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+typedef surface_mesh::Surface_mesh Mesh;
+
+// triangles per leaf
+static const int LEAF_SIZE = 4;
+// triangle pairs per call of the intersection kernel
+static const int PAIR_BATCH = 256;
+
+void TriangleBVH::build(const Mesh& mesh) {
+    triangles_.clear();
+    nodes_.clear();
+
+    // fan triangulation of every face
+    for (auto f: mesh.faces()) {
+        auto fv = mesh.vertices(f);
+        const int v0 = (*fv).idx();
+        ++fv;
+        int v1 = (*fv).idx();
+        for (unsigned int k = 2; k < mesh.valence(f); ++k) {
+            ++fv;
+            Triangle triangle;
+            triangle.v[0] = v0;
+            triangle.v[1] = v1;
+            triangle.v[2] = (*fv).idx();
+            triangle.face = f.idx();
+            triangles_.push_back(triangle);
+            v1 = triangle.v[2];
+        }
+    }
+    if (triangles_.empty()) return;
+
+    std::vector<Point> centroids(triangles_.size());
+    for (size_t i = 0; i < triangles_.size(); ++i) {
+        const Triangle& tri = triangles_[i];
+        centroids[i] = (mesh.position(Mesh::Vertex(tri.v[0])) +
+                        mesh.position(Mesh::Vertex(tri.v[1])) +
+                        mesh.position(Mesh::Vertex(tri.v[2]))) / 3.0f;
+    }
+
+    nodes_.reserve(2 * triangles_.size() / LEAF_SIZE + 1);
+    nodes_.push_back(Node());
+    build_node(0, centroids, 0, triangles_.size());
+    refit(mesh);
+}
+
+void TriangleBVH::build_node(const int index, std::vector<Point>& centroids,
+                             const int begin, const int end) {
+    if (end - begin <= LEAF_SIZE) {
+        nodes_[index].first = begin;
+        nodes_[index].count = end - begin;
+        return;
+    }
+
+    // split at the median centroid along the longest axis of the centroid box
+    Point c_min = centroids[begin], c_max = centroids[begin];
+    for (int i = begin + 1; i < end; ++i) {
+        c_min.minimize(centroids[i]);
+        c_max.maximize(centroids[i]);
+    }
+    const Point extent = c_max - c_min;
+    int axis = 0;
+    if (extent[1] > extent[axis]) axis = 1;
+    if (extent[2] > extent[axis]) axis = 2;
+
+    // sort triangle indices, then apply the order to both arrays
+    std::vector<int> order(end - begin);
+    for (int i = begin; i < end; ++i) order[i - begin] = i;
+    const int mid = (end - begin) / 2;
+    std::nth_element(order.begin(), order.begin() + mid, order.end(),
+                     [&centroids, axis](const int a, const int b) {
+                         return centroids[a][axis] < centroids[b][axis];
+                     });
+    std::vector<Triangle> triangles(end - begin);
+    std::vector<Point> points(end - begin);
+    for (int i = 0; i < end - begin; ++i) {
+        triangles[i] = triangles_[order[i]];
+        points[i] = centroids[order[i]];
+    }
+    std::copy(triangles.begin(), triangles.end(), triangles_.begin() + begin);
+    std::copy(points.begin(), points.end(), centroids.begin() + begin);
+
+    // children are stored next to each other, after their parent
+    const int left = nodes_.size();
+    nodes_.push_back(Node());
+    nodes_.push_back(Node());
+    nodes_[index].first = left;
+    nodes_[index].count = 0;
+    build_node(left, centroids, begin, begin + mid);
+    build_node(left + 1, centroids, begin + mid, end);
+}
+
+void TriangleBVH::refit(const Mesh& mesh) {
+    refit(mesh.get_vertex_property<Point>("v:point").data());
+}
+
+void TriangleBVH::refit(const Point* positions) {
+    // children come after their parent, a reverse sweep is bottom-up
+    for (int i = int(nodes_.size()) - 1; i >= 0; --i) {
+        Node& node = nodes_[i];
+        if (node.count > 0) {
+            fit_leaf(positions, node);
+        } else {
+            const Node& left = nodes_[node.first];
+            const Node& right = nodes_[node.first + 1];
+            node.box_min = left.box_min;
+            node.box_max = left.box_max;
+            node.box_min.minimize(right.box_min);
+            node.box_max.maximize(right.box_max);
+        }
+    }
+}
+
+void TriangleBVH::fit_leaf(const Point* positions, Node& node) const {
+    node.box_min = Point(std::numeric_limits<Scalar>::max());
+    node.box_max = Point(-std::numeric_limits<Scalar>::max());
+    for (int i = node.first; i < node.first + node.count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            const Point& p = positions[triangles_[i].v[k]];
+            node.box_min.minimize(p);
+            node.box_max.maximize(p);
+        }
+    }
+}
+
+bool TriangleBVH::intersect(const Mesh& mesh, const Point& origin,
+                            const Point& direction, Mesh::Face& face,
+                            Scalar& t) const {
+    if (nodes_.empty()) return false;
+
+    Point inv_direction;
+    for (int k = 0; k < 3; ++k) {
+        inv_direction[k] = direction[k] != 0.0f ? 1.0f / direction[k]
+                                                : std::numeric_limits<Scalar>::max();
+    }
+
+    Scalar t_best = std::numeric_limits<Scalar>::max();
+    int face_best = -1;
+
+    std::vector<int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes_[stack.back()];
+        stack.pop_back();
+
+        // slab test, skip boxes that start behind the closest hit
+        Scalar t_near = 0.0f, t_far = t_best;
+        for (int k = 0; k < 3 && t_near <= t_far; ++k) {
+            Scalar t0 = (node.box_min[k] - origin[k]) * inv_direction[k];
+            Scalar t1 = (node.box_max[k] - origin[k]) * inv_direction[k];
+            if (t0 > t1) std::swap(t0, t1);
+            t_near = std::max(t_near, t0);
+            t_far = std::min(t_far, t1);
+        }
+        if (t_near > t_far) continue;
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                Scalar t_hit;
+                if (intersect_triangle(mesh, triangles_[i], origin, direction, t_hit) &&
+                    t_hit < t_best) {
+                    t_best = t_hit;
+                    face_best = triangles_[i].face;
+                }
+            }
+        } else {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+
+    if (face_best < 0) return false;
+    face = Mesh::Face(face_best);
+    t = t_best;
+    return true;
+}
+
+void TriangleBVH::occluded(const Mesh& mesh, const Point& origin, const Point* targets,
+                           const int n, const Scalar max_t, unsigned char* occluded) const {
+    std::fill(occluded, occluded + n, 0);
+    if (nodes_.empty()) return;
+
+    const int n_packets = (n + RAY_PACKET - 1) / RAY_PACKET;
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int packet = 0; packet < n_packets; ++packet) {
+        const int begin = packet * RAY_PACKET;
+        const int count = std::min(int(RAY_PACKET), n - begin);
+        Point direction[RAY_PACKET], inv_direction[RAY_PACKET];
+        for (int i = 0; i < count; ++i) {
+            direction[i] = targets[begin + i] - origin;
+            for (int k = 0; k < 3; ++k) {
+                inv_direction[i][k] = direction[i][k] != 0.0f ? 1.0f / direction[i][k]
+                                                              : std::numeric_limits<Scalar>::max();
+            }
+        }
+
+        // bit i for the rays that have not hit anything yet, a node is
+        // entered if its box is hit by one of them
+        unsigned int active = (1u << count) - 1;
+        // the tree is balanced, its depth is below the bits of the
+        // triangle count
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0 && active) {
+            const Node& node = nodes_[stack[--top]];
+            unsigned int hit = 0;
+            for (int i = 0; i < count; ++i) {
+                if (!(active & (1u << i))) continue;
+                Scalar t_near = 0.0f, t_far = max_t;
+                for (int k = 0; k < 3 && t_near <= t_far; ++k) {
+                    Scalar t0 = (node.box_min[k] - origin[k]) * inv_direction[i][k];
+                    Scalar t1 = (node.box_max[k] - origin[k]) * inv_direction[i][k];
+                    if (t0 > t1) std::swap(t0, t1);
+                    t_near = std::max(t_near, t0);
+                    t_far = std::min(t_far, t1);
+                }
+                if (t_near <= t_far) hit |= 1u << i;
+            }
+            if (!hit) continue;
+
+            if (node.count > 0) {
+                for (int j = node.first; j < node.first + node.count && hit; ++j) {
+                    for (int i = 0; i < count; ++i) {
+                        if (!(hit & (1u << i))) continue;
+                        Scalar t_hit;
+                        if (intersect_triangle(mesh, triangles_[j], origin, direction[i], t_hit) &&
+                            t_hit < max_t) {
+                            occluded[begin + i] = 1;
+                            hit &= ~(1u << i);
+                            active &= ~(1u << i);
+                        }
+                    }
+                }
+            } else {
+                stack[top++] = node.first;
+                stack[top++] = node.first + 1;
+            }
+        }
+    }
+}
+
+// squared distance from p to the box
+static Scalar box_distance2(const Point& box_min, const Point& box_max, const Point& p) {
+    Scalar d2 = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        const Scalar d = std::max(std::max(box_min[k] - p[k], p[k] - box_max[k]), 0.0f);
+        d2 += d * d;
+    }
+    return d2;
+}
+
+// squared distance from p to the triangle a, b, c, by the Voronoi regions of
+// its vertices, edges and face (Ericson, Real-Time Collision Detection 5.1.5)
+static Scalar triangle_distance2(const Point& p, const Point& a, const Point& b,
+                                 const Point& c) {
+    const Point ab = b - a, ac = c - a, ap = p - a;
+    const Scalar d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return sqrnorm(ap);
+
+    const Point bp = p - b;
+    const Scalar d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return sqrnorm(bp);
+
+    const Scalar vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return sqrnorm(ap - ab * (d1 / (d1 - d3)));
+    }
+
+    const Point cp = p - c;
+    const Scalar d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return sqrnorm(cp);
+
+    const Scalar vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return sqrnorm(ap - ac * (d2 / (d2 - d6)));
+    }
+
+    const Scalar va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        return sqrnorm(bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+    }
+
+    // inside the face; a degenerate triangle ends up on an edge above
+    const Scalar denom = va + vb + vc;
+    if (!(denom > 0.0f)) return std::min(sqrnorm(ap), std::min(sqrnorm(bp), sqrnorm(cp)));
+    const Scalar v = vb / denom, w = vc / denom;
+    return sqrnorm(ap - ab * v - ac * w);
+}
+
+void TriangleBVH::closest_distances(const Point* positions, const Point* queries, const int n,
+                                    const Scalar* bound2, Scalar* distance2) const {
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int q = 0; q < n; ++q) {
+        const Point& p = queries[q];
+        Scalar best = bound2 ? bound2[q] : std::numeric_limits<Scalar>::max();
+        if (nodes_.empty() || best == 0.0f) {
+            distance2[q] = best;
+            continue;
+        }
+
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes_[stack[--top]];
+            if (box_distance2(node.box_min, node.box_max, p) >= best) continue;
+
+            if (node.count > 0) {
+                for (int i = node.first; i < node.first + node.count; ++i) {
+                    const Triangle& t = triangles_[i];
+                    best = std::min(best, triangle_distance2(p, positions[t.v[0]],
+                                                             positions[t.v[1]],
+                                                             positions[t.v[2]]));
+                }
+            } else {
+                // the nearer child on top
+                const Node& left = nodes_[node.first];
+                const Node& right = nodes_[node.first + 1];
+                const bool left_first = box_distance2(left.box_min, left.box_max, p) <=
+                                        box_distance2(right.box_min, right.box_max, p);
+                stack[top++] = left_first ? node.first + 1 : node.first;
+                stack[top++] = left_first ? node.first : node.first + 1;
+            }
+        }
+        distance2[q] = best;
+    }
+}
+
+static bool boxes_overlap(const Point& min0, const Point& max0, const Point& min1,
+                          const Point& max1) {
+    return min0[0] <= max1[0] && min1[0] <= max0[0] && min0[1] <= max1[1] &&
+           min1[1] <= max0[1] && min0[2] <= max1[2] && min1[2] <= max0[2];
+}
+
+namespace {
+
+// triangle pairs of self_intersections() waiting for the kernel: the
+// corners of both triangles, their faces and the results
+struct PairBatch {
+    int a[3 * PAIR_BATCH];
+    int b[3 * PAIR_BATCH];
+    int faces[2 * PAIR_BATCH];
+    uint8_t hit[PAIR_BATCH];
+    int size = 0;
+};
+
+}
+
+void TriangleBVH::self_intersections(const Point* positions,
+                                     std::vector<std::pair<int, int> >& faces) const {
+    faces.clear();
+    if (nodes_.empty()) return;
+    std::vector<int> leaves;
+    for (int i = 0; i < int(nodes_.size()); ++i) {
+        if (nodes_[i].count > 0) leaves.push_back(i);
+    }
+    const GeometryKernels& kernels = geometry_kernels();
+    const float* xyz = positions[0].data();
+    const int n_leaves = int(leaves.size());
+
+#pragma omp parallel
+    {
+        std::vector<std::pair<int, int> > found;
+        PairBatch batch;
+        auto flush = [&]() {
+            kernels.triangle_pairs_intersect(batch.size, xyz, batch.a, batch.b, batch.hit);
+            for (int i = 0; i < batch.size; ++i) {
+                if (batch.hit[i]) found.emplace_back(batch.faces[2 * i], batch.faces[2 * i + 1]);
+            }
+            batch.size = 0;
+        };
+        auto add_pair = [&](const Triangle& p, const Triangle& q) {
+            if (p.face == q.face) return;
+            int shared = 0, ps = 0, qs = 0;
+            for (int k = 0; k < 3; ++k) {
+                for (int m = 0; m < 3; ++m) {
+                    if (p.v[k] == q.v[m]) {
+                        ++shared;
+                        ps = k;
+                        qs = m;
+                    }
+                }
+            }
+            // neighbors across an edge only meet where the surface folds
+            if (shared > 1) return;
+            // a shared corner first, the orientation is kept
+            const int i = batch.size++;
+            for (int k = 0; k < 3; ++k) {
+                batch.a[3 * i + k] = p.v[(ps + k) % 3];
+                batch.b[3 * i + k] = q.v[(qs + k) % 3];
+            }
+            batch.faces[2 * i] = std::min(p.face, q.face);
+            batch.faces[2 * i + 1] = std::max(p.face, q.face);
+            if (batch.size == PAIR_BATCH) flush();
+        };
+
+        // every leaf with itself and the overlapping leaves after it
+#pragma omp for schedule(dynamic, 64)
+        for (int l = 0; l < n_leaves; ++l) {
+            const int index = leaves[l];
+            const Node& leaf = nodes_[index];
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const int other_index = stack[--top];
+                const Node& other = nodes_[other_index];
+                if (!boxes_overlap(leaf.box_min, leaf.box_max, other.box_min, other.box_max)) {
+                    continue;
+                }
+                if (other.count == 0) {
+                    stack[top++] = other.first;
+                    stack[top++] = other.first + 1;
+                    continue;
+                }
+                if (other_index < index) continue;
+                for (int i = leaf.first; i < leaf.first + leaf.count; ++i) {
+                    const int begin = other_index == index ? i + 1 : other.first;
+                    for (int j = begin; j < other.first + other.count; ++j) {
+                        add_pair(triangles_[i], triangles_[j]);
+                    }
+                }
+            }
+        }
+        if (batch.size > 0) flush();
+#pragma omp critical
+        faces.insert(faces.end(), found.begin(), found.end());
+    }
+
+    // the triangles of polygons may report a pair of faces more than once
+    std::sort(faces.begin(), faces.end());
+    faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+}
+
+bool TriangleBVH::intersect_triangle(const Mesh& mesh, const Triangle& triangle,
+                                     const Point& origin, const Point& direction,
+                                     Scalar& t) const {
+    // Moller-Trumbore
+    const Point& p0 = mesh.position(Mesh::Vertex(triangle.v[0]));
+    const Point e1 = mesh.position(Mesh::Vertex(triangle.v[1])) - p0;
+    const Point e2 = mesh.position(Mesh::Vertex(triangle.v[2])) - p0;
+    const Point p = cross(direction, e2);
+    const Scalar det = dot(e1, p);
+    if (std::abs(det) < std::numeric_limits<Scalar>::min()) return false;
+
+    const Scalar inv_det = 1.0f / det;
+    const Point s = origin - p0;
+    const Scalar u = dot(s, p) * inv_det;
+    if (u < 0.0f || u > 1.0f) return false;
+
+    const Point q = cross(s, e1);
+    const Scalar v = dot(direction, q) * inv_det;
+    if (v < 0.0f || u + v > 1.0f) return false;
+
+    t = dot(e2, q) * inv_det;
+    return t > 0.0f;
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <utility>
+#include <vector>
+
+namespace mesh_processing {
+
+// Bounding volume hierarchy over the triangles of a Surface_mesh, polygons
+// are fanned into triangles. build() once per connectivity, refit() after
+// the vertices moved. A copy refit to other positions of the same
+// connectivity, e.g. the original ones, answers for that surface.
+class TriangleBVH {
+
+public:
+    void build(const surface_mesh::Surface_mesh& mesh);
+    void refit(const surface_mesh::Surface_mesh& mesh);
+    // refit() to positions instead of the positions of the mesh, one per
+    // vertex; the queries then take the same positions
+    void refit(const surface_mesh::Point* positions);
+    bool empty() const { return nodes_.empty(); }
+    // bytes reserved by the nodes and triangles
+    size_t memory_usage() const {
+        return triangles_.capacity() * sizeof(Triangle) + nodes_.capacity() * sizeof(Node);
+    }
+
+    // closest hit of the ray origin + t * direction with t > 0, returns the
+    // hit face and t
+    bool intersect(const surface_mesh::Surface_mesh& mesh,
+                   const surface_mesh::Point& origin,
+                   const surface_mesh::Point& direction,
+                   surface_mesh::Surface_mesh::Face& face,
+                   surface_mesh::Scalar& t) const;
+    // occluded[i] = 1 if a triangle crosses the segment from origin to
+    // targets[i] before max_t of its length, e.g. max_t slightly below 1 for
+    // the visibility of vertices from the eye. The rays are traversed in
+    // packets of RAY_PACKET neighbours in targets, one node test for the
+    // packet, and the packets run in parallel
+    void occluded(const surface_mesh::Surface_mesh& mesh,
+                  const surface_mesh::Point& origin,
+                  const surface_mesh::Point* targets, const int n,
+                  const surface_mesh::Scalar max_t, unsigned char* occluded) const;
+
+    // distance2[i] is the squared distance from queries[i] to the closest
+    // point of the triangles at positions, for n queries in parallel. The
+    // nearer child is entered first and boxes farther than the closest
+    // triangle so far are skipped; bound2[i], if given, is an upper bound
+    // to start from, e.g. the squared distance to a point known to lie on
+    // the surface, and returned if nothing is closer.
+    void closest_distances(const surface_mesh::Point* positions,
+                           const surface_mesh::Point* queries, const int n,
+                           const surface_mesh::Scalar* bound2,
+                           surface_mesh::Scalar* distance2) const;
+
+    // the pairs of faces whose triangles cross at positions, those of the
+    // last refit, each once with the smaller face first, sorted. Every leaf is paired with the leaves
+    // its box overlaps in parallel, the candidate triangle pairs are
+    // collected into batches for the vectorized test of
+    // GeometryKernels::triangle_pairs_intersect(). Triangles of one face
+    // and triangles sharing an edge are not tested, those sharing a vertex
+    // only count if they cross away from it.
+    void self_intersections(const surface_mesh::Point* positions,
+                            std::vector<std::pair<int, int> >& faces) const;
+
+private:
+    enum { RAY_PACKET = 8 };
+
+    struct Triangle {
+        int v[3];
+        int face;
+    };
+
+    // leaves have count > 0 and cover triangles_[first, first + count),
+    // inner nodes have their children at first and first + 1
+    struct Node {
+        surface_mesh::Point box_min, box_max;
+        int first, count;
+    };
+
+    void build_node(const int index, std::vector<surface_mesh::Point>& centroids,
+                    const int begin, const int end);
+    void fit_leaf(const surface_mesh::Point* positions, Node& node) const;
+    bool intersect_triangle(const surface_mesh::Surface_mesh& mesh,
+                            const Triangle& triangle,
+                            const surface_mesh::Point& origin,
+                            const surface_mesh::Point& direction,
+                            surface_mesh::Scalar& t) const;
+
+    std::vector<Triangle> triangles_;
+    std::vector<Node> nodes_;
+};
+
+}
+
+#endif // BVH_H
@@ -0,0 +1,28 @@
+#include "camera.h"
+#include <cmath>
+
+namespace mesh_processing {
+
+void camera_matrices(const CameraParameters& camera, const Eigen::Vector2i& size,
+                     Eigen::Matrix4f& model, Eigen::Matrix4f& view, Eigen::Matrix4f& proj) {
+    view = nanogui::lookAt(camera.eye, camera.center, camera.up);
+
+    float fH = std::tan(camera.viewAngle / 360.0f * M_PI) * camera.dnear;
+    float fW = fH * (float)size.x() / (float)size.y();
+
+    proj = nanogui::frustum(-fW, fW, -fH, fH, camera.dnear, camera.dfar);
+    model = camera.arcball.matrix();
+
+    model = nanogui::scale(model, Eigen::Vector3f::Constant(camera.zoom * camera.modelZoom));
+    model = nanogui::translate(model, camera.modelTranslation);
+}
+
+void center_camera(CameraParameters& camera, const Eigen::Vector2i& size,
+                   const Eigen::Vector3f& center, const float radius) {
+    camera.arcball = nanogui::Arcball();
+    camera.arcball.setSize(size);
+    camera.modelZoom = 2 / radius;
+    camera.modelTranslation = -center;
+}
+
+}
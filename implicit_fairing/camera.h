@@ -0,0 +1,35 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <nanogui/glutil.h>
+#include <Eigen/Core>
+
+namespace mesh_processing {
+
+// The camera of the viewer and of the batch thumbnails: the model is turned
+// by the arcball, scaled by zoom * modelZoom and moved by modelTranslation,
+// and seen from eye through a frustum of viewAngle degrees.
+struct CameraParameters {
+    nanogui::Arcball arcball;
+    float zoom = 1.0f, viewAngle = 45.0f;
+    float dnear = 0.05f, dfar = 100.0f;
+    Eigen::Vector3f eye = Eigen::Vector3f(0.0f, 0.0f, 5.0f);
+    Eigen::Vector3f center = Eigen::Vector3f(0.0f, 0.0f, 0.0f);
+    Eigen::Vector3f up = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
+    Eigen::Vector3f modelTranslation = Eigen::Vector3f::Zero();
+    Eigen::Vector3f modelTranslation_start = Eigen::Vector3f::Zero();
+    float modelZoom = 1.0f;
+};
+
+// the matrices of camera for a viewport of size pixels
+void camera_matrices(const CameraParameters& camera, const Eigen::Vector2i& size,
+                     Eigen::Matrix4f& model, Eigen::Matrix4f& view, Eigen::Matrix4f& proj);
+
+// a new arcball for a viewport of size pixels, and the model moved and
+// scaled so that the sphere of center and radius fills the view
+void center_camera(CameraParameters& camera, const Eigen::Vector2i& size,
+                   const Eigen::Vector3f& center, const float radius);
+
+}
+
+#endif // CAMERA_H
@@ -0,0 +1,168 @@
+#include "components.h"
+#include "ldlt_solve.h"
+#include <algorithm>
+#include <atomic>
+
+namespace mesh_processing {
+
+using surface_mesh::Surface_mesh;
+
+// root of x, halving the path on the way: x is linked to its grandparent,
+// a failed exchange only skips the shortcut
+static int find_root(std::vector< std::atomic<int> >& parent, int x) {
+    while (true) {
+        int p = parent[x].load(std::memory_order_relaxed);
+        if (p == x) return x;
+        const int g = parent[p].load(std::memory_order_relaxed);
+        if (g != p) parent[x].compare_exchange_weak(p, g, std::memory_order_relaxed);
+        x = g;
+    }
+}
+
+int connected_components(const Surface_mesh& mesh, std::vector<int>& component) {
+    const int n = mesh.vertices_size();
+    std::vector< std::atomic<int> > parent(n);
+    for (int v = 0; v < n; ++v) parent[v].store(v, std::memory_order_relaxed);
+
+    // the parent of a vertex is never larger than the vertex, so the root
+    // of a component is its smallest vertex
+    const int n_edges = mesh.edges_size();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_edges; ++i) {
+        const Surface_mesh::Edge e(i);
+        if (mesh.is_deleted(e)) continue;
+        int a = mesh.vertex(e, 0).idx();
+        int b = mesh.vertex(e, 1).idx();
+        while (true) {
+            a = find_root(parent, a);
+            b = find_root(parent, b);
+            if (a == b) break;
+            if (a < b) std::swap(a, b);
+            int expected = a;
+            if (parent[a].compare_exchange_strong(expected, b)) break;
+        }
+    }
+
+    std::vector<int> root(n);
+#pragma omp parallel for schedule(static)
+    for (int v = 0; v < n; ++v) root[v] = find_root(parent, v);
+    component.resize(n);
+    int n_components = 0;
+    for (int v = 0; v < n; ++v) {
+        component[v] = root[v] == v ? n_components++ : component[root[v]];
+    }
+    return n_components;
+}
+
+void BlockDiagonalLDLT::set_blocks(const std::vector<int>& block, const int n_blocks,
+                                   const int min_rows) {
+    const int n = block.size();
+    std::vector<int> size(n_blocks, 0);
+    for (int r = 0; r < n; ++r) ++size[block[r]];
+    std::vector<int> order(n_blocks);
+    for (int b = 0; b < n_blocks; ++b) order[b] = b;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](const int a, const int b) { return size[a] > size[b]; });
+
+    // a block of min_rows or more is a group of its own, the smaller ones
+    // fill groups up to min_rows
+    std::vector<int> group_of_block(n_blocks, -1);
+    int n_groups = 0, open = -1, open_rows = 0;
+    for (const int b: order) {
+        if (size[b] == 0) break;
+        if (size[b] >= min_rows) {
+            group_of_block[b] = n_groups++;
+            continue;
+        }
+        if (open < 0 || open_rows >= min_rows) {
+            open = n_groups++;
+            open_rows = 0;
+        }
+        group_of_block[b] = open;
+        open_rows += size[b];
+    }
+
+    groups_.clear();
+    groups_.resize(n_groups);
+    for (int r = 0; r < n; ++r) groups_[group_of_block[block[r]]].rows.push_back(r);
+    std::stable_sort(groups_.begin(), groups_.end(), [](const Group& a, const Group& b) {
+        return a.rows.size() > b.rows.size();
+    });
+    local_.assign(n, 0);
+    for (const Group& group: groups_) {
+        for (size_t i = 0; i < group.rows.size(); ++i) local_[group.rows[i]] = int(i);
+    }
+    info_ = Eigen::Success;
+}
+
+void BlockDiagonalLDLT::factorize(const Eigen::SparseMatrix<double>& A) {
+    std::vector<char> failed(groups_.size(), 0);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int g = 0; g < int(groups_.size()); ++g) {
+        Group& group = groups_[g];
+        const int m = int(group.rows.size());
+
+        // the rows are ascending, so are their local rows: the columns of
+        // the block are copied in order
+        Eigen::SparseMatrix<double> sub(m, m);
+        size_t nonzeros = 0;
+        for (const int r: group.rows) {
+            nonzeros += A.outerIndexPtr()[r + 1] - A.outerIndexPtr()[r];
+        }
+        sub.reserve(nonzeros);
+        for (int j = 0; j < m; ++j) {
+            sub.startVec(j);
+            for (Eigen::SparseMatrix<double>::InnerIterator it(A, group.rows[j]); it; ++it) {
+                sub.insertBack(local_[it.row()], j) = it.value();
+            }
+        }
+        sub.finalize();
+
+        if (!group.ldlt) group.ldlt.reset(new Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> >());
+        if (!group.analyzed) {
+            group.ldlt->analyzePattern(sub);
+            group.analyzed = true;
+        }
+        group.ldlt->factorize(sub);
+        failed[g] = group.ldlt->info() != Eigen::Success;
+        if (failed[g]) group.analyzed = false;
+    }
+    info_ = std::count(failed.begin(), failed.end(), 1) ? Eigen::NumericalIssue : Eigen::Success;
+}
+
+void BlockDiagonalLDLT::solve(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) const {
+    X.resize(B.rows(), B.cols());
+    // the groups write disjoint rows of X
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int g = 0; g < int(groups_.size()); ++g) {
+        const Group& group = groups_[g];
+        const int m = int(group.rows.size());
+        group.b.resize(m, B.cols());
+        for (int i = 0; i < m; ++i) group.b.row(i) = B.row(group.rows[i]);
+        solve_ldlt_xyz(*group.ldlt, group.b, group.x, group.work);
+        for (int i = 0; i < m; ++i) X.row(group.rows[i]) = group.x.row(i);
+    }
+}
+
+size_t BlockDiagonalLDLT::memory_usage() const {
+    size_t bytes = local_.capacity() * sizeof(int);
+    for (const Group& group: groups_) {
+        bytes += group.rows.capacity() * sizeof(int) +
+                 size_t(group.b.size() + group.x.size()) * sizeof(double) +
+                 group.work.capacity() * sizeof(double);
+        if (group.ldlt && group.analyzed) {
+            bytes += size_t(group.ldlt->matrixL().nestedExpression().nonZeros()) *
+                         (sizeof(double) + sizeof(int)) +
+                     size_t(group.ldlt->vectorD().size()) * sizeof(double);
+        }
+    }
+    return bytes;
+}
+
+void BlockDiagonalLDLT::clear() {
+    groups_.clear();
+    local_.clear();
+    info_ = Eigen::Success;
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <Eigen/Sparse>
+#include <memory>
+#include <vector>
+
+namespace mesh_processing {
+
+// component[v] in [0, n_components) for every vertex, connected by edges;
+// the components are numbered in the order of their smallest vertex, so
+// the labels do not depend on the number of threads. Union-find over the
+// edges in parallel: every root links under the smaller of the two, with a
+// compare-and-swap, and the finds halve their paths. Returns n_components.
+int connected_components(const surface_mesh::Surface_mesh& mesh, std::vector<int>& component);
+
+// LDLT of a block diagonal SPD matrix, e.g. the Laplacian of a scan in many
+// pieces, one factorization per block and all of them concurrently. Small
+// blocks are packed into groups of about min_rows rows, which are factorized
+// as one matrix. The groups are factorized and solved largest first, each
+// thread takes the next one once it is done, so a few large blocks do not
+// wait for the many small ones. Call set_blocks() whenever the pattern
+// changes, then factorize() for every new set of values.
+class BlockDiagonalLDLT {
+
+public:
+    // block[r] in [0, n_blocks) of every row r; A must not couple the rows
+    // of different blocks
+    void set_blocks(const std::vector<int>& block, const int n_blocks, const int min_rows);
+    // number of groups, 1 means there is nothing to gain over one LDLT
+    int n_groups() const { return int(groups_.size()); }
+
+    // analyzes the pattern of every group on the first call after
+    // set_blocks()
+    void factorize(const Eigen::SparseMatrix<double>& A);
+    Eigen::ComputationInfo info() const { return info_; }
+    // X = A^-1 B for the three columns of B
+    void solve(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) const;
+
+    // bytes of the factors and row lists
+    size_t memory_usage() const;
+    void clear();
+
+private:
+    struct Group {
+        // rows of A in the group, ascending
+        std::vector<int> rows;
+        std::unique_ptr< Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > > ldlt;
+        bool analyzed = false;
+        mutable Eigen::MatrixXd b, x;
+        mutable std::vector<double> work;
+    };
+    // position of each row in its group
+    std::vector<int> local_;
+    std::vector<Group> groups_;
+    Eigen::ComputationInfo info_ = Eigen::Success;
+};
+
+}
+
+#endif // COMPONENTS_H
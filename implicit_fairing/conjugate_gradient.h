@@ -0,0 +1,75 @@
+#ifndef CONJUGATE_GRADIENT_H
+#define CONJUGATE_GRADIENT_H
+
+#include <Eigen/Sparse>
+#include "async_job.h"
+
+namespace mesh_processing {
+
+// Eigen::ConjugateGradient::solveWithGuess() on the computed solver cg, the
+// same iteration with the same expressions, which also stops once progress
+// is cancelled or expired; X then holds the iterate of that moment, the best
+// solution so far. iterations, error and the returned info are those of the
+// last column like cg.iterations(), cg.error() and cg.info(); stopped is
+// set if progress ended the solve.
+template <typename Solver>
+Eigen::ComputationInfo conjugate_gradient(const Solver& cg, const Eigen::SparseMatrix<double>& A,
+                                          const Eigen::MatrixXd& B, Eigen::MatrixXd& X,
+                                          const JobProgress* progress, int& iterations,
+                                          double& error, bool& stopped) {
+    const auto mat = A.selfadjointView<Solver::UpLo>();
+    const typename Solver::Preconditioner& precond = cg.preconditioner();
+    const int n = int(A.cols());
+    const double tolerance = cg.tolerance();
+    stopped = false;
+    iterations = 0;
+    error = 0.0;
+    for (int j = 0; j < B.cols() && !stopped; ++j) {
+        Eigen::MatrixXd::ColXpr x = X.col(j);
+        const Eigen::MatrixXd::ConstColXpr rhs = B.col(j);
+        Eigen::VectorXd residual = rhs - mat * x;
+        const double rhs_norm2 = rhs.squaredNorm();
+        iterations = 0;
+        if (rhs_norm2 == 0) {
+            x.setZero();
+            error = 0.0;
+            continue;
+        }
+        const double threshold = tolerance * tolerance * rhs_norm2;
+        double residual_norm2 = residual.squaredNorm();
+        if (residual_norm2 < threshold) {
+            error = std::sqrt(residual_norm2 / rhs_norm2);
+            continue;
+        }
+
+        Eigen::VectorXd p(n), z(n), tmp(n);
+        p = precond.solve(residual);
+        double abs_new = residual.dot(p);
+        int i = 0;
+        while (i < cg.maxIterations()) {
+            tmp.noalias() = mat * p;
+            const double alpha = abs_new / p.dot(tmp);
+            x += alpha * p;
+            residual -= alpha * tmp;
+            residual_norm2 = residual.squaredNorm();
+            if (residual_norm2 < threshold) break;
+            // x is consistent with the residual here
+            if (progress && progress->stopped()) {
+                stopped = true;
+                break;
+            }
+            z = precond.solve(residual);
+            const double abs_old = abs_new;
+            abs_new = residual.dot(z);
+            p = z + (abs_new / abs_old) * p;
+            ++i;
+        }
+        error = std::sqrt(residual_norm2 / rhs_norm2);
+        iterations = i;
+    }
+    return error <= tolerance ? Eigen::Success : Eigen::NoConvergence;
+}
+
+}
+
+#endif // CONJUGATE_GRADIENT_H
@@ -0,0 +1,63 @@
+#include "cpu_features.h"
+#include <cstdlib>
+#include <cstring>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace mesh_processing {
+
+static SIMD_LEVEL detect_simd_level() {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    // also checks that the OS saves the wide registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+        __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+        __builtin_cpu_supports("f16c")) {
+        return SIMD_AVX2;
+    }
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return SIMD_BASELINE;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool f16c = (info[2] & (1 << 29)) != 0;
+    if (!osxsave) return SIMD_BASELINE;
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0;
+    // F, DQ, BW and VL in EBX; the OS saves the opmask and the upper zmm
+    const bool avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 17)) &&
+                        (info[1] & (1 << 30)) && (info[1] & (1u << 31)) &&
+                        (xcr0 & 0xe6) == 0xe6;
+    if (avx512) return SIMD_AVX512;
+    if (avx2 && fma && f16c && (xcr0 & 0x6) == 0x6) return SIMD_AVX2;
+#endif
+    return SIMD_BASELINE;
+}
+
+SIMD_LEVEL cpu_simd_level() {
+    static const SIMD_LEVEL level = [] {
+        SIMD_LEVEL detected = detect_simd_level();
+        if (const char* cap = std::getenv("GP_SIMD")) {
+            const SIMD_LEVEL requested = strcmp(cap, "avx512") == 0 ? SIMD_AVX512
+                                       : strcmp(cap, "avx2") == 0 ? SIMD_AVX2
+                                       : SIMD_BASELINE;
+            if (requested < detected) detected = requested;
+        }
+        return detected;
+    }();
+    return level;
+}
+
+const char* simd_level_name(const SIMD_LEVEL level) {
+    return level == SIMD_AVX512 ? "avx512" : level == SIMD_AVX2 ? "avx2" : "baseline";
+}
+
+}
@@ -0,0 +1,19 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+namespace mesh_processing {
+
+// Vector extensions the kernels of geometry_kernels.h are compiled for, in
+// increasing order. AVX2 includes FMA and F16C, AVX512 the F, VL, BW and DQ subsets
+// of the Skylake server and later Xeon and Zen 4 EPYC cores.
+enum SIMD_LEVEL : int { SIMD_BASELINE = 0, SIMD_AVX2 = 1, SIMD_AVX512 = 2 };
+
+// the widest level the processor and the operating system support, read
+// once; the environment variable GP_SIMD=baseline|avx2|avx512 caps it, e.g.
+// for comparing the variants on one machine
+SIMD_LEVEL cpu_simd_level();
+const char* simd_level_name(const SIMD_LEVEL level);
+
+}
+
+#endif // CPU_FEATURES_H
@@ -0,0 +1,255 @@
+#include "decimation.h"
+#include "async_job.h"
+#include "independent_edges.h"
+#include <surface_mesh/Trace.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+typedef surface_mesh::Surface_mesh Mesh;
+
+// the planes through boundary edges count as much as a face of this many
+// times the squared edge length, which keeps the boundary in place
+static const double BOUNDARY_WEIGHT = 100.0;
+// key of an edge that cannot be collapsed
+static const uint64_t NO_COLLAPSE = NO_EDGE_KEY;
+
+// sum of w (n.x + d)^2 over planes as the symmetric 4x4 matrix
+// [A b; b^T c], upper triangle row by row
+struct Quadric {
+    double q[10];
+
+    Quadric() { std::fill(q, q + 10, 0.0); }
+    // the plane through p with unit normal n, weighted by w
+    Quadric(const Point& n, const Point& p, const double w) {
+        const double a = n[0], b = n[1], c = n[2], d = -dot(n, p);
+        const double v[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+        for (int i = 0; i < 10; ++i) q[i] = w * v[i];
+    }
+    Quadric& operator+=(const Quadric& o) {
+        for (int i = 0; i < 10; ++i) q[i] += o.q[i];
+        return *this;
+    }
+    double operator()(const Point& p) const {
+        const double x = p[0], y = p[1], z = p[2];
+        return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x +
+               q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y +
+               q[7] * z * z + 2.0 * q[8] * z + q[9];
+    }
+    // the minimum of the quadric, false if A is close to singular, e.g.
+    // for the planes of a flat or a cylindrical region
+    bool minimum(Point& p) const {
+        const double c00 = q[4] * q[7] - q[5] * q[5];
+        const double c01 = q[2] * q[5] - q[1] * q[7];
+        const double c02 = q[1] * q[5] - q[2] * q[4];
+        const double det = q[0] * c00 + q[1] * c01 + q[2] * c02;
+        const double scale = q[0] * q[4] * q[7];
+        if (!(std::fabs(det) > 1e-10 * scale) || scale <= 0.0) return false;
+        const double c11 = q[0] * q[7] - q[2] * q[2];
+        const double c12 = q[1] * q[2] - q[0] * q[5];
+        const double c22 = q[0] * q[4] - q[1] * q[1];
+        const double b0 = -q[3], b1 = -q[6], b2 = -q[8];
+        p = Point(Scalar((c00 * b0 + c01 * b1 + c02 * b2) / det),
+                  Scalar((c01 * b0 + c11 * b1 + c12 * b2) / det),
+                  Scalar((c02 * b0 + c12 * b1 + c22 * b2) / det));
+        return true;
+    }
+};
+
+// the planes of the faces around v weighted by their area, and those
+// through its boundary edges
+static Quadric vertex_quadric(const Mesh& mesh, const Mesh::Vertex v) {
+    Quadric quadric;
+    for (auto h: mesh.halfedges(v)) {
+        if (mesh.is_boundary(h)) continue;
+        const Point& p = mesh.position(v);
+        const Point d0 = mesh.position(mesh.to_vertex(h)) - p;
+        const Point d1 = mesh.position(mesh.to_vertex(mesh.next_halfedge(h))) - p;
+        Point n = cross(d0, d1);
+        const Scalar double_area = norm(n);
+        if (double_area <= std::numeric_limits<Scalar>::min()) continue;
+        n /= double_area;
+        quadric += Quadric(n, p, 0.5 * double_area);
+
+        // the edges of the face at v that have no face on the other side
+        for (const Mesh::Halfedge e: { h, mesh.prev_halfedge(h) }) {
+            if (!mesh.is_boundary(mesh.opposite_halfedge(e))) continue;
+            const Point d = mesh.position(mesh.to_vertex(e)) - mesh.position(mesh.from_vertex(e));
+            Point side = cross(d, n);
+            const Scalar length = norm(side);
+            if (length <= std::numeric_limits<Scalar>::min()) continue;
+            side /= length;
+            quadric += Quadric(side, p, BOUNDARY_WEIGHT * sqrnorm(d));
+        }
+    }
+    return quadric;
+}
+
+// a collapse of the halfedge h moves to_vertex(h) to position and removes
+// from_vertex(h)
+class Decimator {
+
+public:
+    Decimator(Mesh& mesh, const DecimationOptions& options)
+        : mesh_(mesh), options_(options),
+          min_cos_(std::cos(options.max_normal_angle * Scalar(M_PI / 180.0))) {}
+
+    unsigned int run(JobProgress* progress, std::vector<EdgeCollapse>* record);
+
+private:
+    // the key of the collapse of edge e, cost bits above the index so the
+    // order is by cost and then by index; NO_COLLAPSE if it is not allowed
+    uint64_t evaluate(const int e, Mesh::Halfedge& h, Point& position) const;
+    // no face around the two vertices of h turns by more than the limit or
+    // degenerates when both are replaced by position
+    bool normals_ok(const Mesh::Halfedge h, const Point& position) const;
+
+    Mesh& mesh_;
+    const DecimationOptions& options_;
+    const Scalar min_cos_;
+    std::vector<Quadric> quadrics_;
+};
+
+bool Decimator::normals_ok(const Mesh::Halfedge h, const Point& position) const {
+    const Mesh::Vertex removed = mesh_.from_vertex(h), kept = mesh_.to_vertex(h);
+    for (const Mesh::Vertex v: { removed, kept }) {
+        for (auto g: mesh_.halfedges(v)) {
+            if (mesh_.is_boundary(g)) continue;
+            const Mesh::Vertex a = mesh_.to_vertex(g);
+            const Mesh::Vertex b = mesh_.to_vertex(mesh_.next_halfedge(g));
+            // the two faces of the edge are removed
+            if (a == removed || a == kept || b == removed || b == kept) continue;
+            const Point& p = mesh_.position(v);
+            const Point& pa = mesh_.position(a);
+            const Point& pb = mesh_.position(b);
+            const Point before = cross(pa - p, pb - p);
+            const Point after = cross(pa - position, pb - position);
+            const Scalar length = norm(after);
+            if (length <= std::numeric_limits<Scalar>::min()) return false;
+            if (dot(before, after) < min_cos_ * norm(before) * length) return false;
+        }
+    }
+    return true;
+}
+
+uint64_t Decimator::evaluate(const int e, Mesh::Halfedge& h, Point& position) const {
+    const Mesh::Edge edge(e);
+    if (mesh_.is_deleted(edge)) return NO_COLLAPSE;
+    h = mesh_.halfedge(edge, 0);
+    const Mesh::Vertex a = mesh_.from_vertex(h), b = mesh_.to_vertex(h);
+    const bool boundary_a = mesh_.is_boundary(a), boundary_b = mesh_.is_boundary(b);
+
+    Quadric quadric = quadrics_[a.idx()];
+    quadric += quadrics_[b.idx()];
+    if (boundary_a != boundary_b) {
+        // the boundary vertex stays where it is
+        if (boundary_a) h = mesh_.opposite_halfedge(h);
+        position = mesh_.position(mesh_.to_vertex(h));
+    } else if (!quadric.minimum(position)) {
+        // the best of the ends and the midpoint
+        const Point& pa = mesh_.position(a);
+        const Point& pb = mesh_.position(b);
+        const Point candidates[3] = { pa, pb, 0.5f * (pa + pb) };
+        position = candidates[0];
+        double best = quadric(position);
+        for (int k = 1; k < 3; ++k) {
+            const double error = quadric(candidates[k]);
+            if (error < best) {
+                best = error;
+                position = candidates[k];
+            }
+        }
+    }
+
+    const double cost = std::max(quadric(position), 0.0);
+    if (!(cost <= options_.max_error)) return NO_COLLAPSE;
+    if (!mesh_.is_collapse_ok(h) || !normals_ok(h, position)) return NO_COLLAPSE;
+    const float cost_float = float(cost);
+    uint32_t bits;
+    std::memcpy(&bits, &cost_float, sizeof(bits));
+    return (uint64_t(bits) << 32) | uint32_t(e);
+}
+
+unsigned int Decimator::run(JobProgress* progress, std::vector<EdgeCollapse>* record) {
+    SURFACE_MESH_TRACE_ZONE("decimate");
+    const int n_vertices = mesh_.vertices_size();
+    const int n_edges = mesh_.edges_size();
+    const size_t target = options_.target_faces;
+    const size_t start_faces = mesh_.n_faces();
+    if (start_faces <= target) return 0;
+
+    quadrics_.resize(n_vertices);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i) {
+        Mesh::Vertex v(i);
+        if (!mesh_.is_deleted(v) && !mesh_.is_isolated(v)) quadrics_[i] = vertex_quadric(mesh_, v);
+    }
+
+    std::vector<uint64_t> keys(n_edges, NO_COLLAPSE);
+    std::vector<Mesh::Halfedge> halfedges(n_edges);
+    std::vector<Point> positions(n_edges);
+    // vertices whose edges need new keys, all at first
+    std::vector<unsigned char> dirty(n_vertices, 1);
+    IndependentEdges independent;
+    unsigned int n_collapses = 0;
+
+    while (mesh_.n_faces() > target) {
+        // keys of the edges at changed vertices
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int e = 0; e < n_edges; ++e) {
+            const Mesh::Edge edge(e);
+            if (mesh_.is_deleted(edge)) {
+                keys[e] = NO_COLLAPSE;
+                continue;
+            }
+            if (dirty[mesh_.vertex(edge, 0).idx()] || dirty[mesh_.vertex(edge, 1).idx()]) {
+                keys[e] = evaluate(e, halfedges[e], positions[e]);
+            }
+        }
+        std::fill(dirty.begin(), dirty.end(), 0);
+
+        // the one-rings of the selected edges are disjoint, so their
+        // collapses do not change each other
+        const std::vector<int>& collapses = independent.select(mesh_, keys);
+        if (collapses.empty()) break;
+
+        // the collapses were tested before, so the boundary halfedges are
+        // repaired once per round
+        mesh_.begin_topology_batch();
+        for (const int e: collapses) {
+            if (mesh_.n_faces() <= target) break;
+            const Mesh::Halfedge h = halfedges[e];
+            const Mesh::Vertex removed = mesh_.from_vertex(h), kept = mesh_.to_vertex(h);
+            quadrics_[kept.idx()] += quadrics_[removed.idx()];
+            mesh_.collapse(h);
+            mesh_.position(kept) = positions[e];
+            if (record) record->push_back({ removed.idx(), kept.idx(), positions[e] });
+            all_of_closed_ring(mesh_, kept, [&](const Mesh::Vertex u) { dirty[u.idx()] = 1; return true; });
+            ++n_collapses;
+        }
+        mesh_.end_topology_batch();
+        if (progress && !progress->report(float(start_faces - mesh_.n_faces()) /
+                                          float(start_faces - target))) {
+            break;
+        }
+    }
+
+    mesh_.garbage_collection();
+    if (mesh_.get_vertex_property<Point>("v:normal")) mesh_.update_vertex_normals();
+    return n_collapses;
+}
+
+unsigned int decimate(Mesh& mesh, const DecimationOptions& options, JobProgress* progress,
+                      std::vector<EdgeCollapse>* collapses) {
+    if (!mesh.is_triangle_mesh()) return 0;
+    Decimator decimator(mesh, options);
+    return decimator.run(progress, collapses);
+}
+
+}
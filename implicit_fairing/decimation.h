@@ -0,0 +1,53 @@
+#ifndef DECIMATION_H
+#define DECIMATION_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <limits>
+#include <vector>
+
+namespace mesh_processing {
+
+class JobProgress;
+
+struct DecimationOptions {
+    // no collapses once the mesh has at most this many faces, 0 for none
+    unsigned int target_faces = 0;
+    // largest quadric error of a collapse, about the squared distance the
+    // surface moves, in mesh units
+    float max_error = std::numeric_limits<float>::max();
+    // largest angle in degrees a face normal may turn in a collapse
+    float max_normal_angle = 60.0f;
+};
+
+// one collapse of decimate(): removed was merged into kept, which moved to
+// position; indices of the mesh before the collapses
+struct EdgeCollapse {
+    int removed;
+    int kept;
+    surface_mesh::Point position;
+};
+
+// Quadric error edge collapse simplification of a triangle mesh. Each
+// collapse removes one vertex of an edge and moves the other one to the
+// point of least summed squared distance to the planes of the faces it
+// replaces (Garland and Heckbert); boundaries are held by planes through
+// their edges. The collapses run in rounds: the costs of the edges whose
+// neighbourhood changed in the last round are recomputed in parallel, then
+// every edge that is the cheapest among the edges around the one-rings of
+// its ends is collapsed, cheapest first. These are independent, so a round
+// gives the result of the greedy order within each neighbourhood; the
+// same on any number of threads.
+//
+// The remaining vertices keep their properties, v:normal is recomputed if
+// there is one; the deleted elements are removed by garbage_collection()
+// at the end. Returns the number of collapses, 0 for a mesh that is not a
+// triangle mesh. Cancelled through progress, the mesh is valid then. The
+// collapses are appended to collapses in the order they were made, e.g. for
+// write_progressive_mesh().
+unsigned int decimate(surface_mesh::Surface_mesh& mesh, const DecimationOptions& options,
+                      JobProgress* progress = nullptr,
+                      std::vector<EdgeCollapse>* collapses = nullptr);
+
+}
+
+#endif // DECIMATION_H
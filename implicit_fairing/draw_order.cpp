@@ -0,0 +1,200 @@
+#include "draw_order.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace mesh_processing {
+
+void optimize_draw_order(const Eigen::Map<const Eigen::Matrix3Xf>& points, uint32_t* indices,
+                         const int n_triangles, const int cache_size) {
+    const int n = int(points.cols());
+    if (n_triangles == 0 || n == 0) return;
+
+    // the triangles around every vertex, and how many of them are not yet
+    // emitted
+    std::vector<int> offsets(n + 1, 0), incident(3 * size_t(n_triangles)), live(n);
+    for (int i = 0; i < 3 * n_triangles; ++i) ++offsets[indices[i] + 1];
+    for (int v = 0; v < n; ++v) {
+        live[v] = offsets[v + 1];
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < 3 * n_triangles; ++i) incident[fill[indices[i]]++] = i / 3;
+
+    // cache_time[v] is the time v entered the simulated cache, it is still
+    // in there while time - cache_time[v] <= cache_size
+    std::vector<int> cache_time(n, 0), dead_end, candidates;
+    std::vector<char> emitted(n_triangles, 0);
+    std::vector<int> order, cluster_start(1, 0);
+    order.reserve(n_triangles);
+    dead_end.reserve(3 * size_t(n_triangles));
+    int time = cache_size + 1;
+    int cursor = 0;
+    int fan = 0;
+    while (fan < n && live[fan] == 0) ++fan;
+    cursor = fan;
+
+    while (fan >= 0 && fan < n) {
+        // the remaining triangles around fan
+        candidates.clear();
+        for (int p = offsets[fan]; p < offsets[fan + 1]; ++p) {
+            const int t = incident[p];
+            if (emitted[t]) continue;
+            emitted[t] = 1;
+            order.push_back(t);
+            for (int k = 0; k < 3; ++k) {
+                const int v = int(indices[3 * t + k]);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cache_time[v] > cache_size) cache_time[v] = time++;
+            }
+        }
+
+        // the oldest candidate that is still cached after its own fan
+        int best = -1, best_priority = -1;
+        for (const int v : candidates) {
+            if (live[v] == 0) continue;
+            int priority = 0;
+            if (time - cache_time[v] + 2 * live[v] <= cache_size) priority = time - cache_time[v];
+            if (priority > best_priority) {
+                best = v;
+                best_priority = priority;
+            }
+        }
+        if (best == -1) {
+            // a dead end: the latest vertex with triangles left, else the
+            // next one in input order; the cache is cold, a new cluster
+            // begins
+            while (!dead_end.empty() && best == -1) {
+                const int v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0) best = v;
+            }
+            while (best == -1 && cursor < n) {
+                if (live[cursor] > 0) best = cursor;
+                ++cursor;
+            }
+            if (best != -1) cluster_start.push_back(int(order.size()));
+        }
+        fan = best;
+    }
+    cluster_start.push_back(int(order.size()));
+
+    // the clusters by their centroid and normal, relative to the area
+    // weighted center of the mesh
+    const int n_clusters = int(cluster_start.size()) - 1;
+    std::vector<Eigen::Vector3d> centroid(n_clusters), normal(n_clusters);
+    Eigen::Vector3d center = Eigen::Vector3d::Zero();
+    double area = 0.0;
+    for (int c = 0; c < n_clusters; ++c) {
+        Eigen::Vector3d sum = Eigen::Vector3d::Zero(), area_normal = Eigen::Vector3d::Zero();
+        double cluster_area = 0.0;
+        for (int j = cluster_start[c]; j < cluster_start[c + 1]; ++j) {
+            const uint32_t* tri = indices + 3 * size_t(order[j]);
+            const Eigen::Vector3d a = points.col(tri[0]).cast<double>();
+            const Eigen::Vector3d b = points.col(tri[1]).cast<double>();
+            const Eigen::Vector3d d = points.col(tri[2]).cast<double>();
+            const Eigen::Vector3d e1 = b - a, e2 = d - a;
+            const Eigen::Vector3d cross(e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                                        e1[0] * e2[1] - e1[1] * e2[0]);
+            const double w = 0.5 * cross.norm();
+            sum += w * (a + b + d) / 3.0;
+            area_normal += cross;
+            cluster_area += w;
+        }
+        center += sum;
+        area += cluster_area;
+        centroid[c] = cluster_area > 0.0 ? Eigen::Vector3d(sum / cluster_area) : Eigen::Vector3d(sum);
+        const double length = area_normal.norm();
+        normal[c] = length > 0.0 ? Eigen::Vector3d(area_normal / length) : Eigen::Vector3d::Zero();
+    }
+    if (area > 0.0) center /= area;
+
+    std::vector<double> score(n_clusters);
+    for (int c = 0; c < n_clusters; ++c) score[c] = (centroid[c] - center).dot(normal[c]);
+    std::vector<int> clusters(n_clusters);
+    for (int c = 0; c < n_clusters; ++c) clusters[c] = c;
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [&](const int a, const int b) { return score[a] > score[b]; });
+
+    std::vector<uint32_t> sorted(3 * size_t(n_triangles));
+    size_t j = 0;
+    for (const int c : clusters) {
+        for (int k = cluster_start[c]; k < cluster_start[c + 1]; ++k) {
+            const uint32_t* tri = indices + 3 * size_t(order[k]);
+            sorted[j++] = tri[0];
+            sorted[j++] = tri[1];
+            sorted[j++] = tri[2];
+        }
+    }
+    std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void DrawClusters::build(const Eigen::Map<const Eigen::Matrix3Xf>& points, const uint32_t* indices,
+                         const int n_triangles, const int cluster_size) {
+    ranges_.clear();
+    for (int first = 0; first < n_triangles; first += cluster_size) {
+        const Range r = { uint32_t(first), uint32_t(std::min(cluster_size, n_triangles - first)) };
+        ranges_.push_back(r);
+    }
+    spheres_.resize(ranges_.size());
+    refit(points, indices);
+}
+
+void DrawClusters::refit(const Eigen::Map<const Eigen::Matrix3Xf>& points, const uint32_t* indices) {
+    const int n = n_clusters();
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < n; ++c) {
+        // sphere around the box center through the farthest vertex
+        const size_t begin = 3 * size_t(ranges_[c].first);
+        const size_t end = begin + 3 * size_t(ranges_[c].count);
+        Eigen::Vector3f lo = points.col(indices[begin]), hi = lo;
+        for (size_t j = begin + 1; j < end; ++j) {
+            lo = lo.cwiseMin(points.col(indices[j]));
+            hi = hi.cwiseMax(points.col(indices[j]));
+        }
+        const Eigen::Vector3f center = 0.5f * (lo + hi);
+        float radius = 0.0f;
+        for (size_t j = begin; j < end; ++j) {
+            radius = std::max(radius, (points.col(indices[j]) - center).squaredNorm());
+        }
+        spheres_[c] << center, std::sqrt(radius);
+    }
+}
+
+void DrawClusters::select(const Eigen::Matrix4f& model_view, const Eigen::Matrix4f& projection,
+                          std::vector<Range>& ranges) const {
+    ranges.clear();
+    Eigen::Vector4f planes[6];
+    frustum_planes(model_view, projection, planes);
+    for (int c = 0; c < n_clusters(); ++c) {
+        const Eigen::Vector4f& sphere = spheres_[c];
+        bool visible = true;
+        for (const Eigen::Vector4f& plane: planes) {
+            if (plane.head<3>().dot(sphere.head<3>()) + plane[3] < -sphere[3]) visible = false;
+        }
+        if (!visible) continue;
+        const Range& r = ranges_[c];
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == r.first) {
+            ranges.back().count += r.count;
+        } else {
+            ranges.push_back(r);
+        }
+    }
+}
+
+double average_cache_miss_ratio(const uint32_t* indices, const int n_triangles,
+                                const int n_vertices, const int cache_size) {
+    if (n_triangles == 0) return 0.0;
+    // v is cached while fewer than cache_size misses followed its own
+    std::vector<long> entered(n_vertices, -long(cache_size) - 1);
+    long misses = 0;
+    for (int i = 0; i < 3 * n_triangles; ++i) {
+        const uint32_t v = indices[i];
+        if (misses - entered[v] > cache_size) entered[v] = misses++;
+    }
+    return double(misses) / n_triangles;
+}
+
+}
@@ -0,0 +1,61 @@
+#ifndef DRAW_ORDER_H
+#define DRAW_ORDER_H
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <vector>
+#include "lod.h"
+
+namespace mesh_processing {
+
+// Triangle order of an index buffer for the GPU, after Sander, Nehab and
+// Barczak, "Fast triangle reordering for vertex locality and reduced
+// overdraw" (Tipsy): the triangles are emitted fan by fan around the vertex
+// most likely still in a post-transform cache of cache_size entries, which
+// splits them into clusters at every jump to a cold part of the mesh. The
+// clusters are then drawn outward facing first, by the distance of their
+// centroid from the center of the mesh along their normal, so the front
+// surfaces of a closed mesh tend to cover the ones behind them.
+//
+// indices holds 3 vertex indices per triangle and is reordered in place,
+// the triangles keep their orientation. Runs in linear time.
+void optimize_draw_order(const Eigen::Map<const Eigen::Matrix3Xf>& points, uint32_t* indices,
+                         const int n_triangles, const int cache_size = 16);
+
+// vertex shader invocations per triangle of indices in a FIFO cache of
+// cache_size entries, 3 without any reuse and about 0.6 at best on large
+// meshes
+double average_cache_miss_ratio(const uint32_t* indices, const int n_triangles,
+                                const int n_vertices, const int cache_size = 16);
+
+// Bounding spheres of runs of consecutive triangles of an index buffer, so
+// the runs outside the view frustum are not drawn. The draw order above
+// keeps the triangles of a run close to each other. build() once per index
+// buffer, refit() after the vertices moved.
+class DrawClusters {
+
+public:
+    typedef LodHierarchy::Range Range;
+
+    void build(const Eigen::Map<const Eigen::Matrix3Xf>& points, const uint32_t* indices,
+               const int n_triangles, const int cluster_size = 512);
+    void refit(const Eigen::Map<const Eigen::Matrix3Xf>& points, const uint32_t* indices);
+    bool empty() const { return ranges_.empty(); }
+    int n_clusters() const { return (int) ranges_.size(); }
+    size_t memory_usage() const {
+        return ranges_.capacity() * sizeof(Range) + spheres_.capacity() * sizeof(Eigen::Vector4f);
+    }
+
+    // the ranges of the clusters in the view frustum, neighbours merged
+    void select(const Eigen::Matrix4f& model_view, const Eigen::Matrix4f& projection,
+                std::vector<Range>& ranges) const;
+
+private:
+    std::vector<Range> ranges_;
+    // center and radius
+    std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f> > spheres_;
+};
+
+}
+
+#endif // DRAW_ORDER_H
@@ -0,0 +1,52 @@
+#ifndef EIGEN_INTEROP_H
+#define EIGEN_INTEROP_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <Eigen/Core>
+
+// 3 x n views over the storage of Point/Normal vertex properties
+typedef Eigen::Map<Eigen::Matrix3Xf> Matrix3XfMap;
+typedef Eigen::Map<const Eigen::Matrix3Xf> ConstMatrix3XfMap;
+// 1 x n view over the storage of a Scalar vertex property
+typedef Eigen::Map<const Eigen::Matrix<float, 1, Eigen::Dynamic> > ConstRowXfMap;
+// 4 x n view over the storage of a Color8 vertex property
+typedef Eigen::Map<const Eigen::Matrix<uint8_t, 4, Eigen::Dynamic> > ConstMatrix4Xu8Map;
+
+namespace mesh_processing {
+
+// Point is three packed floats, so a Point is a Vector3f and a Point
+// property array is a 3 x n matrix in place, e.g.
+//     as_eigen(mesh.points()).colwise() -= shift;
+// the views alias the mesh storage and are invalidated with it
+static_assert(sizeof(surface_mesh::Point) == 3 * sizeof(float), "Point must be tightly packed");
+
+inline Eigen::Map<Eigen::Vector3f> as_eigen(surface_mesh::Point& p) {
+    return Eigen::Map<Eigen::Vector3f>(p.data());
+}
+inline Eigen::Map<const Eigen::Vector3f> as_eigen(const surface_mesh::Point& p) {
+    return Eigen::Map<const Eigen::Vector3f>(p.data());
+}
+inline Matrix3XfMap as_eigen(surface_mesh::Property_vector<surface_mesh::Point>& points) {
+    return Matrix3XfMap(points.data()->data(), 3, points.size());
+}
+inline ConstMatrix3XfMap as_eigen(const surface_mesh::Property_vector<surface_mesh::Point>& points) {
+    return ConstMatrix3XfMap(points.data()->data(), 3, points.size());
+}
+// the read-only view of a property the caller may write to
+inline ConstMatrix3XfMap as_const_eigen(const surface_mesh::Property_vector<surface_mesh::Point>& points) {
+    return as_eigen(points);
+}
+
+static_assert(sizeof(surface_mesh::Color8) == 4, "Color8 must be tightly packed");
+
+inline ConstMatrix4Xu8Map as_const_eigen(const surface_mesh::Property_vector<surface_mesh::Color8>& colors) {
+    return ConstMatrix4Xu8Map(colors.data()->data(), 4, colors.size());
+}
+
+inline surface_mesh::Point to_point(const Eigen::Vector3f& v) {
+    return surface_mesh::Point(v[0], v[1], v[2]);
+}
+
+}
+
+#endif // EIGEN_INTEROP_H
@@ -0,0 +1,190 @@
+#include "frozen_mesh.h"
+#include "reduction.h"
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+typedef surface_mesh::Surface_mesh Mesh;
+
+void FrozenMesh::freeze(const Mesh& mesh) {
+    clear();
+
+    // frozen index of every live vertex
+    const int n_slots = mesh.vertices_size();
+    std::vector<int> index(n_slots, -1);
+    int n_vertices = 0;
+    for (auto v: mesh.vertices()) index[v.idx()] = n_vertices++;
+    if (n_vertices != n_slots) {
+        source_.resize(n_vertices);
+        for (auto v: mesh.vertices()) source_[index[v.idx()]] = v.idx();
+    }
+
+    offsets_.assign(n_vertices + 1, 0);
+    boundary_.assign(n_vertices, 0);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i) {
+        const Mesh::Vertex v(source_vertex(i));
+        offsets_[i + 1] = mesh.valence(v);
+        boundary_[i] = mesh.is_boundary(v);
+    }
+    for (int i = 0; i < n_vertices; ++i) offsets_[i + 1] += offsets_[i];
+    neighbors_.resize(offsets_[n_vertices]);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i) {
+        int k = offsets_[i];
+        for (auto w: mesh.vertices(Mesh::Vertex(source_vertex(i)))) neighbors_[k++] = index[w.idx()];
+    }
+
+    // polygons are fanned around their first vertex, the triangles of a
+    // face stay consecutive so that thaw() finds them again
+    bool polygons = false;
+    size_t n_triangles = 0;
+    for (auto f: mesh.faces()) {
+        const unsigned int valence = mesh.valence(f);
+        n_triangles += valence - 2;
+        polygons |= valence != 3;
+    }
+    triangles_.reserve(3 * n_triangles);
+    if (polygons) triangle_faces_.reserve(n_triangles);
+    int face = 0;
+    for (auto f: mesh.faces()) {
+        auto fv = mesh.vertices(f);
+        const int v0 = index[(*fv).idx()];
+        ++fv;
+        int v1 = index[(*fv).idx()];
+        for (unsigned int k = 2; k < mesh.valence(f); ++k) {
+            ++fv;
+            const int v2 = index[(*fv).idx()];
+            triangles_.push_back(v0);
+            triangles_.push_back(v1);
+            triangles_.push_back(v2);
+            if (polygons) triangle_faces_.push_back(face);
+            v1 = v2;
+        }
+        ++face;
+    }
+
+    set_positions(mesh);
+}
+
+void FrozenMesh::set_positions(const Mesh& mesh) {
+    const int n = n_vertices();
+    positions_.x.resize(n);
+    positions_.y.resize(n);
+    positions_.z.resize(n);
+    const auto& points = mesh.points();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        const Point& p = points[source_vertex(i)];
+        positions_.x[i] = p[0];
+        positions_.y[i] = p[1];
+        positions_.z[i] = p[2];
+    }
+}
+
+void FrozenMesh::thaw(Mesh& mesh) const {
+    mesh.clear();
+    const int n = n_vertices();
+    mesh.reserve(n, neighbors_.size() / 2, n_triangles());
+    for (int i = 0; i < n; ++i) mesh.add_vertex(position(i));
+
+    std::vector<unsigned int> indices, valences;
+    if (triangle_faces_.empty()) {
+        indices.assign(triangles_.begin(), triangles_.end());
+        valences.assign(n_triangles(), 3);
+    } else {
+        // the first triangle of a face gives its first three vertices, every
+        // further one the next
+        indices.reserve(triangles_.size());
+        for (int t = 0; t < n_triangles(); ++t) {
+            if (t > 0 && triangle_faces_[t] == triangle_faces_[t - 1]) {
+                indices.push_back(triangles_[3 * t + 2]);
+                ++valences.back();
+                continue;
+            }
+            indices.insert(indices.end(), triangles_.begin() + 3 * t, triangles_.begin() + 3 * t + 3);
+            valences.push_back(3);
+        }
+    }
+    mesh.add_faces(indices, valences);
+}
+
+void FrozenMesh::clear() {
+    positions_ = SoAGeometry::Positions();
+    std::vector<int>().swap(offsets_);
+    std::vector<int>().swap(neighbors_);
+    std::vector<unsigned char>().swap(boundary_);
+    std::vector<int>().swap(triangles_);
+    std::vector<int>().swap(source_);
+    std::vector<int>().swap(triangle_faces_);
+}
+
+void FrozenMesh::bounding_box(Point& min, Point& max) const {
+    struct Bounds {
+        Point min, max;
+    };
+    const Bounds none = { n_vertices() > 0 ? position(0) : Point(0.0f, 0.0f, 0.0f),
+                          n_vertices() > 0 ? position(0) : Point(0.0f, 0.0f, 0.0f) };
+    const Bounds bounds = deterministic_reduce(n_vertices(), none, [&](const int i) {
+        const Bounds b = { position(i), position(i) };
+        return b;
+    }, [](const Bounds& a, const Bounds& b) {
+        Bounds c = a;
+        c.min.minimize(b.min);
+        c.max.maximize(b.max);
+        return c;
+    });
+    min = bounds.min;
+    max = bounds.max;
+}
+
+// the edges of triangle t from its first vertex
+static inline void triangle_edges(const FrozenMesh& frozen, const int t, Point& p0, Point& e1,
+                                  Point& e2) {
+    const int* v = frozen.triangles().data() + 3 * t;
+    p0 = frozen.position(v[0]);
+    e1 = frozen.position(v[1]) - p0;
+    e2 = frozen.position(v[2]) - p0;
+}
+
+double FrozenMesh::area() const {
+    return deterministic_sum(n_triangles(), 0.0, [&](const int t) {
+        Point p0, e1, e2;
+        triangle_edges(*this, t, p0, e1, e2);
+        return 0.5 * double(norm(cross(e1, e2)));
+    });
+}
+
+double FrozenMesh::volume() const {
+    return deterministic_sum(n_triangles(), 0.0, [&](const int t) {
+        Point p0, e1, e2;
+        triangle_edges(*this, t, p0, e1, e2);
+        return double(dot(p0, cross(e1, e2))) / 6.0;
+    });
+}
+
+void FrozenMesh::vertex_normals(std::vector<Point>& normals) const {
+    normals.assign(n_vertices(), Point(0.0f, 0.0f, 0.0f));
+    // twice the area in the length of the cross product
+    for (int t = 0; t < n_triangles(); ++t) {
+        Point p0, e1, e2;
+        triangle_edges(*this, t, p0, e1, e2);
+        const Point n = cross(e1, e2);
+        for (int k = 0; k < 3; ++k) normals[triangles_[3 * t + k]] += n;
+    }
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices(); ++i) {
+        const Scalar length = norm(normals[i]);
+        if (length > 0.0f) normals[i] /= length;
+    }
+}
+
+size_t FrozenMesh::memory_usage() const {
+    return positions_.memory_usage() +
+           (offsets_.capacity() + neighbors_.capacity() + triangles_.capacity() +
+            source_.capacity() + triangle_faces_.capacity()) * sizeof(int) +
+           boundary_.capacity();
+}
+
+}
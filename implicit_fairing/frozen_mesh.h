@@ -0,0 +1,77 @@
+#ifndef FROZEN_MESH_H
+#define FROZEN_MESH_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include "soa_geometry.h"
+#include <vector>
+
+namespace mesh_processing {
+
+// Immutable compact copy of a Surface_mesh for jobs that only query it:
+// the live vertices renumbered without gaps, their one-rings in compressed
+// sparse row layout, the faces as a flat triangle index array and the
+// positions as x/y/z arrays. No halfedges and no deleted flags, about 65
+// bytes per vertex of a closed triangle mesh where the Surface_mesh takes
+// about 125. freeze() once per connectivity, set_positions() after the
+// vertices moved; thaw() builds the Surface_mesh again, so the caller may
+// drop the halfedge structure in between.
+class FrozenMesh {
+
+public:
+    void freeze(const surface_mesh::Surface_mesh& mesh);
+    // the positions of the same connectivity, e.g. after smoothing
+    void set_positions(const surface_mesh::Surface_mesh& mesh);
+    // mesh becomes the frozen mesh, with the frozen numbering; polygons
+    // are put together again from their triangles
+    void thaw(surface_mesh::Surface_mesh& mesh) const;
+    bool empty() const { return offsets_.empty(); }
+    void clear();
+
+    int n_vertices() const { return offsets_.empty() ? 0 : int(offsets_.size()) - 1; }
+    int n_triangles() const { return int(triangles_.size()) / 3; }
+    // vertex of the frozen mesh that frozen vertex i was, the identity
+    // unless the mesh had garbage
+    int source_vertex(const int i) const { return source_.empty() ? i : source_[i]; }
+    // face of the frozen mesh triangle t was fanned from, the identity on
+    // triangle meshes
+    int source_face(const int t) const { return triangle_faces_.empty() ? t : triangle_faces_[t]; }
+
+    const SoAGeometry::Positions& positions() const { return positions_; }
+    surface_mesh::Point position(const int i) const {
+        return surface_mesh::Point(positions_.x[i], positions_.y[i], positions_.z[i]);
+    }
+
+    // the neighbors of vertex i are neighbors()[offsets()[i] .. offsets()[i+1])
+    // in circulator order
+    const std::vector<int>& offsets() const { return offsets_; }
+    const std::vector<int>& neighbors() const { return neighbors_; }
+    int valence(const int i) const { return offsets_[i + 1] - offsets_[i]; }
+    bool is_boundary(const int i) const { return boundary_[i] != 0; }
+
+    // triangle t is triangles()[3t .. 3t + 3), polygons fanned around their
+    // first vertex
+    const std::vector<int>& triangles() const { return triangles_; }
+
+    void bounding_box(surface_mesh::Point& min, surface_mesh::Point& max) const;
+    // total area of the triangles
+    double area() const;
+    // signed volume enclosed by the triangles, meaningful for closed meshes
+    double volume() const;
+    // area weighted normal of every vertex, 0 for isolated vertices
+    void vertex_normals(std::vector<surface_mesh::Point>& normals) const;
+
+    // bytes reserved by the arrays
+    size_t memory_usage() const;
+
+private:
+    SoAGeometry::Positions positions_;
+    std::vector<int> offsets_, neighbors_;
+    std::vector<unsigned char> boundary_;
+    std::vector<int> triangles_;
+    // empty where they would be the identity
+    std::vector<int> source_, triangle_faces_;
+};
+
+}
+
+#endif // FROZEN_MESH_H
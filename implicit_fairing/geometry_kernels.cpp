@@ -0,0 +1,25 @@
+// the baseline variant of the kernels and the dispatch
+#define GEOMETRY_KERNELS_TABLE geometry_kernels_baseline
+#define GEOMETRY_KERNELS_LEVEL SIMD_BASELINE
+#include "geometry_kernels_impl.h"
+
+namespace mesh_processing {
+
+#ifdef GP_SIMD_DISPATCH
+extern const GeometryKernels geometry_kernels_avx2;
+extern const GeometryKernels geometry_kernels_avx512;
+#endif
+
+const GeometryKernels& geometry_kernels() {
+    static const GeometryKernels* kernels = [] {
+#ifdef GP_SIMD_DISPATCH
+        const SIMD_LEVEL level = cpu_simd_level();
+        if (level >= SIMD_AVX512) return &geometry_kernels_avx512;
+        if (level >= SIMD_AVX2) return &geometry_kernels_avx2;
+#endif
+        return &geometry_kernels_baseline;
+    }();
+    return *kernels;
+}
+
+}
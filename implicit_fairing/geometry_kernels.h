@@ -0,0 +1,57 @@
+#ifndef GEOMETRY_KERNELS_H
+#define GEOMETRY_KERNELS_H
+
+#include <cstdint>
+#include "cpu_features.h"
+
+namespace mesh_processing {
+
+// The vectorized loops of SoAGeometry, of the scalar packing, of the half
+// precision conversions and of the triangle pair tests, over flat arrays.
+// geometry_kernels_impl.h is compiled once for the baseline target and, on
+// x86 with GP_SIMD_DISPATCH, once more each for AVX2 and AVX-512;
+// geometry_kernels() picks the table of the widest variant the host runs.
+// All variants are built without FMA contraction, so they return the same
+// bits, only faster.
+struct GeometryKernels {
+    // cotan weight of every edge from the target vertices and the opposite
+    // corners of its halfedges 2i and 2i + 1, see
+    // SoAGeometry::edge_cotan_weights()
+    void (*edge_cotan_weights)(const int n_edges, const float* x, const float* y, const float* z,
+                               const int* halfedge_to, const int* halfedge_corner,
+                               const float max_cotan, float* weights);
+    // area of the triangle f0, f1, f2 of every face
+    void (*face_areas)(const int n_faces, const float* x, const float* y, const float* z,
+                       const int* f0, const int* f1, const int* f2, float* areas);
+    // face_areas() and the clamped cotangents of the corners opposite to
+    // the three halfedges of every face
+    void (*face_areas_cotans)(const int n_faces, const float* x, const float* y, const float* z,
+                              const int* f0, const int* f1, const int* f2, const float max_cotan,
+                              float* areas, float* cot0, float* cot1, float* cot2);
+    // the angles of these corners
+    void (*corner_angles)(const int n_faces, const float* x, const float* y, const float* z,
+                          const int* f0, const int* f1, const int* f2,
+                          float* angle0, float* angle1, float* angle2);
+    // (values - min_value) * scale clamped to [0, 1] in 8 bits, see pack_scalars()
+    void (*pack_scalars)(const int n, const float* values, const float min_value,
+                         const float scale, uint8_t* packed);
+    // binary16 to float and back, see surface_mesh::Half; 8 at a time with
+    // F16C in the AVX2 and AVX-512 variants
+    void (*halves_to_floats)(const int n, const uint16_t* halves, float* values);
+    void (*floats_to_halves)(const int n, const float* values, uint16_t* halves);
+    // hit[i] = 1 if the triangles a[3i..3i+2] and b[3i..3i+2], vertex
+    // indices into the interleaved positions xyz, cross: an edge of one
+    // passes through the other. A vertex both share must come first in
+    // both, touching there is no crossing; coplanar pairs never cross. Not
+    // threaded, the callers run batches of pairs in parallel.
+    void (*triangle_pairs_intersect)(const int n_pairs, const float* xyz, const int* a,
+                                     const int* b, uint8_t* hit);
+    SIMD_LEVEL level;
+};
+
+// the table of cpu_simd_level() among the compiled variants
+const GeometryKernels& geometry_kernels();
+
+}
+
+#endif // GEOMETRY_KERNELS_H
@@ -0,0 +1,7 @@
+// compiled with -mavx2 -mfma -mf16c -ffp-contract=off when GP_SIMD_DISPATCH is on,
+// see CMakeLists.txt
+#ifdef GP_SIMD_DISPATCH
+#define GEOMETRY_KERNELS_TABLE geometry_kernels_avx2
+#define GEOMETRY_KERNELS_LEVEL SIMD_AVX2
+#include "geometry_kernels_impl.h"
+#endif
@@ -0,0 +1,7 @@
+// compiled with -mavx512f -mavx512vl -mavx512bw -mavx512dq and 512 bit
+// vectors when GP_SIMD_DISPATCH is on, see CMakeLists.txt
+#ifdef GP_SIMD_DISPATCH
+#define GEOMETRY_KERNELS_TABLE geometry_kernels_avx512
+#define GEOMETRY_KERNELS_LEVEL SIMD_AVX512
+#include "geometry_kernels_impl.h"
+#endif
@@ -0,0 +1,248 @@
+// The loops of GeometryKernels, included once per vector extension by
+// geometry_kernels.cpp, geometry_kernels_avx2.cpp and
+// geometry_kernels_avx512.cpp, which define GEOMETRY_KERNELS_TABLE and
+// GEOMETRY_KERNELS_LEVEL. Everything here has internal linkage and calls
+// only C library functions and the out of line Half conversions: an inline function with external linkage would
+// be emitted by every variant, and the linker could pick an AVX-512 copy
+// for the baseline code. No include guard, on purpose.
+
+#include <math.h>
+#include <surface_mesh/Half.h>
+#include "geometry_kernels.h"
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define GEOMETRY_KERNELS_F16C
+#endif
+
+namespace mesh_processing {
+
+namespace {
+
+// clamp_cotan() of soa_geometry.h, with the comparisons of std::min and
+// std::max
+inline float clamp_cotan_kernel(const float cot, const float max_cotan) {
+    float clamped = cot < -max_cotan ? -max_cotan : cot;
+    clamped = max_cotan < clamped ? max_cotan : clamped;
+    return cot == cot ? clamped : 0.0f;
+}
+
+void edge_cotan_weights(const int n_edges, const float* x, const float* y, const float* z,
+                        const int* to, const int* corner, const float max_cotan, float* w) {
+    // the halfedges of edge i are 2i and 2i + 1: two stride-2 loads per
+    // stencil array, which the compiler splits into vector gathers
+#pragma omp parallel for simd schedule(static)
+    for (int i = 0; i < n_edges; ++i) {
+        const int a = to[2 * i], b = to[2 * i + 1];
+        const float ax = x[a], ay = y[a], az = z[a];
+        const float bx = x[b], by = y[b], bz = z[b];
+
+        // cot of the corner at c is dot(a - c, b - c) / |cross(a - c, b - c)|
+        const int c = corner[2 * i];
+        float d0x = ax - x[c], d0y = ay - y[c], d0z = az - z[c];
+        float d1x = bx - x[c], d1y = by - y[c], d1z = bz - z[c];
+        float cx = d0y*d1z - d0z*d1y, cy = d0z*d1x - d0x*d1z, cz = d0x*d1y - d0y*d1x;
+        float s = d0x*d1x; s += d0y*d1y; s += d0z*d1z;
+        float n = cx*cx; n += cy*cy; n += cz*cz;
+        const float t0 = clamp_cotan_kernel(s / sqrtf(n), max_cotan);
+
+        const int d = corner[2 * i + 1];
+        d0x = ax - x[d]; d0y = ay - y[d]; d0z = az - z[d];
+        d1x = bx - x[d]; d1y = by - y[d]; d1z = bz - z[d];
+        cx = d0y*d1z - d0z*d1y; cy = d0z*d1x - d0x*d1z; cz = d0x*d1y - d0y*d1x;
+        s = d0x*d1x; s += d0y*d1y; s += d0z*d1z;
+        n = cx*cx; n += cy*cy; n += cz*cz;
+        const float t1 = clamp_cotan_kernel(s / sqrtf(n), max_cotan);
+
+        // a boundary halfedge has its corner at a
+        float weight = 0.0f;
+        weight += c != a ? t0 : 0.0f;
+        weight += d != a ? t1 : 0.0f;
+        w[i] = weight;
+    }
+}
+
+void face_areas(const int n_faces, const float* x, const float* y, const float* z,
+                const int* f0, const int* f1, const int* f2, float* area) {
+#pragma omp parallel for simd schedule(static)
+    for (int i = 0; i < n_faces; ++i) {
+        const int p = f0[i], q = f1[i], r = f2[i];
+        const float ux = x[q] - x[p], uy = y[q] - y[p], uz = z[q] - z[p];
+        const float vx = x[r] - x[p], vy = y[r] - y[p], vz = z[r] - z[p];
+        const float cx = uy*vz - uz*vy, cy = uz*vx - ux*vz, cz = ux*vy - uy*vx;
+        float n = cx*cx; n += cy*cy; n += cz*cz;
+        area[i] = sqrtf(n) * 0.5f;
+    }
+}
+
+void face_areas_cotans(const int n_faces, const float* x, const float* y, const float* z,
+                       const int* f0, const int* f1, const int* f2, const float max_cotan,
+                       float* area, float* c0, float* c1, float* c2) {
+#pragma omp parallel for simd schedule(static)
+    for (int i = 0; i < n_faces; ++i) {
+        const int p0 = f0[i], p1 = f1[i], p2 = f2[i];
+        const float d0x = x[p1] - x[p0], d0y = y[p1] - y[p0], d0z = z[p1] - z[p0];
+        const float d1x = x[p2] - x[p1], d1y = y[p2] - y[p1], d1z = z[p2] - z[p1];
+        const float d2x = x[p0] - x[p2], d2y = y[p0] - y[p2], d2z = z[p0] - z[p2];
+
+        // cross(d0, -d2)
+        const float ex = -d2x, ey = -d2y, ez = -d2z;
+        const float cx = d0y*ez - d0z*ey, cy = d0z*ex - d0x*ez, cz = d0x*ey - d0y*ex;
+        float n = cx*cx; n += cy*cy; n += cz*cz;
+        const float double_area = sqrtf(n);
+        area[i] = double_area * 0.5f;
+
+        float s = d0x*d1x; s += d0y*d1y; s += d0z*d1z;
+        c0[i] = clamp_cotan_kernel(-s / double_area, max_cotan);
+        s = d1x*d2x; s += d1y*d2y; s += d1z*d2z;
+        c1[i] = clamp_cotan_kernel(-s / double_area, max_cotan);
+        s = d2x*d0x; s += d2y*d0y; s += d2z*d0z;
+        c2[i] = clamp_cotan_kernel(-s / double_area, max_cotan);
+    }
+}
+
+void corner_angles(const int n_faces, const float* x, const float* y, const float* z,
+                   const int* f0, const int* f1, const int* f2,
+                   float* a0, float* a1, float* a2) {
+    // the three corners of a face share |cross|, twice its area
+#pragma omp parallel for simd schedule(static)
+    for (int i = 0; i < n_faces; ++i) {
+        const int p0 = f0[i], p1 = f1[i], p2 = f2[i];
+        const float d0x = x[p1] - x[p0], d0y = y[p1] - y[p0], d0z = z[p1] - z[p0];
+        const float d1x = x[p2] - x[p1], d1y = y[p2] - y[p1], d1z = z[p2] - z[p1];
+        const float d2x = x[p0] - x[p2], d2y = y[p0] - y[p2], d2z = z[p0] - z[p2];
+
+        // cross(d0, -d2)
+        const float ex = -d2x, ey = -d2y, ez = -d2z;
+        const float cx = d0y*ez - d0z*ey, cy = d0z*ex - d0x*ez, cz = d0x*ey - d0y*ex;
+        float n = cx*cx; n += cy*cy; n += cz*cz;
+        const float double_area = sqrtf(n);
+
+        float s = d0x*d1x; s += d0y*d1y; s += d0z*d1z;
+        a0[i] = atan2f(double_area, -s);
+        s = d1x*d2x; s += d1y*d2y; s += d1z*d2z;
+        a1[i] = atan2f(double_area, -s);
+        s = d2x*d0x; s += d2y*d0y; s += d2z*d0z;
+        a2[i] = atan2f(double_area, -s);
+    }
+}
+
+void pack_scalars(const int n, const float* values, const float min_value, const float scale,
+                  uint8_t* packed) {
+#pragma omp parallel for simd schedule(static)
+    for (int i = 0; i < n; ++i) {
+        // quantize() of vertex_packing.cpp
+        float t = (values[i] - min_value) * scale;
+        t = t < 0.0f ? 0.0f : t;
+        t = 1.0f < t ? 1.0f : t;
+        packed[i] = uint8_t(int(t * 255.0f + 0.5f));
+    }
+}
+
+void halves_to_floats(const int n, const uint16_t* halves, float* values) {
+#ifdef GEOMETRY_KERNELS_F16C
+    const int n8 = n - n % 8;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n8; i += 8) {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(halves + i));
+        _mm256_storeu_ps(values + i, _mm256_cvtph_ps(h));
+    }
+    for (int i = n8; i < n; ++i) values[i] = _cvtsh_ss(halves[i]);
+#else
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) values[i] = surface_mesh::Half::half_to_float(halves[i]);
+#endif
+}
+
+void floats_to_halves(const int n, const float* values, uint16_t* halves) {
+#ifdef GEOMETRY_KERNELS_F16C
+    const int n8 = n - n % 8;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n8; i += 8) {
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(halves + i), h);
+    }
+    for (int i = n8; i < n; ++i) halves[i] = (uint16_t) _cvtss_sh(values[i], _MM_FROUND_TO_NEAREST_INT);
+#else
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) halves[i] = surface_mesh::Half::float_to_half(values[i]);
+#endif
+}
+
+// does the segment p q cross the triangle a b c with normal n? p and q
+// strictly on either side of its plane, and the line through them on the
+// same side of all three edges. The side of a point is taken relative to a,
+// so that a corner shared with the triangle of p q, at a, is on the plane
+// and never crosses.
+inline int segment_crosses_kernel(const float px, const float py, const float pz,
+                                   const float qx, const float qy, const float qz,
+                                   const float ax, const float ay, const float az,
+                                   const float bx, const float by, const float bz,
+                                   const float cx, const float cy, const float cz,
+                                   const float nx, const float ny, const float nz) {
+    float sp = nx*(px - ax); sp += ny*(py - ay); sp += nz*(pz - az);
+    float sq = nx*(qx - ax); sq += ny*(qy - ay); sq += nz*(qz - az);
+    // bitwise operators, short-circuits would be branches
+    const int crosses = ((sp < 0.0f) & (sq > 0.0f)) | ((sp > 0.0f) & (sq < 0.0f));
+
+    // the volumes of p q with every edge, dot(q - p, cross(u - p, v - p))
+    const float dx = qx - px, dy = qy - py, dz = qz - pz;
+    const float ux = ax - px, uy = ay - py, uz = az - pz;
+    const float vx = bx - px, vy = by - py, vz = bz - pz;
+    const float wx = cx - px, wy = cy - py, wz = cz - pz;
+    float e0 = dx*(uy*vz - uz*vy); e0 += dy*(uz*vx - ux*vz); e0 += dz*(ux*vy - uy*vx);
+    float e1 = dx*(vy*wz - vz*wy); e1 += dy*(vz*wx - vx*wz); e1 += dz*(vx*wy - vy*wx);
+    float e2 = dx*(wy*uz - wz*uy); e2 += dy*(wz*ux - wx*uz); e2 += dz*(wx*uy - wy*ux);
+    const int inside = ((e0 >= 0.0f) & (e1 >= 0.0f) & (e2 >= 0.0f)) |
+                       ((e0 <= 0.0f) & (e1 <= 0.0f) & (e2 <= 0.0f));
+    return crosses & inside;
+}
+
+void triangle_pairs_intersect(const int n_pairs, const float* xyz, const int* a, const int* b,
+                              uint8_t* hit) {
+    // no branches on the data, the six edge tests of a pair are evaluated
+    // in full and the lanes of a vector are pairs
+#pragma omp simd
+    for (int i = 0; i < n_pairs; ++i) {
+        // offsets, not pointers, so that the loads become vector gathers
+        const int a0 = 3 * a[3 * i], a1 = 3 * a[3 * i + 1], a2 = 3 * a[3 * i + 2];
+        const int b0 = 3 * b[3 * i], b1 = 3 * b[3 * i + 1], b2 = 3 * b[3 * i + 2];
+        const float a0x = xyz[a0], a0y = xyz[a0 + 1], a0z = xyz[a0 + 2];
+        const float a1x = xyz[a1], a1y = xyz[a1 + 1], a1z = xyz[a1 + 2];
+        const float a2x = xyz[a2], a2y = xyz[a2 + 1], a2z = xyz[a2 + 2];
+        const float b0x = xyz[b0], b0y = xyz[b0 + 1], b0z = xyz[b0 + 2];
+        const float b1x = xyz[b1], b1y = xyz[b1 + 1], b1z = xyz[b1 + 2];
+        const float b2x = xyz[b2], b2y = xyz[b2 + 1], b2z = xyz[b2 + 2];
+
+        float ux = a1x - a0x, uy = a1y - a0y, uz = a1z - a0z;
+        float vx = a2x - a0x, vy = a2y - a0y, vz = a2z - a0z;
+        const float anx = uy*vz - uz*vy, any = uz*vx - ux*vz, anz = ux*vy - uy*vx;
+        ux = b1x - b0x; uy = b1y - b0y; uz = b1z - b0z;
+        vx = b2x - b0x; vy = b2y - b0y; vz = b2z - b0z;
+        const float bnx = uy*vz - uz*vy, bny = uz*vx - ux*vz, bnz = ux*vy - uy*vx;
+
+        int crossed = 0;
+        crossed |= segment_crosses_kernel(a0x, a0y, a0z, a1x, a1y, a1z, b0x, b0y, b0z,
+                                          b1x, b1y, b1z, b2x, b2y, b2z, bnx, bny, bnz);
+        crossed |= segment_crosses_kernel(a1x, a1y, a1z, a2x, a2y, a2z, b0x, b0y, b0z,
+                                          b1x, b1y, b1z, b2x, b2y, b2z, bnx, bny, bnz);
+        crossed |= segment_crosses_kernel(a2x, a2y, a2z, a0x, a0y, a0z, b0x, b0y, b0z,
+                                          b1x, b1y, b1z, b2x, b2y, b2z, bnx, bny, bnz);
+        crossed |= segment_crosses_kernel(b0x, b0y, b0z, b1x, b1y, b1z, a0x, a0y, a0z,
+                                          a1x, a1y, a1z, a2x, a2y, a2z, anx, any, anz);
+        crossed |= segment_crosses_kernel(b1x, b1y, b1z, b2x, b2y, b2z, a0x, a0y, a0z,
+                                          a1x, a1y, a1z, a2x, a2y, a2z, anx, any, anz);
+        crossed |= segment_crosses_kernel(b2x, b2y, b2z, b0x, b0y, b0z, a0x, a0y, a0z,
+                                          a1x, a1y, a1z, a2x, a2y, a2z, anx, any, anz);
+        hit[i] = uint8_t(crossed);
+    }
+}
+
+}
+
+extern const GeometryKernels GEOMETRY_KERNELS_TABLE;
+const GeometryKernels GEOMETRY_KERNELS_TABLE = {
+    &edge_cotan_weights, &face_areas, &face_areas_cotans, &corner_angles, &pack_scalars,
+    &halves_to_floats, &floats_to_halves, &triangle_pairs_intersect, GEOMETRY_KERNELS_LEVEL
+};
+
+}
@@ -0,0 +1,318 @@
+#include "gpu_smoothing.h"
+#include <iostream>
+#include <vector>
+
+namespace mesh_processing {
+
+// texture units of the texture buffers, the stencil in enum order
+static const int POSITION_UNIT = 0;
+static const int STENCIL_UNIT = 1;
+
+// the stencil and the current positions, one vertex per shader invocation
+#define STENCIL_GLSL \
+    "#version 330\n" \
+    "uniform samplerBuffer positions;\n" \
+    "uniform isamplerBuffer offsets;\n" \
+    "uniform isamplerBuffer neighbors;\n" \
+    "uniform samplerBuffer weights;\n" \
+    "uniform usamplerBuffer interior;\n" \
+    "vec3 point(int i) {\n" \
+    "    return vec3(texelFetch(positions, 3 * i).r, texelFetch(positions, 3 * i + 1).r,\n" \
+    "                texelFetch(positions, 3 * i + 2).r);\n" \
+    "}\n"
+
+static const char* SMOOTH_SHADER =
+    STENCIL_GLSL
+    "uniform float damping;\n"
+    "out vec3 smoothed;\n"
+    "void main() {\n"
+    "    int i = gl_VertexID;\n"
+    "    vec3 p = point(i);\n"
+    "    smoothed = p;\n"
+    "    if (texelFetch(interior, i).r == 0u) return;\n"
+    "    int end = texelFetch(offsets, i + 1).r;\n"
+    "    vec3 laplace = vec3(0.0);\n"
+    "    float ww = 0.0;\n"
+    "    for (int k = texelFetch(offsets, i).r; k < end; ++k) {\n"
+    "        float w = texelFetch(weights, k).r;\n"
+    "        ww += w;\n"
+    "        laplace += w * (point(texelFetch(neighbors, k).r) - p);\n"
+    "    }\n"
+    "    smoothed = p + damping * laplace / ww;\n"
+    "}";
+
+// as Surface_mesh::compute_vertex_normal(): the neighbors are in circulator
+// order, consecutive ones span a face, except the first pair at a boundary
+static const char* NORMAL_SHADER =
+    STENCIL_GLSL
+    "uniform vec3 box_extent;\n"
+    "out vec2 normal;\n"
+    "void main() {\n"
+    "    int i = gl_VertexID;\n"
+    "    vec3 p = point(i) * box_extent;\n"
+    "    int begin = texelFetch(offsets, i).r;\n"
+    "    int count = texelFetch(offsets, i + 1).r - begin;\n"
+    "    vec3 n = vec3(0.0);\n"
+    "    for (int j = texelFetch(interior, i).r != 0u ? 0 : 1; j < count; ++j) {\n"
+    "        vec3 p1 = point(texelFetch(neighbors, begin + j).r) * box_extent - p;\n"
+    "        vec3 p2 = point(texelFetch(neighbors, begin + (j + 1) % count).r) * box_extent - p;\n"
+    "        float denom = sqrt(dot(p1, p1) * dot(p2, p2));\n"
+    "        vec3 c = cross(p1, p2);\n"
+    "        float l = length(c);\n"
+    "        if (denom > 0.0 && l > 0.0) {\n"
+    "            n += c * acos(clamp(dot(p1, p2) / denom, -1.0, 1.0)) / l;\n"
+    "        }\n"
+    "    }\n"
+    "    // octahedral encoding as in pack_normals()\n"
+    "    float l1 = abs(n.x) + abs(n.y) + abs(n.z);\n"
+    "    normal = vec2(0.0);\n"
+    "    if (l1 > 0.0) {\n"
+    "        normal = n.xy / l1;\n"
+    "        if (n.z < 0.0) {\n"
+    "            normal = (1.0 - abs(normal.yx)) *\n"
+    "                     vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);\n"
+    "        }\n"
+    "    }\n"
+    "}";
+
+// as MeshProcessing::calc_vertex_properties() with the weights of
+// calc_weights(): the cotan weight of the edge to a neighbor from the two
+// faces with its circulator neighbors, the vertex weight from the areas of
+// the faces around; boundary vertices are 0 there
+static const char* CURVATURE_SHADER =
+    STENCIL_GLSL
+    "uniform vec3 box_extent;\n"
+    "out float unicurvature;\n"
+    "out float curvature;\n"
+    "out float gauss_curvature;\n"
+    // clamped to DEFAULT_MAX_COTAN
+    "float cotan(vec3 d0, vec3 d1) {\n"
+    "    return clamp(dot(d0, d1) / length(cross(d0, d1)), -1e5, 1e5);\n"
+    "}\n"
+    "void main() {\n"
+    "    int i = gl_VertexID;\n"
+    "    unicurvature = curvature = gauss_curvature = 0.0;\n"
+    "    int begin = texelFetch(offsets, i).r;\n"
+    "    int count = texelFetch(offsets, i + 1).r - begin;\n"
+    "    if (texelFetch(interior, i).r == 0u || count == 0) return;\n"
+    "    vec3 p = point(i) * box_extent;\n"
+    "    vec3 uniform_laplace = vec3(0.0);\n"
+    "    vec3 laplace = vec3(0.0);\n"
+    "    float angles = 0.0;\n"
+    "    float area = 0.0;\n"
+    "    vec3 d_prev = point(texelFetch(neighbors, begin + count - 1).r) * box_extent - p;\n"
+    "    vec3 d = point(texelFetch(neighbors, begin).r) * box_extent - p;\n"
+    "    for (int j = 0; j < count; ++j) {\n"
+    "        vec3 d_next = point(texelFetch(neighbors, begin + (j + 1) % count).r) * box_extent - p;\n"
+    "        float w = cotan(-d_prev, d - d_prev) + cotan(-d_next, d - d_next);\n"
+    "        uniform_laplace += d;\n"
+    "        laplace += w * d;\n"
+    "        angles += acos(clamp(dot(normalize(d), normalize(d_next)), -1.0, 1.0));\n"
+    "        area += 0.5 * length(cross(d, d_next)) * 0.3333;\n"
+    "        d_prev = d;\n"
+    "        d = d_next;\n"
+    "    }\n"
+    "    float weight = 0.5 / area;\n"
+    "    unicurvature = 0.5 * length(uniform_laplace / float(count));\n"
+    "    curvature = 0.5 * length(laplace * weight);\n"
+    "    gauss_curvature = (2.0 * 3.14159265 - angles) * 2.0 * weight;\n"
+    "}";
+
+// varyings are written to separate buffers, in order
+static GLuint build_program(const char* name, const char* source, const char** varyings,
+                            const int n_varyings = 1) {
+    const GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint ok = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << name << ": " << log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    const GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    // the varyings are set before linking
+    glTransformFeedbackVaryings(program, n_varyings, varyings, GL_SEPARATE_ATTRIBS);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        std::cerr << name << ": " << log << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "positions"), POSITION_UNIT);
+    const char* stencil[] = { "offsets", "neighbors", "weights", "interior" };
+    for (int k = 0; k < 4; ++k) {
+        glUniform1i(glGetUniformLocation(program, stencil[k]), STENCIL_UNIT + k);
+    }
+    glUseProgram(0);
+    return program;
+}
+
+bool GpuSmoother::init() {
+    if (ready()) return true;
+    const char* smoothed = "smoothed";
+    const char* normal = "normal";
+    const char* curvatures[N_CURVATURES] = { "unicurvature", "curvature", "gauss_curvature" };
+    smoothProgram_ = build_program("gpu smoothing", SMOOTH_SHADER, &smoothed);
+    normalProgram_ = build_program("gpu normals", NORMAL_SHADER, &normal);
+    curvatureProgram_ = build_program("gpu curvatures", CURVATURE_SHADER, curvatures, N_CURVATURES);
+    if (smoothProgram_ == 0 || normalProgram_ == 0 || curvatureProgram_ == 0) {
+        release();
+        return false;
+    }
+    // core profiles draw with a vertex array bound, even without attributes
+    glGenVertexArrays(1, &vertexArray_);
+    glGenBuffers(N_STENCIL, stencil_);
+    glGenTextures(N_STENCIL, stencilTextures_);
+    glGenBuffers(2, positions_);
+    glGenTextures(2, positionTextures_);
+    glGenBuffers(1, &normals_);
+    glGenBuffers(N_CURVATURES, curvatures_);
+    return true;
+}
+
+void GpuSmoother::release() {
+    if (smoothProgram_ != 0) glDeleteProgram(smoothProgram_);
+    if (normalProgram_ != 0) glDeleteProgram(normalProgram_);
+    if (curvatureProgram_ != 0) glDeleteProgram(curvatureProgram_);
+    if (vertexArray_ != 0) {
+        glDeleteVertexArrays(1, &vertexArray_);
+        glDeleteBuffers(N_STENCIL, stencil_);
+        glDeleteTextures(N_STENCIL, stencilTextures_);
+        glDeleteBuffers(2, positions_);
+        glDeleteTextures(2, positionTextures_);
+        glDeleteBuffers(1, &normals_);
+        glDeleteBuffers(N_CURVATURES, curvatures_);
+    }
+    smoothProgram_ = normalProgram_ = curvatureProgram_ = vertexArray_ = 0;
+    n_vertices_ = 0;
+}
+
+// data into buffer, viewed by texture in format
+static void upload_texture_buffer(const GLuint buffer, const GLuint texture, const GLenum format,
+                                  const size_t bytes, const void* data) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_STATIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void GpuSmoother::upload(const OneRingAdjacency& ring, const Eigen::Map<const Eigen::Matrix3Xf>& points,
+                         const Eigen::Vector3f& box_min, const Eigen::Vector3f& box_extent) {
+    n_vertices_ = 0;
+    const int n = ring.n_vertices();
+    if (!ready() || n <= 0 || points.cols() != n) return;
+    n_vertices_ = n;
+    boxMin_ = box_min;
+    boxExtent_ = box_extent;
+
+    upload_texture_buffer(stencil_[OFFSETS], stencilTextures_[OFFSETS], GL_R32I,
+                          ring.offsets().size() * sizeof(int), ring.offsets().data());
+    upload_texture_buffer(stencil_[NEIGHBORS], stencilTextures_[NEIGHBORS], GL_R32I,
+                          ring.neighbors().size() * sizeof(int), ring.neighbors().data());
+    upload_texture_buffer(stencil_[WEIGHTS], stencilTextures_[WEIGHTS], GL_R32F,
+                          ring.weights().size() * sizeof(float), ring.weights().data());
+    upload_texture_buffer(stencil_[INTERIOR], stencilTextures_[INTERIOR], GL_R8UI,
+                          ring.interior().size(), ring.interior().data());
+
+    // box fractions, a flat axis stays 0
+    Eigen::Vector3f scale;
+    for (int k = 0; k < 3; ++k) scale[k] = box_extent[k] > 0.0f ? 1.0f / box_extent[k] : 0.0f;
+    Eigen::Matrix3Xf fractions = scale.asDiagonal() * (points.colwise() - box_min);
+    current_ = 0;
+    for (int k = 0; k < 2; ++k) {
+        upload_texture_buffer(positions_[k], positionTextures_[k], GL_R32F,
+                              fractions.size() * sizeof(float), k == 0 ? fractions.data() : nullptr);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, normals_);
+    glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(float) * n, nullptr, GL_DYNAMIC_COPY);
+    for (int k = 0; k < N_CURVATURES; ++k) {
+        glBindBuffer(GL_ARRAY_BUFFER, curvatures_[k]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * n, nullptr, GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    for (const GLuint program : { normalProgram_, curvatureProgram_ }) {
+        glUseProgram(program);
+        glUniform3fv(glGetUniformLocation(program, "box_extent"), 1, boxExtent_.data());
+    }
+    run(normalProgram_, &normals_);
+}
+
+void GpuSmoother::run(const GLuint program, const GLuint* targets, const int n_targets) {
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0 + POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, positionTextures_[current_]);
+    for (int k = 0; k < N_STENCIL; ++k) {
+        glActiveTexture(GL_TEXTURE0 + STENCIL_UNIT + k);
+        glBindTexture(GL_TEXTURE_BUFFER, stencilTextures_[k]);
+    }
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(vertexArray_);
+    for (int k = 0; k < n_targets; ++k) {
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, k, targets[k]);
+    }
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, n_vertices_);
+    glEndTransformFeedback();
+    for (int k = 0; k < n_targets; ++k) {
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, k, 0);
+    }
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    for (int k = N_STENCIL; k >= 0; --k) {
+        glActiveTexture(GL_TEXTURE0 + POSITION_UNIT + k);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    glUseProgram(0);
+}
+
+void GpuSmoother::smooth(const int iterations, const float damping) {
+    if (empty()) return;
+    glUseProgram(smoothProgram_);
+    glUniform1f(glGetUniformLocation(smoothProgram_, "damping"), damping);
+    for (int iter = 0; iter < iterations; ++iter) {
+        // a buffer is never read and written in the same pass
+        run(smoothProgram_, &positions_[1 - current_]);
+        current_ = 1 - current_;
+    }
+    run(normalProgram_, &normals_);
+}
+
+void GpuSmoother::compute_curvatures() {
+    if (empty()) return;
+    run(curvatureProgram_, curvatures_, N_CURVATURES);
+}
+
+void GpuSmoother::download_curvatures(const int curvature, std::vector<float>& values) const {
+    values.resize(n_vertices_);
+    if (empty()) return;
+    glBindBuffer(GL_ARRAY_BUFFER, curvatures_[curvature]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, values.size() * sizeof(float), values.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GpuSmoother::download(Eigen::Matrix3Xf& points) const {
+    points.resize(3, n_vertices_);
+    if (empty()) return;
+    glBindBuffer(GL_ARRAY_BUFFER, positions_[current_]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, points.size() * sizeof(float), points.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    points = (boxExtent_.asDiagonal() * points).colwise() + boxMin_;
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef GPU_SMOOTHING_H
+#define GPU_SMOOTHING_H
+
+#include <nanogui/opengl.h>
+#include <Eigen/Core>
+#include <vector>
+#include "one_ring.h"
+
+namespace mesh_processing {
+
+// The damped Jacobi iterations of OneRingAdjacency::smooth_step() on the GPU,
+// as OpenGL 3.3 transform feedback passes over texture buffers, so they run
+// in the context the viewer already has. The one-rings and their weights are
+// uploaded once, the positions stay on the GPU between calls of smooth().
+// positions() and normals() can be drawn from directly: positions are
+// fractions of the bounding box given to upload(), as the quantized ones of
+// vertex_packing.h, normals are octahedral coordinates in [-1, 1]^2, both
+// as floats. compute_curvatures() derives the curvatures of
+// MeshProcessing::get_scalars() from the same buffers, so colors follow the
+// smoothed positions without a round trip through the CPU. Needs a current
+// GL context for all calls but the accessors.
+class GpuSmoother {
+
+public:
+    ~GpuSmoother() { release(); }
+
+    // builds the programs, false if the driver refuses them
+    bool init();
+    void release();
+    bool ready() const { return smoothProgram_ != 0; }
+
+    // the stencil and the positions, mapped into the box
+    void upload(const OneRingAdjacency& ring, const Eigen::Map<const Eigen::Matrix3Xf>& points,
+                const Eigen::Vector3f& box_min, const Eigen::Vector3f& box_extent);
+    bool empty() const { return n_vertices_ == 0; }
+    int n_vertices() const { return n_vertices_; }
+
+    // iterations steps of p += damping * sum w (q - p) / sum w, then the
+    // angle weighted vertex normals of the result
+    void smooth(const int iterations, const float damping);
+
+    // the uniform mean, the mean and the Gauss curvature of the current
+    // positions, 0 at boundary vertices
+    void compute_curvatures();
+    enum { UNIFORM_MEAN = 0, MEAN = 1, GAUSS = 2, N_CURVATURES = 3 };
+    // 1 float per vertex, curvature is one of the enum
+    GLuint curvatures(const int curvature) const { return curvatures_[curvature]; }
+    void download_curvatures(const int curvature, std::vector<float>& values) const;
+
+    // 3 floats per vertex
+    GLuint positions() const { return positions_[current_]; }
+    // 2 floats per vertex
+    GLuint normals() const { return normals_; }
+
+    // the positions in mesh coordinates
+    void download(Eigen::Matrix3Xf& points) const;
+
+private:
+    // one transform feedback pass writing a varying to each of targets,
+    // positions_[current_] and the stencil bound as texture buffers
+    void run(const GLuint program, const GLuint* targets, const int n_targets = 1);
+
+    GLuint smoothProgram_ = 0;
+    GLuint normalProgram_ = 0;
+    GLuint curvatureProgram_ = 0;
+    GLuint vertexArray_ = 0;
+    // the buffers and the texture buffers viewing them
+    enum { OFFSETS = 0, NEIGHBORS = 1, WEIGHTS = 2, INTERIOR = 3, N_STENCIL = 4 };
+    GLuint stencil_[N_STENCIL] = { 0, 0, 0, 0 };
+    GLuint stencilTextures_[N_STENCIL] = { 0, 0, 0, 0 };
+    GLuint positions_[2] = { 0, 0 };
+    GLuint positionTextures_[2] = { 0, 0 };
+    GLuint normals_ = 0;
+    GLuint curvatures_[N_CURVATURES] = { 0, 0, 0 };
+    int current_ = 0;
+    int n_vertices_ = 0;
+    Eigen::Vector3f boxMin_ = Eigen::Vector3f::Zero();
+    Eigen::Vector3f boxExtent_ = Eigen::Vector3f::Zero();
+};
+
+}
+
+#endif // GPU_SMOOTHING_H
@@ -0,0 +1,91 @@
+
+#include "incomplete_cholesky.h"
+#include <cmath>
+#include <vector>
+
+namespace mesh_processing {
+
+void IncompleteCholeskyPreconditioner::analyzePattern(const Eigen::SparseMatrix<double>& A) {
+    // the pattern of L is the lower triangle of A
+    L_ = A.triangularView<Eigen::Lower>();
+    L_.makeCompressed();
+}
+
+void IncompleteCholeskyPreconditioner::factorize(const Eigen::SparseMatrix<double>& A) {
+    const int n = A.cols();
+    if (L_.cols() != n || L_.nonZeros() == 0) {
+        analyzePattern(A);
+    } else {
+        L_ = A.triangularView<Eigen::Lower>();
+        L_.makeCompressed();
+    }
+
+    const int* outer = L_.outerIndexPtr();
+    const int* inner = L_.innerIndexPtr();
+    double* values = L_.valuePtr();
+
+    // position of row i in the column currently being updated, -1 if absent
+    std::vector<int> position(n, -1);
+    info_ = Eigen::Success;
+
+    // right-looking factorization restricted to the pattern of A
+    for (int k = 0; k < n; ++k) {
+        if (outer[k] == outer[k+1] || inner[outer[k]] != k) {
+            info_ = Eigen::NumericalIssue;
+            return;
+        }
+
+        double pivot = values[outer[k]];
+        if (pivot <= 0.0) {
+            // not an M-matrix (obtuse triangles): fall back to the diagonal
+            pivot = std::abs(A.coeff(k, k));
+            if (pivot == 0.0) pivot = 1.0;
+        }
+        pivot = std::sqrt(pivot);
+        values[outer[k]] = pivot;
+        for (int p = outer[k] + 1; p < outer[k+1]; ++p)
+            values[p] /= pivot;
+
+        // update the columns j > k that are coupled to column k
+        for (int p = outer[k] + 1; p < outer[k+1]; ++p) {
+            const int j = inner[p];
+            for (int q = outer[j]; q < outer[j+1]; ++q)
+                position[inner[q]] = q;
+
+            for (int r = p; r < outer[k+1]; ++r) {
+                const int q = position[inner[r]];
+                if (q >= 0)
+                    values[q] -= values[r] * values[p];
+            }
+
+            for (int q = outer[j]; q < outer[j+1]; ++q)
+                position[inner[q]] = -1;
+        }
+    }
+}
+
+Eigen::VectorXd IncompleteCholeskyPreconditioner::solve(const Eigen::VectorXd& b) const {
+    const int n = L_.cols();
+    const int* outer = L_.outerIndexPtr();
+    const int* inner = L_.innerIndexPtr();
+    const double* values = L_.valuePtr();
+
+    // L*y = b
+    Eigen::VectorXd x = b;
+    for (int j = 0; j < n; ++j) {
+        x[j] /= values[outer[j]];
+        for (int p = outer[j] + 1; p < outer[j+1]; ++p)
+            x[inner[p]] -= values[p] * x[j];
+    }
+
+    // L^T*x = y
+    for (int j = n - 1; j >= 0; --j) {
+        double s = x[j];
+        for (int p = outer[j] + 1; p < outer[j+1]; ++p)
+            s -= values[p] * x[inner[p]];
+        x[j] = s / values[outer[j]];
+    }
+    return x;
+}
+
+}
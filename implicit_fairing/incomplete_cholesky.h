@@ -0,0 +1,38 @@
+#ifndef INCOMPLETE_CHOLESKY_H
+#define INCOMPLETE_CHOLESKY_H
+
+#include <Eigen/Sparse>
+
+namespace mesh_processing {
+
+// Zero fill-in incomplete Cholesky factorization A ~ L*L^T, usable as the
+// preconditioner of Eigen::ConjugateGradient. Only the lower triangle of A
+// is read. The incomplete factorization shipped with Eigen 3.2 (unsupported
+// module) breaks down on cotan matrices, hence this one.
+class IncompleteCholeskyPreconditioner {
+
+public:
+    IncompleteCholeskyPreconditioner() : info_(Eigen::Success) {}
+
+    void analyzePattern(const Eigen::SparseMatrix<double>& A);
+    void factorize(const Eigen::SparseMatrix<double>& A);
+    void compute(const Eigen::SparseMatrix<double>& A) {
+        analyzePattern(A);
+        factorize(A);
+    }
+
+    // returns x with L*L^T*x = b
+    Eigen::VectorXd solve(const Eigen::VectorXd& b) const;
+
+    Eigen::ComputationInfo info() const { return info_; }
+    const Eigen::SparseMatrix<double>& factor() const { return L_; }
+
+private:
+    // lower triangle, diagonal entry first in each column
+    Eigen::SparseMatrix<double> L_;
+    Eigen::ComputationInfo info_;
+};
+
+}
+
+#endif // INCOMPLETE_CHOLESKY_H
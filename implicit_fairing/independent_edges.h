@@ -0,0 +1,86 @@
+#ifndef INDEPENDENT_EDGES_H
+#define INDEPENDENT_EDGES_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace mesh_processing {
+
+// key of an edge that is not to be changed
+static const uint64_t NO_EDGE_KEY = ~uint64_t(0);
+
+// f of v and of its neighbours until one of them returns false
+template <class F>
+inline bool all_of_closed_ring(const surface_mesh::Surface_mesh& mesh,
+                               const surface_mesh::Surface_mesh::Vertex v, const F& f) {
+    if (!f(v)) return false;
+    for (auto u: mesh.vertices(v)) {
+        if (!f(u)) return false;
+    }
+    return true;
+}
+
+// Rounds of local edge operations in parallel: every edge gets a unique
+// key, smaller first, e.g. a cost in the high bits above the edge index.
+// select() returns the edges whose key is the smallest around every vertex
+// of the one-rings of their ends, in key order. The one-rings of two such
+// edges are disjoint, so a collapse, flip or split of one of them does not
+// change the faces the others were evaluated on, and applying all of them
+// gives the same mesh as the greedy order, on any number of threads.
+class IndependentEdges {
+
+public:
+    const std::vector<int>& select(const surface_mesh::Surface_mesh& mesh,
+                                   const std::vector<uint64_t>& keys) {
+        typedef surface_mesh::Surface_mesh::Vertex Vertex;
+        const int n_vertices = mesh.vertices_size();
+        const int n_edges = int(keys.size());
+        best_.resize(n_vertices);
+        around_.resize(n_vertices);
+        selected_.resize(n_edges);
+
+        // the smallest key at every vertex, then around its one-ring
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n_vertices; ++i) {
+            const Vertex v(i);
+            best_[i] = NO_EDGE_KEY;
+            if (mesh.is_deleted(v) || mesh.is_isolated(v)) continue;
+            for (auto h: mesh.halfedges(v)) best_[i] = std::min(best_[i], keys[mesh.edge(h).idx()]);
+        }
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n_vertices; ++i) {
+            const Vertex v(i);
+            around_[i] = best_[i];
+            if (mesh.is_deleted(v) || mesh.is_isolated(v)) continue;
+            for (auto u: mesh.vertices(v)) around_[i] = std::min(around_[i], best_[u.idx()]);
+        }
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int e = 0; e < n_edges; ++e) {
+            selected_[e] = 0;
+            if (keys[e] == NO_EDGE_KEY) continue;
+            const surface_mesh::Surface_mesh::Edge edge(e);
+            auto smallest = [&](const Vertex x) { return around_[x.idx()] == keys[e]; };
+            selected_[e] = all_of_closed_ring(mesh, mesh.vertex(edge, 0), smallest) &&
+                           all_of_closed_ring(mesh, mesh.vertex(edge, 1), smallest);
+        }
+
+        edges_.clear();
+        for (int e = 0; e < n_edges; ++e) {
+            if (selected_[e]) edges_.push_back(e);
+        }
+        std::sort(edges_.begin(), edges_.end(),
+                  [&](const int a, const int b) { return keys[a] < keys[b]; });
+        return edges_;
+    }
+
+private:
+    std::vector<uint64_t> best_, around_;
+    std::vector<unsigned char> selected_;
+    std::vector<int> edges_;
+};
+
+}
+
+#endif // INDEPENDENT_EDGES_H
@@ -0,0 +1,327 @@
+#include "laplace_operator.h"
+#include "reduction.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mesh_processing {
+
+using surface_mesh::Property_vector;
+using surface_mesh::Scalar;
+
+void LaplaceOperator::assign(const WEIGHTS weights, Property_vector<Scalar>& edge_weights,
+                             Eigen::VectorXd& mass, const unsigned int topology_revision,
+                             const uint64_t positions_key) {
+    edge_weights_.swap(edge_weights);
+    mass_.swap(mass);
+    Property_vector<Scalar>().swap(edge_weights);
+    mass.resize(0);
+    L_ = Eigen::SparseMatrix<double>();
+    std::vector<int>().swap(diagonal_);
+    assembled_ = false;
+    weights_ = weights;
+    topology_revision_ = topology_revision;
+    positions_key_ = positions_key;
+}
+
+void LaplaceOperator::assign_matrix(Eigen::SparseMatrix<double>& L) {
+    L_.swap(L);
+    assembled_ = true;
+
+    const int n = int(L_.outerSize());
+    const int* outer = L_.outerIndexPtr();
+    const int* inner = L_.innerIndexPtr();
+    diagonal_.resize(n);
+#pragma omp parallel for schedule(static)
+    for (int j = 0; j < n; ++j) {
+        for (int p = outer[j]; p < outer[j + 1]; ++p) {
+            if (inner[p] == j) diagonal_[j] = p;
+        }
+    }
+}
+
+bool LaplaceOperator::matches(const WEIGHTS weights, const unsigned int topology_revision,
+                              const uint64_t positions_key) const {
+    return !empty() && weights_ == weights && topology_revision_ == topology_revision &&
+           (weights == UNIFORM || positions_key_ == positions_key);
+}
+
+void LaplaceOperator::clear() {
+    Property_vector<Scalar>().swap(edge_weights_);
+    mass_ = Eigen::VectorXd();
+    L_ = Eigen::SparseMatrix<double>();
+    std::vector<int>().swap(diagonal_);
+    assembled_ = false;
+}
+
+void LaplaceOperator::apply(const Eigen::MatrixXd& X, Eigen::MatrixXd& Y) const {
+    const int n = size();
+    const int cols = int(X.cols());
+    const int* outer = L_.outerIndexPtr();
+    const int* inner = L_.innerIndexPtr();
+    const double* values = L_.valuePtr();
+    Y.resize(n, cols);
+    // L is symmetric, so column i of the compressed storage is row i
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        for (int c = 0; c < cols; ++c) {
+            double sum = 0.0;
+            for (int p = outer[i]; p < outer[i + 1]; ++p) sum += values[p] * X(inner[p], c);
+            Y(i, c) = sum;
+        }
+    }
+}
+
+void LaplaceOperator::combine(const double mass_scale, const double laplace_scale,
+                              Eigen::SparseMatrix<double>& A, const bool lower) const {
+    if (!lower) {
+        A = L_;
+        double* values = A.valuePtr();
+        for (int p = 0; p < A.nonZeros(); ++p) values[p] *= laplace_scale;
+        for (int i = 0; i < size(); ++i) values[diagonal_[i]] += mass_scale * mass_[i];
+        return;
+    }
+
+    // the rows of a column are sorted, its lower part starts at the diagonal
+    const int n = size();
+    const int* outer = L_.outerIndexPtr();
+    const int* inner = L_.innerIndexPtr();
+    const double* values = L_.valuePtr();
+    A.resize(n, n);
+    int* a_outer = A.outerIndexPtr();
+    a_outer[0] = 0;
+    for (int j = 0; j < n; ++j) a_outer[j + 1] = a_outer[j] + outer[j + 1] - diagonal_[j];
+    A.resizeNonZeros(a_outer[n]);
+    int* a_inner = A.innerIndexPtr();
+    double* a_values = A.valuePtr();
+#pragma omp parallel for schedule(static)
+    for (int j = 0; j < n; ++j) {
+        int k = a_outer[j];
+        for (int p = diagonal_[j]; p < outer[j + 1]; ++p, ++k) {
+            a_inner[k] = inner[p];
+            a_values[k] = values[p] * laplace_scale;
+        }
+        a_values[a_outer[j]] += mass_scale * mass_[j];
+    }
+}
+
+namespace {
+
+// the product of apply_matrix_free() with the neighbor and the weight of
+// entry k of the rings from entry(k)
+template <class Entry>
+void apply_rings(const int n, const int* offsets, const Entry& entry, const double* mass,
+                 const double mass_scale, const double laplace_scale, const double* x,
+                 double* y) {
+    // the sums of a row stay in ring order, a vectorized reduction would
+    // give other bits with every vector width
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        double sum = 0.0, sx = 0.0, sy = 0.0, sz = 0.0;
+        for (int k = offsets[i]; k < offsets[i + 1]; ++k) {
+            const OneRingAdjacency::Entry e = entry(k);
+            const double weight = e.weight;
+            const double* xj = x + 3 * e.neighbor;
+            sum += weight;
+            sx += weight * xj[0];
+            sy += weight * xj[1];
+            sz += weight * xj[2];
+        }
+        const double d = laplace_scale * sum + mass_scale * mass[i];
+        y[3 * i] = d * x[3 * i] - laplace_scale * sx;
+        y[3 * i + 1] = d * x[3 * i + 1] - laplace_scale * sy;
+        y[3 * i + 2] = d * x[3 * i + 2] - laplace_scale * sz;
+    }
+}
+
+}
+
+void LaplaceOperator::apply_matrix_free(const OneRingAdjacency& rings, const double mass_scale,
+                                        const double laplace_scale, const double* x,
+                                        double* y) const {
+    const int* neighbors = rings.neighbors().data();
+    const int* edges = rings.edges().data();
+    const Scalar* w = edge_weights_.data();
+    apply_rings(size(), rings.offsets().data(), [&](const int k) {
+        return OneRingAdjacency::Entry{ neighbors[k], w[edges[k]] };
+    }, mass_.data(), mass_scale, laplace_scale, x, y);
+}
+
+void LaplaceOperator::apply_matrix_free(const OneRingAdjacency& rings,
+                                        const std::vector<OneRingAdjacency::Entry>& entries,
+                                        const double mass_scale, const double laplace_scale,
+                                        const double* x, double* y) const {
+    const OneRingAdjacency::Entry* e = entries.data();
+    apply_rings(size(), rings.offsets().data(), [&](const int k) { return e[k]; },
+                mass_.data(), mass_scale, laplace_scale, x, y);
+}
+
+void LaplaceOperator::diagonal(const OneRingAdjacency& rings, const double mass_scale,
+                               const double laplace_scale, std::vector<double>& d) const {
+    const int n = size();
+    const std::vector<int>& offsets = rings.offsets();
+    const std::vector<int>& edges = rings.edges();
+    d.resize(n);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        double sum = 0.0;
+        for (int k = offsets[i]; k < offsets[i + 1]; ++k) sum += edge_weights_[edges[k]];
+        d[i] = laplace_scale * sum + mass_scale * mass_[i];
+    }
+}
+
+namespace {
+
+// three sums at once for deterministic_reduce()
+struct Sum3 {
+    double v[3];
+};
+
+Sum3 add(const Sum3& a, const Sum3& b) {
+    return Sum3{{ a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2] }};
+}
+
+// the dot products of the x, y and z columns of interleaved a and b
+Sum3 dot3(const int n, const double* a, const double* b) {
+    return deterministic_reduce(n, Sum3{{ 0.0, 0.0, 0.0 }}, [&](const int i) {
+        return Sum3{{ a[3 * i] * b[3 * i], a[3 * i + 1] * b[3 * i + 1],
+                      a[3 * i + 2] * b[3 * i + 2] }};
+    }, add);
+}
+
+}
+
+bool LaplaceOperator::solve_matrix_free(const OneRingAdjacency& rings, const double mass_scale,
+                                        const double laplace_scale, const Eigen::MatrixXd& B,
+                                        Eigen::MatrixXd& X, const double tolerance,
+                                        const int max_iterations, int& iterations,
+                                        double& error, const JobProgress* progress,
+                                        bool& stopped) const {
+    const int n = size();
+    std::vector<double> inv_diag;
+    diagonal(rings, mass_scale, laplace_scale, inv_diag);
+    for (double& d : inv_diag) d = d != 0.0 ? 1.0 / d : 1.0;
+
+    // with interleaved rings the products read neighbor and weight from one
+    // array, gathered once for all iterations
+    std::vector<OneRingAdjacency::Entry> entries;
+    if (rings.interleaved()) rings.gather_entries(edge_weights_, entries);
+    auto apply = [&](const double* in, double* out) {
+        if (rings.interleaved()) {
+            apply_matrix_free(rings, entries, mass_scale, laplace_scale, in, out);
+        } else {
+            apply_matrix_free(rings, mass_scale, laplace_scale, in, out);
+        }
+    };
+
+    // x, r = b - A x, p and q = A p, interleaved
+    std::vector<double> x(3 * n), r(3 * n), p(3 * n), q(3 * n);
+    for (int i = 0; i < n; ++i) {
+        for (int c = 0; c < 3; ++c) x[3 * i + c] = X(i, c);
+    }
+    apply(x.data(), q.data());
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            r[3 * i + c] = B(i, c) - q[3 * i + c];
+            p[3 * i + c] = inv_diag[i] * r[3 * i + c];
+        }
+    }
+
+    // the thresholds of Eigen::ConjugateGradient
+    const Sum3 b_norm2 = deterministic_reduce(n, Sum3{{ 0.0, 0.0, 0.0 }}, [&](const int i) {
+        return Sum3{{ B(i, 0) * B(i, 0), B(i, 1) * B(i, 1), B(i, 2) * B(i, 2) }};
+    }, add);
+    const Sum3 r_norm2 = dot3(n, r.data(), r.data());
+    Sum3 rz = dot3(n, r.data(), p.data());
+    const double zero = (std::numeric_limits<double>::min)();
+    double threshold[3], residual[3];
+    bool active[3];
+    int column_iterations[3] = { 0, 0, 0 };
+    for (int c = 0; c < 3; ++c) {
+        threshold[c] = (std::max)(tolerance * tolerance * b_norm2.v[c], zero);
+        residual[c] = r_norm2.v[c];
+        active[c] = b_norm2.v[c] != 0.0 && residual[c] >= threshold[c];
+        if (b_norm2.v[c] == 0.0) {
+            for (int i = 0; i < n; ++i) x[3 * i + c] = 0.0;
+            residual[c] = 0.0;
+        }
+    }
+
+    stopped = false;
+    for (int it = 0; it < max_iterations && (active[0] || active[1] || active[2]); ++it) {
+        if (progress && progress->stopped()) {
+            stopped = true;
+            break;
+        }
+        apply(p.data(), q.data());
+        const Sum3 pq = dot3(n, p.data(), q.data());
+        double alpha[3];
+        for (int c = 0; c < 3; ++c) alpha[c] = active[c] ? rz.v[c] / pq.v[c] : 0.0;
+
+        // x += alpha p, r -= alpha q, and the new r.r and r.z with z = D^-1 r
+        const Sum3 norms = deterministic_reduce(n, Sum3{{ 0.0, 0.0, 0.0 }}, [&](const int i) {
+            Sum3 s{{ 0.0, 0.0, 0.0 }};
+            for (int c = 0; c < 3; ++c) {
+                if (!active[c]) continue;
+                const int k = 3 * i + c;
+                x[k] += alpha[c] * p[k];
+                r[k] -= alpha[c] * q[k];
+                s.v[c] = r[k] * r[k];
+            }
+            return s;
+        }, add);
+        const Sum3 rz_new = deterministic_reduce(n, Sum3{{ 0.0, 0.0, 0.0 }}, [&](const int i) {
+            Sum3 s{{ 0.0, 0.0, 0.0 }};
+            for (int c = 0; c < 3; ++c) {
+                if (active[c]) s.v[c] = r[3 * i + c] * inv_diag[i] * r[3 * i + c];
+            }
+            return s;
+        }, add);
+
+        double beta[3];
+        bool update[3];
+        for (int c = 0; c < 3; ++c) {
+            update[c] = false;
+            if (!active[c]) continue;
+            ++column_iterations[c];
+            residual[c] = norms.v[c];
+            if (residual[c] < threshold[c]) {
+                active[c] = false;
+                continue;
+            }
+            beta[c] = rz_new.v[c] / rz.v[c];
+            rz.v[c] = rz_new.v[c];
+            update[c] = true;
+        }
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                const int k = 3 * i + c;
+                if (update[c]) p[k] = inv_diag[i] * r[k] + beta[c] * p[k];
+            }
+        }
+    }
+
+    X.resize(n, 3);
+    for (int i = 0; i < n; ++i) {
+        for (int c = 0; c < 3; ++c) X(i, c) = x[3 * i + c];
+    }
+    iterations = 0;
+    error = 0.0;
+    for (int c = 0; c < 3; ++c) {
+        iterations = (std::max)(iterations, column_iterations[c]);
+        if (b_norm2.v[c] != 0.0) {
+            error = (std::max)(error, std::sqrt(residual[c] / b_norm2.v[c]));
+        }
+    }
+    return !(active[0] || active[1] || active[2]);
+}
+
+size_t LaplaceOperator::memory_usage() const {
+    return edge_weights_.capacity() * sizeof(Scalar) + size_t(mass_.size()) * sizeof(double) +
+           size_t(L_.nonZeros()) * (sizeof(double) + sizeof(int)) +
+           size_t(L_.outerSize() + 1) * sizeof(int) + diagonal_.capacity() * sizeof(int);
+}
+
+}
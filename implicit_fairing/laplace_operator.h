@@ -0,0 +1,116 @@
+#ifndef LAPLACE_OPERATOR_H
+#define LAPLACE_OPERATOR_H
+
+#include <Eigen/Sparse>
+#include <surface_mesh/properties.h>
+#include <cstdint>
+#include <vector>
+#include "async_job.h"
+#include "one_ring.h"
+
+namespace mesh_processing {
+
+// The Laplacian of a mesh as a sparse symmetric positive semidefinite matrix
+// with its lumped mass, in the convention of the solvers: (L x)_i is the sum
+// of w_ij (x_i - x_j) over the one-ring of vertex i, with the cotan weights
+// or w_ij = 1, and mass(i) is the area of vertex i, or 1 with uniform
+// weights. MeshProcessing::laplace_operator() assembles it once per
+// positions and connectivity, and implicit_smoothing, minimal_surface and
+// the eigenbasis all read that one.
+//
+// The float weight of every edge is all the operator needs, the assembled
+// double matrix is only built on request: the matrix-free products run over
+// the one-rings of the mesh instead, with x, y and z of a vertex next to
+// each other, and read about half the bytes of three products with the
+// assembled matrix.
+class LaplaceOperator {
+
+public:
+    enum WEIGHTS : int { COTAN = 0, UNIFORM = 1 };
+
+    // takes the storage of edge_weights and mass, which are left empty, and
+    // drops the assembled matrix
+    void assign(const WEIGHTS weights,
+                surface_mesh::Property_vector<surface_mesh::Scalar>& edge_weights,
+                Eigen::VectorXd& mass, const unsigned int topology_revision,
+                const uint64_t positions_key);
+    // takes the storage of the assembled L, which must hold every diagonal
+    // entry
+    void assign_matrix(Eigen::SparseMatrix<double>& L);
+    // true if assigned for these weights, connectivity and positions; the
+    // positions do not matter for uniform weights
+    bool matches(const WEIGHTS weights, const unsigned int topology_revision,
+                 const uint64_t positions_key) const;
+    // drops everything, the next laplace_operator() assembles it again
+    void clear();
+    bool empty() const { return mass_.size() == 0; }
+    bool assembled() const { return assembled_; }
+    int size() const { return int(mass_.size()); }
+    WEIGHTS weights() const { return weights_; }
+    // the hash of the positions the weights were computed for
+    uint64_t positions_key() const { return positions_key_; }
+
+    const surface_mesh::Property_vector<surface_mesh::Scalar>& edge_weights() const {
+        return edge_weights_;
+    }
+    const Eigen::VectorXd& mass() const { return mass_; }
+    // the assembled L, empty unless assembled()
+    const Eigen::SparseMatrix<double>& matrix() const { return L_; }
+    // Y = L X with the assembled matrix, the rows in parallel and each in a
+    // fixed order
+    void apply(const Eigen::MatrixXd& X, Eigen::MatrixXd& Y) const;
+    // A = mass_scale * M + laplace_scale * L on the pattern of the assembled
+    // L, e.g. M + dt L of an implicit step; keeps the storage of A if it fits.
+    // With lower only the diagonal and the entries below it, half the bytes
+    // for the solvers that read one triangle.
+    void combine(const double mass_scale, const double laplace_scale,
+                 Eigen::SparseMatrix<double>& A, const bool lower = false) const;
+
+    // y = (mass_scale * M + laplace_scale * L) x without the assembled
+    // matrix, from rings, the one-rings of the mesh; x and y hold x, y and z
+    // of every vertex in turn. The diagonal is summed in the order of
+    // assemble, so only the order of the off-diagonal sum differs from the
+    // assembled product.
+    void apply_matrix_free(const OneRingAdjacency& rings, const double mass_scale,
+                           const double laplace_scale, const double* x, double* y) const;
+    // the same with the weights of entries, OneRingAdjacency::gather_entries()
+    // of edge_weights(), in place of the edge lookups: bit for bit the same
+    // product from one array instead of three
+    void apply_matrix_free(const OneRingAdjacency& rings,
+                           const std::vector<OneRingAdjacency::Entry>& entries,
+                           const double mass_scale, const double laplace_scale,
+                           const double* x, double* y) const;
+    // the diagonal of mass_scale * M + laplace_scale * L
+    void diagonal(const OneRingAdjacency& rings, const double mass_scale,
+                  const double laplace_scale, std::vector<double>& d) const;
+    // (mass_scale * M + laplace_scale * L) X = B by conjugate gradients with
+    // the Jacobi preconditioner and apply_matrix_free(), the entries one if
+    // rings are interleaved, X being the warm start; the columns converge
+    // on their own, each until its residual is below tolerance times the
+    // norm of its rhs. Returns the iterations and the relative residual of
+    // the slowest column, false if one of them did not converge within
+    // max_iterations. Every iteration checks progress, once it stopped X is
+    // the current iterate and stopped is set.
+    bool solve_matrix_free(const OneRingAdjacency& rings, const double mass_scale,
+                           const double laplace_scale, const Eigen::MatrixXd& B,
+                           Eigen::MatrixXd& X, const double tolerance,
+                           const int max_iterations, int& iterations, double& error,
+                           const JobProgress* progress, bool& stopped) const;
+    // bytes reserved by the weights, the mass and the assembled matrix
+    size_t memory_usage() const;
+
+private:
+    surface_mesh::Property_vector<surface_mesh::Scalar> edge_weights_;
+    Eigen::VectorXd mass_;
+    Eigen::SparseMatrix<double> L_;
+    // position of L(i, i) in the values of L
+    std::vector<int> diagonal_;
+    bool assembled_ = false;
+    WEIGHTS weights_ = COTAN;
+    unsigned int topology_revision_ = 0;
+    uint64_t positions_key_ = 0;
+};
+
+}
+
+#endif // LAPLACE_OPERATOR_H
@@ -0,0 +1,75 @@
+
+#include "ldlt_solve.h"
+#include <cassert>
+
+namespace mesh_processing {
+
+template <typename T>
+void solve_ldlt_xyz(const Eigen::SimplicialLDLT< Eigen::SparseMatrix<T> >& ldlt,
+                    const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& B,
+                    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& X,
+                    std::vector<T>& work) {
+    assert(B.cols() == 3);
+    // unit lower triangle without the diagonal, one column per vertex in
+    // the fill-reducing order
+    const Eigen::SparseMatrix<T>& L = ldlt.matrixL().nestedExpression();
+    const Eigen::Matrix<T, Eigen::Dynamic, 1>& D = ldlt.vectorD();
+    const int* perm = ldlt.permutationP().size() > 0 ? ldlt.permutationP().indices().data()
+                                                     : nullptr;
+    const int n = L.cols();
+    const int* outer = L.outerIndexPtr();
+    const int* inner = L.innerIndexPtr();
+    const T* values = L.valuePtr();
+
+    // y = P b
+    work.resize(4 * size_t(n));
+    T* y = work.data();
+    for (int i = 0; i < n; ++i) {
+        T* yi = y + 4 * (perm ? perm[i] : i);
+        yi[0] = B(i, 0);
+        yi[1] = B(i, 1);
+        yi[2] = B(i, 2);
+        yi[3] = T(0);
+    }
+
+    // L y' = y, column j scatters y_j to the rows below it
+    for (int j = 0; j < n; ++j) {
+        const T* yj = y + 4 * j;
+        for (int p = outer[j]; p < outer[j + 1]; ++p) {
+            T* yi = y + 4 * inner[p];
+            const T l = values[p];
+            for (int k = 0; k < 4; ++k) yi[k] -= l * yj[k];
+        }
+    }
+
+    // y'' = D^-1 y', then L^T y''' = y'' from the last column up
+    for (int j = n - 1; j >= 0; --j) {
+        T* yj = y + 4 * j;
+        const T d = T(1) / D[j];
+        T s[4] = { yj[0] * d, yj[1] * d, yj[2] * d, yj[3] * d };
+        for (int p = outer[j]; p < outer[j + 1]; ++p) {
+            const T* yi = y + 4 * inner[p];
+            const T l = values[p];
+            for (int k = 0; k < 4; ++k) s[k] -= l * yi[k];
+        }
+        for (int k = 0; k < 4; ++k) yj[k] = s[k];
+    }
+
+    // x = P^-1 y'''
+    X.resize(n, 3);
+    for (int i = 0; i < n; ++i) {
+        const T* yi = y + 4 * (perm ? perm[i] : i);
+        X(i, 0) = yi[0];
+        X(i, 1) = yi[1];
+        X(i, 2) = yi[2];
+    }
+}
+
+template void solve_ldlt_xyz<double>(const Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> >&,
+                                     const Eigen::MatrixXd&, Eigen::MatrixXd&,
+                                     std::vector<double>&);
+template void solve_ldlt_xyz<float>(const Eigen::SimplicialLDLT< Eigen::SparseMatrix<float> >&,
+                                    const Eigen::MatrixXf&, Eigen::MatrixXf&,
+                                    std::vector<float>&);
+
+}
@@ -0,0 +1,22 @@
+#ifndef LDLT_SOLVE_H
+#define LDLT_SOLVE_H
+
+#include <Eigen/Sparse>
+#include <vector>
+
+namespace mesh_processing {
+
+// X = A^-1 B for the three columns of B with the factors of a
+// Eigen::SimplicialLDLT. SimplicialLDLT::solve runs the triangular solves
+// once per column; here the columns are interleaved, x y z padded to four,
+// so each substitution streams the factor once and updates a whole row per
+// entry. work holds the interleaved vectors between calls.
+template <typename T>
+void solve_ldlt_xyz(const Eigen::SimplicialLDLT< Eigen::SparseMatrix<T> >& ldlt,
+                    const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& B,
+                    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& X,
+                    std::vector<T>& work);
+
+}
+
+#endif // LDLT_SOLVE_H
@@ -0,0 +1,283 @@
+#include "lod.h"
+#include "eigen_interop.h"
+#include "reduction.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+typedef surface_mesh::Surface_mesh Mesh;
+
+// triangles per cluster, in level 0
+static const size_t CLUSTER_SIZE = 16384;
+// no coarser levels are made from a level with fewer triangles
+static const size_t MIN_TRIANGLES = 256;
+static const int MAX_LEVELS = 16;
+// a coarser grid that keeps more of the triangles is skipped
+static const double MIN_REDUCTION = 0.9;
+// 21 bits per axis of a grid cell key
+static const uint64_t MAX_CELL = (1u << 21) - 1;
+
+// the 10 low bits of x moved to every third bit
+static uint32_t spread_bits(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// the same triangle starts at its smallest index, orientation is kept
+static void rotate_to_smallest(uint32_t* t) {
+    if (t[1] < t[0] && t[1] < t[2]) std::rotate(t, t + 1, t + 3);
+    else if (t[2] < t[0] && t[2] < t[1]) std::rotate(t, t + 2, t + 3);
+}
+
+void LodHierarchy::build(const Mesh& mesh) {
+    indices_.clear();
+    ranges_.clear();
+    clusters_.clear();
+    errors_.clear();
+
+    // fan triangulation of every face
+    std::vector<uint32_t> triangles;
+    triangles.reserve(3 * mesh.n_faces());
+    for (auto f: mesh.faces()) {
+        auto fv = mesh.vertices(f);
+        const uint32_t v0 = (*fv).idx();
+        ++fv;
+        uint32_t v1 = (*fv).idx();
+        for (unsigned int k = 2; k < mesh.valence(f); ++k) {
+            ++fv;
+            const uint32_t v2 = (*fv).idx();
+            triangles.push_back(v0);
+            triangles.push_back(v1);
+            triangles.push_back(v2);
+            v1 = v2;
+        }
+    }
+    const int n = int(triangles.size() / 3);
+    if (n == 0) return;
+
+    Point lo = mesh.position(*mesh.vertices_begin()), hi = lo;
+    for (auto v: mesh.vertices()) {
+        lo.minimize(mesh.position(v));
+        hi.maximize(mesh.position(v));
+    }
+    const Point extent = hi - lo;
+    const Scalar largest = std::max(std::max(extent[0], extent[1]), extent[2]);
+    const Scalar to_grid = largest > 0 ? 1023.0f / largest : 0.0f;
+
+    // clusters are runs of CLUSTER_SIZE triangles in Morton order of the
+    // centroids, ties keep the face order
+    std::vector<std::pair<uint32_t, uint32_t> > order(n);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        const uint32_t* t = &triangles[3 * i];
+        const Point c = (mesh.position(Mesh::Vertex(t[0])) + mesh.position(Mesh::Vertex(t[1])) +
+                         mesh.position(Mesh::Vertex(t[2]))) / 3.0f;
+        uint32_t q[3];
+        for (int k = 0; k < 3; ++k) {
+            q[k] = (uint32_t) std::min(std::max((c[k] - lo[k]) * to_grid, 0.0f), 1023.0f);
+        }
+        order[i] = std::make_pair((spread_bits(q[0]) << 2) | (spread_bits(q[1]) << 1) |
+                                  spread_bits(q[2]), (uint32_t) i);
+    }
+    std::sort(order.begin(), order.end());
+
+    const int n_clusters = int((n + CLUSTER_SIZE - 1) / CLUSTER_SIZE);
+    clusters_.resize(n_clusters);
+    indices_.resize(3 * size_t(n));
+    // the grids follow from the sum, the levels are the same on any number
+    // of threads
+    const double edge_length = deterministic_sum(n, 0.0, [&](const int i) {
+        const uint32_t* t = &triangles[3 * order[i].second];
+        std::copy(t, t + 3, &indices_[3 * size_t(i)]);
+        double length = 0.0;
+        for (int k = 0; k < 3; ++k) {
+            length += distance(mesh.position(Mesh::Vertex(t[k])),
+                               mesh.position(Mesh::Vertex(t[(k + 1) % 3])));
+        }
+        return length;
+    });
+    std::vector<uint32_t>().swap(triangles);
+
+    ranges_.resize(n_clusters);
+    for (int c = 0; c < n_clusters; ++c) {
+        ranges_[c].first = uint32_t(c * CLUSTER_SIZE);
+        ranges_[c].count = uint32_t(std::min(CLUSTER_SIZE, n - c * CLUSTER_SIZE));
+    }
+    errors_.push_back(0.0f);
+
+    // the grid of level 1 is twice the mean edge length, it doubles per level
+    double cell = 2.0 * edge_length / (3.0 * n);
+    std::vector<uint32_t> representative(mesh.vertices_size());
+    std::vector<unsigned char> used(mesh.vertices_size());
+    std::vector<std::pair<uint64_t, uint32_t> > cells;
+    std::vector<std::vector<uint32_t> > coarse(n_clusters);
+    size_t current = 0;  // first range of the current level
+    size_t current_size = n;
+    for (int level = 1; level < MAX_LEVELS && current_size >= MIN_TRIANGLES && cell > 0.0;
+         ++level, cell *= 2.0) {
+        // one vertex per grid cell among the vertices of the current level,
+        // the one with the smallest index
+        std::fill(used.begin(), used.end(), 0);
+        for (int c = 0; c < n_clusters; ++c) {
+            const Range& r = ranges_[current + c];
+            const uint32_t* t = &indices_[3 * size_t(r.first)];
+            for (size_t j = 0; j < 3 * size_t(r.count); ++j) used[t[j]] = 1;
+        }
+        cells.clear();
+        for (size_t v = 0; v < used.size(); ++v) {
+            if (!used[v]) continue;
+            const Point& p = mesh.position(Mesh::Vertex(int(v)));
+            uint64_t key = 0;
+            for (int k = 0; k < 3; ++k) {
+                const double x = std::floor((p[k] - lo[k]) / cell);
+                key = (key << 21) | std::min(uint64_t(std::max(x, 0.0)), MAX_CELL);
+            }
+            cells.push_back(std::make_pair(key, uint32_t(v)));
+        }
+        std::sort(cells.begin(), cells.end());
+        for (size_t i = 0; i < cells.size(); ++i) {
+            const bool first = i == 0 || cells[i].first != cells[i - 1].first;
+            representative[cells[i].second] = first ? cells[i].second
+                                                    : representative[cells[i - 1].second];
+        }
+
+        // remapped triangles of every cluster without the degenerate and
+        // the duplicate ones
+        size_t coarse_size = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:coarse_size)
+        for (int c = 0; c < n_clusters; ++c) {
+            std::vector<uint32_t>& out = coarse[c];
+            out.clear();
+            const Range& range = ranges_[current + c];
+            const uint32_t* t = &indices_[3 * size_t(range.first)];
+            for (uint32_t j = 0; j < range.count; ++j, t += 3) {
+                uint32_t r[3] = { representative[t[0]], representative[t[1]], representative[t[2]] };
+                if (r[0] == r[1] || r[1] == r[2] || r[2] == r[0]) continue;
+                rotate_to_smallest(r);
+                out.insert(out.end(), r, r + 3);
+            }
+            typedef std::pair<uint64_t, uint32_t> Key;
+            std::vector<Key> keys(out.size() / 3);
+            for (size_t j = 0; j < keys.size(); ++j) {
+                keys[j] = Key((uint64_t(out[3 * j]) << 32) | out[3 * j + 1], out[3 * j + 2]);
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+            out.resize(3 * keys.size());
+            for (size_t j = 0; j < keys.size(); ++j) {
+                out[3 * j] = uint32_t(keys[j].first >> 32);
+                out[3 * j + 1] = uint32_t(keys[j].first);
+                out[3 * j + 2] = keys[j].second;
+            }
+            coarse_size += keys.size();
+        }
+        if (coarse_size == 0) break;
+        // too fine to pay off, the next grid starts from the current level again
+        if (coarse_size > MIN_REDUCTION * current_size) continue;
+
+        const size_t offset = ranges_.size();
+        for (int c = 0; c < n_clusters; ++c) {
+            Range range;
+            range.first = uint32_t(indices_.size() / 3);
+            range.count = uint32_t(coarse[c].size() / 3);
+            ranges_.push_back(range);
+            indices_.insert(indices_.end(), coarse[c].begin(), coarse[c].end());
+        }
+        errors_.push_back(Scalar(cell * std::sqrt(3.0)));
+        current = offset;
+        current_size = coarse_size;
+    }
+    refit(mesh);
+}
+
+void LodHierarchy::refit(const Mesh& mesh) {
+    const int n_clusters = int(clusters_.size());
+    const int levels = n_levels();
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < n_clusters; ++c) {
+        // sphere around the box center through the farthest vertex
+        Point lo(0.0f, 0.0f, 0.0f), hi(0.0f, 0.0f, 0.0f);
+        bool any = false;
+        for (int l = 0; l < levels; ++l) {
+            const Range& r = range(l, c);
+            for (size_t j = 3 * size_t(r.first); j < 3 * size_t(r.first + r.count); ++j) {
+                const Point& p = mesh.position(Mesh::Vertex(indices_[j]));
+                if (!any) lo = hi = p;
+                lo.minimize(p);
+                hi.maximize(p);
+                any = true;
+            }
+        }
+        const Point center = 0.5f * (lo + hi);
+        Scalar radius = 0.0f;
+        for (int l = 0; l < levels; ++l) {
+            const Range& r = range(l, c);
+            for (size_t j = 3 * size_t(r.first); j < 3 * size_t(r.first + r.count); ++j) {
+                radius = std::max(radius, sqrnorm(mesh.position(Mesh::Vertex(indices_[j])) - center));
+            }
+        }
+        clusters_[c].center = center;
+        clusters_[c].radius = std::sqrt(radius);
+    }
+}
+
+void frustum_planes(const Eigen::Matrix4f& model_view, const Eigen::Matrix4f& projection,
+                    Eigen::Vector4f planes[6]) {
+    const Eigen::Matrix4f mvp = projection * model_view;
+    for (int i = 0; i < 3; ++i) {
+        planes[2 * i] = (mvp.row(3) + mvp.row(i)).transpose();
+        planes[2 * i + 1] = (mvp.row(3) - mvp.row(i)).transpose();
+    }
+    for (int i = 0; i < 6; ++i) planes[i] /= planes[i].head<3>().norm();
+}
+
+void LodHierarchy::select(const Eigen::Matrix4f& model_view, const Eigen::Matrix4f& projection,
+                          const float viewport_height, const float max_error,
+                          std::vector<Range>& ranges) const {
+    ranges.clear();
+
+    Eigen::Vector4f planes[6];
+    frustum_planes(model_view, projection, planes);
+
+    const float scale = model_view.block<3, 1>(0, 0).norm();
+    // pixels per unit length in eye space at depth 1
+    const float focal = 0.5f * viewport_height * projection(1, 1);
+
+    for (int c = 0; c < n_clusters(); ++c) {
+        const Cluster& cluster = clusters_[c];
+        const Eigen::Vector3f center = as_eigen(cluster.center);
+        bool visible = true;
+        for (const Eigen::Vector4f& plane: planes) {
+            if (plane.head<3>().dot(center) + plane[3] < -cluster.radius) visible = false;
+        }
+        if (!visible) continue;
+
+        // depth of the nearest point of the sphere, all detail if the
+        // camera is inside
+        const float z = model_view.block<1, 3>(2, 0).dot(center.transpose()) + model_view(2, 3);
+        const float depth = -z - scale * cluster.radius;
+        int level = 0;
+        if (depth > 0.0f) {
+            const float largest_error = max_error * depth / (focal * scale);
+            while (level + 1 < n_levels() && errors_[level + 1] <= largest_error) ++level;
+        }
+
+        const Range& r = range(level, c);
+        if (r.count == 0) continue;
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == r.first) {
+            ranges.back().count += r.count;
+        } else {
+            ranges.push_back(r);
+        }
+    }
+}
+
+}
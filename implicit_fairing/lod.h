@@ -0,0 +1,78 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <Eigen/Core>
+#include <cstdint>
+#include <vector>
+
+namespace mesh_processing {
+
+// Levels of detail of the triangles of a Surface_mesh for rendering,
+// polygons are fanned into triangles. The triangles are grouped into
+// clusters of neighbouring triangles, in Morton order of their centroids.
+// Level 0 are the triangles of the mesh, every further level snaps the
+// vertices of the level before to a grid twice as coarse and keeps one mesh
+// vertex per cell, so all levels index the vertex buffer of the mesh.
+// build() once per connectivity, refit() after the vertices moved; the
+// levels stay those of the build then, only the cluster bounds follow.
+// the 6 planes of the view frustum of projection * model_view in mesh
+// coordinates, with unit normals that point inside: a sphere is outside if
+// plane.head<3>().dot(center) + plane[3] < -radius for one of them
+void frustum_planes(const Eigen::Matrix4f& model_view, const Eigen::Matrix4f& projection,
+                    Eigen::Vector4f planes[6]);
+
+class LodHierarchy {
+
+public:
+    // triangles [first, first + count) of indices()
+    struct Range {
+        uint32_t first, count;
+    };
+
+    void build(const surface_mesh::Surface_mesh& mesh);
+    void refit(const surface_mesh::Surface_mesh& mesh);
+    bool empty() const { return indices_.empty(); }
+    // bytes reserved by the indices and the clusters
+    size_t memory_usage() const {
+        return indices_.capacity() * sizeof(uint32_t) + ranges_.capacity() * sizeof(Range) +
+               clusters_.capacity() * sizeof(Cluster) + errors_.capacity() * sizeof(float);
+    }
+
+    int n_levels() const { return (int) errors_.size(); }
+    int n_clusters() const { return (int) clusters_.size(); }
+    // distance a vertex of level moved at most, 0 for level 0
+    float error(const int level) const { return errors_[level]; }
+    // 3 vertex indices per triangle, the levels one after another and the
+    // clusters one after another within every level
+    const std::vector<uint32_t>& indices() const { return indices_; }
+    // the triangles of cluster in level
+    const Range& range(const int level, const int cluster) const {
+        return ranges_[level * clusters_.size() + cluster];
+    }
+
+    // the ranges to draw for the camera, ranges of neighbouring clusters
+    // are merged: clusters outside the view frustum are skipped, the others
+    // get the coarsest level whose error projects to at most max_error
+    // pixels. model_view maps the mesh to eye space with a uniform scale,
+    // projection is a perspective projection, viewport_height in pixels.
+    void select(const Eigen::Matrix4f& model_view, const Eigen::Matrix4f& projection,
+                const float viewport_height, const float max_error,
+                std::vector<Range>& ranges) const;
+
+private:
+    // bounding sphere of the vertices of a cluster in all levels
+    struct Cluster {
+        surface_mesh::Point center;
+        float radius;
+    };
+
+    std::vector<uint32_t> indices_;
+    std::vector<Range> ranges_;
+    std::vector<Cluster> clusters_;
+    std::vector<float> errors_;
+};
+
+}
+
+#endif // LOD_H
@@ -1,17 +1,121 @@
 
+#ifndef GP_HEADLESS
 #include "viewer.h"
+#include "thumbnail_renderer.h"
+#endif
+#include "batch.h"
+#include "replay.h"
+#include "server.h"
+#include <surface_mesh/Threads.h>
+#include <surface_mesh/Trace.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+int main(int argc, char ** argv) {
+    // headless mode, no GL context is created
+    if (mesh_processing::is_batch_command(argc, argv)) {
+        mesh_processing::BatchOptions options;
+        std::string error;
+        if (!mesh_processing::parse_batch_options(argc, argv, options, error)) {
+            std::cerr << error << std::endl;
+            mesh_processing::print_batch_usage(argv[0]);
+            return -1;
+        }
+        // pictures of the results, drawn in a context of their own without
+        // a window
+#ifndef GP_HEADLESS
+        std::unique_ptr<mesh_processing::ThumbnailRenderer> thumbnails;
+        if (!options.thumbnail_dir.empty()) {
+            thumbnails.reset(new mesh_processing::ThumbnailRenderer(options.thumbnail_size));
+            if (!thumbnails->start(error)) {
+                std::cerr << "--thumbnails: " << error << std::endl;
+                return -1;
+            }
+            options.thumbnails = thumbnails.get();
+        }
+        int failed = mesh_processing::run_batch(options);
+        if (thumbnails) failed += thumbnails->finish();
+        return failed == 0 ? 0 : -1;
+#else
+        if (!options.thumbnail_dir.empty()) {
+            std::cerr << "--thumbnails: built without the viewer" << std::endl;
+            return -1;
+        }
+        return mesh_processing::run_batch(options) == 0 ? 0 : -1;
+#endif
+    }
+    // long-lived server, headless as well
+    if (mesh_processing::is_server_command(argc, argv)) {
+        mesh_processing::ServerOptions options;
+        std::string error;
+        if (!mesh_processing::parse_server_options(argc, argv, options, error)) {
+            std::cerr << error << std::endl;
+            mesh_processing::print_server_usage(argv[0]);
+            return -1;
+        }
+        return mesh_processing::run_server(options) ? 0 : -1;
+    }
+
+    // viewer actions of a --record session, timed
+    if (mesh_processing::is_replay_command(argc, argv)) {
+        mesh_processing::ReplayOptions options;
+        std::string error;
+        if (!mesh_processing::parse_replay_options(argc, argv, options, error)) {
+            std::cerr << error << std::endl;
+            mesh_processing::print_replay_usage(argv[0]);
+            return -1;
+        }
+        return mesh_processing::run_replay(options) ? 0 : -1;
+    }
+
+#ifdef GP_HEADLESS
+    // built without the viewer
+    mesh_processing::print_batch_usage(argv[0]);
+    return -1;
+#else
+    // --trace FILE records the session as a Chrome trace, --attach NAME
+    // follows the shared mesh of a batch run, --record FILE logs the
+    // actions for --replay, --threads N and --affinity none|compact|spread
+    // set the threads of the jobs; one CPU is kept for the UI thread
+    const char* trace = nullptr;
+    const char* attach = nullptr;
+    const char* record = nullptr;
+    surface_mesh::Thread_options threads;
+    threads.reserved = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--trace") == 0) trace = argv[i + 1];
+        else if (strcmp(argv[i], "--attach") == 0) attach = argv[i + 1];
+        else if (strcmp(argv[i], "--record") == 0) record = argv[i + 1];
+        else if (strcmp(argv[i], "--threads") == 0) threads.threads = unsigned(atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--affinity") == 0) {
+            if (strcmp(argv[i + 1], "compact") == 0) threads.affinity = surface_mesh::AFFINITY_COMPACT;
+            else if (strcmp(argv[i + 1], "spread") == 0) threads.affinity = surface_mesh::AFFINITY_SPREAD;
+        }
+    }
+    surface_mesh::set_thread_options(threads);
+    if (trace) surface_mesh::Trace::start();
 
-int main(int /* argc */, char ** /* argv */) {
     try {
         nanogui::init();
         {
             nanogui::ref<Viewer> app = new Viewer();
+            if (attach && !app->attach(attach)) {
+                std::cerr << attach << ": no shared mesh" << std::endl;
+            }
+            if (record && !app->record(record)) {
+                std::cerr << record << ": cannot write" << std::endl;
+            }
             app->drawAll();
             app->setVisible(true);
             nanogui::mainloop();
         }
 
         nanogui::shutdown();
+        if (trace && !surface_mesh::Trace::write(trace)) {
+            std::cerr << trace << ": cannot write" << std::endl;
+        }
     } catch (const std::runtime_error &e) {
         std::string error_msg = std::string("Caught a fatal error: ") + std::string(e.what());
 #if defined(_WIN32)
@@ -23,4 +127,5 @@ int main(int /* argc */, char ** /* argv */) {
     }
 
     return 0;
+#endif
 }
@@ -0,0 +1,151 @@
+#include "mesh_hash.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace mesh_processing {
+
+typedef surface_mesh::Surface_mesh Mesh;
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotl(const uint64_t x, const int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// unaligned little endian loads, the vectors of a mesh are aligned anyway
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t lane_round(uint64_t acc, const uint64_t input) {
+    acc += input * PRIME64_2;
+    return rotl(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t merge_round(uint64_t acc, const uint64_t value) {
+    acc ^= lane_round(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+static inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t xxhash64(const unsigned char* p, const size_t size, const uint64_t seed) {
+    const unsigned char* const end = p + size;
+    uint64_t h;
+    if (size >= 32) {
+        // four independent lanes over 32 byte stripes
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        const unsigned char* const limit = end - 32;
+        do {
+            v1 = lane_round(v1, read64(p));
+            v2 = lane_round(v2, read64(p + 8));
+            v3 = lane_round(v3, read64(p + 16));
+            v4 = lane_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+    h += uint64_t(size);
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= lane_round(0, read64(p));
+        h = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= uint64_t(read32(p)) * PRIME64_1;
+        h = rotl(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= uint64_t(*p) * PRIME64_5;
+        h = rotl(h, 11) * PRIME64_1;
+    }
+    return avalanche(h);
+}
+
+// not symmetric, the order of the chunks matters
+static inline uint64_t combine(const uint64_t left, const uint64_t right) {
+    return avalanche(merge_round(rotl(left, 17) * PRIME64_3, right));
+}
+
+uint64_t parallel_hash(const void* data, const size_t size, const uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    if (size <= HASH_CHUNK) return xxhash64(bytes, size, seed);
+
+    const int n_chunks = int((size + HASH_CHUNK - 1) / HASH_CHUNK);
+    std::vector<uint64_t> chunks(n_chunks);
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < n_chunks; ++c) {
+        const size_t begin = size_t(c) * HASH_CHUNK;
+        chunks[c] = xxhash64(bytes + begin, std::min(HASH_CHUNK, size - begin), seed);
+    }
+    // the same tree as deterministic_reduce()
+    for (int stride = 1; stride < n_chunks; stride *= 2) {
+        for (int c = 0; c + stride < n_chunks; c += 2 * stride) {
+            chunks[c] = combine(chunks[c], chunks[c + stride]);
+        }
+    }
+    return combine(chunks[0], uint64_t(size));
+}
+
+// the bytes of a property of trivially copyable elements
+template <class Property>
+static uint64_t property_hash(const Property& property, const uint64_t seed) {
+    const auto& values = property.vector();
+    return parallel_hash(values.data(), values.size() * sizeof(values[0]), seed);
+}
+
+uint64_t topology_hash(const Mesh& mesh) {
+    // the deleted elements keep their connectivity, the live counts tell
+    // meshes with different garbage apart
+    const uint64_t counts[] = { mesh.vertices_size(), mesh.halfedges_size(), mesh.faces_size(),
+                                mesh.n_vertices(), mesh.n_faces() };
+    uint64_t h = xxhash64(reinterpret_cast<const unsigned char*>(counts), sizeof(counts), 0);
+    h = combine(h, property_hash(mesh.get_vertex_property<Mesh::Vertex_connectivity>("v:connectivity"), 1));
+    h = combine(h, property_hash(mesh.get_halfedge_property<Mesh::Halfedge_connectivity>("h:connectivity"), 2));
+    h = combine(h, property_hash(mesh.get_face_property<Mesh::Face_connectivity>("f:connectivity"), 3));
+    return h;
+}
+
+uint64_t geometry_hash(const Mesh& mesh) {
+    const auto& points = mesh.points();
+    return parallel_hash(points.data(), points.size() * sizeof(surface_mesh::Point), 4);
+}
+
+MeshHash mesh_hash(const Mesh& mesh) {
+    MeshHash hash;
+    hash.topology = topology_hash(mesh);
+    hash.geometry = geometry_hash(mesh);
+    return hash;
+}
+
+}
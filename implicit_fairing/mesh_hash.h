@@ -0,0 +1,39 @@
+#ifndef MESH_HASH_H
+#define MESH_HASH_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace mesh_processing {
+
+// bytes per chunk of parallel_hash()
+const size_t HASH_CHUNK = 64 * 1024;
+
+// 64 bit hash of size bytes: xxHash64 of every HASH_CHUNK bytes in
+// parallel, the chunk hashes combined pairwise in a fixed tree, so the
+// value does not depend on the number of threads. For identities, e.g. of
+// cache entries, not for security; it is not the xxHash64 of the buffer.
+uint64_t parallel_hash(const void* data, const size_t size, const uint64_t seed = 0);
+
+// identity of a mesh as it is stored, with its numbering and deleted
+// elements: the same for the same mesh built the same way, e.g. read from
+// the same file. Two meshes with equal topology and new positions differ
+// in geometry only.
+struct MeshHash {
+    // the element counts and the vertex, halfedge and face connectivity
+    uint64_t topology = 0;
+    // the positions of all vertex slots
+    uint64_t geometry = 0;
+    bool operator==(const MeshHash& other) const {
+        return topology == other.topology && geometry == other.geometry;
+    }
+    bool operator!=(const MeshHash& other) const { return !(*this == other); }
+};
+uint64_t topology_hash(const surface_mesh::Surface_mesh& mesh);
+uint64_t geometry_hash(const surface_mesh::Surface_mesh& mesh);
+MeshHash mesh_hash(const surface_mesh::Surface_mesh& mesh);
+
+}
+
+#endif // MESH_HASH_H
@@ -0,0 +1,102 @@
+#include "mesh_loader.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <vector>
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <dirent.h>
+#endif
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+
+void MeshLoader::load(const string& filename) {
+    job_.cancel_and_wait();
+    filename_ = filename;
+    ok_ = false;
+    mesh_.reset(new MeshProcessing());
+    MeshProcessing* mesh = mesh_.get();
+    job_.start([this, mesh, filename](JobProgress& progress) {
+        mesh->set_progress(&progress);
+        mesh->set_mesh_cache(true);
+        ok_ = mesh->read_mesh(filename) && !progress.cancelled();
+        if (ok_) {
+            // what Viewer::refresh_mesh() reads first
+            mesh->get_indices();
+            mesh->get_normals();
+            mesh->get_dist_max();
+            // the next open of the file skips the parse and the attributes
+            if (!mesh->is_from_cache() && !progress.cancelled() &&
+                !mesh->save_mesh_cache(filename)) {
+                std::cerr << MeshProcessing::mesh_cache_path(filename) << ": cannot write"
+                          << std::endl;
+            }
+            ok_ = progress.report(1.0f);
+        }
+        mesh->set_progress(nullptr);
+    });
+}
+
+bool MeshLoader::get_bounding_box(Point& min, Point& max) const {
+    // read_mesh() reports 0.5 once the bounds are written
+    if (!mesh_ || progress() < 0.5f) return false;
+    mesh_->get_bounding_box(min, max);
+    return true;
+}
+
+std::unique_ptr<MeshProcessing> MeshLoader::take() {
+    if (running()) return std::unique_ptr<MeshProcessing>();
+    std::unique_ptr<MeshProcessing> mesh = std::move(mesh_);
+    if (!ok_) mesh.reset();
+    return mesh;
+}
+
+static bool has_mesh_extension(const string& name) {
+    const size_t dot = name.rfind('.');
+    if (dot == string::npos) return false;
+    string ext = name.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "off" || ext == "obj" || ext == "stl" || ext == "poly" || ext == "ply" ||
+           ext == "smc" || ext == "pm";
+}
+
+string next_mesh_file(const string& filename) {
+    const size_t slash = filename.find_last_of("/\\");
+    const string dir = slash == string::npos ? string() : filename.substr(0, slash + 1);
+    const string name = slash == string::npos ? filename : filename.substr(slash + 1);
+
+    std::vector<string> names;
+#if defined(_WIN32)
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((dir + "*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) return string();
+    do {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+            has_mesh_extension(entry.cFileName)) {
+            names.push_back(entry.cFileName);
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR* d = opendir(dir.empty() ? "." : dir.c_str());
+    if (!d) return string();
+    while (const dirent* entry = readdir(d)) {
+        if (entry->d_name[0] != '.' && has_mesh_extension(entry->d_name)) {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(d);
+#endif
+
+    std::sort(names.begin(), names.end());
+    if (names.empty()) return string();
+    // the first name after the current one, which need not be listed
+    std::vector<string>::const_iterator next = std::upper_bound(names.begin(), names.end(), name);
+    if (next == names.end()) next = names.begin();
+    return *next == name ? string() : dir + *next;
+}
+
+}
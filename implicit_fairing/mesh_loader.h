@@ -0,0 +1,54 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include <memory>
+#include <string>
+#include "async_job.h"
+#include "mesh_processing.h"
+
+namespace mesh_processing {
+
+// Reads a mesh file into a new MeshProcessing on a worker thread, including
+// the attributes the viewer uploads first, so the owner only swaps it in.
+// The viewer keeps one loader for the file that is opened and one that
+// prefetches the next file of the directory.
+class MeshLoader {
+
+public:
+    // starts loading filename, a load in progress is cancelled and its
+    // result dropped
+    void load(const string& filename);
+    // the result of a cancelled load is dropped; the file itself is read to
+    // the end, cancellation takes effect before the attributes are computed
+    void cancel() { job_.cancel(); }
+    bool running() const { return job_.running(); }
+    bool pending() const { return job_.pending(); }
+    float progress() const { return job_.progress(); }
+    // the file of the current or the last load
+    const string& filename() const { return filename_; }
+
+    // the bounds of the mesh being loaded once they are known, usually
+    // long before the load finished
+    bool get_bounding_box(surface_mesh::Point& min, surface_mesh::Point& max) const;
+
+    // true exactly once after a load ended
+    bool poll_finished() { return job_.poll_finished(); }
+    // the loaded mesh after poll_finished(), nullptr if the file could not
+    // be read or the load was cancelled; the loader is empty afterwards
+    std::unique_ptr<MeshProcessing> take();
+
+private:
+    AsyncJob job_;
+    string filename_;
+    // written by the worker, owned by the caller once the job was collected
+    std::unique_ptr<MeshProcessing> mesh_;
+    bool ok_ = false;
+};
+
+// the file after filename in its directory in name order that read_mesh()
+// has a reader for, wrapping around at the end; empty if there is no other
+string next_mesh_file(const string& filename);
+
+}
+
+#endif // MESH_LOADER_H
@@ -1,664 +1,3616 @@
 
 #define _USE_MATH_DEFINES
 #include "mesh_processing.h"
+#include "conjugate_gradient.h"
+#include "geometry_kernels.h"
+#include "ldlt_solve.h"
+#include "metrics.h"
+#include "progressive_mesh.h"
+#include "reduction.h"
+#include <surface_mesh/IO.h>
+#include <surface_mesh/Reorder.h>
+#include <surface_mesh/Trace.h>
+#include <surface_mesh/Weld.h>
+#include <sys/stat.h>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <queue>
 #include <set>
+#include <unordered_map>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace mesh_processing {
 
 using surface_mesh::Point;
 using surface_mesh::Scalar;
 using surface_mesh::Color;
+using surface_mesh::Color8;
+using surface_mesh::Property_vector;
 using std::min;
 using std::max;
 using std::cout;
 using std::endl;
 
-MeshProcessing::MeshProcessing(const string& filename) {
+// property names interned once, lookups through the keys are array accesses
+static const surface_mesh::Property_key e_feature_key("e:feature");
+static const surface_mesh::Property_key f_self_intersection_key("f:self_intersection");
+static const surface_mesh::Property_key v_curvature_key("v:curvature");
+static const surface_mesh::Property_key v_gauss_curvature_key("v:gauss_curvature");
+static const surface_mesh::Property_key v_max_curvature_key("v:max_curvature");
+static const surface_mesh::Property_key v_min_curvature_key("v:min_curvature");
+static const surface_mesh::Property_key v_deviation_key("v:deviation");
+static const surface_mesh::Property_key v_max_direction_key("v:max_direction");
+static const surface_mesh::Property_key v_normal_key("v:normal");
+static const surface_mesh::Property_key v_selected_key("v:selected");
+static const surface_mesh::Property_key v_self_intersection_key("v:self_intersection");
+static const surface_mesh::Property_key v_session_init_key("v:session_init");
+static const surface_mesh::Property_key v_unicurvature_key("v:unicurvature");
+static const surface_mesh::Property_key v_valence_key("v:valence");
+
+// a local edit is one that moves at most every LOCAL_UPDATE_FRACTION-th
+// vertex, its attributes are updated on the two-ring of the moved vertices
+static const size_t LOCAL_UPDATE_FRACTION = 8;
+
+MeshProcessing::MeshProcessing(const string& filename, const unsigned int read_attributes)
+    : read_attributes_(read_attributes) {
     load_mesh(filename);
 }
 
+MeshProcessing::MeshProcessing(const Mesh& mesh) {
+    set_mesh(mesh);
+}
+
+MeshProcessing::MeshProcessing() {}
+
+// hash of the float bits, tells whether the positions are the same as in a
+// previous call
+static uint64_t positions_key(const Property_vector<Point>& points) {
+    return parallel_hash(points.data(), points.size() * sizeof(Point));
+}
+
+// signed volume of the cones from center over the triangles of mesh with the
+// vertices at position(i), the same on any number of threads; a scale about
+// center changes it by the cube of the scale
+template <typename Position>
+static double signed_volume(const Mesh& mesh, const Point& center, const Position& position) {
+    const surface_mesh::Vec3d c(center);
+    return deterministic_sum(int(mesh.faces_size()), 0.0, [&](const int i) {
+        const Mesh::Face f(i);
+        if (mesh.is_deleted(f)) return 0.0;
+        const Mesh::Halfedge h = mesh.halfedge(f);
+        const surface_mesh::Vec3d p0 = position(mesh.from_vertex(h).idx()) - c;
+        const surface_mesh::Vec3d p1 = position(mesh.to_vertex(h).idx()) - c;
+        const surface_mesh::Vec3d p2 = position(mesh.to_vertex(mesh.next_halfedge(h)).idx()) - c;
+        return dot(p0, cross(p1, p2)) / 6.0;
+    });
+}
+
+// the scale that takes the volume after back to before, 1 if the sign flipped
+static double volume_scale(const double before, const double after) {
+    if (before == 0.0 || after == 0.0 || (before > 0.0) != (after > 0.0)) return 1.0;
+    return std::cbrt(before / after);
+}
+
 void MeshProcessing::implicit_smoothing(const double timestep) {
+    SURFACE_MESH_TRACE_ZONE("implicit_smoothing");
+    implicit_step(timestep);
+}
+
+bool MeshProcessing::adaptive_implicit_smoothing(const double total_time,
+                                                 const double tolerance,
+                                                 const double max_timestep) {
+    SURFACE_MESH_TRACE_ZONE("adaptive_implicit_smoothing");
+    smoothing_iterations_ = 0;
+    if (!(total_time > 0.0)) return true;
+
+    Property_vector<Point>& points = mesh_.points();
+    const int n = mesh_.n_vertices();
+    bool closed = true;
+    for (auto h: mesh_.compact_halfedges()) {
+        if (mesh_.is_boundary(h)) {
+            closed = false;
+            break;
+        }
+    }
+    auto volume = [&]() {
+        return signed_volume(mesh_, Point(0.0f, 0.0f, 0.0f), [&](const int i) {
+            return surface_mesh::Vec3d(points[i]);
+        });
+    };
+    const double radius = std::max(get_dist_max(), std::numeric_limits<float>::min());
+
+    // the operator of the starting positions for all steps
+    laplace_operator(true, false);
+    laplace_frozen_ = true;
+
+    // dt = total_time / 2^level; the elapsed time stays a multiple of dt,
+    // dyadic fractions are exact in double
+    const int max_level = 40;
+    int level = 0;
+    while (level < max_level && total_time / std::ldexp(1.0, level) > max_timestep) ++level;
+    double elapsed = 0.0;
+    double volume_before = closed ? volume() : 0.0;
+    unsigned int rejected = 0, changes = 0;
+    double last_timestep = 0.0;
+    std::vector<Point> before;
+    bool ok = true;
+    while (elapsed < total_time) {
+        // an expired run keeps the steps it accepted
+        if (!report_progress(float(elapsed / total_time))) {
+            ok = !cancelled();
+            break;
+        }
+        const double dt = total_time / std::ldexp(1.0, level);
+        if (dt != last_timestep) ++changes;
+        last_timestep = dt;
+        before.assign(points.begin(), points.end());
+        if (!implicit_step(dt)) {
+            ok = false;
+            break;
+        }
+
+        const double squared = deterministic_sum(n, 0.0, [&](const int i) {
+            return double(sqrnorm(points[i] - before[i]));
+        });
+        double error = std::sqrt(squared / std::max(n, 1)) / radius;
+        double volume_after = 0.0;
+        if (closed) {
+            volume_after = volume();
+            if (volume_before != 0.0) {
+                error = std::max(error, std::abs(volume_after - volume_before) /
+                                        std::abs(volume_before));
+            }
+        }
+        if (error > tolerance && level < max_level) {
+            std::copy(before.begin(), before.end(), points.begin());
+            ++level;
+            ++rejected;
+            continue;
+        }
+        elapsed += dt;
+        volume_before = volume_after;
+        ++smoothing_iterations_;
+        // twice the step if this one was well within the tolerance and the
+        // doubled step still ends on the total; a new size costs a
+        // factorization, about as much as eight back-substitutions, so only
+        // while eight doubled steps remain
+        if (error < 0.25 * tolerance && level > 0 && std::fmod(elapsed, 2.0 * dt) == 0.0 &&
+            elapsed + 16.0 * dt <= total_time) {
+            --level;
+        }
+    }
+    laplace_frozen_ = false;
+    printf("adaptive implicit smoothing: %u steps, %u rejected, %u step sizes.\n",
+           smoothing_iterations_, rejected, changes);
+    return ok;
+}
 
+bool MeshProcessing::implicit_step(const double timestep) {
     const int n = mesh_.n_vertices();
 
     // get vertex position
-    auto points = mesh_.vertex_property<Point>("v:point");
+    Property_vector<Point>& points = mesh_.points();
 
-    // compute cotan edge weights and vertex areas
-    calc_weights ();
-    auto cotan = mesh_.edge_property<Scalar>("e:weight");
-    auto area_inv = mesh_.vertex_property<Scalar>("v:weight");
+    // (M + dt*L) X = M B, warm-started from the current positions; only the
+    // mass here, solve_laplace() assembles the matrix if the solver needs it
+    const LaplaceOperator& op = laplace_operator(true, false);
+    SolverWorkspace& ws = workspace_;
+    ws.B.resize(n, 3);
+    for (int i = 0; i < n; ++i) {
+        for (int dim = 0; dim < 3; ++dim) {
+            ws.B(i, dim) = points[i][dim] * op.mass()[i];
+        }
+    }
+    ws.X = as_eigen(points).transpose().cast<double>();
+    const Point center = mesh_center_;
+    const double volume = !volume_preservation_ ? 0.0 : signed_volume(mesh_, center,
+            [&](const int i) { return surface_mesh::Vec3d(points[i]); });
+    if (!solve_laplace(1.0, timestep, ws.B, ws.X)) {
+        return false;
+    }
 
-    // A*X = B
-    Eigen::SparseMatrix<double> A(n,n);
-    Eigen::MatrixXd B(n,3);
+    // copy solution
+    SURFACE_MESH_TRACE_ZONE("copy-back");
+    if (!volume_preservation_) {
+        as_eigen(points) = ws.X.transpose().cast<float>();
+        return true;
+    }
+    const Eigen::MatrixXd& X = ws.X;
+    const double scale = volume_scale(volume, signed_volume(mesh_, center, [&](const int i) {
+        return surface_mesh::Vec3d(X(i, 0), X(i, 1), X(i, 2));
+    }));
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        for (int dim = 0; dim < 3; ++dim) {
+            points[i][dim] = float(center[dim] + scale * (X(i, dim) - center[dim]));
+        }
+    }
+    return true;
+}
 
-    // nonzero elements of A as triplets: (row, column, value)
-    std::vector< Eigen::Triplet<double> > triplets;
+// the solver types that only read the lower triangle of a system, which is
+// then assembled without the upper one; CG multiplies with both, the GPU
+// backends upload the full matrix
+static bool reads_lower_triangle(const MeshProcessing::SOLVER_TYPE type) {
+    return type == MeshProcessing::DIRECT_LDLT || type == MeshProcessing::DIRECT_LDLT_FLOAT ||
+           type == MeshProcessing::DIRECT_CHOLMOD || type == MeshProcessing::DIRECT_PARDISO;
+}
 
-    // setup matrix A and rhs B
-    for (int i = 0; i < n; ++i)
-    {
-        Mesh::Vertex v(i);
+const LaplaceOperator& MeshProcessing::laplace_operator(const bool cotan, const bool assemble) {
+    LaplaceOperator& op = cotan ? cotan_laplace_ : uniform_laplace_;
+    const LaplaceOperator::WEIGHTS type = cotan ? LaplaceOperator::COTAN : LaplaceOperator::UNIFORM;
+    const uint64_t key = !cotan ? 0 : laplace_frozen_ && !op.empty() ? op.positions_key()
+                                                                     : positions_key(mesh_.points());
+    const int n = mesh_.n_vertices();
+    if (!op.matches(type, mesh_.topology_revision(), key)) {
+        SURFACE_MESH_TRACE_ZONE("laplace weights");
+        Eigen::VectorXd mass(n);
+        if (cotan) {
+            // the cotan edge weights and vertex areas, the edge weights move
+            // into the operator
+            update_soa();
+            CotanWeights weights;
+            calc_weights(weights);
+            for (int i = 0; i < n; ++i) mass(i) = 1.0 / weights.vertex[i];
+            op.assign(type, weights.edge, mass, mesh_.topology_revision(), key);
+            // the factors of the previous operator no longer apply
+            laplace_factorization_.factorized = false;
+            geodesic_.heat.factorized = false;
+            geodesic_.poisson.factorized = false;
+        } else {
+            Property_vector<Scalar> ones(mesh_.edges_size(), 1.0f);
+            mass.setOnes();
+            op.assign(type, ones, mass, mesh_.topology_revision(), key);
+        }
+    }
+    if (!assemble || op.assembled()) return op;
+
+    SURFACE_MESH_TRACE_ZONE("laplace operator");
+    std::vector<int>& index = workspace_.index;
+    index.resize(n);
+    for (int i = 0; i < n; ++i) index[i] = i;
+    workspace_.diag.assign(n, 0.0);
+    Eigen::SparseMatrix<double> L;
+    assemble_cotan_system(op.edge_weights(), index, n, workspace_.diag, 1.0, L);
+    op.assign_matrix(L);
+    return op;
+}
 
-        double vweight = area_inv[v];
+bool MeshProcessing::solve_laplace(const double mass_scale, const double laplace_scale,
+                                   const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+    return solve_laplace(mass_scale, laplace_scale, B, X, laplace_factorization_,
+                         laplace_factor_scales_, true);
+}
 
-        // rhs row
-        for (int dim = 0; dim < 3; ++dim) {
-            B(i, dim) = points[v][dim] / vweight;
+bool MeshProcessing::solve_laplace(const double mass_scale, const double laplace_scale,
+                                   const Eigen::MatrixXd& B, Eigen::MatrixXd& X,
+                                   SpdFactorization& factorization, double* factor_scales,
+                                   const bool pinned) {
+    const bool matrix_free = solver_type_ == CG_MATRIX_FREE;
+    const LaplaceOperator& op = laplace_operator(true, !matrix_free);
+    const int n = op.size();
+
+    // lhs on the pattern of L, same sizes keep the storage of A; the
+    // matrix-free products need none
+    SolverWorkspace& ws = workspace_;
+    if (matrix_free) {
+        ws.A = Eigen::SparseMatrix<double>();
+    } else {
+        SURFACE_MESH_TRACE_ZONE("combine");
+        op.combine(mass_scale, laplace_scale, ws.A, reads_lower_triangle(solver_type_));
+    }
+    ws.index.resize(n);
+    for (int i = 0; i < n; ++i) ws.index[i] = i;
+    if (!report_progress(0.5f)) {
+        return false;
+    }
+
+    factorization.set_revision(mesh_.topology_revision());
+    // the factors of the same operator and scales still apply, e.g. after
+    // an undo
+    if (factor_scales[0] != mass_scale || factor_scales[1] != laplace_scale) {
+        factorization.factorized = false;
+    }
+    factor_scales[0] = mass_scale;
+    factor_scales[1] = laplace_scale;
+    const MatrixFreeSystem system = { &op, mass_scale, laplace_scale };
+    if (!pinned) {
+        return solve_spd_system(ws.A, B, X, ws.index, factorization,
+                                matrix_free ? &system : nullptr);
+    }
+    return solve_pinned_system(ws.A, B, X, ws.index, factorization,
+                               matrix_free ? &system : nullptr);
+}
+
+// bytes of the compressed storage of A
+template <typename T>
+static size_t sparse_memory(const Eigen::SparseMatrix<T>& A) {
+    return size_t(A.nonZeros()) * (sizeof(T) + sizeof(int)) +
+           size_t(A.outerSize() + 1) * sizeof(int);
+}
+
+template <typename T>
+static size_t dense_memory(const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& M) {
+    return size_t(M.size()) * sizeof(T);
+}
+
+// bytes of the factors L and D
+template <typename T>
+static size_t ldlt_memory(const Eigen::SimplicialLDLT< Eigen::SparseMatrix<T> >& ldlt) {
+    return sparse_memory(ldlt.matrixL().nestedExpression()) +
+           size_t(ldlt.vectorD().size()) * sizeof(T);
+}
+
+size_t MeshProcessing::SolverWorkspace::memory() const {
+    return sparse_memory(A) + dense_memory(B) + dense_memory(X) +
+           index.capacity() * sizeof(int) + diag.capacity() * sizeof(double) +
+           triplets.capacity() * sizeof(Eigen::Triplet<double>) +
+           sparse_memory(A_float) + dense_memory(R) + dense_memory(R_float) +
+           dense_memory(X_float) + xyz.capacity() * sizeof(double) +
+           xyz_float.capacity() * sizeof(float);
+}
+
+void MeshProcessing::SpdFactorization::set_revision(const unsigned int topology_revision) {
+    if (revision != topology_revision) {
+        revision = topology_revision;
+        analyzed = analyzed_float = analyzed_backend = analyzed_blocks = false;
+        factorized = false;
+    }
+}
+
+void MeshProcessing::SpdFactorization::set_ordering(const FILL_ORDERING fill_ordering) {
+    if (ordering != fill_ordering) {
+        ordering = fill_ordering;
+        analyzed = analyzed_float = false;
+        factorized = false;
+    }
+}
+
+size_t MeshProcessing::InteriorSystem::memory() const {
+    return index.capacity() * sizeof(int) + sparse_memory(L) +
+           (coupling_start.capacity() + coupling_vertex.capacity()) * sizeof(int) +
+           coupling_weight.capacity() * sizeof(double);
+}
+
+size_t MeshProcessing::SpdFactorization::memory() const {
+    return (analyzed ? ldlt_memory(ldlt) : 0) + (analyzed_float ? ldlt_memory(ldlt_float) : 0) +
+           (analyzed_backend ? backend->memory() : 0) + blocks.memory_usage() +
+           dense_memory(pins.Z) +
+           size_t(pins.S.rows()) * pins.S.rows() * sizeof(double);
+}
+
+void MeshProcessing::SpdFactorization::release() {
+    // the Eigen solvers are not assignable, factorizing an empty matrix
+    // releases their factors
+    ldlt.compute(Eigen::SparseMatrix<double>());
+    ldlt_float.compute(Eigen::SparseMatrix<float>());
+    backend.reset();
+    blocks.clear();
+    analyzed = analyzed_float = analyzed_backend = analyzed_blocks = false;
+    factorized = false;
+    pins = Pins();
+}
+
+// the solver types that run an external backend
+static bool is_backend(const MeshProcessing::SOLVER_TYPE type) {
+    return type == MeshProcessing::DIRECT_CHOLMOD || type == MeshProcessing::DIRECT_PARDISO ||
+           type == MeshProcessing::DIRECT_CUSOLVER || type == MeshProcessing::CG_AMGX;
+}
+
+// the external backend behind a solver type
+static SpdBackendKind backend_kind(const MeshProcessing::SOLVER_TYPE type) {
+    switch (type) {
+    case MeshProcessing::DIRECT_PARDISO: return SPD_PARDISO;
+    case MeshProcessing::DIRECT_CUSOLVER: return SPD_CUSOLVER;
+    case MeshProcessing::CG_AMGX: return SPD_AMGX;
+    default: return SPD_CHOLMOD_SUPERNODAL;
+    }
+}
+
+// the --solver name of a CG solver type, labels its solves in the metrics
+static const char* cg_solver_name(const MeshProcessing::SOLVER_TYPE type) {
+    switch (type) {
+    case MeshProcessing::CG_INCOMPLETE_CHOLESKY: return "ichol";
+    case MeshProcessing::CG_MULTIGRID: return "multigrid";
+    case MeshProcessing::CG_SCHWARZ: return "schwarz";
+    case MeshProcessing::CG_MATRIX_FREE: return "matrix-free";
+    default: return "cg";
+    }
+}
+
+bool MeshProcessing::solver_available(const SOLVER_TYPE type) {
+    if (is_backend(type)) {
+        return spd_backend_available(backend_kind(type));
+    }
+    return true;
+}
+
+void MeshProcessing::note_solver_memory(const Eigen::SparseMatrix<double>& A,
+                                        const Eigen::MatrixXd& B, const Eigen::MatrixXd& X,
+                                        const size_t factor_bytes) {
+    peak_solver_memory_ = std::max(peak_solver_memory_, sparse_memory(A) + dense_memory(B) +
+                                                        dense_memory(X) + factor_bytes);
+}
+
+MeshProcessing::MemoryReport MeshProcessing::memory_report() const {
+    MemoryReport report;
+    report.mesh = mesh_.memory_report();
+    report.mirrors = size_t(indices_.size()) * sizeof(uint32_t) +
+                     size_t(selection_.size()) * sizeof(float);
+    report.points_init = points_init_.capacity() * sizeof(Point);
+    report.history = history_.memory_usage() + history_.state_memory();
+    report.acceleration = bvh_.memory_usage() + one_ring_.memory_usage() + soa_.memory_usage() +
+                          multigrid_.memory_usage() + eigenbasis_.memory_usage() + lod_.memory_usage() +
+                          draw_clusters_.memory_usage();
+    for (const OneRingAdjacency& ring: coarse_rings_) report.acceleration += ring.memory_usage();
+    report.solver += laplace_factorization_.memory() + interior_factorization_.memory() +
+                     region_factorization_.memory() + geodesic_.heat.memory() +
+                     geodesic_.poisson.memory();
+    report.workspace = workspace_.memory() + cotan_laplace_.memory_usage() +
+                       uniform_laplace_.memory_usage() + interior_.memory() +
+                       region_.index.capacity() * sizeof(int);
+    report.solver += sparse_memory(cg_ichol_solver_.preconditioner().factor()) +
+                     cg_multigrid_solver_.preconditioner().memory_usage() +
+                     cg_schwarz_solver_.preconditioner().memory_usage();
+    report.peak_solver = peak_solver_memory_;
+    return report;
+}
+
+bool MeshProcessing::solve_spd_system(const Eigen::SparseMatrix<double>& A,
+                                      const Eigen::MatrixXd& B,
+                                      Eigen::MatrixXd& X,
+                                      const std::vector<int>& index,
+                                      SpdFactorization& factorization,
+                                      const MatrixFreeSystem* matrix_free) {
+    factorization.set_ordering(fill_ordering_);
+    // direct factors of the same values are used as they are
+    const bool reuse_factors = factorization.factorized &&
+                               factorization.factorized_type == solver_type_;
+    factorization.factorized = reuse_factors;
+    factorization.factorized_type = solver_type_;
+    if (!reuse_factors) ++factorization.generation;
+    Metrics::record_cache("factorization", reuse_factors);
+    if (solver_type_ == DIRECT_LDLT_FLOAT) {
+        return solve_mixed_precision(A, B, X, index, factorization);
+    }
+    if (is_backend(solver_type_)) {
+        if (!factorization.backend || factorization.backend_type != solver_type_) {
+            factorization.backend = make_spd_backend(backend_kind(solver_type_));
+            factorization.backend_type = solver_type_;
+            factorization.analyzed_backend = false;
+        }
+        SpdBackend& backend = *factorization.backend;
+        if (!reuse_factors) {
+            SURFACE_MESH_TRACE_ZONE("factorize");
+            backend.set_tolerance(solver_tolerance_, solver_max_iterations_);
+            if (!factorization.analyzed_backend) {
+                backend.analyze(A);
+                factorization.analyzed_backend = true;
+            }
+            if (!backend.factorize(A)) {
+                printf("%s factorization failed.\n", backend.name());
+                factorization.analyzed_backend = false;
+                return false;
+            }
+            factorization.factorized = true;
+        }
+        // the factorization itself cannot be interrupted; its factors are
+        // kept for the next call, an expired job still gets the cheap solve
+        if (cancelled()) return false;
+        note_solver_memory(A, B, X, backend.memory());
+        SURFACE_MESH_TRACE_ZONE("solve");
+        backend.solve(B, X);
+        if (backend.iterations() >= 0) {
+            printf("%s: %d iterations.\n", backend.name(), backend.iterations());
+        }
+        return true;
+    }
+    if (solver_type_ == DIRECT_LDLT) {
+        // the matrix of a mesh in several pieces is block diagonal, the
+        // blocks are factorized and solved concurrently
+        BlockDiagonalLDLT& blocks = factorization.blocks;
+        if (!factorization.analyzed_blocks) {
+            int n_components;
+            const std::vector<int>& component = vertex_components(n_components);
+            std::vector<int> row_component(A.rows(), 0);
+            for (size_t v = 0; v < index.size() && v < component.size(); ++v) {
+                if (index[v] >= 0) row_component[index[v]] = component[v];
+            }
+            // groups of a few thousand rows at least, below that the threads
+            // cost more than the factorizations
+            int n_threads = 1;
+#ifdef _OPENMP
+            n_threads = omp_get_max_threads();
+#endif
+            blocks.set_blocks(row_component, n_components,
+                              std::max(4096, int(A.rows()) / (4 * n_threads)));
+            factorization.analyzed_blocks = true;
+        }
+        if (blocks.n_groups() > 1) {
+            if (!reuse_factors) {
+                SURFACE_MESH_TRACE_ZONE("factorize");
+                blocks.factorize(A);
+            }
+            note_solver_memory(A, B, X, blocks.memory_usage());
+            if (blocks.info() != Eigen::Success) {
+                printf("linear solver factorization failed.\n");
+                factorization.analyzed_blocks = false;
+                factorization.factorized = false;
+                return false;
+            }
+            factorization.factorized = true;
+            if (cancelled()) return false;
+            SURFACE_MESH_TRACE_ZONE("solve");
+            blocks.solve(B, X);
+            return true;
         }
 
-        // lhs row
-        double ww(0.0);
-        for (auto hv: mesh_.halfedges(v))
+        // the sparsity pattern only depends on the connectivity: analyze it
+        // once and only redo the numerical factorization for new values
+        Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> >& ldlt = factorization.ldlt;
+        bool& pattern_analyzed = factorization.analyzed;
+        if (!reuse_factors) {
+            SURFACE_MESH_TRACE_ZONE("factorize");
+            if (!pattern_analyzed) {
+                analyze_pattern(factorization.ldlt, A, index);
+                pattern_analyzed = true;
+            }
+            ldlt.factorize(A);
+        }
+        note_solver_memory(A, B, X, ldlt_memory(ldlt));
+        if (ldlt.info() != Eigen::Success) {
+            printf("linear solver factorization failed.\n");
+            pattern_analyzed = false;
+            factorization.factorized = false;
+            return false;
+        }
+        factorization.factorized = true;
+        if (cancelled()) return false;
+        SURFACE_MESH_TRACE_ZONE("solve");
+        // one pass over the factor for x, y and z
+        solve_ldlt_xyz(ldlt, B, X, workspace_.xyz);
+        return true;
+    }
+
+    // A is symmetric positive definite, so CG applies directly; every
+    // iteration checks the progress, the iterate of a stopped solve is kept
+    Eigen::ComputationInfo info;
+    int iterations;
+    double error;
+    bool stopped;
+    if (solver_type_ == CG_MATRIX_FREE && matrix_free) {
+        const OneRingAdjacency& rings = one_ring();
+        bool converged;
+        {
+            SURFACE_MESH_TRACE_ZONE("solve");
+            converged = matrix_free->op->solve_matrix_free(
+                    rings, matrix_free->mass_scale, matrix_free->laplace_scale, B, X,
+                    solver_tolerance_, solver_max_iterations_, iterations, error, progress_,
+                    stopped);
+        }
+        // the weights and the one-rings instead of the matrix, the CG
+        // vectors in place of the preconditioner
+        note_solver_memory(A, B, X, matrix_free->op->memory_usage() + rings.memory_usage() +
+                                    size_t(B.rows()) * 13 * sizeof(double));
+        info = converged ? Eigen::Success : Eigen::NoConvergence;
+    } else if (solver_type_ == CG_JACOBI || solver_type_ == CG_MATRIX_FREE) {
+        cg_jacobi_solver_.setTolerance(solver_tolerance_);
+        cg_jacobi_solver_.setMaxIterations(solver_max_iterations_);
+        {
+            // preconditioner setup
+            SURFACE_MESH_TRACE_ZONE("factorize");
+            cg_jacobi_solver_.compute(A);
+        }
+        // the Jacobi preconditioner is the inverse diagonal
+        note_solver_memory(A, B, X, size_t(A.rows()) * sizeof(double));
         {
-            Mesh::Vertex vv = mesh_.to_vertex(hv);
-            Mesh::Edge e = mesh_.edge(hv);
+            SURFACE_MESH_TRACE_ZONE("solve");
+            info = conjugate_gradient(cg_jacobi_solver_, A, B, X, progress_, iterations, error,
+                                      stopped);
+        }
+    } else if (solver_type_ == CG_SCHWARZ) {
+        cg_schwarz_solver_.setTolerance(solver_tolerance_);
+        cg_schwarz_solver_.setMaxIterations(solver_max_iterations_);
+        {
+            // overlapping subdomain factors, one LDLT per block
+            SURFACE_MESH_TRACE_ZONE("factorize");
+            cg_schwarz_solver_.preconditioner().set_partition(subdomain_partition(), index);
+            cg_schwarz_solver_.compute(A);
+        }
+        note_solver_memory(A, B, X, cg_schwarz_solver_.preconditioner().memory_usage());
+        {
+            SURFACE_MESH_TRACE_ZONE("solve");
+            info = conjugate_gradient(cg_schwarz_solver_, A, B, X, progress_, iterations, error,
+                                      stopped);
+        }
+    } else if (solver_type_ == CG_MULTIGRID) {
+        cg_multigrid_solver_.setTolerance(solver_tolerance_);
+        cg_multigrid_solver_.setMaxIterations(solver_max_iterations_);
+        {
+            // Galerkin operators of the cached hierarchy for this system
+            SURFACE_MESH_TRACE_ZONE("factorize");
+            cg_multigrid_solver_.preconditioner().set_hierarchy(multigrid_hierarchy(), index);
+            cg_multigrid_solver_.compute(A);
+        }
+        note_solver_memory(A, B, X, cg_multigrid_solver_.preconditioner().memory_usage());
+        {
+            SURFACE_MESH_TRACE_ZONE("solve");
+            info = conjugate_gradient(cg_multigrid_solver_, A, B, X, progress_, iterations, error,
+                                      stopped);
+        }
+    } else {
+        cg_ichol_solver_.setTolerance(solver_tolerance_);
+        cg_ichol_solver_.setMaxIterations(solver_max_iterations_);
+        {
+            // preconditioner setup
+            SURFACE_MESH_TRACE_ZONE("factorize");
+            cg_ichol_solver_.compute(A);
+        }
+        note_solver_memory(A, B, X, sparse_memory(cg_ichol_solver_.preconditioner().factor()));
+        {
+            SURFACE_MESH_TRACE_ZONE("solve");
+            info = conjugate_gradient(cg_ichol_solver_, A, B, X, progress_, iterations, error,
+                                      stopped);
+        }
+    }
+    printf("CG: %d iterations, error %g.\n", iterations, error);
+    Metrics::record_solve(solver_type_ == CG_MATRIX_FREE && !matrix_free ?
+                          "cg" : cg_solver_name(solver_type_), iterations, error);
+    if (stopped) {
+        // a cancelled solve leaves the positions alone, an expired one
+        // returns the best solution so far
+        printf("CG %s.\n", cancelled() ? "cancelled" : "stopped by the time budget");
+        return !cancelled();
+    }
+    if (info != Eigen::Success) {
+        printf("CG did not converge.\n");
+    }
+    return true;
+}
 
-            double eweight = cotan[e];
-            ww += eweight;
+bool MeshProcessing::solve_pinned_system(const Eigen::SparseMatrix<double>& A,
+                                         const Eigen::MatrixXd& B,
+                                         Eigen::MatrixXd& X,
+                                         const std::vector<int>& index,
+                                         SpdFactorization& factorization,
+                                         const MatrixFreeSystem* matrix_free) {
+    if (!solve_spd_system(A, B, X, index, factorization, matrix_free)) return false;
+    if (constraints_revision_ != mesh_.topology_revision()) clear_constraints();
+
+    // rows and positions of the pins in this system
+    std::vector<int> rows;
+    std::vector<Point> targets;
+    for (size_t c = 0; c < constraint_vertices_.size(); ++c) {
+        const int v = constraint_vertices_[c];
+        if (v < int(index.size()) && index[v] >= 0) {
+            rows.push_back(index[v]);
+            targets.push_back(constraint_positions_[c]);
+        }
+    }
+    if (rows.empty()) return true;
+    SURFACE_MESH_TRACE_ZONE("pins");
+
+    // keep the columns A^-1 e_r of the pins that stay while the values are
+    // the same, solve for the new ones three at a time
+    SpdFactorization::Pins& pins = factorization.pins;
+    if (pins.generation != factorization.generation) pins.rows.clear();
+    const int n_rows = B.rows();
+    const int k = rows.size();
+    Eigen::MatrixXd Z(n_rows, k);
+    std::vector<int> missing;
+    for (int j = 0; j < k; ++j) {
+        auto it = std::find(pins.rows.begin(), pins.rows.end(), rows[j]);
+        if (it != pins.rows.end()) {
+            Z.col(j) = pins.Z.col(it - pins.rows.begin());
+        } else {
+            missing.push_back(j);
+        }
+    }
+    // the multipliers need the exact columns, which a stopped CG solve
+    // would not deliver
+    if (!missing.empty() && stopped()) return false;
+    Eigen::MatrixXd E, Y;
+    for (size_t m = 0; m < missing.size(); m += 3) {
+        E.setZero(n_rows, 3);
+        Y.setZero(n_rows, 3);
+        const int count = std::min<int>(3, missing.size() - m);
+        for (int c = 0; c < count; ++c) E(rows[missing[m + c]], c) = 1.0;
+        if (!solve_spd_system(A, E, Y, index, factorization, matrix_free)) return false;
+        for (int c = 0; c < count; ++c) Z.col(missing[m + c]) = Y.col(c);
+    }
+    pins.rows = rows;
+    pins.Z.swap(Z);
+    pins.generation = factorization.generation;
+
+    // Lagrange multipliers of the pins from the Schur complement
+    // S = C A^-1 C^T, then X -= A^-1 C^T S^-1 (C X - D)
+    Eigen::MatrixXd S(k, k), R(k, 3);
+    for (int i = 0; i < k; ++i) {
+        for (int j = 0; j < k; ++j) S(i, j) = pins.Z(rows[i], j);
+        for (int dim = 0; dim < 3; ++dim) R(i, dim) = X(rows[i], dim) - targets[i][dim];
+    }
+    pins.S.compute(S);
+    X.noalias() -= pins.Z * pins.S.solve(R);
+    return true;
+}
+
+void MeshProcessing::set_constraint(const Mesh::Vertex v, const Point& p) {
+    if (constraints_revision_ != mesh_.topology_revision()) clear_constraints();
+    constraints_revision_ = mesh_.topology_revision();
+    for (size_t c = 0; c < constraint_vertices_.size(); ++c) {
+        if (constraint_vertices_[c] == v.idx()) {
+            constraint_positions_[c] = p;
+            return;
+        }
+    }
+    constraint_vertices_.push_back(v.idx());
+    constraint_positions_.push_back(p);
+}
+
+bool MeshProcessing::remove_constraint(const Mesh::Vertex v) {
+    for (size_t c = 0; c < constraint_vertices_.size(); ++c) {
+        if (constraint_vertices_[c] == v.idx()) {
+            constraint_vertices_.erase(constraint_vertices_.begin() + c);
+            constraint_positions_.erase(constraint_positions_.begin() + c);
+            return true;
+        }
+    }
+    return false;
+}
+
+void MeshProcessing::clear_constraints() {
+    constraint_vertices_.clear();
+    constraint_positions_.clear();
+}
+
+Mesh::Vertex MeshProcessing::get_selected_vertex() {
+    const Point p(selection_(0, 0), selection_(1, 0), selection_(2, 0));
+    Mesh::Vertex nearest;
+    float min_distance = std::numeric_limits<float>::max();
+    for (auto v : mesh_.compact_vertices()) {
+        const float dist = sqrnorm(mesh_.position(v) - p);
+        if (dist < min_distance) {
+            min_distance = dist;
+            nearest = v;
+        }
+    }
+    return nearest;
+}
+
+void MeshProcessing::set_region(const std::vector<Mesh::Vertex>& vertices) {
+    RegionOfInterest& region = region_;
+    region.vertices.clear();
+    for (const Mesh::Vertex v: vertices) {
+        if (v.is_valid() && v.idx() < mesh_.vertices_size()) region.vertices.push_back(v.idx());
+    }
+    std::sort(region.vertices.begin(), region.vertices.end());
+    region.vertices.erase(std::unique(region.vertices.begin(), region.vertices.end()),
+                          region.vertices.end());
+    region.topology_revision = mesh_.topology_revision();
+    ++region.generation;
+}
+
+void MeshProcessing::set_region_ball(const Mesh::Vertex center, const float radius) {
+    // Dijkstra over the edge lengths, the distances live in a map so that
+    // the cost follows the size of the ball
+    std::vector<Mesh::Vertex> ball;
+    std::unordered_map<int, float> distance;
+    typedef std::pair<float, int> Entry;
+    std::priority_queue< Entry, std::vector<Entry>, std::greater<Entry> > queue;
+    if (center.is_valid() && center.idx() < mesh_.vertices_size()) {
+        distance[center.idx()] = 0.0f;
+        queue.push(Entry(0.0f, center.idx()));
+    }
+    while (!queue.empty()) {
+        const Entry entry = queue.top();
+        queue.pop();
+        const Mesh::Vertex v(entry.second);
+        if (entry.first > distance[v.idx()]) continue;
+        ball.push_back(v);
+        for (auto hv: mesh_.halfedges(v)) {
+            const Mesh::Vertex vv = mesh_.to_vertex(hv);
+            const float d = entry.first + norm(mesh_.position(vv) - mesh_.position(v));
+            if (d > radius) continue;
+            auto it = distance.find(vv.idx());
+            if (it == distance.end() || d < it->second) {
+                distance[vv.idx()] = d;
+                queue.push(Entry(d, vv.idx()));
+            }
+        }
+    }
+    set_region(ball);
+}
+
+void MeshProcessing::clear_region() {
+    region_.vertices.clear();
+    ++region_.generation;
+}
+
+// window position of p in pixels with y down, false behind the eye
+static inline bool project_to_window(const Eigen::Matrix4f& mvp, const Eigen::Vector2f& viewport,
+                                     const Point& p, Eigen::Vector2f& pixel) {
+    const Eigen::Vector4f clip = mvp * Eigen::Vector4f(p[0], p[1], p[2], 1.0f);
+    if (clip[3] <= 0.0f) return false;
+    pixel[0] = (clip[0] / clip[3] + 1.0f) * 0.5f * viewport[0];
+    pixel[1] = (1.0f - clip[1] / clip[3]) * 0.5f * viewport[1];
+    return true;
+}
+
+template <typename Inside>
+int MeshProcessing::select_vertices(const SelectionView& view, const Inside& inside,
+                                    const SELECTION_MODE mode) {
+    SURFACE_MESH_TRACE_ZONE("select_vertices");
+    const int n = mesh_.vertices_size();
+    const auto& points = mesh_.points();
+    std::vector<unsigned char> hit(n, 0);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        Eigen::Vector2f pixel;
+        hit[i] = !mesh_.is_deleted(Mesh::Vertex(i)) &&
+                 project_to_window(view.mvp, view.viewport, points[i], pixel) && inside(pixel);
+    }
+
+    if (view.visible_only) {
+        // the segments from the eye stop short of their vertex, the
+        // triangles around it do not hide it
+        std::vector<int> candidates;
+        for (int i = 0; i < n; ++i) {
+            if (hit[i]) candidates.push_back(i);
+        }
+        std::vector<Point> targets(candidates.size());
+        for (size_t k = 0; k < candidates.size(); ++k) targets[k] = points[candidates[k]];
+        std::vector<unsigned char> occluded(candidates.size());
+        update_bvh();
+        bvh_.occluded(mesh_, to_point(view.eye), targets.data(), int(targets.size()), 0.999f,
+                      occluded.data());
+        for (size_t k = 0; k < candidates.size(); ++k) {
+            if (occluded[k]) hit[candidates[k]] = 0;
+        }
+    }
+
+    // the bits of the property are written by one thread
+    auto selected = mesh_.vertex_property<bool>(v_selected_key, false);
+    int begin = n, end = 0, changed = 0;
+    for (int i = 0; i < n; ++i) {
+        const Mesh::Vertex v(i);
+        bool value = selected[v];
+        if (hit[i]) {
+            value = mode != SELECT_REMOVE;
+        } else if (mode == SELECT_REPLACE) {
+            value = false;
+        }
+        if (value == selected[v]) continue;
+        selected[v] = value;
+        begin = min(begin, i);
+        end = i + 1;
+        ++changed;
+    }
+    if (changed > 0) note_selection_change(begin, end);
+    return changed;
+}
+
+int MeshProcessing::select_brush(const SelectionView& view, const Eigen::Vector2f& center,
+                                 const float radius, const SELECTION_MODE mode) {
+    const float radius2 = radius * radius;
+    return select_vertices(view, [&](const Eigen::Vector2f& pixel) {
+        return (pixel - center).squaredNorm() <= radius2;
+    }, mode);
+}
+
+int MeshProcessing::select_lasso(const SelectionView& view,
+                                 const std::vector<Eigen::Vector2f>& polygon,
+                                 const SELECTION_MODE mode) {
+    if (polygon.size() < 3) {
+        return mode == SELECT_REPLACE ? select_vertices(view, [](const Eigen::Vector2f&) {
+            return false;
+        }, mode) : 0;
+    }
+    Eigen::Vector2f box_min = polygon[0], box_max = polygon[0];
+    for (const Eigen::Vector2f& p: polygon) {
+        box_min = box_min.cwiseMin(p);
+        box_max = box_max.cwiseMax(p);
+    }
+    return select_vertices(view, [&](const Eigen::Vector2f& pixel) {
+        if ((pixel.array() < box_min.array()).any() || (pixel.array() > box_max.array()).any()) {
+            return false;
+        }
+        // crossings of a ray to the right
+        bool inside = false;
+        for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+            const Eigen::Vector2f& a = polygon[i];
+            const Eigen::Vector2f& b = polygon[j];
+            if ((a[1] > pixel[1]) != (b[1] > pixel[1]) &&
+                pixel[0] < a[0] + (pixel[1] - a[1]) * (b[0] - a[0]) / (b[1] - a[1])) {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }, mode);
+}
+
+void MeshProcessing::clear_vertex_selection() {
+    auto selected = mesh_.get_vertex_property<bool>(v_selected_key);
+    if (!selected) return;
+    mesh_.remove_vertex_property(selected);
+    note_selection_change(0, mesh_.vertices_size());
+}
+
+int MeshProcessing::get_vertex_selection_size() const {
+    auto selected = mesh_.get_vertex_property<bool>(v_selected_key);
+    if (!selected) return 0;
+    // a popcount per word, unless the bits of deleted vertices have to be
+    // left out
+    const surface_mesh::Bit_vector& bits = selected.vector();
+    if (mesh_.n_vertices() == mesh_.vertices_size()) return int(bits.count());
+    int count = 0;
+    bits.for_each_set([&](const size_t i) { count += !mesh_.is_deleted(Mesh::Vertex(i)); });
+    return count;
+}
+
+void MeshProcessing::get_selected_vertices(std::vector<Mesh::Vertex>& vertices) const {
+    vertices.clear();
+    auto selected = mesh_.get_vertex_property<bool>(v_selected_key);
+    if (!selected) return;
+    selected.vector().for_each_set([&](const size_t i) {
+        const Mesh::Vertex v(i);
+        if (!mesh_.is_deleted(v)) vertices.push_back(v);
+    });
+}
+
+void MeshProcessing::note_selection_change(const int begin, const int end) {
+    selection_changed_revision_ = selection_revision_++;
+    selection_changed_begin_ = begin;
+    selection_changed_end_ = end;
+    selection_topology_revision_ = mesh_.topology_revision();
+}
+
+bool MeshProcessing::get_selection_changes(const unsigned int since, int& first,
+                                           int& count) const {
+    if (selection_topology_revision_ != mesh_.topology_revision()) return false;
+    if (since == selection_revision_) {
+        first = count = 0;
+        return true;
+    }
+    if (since != selection_changed_revision_) return false;
+    first = selection_changed_begin_;
+    count = selection_changed_end_ - selection_changed_begin_;
+    return true;
+}
+
+void MeshProcessing::get_selection_mask(const int first, const int count,
+                                        std::vector<unsigned char>& mask) const {
+    mask.assign(count, 0);
+    auto selected = mesh_.get_vertex_property<bool>(v_selected_key);
+    if (!selected) return;
+    const surface_mesh::Bit_vector& bits = selected.vector();
+    const size_t end = first + count;
+    for (size_t i = bits.find_next(first); i < end; i = bits.find_next(i + 1)) {
+        mask[i - first] = 1;
+    }
+}
+
+void MeshProcessing::set_region_to_selection() {
+    std::vector<Mesh::Vertex> vertices;
+    get_selected_vertices(vertices);
+    set_region(vertices);
+}
+
+void MeshProcessing::region_implicit_smoothing(const double timestep) {
+    SURFACE_MESH_TRACE_ZONE("region_implicit_smoothing");
+    solve_region(timestep, false);
+}
+
+void MeshProcessing::region_minimal_surface() {
+    SURFACE_MESH_TRACE_ZONE("region_minimal_surface");
+    solve_region(0.0, true);
+}
+
+// cotangent of the corner opposite to halfedge h clamped to max_cotan, 0 on
+// the boundary
+static Scalar opposite_cotan(const Mesh& mesh, const Mesh::Halfedge h, const Scalar max_cotan) {
+    if (mesh.is_boundary(h)) return 0.0f;
+    const Point& p0 = mesh.position(mesh.from_vertex(h));
+    const Point& p1 = mesh.position(mesh.to_vertex(h));
+    const Point& p2 = mesh.position(mesh.to_vertex(mesh.next_halfedge(h)));
+    const Point d0 = p0 - p2, d1 = p1 - p2;
+    return clamp_cotan(dot(d0, d1) / norm(cross(d0, d1)), max_cotan);
+}
+
+void MeshProcessing::solve_region(const double timestep, const bool minimal) {
+    RegionOfInterest& region = region_;
+    if (region.topology_revision != mesh_.topology_revision()) region.vertices.clear();
+    if (region.vertices.empty()) return;
+    Property_vector<Point>& points = mesh_.points();
+
+    // rows for the free vertices of the region
+    std::vector<int>& index = region.index;
+    index.resize(mesh_.vertices_size(), -1);
+    std::vector<int> rows;
+    for (const int i: region.vertices) {
+        if (minimal && mesh_.is_boundary(Mesh::Vertex(i))) continue;
+        index[i] = rows.size();
+        rows.push_back(i);
+    }
+    const int n_rows = rows.size();
+
+    // (M + dt L) X = M P, or L X = 0, with the weights of the region's
+    // one-rings computed locally; fixed neighbours go to the rhs
+    SolverWorkspace& ws = workspace_;
+    ws.triplets.clear();
+    ws.B.setZero(n_rows, 3);
+    ws.X.resize(n_rows, 3);
+    const double scale = minimal ? 1.0 : timestep;
+    const bool lower = reads_lower_triangle(solver_type_);
+    for (int row = 0; row < n_rows; ++row) {
+        const Mesh::Vertex v(rows[row]);
+        const Point& p = points[v.idx()];
+        double ww = 0.0;
+        for (auto hv: mesh_.halfedges(v)) {
+            const Mesh::Vertex vv = mesh_.to_vertex(hv);
+            const double w = scale * (opposite_cotan(mesh_, hv, max_cotan_) +
+                                      opposite_cotan(mesh_, mesh_.opposite_halfedge(hv),
+                                                     max_cotan_));
+            ww += w;
+            const int col = index[vv.idx()];
+            if (col >= 0 && (!lower || col < row)) {
+                ws.triplets.push_back(Eigen::Triplet<double>(row, col, -w));
+            } else if (col < 0) {
+                for (int dim = 0; dim < 3; ++dim) ws.B(row, dim) += w * points[vv.idx()][dim];
+            }
+        }
+        if (!minimal) {
+            // lumped mass 1 / CotanWeights::vertex of calc_weights
+            Scalar area = 0.0;
+            for (auto f: mesh_.faces(v)) {
+                auto fv = mesh_.vertices(f);
+                const Point& a = mesh_.position(*fv);
+                const Point& b = mesh_.position(*(++fv));
+                const Point& c = mesh_.position(*(++fv));
+                area += norm(cross(b - a, c - a)) * 0.5f * 0.3333f;
+            }
+            const double mass = 2.0 * area;
+            ww += mass;
+            for (int dim = 0; dim < 3; ++dim) ws.B(row, dim) += mass * p[dim];
+        }
+        ws.triplets.push_back(Eigen::Triplet<double>(row, row, ww));
+        for (int dim = 0; dim < 3; ++dim) ws.X(row, dim) = p[dim];
+    }
+    ws.A.resize(n_rows, n_rows);
+    ws.A.setFromTriplets(ws.triplets.begin(), ws.triplets.end());
+
+    // the pattern changes with the region and the operator
+    SpdFactorization& factorization = region_factorization_;
+    factorization.set_revision(2 * region.generation + (minimal ? 1 : 0));
+    factorization.factorized = false;
+    const bool solved = report_progress(0.5f) &&
+                        solve_pinned_system(ws.A, ws.B, ws.X, index, factorization);
+    if (solved) {
+        SURFACE_MESH_TRACE_ZONE("copy-back");
+        for (int row = 0; row < n_rows; ++row) {
+            for (int dim = 0; dim < 3; ++dim) {
+                points[rows[row]][dim] = ws.X(row, dim);
+            }
+        }
+    }
+    for (const int i: rows) index[i] = -1;
+}
+
+// flushes float denormals to zero while in scope: the fill-in of the
+// strongly diagonally dominant systems underflows, and denormal arithmetic
+// slows the factorization down several times; the refinement recovers the
+// lost bits
+class FlushDenormals {
+public:
+#if defined(__SSE__) || defined(_M_X64)
+    FlushDenormals() : csr_(_mm_getcsr()) { _mm_setcsr(csr_ | 0x8040); }  // FTZ | DAZ
+    ~FlushDenormals() { _mm_setcsr(csr_); }
+private:
+    unsigned int csr_;
+#endif
+};
+
+static const char* ordering_name(const MeshProcessing::FILL_ORDERING ordering) {
+    switch (ordering) {
+    case MeshProcessing::ORDERING_COLAMD: return "COLAMD";
+    case MeshProcessing::ORDERING_METIS: return "METIS";
+    case MeshProcessing::ORDERING_MORTON: return "Morton";
+    case MeshProcessing::ORDERING_AUTO: return "auto";
+    default: return "AMD";
+    }
+}
+
+template <typename T>
+bool MeshProcessing::fill_order(const Eigen::SparseMatrix<T>& A, const std::vector<int>& index,
+                                const FILL_ORDERING ordering, std::vector<int>& order) {
+    switch (ordering) {
+    case ORDERING_COLAMD:
+        colamd_order(A, order);
+        return true;
+    case ORDERING_METIS:
+        return metis_order(A, order);
+    case ORDERING_MORTON: {
+        // the rows in the order of their vertices along the curve, if every
+        // row is the one of a vertex
+        std::vector<int> vertices;
+        surface_mesh::vertex_order(mesh_, surface_mesh::REORDER_MORTON, vertices);
+        order.clear();
+        order.reserve(A.rows());
+        for (const int v : vertices) {
+            if (v < int(index.size()) && index[v] >= 0) order.push_back(index[v]);
+        }
+        return int(order.size()) == int(A.rows());
+    }
+    default:
+        return false;
+    }
+}
+
+template <typename T>
+MeshProcessing::FILL_ORDERING MeshProcessing::order_pattern(PersistentLDLT<T>& ldlt,
+                                                            const Eigen::SparseMatrix<T>& A,
+                                                            const std::vector<int>& index) {
+    SURFACE_MESH_TRACE_ZONE("order_pattern");
+    std::vector<int> order;
+    if (fill_ordering_ != ORDERING_AUTO) {
+        if (fill_ordering_ != ORDERING_AMD && fill_order(A, index, fill_ordering_, order)) {
+            ldlt.analyze_ordered(A, order);
+            return fill_ordering_;
+        }
+        ldlt.analyzePattern(A);
+        return ORDERING_AMD;
+    }
+
+    // the symbolic analysis is cheap next to the factorization it sizes
+    ldlt.analyzePattern(A);
+    const int64_t amd_nonzeros = ldlt.factor_nonzeros();
+    int64_t best_nonzeros = amd_nonzeros;
+    FILL_ORDERING best = ORDERING_AMD, last = ORDERING_AMD;
+    std::vector<int> best_order;
+    for (const FILL_ORDERING ordering : { ORDERING_COLAMD, ORDERING_METIS, ORDERING_MORTON }) {
+        if (!fill_order(A, index, ordering, order)) continue;
+        ldlt.analyze_ordered(A, order);
+        last = ordering;
+        const int64_t nonzeros = ldlt.factor_nonzeros();
+        if (nonzeros < best_nonzeros) {
+            best_nonzeros = nonzeros;
+            best = ordering;
+            best_order.swap(order);
+        }
+    }
+    if (best != last) {
+        if (best == ORDERING_AMD) ldlt.analyzePattern(A);
+        else ldlt.analyze_ordered(A, best_order);
+    }
+    printf("fill ordering %s for %d rows: %lld entries in L, %lld with AMD.\n",
+           ordering_name(best), int(A.rows()), (long long)best_nonzeros, (long long)amd_nonzeros);
+    return best;
+}
+
+template <typename T>
+void MeshProcessing::analyze_pattern(PersistentLDLT<T>& ldlt, const Eigen::SparseMatrix<T>& A,
+                                     const std::vector<int>& index) {
+    if (!symbolic_cache_enabled_) {
+        order_pattern(ldlt, A, index);
+        return;
+    }
+    const uint64_t key = sparsity_key(A);
+    if (const SymbolicAnalysis* analysis = symbolic_cache_.find(key, int(A.rows()), fill_ordering_)) {
+        ldlt.import_analysis(*analysis);
+        return;
+    }
+    SymbolicAnalysis analysis;
+    analysis.chosen = order_pattern(ldlt, A, index);
+    ldlt.export_analysis(analysis);
+    analysis.pattern_key = key;
+    analysis.ordering = fill_ordering_;
+    symbolic_cache_.add(std::move(analysis));
+}
+
+// R = B - A X with A symmetric and only its lower triangle stored; the
+// self-adjoint products of this Eigen abort with several columns
+static void lower_residual(const Eigen::SparseMatrix<double>& A, const Eigen::MatrixXd& B,
+                           const Eigen::MatrixXd& X, Eigen::MatrixXd& R) {
+    R = B;
+    const int* outer = A.outerIndexPtr();
+    const int* inner = A.innerIndexPtr();
+    const double* values = A.valuePtr();
+    for (int c = 0; c < int(X.cols()); ++c) {
+        for (int j = 0; j < int(A.outerSize()); ++j) {
+            const double xj = X(j, c);
+            double sum = 0.0;
+            for (int p = outer[j]; p < outer[j + 1]; ++p) {
+                const int i = inner[p];
+                R(i, c) -= values[p] * xj;
+                if (i != j) sum += values[p] * X(i, c);
+            }
+            R(j, c) -= sum;
+        }
+    }
+}
+
+bool MeshProcessing::solve_mixed_precision(const Eigen::SparseMatrix<double>& A,
+                                           const Eigen::MatrixXd& B,
+                                           Eigen::MatrixXd& X,
+                                           const std::vector<int>& index,
+                                           SpdFactorization& factorization) {
+    SolverWorkspace& ws = workspace_;
+    Eigen::SimplicialLDLT< Eigen::SparseMatrix<float> >& ldlt = factorization.ldlt_float;
+    FlushDenormals flush;
+    if (!factorization.factorized) {
+        SURFACE_MESH_TRACE_ZONE("factorize");
+        ws.A_float = A.cast<float>();
+        if (!factorization.analyzed_float) {
+            analyze_pattern(factorization.ldlt_float, ws.A_float, index);
+            factorization.analyzed_float = true;
+        }
+        ldlt.factorize(ws.A_float);
+    }
+    // besides the factors: the float matrix, the residual in double and
+    // float and the float correction
+    note_solver_memory(A, B, X, ldlt_memory(ldlt) + sparse_memory(ws.A_float) +
+                                2 * dense_memory(B));
+    if (ldlt.info() != Eigen::Success) {
+        printf("linear solver factorization failed.\n");
+        factorization.analyzed_float = false;
+        factorization.factorized = false;
+        return false;
+    }
+    factorization.factorized = true;
+    if (cancelled()) return false;
+
+    // X = A^-1 B in float, then X += A^-1 (B - A X) with the residual in
+    // double until it is below the tolerance or stops decreasing, or the
+    // budget runs out
+    SURFACE_MESH_TRACE_ZONE("solve");
+    ws.R_float = B.cast<float>();
+    solve_ldlt_xyz(ldlt, ws.R_float, ws.X_float, ws.xyz_float);
+    X = ws.X_float.cast<double>();
+    const double b_norm = B.norm();
+    double r_norm = std::numeric_limits<double>::max();
+    int steps = 0;
+    for (;; ++steps) {
+        lower_residual(A, B, X, ws.R);
+        const double last_norm = r_norm;
+        r_norm = ws.R.norm();
+        if (r_norm <= solver_tolerance_ * b_norm || r_norm > 0.5 * last_norm ||
+            steps == solver_max_iterations_ || stopped()) {
+            break;
+        }
+        ws.R_float = ws.R.cast<float>();
+        solve_ldlt_xyz(ldlt, ws.R_float, ws.X_float, ws.xyz_float);
+        X += ws.X_float.cast<double>();
+    }
+    printf("LDLT float: %d refinement steps, error %g.\n", steps,
+           b_norm > 0.0 ? r_norm / b_norm : r_norm);
+    return !cancelled();
+}
+
+void MeshProcessing::assemble_cotan_system(const Property_vector<Scalar>& cotan,
+                                           const std::vector<int>& index,
+                                           const int n_rows,
+                                           const std::vector<double>& diag,
+                                           const double scale,
+                                           Eigen::SparseMatrix<double>& A) const {
+    SURFACE_MESH_TRACE_ZONE("assembly");
+    const int n = mesh_.n_vertices();
+
+    // the matrix is symmetric, so column index[v] is the one-ring of v:
+    // the valences give the exact column sizes
+    A.resize(n_rows, n_rows);
+    int* outer = A.outerIndexPtr();
+    for (int i = 0; i < n; ++i) {
+        const int col = index[i];
+        if (col < 0) continue;
+        int count = 1;
+        for (auto hv: mesh_.halfedges(Mesh::Vertex(i))) {
+            if (index[mesh_.to_vertex(hv).idx()] >= 0) ++count;
+        }
+        outer[col + 1] = count;
+    }
+    outer[0] = 0;
+    for (int col = 0; col < n_rows; ++col) {
+        outer[col + 1] += outer[col];
+    }
+    A.resizeNonZeros(outer[n_rows]);
+
+    // fill every column in place, row indices sorted as Eigen expects
+    int* inner = A.innerIndexPtr();
+    double* values = A.valuePtr();
+    for (int i = 0; i < n; ++i) {
+        const int col = index[i];
+        if (col < 0) continue;
+
+        int* rows = inner + outer[col];
+        double* vals = values + outer[col];
+        int count = 0;
+        double ww(0.0);
+        for (auto hv: mesh_.halfedges(Mesh::Vertex(i))) {
+            double eweight = cotan[mesh_.edge(hv).idx()];
+            ww += eweight;
+
+            const int row = index[mesh_.to_vertex(hv).idx()];
+            if (row < 0) continue;
+
+            // insertion sort, the one-rings are small
+            int k = count++;
+            for (; k > 0 && rows[k-1] > row; --k) {
+                rows[k] = rows[k-1];
+                vals[k] = vals[k-1];
+            }
+            rows[k] = row;
+            vals[k] = -scale * eweight;
+        }
+
+        int k = count++;
+        for (; k > 0 && rows[k-1] > col; --k) {
+            rows[k] = rows[k-1];
+            vals[k] = vals[k-1];
+        }
+        rows[k] = col;
+        vals[k] = diag[i] + scale * ww;
+    }
+}
+
+void MeshProcessing::set_max_cotan(const float max_cotan) {
+    if (max_cotan == max_cotan_) return;
+    max_cotan_ = max_cotan;
+    // the cached systems were assembled with the old bound
+    cotan_laplace_.clear();
+    interior_.assembled = false;
+    dirty_ = DIRTY_ALL;
+    local_dirty_ = 0;
+}
+
+void MeshProcessing::set_solver(const SOLVER_TYPE type, const double tolerance,
+                                const int max_iterations) {
+    if (!solver_available(type)) {
+        printf("solver backend not built in, using the Eigen LDLT.\n");
+    }
+    solver_type_ = solver_available(type) ? type : DIRECT_LDLT;
+    solver_tolerance_ = tolerance;
+    solver_max_iterations_ = max_iterations;
+}
+
+bool MeshProcessing::ordering_available(const FILL_ORDERING ordering) {
+    return ordering != ORDERING_METIS || metis_available();
+}
+
+void MeshProcessing::set_fill_ordering(const FILL_ORDERING ordering) {
+    if (!ordering_available(ordering)) {
+        printf("fill ordering not built in, using AMD.\n");
+    }
+    // the factorizations pick the change up on their next solve
+    fill_ordering_ = ordering_available(ordering) ? ordering : ORDERING_AMD;
+}
+
+void MeshProcessing::minimal_surface(const bool reduce_boundary, const bool keep_weights) {
+    SURFACE_MESH_TRACE_ZONE("minimal_surface");
+    if (reduce_boundary) {
+        minimal_surface_interior(keep_weights);
+        return;
+    }
+
+    const int n = mesh_.n_vertices();
+
+    // get vertex position
+    Property_vector<Point>& points = mesh_.points();
+    const Property_vector<Point>& points_init = points_init_;
+
+    // the rows of the interior vertices are those of the cotan operator,
+    // the boundary rows identity rows
+    const LaplaceOperator& op = laplace_operator(true);
+    const std::vector<int>& interior_idx = interior_index();
+
+    // A*X = B
+    SolverWorkspace& ws = workspace_;
+    Eigen::SparseMatrix<double>& L = ws.A;
+    Eigen::MatrixXd& rhs = ws.B;
+    L = op.matrix();
+    L.prune([&](const int row, const int col, const double) {
+        return interior_idx[row] >= 0 || row == col;
+    });
+    rhs.setZero(n, 3);
+    for (int j = 0; j < L.outerSize(); ++j) {
+        for (Eigen::SparseMatrix<double>::InnerIterator it(L, j); it; ++it) {
+            if (interior_idx[it.row()] < 0) it.valueRef() = 1.0;
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        if (interior_idx[i] >= 0) continue;
+        for (int dim = 0; dim < 3; ++dim) {
+            rhs(i, dim) = points_init[i][dim];
+        }
+    }
+
+    const double area_sum = deterministic_sum(n, 0.0, [&](const int i) {
+        return op.mass()[i];
+    });
+    printf ("Sum of area: %g.\n", area_sum);
+
+    // solve A*X = B
+    if (!report_progress(0.5f)) return;
+    Eigen::SparseLU< Eigen::SparseMatrix<double> > solver;
+    {
+        SURFACE_MESH_TRACE_ZONE("factorize");
+        solver.compute(L);
+    }
+    if (solver.info () != Eigen::Success) {
+        printf("linear solver init failed.\n");
+    }
+
+    Eigen::MatrixXd& X = ws.X;
+    {
+        SURFACE_MESH_TRACE_ZONE("solve");
+        X = solver.solve(rhs);
+    }
+    // SparseLU does not expose the size of its factors
+    note_solver_memory(L, rhs, X, 0);
+    if (solver.info () != Eigen::Success) {
+        printf("linear solver failed.\n");
+    }
+
+    // copy solution
+    SURFACE_MESH_TRACE_ZONE("copy-back");
+    for (int i = 0; i < n; ++i) {
+        Mesh::Vertex v(i);
+        for (int dim = 0; dim < 3; ++dim) {
+            points[i][dim] += 1. * (X(i, dim) - points[i][dim]);
+        }
+    }
+
+}
+
+bool MeshProcessing::harmonic_parameterization(const bool keep_weights) {
+    SURFACE_MESH_TRACE_ZONE("harmonic_parameterization");
+    const int n = mesh_.n_vertices();
+    const Property_vector<Point>& points = mesh_.points();
+
+    // the boundary loop, which must hold every boundary vertex
+    std::vector<int> loop;
+    Mesh::Halfedge start;
+    for (auto h: mesh_.compact_halfedges()) {
+        if (mesh_.is_boundary(h)) {
+            start = h;
+            break;
+        }
+    }
+    if (!start.is_valid()) return false;
+    Mesh::Halfedge h = start;
+    do {
+        loop.push_back(mesh_.to_vertex(h).idx());
+        h = mesh_.next_halfedge(h);
+    } while (h != start && int(loop.size()) <= n);
+    const std::vector<int>& interior_idx = interior_index();
+    InteriorSystem& sys = interior_;
+    if (h != start || int(loop.size()) != n - sys.n_interior) {
+        printf("parameterization needs a single boundary loop.\n");
+        return false;
+    }
+
+    // the circle by arc length; the boundary halfedges run clockwise as
+    // seen from the faces, so the angle decreases along them
+    std::vector<double> arc(loop.size() + 1, 0.0);
+    for (size_t k = 0; k < loop.size(); ++k) {
+        const Point& a = points[loop[k]];
+        const Point& b = points[loop[(k + 1) % loop.size()]];
+        arc[k + 1] = arc[k] + norm(b - a);
+    }
+    Mesh::Vertex_property<surface_mesh::Texture_coordinate> texcoords =
+            mesh_.vertex_property<surface_mesh::Texture_coordinate>("v:texcoord");
+    for (size_t k = 0; k < loop.size(); ++k) {
+        const double angle = arc[loop.size()] > 0.0 ? -2.0 * M_PI * arc[k] / arc[loop.size()]
+                                                    : 0.0;
+        texcoords[Mesh::Vertex(loop[k])] =
+                surface_mesh::Texture_coordinate(0.5 + 0.5 * std::cos(angle),
+                                                 0.5 + 0.5 * std::sin(angle), 0.0f);
+    }
+    if (sys.n_interior == 0) return true;
+
+    // L_II * UV_I = -L_IB * UV_B, the third column stays 0
+    update_interior_system(keep_weights);
+    SolverWorkspace& ws = workspace_;
+    Eigen::MatrixXd& rhs = ws.B;
+    Eigen::MatrixXd& X = ws.X;
+    rhs.setZero(sys.n_interior, 3);
+    X.setZero(sys.n_interior, 3);
+    for (int i = 0; i < n; ++i) {
+        const int row = interior_idx[i];
+        if (row < 0) continue;
+        for (int c = sys.coupling_start[row]; c < sys.coupling_start[row + 1]; ++c) {
+            const surface_mesh::Texture_coordinate& boundary =
+                    texcoords[Mesh::Vertex(sys.coupling_vertex[c])];
+            for (int dim = 0; dim < 2; ++dim) {
+                rhs(row, dim) += sys.coupling_weight[c] * boundary[dim];
+            }
+        }
+    }
+    if (!solve_spd_system(sys.L, rhs, X, interior_idx, interior_factorization_)) return false;
+    for (int i = 0; i < n; ++i) {
+        const int row = interior_idx[i];
+        if (row < 0) continue;
+        texcoords[Mesh::Vertex(i)] = surface_mesh::Texture_coordinate(X(row, 0), X(row, 1), 0.0f);
+    }
+    return true;
+}
+
+void MeshProcessing::update_interior_system(const bool keep_weights) {
+    const int n = mesh_.n_vertices();
+    InteriorSystem& sys = interior_;
+    const std::vector<int>& interior_idx = interior_index();
+    const int n_interior = sys.n_interior;
+
+    // the reduced cotan system is symmetric positive definite, the interior
+    // vertices and so the pattern only change with the connectivity
+    SpdFactorization& factorization = interior_factorization_;
+    factorization.set_revision(mesh_.topology_revision());
+
+    // L_II and L_IB from the cotan operator, taken again unless the weights
+    // are kept or no vertex moved
+    const bool lower = reads_lower_triangle(solver_type_);
+    if (!sys.assembled || sys.lower != lower ||
+        (!keep_weights && sys.positions_key != positions_key(mesh_.points()))) {
+        const LaplaceOperator& op = laplace_operator(true);
+        const Eigen::SparseMatrix<double>& L = op.matrix();
+        const int* outer = L.outerIndexPtr();
+        const int* inner = L.innerIndexPtr();
+        const double* values = L.valuePtr();
+
+        // the rows are numbered in vertex order, so the couplings of the
+        // rows follow each other; L is symmetric, column i is row i
+        sys.coupling_start.assign(n_interior + 1, 0);
+        sys.coupling_vertex.clear();
+        sys.coupling_weight.clear();
+        for (int i = 0; i < n; ++i) {
+            const int row = interior_idx[i];
+            if (row < 0) continue;
+            for (int p = outer[i]; p < outer[i + 1]; ++p) {
+                if (interior_idx[inner[p]] < 0) {
+                    sys.coupling_vertex.push_back(inner[p]);
+                    sys.coupling_weight.push_back(-values[p]);
+                }
+            }
+            sys.coupling_start[row + 1] = sys.coupling_vertex.size();
+        }
+
+        // the interior rows and columns, renumbered; the vertex order keeps
+        // the rows sorted
+        Eigen::SparseMatrix<double>& A = sys.L;
+        A.resize(n_interior, n_interior);
+        int* a_outer = A.outerIndexPtr();
+        a_outer[0] = 0;
+        for (int i = 0; i < n; ++i) {
+            const int col = interior_idx[i];
+            if (col < 0) continue;
+            int count = 0;
+            for (int p = outer[i]; p < outer[i + 1]; ++p) {
+                count += interior_idx[inner[p]] >= (lower ? col : 0);
+            }
+            a_outer[col + 1] = a_outer[col] + count;
+        }
+        A.resizeNonZeros(a_outer[n_interior]);
+        int* a_inner = A.innerIndexPtr();
+        double* a_values = A.valuePtr();
+        for (int i = 0; i < n; ++i) {
+            const int col = interior_idx[i];
+            if (col < 0) continue;
+            int k = a_outer[col];
+            for (int p = outer[i]; p < outer[i + 1]; ++p) {
+                const int row = interior_idx[inner[p]];
+                if (row < (lower ? col : 0)) continue;
+                a_inner[k] = row;
+                a_values[k++] = values[p];
+            }
+        }
+        sys.positions_key = op.positions_key();
+        sys.lower = lower;
+        sys.assembled = true;
+        factorization.factorized = false;
+    }
+}
+
+const std::vector<int>& MeshProcessing::interior_index() {
+    InteriorSystem& sys = interior_;
+    if (!sys.indexed || sys.topology_revision != mesh_.topology_revision()) {
+        // number the interior vertices, boundary vertices are fixed
+        const int n = mesh_.n_vertices();
+        sys.index.assign(n, -1);
+        sys.n_interior = 0;
+        for (int i = 0; i < n; ++i) {
+            if (!mesh_.is_boundary(Mesh::Vertex(i))) {
+                sys.index[i] = sys.n_interior++;
+            }
+        }
+        sys.topology_revision = mesh_.topology_revision();
+        sys.indexed = true;
+        sys.assembled = false;
+    }
+    return sys.index;
+}
+
+bool MeshProcessing::set_boundary_position(const Mesh::Vertex v, const Point& p) {
+    if (!v.is_valid() || v.idx() >= int(points_init_.size()) ||
+        interior_index()[v.idx()] >= 0) {
+        return false;
+    }
+    points_init_[v.idx()] = p;
+    mesh_.position(v) = p;
+    return true;
+}
+
+void MeshProcessing::minimal_surface_interior(const bool keep_weights) {
+
+    const int n = mesh_.n_vertices();
+
+    // get vertex position
+    Property_vector<Point>& points = mesh_.points();
+    const Property_vector<Point>& points_init = points_init_;
+
+    InteriorSystem& sys = interior_;
+    const std::vector<int>& interior_idx = interior_index();
+    const int n_interior = sys.n_interior;
+    if (n_interior == 0) {
+        return;
+    }
+
+    update_interior_system(keep_weights);
+    SpdFactorization& factorization = interior_factorization_;
+
+    // L_II * X_I = -L_IB * X_B
+    SolverWorkspace& ws = workspace_;
+    Eigen::MatrixXd& rhs = ws.B;
+    Eigen::MatrixXd& X = ws.X;
+    rhs.setZero(n_interior, 3);
+    X.resize(n_interior, 3);
+
+    for (int i = 0; i < n; ++i) {
+        const int row = interior_idx[i];
+        if (row < 0) continue;
+
+        // warm start for CG
+        for (int dim = 0; dim < 3; ++dim) {
+            X(row, dim) = points[i][dim];
+        }
+
+        // known boundary positions move to the rhs
+        for (int c = sys.coupling_start[row]; c < sys.coupling_start[row + 1]; ++c) {
+            const Point& boundary = points_init[sys.coupling_vertex[c]];
+            for (int dim = 0; dim < 3; ++dim) {
+                rhs(row, dim) += sys.coupling_weight[c] * boundary[dim];
+            }
+        }
+    }
+
+    if (report_progress(0.5f) &&
+        solve_pinned_system(sys.L, rhs, X, interior_idx, factorization)) {
+        SURFACE_MESH_TRACE_ZONE("copy-back");
+        for (int i = 0; i < n; ++i) {
+            const int row = interior_idx[i];
+            for (int dim = 0; dim < 3; ++dim) {
+                points[i][dim] = row < 0 ? points_init[i][dim] : X(row, dim);
+            }
+        }
+    }
+
+}
+
+void MeshProcessing::calc_uniform_mean_curvature() {
+    Mesh::Vertex_property<DisplayScalar> v_unicurvature =
+            mesh_.vertex_property<DisplayScalar>(v_unicurvature_key, 0.0f);
+    Mesh::Vertex_around_vertex_circulator   vv_c, vv_end;
+    Point             laplace(0.0);
+
+    for (auto v: mesh_.compact_vertices()) {
+        Scalar curv = 0;
+
+        if (!mesh_.is_boundary(v)) {
+            laplace = Point(0.0f);
+            double n = 0;
+            vv_c = mesh_.vertices(v);
+            vv_end = vv_c;
+
+            do {
+                laplace += (mesh_.position(*vv_c) - mesh_.position(v));
+                ++n;
+            } while(++vv_c != vv_end);
+
+            laplace /= n;
+
+            curv = 0.5f * norm(laplace);
+        }
+        v_unicurvature[v] = curv;
+    }
+}
+
+void MeshProcessing::calc_mean_curvature(const CotanWeights& weights) {
+    Mesh::Vertex_property<DisplayScalar> v_curvature =
+            mesh_.vertex_property<DisplayScalar>(v_curvature_key, 0.0f);
+    const Property_vector<Scalar>& e_weight = weights.edge;
+    const Property_vector<Scalar>& v_weight = weights.vertex;
+
+    Mesh::Halfedge_around_vertex_circulator vh_c, vh_end;
+    Mesh::Vertex neighbor_v;
+    Mesh::Edge e;
+    Point laplace(0.0f, 0.0f, 0.0f);
+
+    for (auto v: mesh_.compact_vertices()) {
+        Scalar curv = 0.0f;
+
+        if (!mesh_.is_boundary(v)) {
+            laplace = Point(0.0f, 0.0f, 0.0f);
+
+            vh_c = mesh_.halfedges(v);
+            vh_end = vh_c;
+
+            do {
+                e = mesh_.edge(*vh_c);
+                neighbor_v = mesh_.to_vertex(*vh_c);
+                laplace += e_weight[e.idx()] * (mesh_.position(neighbor_v) -
+                                                mesh_.position(v));
+
+            } while(++vh_c != vh_end);
+
+            laplace *= v_weight[v.idx()];
+            curv = 0.5f * norm(laplace);
+        }
+        v_curvature[v] = curv;
+    }
+}
+
+void MeshProcessing::calc_vertex_properties(const CotanWeights& weights,
+                                            const std::vector<int>* vertices) {
+    SURFACE_MESH_TRACE_ZONE("curvatures");
+    auto v_valence = mesh_.vertex_property<DisplayScalar>(v_valence_key, 0.0f);
+    auto v_unicurvature = mesh_.vertex_property<DisplayScalar>(v_unicurvature_key, 0.0f);
+    auto v_curvature = mesh_.vertex_property<DisplayScalar>(v_curvature_key, 0.0f);
+    auto v_gauss_curvature = mesh_.vertex_property<DisplayScalar>(v_gauss_curvature_key, 0.0f);
+    auto v_normal = mesh_.vertex_property<Point>(v_normal_key);
+    const Property_vector<Scalar>& e_weight = weights.edge;
+    const Property_vector<Scalar>& v_weight = weights.vertex;
+    const Property_vector<Scalar>& corner_angle = weights.angle;
+    const int n_vertices = vertices ? int(vertices->size()) : int(mesh_.vertices_size());
+
+    // one traversal of each one-ring computes the valence, both mean
+    // curvatures, the angle defect and the angle-weighted normal
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n_vertices; ++k) {
+        const int i = vertices ? (*vertices)[k] : k;
+        Mesh::Vertex v(i);
+        if (mesh_.is_deleted(v)) continue;
+
+        const Point& p = mesh_.position(v);
+        Point uniform_laplace(0.0f), laplace(0.0f), normal(0.0f);
+        Scalar angles = 0.0f;
+        unsigned int valence = 0;
+
+        for (auto h: mesh_.halfedges(v)) {
+            const Point d = mesh_.position(mesh_.to_vertex(h)) - p;
+            uniform_laplace += d;
+            laplace += e_weight[mesh_.edge(h).idx()] * d;
+
+            // the corner of the incident face at v, opposite to next(h), for
+            // the angle sum and the angle-weighted normal
+            if (!mesh_.is_boundary(h)) {
+                const Scalar angle = corner_angle[mesh_.next_halfedge(h).idx()];
+                angles += angle;
+                const Point d2 = mesh_.position(mesh_.from_vertex(mesh_.prev_halfedge(h))) - p;
+                const Point n = cross(d, d2);
+                const Scalar denom = norm(n);
+                if (denom > std::numeric_limits<Scalar>::min()) {
+                    normal += n * (angle / denom);
+                }
+            }
+            ++valence;
+        }
+
+        v_valence[v] = valence;
+        v_normal[v] = normal.normalize();
+        if (mesh_.is_boundary(v)) {
+            v_unicurvature[v] = 0.0f;
+            v_curvature[v] = 0.0f;
+            v_gauss_curvature[v] = 0.0f;
+        } else {
+            v_unicurvature[v] = 0.5f * norm(uniform_laplace / Scalar(valence));
+            v_curvature[v] = 0.5f * norm(laplace * v_weight[i]);
+            v_gauss_curvature[v] = (2 * (Scalar)M_PI - angles) * 2.0f * v_weight[i];
+        }
+    }
+}
+
+void MeshProcessing::calc_principal_curvatures(const std::vector<int>* vertices) {
+    SURFACE_MESH_TRACE_ZONE("principal curvatures");
+    auto v_normal = mesh_.vertex_property<Point>(v_normal_key);
+    auto v_max_curvature = mesh_.vertex_property<DisplayScalar>(v_max_curvature_key, 0.0f);
+    auto v_min_curvature = mesh_.vertex_property<DisplayScalar>(v_min_curvature_key, 0.0f);
+    auto v_max_direction = mesh_.vertex_property<Point>(v_max_direction_key, Point(0.0f));
+    const int n_vertices = vertices ? int(vertices->size()) : int(mesh_.vertices_size());
+
+    // the second fundamental form of each vertex in a tangent basis, the
+    // least squares fit to the normal curvatures along its edges, weighted
+    // by the area of the faces at the edge. every vertex sums its own
+    // one-ring, the threads share nothing but the outputs
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n_vertices; ++k) {
+        Mesh::Vertex v(vertices ? (*vertices)[k] : k);
+        if (mesh_.is_deleted(v)) continue;
+        v_max_curvature[v] = 0.0f;
+        v_min_curvature[v] = 0.0f;
+        v_max_direction[v] = Point(0.0f);
+        if (mesh_.is_boundary(v) || mesh_.is_isolated(v)) continue;
+
+        const Point& p = mesh_.position(v);
+        const Point n = v_normal[v];
+        Point t1 = cross(n, std::fabs(n[0]) < 0.6f ? Point(1.0f, 0.0f, 0.0f)
+                                                   : Point(0.0f, 1.0f, 0.0f));
+        t1.normalize();
+        const Point t2 = cross(n, t1);
+
+        // normal equations of kappa = (x^2, 2xy, y^2) . (e, f, g) for the
+        // unit tangent directions (x, y) of the edges
+        double ata[6] = { 0.0 }, atb[3] = { 0.0 };
+        for (auto h: mesh_.halfedges(v)) {
+            const Point d = mesh_.position(mesh_.to_vertex(h)) - p;
+            const Scalar a = dot(d, t1), b = dot(d, t2);
+            const Scalar length2 = sqrnorm(d), tangent2 = a * a + b * b;
+            if (length2 <= std::numeric_limits<Scalar>::min() ||
+                tangent2 <= std::numeric_limits<Scalar>::min()) continue;
+
+            // twice the areas of the faces on both sides of the edge
+            const Mesh::Halfedge o = mesh_.opposite_halfedge(h);
+            Scalar w = norm(cross(d, mesh_.position(mesh_.to_vertex(mesh_.next_halfedge(h))) - p));
+            if (!mesh_.is_boundary(o)) {
+                w += norm(cross(mesh_.position(mesh_.to_vertex(mesh_.next_halfedge(o))) - p, d));
+            }
+            // the circle through both ends, tangent to the plane at v;
+            // positive where the surface bends away from the normal
+            const double kappa = -2.0 * dot(n, d) / length2;
+            const double xx = a * a / tangent2, xy = a * b / tangent2, yy = b * b / tangent2;
+            const double r[3] = { xx, 2.0 * xy, yy };
+            ata[0] += w * r[0] * r[0];
+            ata[1] += w * r[0] * r[1];
+            ata[2] += w * r[0] * r[2];
+            ata[3] += w * r[1] * r[1];
+            ata[4] += w * r[1] * r[2];
+            ata[5] += w * r[2] * r[2];
+            for (int j = 0; j < 3; ++j) atb[j] += w * kappa * r[j];
+        }
+
+        // Cramer's rule, a one-ring with fewer than three directions is left flat
+        const double c00 = ata[3] * ata[5] - ata[4] * ata[4];
+        const double c01 = ata[2] * ata[4] - ata[1] * ata[5];
+        const double c02 = ata[1] * ata[4] - ata[2] * ata[3];
+        const double det = ata[0] * c00 + ata[1] * c01 + ata[2] * c02;
+        const double scale = ata[0] * ata[3] * ata[5];
+        if (!(std::fabs(det) > 1e-12 * scale)) continue;
+        const double c11 = ata[0] * ata[5] - ata[2] * ata[2];
+        const double c12 = ata[1] * ata[2] - ata[0] * ata[4];
+        const double c22 = ata[0] * ata[3] - ata[1] * ata[1];
+        const double e = (c00 * atb[0] + c01 * atb[1] + c02 * atb[2]) / det;
+        const double f = (c01 * atb[0] + c11 * atb[1] + c12 * atb[2]) / det;
+        const double g = (c02 * atb[0] + c12 * atb[1] + c22 * atb[2]) / det;
+
+        // eigenvalues and the direction of the larger one
+        const double mean = 0.5 * (e + g);
+        const double radius = std::sqrt(0.25 * (e - g) * (e - g) + f * f);
+        v_max_curvature[v] = Scalar(mean + radius);
+        v_min_curvature[v] = Scalar(mean - radius);
+        const Scalar theta = Scalar(0.5 * std::atan2(2.0 * f, e - g));
+        v_max_direction[v] = std::cos(theta) * t1 + std::sin(theta) * t2;
+    }
+}
+
+void MeshProcessing::calc_gauss_curvature(const CotanWeights& weights) {
+    Mesh::Vertex_property<DisplayScalar> v_gauss_curvature =
+            mesh_.vertex_property<DisplayScalar>(v_gauss_curvature_key, 0.0f);
+    const Property_vector<Scalar>& v_weight = weights.vertex;
+    const Property_vector<Scalar>& corner_angle = weights.angle;
+
+    // compute for all non-boundary vertices, the corner at v of the face of
+    // h is opposite to next(h)
+    for (auto v: mesh_.compact_vertices()) {
+        Scalar curv = 0.0f;
+
+        if (!mesh_.is_boundary(v)) {
+            Scalar angles = 0.0f;
+            for (auto h: mesh_.halfedges(v)) {
+                angles += corner_angle[mesh_.next_halfedge(h).idx()];
+            }
+            curv = (2 * (Scalar)M_PI - angles) * 2.0f * v_weight[v.idx()];
+        }
+        v_gauss_curvature[v] = curv;
+    }
+}
+
+void MeshProcessing::uniform_smooth(const unsigned int iterations) {
+    smooth_iterations(iterations, false, false);
+}
+
+// iterations of the finer levels of multiresolution_smooth
+static const unsigned int LEVEL_ITERATIONS = 20;
+
+void MeshProcessing::multiresolution_smooth(const unsigned int iterations) {
+    SURFACE_MESH_TRACE_ZONE("multiresolution smooth");
+    const MultigridHierarchy& hierarchy = multigrid_hierarchy();
+
+    // the coarsest level whose own share of the iterations is at least
+    // LEVEL_ITERATIONS, after the finer ones ran theirs; an iteration of
+    // level l counts as 2^l fine ones
+    int top = 0;
+    while (top + 1 < hierarchy.n_levels() &&
+           iterations >= LEVEL_ITERATIONS * ((2u << (top + 1)) - 1)) {
+        ++top;
+    }
+    if (top == 0) {
+        uniform_smooth(iterations);
+        return;
+    }
+    const std::vector<OneRingAdjacency>& rings = coarse_one_rings();
+
+    // positions of the levels, the mean of the vertices of an aggregate
+    Property_vector<Point>& points = mesh_.points();
+    std::vector< std::vector<Point> > positions(top + 1);
+    for (int l = 1; l <= top; ++l) {
+        const std::vector<Point>* finer = l > 1 ? &positions[l - 1] : nullptr;
+        const std::vector<int>& parent = hierarchy.parent(l - 1);
+        std::vector<Point>& level = positions[l];
+        std::vector<int> count(hierarchy.n_vertices(l), 0);
+        level.assign(hierarchy.n_vertices(l), Point(0.0f));
+        for (size_t v = 0; v < parent.size(); ++v) {
+            if (parent[v] < 0) continue;
+            level[parent[v]] += finer ? (*finer)[v] : points[v];
+            ++count[parent[v]];
+        }
+        for (size_t c = 0; c < level.size(); ++c) {
+            if (count[c] > 0) level[c] /= Scalar(count[c]);
+        }
+    }
+
+    // coarse to fine, every level starts from its positions moved by the
+    // displacement of the level above
+    std::vector<Point> displacement, current, buffer;
+    for (int l = top; l > 0; --l) {
+        if (!report_progress(float(top - l) / (top + 1))) return;
+        const std::vector<Point>& level = positions[l];
+        current = level;
+        if (l < top) rings[l - 1].prolongate(displacement.data(), hierarchy.parent(l), current.data());
+        const unsigned int n_iterations = l < top ? LEVEL_ITERATIONS :
+            (iterations - LEVEL_ITERATIONS * ((1u << top) - 1)) >> top;
+        buffer.resize(current.size());
+        for (unsigned int iter = 0; iter < n_iterations; ++iter) {
+            rings[l - 1].smooth_step(current.data(), buffer.data(), 0.5f, false);
+            current.swap(buffer);
+        }
+        displacement.resize(current.size());
+        for (size_t v = 0; v < current.size(); ++v) displacement[v] = current[v] - level[v];
+    }
+
+    one_ring().prolongate(displacement.data(), hierarchy.parent(0), points.data());
+    smooth_iterations(LEVEL_ITERATIONS, false, false);
+}
+
+// lambda and mu of taubin_smooth, 1 / lambda + 1 / mu = 0.11 is the
+// frequency below which the pair grows the mesh instead of smoothing it
+static const Scalar TAUBIN_LAMBDA = 0.5f;
+static const Scalar TAUBIN_MU = -0.53f;
+
+void MeshProcessing::taubin_smooth(const unsigned int iterations) {
+    SURFACE_MESH_TRACE_ZONE("taubin smooth");
+    const OneRingAdjacency& ring = one_ring();
+    Property_vector<Point>& points = mesh_.points();
+    Property_vector<Point> scratch(points.size());
+
+    double first_moved = 0.0;
+    smoothing_iterations_ = 0;
+    for (unsigned int iter = 0; iter < iterations; ++iter) {
+        if (!report_progress(float(iter) / iterations)) break;
+        const double moved = ring.taubin_step(points.data(), scratch.data(), points.data(),
+                                              TAUBIN_LAMBDA, TAUBIN_MU, false);
+        ++smoothing_iterations_;
+        publish_snapshot(iter, points.data());
+        if (iter == 0) first_moved = moved;
+        const double tolerance = smoothing_tolerance_;
+        if (tolerance > 0.0 && moved <= tolerance * tolerance * first_moved) break;
+    }
+}
+
+void MeshProcessing::publish_snapshot(const unsigned int iter, const Point* points) {
+    if (!snapshots_) return;
+    const unsigned int interval = snapshots_->interval();
+    if (interval == 0 || (iter + 1) % interval != 0) return;
+    std::vector<float>& snapshot = snapshots_->back();
+    const size_t n = mesh_.vertices_size();
+    snapshot.resize(3 * n);
+    std::memcpy(snapshot.data(), points, n * sizeof(Point));
+    snapshots_->publish();
+}
+
+void MeshProcessing::smooth(const unsigned int iterations) {
+    smooth_iterations(iterations, true, false);
+}
+
+void MeshProcessing::feature_preserving_smooth(const unsigned int iterations,
+                                               const float feature_angle) {
+    detect_features(feature_angle);
+    smooth_iterations(iterations, true, true);
+}
+
+void MeshProcessing::detect_features(const float feature_angle) {
+    SURFACE_MESH_TRACE_ZONE("features");
+    auto feature = mesh_.edge_property<Scalar>(e_feature_key, 0.0f);
+    const Scalar min_cos = std::cos(feature_angle * Scalar(M_PI) / 180.0f);
+    const int n_edges = mesh_.edges_size();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_edges; ++i) {
+        Mesh::Edge e(i);
+        feature[e] = 0.0f;
+        if (mesh_.is_deleted(e) || mesh_.is_boundary(e)) continue;
+        const surface_mesh::Normal n0 = mesh_.compute_face_normal(mesh_.face(mesh_.halfedge(e, 0)));
+        const surface_mesh::Normal n1 = mesh_.compute_face_normal(mesh_.face(mesh_.halfedge(e, 1)));
+        if (dot(n0, n1) < min_cos) feature[e] = 1.0f;
+    }
+}
+
+bool MeshProcessing::compute_eigenbasis(const unsigned int k) {
+    SURFACE_MESH_TRACE_ZONE("eigenbasis");
+    // the cotan operator and lumped mass of implicit_smoothing
+    const LaplaceOperator& op = laplace_operator(true);
+
+    eigenbasis_revision_ = mesh_.topology_revision();
+    if (!eigenbasis_.compute(op.matrix(), op.mass(), k, 1e-8, progress_)) {
+        eigenbasis_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool MeshProcessing::save_eigenbasis(const string& filename) const {
+    return eigenbasis_.save(filename);
+}
+
+bool MeshProcessing::load_eigenbasis(const string& filename) {
+    if (!eigenbasis_.load(filename, mesh_.n_vertices())) return false;
+    eigenbasis_revision_ = mesh_.topology_revision();
+    return true;
+}
+
+int MeshProcessing::get_eigenbasis_size() {
+    if (eigenbasis_revision_ != mesh_.topology_revision() ||
+        eigenbasis_.n_rows() != int(mesh_.n_vertices())) {
+        eigenbasis_.clear();
+    }
+    return eigenbasis_.size();
+}
+
+void MeshProcessing::spectral_smoothing(const unsigned int components) {
+    spectral_enhance_feature(components, 0);
+}
+
+void MeshProcessing::spectral_enhance_feature(const unsigned int components,
+                                              const float coefficient) {
+    SURFACE_MESH_TRACE_ZONE("spectral");
+    if (get_eigenbasis_size() == 0) return;
+    Property_vector<Point>& points = mesh_.points();
+    const Eigen::MatrixXd X = as_eigen(points).transpose().cast<double>();
+    Eigen::MatrixXd Y;
+    eigenbasis_.low_pass(X, components, Y);
+    // coefficient 0 keeps the low-pass result
+    if (coefficient > 0) Y = X + (X - Y) * double(coefficient);
+    as_eigen(points) = Y.transpose().cast<float>();
+}
+
+// plain smoothing iterations before the Chebyshev semi-iteration starts
+static const unsigned int CHEBYSHEV_WARMUP = 4;
+
+void MeshProcessing::smooth_iterations(const unsigned int iterations, const bool cotan,
+                                       const bool features, const bool enhance,
+                                       const float coefficient) {
+    SURFACE_MESH_TRACE_ZONE("smooth");
+    OneRingAdjacency& ring = one_ring();
+    CotanWeights weights;
+    if (cotan) update_soa();
+    Mesh::Edge_property<Scalar> e_feature;
+    // the creases go into the weight slots, so they cost no extra pass
+    if (features) e_feature = mesh_.edge_property<Scalar>(e_feature_key, 0.0f);
+    if (features && !cotan) {
+        ring.reset_weights();
+        ring.restrict_to_features(e_feature);
+    }
+    const bool weighted = cotan || features;
+    // the Chebyshev semi-iteration needs a fixed step and its spectral
+    // radius, estimated from the decay of the displacements of the plain
+    // iterations before it started; cotan weights follow the positions
+    const bool gauss_seidel = gauss_seidel_smoothing_ && !enhance;
+    if (gauss_seidel && ring.n_colors() == 0) ring.build_colors();
+    const bool accelerate = chebyshev_smoothing_ && !enhance && !cotan && !gauss_seidel;
+    double first_moved = 0.0, previous_moved = 0.0, last_moved = 0.0;
+    double rho2 = 0.0, omega = 1.0;
+    bool converged = false;
+
+    // ping-pong between the positions and a scratch buffer; enhancement
+    // keeps the original positions and ping-pongs between two buffers,
+    // Gauss-Seidel needs neither
+    Property_vector<Point>& points = mesh_.points();
+    const Point center = mesh_center_;
+    const bool preserve = volume_preservation_ && !enhance;
+    const double volume = !preserve ? 0.0 : signed_volume(mesh_, center,
+            [&](const int i) { return surface_mesh::Vec3d(points[i]); });
+    Property_vector<Point> buffer(gauss_seidel ? 0 : points.size()),
+                           spare(enhance ? points.size() : 0);
+    Point* const original = points.data();
+    Point* const ping = buffer.data();
+    Point* const pong = enhance ? spare.data() : original;
+    Point* in = original;
+    Point* out = ping;
+
+    smoothing_iterations_ = 0;
+    for (unsigned int iter=0; iter<iterations; ++iter) {
+        // a cancelled or converged enhancement still extrapolates from
+        // where it stopped
+        const bool stop = !report_progress(float(iter) / iterations) || converged;
+        if (stop && !enhance) break;
+
+        if (cotan && iter % weight_update_interval_ == 0) {
+            // update edge weights, they are computed from the mesh_ positions,
+            // so the buffer with the current ones is swapped in meanwhile
+            Property_vector<Point>* current =
+                in == original ? nullptr : in == ping ? &buffer : &spare;
+            if (current) points.swap(*current);
+            calc_edges_weights(weights);
+            ring.gather_edge_weights(weights.edge);
+            if (features) ring.restrict_to_features(e_feature);
+            if (current) points.swap(*current);
+        }
+
+        if (enhance && (stop || iter + 1 == iterations)) {
+            // amplify what the smoothing removes, fused with the last
+            // iteration; a single iteration cannot write in place
+            if (in != original) {
+                ring.enhance_step(in, original, original, 0.5f, weighted, coefficient);
+            } else {
+                ring.enhance_step(in, original, out, 0.5f, weighted, coefficient);
+                std::copy(out, out + points.size(), original);
+            }
+            ++smoothing_iterations_;
+            return;
+        }
+
+        // new vertex positions by damped Laplacian smoothing, out holds the
+        // iterate before in
+        double moved;
+        if (accelerate && iter >= CHEBYSHEV_WARMUP) {
+            if (iter == CHEBYSHEV_WARMUP) {
+                rho2 = previous_moved > 0.0 ? std::min(last_moved / previous_moved, 0.99) : 0.0;
+                omega = 2.0 / (2.0 - rho2);
+            } else {
+                omega = 4.0 / (4.0 - rho2 * omega);
+            }
+            moved = ring.accelerated_step(in, out, out, 0.5f, weighted, omega);
+        } else if (gauss_seidel) {
+            // undamped, in place that stays stable
+            moved = ring.gauss_seidel_step(original, 1.0f, weighted);
+        } else {
+            moved = ring.smooth_step(in, out, 0.5f, weighted);
+        }
+        ++smoothing_iterations_;
+        if (!gauss_seidel) {
+            in = out;
+            out = in == ping ? pong : ping;
+        }
+        // an enhancement only shows once it extrapolated
+        if (!enhance) publish_snapshot(iter, in);
+
+        // squared displacements, relative to the first iteration
+        if (iter == 0) first_moved = moved;
+        previous_moved = last_moved;
+        last_moved = moved;
+        const double tolerance = smoothing_tolerance_;
+        converged = tolerance > 0.0 && moved <= tolerance * tolerance * first_moved;
+    }
+
+    if (!preserve) {
+        if (in != original) std::copy(in, in + points.size(), original);
+        return;
+    }
+    // the rescaling is fused with the copy back, or in place
+    const float scale = float(volume_scale(volume, signed_volume(mesh_, center, [&](const int i) {
+        return surface_mesh::Vec3d(in[i]);
+    })));
+    const int n_points = int(points.size());
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_points; ++i) original[i] = center + scale * (in[i] - center);
+}
+
+const OneRingAdjacency& MeshProcessing::smoothing_stencil(const bool cotan) {
+    OneRingAdjacency& ring = one_ring();
+    if (cotan) {
+        update_soa();
+        CotanWeights weights;
+        calc_edges_weights(weights);
+        ring.gather_edge_weights(weights.edge);
+    } else {
+        ring.reset_weights();
+    }
+    return ring;
+}
+
+void MeshProcessing::set_points(const Eigen::Matrix3Xf& points) {
+    Property_vector<Point>& positions = mesh_.points();
+    if (size_t(points.cols()) != positions.size()) return;
+    as_eigen(positions) = points;
+}
+
+bool MeshProcessing::replace_positions(const std::vector<Point>& points) {
+    Property_vector<Point>& positions = mesh_.points();
+    if (points.size() != positions.size()) return false;
+    std::copy(points.begin(), points.end(), positions.begin());
+    points_init_ = positions;
+    history_.reset(points_init_);
+    eigenbasis_.clear();
+    clear_constraints();
+    clear_region();
+    region_factorization_.release();
+    dist_max_ = -1.0f;
+    compute_bounds();
+    // nothing is known about what moved, all attributes are dirty
+    compute_mesh_properties();
+    return true;
+}
+
+void MeshProcessing::update_soa() {
+    if (use_soa_kernels_ && (soa_.empty() || soa_revision_ != mesh_.topology_revision())) {
+        soa_.build(mesh_);
+        soa_revision_ = mesh_.topology_revision();
+    }
+}
+
+const SoAGeometry* MeshProcessing::soa_kernels(CotanWeights& weights) const {
+    if (!use_soa_kernels_ || soa_.empty() || soa_revision_ != mesh_.topology_revision()) {
+        return nullptr;
+    }
+    // the positions may have changed since the last kernel
+    SoAGeometry::load(mesh_.points(), weights.positions);
+    return &soa_;
+}
+
+const MultigridHierarchy& MeshProcessing::multigrid_hierarchy() {
+    if (multigrid_.empty() || multigrid_revision_ != mesh_.topology_revision()) {
+        SURFACE_MESH_TRACE_ZONE("multigrid hierarchy");
+        multigrid_.build(mesh_);
+        multigrid_revision_ = mesh_.topology_revision();
+    }
+    return multigrid_;
+}
+
+const std::vector<OneRingAdjacency>& MeshProcessing::coarse_one_rings() {
+    const MultigridHierarchy& hierarchy = multigrid_hierarchy();
+    if (int(coarse_rings_.size()) + 1 != hierarchy.n_levels() ||
+        coarse_rings_revision_ != mesh_.topology_revision()) {
+        coarse_rings_.resize(hierarchy.n_levels() - 1);
+        for (int l = 0; l + 1 < hierarchy.n_levels(); ++l) {
+            const OneRingAdjacency& fine = l == 0 ? one_ring() : coarse_rings_[l - 1];
+            coarse_rings_[l].build_coarse(fine, hierarchy.parent(l), hierarchy.n_vertices(l + 1));
+        }
+        coarse_rings_revision_ = mesh_.topology_revision();
+    }
+    return coarse_rings_;
+}
+
+const std::vector<int>& MeshProcessing::vertex_components(int& n_components) {
+    if (components_.size() != size_t(mesh_.vertices_size()) ||
+        components_revision_ != mesh_.topology_revision()) {
+        SURFACE_MESH_TRACE_ZONE("connected components");
+        n_components_ = connected_components(mesh_, components_);
+        components_revision_ = mesh_.topology_revision();
+    }
+    n_components = n_components_;
+    return components_;
+}
+
+const std::vector<int>& MeshProcessing::subdomain_partition() {
+    if (subdomains_.size() != mesh_.n_vertices() ||
+        subdomains_revision_ != mesh_.topology_revision()) {
+        SURFACE_MESH_TRACE_ZONE("subdomain partition");
+        // blocks of a few thousand vertices at least, below that the
+        // threads cost more than the solves
+        int n_threads = 2;
+#ifdef _OPENMP
+        n_threads = std::max(n_threads, omp_get_max_threads());
+#endif
+        const int n_parts = std::min(n_threads, std::max(1, int(mesh_.n_vertices()) / 4096));
+        subdomains_ = partition_vertices(mesh_, n_parts);
+        subdomains_revision_ = mesh_.topology_revision();
+    }
+    return subdomains_;
+}
+
+OneRingAdjacency& MeshProcessing::one_ring() {
+    if (one_ring_.empty() || one_ring_revision_ != mesh_.topology_revision()) {
+        one_ring_.set_interleaved(interleaved_one_rings_);
+        one_ring_.build(mesh_);
+        one_ring_revision_ = mesh_.topology_revision();
+    }
+    return one_ring_;
+}
+
+void MeshProcessing::uniform_laplacian_enhance_feature(const unsigned int iterations,
+                                                       const float coefficient) {
+    SURFACE_MESH_TRACE_ZONE("enhance_feature");
+    smooth_iterations(iterations, false, false, true, coefficient);
+}
+
+void MeshProcessing::laplace_beltrami_enhance_feature(const unsigned int iterations,
+                                                      const float coefficient) {
+    SURFACE_MESH_TRACE_ZONE("enhance_feature");
+    smooth_iterations(iterations, true, false, true, coefficient);
+}
+
+// the area of triangle f and the clamped cotangents of the corners opposite
+// to its halfedges h[0] = halfedge(f), h[1] and h[2], as the SoA kernel
+// computes them
+static Scalar face_area_cotans(const Mesh& mesh, const Property_vector<Point>& points,
+                               const Scalar max_cotan, const Mesh::Face f,
+                               Mesh::Halfedge* h, Scalar* cotan) {
+    h[0] = mesh.halfedge(f);
+    h[1] = mesh.next_halfedge(h[0]);
+    h[2] = mesh.next_halfedge(h[1]);
+    const Point& p0 = points[mesh.to_vertex(h[0]).idx()];
+    const Point& p1 = points[mesh.to_vertex(h[1]).idx()];
+    const Point& p2 = points[mesh.to_vertex(h[2]).idx()];
+
+    const Point d0 = p1 - p0, d1 = p2 - p1, d2 = p0 - p2;
+    const Scalar double_area = norm(cross(d0, -d2));
+
+    // the corner opposite to halfedge h is the target of next(h)
+    cotan[0] = clamp_cotan(-dot(d0, d1) / double_area, max_cotan);
+    cotan[1] = clamp_cotan(-dot(d1, d2) / double_area, max_cotan);
+    cotan[2] = clamp_cotan(-dot(d2, d0) / double_area, max_cotan);
+    return double_area * 0.5f;
+}
+
+void MeshProcessing::calc_weights(CotanWeights& weights) const {
+    SURFACE_MESH_TRACE_ZONE("weights");
+    const int n_faces = mesh_.faces_size();
+    const int n_edges = mesh_.edges_size();
+    const int n_vertices = mesh_.vertices_size();
+    weights.edge.assign(n_edges, 0.0f);
+    weights.vertex.assign(n_vertices, 0.0f);
+    weights.halfedge.assign(mesh_.halfedges_size(), 0.0f);
+    Property_vector<Scalar>& e_weight = weights.edge;
+    Property_vector<Scalar>& v_weight = weights.vertex;
+    Property_vector<Scalar>& halfedge_cotan = weights.halfedge;
+    const Property_vector<Point>& points = mesh_.points();
+
+    // fused sweep over the triangles: one cross product per face gives its
+    // area and the cotangents of its three corners. the results are stored
+    // per face / halfedge and gathered afterwards, so no scatter races.
+    std::vector<Scalar> face_area(n_faces, 0.0f);
+
+    const SoAGeometry* soa = soa_kernels(weights);
+    if (soa) {
+        soa->face_areas_cotans(weights.positions, max_cotan_, face_area, halfedge_cotan);
+    } else {
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n_faces; ++i) {
+            Mesh::Face f(i);
+            if (mesh_.is_deleted(f)) continue;
+
+            Mesh::Halfedge h[3];
+            Scalar cotan[3];
+            face_area[i] = face_area_cotans(mesh_, points, max_cotan_, f, h, cotan);
+            for (int k = 0; k < 3; ++k) halfedge_cotan[h[k].idx()] = cotan[k];
+        }
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_edges; ++i) {
+        if (mesh_.is_deleted(Mesh::Edge(i))) continue;
+        e_weight[i] = halfedge_cotan[2*i] + halfedge_cotan[2*i+1];
+    }
+
+    // the faces around each vertex from flat arrays rather than a circulator
+    if (soa) {
+        soa->vertex_weights(face_area, v_weight);
+        return;
+    }
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i) {
+        Mesh::Vertex v(i);
+        if (mesh_.is_deleted(v) || mesh_.is_isolated(v)) continue;
+
+        Scalar area = 0.0;
+        for (auto f: mesh_.faces(v)) {
+            area += face_area[f.idx()] * 0.3333f;
+        }
+        v_weight[i] = 0.5 / area;
+    }
+}
+
+void MeshProcessing::calc_local_weights(const std::vector<int>& vertices,
+                                        CotanWeights& weights) const {
+    SURFACE_MESH_TRACE_ZONE("local weights");
+    if (weights.edge.size() != mesh_.edges_size()) weights.edge.resize(mesh_.edges_size());
+    if (weights.vertex.size() != mesh_.vertices_size()) weights.vertex.resize(mesh_.vertices_size());
+    if (weights.halfedge.size() != mesh_.halfedges_size()) {
+        weights.halfedge.resize(mesh_.halfedges_size());
+    }
+    Property_vector<Scalar>& e_weight = weights.edge;
+    Property_vector<Scalar>& v_weight = weights.vertex;
+    Property_vector<Scalar>& halfedge_cotan = weights.halfedge;
+    const Property_vector<Point>& points = mesh_.points();
+
+    // the faces and the edges around the vertices, each written once
+    std::vector<int> faces, edges;
+    for (const int i: vertices) {
+        for (auto h: mesh_.halfedges(Mesh::Vertex(i))) {
+            edges.push_back(mesh_.edge(h).idx());
+            if (!mesh_.is_boundary(h)) faces.push_back(mesh_.face(h).idx());
+        }
+    }
+    for (std::vector<int>* elements: { &faces, &edges }) {
+        std::sort(elements->begin(), elements->end());
+        elements->erase(std::unique(elements->begin(), elements->end()), elements->end());
+    }
+    const int n_faces = faces.size();
+    const int n_edges = edges.size();
+    const int n_vertices = vertices.size();
+
+    // the corners of the faces, those of the boundary halfedges are
+    // cotangents of no face
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n_edges; ++k) {
+        for (int j = 0; j < 2; ++j) {
+            const Mesh::Halfedge h = mesh_.halfedge(Mesh::Edge(edges[k]), j);
+            if (mesh_.is_boundary(h)) halfedge_cotan[h.idx()] = 0.0f;
+        }
+    }
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n_faces; ++k) {
+        Mesh::Halfedge h[3];
+        Scalar cotan[3];
+        face_area_cotans(mesh_, points, max_cotan_, Mesh::Face(faces[k]), h, cotan);
+        for (int j = 0; j < 3; ++j) halfedge_cotan[h[j].idx()] = cotan[j];
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n_edges; ++k) {
+        const int e = edges[k];
+        e_weight[e] = halfedge_cotan[2 * e] + halfedge_cotan[2 * e + 1];
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n_vertices; ++k) {
+        Mesh::Vertex v(vertices[k]);
+        v_weight[v.idx()] = 0.0f;
+        if (mesh_.is_deleted(v) || mesh_.is_isolated(v)) continue;
+
+        Scalar area = 0.0;
+        for (auto f: mesh_.faces(v)) {
+            Mesh::Halfedge h[3];
+            Scalar cotan[3];
+            area += face_area_cotans(mesh_, points, max_cotan_, f, h, cotan) * 0.3333f;
+        }
+        v_weight[v.idx()] = 0.5 / area;
+    }
+}
+
+// the angles of the corners opposite to the halfedges h[0] = halfedge(f),
+// h[1] and h[2] of triangle f, as the SoA kernel computes them
+static void face_corner_angles(const Mesh& mesh, const Property_vector<Point>& points,
+                               const Mesh::Face f, Mesh::Halfedge* h, Scalar* angle) {
+    h[0] = mesh.halfedge(f);
+    h[1] = mesh.next_halfedge(h[0]);
+    h[2] = mesh.next_halfedge(h[1]);
+    const Point& p0 = points[mesh.to_vertex(h[0]).idx()];
+    const Point& p1 = points[mesh.to_vertex(h[1]).idx()];
+    const Point& p2 = points[mesh.to_vertex(h[2]).idx()];
+
+    const Point d0 = p1 - p0, d1 = p2 - p1, d2 = p0 - p2;
+    const Scalar double_area = norm(cross(d0, -d2));
+
+    // atan2 of |cross| and dot keeps its precision for tiny and for
+    // nearly flat corners, where acos of the normalized dot does not
+    angle[0] = std::atan2(double_area, -dot(d0, d1));
+    angle[1] = std::atan2(double_area, -dot(d1, d2));
+    angle[2] = std::atan2(double_area, -dot(d2, d0));
+}
+
+void MeshProcessing::calc_corner_angles(CotanWeights& weights,
+                                        const std::vector<int>* vertices) const {
+    SURFACE_MESH_TRACE_ZONE("corner angles");
+    if (weights.angle.size() != mesh_.halfedges_size()) {
+        weights.angle.assign(mesh_.halfedges_size(), 0.0f);
+    }
+    Property_vector<Scalar>& corner_angle = weights.angle;
+    const Property_vector<Point>& points = mesh_.points();
+
+    // all faces: vectorized over the triangles
+    if (!vertices) {
+        const SoAGeometry* soa = soa_kernels(weights);
+        if (soa) {
+            soa->corner_angles(weights.positions, corner_angle);
+            return;
+        }
+        const int n_faces = mesh_.faces_size();
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n_faces; ++i) {
+            Mesh::Face f(i);
+            if (mesh_.is_deleted(f)) continue;
+
+            Mesh::Halfedge h[3];
+            Scalar angle[3];
+            face_corner_angles(mesh_, points, f, h, angle);
+            for (int k = 0; k < 3; ++k) corner_angle[h[k].idx()] = angle[k];
+        }
+        return;
+    }
 
-            triplets.push_back(Eigen::Triplet<double>(i, vv.idx(), -timestep*eweight));
+    // the faces around the vertices, each written once
+    std::vector<int> faces;
+    for (const int i: *vertices) {
+        for (auto h: mesh_.halfedges(Mesh::Vertex(i))) {
+            if (!mesh_.is_boundary(h)) faces.push_back(mesh_.face(h).idx());
         }
-        triplets.push_back(Eigen::Triplet<double>(i, i, 1.0/vweight + timestep*ww));
     }
+    std::sort(faces.begin(), faces.end());
+    faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+    const int n_faces = faces.size();
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n_faces; ++k) {
+        Mesh::Halfedge h[3];
+        Scalar angle[3];
+        face_corner_angles(mesh_, points, Mesh::Face(faces[k]), h, angle);
+        for (int j = 0; j < 3; ++j) corner_angle[h[j].idx()] = angle[j];
+    }
+}
 
-    // build sparse matrix from triplets
-    A.setFromTriplets(triplets.begin(), triplets.end());
+void MeshProcessing::calc_edges_weights(CotanWeights& weights) const {
+    SURFACE_MESH_TRACE_ZONE("weights");
+    const int n_edges = mesh_.edges_size();
+    weights.edge.assign(n_edges, 0.0f);
+    Property_vector<Scalar>& e_weight = weights.edge;
+    const Property_vector<Point>& points = mesh_.points();
 
-    // solve A*X = B
-    Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > solver(A);
-    Eigen::MatrixXd X = solver.solve(B);
+    if (const SoAGeometry* soa = soa_kernels(weights)) {
+        soa->edge_cotan_weights(weights.positions, max_cotan_, e_weight);
+        return;
+    }
 
-    // copy solution
-    for (int i = 0; i < n; ++i)
+    // every edge is independent: parallel and deterministic
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_edges; ++i)
     {
-        Mesh::Vertex v(i);
-        for (int dim = 0; dim < 3; ++dim)
-            points[v][dim] = X(i, dim);
-    }
+        Mesh::Edge e(i);
+        if (mesh_.is_deleted(e)) continue;
 
-    // clean-up
-    mesh_.remove_vertex_property(area_inv);
-    mesh_.remove_edge_property(cotan);
-}
+        Mesh::Halfedge h0, h1, h2;
+        Point p0, p1, p2, d0, d1;
+        Scalar w = 0.0;
 
-void MeshProcessing::minimal_surface() {
+        h0 = mesh_.halfedge(e, 0);
+        p0 = points[mesh_.to_vertex(h0).idx()];
 
-    const int n = mesh_.n_vertices();
+        h1 = mesh_.halfedge(e, 1);
+        p1 = points[mesh_.to_vertex(h1).idx()];
 
-    // get vertex position
-    auto points = mesh_.vertex_property<Point>("v:point");
-    auto points_init = mesh_init_.vertex_property<Point>("v:point");
+        if (!mesh_.is_boundary(h0))
+        {
+            h2 = mesh_.next_halfedge(h0);
+            p2 = points[mesh_.to_vertex(h2).idx()];
+            d0 = p0 - p2;
+            d1 = p1 - p2;
+            w += clamp_cotan(dot(d0,d1) / norm(cross(d0,d1)), max_cotan_);
+        }
 
-    // compute cotan edge weights and vertex areas
-    calc_weights ();
-    auto cotan = mesh_.edge_property<Scalar>("e:weight");
-    auto area_inv = mesh_.vertex_property<Scalar>("v:weight");
+        if (!mesh_.is_boundary(h1))
+        {
+            h2 = mesh_.next_halfedge(h1);
+            p2 = points[mesh_.to_vertex(h2).idx()];
+            d0 = p0 - p2;
+            d1 = p1 - p2;
+            w += clamp_cotan(dot(d0,d1) / norm(cross(d0,d1)), max_cotan_);
+        }
 
-    // A*X = B
-    Eigen::SparseMatrix<double> L (n, n);
-    Eigen::MatrixXd rhs (Eigen::MatrixXd::Zero (n, 3));
+        e_weight[i] = w;
+    }
+}
 
-    // nonzero elements of A as triplets: (row, column, value)
-    std::vector< Eigen::Triplet<double> > triplets_L;
+void MeshProcessing::calc_vertices_weights(CotanWeights& weights) const {
+    SURFACE_MESH_TRACE_ZONE("weights");
+    const int n_faces = mesh_.faces_size();
+    const int n_vertices = mesh_.vertices_size();
+    weights.vertex.assign(n_vertices, 0.0f);
+    Property_vector<Scalar>& v_weight = weights.vertex;
 
-        double area_sum = 0.;
-    // setup matrix A and rhs B
-    for (int i = 0; i < n; ++i) {
-        Mesh::Vertex v(i);
-        area_sum += 1. / area_inv[v];
+    // compute each triangle area once, then gather it at the corners
+    std::vector<Scalar> face_area(n_faces, 0.0f);
 
-        if (mesh_.is_boundary(v) ) {
-            triplets_L.push_back (Eigen::Triplet<double> (i, i, 1.));
+    const SoAGeometry* soa = soa_kernels(weights);
+    if (soa) {
+        soa->face_areas(weights.positions, face_area);
+    } else {
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n_faces; ++i) {
+            Mesh::Face f(i);
+            if (mesh_.is_deleted(f)) continue;
 
-            // rhs row -- all equal to zero
-            for (int dim = 0; dim < 3; ++dim) {
-                rhs(i, dim) = points_init[v][dim];
-            }
-        } else {
-            // rhs row -- all equal to zero
-            for (int dim = 0; dim < 3; ++dim) {
-                rhs(i, dim) = 0;
-            }
+            Mesh::Halfedge h = mesh_.halfedge(f);
+            const Point& P = mesh_.position(mesh_.to_vertex(h));  h = mesh_.next_halfedge(h);
+            const Point& Q = mesh_.position(mesh_.to_vertex(h));  h = mesh_.next_halfedge(h);
+            const Point& R = mesh_.position(mesh_.to_vertex(h));
 
-            // lhs row
-            double ww(0.0);
-            for (auto hv: mesh_.halfedges(v)) {
-                Mesh::Vertex vv = mesh_.to_vertex(hv);
-                Mesh::Edge    e = mesh_.edge(hv);
+            face_area[i] = norm(cross(Q-P, R-P)) * 0.5f;
+        }
+    }
 
-                double eweight = cotan[e];
-                ww += eweight;
+    // the faces around each vertex from flat arrays rather than a circulator
+    if (soa) {
+        soa->vertex_weights(face_area, v_weight);
+        return;
+    }
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i) {
+        Mesh::Vertex v(i);
+        if (mesh_.is_deleted(v) || mesh_.is_isolated(v)) continue;
 
-                triplets_L.push_back(Eigen::Triplet<double>(i, vv.idx(), -eweight));
-            }
-            triplets_L.push_back(Eigen::Triplet<double>(i, i, ww));
+        Scalar area = 0.0;
+        for (auto f: mesh_.faces(v)) {
+            area += face_area[f.idx()] * 0.3333f;
         }
+        v_weight[i] = 0.5 / area;
     }
-    printf ("Sum of area: %g.\n", area_sum);
-
+}
 
-    L.setFromTriplets (triplets_L.begin (), triplets_L.end ());
+bool MeshProcessing::geodesic_distances(std::vector<float>& distances) {
+    const Mesh::Vertex source = get_selected_vertex();
+    if (!source.is_valid()) return false;
+    return geodesic_distances(std::vector<Mesh::Vertex>(1, source), distances);
+}
 
-    // solve A*X = B
-    Eigen::SparseLU< Eigen::SparseMatrix<double> > solver(L);
-    if (solver.info () != Eigen::Success) {
-        printf("linear solver init failed.\n");
+bool MeshProcessing::geodesic_distances(const std::vector<Mesh::Vertex>& sources,
+                                        std::vector<float>& distances,
+                                        const double timestep_scale) {
+    SURFACE_MESH_TRACE_ZONE("geodesic_distances");
+    const int n = mesh_.vertices_size();
+    const int n_faces = mesh_.faces_size();
+    const Property_vector<Point>& points = mesh_.points();
+
+    // heat of the sources after t = h^2, h the mean edge length, in the
+    // first column; the solvers take three
+    Eigen::MatrixXd B = Eigen::MatrixXd::Zero(n, 3);
+    int n_sources = 0;
+    for (const Mesh::Vertex v: sources) {
+        if (!v.is_valid() || v.idx() >= n || mesh_.is_deleted(v)) continue;
+        B(v.idx(), 0) = 1.0;
+        ++n_sources;
+    }
+    if (n_sources == 0 || mesh_.n_edges() == 0) return false;
+    const double length_sum = deterministic_sum(int(mesh_.edges_size()), 0.0, [&](const int i) {
+        const Mesh::Edge e(i);
+        if (mesh_.is_deleted(e)) return 0.0;
+        return double(norm(points[mesh_.vertex(e, 1).idx()] - points[mesh_.vertex(e, 0).idx()]));
+    });
+    const double h = length_sum / mesh_.n_edges();
+    const double t = timestep_scale * h * h;
+    // the heat falls off exponentially and its gradient is normalized, so
+    // the far field needs more than the relative tolerance of CG: the CG
+    // types solve with DIRECT_LDLT here
+    const SOLVER_TYPE selected = solver_type_;
+    if (selected != DIRECT_LDLT_FLOAT && selected != DIRECT_CHOLMOD &&
+        selected != DIRECT_PARDISO && selected != DIRECT_CUSOLVER) {
+        solver_type_ = DIRECT_LDLT;
+    }
+    Eigen::MatrixXd U = Eigen::MatrixXd::Zero(n, 3);
+    bool solved = solve_laplace(1.0, t, B, U, geodesic_.heat, geodesic_.heat_scales, false);
+    if (!solved) {
+        solver_type_ = selected;
+        return false;
     }
 
-    Eigen::MatrixXd X = solver.solve(rhs);
-    if (solver.info () != Eigen::Success) {
-        printf("linear solver failed.\n");
+    // X = -grad u / |grad u| per face, and per halfedge (a, b) its share
+    // cot / 2 * dot(p_b - p_a, X) of the integrated divergence at a, which
+    // b gets with the opposite sign
+    std::vector<double> flux(mesh_.halfedges_size(), 0.0);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_faces; ++i) {
+        const Mesh::Face f(i);
+        if (mesh_.is_deleted(f)) continue;
+        Mesh::Halfedge hs[3];
+        Scalar cotan[3];
+        face_area_cotans(mesh_, points, max_cotan_, f, hs, cotan);
+        // vertex k is the target of hs[k], the edge opposite to it is
+        // hs[k + 1] from vertex k + 1 to k + 2
+        surface_mesh::Vec3d p[3];
+        double u[3];
+        for (int k = 0; k < 3; ++k) {
+            const int v = mesh_.to_vertex(hs[k]).idx();
+            p[k] = surface_mesh::Vec3d(points[v]);
+            u[k] = U(v, 0);
+        }
+        const surface_mesh::Vec3d normal = cross(p[1] - p[0], p[2] - p[0]);
+        const double double_area = norm(normal);
+        if (double_area == 0.0) continue;
+        surface_mesh::Vec3d grad(0.0, 0.0, 0.0);
+        for (int k = 0; k < 3; ++k) {
+            grad += u[k] * cross(normal, p[(k + 2) % 3] - p[(k + 1) % 3]);
+        }
+        const double grad_norm = norm(grad);
+        if (grad_norm == 0.0) continue;
+        const surface_mesh::Vec3d X = grad / -grad_norm;
+        // hs[k] runs from vertex k - 1 to vertex k
+        for (int k = 0; k < 3; ++k) {
+            flux[hs[k].idx()] = 0.5 * cotan[k] * dot(p[k] - p[(k + 2) % 3], X);
+        }
     }
 
-    // copy solution
+    // (eps M + L) phi = -2 div X: L is twice the negative of the Laplacian
+    // of the divergence, eps keeps the system definite without moving phi
+    // by more than a constant
+    Eigen::MatrixXd& D = B;
+    D.setZero(n, 3);
+#pragma omp parallel for schedule(static)
     for (int i = 0; i < n; ++i) {
-        Mesh::Vertex v(i);
-        for (int dim = 0; dim < 3; ++dim) {
-            points[v][dim] += 1. * (X(i, dim) - points[v][dim]);
+        const Mesh::Vertex v(i);
+        if (mesh_.is_deleted(v)) continue;
+        double divergence = 0.0;
+        for (auto hv: mesh_.halfedges(v)) {
+            divergence += flux[hv.idx()] - flux[mesh_.opposite_halfedge(hv).idx()];
         }
+        D(i, 0) = -2.0 * divergence;
     }
-
-    // clean-up
-    mesh_.remove_vertex_property(area_inv);
-    mesh_.remove_edge_property(cotan);
+    Eigen::MatrixXd& phi = U;
+    phi.setZero(n, 3);
+    solved = solve_laplace(1e-6 / t, 1.0, D, phi, geodesic_.poisson, geodesic_.poisson_scales,
+                           false);
+    solver_type_ = selected;
+    if (!solved) return false;
+
+    double min_value = std::numeric_limits<double>::max();
+    for (int i = 0; i < n; ++i) {
+        if (!mesh_.is_deleted(Mesh::Vertex(i))) min_value = min(min_value, phi(i, 0));
+    }
+    distances.assign(n, 0.0f);
+    for (int i = 0; i < n; ++i) {
+        if (!mesh_.is_deleted(Mesh::Vertex(i))) distances[i] = float(phi(i, 0) - min_value);
+    }
+    return true;
 }
 
-void MeshProcessing::calc_uniform_mean_curvature() {
-    Mesh::Vertex_property<Scalar> v_unicurvature =
-            mesh_.vertex_property<Scalar>("v:unicurvature", 0.0f);
-    Mesh::Vertex_around_vertex_circulator   vv_c, vv_end;
-    Point             laplace(0.0);
-
-    for (auto v: mesh_.vertices()) {
-        Scalar curv = 0;
-
-        if (!mesh_.is_boundary(v)) {
-            laplace = Point(0.0f);
-            double n = 0;
-            vv_c = mesh_.vertices(v);
-            vv_end = vv_c;
-
-            do {
-                laplace += (mesh_.position(*vv_c) - mesh_.position(v));
-                ++n;
-            } while(++vv_c != vv_end);
-
-            laplace /= n;
-
-            curv = 0.5f * norm(laplace);
-        }
-        v_unicurvature[v] = curv;
+void MeshProcessing::load_mesh(const string &filename) {
+    if (!read_mesh(filename)) {
+        std::cerr << "Mesh not found, exiting." << std::endl;
+        exit(-1);
     }
 }
 
-void MeshProcessing::calc_mean_curvature() {
-    Mesh::Vertex_property<Scalar>  v_curvature =
-            mesh_.vertex_property<Scalar>("v:curvature", 0.0f);
-    Mesh::Edge_property<Scalar> e_weight =
-            mesh_.edge_property<Scalar>("e:weight", 0.0f);
-    Mesh::Vertex_property<Scalar>  v_weight =
-            mesh_.vertex_property<Scalar>("v:weight", 0.0f);
+// modification time of filename, -1 if it does not exist
+static long long modification_time(const string& filename) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return -1;
+#if defined(__linux__)
+    return (long long) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+    return (long long) st.st_mtime * 1000000000LL;
+#endif
+}
 
-    Mesh::Halfedge_around_vertex_circulator vh_c, vh_end;
-    Mesh::Vertex neighbor_v;
-    Mesh::Edge e;
-    Point laplace(0.0f, 0.0f, 0.0f);
+bool MeshProcessing::read_mesh(const string& filename) {
+    // a cache written after the last change of filename
+    from_cache_ = false;
+    const string cache = mesh_cache_path(filename);
+    // mapped where the build allows it, save_mesh_cache() replaces the file
+    // by a rename, so the mapping stays intact
+    if (mesh_cache_ && modification_time(cache) > modification_time(filename) &&
+        surface_mesh::map_poly(mesh_, cache)) {
+        face_report_ = surface_mesh::Face_report();
+        from_cache_ = true;
+        cout << "Mesh " << filename << " loaded from " << cache << "." << endl;
+        mesh_changed();
+        // the curvature pass left the normals and curvatures in the cache
+        if (mesh_.get_vertex_property<Point>(v_normal_key) &&
+            mesh_.get_vertex_property<DisplayScalar>(v_curvature_key)) {
+            dirty_ &= ~(DIRTY_NORMALS | DIRTY_CURVATURES);
+        }
+        return true;
+    }
 
-    for (auto v: mesh_.vertices()) {
-        Scalar curv = 0.0f;
+    surface_mesh::Vertex_bounds bounds;
+    const size_t dot = filename.rfind('.');
+    if (dot != string::npos && (filename.compare(dot, string::npos, ".pm") == 0 ||
+                                filename.compare(dot, string::npos, ".PM") == 0)) {
+        // the full mesh, the viewer shows the levels while they arrive
+        if (!read_progressive_mesh(mesh_, filename)) return false;
+    }
+    else if (!surface_mesh::read_mesh(mesh_, filename, &bounds, read_attributes_)) {
+        return false;
+    }
+    face_report_ = mesh_.face_report();
+    if (!face_report_.ok()) std::cerr << filename << ": " << face_report_.summary() << std::endl;
+    // the operators assume triangles, polygons are fanned
+    mesh_.triangulate();
 
-        if (!mesh_.is_boundary(v)) {
-            laplace = Point(0.0f, 0.0f, 0.0f);
+    cout << "Mesh "<< filename << " loaded." << endl;
+    cout << "# of vertices : " << mesh_.n_vertices() << endl;
+    cout << "# of faces : " << mesh_.n_faces() << endl;
+    cout << "# of edges : " << mesh_.n_edges() << endl;
 
-            vh_c = mesh_.halfedges(v);
-            vh_end = vh_c;
+    mesh_changed(bounds.n == mesh_.n_vertices() ? &bounds : nullptr);
+    return true;
+}
 
-            do {
-                e = mesh_.edge(*vh_c);
-                neighbor_v = mesh_.to_vertex(*vh_c);
-                laplace += e_weight[e] * (mesh_.position(neighbor_v) -
-                                          mesh_.position(v));
+bool MeshProcessing::save_mesh_cache(const string& filename) {
+    update_curvatures();
+    // a reader never sees a partly written cache
+    const string cache = mesh_cache_path(filename);
+    const string temporary = cache + ".tmp";
+    if (!surface_mesh::write_poly(mesh_, temporary)) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::remove(cache.c_str());
+    return std::rename(temporary.c_str(), cache.c_str()) == 0;
+}
 
-            } while(++vh_c != vh_end);
+bool MeshProcessing::save_session(const string& filename) {
+    update_principal_curvatures();
+    // the initial positions travel as a vertex property of the file
+    Mesh::Vertex_property<Point> init = mesh_.vertex_property<Point>(v_session_init_key);
+    init.vector() = points_init_;
+    const string temporary = filename + ".tmp";
+    const bool written = surface_mesh::write_poly(mesh_, temporary);
+    mesh_.remove_vertex_property(init);
+    if (!written) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::remove(filename.c_str());
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0) return false;
+    // a basis of an older session must not be taken for this one
+    const string basis = session_basis_path(filename);
+    if (get_eigenbasis_size() > 0) return save_eigenbasis(basis);
+    std::remove(basis.c_str());
+    return true;
+}
 
-            laplace *= v_weight[v];
-            curv = 0.5f * norm(laplace);
+bool MeshProcessing::load_session(const string& filename) {
+    if (!surface_mesh::read_poly(mesh_, filename)) return false;
+    Mesh::Vertex_property<Point> init = mesh_.get_vertex_property<Point>(v_session_init_key);
+    if (!init) {
+        mesh_.clear();
+        mesh_changed();
+        return false;
+    }
+    face_report_ = surface_mesh::Face_report();
+    from_cache_ = false;
+    mesh_changed();
+    points_init_ = init.vector();
+    mesh_.remove_vertex_property(init);
+    // the attributes were up to date when the session was saved
+    if (mesh_.get_vertex_property<Point>(v_normal_key) &&
+        mesh_.get_vertex_property<DisplayScalar>(v_curvature_key)) {
+        dirty_ &= ~(DIRTY_NORMALS | DIRTY_CURVATURES);
+        if (mesh_.get_vertex_property<Point>(v_max_direction_key)) {
+            dirty_ &= ~DIRTY_PRINCIPAL_CURVATURES;
         }
-        v_curvature[v] = curv;
     }
+    load_eigenbasis(session_basis_path(filename));
+    cout << "Session " << filename << " loaded." << endl;
+    return true;
 }
 
-void MeshProcessing::calc_gauss_curvature() {
-    Mesh::Vertex_property<Scalar> v_gauss_curvature =
-            mesh_.vertex_property<Scalar>("v:gauss_curvature", 0.0f);
-    Mesh::Vertex_property<Scalar> v_weight =
-            mesh_.vertex_property<Scalar>("v:weight", 0.0f);
-    Mesh::Vertex_around_vertex_circulator vv_c, vv_c2, vv_end;
-    Point d0, d1;
-    Scalar angles, cos_angle;
-    Scalar lb(-1.0f), ub(1.0f);
+bool MeshProcessing::load_symbolic_cache(const string& filename) {
+    return symbolic_cache_.load(symbolic_cache_path(filename));
+}
 
-    // compute for all non-boundary vertices
-    for (auto v: mesh_.vertices()) {
-        Scalar curv = 0.0f;
+bool MeshProcessing::save_symbolic_cache(const string& filename) {
+    if (!symbolic_cache_.modified()) return true;
+    return symbolic_cache_.save(symbolic_cache_path(filename));
+}
 
-        if (!mesh_.is_boundary(v)) {
-            angles = 0.0f;
+void MeshProcessing::set_mesh(const Mesh& mesh) {
+    mesh_.assign(mesh);
+    face_report_ = surface_mesh::Face_report();
+    mesh_changed();
+}
 
-            vv_c = mesh_.vertices(v);
-            vv_end = vv_c;
+void MeshProcessing::mesh_changed(const surface_mesh::Vertex_bounds* bounds) {
+    peak_solver_memory_ = 0;
+    workspace_ = SolverWorkspace();
+    cotan_laplace_.clear();
+    uniform_laplace_.clear();
+    interior_ = InteriorSystem();
+    eigenbasis_.clear();
+    clear_constraints();
+    clear_region();
+    region_.index = std::vector<int>();
+    region_factorization_.release();
+    // mesh_ never holds garbage between operations, so the loops over it may
+    // take the compact ranges
+    if (mesh_.has_garbage()) mesh_.garbage_collection();
+    // the readers reserve by estimate
+    mesh_.free_memory();
+
+    // the center and the bounds of the mesh, from the reader if it gathered
+    // them; otherwise computed, the same on any number of threads
+    dist_max_ = -1.0f;
+    if (bounds) {
+        mesh_center_ = bounds->centroid();
+        bbox_min_ = bounds->min;
+        bbox_max_ = bounds->max;
+    } else {
+        compute_bounds();
+    }
+    // a loading viewer may draw the bounds from here on, see read_mesh()
+    report_progress(0.5f);
 
-            do {
-                vv_c2 = vv_c;
-                ++ vv_c2;
-                d0 = normalize(mesh_.position(*vv_c) - mesh_.position(v));
-                d1 = normalize(mesh_.position(*vv_c2) - mesh_.position(v));
-                cos_angle = max(lb, min(ub, dot(d0, d1)));
-                angles += acos(cos_angle);
-            } while(++vv_c != vv_end);
+    // keep the original positions for minimal_surface, the connectivity
+    // of mesh_ does not change
+    points_init_ = mesh_.points();
+    history_.reset(points_init_);
 
-            curv = (2 * (Scalar)M_PI - angles) * 2.0f * v_weight[v];
-        }
-        v_gauss_curvature[v] = curv;
-    }
+    update_soa();
+    compute_mesh_properties();
 }
 
-void MeshProcessing::uniform_smooth(const unsigned int iterations) {
-    Mesh::Vertex_around_vertex_circulator vv_c, vv_end;
-    Point laplacian;
-    unsigned int w;
-    Mesh::Vertex_property<Point> v_new_pos = mesh_.vertex_property<Point>("v:new_positions");
+void MeshProcessing::compute_bounds() {
+    struct Bounds {
+        Point sum, min, max;
+    };
+    const Property_vector<Point>& points = mesh_.points();
+    const int n_vertices = mesh_.vertices_size();
+    const Point first = mesh_.n_vertices() > 0 ? mesh_.position(*mesh_.vertices_begin())
+                                               : Point(0.0f, 0.0f, 0.0f);
+    const Bounds none = { Point(0.0f, 0.0f, 0.0f), first, first };
+    const Bounds bounds = deterministic_reduce(n_vertices, none, [&](const int i) {
+        if (mesh_.is_deleted(Mesh::Vertex(i))) return none;
+        const Bounds b = { points[i], points[i], points[i] };
+        return b;
+    }, [](const Bounds& a, const Bounds& b) {
+        Bounds c = { a.sum + b.sum, a.min, a.max };
+        c.min.minimize(b.min);
+        c.max.maximize(b.max);
+        return c;
+    });
+    mesh_center_ = bounds.sum / Scalar(mesh_.n_vertices());
+    bbox_min_ = bounds.min;
+    bbox_max_ = bounds.max;
+}
 
-    for (unsigned int iter=0; iter<iterations; ++iter) {
-        // compute new vertex positions by Laplacian smoothing
-        for (auto v: mesh_.vertices()) {
-            laplacian = Point(0.0);
-            w = 0;
-
-            if (!mesh_.is_boundary(v)) {
-                vv_c = mesh_.vertices(v);
-                vv_end = vv_c;
-
-                do {
-                    laplacian += (mesh_.position(*vv_c) - mesh_.position(v));
-                    w++;
-                } while(++vv_c != vv_end);
-
-                laplacian /= w;   // normalize by sum of weights
-                laplacian *= 0.5;  // damping
-            }
+float MeshProcessing::get_dist_max() {
+    // the maximum distance from all points in the mesh and the center
+    if (dist_max_ < 0.0f) {
+        const Property_vector<Point>& points = mesh_.points();
+        dist_max_ = deterministic_reduce(int(mesh_.vertices_size()), 0.0f, [&](const int i) {
+            return mesh_.is_deleted(Mesh::Vertex(i)) ? 0.0f : distance(mesh_center_, points[i]);
+        }, [](const Scalar a, const Scalar b) { return std::max(a, b); });
+    }
+    return dist_max_;
+}
 
-            v_new_pos[v] = mesh_.position(v) + laplacian;
-        }
+void MeshProcessing::compact() {
+    // derived scalars, colors and weights are recomputed on demand
+    static const char* vertex_names[] = {
+        "v:valence", "v:unicurvature", "v:curvature", "v:gauss_curvature",
+        "v:max_curvature", "v:min_curvature", "v:max_direction", "v:color_valence", "v:color_unicurvature", "v:color_curvature",
+        "v:color_gaussian_curv", "v:deviation", "v:self_intersection" };
+    for (const char* name: vertex_names) {
+        if (auto p = mesh_.get_vertex_property<Scalar>(name)) mesh_.remove_vertex_property(p);
+        if (auto p = mesh_.get_vertex_property<DisplayScalar>(name)) mesh_.remove_vertex_property(p);
+        if (auto p = mesh_.get_vertex_property<Color8>(name)) mesh_.remove_vertex_property(p);
+        if (auto p = mesh_.get_vertex_property<Point>(name)) mesh_.remove_vertex_property(p);
+    }
+    if (auto p = mesh_.get_edge_property<Scalar>(e_feature_key)) mesh_.remove_edge_property(p);
+    if (auto p = mesh_.get_face_property<bool>(f_self_intersection_key)) {
+        mesh_.remove_face_property(p);
+    }
+    dirty_ = DIRTY_ALL;
+    deviation_valid_ = false;
+    self_intersections_valid_ = false;
+    local_dirty_ = 0;
+    std::vector<int>().swap(stale_);
+    local_weights_ = CotanWeights();
+
+    // acceleration structures and factorizations are rebuilt by the next
+    // query or solve
+    bvh_ = TriangleBVH();
+    lod_ = LodHierarchy();
+    draw_clusters_ = DrawClusters();
+    one_ring_ = OneRingAdjacency();
+    soa_ = SoAGeometry();
+    laplace_factorization_.release();
+    interior_factorization_.release();
+    region_factorization_.release();
+    geodesic_.heat.release();
+    geodesic_.poisson.release();
+    cg_ichol_solver_.compute(Eigen::SparseMatrix<double>());
+    cg_multigrid_solver_.preconditioner().clear();
+    multigrid_ = MultigridHierarchy();
+    std::vector<OneRingAdjacency>().swap(coarse_rings_);
+    cg_schwarz_solver_.preconditioner().clear();
+    std::vector<int>().swap(subdomains_);
+    std::vector<int>().swap(components_);
+    workspace_ = SolverWorkspace();
+    cotan_laplace_.clear();
+    uniform_laplace_.clear();
+    interior_ = InteriorSystem();
+
+    mesh_.garbage_collection();
+    mesh_.free_memory();
+}
 
-        // update vertex positions
-        for (auto v: mesh_.vertices()) {
-            mesh_.position(v) = v_new_pos[v];
-        }
+bool MeshProcessing::save_mesh(const string& filename, const bool binary_off) {
+    // some writers expect v:normal, bring it up to date first
+    get_normals();
+    const size_t dot = filename.rfind('.');
+    if (binary_off && dot != string::npos && (filename.compare(dot, string::npos, ".off") == 0 ||
+                                              filename.compare(dot, string::npos, ".OFF") == 0)) {
+        return surface_mesh::write_off_binary(mesh_, filename);
     }
+    return mesh_.write(filename);
 }
 
-void MeshProcessing::smooth(const unsigned int iterations) {
-    Mesh::Halfedge h;
-    Mesh::Edge e;
-    Mesh::Halfedge_around_vertex_circulator vh_c, vh_end;
-    Mesh::Vertex neighbor_v;
-    Point laplace;
-    Scalar w, ww;
-    Mesh::Vertex_property<Point> v_new_pos =
-            mesh_.vertex_property<Point>("v:new_pos");
-    Mesh::Edge_property<Scalar> e_weight =
-            mesh_.edge_property<Scalar>("e:weight", 0.0f);
+bool MeshProcessing::save_vertex_columns(const string& filename) {
+    update_principal_curvatures();
+    std::vector<string> columns = {
+        "v:point", v_valence_key.name(), v_unicurvature_key.name(), v_curvature_key.name(),
+        v_gauss_curvature_key.name(), v_max_curvature_key.name(), v_min_curvature_key.name() };
+    if (points_init_.size() == mesh_.vertices_size()) {
+        deviation();
+        columns.push_back(v_deviation_key.name());
+    }
+    // rows are vertex indices, deleted vertices are flagged rather than left out
+    if (mesh_.has_garbage()) columns.push_back("v:deleted");
+    return surface_mesh::write_arrow(mesh_, filename, surface_mesh::ARROW_VERTICES, columns);
+}
 
-    for (unsigned int iter=0; iter<iterations; ++iter) {
-        // update edge weights
-        calc_edges_weights();
+void MeshProcessing::reorder_mesh(const surface_mesh::Reorder_method method) {
+    // carry the original positions along so they get the same numbering
+    const bool keep_init = points_init_.size() == mesh_.vertices_size();
+    auto init_points = mesh_.add_vertex_property<Point>("v:init_point");
+    if (keep_init) init_points.vector() = points_init_;
 
-        // compute new vertex positions by Laplacian smoothing
-        for (auto v: mesh_.vertices()) {
-            laplace = Point(0.0);
-            ww = 0;
+    surface_mesh::reorder(mesh_, method);
+    update_soa();
 
-            if (!mesh_.is_boundary(v)) {
-                vh_c = mesh_.halfedges(v);
-                vh_end = vh_c;
+    points_init_ = keep_init ? init_points.vector()
+                             : mesh_.points();
+    mesh_.remove_vertex_property(init_points);
+    // the recorded steps refer to the old numbering
+    history_.reset(mesh_.points());
+    compute_mesh_properties();
+}
 
-                do {
-                    h = *vh_c;
-                    e = mesh_.edge(h);
-                    w = e_weight[e];
-                    ww += w;
-                    neighbor_v = mesh_.to_vertex(h);
+bool MeshProcessing::weld_vertices(const float tolerance) {
+    if (surface_mesh::weld_vertices(mesh_, tolerance) == 0) return false;
+    mesh_changed();
+    return true;
+}
 
-                    laplace += w * (mesh_.position(neighbor_v) - mesh_.position(v));
+bool MeshProcessing::subdivide(const surface_mesh::Subdivision_method method,
+                               const unsigned int levels) {
+    if (levels == 0 || !surface_mesh::subdivide(mesh_, method, levels)) return false;
+    mesh_changed();
+    return true;
+}
 
-                } while(++vh_c != vh_end);
+bool MeshProcessing::decimate(const DecimationOptions& options) {
+    if (mesh_processing::decimate(mesh_, options, progress_) == 0) return false;
+    mesh_changed();
+    return true;
+}
 
-                laplace /= ww;   // normalize by sum of weights
-                laplace *= 0.5;  // damping
-            }
+bool MeshProcessing::remesh(const RemeshingOptions& options) {
+    if (mesh_processing::remesh(mesh_, options, progress_) == 0) return false;
+    mesh_changed();
+    return true;
+}
 
-            v_new_pos[v] = mesh_.position(v) + laplace;
-        }
+void MeshProcessing::compute_mesh_properties() {
+    // the history tells which vertices moved, nothing is known after a
+    // reset, e.g. for a new mesh
+    std::vector<int> moved;
+    const bool pushed = history_.push(mesh_.points(), &moved);
+    geometry_changed(pushed ? &moved : nullptr);
+}
+
+bool MeshProcessing::undo() {
+    std::vector<int> moved;
+    if (!history_.undo(mesh_.points(), &moved)) return false;
+    geometry_changed(&moved);
+    return true;
+}
 
+bool MeshProcessing::redo() {
+    std::vector<int> moved;
+    if (!history_.redo(mesh_.points(), &moved)) return false;
+    geometry_changed(&moved);
+    return true;
+}
 
-        // update vertex positions
-        for (auto v: mesh_.vertices()) {
-            mesh_.position(v) = v_new_pos[v];
+// vertices and their neighbors, sorted
+static void add_one_ring(const Mesh& mesh, std::vector<int>& vertices) {
+    const size_t n = vertices.size();
+    for (size_t k = 0; k < n; ++k) {
+        for (auto h: mesh.halfedges(Mesh::Vertex(vertices[k]))) {
+            vertices.push_back(mesh.to_vertex(h).idx());
         }
     }
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
 }
 
-void MeshProcessing::uniform_laplacian_enhance_feature(const unsigned int iterations,
-                                                       const unsigned int coefficient) {
-    Mesh::Vertex_property<Point> v_old_pos = mesh_.vertex_property<Point>("v:old_pos");
+void MeshProcessing::geometry_changed(const std::vector<int>* moved) {
+    ++geometry_revision_;
+    deviation_valid_ = false;
+    self_intersections_valid_ = false;
+	selection_ = Eigen::MatrixXf(3, 1);
 
-    for(auto v: mesh_.vertices()) {
-        v_old_pos[v] = mesh_.position(v);
+    // the curvatures of the two-ring of a moved vertex depend on it through
+    // the weights of their edges, the normals and colors follow them
+    const size_t n_vertices = mesh_.n_vertices();
+    std::vector<int> ring;
+    if (moved && attributes_topology_revision_ == mesh_.topology_revision() &&
+        moved->size() * LOCAL_UPDATE_FRACTION <= n_vertices) {
+        ring = *moved;
+        add_one_ring(mesh_, ring);
+        add_one_ring(mesh_, ring);
+    }
+    if (local_dirty_ == 0) stale_.clear();
+    attributes_topology_revision_ = mesh_.topology_revision();
+    if (ring.empty() || (stale_.size() + ring.size()) * LOCAL_UPDATE_FRACTION > n_vertices) {
+        // every attribute is recomputed on its next get_*
+        dirty_ = DIRTY_ALL;
+        local_dirty_ = 0;
+        std::vector<int>().swap(stale_);
+        changed_revision_ = geometry_revision_;
+        changed_begin_ = changed_end_ = 0;
+        return;
     }
 
-    uniform_smooth(iterations);
+    // the attributes that are up to date become stale on the ring only
+    local_dirty_ |= DIRTY_ALL & ~dirty_;
+    const size_t n_stale = stale_.size();
+    stale_.insert(stale_.end(), ring.begin(), ring.end());
+    std::inplace_merge(stale_.begin(), stale_.begin() + n_stale, stale_.end());
+    stale_.erase(std::unique(stale_.begin(), stale_.end()), stale_.end());
+    changed_begin_ = changed_end_ > changed_begin_ ? min(changed_begin_, ring.front()) : ring.front();
+    changed_end_ = max(changed_end_, ring.back() + 1);
+}
 
-    for(auto v: mesh_.vertices()) {
-        mesh_.position(v) += (v_old_pos[v] - mesh_.position(v)) * coefficient;
+const MeshHash& MeshProcessing::get_mesh_hash() {
+    if (!hashed_ || hash_topology_revision_ != mesh_.topology_revision()) {
+        mesh_hash_.topology = topology_hash(mesh_);
+        hash_topology_revision_ = mesh_.topology_revision();
+        hashed_ = false;
     }
+    if (!hashed_ || hash_geometry_revision_ != geometry_revision_) {
+        mesh_hash_.geometry = geometry_hash(mesh_);
+        hash_geometry_revision_ = geometry_revision_;
+        hashed_ = true;
+    }
+    return mesh_hash_;
 }
 
-void MeshProcessing::laplace_beltrami_enhance_feature(const unsigned int iterations,
-                                                      const unsigned int coefficient) {
-    Mesh::Vertex_property<Point> v_old_pos = mesh_.vertex_property<Point>("v:old_pos");
+bool MeshProcessing::get_changed_vertices(const int since, int& first, int& count) const {
+    if (since < int(changed_revision_) || since > int(geometry_revision_)) return false;
+    first = changed_begin_;
+    count = changed_end_ - changed_begin_;
+    return true;
+}
 
-    for(auto v: mesh_.vertices()) {
-        v_old_pos[v] = mesh_.position(v);
+const MatrixXu* MeshProcessing::get_indices() {
+    // geometry-only edits keep the index buffer
+    if (indices_revision_ != mesh_.topology_revision()) {
+        indices_ = MatrixXu(3, mesh_.n_faces());
+        int j = 0;
+        for (auto f: mesh_.compact_faces()) {
+            int k = 0;
+            for (auto v: mesh_.vertices(f)) {
+                indices_(k, j) = v.idx();
+                ++k;
+            }
+            ++j;
+        }
+        // vertex cache and overdraw friendly, once per connectivity; the
+        // columns are triangles but no longer faces
+        optimize_draw_order(as_const_eigen(mesh_.points()), indices_.data(), int(indices_.cols()));
+        indices_revision_ = mesh_.topology_revision();
     }
+    return &indices_;
+}
 
-    smooth(iterations);
-
-    for(auto v: mesh_.vertices()) {
-        mesh_.position(v) += (v_old_pos[v] - mesh_.position(v)) * coefficient;
+const DrawClusters& MeshProcessing::get_draw_clusters() {
+    const MatrixXu& indices = *get_indices();
+    if (draw_clusters_.empty() || draw_clusters_topology_revision_ != indices_revision_) {
+        draw_clusters_.build(get_points(), indices.data(), int(indices.cols()));
+        draw_clusters_topology_revision_ = indices_revision_;
+        draw_clusters_geometry_revision_ = geometry_revision_;
+    } else if (draw_clusters_geometry_revision_ != geometry_revision_) {
+        draw_clusters_.refit(get_points(), indices.data());
+        draw_clusters_geometry_revision_ = geometry_revision_;
     }
+    return draw_clusters_;
 }
 
-void MeshProcessing::calc_weights() {
-    calc_edges_weights();
-    calc_vertices_weights();
+const LodHierarchy& MeshProcessing::get_lod() {
+    if (lod_.empty() || lod_topology_revision_ != mesh_.topology_revision()) {
+        lod_.build(mesh_);
+        lod_topology_revision_ = mesh_.topology_revision();
+        lod_geometry_revision_ = geometry_revision_;
+    } else if (lod_geometry_revision_ != geometry_revision_) {
+        lod_.refit(mesh_);
+        lod_geometry_revision_ = geometry_revision_;
+    }
+    return lod_;
 }
 
-void MeshProcessing::calc_edges_weights() {
-    auto e_weight = mesh_.edge_property<Scalar>("e:weight", 0.0f);
-    auto points = mesh_.vertex_property<Point>("v:point");
-
-    Mesh::Halfedge h0, h1, h2;
-    Point p0, p1, p2, d0, d1;
-
-    for (auto e: mesh_.edges())
-    {
-        e_weight[e] = 0.0;
-
-        h0 = mesh_.halfedge(e, 0);
-        p0 = points[mesh_.to_vertex(h0)];
+ConstMatrix3XfMap MeshProcessing::get_points() {
+    return as_const_eigen(mesh_.points());
+}
 
-        h1 = mesh_.halfedge(e, 1);
-        p1 = points[mesh_.to_vertex(h1)];
+ConstMatrix3XfMap MeshProcessing::get_points_init() {
+    if (points_init_.empty()) return ConstMatrix3XfMap(nullptr, 3, 0);
+    return as_const_eigen(points_init_);
+}
 
-        if (!mesh_.is_boundary(h0))
-        {
-            h2 = mesh_.next_halfedge(h0);
-            p2 = points[mesh_.to_vertex(h2)];
-            d0 = p0 - p2;
-            d1 = p1 - p2;
-            e_weight[e] += dot(d0,d1) / norm(cross(d0,d1));
+ConstMatrix3XfMap MeshProcessing::get_normals() {
+    // the curvature pass leaves up to date normals in v:normal,
+    // otherwise update only the normals
+    if (dirty_ & DIRTY_NORMALS) {
+        if (dirty_ & DIRTY_CURVATURES) {
+            mesh_.update_vertex_normals();
         }
-
-        if (!mesh_.is_boundary(h1))
-        {
-            h2 = mesh_.next_halfedge(h1);
-            p2 = points[mesh_.to_vertex(h2)];
-            d0 = p0 - p2;
-            d1 = p1 - p2;
-            e_weight[e] += dot(d0,d1) / norm(cross(d0,d1));
+        dirty_ &= ~DIRTY_NORMALS;
+    } else if (local_dirty_ & DIRTY_NORMALS) {
+        if (dirty_ & DIRTY_CURVATURES) {
+            auto v_normal = mesh_.vertex_property<Point>(v_normal_key);
+            for (const int i: stale_) v_normal[Mesh::Vertex(i)] = mesh_.compute_vertex_normal(Mesh::Vertex(i));
+        } else {
+            update_curvatures();
         }
+        local_dirty_ &= ~DIRTY_NORMALS;
     }
+    return as_const_eigen(mesh_.vertex_property<Point>(v_normal_key).vector());
 }
 
-void MeshProcessing::calc_vertices_weights() {
-    Mesh::Face_around_vertex_circulator vf_c, vf_end;
-    Mesh::Vertex_around_face_circulator fv_c;
-    Scalar area;
-    auto v_weight = mesh_.vertex_property<Scalar>("v:weight", 0.0f);
-
-    for (auto v: mesh_.vertices()) {
-        area = 0.0;
-        vf_c = mesh_.faces(v);
-
-        if(!vf_c) {
-            continue;
-        }
+ConstMatrix4Xu8Map MeshProcessing::get_colors_valence() {
+    return update_color(DIRTY_COLOR_VALENCE, "v:valence", "v:color_valence",
+                        100 /* bound */);
+}
 
-        vf_end = vf_c;
+ConstMatrix4Xu8Map MeshProcessing::get_colors_unicurvature() {
+    return update_color(DIRTY_COLOR_UNICURVATURE, "v:unicurvature",
+                        "v:color_unicurvature", 20);
+}
 
-        do {
-            fv_c = mesh_.vertices(*vf_c);
+ConstMatrix4Xu8Map MeshProcessing::get_colors_gaussian_curv() {
+    return update_color(DIRTY_COLOR_GAUSSIAN_CURV, "v:gauss_curvature",
+                        "v:color_gaussian_curv", 20);
+}
 
-            const Point& P = mesh_.position(*fv_c);  ++fv_c;
-            const Point& Q = mesh_.position(*fv_c);  ++fv_c;
-            const Point& R = mesh_.position(*fv_c);
+ConstMatrix4Xu8Map MeshProcessing::get_color_curvature() {
+    return update_color(DIRTY_COLOR_CURVATURE, "v:curvature", "v:color_curvature", 20);
+}
 
-            area += norm(cross(Q-P, R-P)) * 0.5f * 0.3333f;
+// the values of a display scalar property as floats: the storage itself, or
+// the values converted into buffer if they are stored in half precision
+static const float* as_floats(const Property_vector<Scalar>& values, std::vector<float>&) {
+    return values.data();
+}
+static const float* as_floats(const Property_vector<surface_mesh::Half>& values,
+                              std::vector<float>& buffer) {
+    buffer.resize(values.size());
+    geometry_kernels().halves_to_floats(int(values.size()),
+                                        reinterpret_cast<const uint16_t*>(values.data()),
+                                        buffer.data());
+    return buffer.data();
+}
 
-        } while(++vf_c != vf_end);
+// the values at the 1/bound and 1 - 1/bound quantiles, reorders values
+static void quantile_bounds(std::vector<Scalar>& values, int bound,
+                            Scalar& min_value, Scalar& max_value) {
+    // discard upper and lower bound, only the two order statistics are
+    // needed so partial selection replaces the full sort
+    unsigned int n = values.size()-1;
+    unsigned int i = n / bound;
+    std::nth_element(values.begin(), values.begin() + i, values.end());
+    std::nth_element(values.begin() + i + 1, values.begin() + (n-1-i), values.end());
+    min_value = values[i];
+    max_value = values[n-1-i];
+}
 
-        v_weight[v] = 0.5 / area;
+ConstRowXfMap MeshProcessing::get_scalars(const SCALAR_TYPE type, float& min_value,
+                                          float& max_value) {
+    static const surface_mesh::Property_key* keys[] = {
+        &v_valence_key, &v_unicurvature_key, &v_curvature_key, &v_gauss_curvature_key,
+        &v_max_curvature_key, &v_min_curvature_key, &v_deviation_key, &v_self_intersection_key };
+    if (type == SCALAR_DEVIATION) {
+        // from no deviation up to the largest one, the quantiles would hide
+        // the few vertices that moved
+        min_value = 0.0f;
+        max_value = float(deviation().hausdorff());
+        auto values = mesh_.vertex_property<DisplayScalar>(v_deviation_key, 0.0f);
+        return ConstRowXfMap(as_floats(values.vector(), scalar_buffer_), values.vector().size());
+    }
+    if (type == SCALAR_SELF_INTERSECTION) {
+        min_value = 0.0f;
+        max_value = 1.0f;
+        self_intersections();
+        auto values = mesh_.vertex_property<DisplayScalar>(v_self_intersection_key, 0.0f);
+        return ConstRowXfMap(as_floats(values.vector(), scalar_buffer_), values.vector().size());
     }
+    update_curvatures();
+    if (type == SCALAR_MAX_CURVATURE || type == SCALAR_MIN_CURVATURE) {
+        update_principal_curvatures();
+    }
+    auto values = mesh_.vertex_property<DisplayScalar>(*keys[type], 0.0f);
+    color_bounds(values, type == SCALAR_VALENCE ? 100 : 20, min_value, max_value);
+    return ConstRowXfMap(as_floats(values.vector(), scalar_buffer_), values.vector().size());
 }
 
-void MeshProcessing::load_mesh(const string &filename) {
-    if (!mesh_.read(filename)) {
-        std::cerr << "Mesh not found, exiting." << std::endl;
-        exit(-1);
+MeshProcessing::DeviationReport MeshProcessing::deviation(const bool symmetric) {
+    SURFACE_MESH_TRACE_ZONE("deviation");
+    if (deviation_valid_ && deviation_topology_revision_ == mesh_.topology_revision() &&
+        (deviation_symmetric_ || !symmetric)) {
+        return deviation_;
     }
-
-    cout << "Mesh "<< filename << " loaded." << endl;
-    cout << "# of vertices : " << mesh_.n_vertices() << endl;
-    cout << "# of faces : " << mesh_.n_faces() << endl;
-    cout << "# of edges : " << mesh_.n_edges() << endl;
-
-    // Compute the center of the mesh
-    mesh_center_ = Point(0.0f, 0.0f, 0.0f);
-    for (auto v: mesh_.vertices()) {
-        mesh_center_ += mesh_.position(v);
+    const int n = int(mesh_.vertices_size());
+    auto values = mesh_.vertex_property<DisplayScalar>(v_deviation_key, 0.0f);
+    deviation_ = DeviationReport();
+    if (n == 0 || points_init_.size() != mesh_.vertices_size()) return deviation_;
+
+    // a vertex lies on its own surface, the distance to its other position
+    // bounds that to the other surface
+    const Point* current = mesh_.points().data();
+    const Point* original = points_init_.data();
+    std::vector<Scalar> bound2(n), forward2(n), backward2;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) bound2[i] = sqrnorm(current[i] - original[i]);
+
+    update_bvh();
+    TriangleBVH original_bvh = bvh_;
+    original_bvh.refit(original);
+    original_bvh.closest_distances(original, current, n, bound2.data(), forward2.data());
+    if (symmetric) {
+        backward2.resize(n);
+        bvh_.closest_distances(current, original, n, bound2.data(), backward2.data());
     }
-    mesh_center_ /= mesh_.n_vertices();
 
-    // Compute the maximum distance from all points in the mesh and the center
-    dist_max_ = 0.0f;
-    for (auto v: mesh_.vertices()) {
-        if (distance(mesh_center_, mesh_.position(v)) > dist_max_) {
-            dist_max_ = distance(mesh_center_, mesh_.position(v));
-        }
+    const double forward_sum = deterministic_sum(n, 0.0, [&](const int i) {
+        return double(std::sqrt(forward2[i]));
+    });
+    deviation_.forward_mean = forward_sum / n;
+    const double backward_sum = !symmetric ? 0.0 : deterministic_sum(n, 0.0, [&](const int i) {
+        return double(std::sqrt(backward2[i]));
+    });
+    deviation_.backward_mean = backward_sum / n;
+    Scalar forward_max = 0.0f, backward_max = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        const Scalar d2 = symmetric ? std::max(forward2[i], backward2[i]) : forward2[i];
+        forward_max = std::max(forward_max, forward2[i]);
+        if (symmetric) backward_max = std::max(backward_max, backward2[i]);
+        values[Mesh::Vertex(i)] = std::sqrt(d2);
     }
+    deviation_.forward_max = std::sqrt(forward_max);
+    deviation_.backward_max = std::sqrt(backward_max);
 
-    compute_mesh_properties();
-
-    // Store the original mesh, this might be useful for some computations
-    mesh_init_ = mesh_;
+    deviation_topology_revision_ = mesh_.topology_revision();
+    deviation_symmetric_ = symmetric;
+    deviation_valid_ = true;
+    return deviation_;
 }
 
-void MeshProcessing::compute_mesh_properties() {
-    Mesh::Vertex_property<Point> vertex_normal =
-            mesh_.vertex_property<Point>("v:normal");
-    mesh_.update_face_normals();
-    mesh_.update_vertex_normals();
-    Mesh::Vertex_property<Color> v_color_valence =
-            mesh_.vertex_property<Color>("v:color_valence",
-                                         Color(1.0f, 1.0f, 1.0f));
-    Mesh::Vertex_property<Color> v_color_unicurvature =
-            mesh_.vertex_property<Color>("v:color_unicurvature",
-                                         Color(1.0f, 1.0f, 1.0f));
-    Mesh::Vertex_property<Color> v_color_curvature =
-            mesh_.vertex_property<Color>("v:color_curvature",
-                                         Color(1.0f, 1.0f, 1.0f));
-    Mesh::Vertex_property<Color> v_color_gaussian_curv =
-            mesh_.vertex_property<Color>("v:color_gaussian_curv",
-                                         Color(1.0f, 1.0f, 1.0f));
-
-    Mesh::Vertex_property<Scalar> vertex_valence =
-            mesh_.vertex_property<Scalar>("v:valence", 0.0f);
-    for (auto v: mesh_.vertices()) {
-        vertex_valence[v] = mesh_.valence(v);
-    }
-
-    Mesh::Vertex_property<Scalar> v_unicurvature =
-            mesh_.vertex_property<Scalar>("v:unicurvature", 0.0f);
-    Mesh::Vertex_property<Scalar> v_curvature =
-            mesh_.vertex_property<Scalar>("v:curvature", 0.0f);
-    Mesh::Vertex_property<Scalar> v_gauss_curvature =
-            mesh_.vertex_property<Scalar>("v:gauss_curvature", 0.0f);
-
-    calc_weights();
-    calc_uniform_mean_curvature();
-    calc_mean_curvature();
-    calc_gauss_curvature();
-    color_coding(vertex_valence, &mesh_, v_color_valence, 100 /* bound */);
-    color_coding(v_unicurvature, &mesh_, v_color_unicurvature);
-    color_coding(v_curvature, &mesh_, v_color_curvature);
-    color_coding(v_gauss_curvature, &mesh_, v_color_gaussian_curv);
-
-    // get the mesh attributes and upload them to the GPU
-    int j = 0;
-    unsigned int n_vertices(mesh_.n_vertices());
-
-    // Create big matrices to send the data to the GPU with the required
-    // format
-    color_valence_ = Eigen::MatrixXf(3, n_vertices);
-    color_unicurvature_ = Eigen::MatrixXf(3, n_vertices);
-    color_curvature_ = Eigen::MatrixXf(3, n_vertices);
-    color_gaussian_curv_ = Eigen::MatrixXf(3, n_vertices);
-    normals_ = Eigen::MatrixXf(3, n_vertices);
-    points_ = Eigen::MatrixXf(3, n_vertices);
-	selection_ = Eigen::MatrixXf(3, 1);
-    indices_ = MatrixXu(3, mesh_.n_faces());
-
-    for(auto f: mesh_.faces()) {
-        std::vector<float> vv(3);
-        int k = 0;
-        for (auto v: mesh_.vertices(f)) {
-            vv[k] = v.idx();
-            ++k;
-        }
-        indices_.col(j) << vv[0], vv[1], vv[2];
-        ++j;
+MeshProcessing::SelfIntersectionReport MeshProcessing::self_intersections() {
+    SURFACE_MESH_TRACE_ZONE("self_intersections");
+    if (self_intersections_valid_ &&
+        self_intersections_topology_revision_ == mesh_.topology_revision()) {
+        return self_intersections_;
     }
+    update_bvh();
+    std::vector<std::pair<int, int> > pairs;
+    bvh_.self_intersections(mesh_.points().data(), pairs);
+
+    auto crossing = mesh_.face_property<bool>(f_self_intersection_key, false);
+    auto values = mesh_.vertex_property<DisplayScalar>(v_self_intersection_key, 0.0f);
+    crossing.vector().assign(mesh_.faces_size(), false);
+    values.vector().assign(mesh_.vertices_size(), DisplayScalar(0.0f));
+    for (const std::pair<int, int>& pair: pairs) {
+        crossing[Mesh::Face(pair.first)] = true;
+        crossing[Mesh::Face(pair.second)] = true;
+    }
+    crossing.vector().for_each_set([&](const size_t f) {
+        for (auto v: mesh_.vertices(Mesh::Face(f))) values[v] = 1.0f;
+    });
+
+    self_intersections_.faces = int(crossing.vector().count());
+    self_intersections_.pairs = int(pairs.size());
+    self_intersections_topology_revision_ = mesh_.topology_revision();
+    self_intersections_valid_ = true;
+    return self_intersections_;
+}
 
-    j = 0;
-    for (auto v: mesh_.vertices()) {
-        points_.col(j) << mesh_.position(v).x,
-                          mesh_.position(v).y,
-                          mesh_.position(v).z;
-
-		/*selection_.col(j) << mesh_.position(v).x,
-							 mesh_.position(v).y,
-							 mesh_.position(v).z;*/
+void MeshProcessing::get_scalar_bounds(const SCALAR_TYPE type, std::vector<float>& values,
+                                       float& min_value, float& max_value) {
+    min_value = max_value = 0.0f;
+    if (values.empty()) return;
+    if (type == SCALAR_DEVIATION) {
+        max_value = *std::max_element(values.begin(), values.end());
+        return;
+    }
+    if (type == SCALAR_SELF_INTERSECTION) {
+        max_value = 1.0f;
+        return;
+    }
+    quantile_bounds(values, type == SCALAR_VALENCE ? 100 : 20, min_value, max_value);
+}
 
-        normals_.col(j) << vertex_normal[v].x,
-                           vertex_normal[v].y,
-                           vertex_normal[v].z;
+void MeshProcessing::update_curvatures() {
+    if (dirty_ & DIRTY_CURVATURES) {
+        CotanWeights weights;
+        calc_weights(weights);
+        calc_corner_angles(weights);
+        calc_vertex_properties(weights);
+        dirty_ &= ~DIRTY_CURVATURES;
+    } else if (local_dirty_ & DIRTY_CURVATURES) {
+        // the pass also brings the normals of the stale vertices up to date
+        calc_local_weights(stale_, local_weights_);
+        calc_corner_angles(local_weights_, &stale_);
+        calc_vertex_properties(local_weights_, &stale_);
+        local_dirty_ &= ~(DIRTY_CURVATURES | DIRTY_NORMALS);
+    }
+}
 
-        color_valence_.col(j) << v_color_valence[v].x,
-                                 v_color_valence[v].y,
-                                 v_color_valence[v].z;
+void MeshProcessing::compute_attributes(const bool principal) {
+    // the principal curvatures run the curvature pass first
+    if (principal) update_principal_curvatures();
+    else update_curvatures();
+}
 
-        color_unicurvature_.col(j) << v_color_unicurvature[v].x,
-                                      v_color_unicurvature[v].y,
-                                      v_color_unicurvature[v].z;
+void MeshProcessing::update_principal_curvatures() {
+    // the tensors read the normals of the curvature pass
+    update_curvatures();
+    if (dirty_ & DIRTY_PRINCIPAL_CURVATURES) {
+        calc_principal_curvatures();
+    } else if (local_dirty_ & DIRTY_PRINCIPAL_CURVATURES) {
+        calc_principal_curvatures(&stale_);
+    }
+    dirty_ &= ~DIRTY_PRINCIPAL_CURVATURES;
+    local_dirty_ &= ~DIRTY_PRINCIPAL_CURVATURES;
+}
 
-        color_curvature_.col(j) << v_color_curvature[v].x,
-                                   v_color_curvature[v].y,
-                                   v_color_curvature[v].z;
+ConstMatrix3XfMap MeshProcessing::get_principal_directions() {
+    update_principal_curvatures();
+    return as_const_eigen(mesh_.vertex_property<Point>(v_max_direction_key).vector());
+}
 
-        color_gaussian_curv_.col(j) << v_color_gaussian_curv[v].x,
-                                       v_color_gaussian_curv[v].y,
-                                       v_color_gaussian_curv[v].z;
-        ++j;
+ConstMatrix4Xu8Map MeshProcessing::update_color(const unsigned int flag,
+                                                const string& scalar_name,
+                                                const string& color_name,
+                                                const int bound) {
+    Mesh::Vertex_property<Color8> color_prop =
+            mesh_.vertex_property<Color8>(color_name, Color8(255, 255, 255, 255));
+    if ((dirty_ | local_dirty_) & flag) {
+        update_curvatures();
+        Mesh::Vertex_property<DisplayScalar> values =
+                mesh_.vertex_property<DisplayScalar>(scalar_name, 0.0f);
+        Scalar min_value, max_value;
+        color_bounds(values, bound, min_value, max_value);
+        // the colors of a local edit only change on the stale vertices,
+        // unless the bounds moved
+        auto range = color_ranges_.find(flag);
+        const bool local = !(dirty_ & flag) && range != color_ranges_.end() &&
+                           range->second == std::make_pair(min_value, max_value);
+        color_coding(values, &mesh_, color_prop, min_value, max_value, local ? &stale_ : nullptr);
+        color_ranges_[flag] = std::make_pair(min_value, max_value);
+        dirty_ &= ~flag;
+        local_dirty_ &= ~flag;
     }
+    return as_const_eigen(color_prop.vector());
 }
 
-void MeshProcessing::color_coding(Mesh::Vertex_property<Scalar> prop, Mesh *mesh,
-                  Mesh::Vertex_property<Color> color_prop, int bound) {
-    // Get the value array
-    std::vector<Scalar> values = prop.vector();
-
-    // discard upper and lower bound
-    unsigned int n = values.size()-1;
-    unsigned int i = n / bound;
-    std::sort(values.begin(), values.end());
-    Scalar min_value = values[i], max_value = values[n-1-i];
+void MeshProcessing::color_bounds(Mesh::Vertex_property<DisplayScalar> prop, int bound,
+                                  Scalar& min_value, Scalar& max_value) {
+    // a copy of the values, the selection reorders them
+    std::vector<Scalar> values;
+    if (as_floats(prop.vector(), values) != values.data()) {
+        values.assign(prop.vector().begin(), prop.vector().end());
+    }
+    quantile_bounds(values, bound, min_value, max_value);
+}
 
+void MeshProcessing::color_coding(Mesh::Vertex_property<DisplayScalar> prop, Mesh *mesh,
+                                  Mesh::Vertex_property<Color8> color_prop,
+                                  const Scalar min_value, const Scalar max_value,
+                                  const std::vector<int>* vertices) {
+    SURFACE_MESH_TRACE_ZONE("color coding");
     // map values to colors
-    for (auto v: mesh->vertices())
-    {
-        set_color(v, value_to_color(prop[v], min_value, max_value), color_prop);
+    const Property_vector<DisplayScalar>& scalars = prop.vector();
+    Property_vector<Color8>& colors = color_prop.vector();
+    const int n_vertices = vertices ? int(vertices->size()) : int(mesh->vertices_size());
+#pragma omp parallel for schedule(static)
+    for (int j = 0; j < n_vertices; ++j) {
+        const int k = vertices ? (*vertices)[j] : j;
+        if (mesh->is_deleted(Mesh::Vertex(k))) continue;
+        colors[k] = value_to_color(scalars[k], min_value, max_value);
     }
 }
 
-void MeshProcessing::set_color(Mesh::Vertex v, const Color& col,
-               Mesh::Vertex_property<Color> color_prop)
-{
-    color_prop[v] = col;
+Color8 MeshProcessing::value_to_color(Scalar value, Scalar min_value, Scalar max_value) {
+    // blue - cyan - green - yellow - red over four equal segments of
+    // [min_value, max_value], clamped outside; t is the position in segments.
+    // the viewer's vertex shader evaluates the same ramp
+    const Scalar range = max_value - min_value;
+    const Scalar t = range > 0 ? (value - min_value) * (4.0f / range)
+                               : (value < min_value ? -1.0f : (value > max_value ? 5.0f : 0.0f));
+    auto ramp = [](Scalar x) { return min(max(x, 0.0f), 1.0f); };
+    auto byte = [](Scalar x) { return (unsigned char) (x * 255.0f + 0.5f); };
+    return Color8(byte(ramp(t - 2.0f)),
+                  byte(ramp(t) - ramp(t - 3.0f)),
+                  byte(1.0f - ramp(t - 1.0f)), 255);
 }
 
-Color MeshProcessing::value_to_color(Scalar value, Scalar min_value, Scalar max_value) {
-    Scalar v0, v1, v2, v3, v4;
-    v0 = min_value + 0.0/4.0 * (max_value - min_value);
-    v1 = min_value + 1.0/4.0 * (max_value - min_value);
-    v2 = min_value + 2.0/4.0 * (max_value - min_value);
-    v3 = min_value + 3.0/4.0 * (max_value - min_value);
-    v4 = min_value + 4.0/4.0 * (max_value - min_value);
-
-    Color col(1.0f, 1.0f, 1.0f);
-
-    if (value < v0) {
-        col = Color(0, 0, 1);
-    } else if (value > v4) {
-        col = Color(1, 0, 0);
-    } else if (value <= v2) {
-        if (value <= v1) { // [v0, v1]
-            Scalar u =  (value - v0) / (v1 - v0);
-            col = Color(0, u, 1);
-        } else { // ]v1, v2]
-            Scalar u = (value - v1) / (v2 - v1);
-            col = Color(0, 1, 1-u);
-        }
-    } else {
-        if (value <= v3) { // ]v2, v3]
-            Scalar u = (value - v2) / (v3 - v2);
-            col = Color(u, 1, 0);
-        } else { // ]v3, v4]
-            Scalar u = (value - v3) / (v4 - v3);
-            col = Color(1, 1-u, 0);
-        }
+void MeshProcessing::update_bvh() {
+    // the BVH is built for the current connectivity and refit after smoothing
+    if (bvh_.empty() || bvh_topology_revision_ != mesh_.topology_revision()) {
+        bvh_.build(mesh_);
+        bvh_topology_revision_ = mesh_.topology_revision();
+        bvh_geometry_revision_ = geometry_revision_;
+    } else if (bvh_geometry_revision_ != geometry_revision_) {
+        bvh_.refit(mesh_);
+        bvh_geometry_revision_ = geometry_revision_;
     }
-    return col;
 }
 
 Eigen::Vector3f MeshProcessing::get_closest_vertex(const Eigen::Vector3f & origin, const Eigen::Vector3f & direction) {
-	float min_distance = std::numeric_limits<float>::max();
-	Eigen::Vector3f closest_vertex;
-	for (auto v : mesh_.vertices()) {
-		Eigen::Vector3f point;
-		point << mesh_.position(v).x, mesh_.position(v).y, mesh_.position(v).z;
-		float projection_length = (point - origin).dot(direction);
-		Eigen::Vector3f difference = point - (origin + projection_length * direction);
-		float distance = difference.norm();
-		if (distance < min_distance) {
-			min_distance = distance;
-			closest_vertex = point;
+	update_bvh();
+	const Point o = to_point(origin);
+	const Point d = to_point(direction);
+	Mesh::Face face;
+	Scalar t;
+	Point closest_vertex;
+	if (bvh_.intersect(mesh_, o, d, face, t)) {
+		// snap the first hit to the nearest vertex of its face
+		const Point hit = o + t * d;
+		float min_distance = std::numeric_limits<float>::max();
+		for (auto v : mesh_.vertices(face)) {
+			float dist = sqrnorm(mesh_.position(v) - hit);
+			if (dist < min_distance) {
+				min_distance = dist;
+				closest_vertex = mesh_.position(v);
+			}
+		}
+	} else {
+		// the ray misses the mesh, take the vertex closest to the ray
+		float min_distance = std::numeric_limits<float>::max();
+		for (auto v : mesh_.compact_vertices()) {
+			const Point& point = mesh_.position(v);
+			const Point difference = point - (o + dot(point - o, d) * d);
+			float dist = sqrnorm(difference);
+			if (dist < min_distance) {
+				min_distance = dist;
+				closest_vertex = point;
+			}
+		}
+	}
+	return as_eigen(closest_vertex);
+}
+
+Eigen::Vector3f MeshProcessing::get_closest_vertex_of_triangle(const int triangle, const Eigen::Vector3f & point) {
+	const MatrixXu& indices = *get_indices();
+	const Point p = to_point(point);
+	Point closest_vertex = mesh_.position(Mesh::Vertex(indices(0, triangle)));
+	for (int k = 1; k < 3; ++k) {
+		const Point& q = mesh_.position(Mesh::Vertex(indices(k, triangle)));
+		if (sqrnorm(q - p) < sqrnorm(closest_vertex - p)) {
+			closest_vertex = q;
 		}
 	}
-	return closest_vertex;
+	return as_eigen(closest_vertex);
 }
 
 MeshProcessing::~MeshProcessing() {}
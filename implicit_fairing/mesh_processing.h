@@ -3,7 +3,32 @@
 #define MESH_PROCESSING_H
 
 #include <surface_mesh/Surface_mesh.h>
+#include <surface_mesh/IO.h>
+#include <surface_mesh/Reorder.h>
+#include <surface_mesh/Subdivision.h>
 #include <Eigen/Sparse>
+#include <Eigen/Cholesky>
+#include <algorithm>
+#include <map>
+#include "components.h"
+#include "incomplete_cholesky.h"
+#include "multigrid.h"
+#include "schwarz.h"
+#include "spectral_basis.h"
+#include "symbolic_analysis.h"
+#include "solver_backend.h"
+#include "async_job.h"
+#include "bvh.h"
+#include "draw_order.h"
+#include "lod.h"
+#include "mesh_hash.h"
+#include "one_ring.h"
+#include "laplace_operator.h"
+#include "eigen_interop.h"
+#include "soa_geometry.h"
+#include "position_history.h"
+#include "decimation.h"
+#include "remeshing.h"
 
 typedef surface_mesh::Surface_mesh Mesh;
 typedef Eigen::Matrix<uint32_t, Eigen::Dynamic, Eigen::Dynamic> MatrixXu;
@@ -12,72 +37,965 @@ namespace mesh_processing {
 
 using std::string;
 
+// the derived per-vertex scalars for display, valences and curvatures:
+// binary16 with GP_HALF_SCALARS, half the memory and about three
+// significant digits; the weights and all the solvers read stay in float
+// and double
+#ifdef MESH_PROCESSING_HALF_SCALARS
+typedef surface_mesh::Half DisplayScalar;
+#else
+typedef surface_mesh::Scalar DisplayScalar;
+#endif
+
+// Concurrency: the const methods only read the mesh and the state derived
+// from it, any number of them may run at the same time as each other and
+// as one non-const call. The operators that move the vertices keep their
+// scratch data in per-call workspaces and in the buffers of their own
+// solves, never in mesh properties, so while one of them runs another thread
+// may call the attribute getters get_points(), get_normals(), get_scalars()
+// and the colorings; these see the positions of before, during or after
+// the operator. Two operators, two threads with getters, and loading,
+// set_mesh(), reorder_mesh(), compact(), undo() and redo() with anything
+// else need to be serialized by the caller.
 class MeshProcessing {
 
 public:
-    MeshProcessing(const string& filename);
+    // linear solver backend for the symmetric systems; DIRECT_LDLT_FLOAT
+    // factorizes in single precision and refines the solution in double,
+    // CG_SCHWARZ preconditions with overlapping subdomain solves,
+    // CG_MATRIX_FREE is CG_JACOBI with the products of the Laplacian taken
+    // from the one-rings and float edge weights instead of an assembled
+    // matrix, for the systems of solve_laplace() and so implicit_smoothing;
+    // the others run CG_JACOBI with it. DIRECT_CUSOLVER and CG_AMGX solve on
+    // a CUDA GPU, the sparse Cholesky of cuSOLVER for moderate sizes and CG
+    // with the AMG of AmgX for the largest meshes. CHOLMOD, Pardiso and the
+    // GPU solvers are only there if CMake found them, see solver_available().
+    // The direct CPU solvers read one triangle, their systems hold the lower
+    // one only; DIRECT_LDLT_FLOAT is the one with float values
+    enum SOLVER_TYPE : int { DIRECT_LDLT = 0, CG_JACOBI = 1, CG_INCOMPLETE_CHOLESKY = 2,
+                             DIRECT_LDLT_FLOAT = 3, DIRECT_CHOLMOD = 4, DIRECT_PARDISO = 5,
+                             CG_MULTIGRID = 6, CG_SCHWARZ = 7, CG_MATRIX_FREE = 8,
+                             DIRECT_CUSOLVER = 9, CG_AMGX = 10 };
+    static bool solver_available(const SOLVER_TYPE type);
+
+    // read_attributes are the surface_mesh::Read_attributes the file is
+    // read with, see set_read_attributes()
+    MeshProcessing(const string& filename,
+                   const unsigned int read_attributes = surface_mesh::READ_ALL);
+    // copies the connectivity and positions of mesh
+    MeshProcessing(const Mesh& mesh);
+    // no mesh yet, see read_mesh()
+    MeshProcessing();
     ~MeshProcessing();
 
     const surface_mesh::Point get_mesh_center() { return mesh_center_; }
-    const float get_dist_max() { return dist_max_; }
-    const Eigen::MatrixXf* get_points() { return &points_; }
+    // largest distance of a vertex from get_mesh_center(), one pass over the
+    // vertices on the first call after a load
+    float get_dist_max();
+    // axis aligned bounds of the vertices
+    void get_bounding_box(surface_mesh::Point& min, surface_mesh::Point& max) const {
+        min = bbox_min_;
+        max = bbox_max_;
+    }
+    // attributes are recomputed lazily, only when the geometry changed since
+    // the last call of the same getter; the returned views point into the
+    // mesh properties and stay valid until the mesh is reloaded
+    ConstMatrix3XfMap get_points();
+    // the positions at load time, indexed like get_points(); none if the
+    // mesh has no vertices
+    ConstMatrix3XfMap get_points_init();
+    // the mesh itself, e.g. for views of its properties; positions written
+    // through it need compute_mesh_properties() afterwards like set_points()
+    Mesh& get_mesh() { return mesh_; }
 	Eigen::Vector3f get_closest_vertex(const Eigen::Vector3f & origin, const Eigen::Vector3f & direction);
+	// vertex of column triangle of get_indices() nearest to point
+	Eigen::Vector3f get_closest_vertex_of_triangle(const int triangle, const Eigen::Vector3f & point);
 	const Eigen::MatrixXf* get_selection() { return &selection_; }
 	void set_selection(const Eigen::Vector3f & point) { selection_.col(0) = point; }
-    const MatrixXu* get_indices() { return &indices_; }
-    const Eigen::MatrixXf* get_normals() { return &normals_; }
-    const Eigen::MatrixXf* get_colors_valence() { return &color_valence_; }
-    const Eigen::MatrixXf* get_colors_unicurvature() { return &color_unicurvature_; }
-    const Eigen::MatrixXf* get_colors_gaussian_curv() { return &color_gaussian_curv_; }
-    const Eigen::MatrixXf* get_color_curvature() { return &color_curvature_; }
+    // 3 vertex indices per triangle, rebuilt per connectivity in the order of
+    // optimize_draw_order(), so column j is not face j
+    const MatrixXu* get_indices();
+    // levels of detail of the triangles, built on first use per
+    // connectivity; its cluster bounds follow the geometry
+    const LodHierarchy& get_lod();
+    // bounding spheres of runs of get_indices() for frustum culling, built
+    // per connectivity and refit per geometry revision
+    const DrawClusters& get_draw_clusters();
+    ConstMatrix3XfMap get_normals();
+    // unit tangent direction of the larger principal curvature, that of the
+    // smaller one is its cross product with the normal; 0 on the boundary
+    ConstMatrix3XfMap get_principal_directions();
+    // the colorings as 8 bit RGBA per vertex
+    ConstMatrix4Xu8Map get_colors_valence();
+    ConstMatrix4Xu8Map get_colors_unicurvature();
+    ConstMatrix4Xu8Map get_colors_gaussian_curv();
+    ConstMatrix4Xu8Map get_color_curvature();
+    // the scalar behind one of the colorings above and the bounds that are
+    // mapped to blue and red, for mapping the colors on the GPU
+    enum SCALAR_TYPE : int { SCALAR_VALENCE = 0, SCALAR_UNICURVATURE = 1,
+                             SCALAR_CURVATURE = 2, SCALAR_GAUSS = 3,
+                             SCALAR_MAX_CURVATURE = 4, SCALAR_MIN_CURVATURE = 5,
+                             SCALAR_DEVIATION = 6, SCALAR_SELF_INTERSECTION = 7 };
+    // the view is valid until the next call
+    ConstRowXfMap get_scalars(const SCALAR_TYPE type, float& min_value, float& max_value);
+    // the bounds get_scalars() maps values of type with, for values that
+    // were computed elsewhere, e.g. on the GPU; reorders values
+    static void get_scalar_bounds(const SCALAR_TYPE type, std::vector<float>& values,
+                                  float& min_value, float& max_value);
     const unsigned int get_number_of_face() { return mesh_.n_faces(); }
+    const unsigned int get_topology_revision() { return mesh_.topology_revision(); }
+    // incremented by compute_mesh_properties, i.e. whenever the geometry changed
+    const unsigned int get_geometry_revision() { return geometry_revision_; }
+    // topology and geometry hash of the mesh, computed again only after the
+    // connectivity or the positions changed; unlike the revisions they are
+    // the same for equal meshes in other MeshProcessings or later runs
+    const MeshHash& get_mesh_hash();
+    // the vertices [first, first + count) outside of which positions,
+    // normals and scalars are the same as in geometry revision since; false
+    // if they may have changed anywhere, e.g. after a change of most vertices
+    bool get_changed_vertices(const int since, int& first, int& count) const;
 	const unsigned int get_number_of_vertices() { return mesh_.n_vertices(); }
 
     void load_mesh(const string& filename);
+    // like load_mesh, but false instead of exiting if filename cannot be
+    // read; polygons are triangulated, .pm files are progressive meshes, see
+    // read_progressive_mesh(). Reports 0.5 to the progress once the
+    // file is read and the center and bounds are valid, the attributes are
+    // computed after that
+    bool read_mesh(const string& filename);
+    // with the cache enabled, read_mesh() takes the mesh, its normals and
+    // curvatures from mesh_cache_path(filename) while that file is newer
+    // than filename, skipping the parse and the attribute passes
+    void set_mesh_cache(const bool enabled) { mesh_cache_ = enabled; }
+    // the optional attributes read_mesh() loads, surface_mesh::READ_GEOMETRY
+    // skips texture coordinates, PLY normals and colors that the operations
+    // do not need; they are then not written either
+    void set_read_attributes(const unsigned int attributes) { read_attributes_ = attributes; }
+    // true if the last read_mesh() came from the cache
+    bool is_from_cache() const { return from_cache_; }
+    // writes the mesh with up to date normals and curvatures as a poly
+    // file to mesh_cache_path(filename), replacing it atomically
+    bool save_mesh_cache(const string& filename);
+    static string mesh_cache_path(const string& filename) { return filename + ".cache"; }
+    // the state of a working session: the mesh with its current and initial
+    // positions, normals and curvatures as a poly file, and the eigenbasis
+    // in session_basis_path(filename) if there is one. The factorizations
+    // are not stored, the first solve after load_session() rebuilds them
+    bool save_session(const string& filename);
+    // replaces the mesh like read_mesh(), false if filename is no session
+    bool load_session(const string& filename);
+    static string session_basis_path(const string& filename) { return filename + ".basis"; }
+    // with the symbolic cache enabled, the LDLT solvers record the ordering
+    // and elimination tree of every pattern they analyze, and take them from
+    // the cache instead of analyzing a pattern that is already there; the
+    // records are kept by the hash of the pattern, across mesh changes
+    void set_symbolic_cache(const bool enabled) { symbolic_cache_enabled_ = enabled; }
+    // the records of symbolic_cache_path(filename), false if there is no
+    // such file or it is damaged
+    bool load_symbolic_cache(const string& filename);
+    // writes the records if the last load missed any, true if nothing
+    // needed to be written
+    bool save_symbolic_cache(const string& filename);
+    static string symbolic_cache_path(const string& filename) { return filename + ".symbolic"; }
+    // what surface_mesh::Surface_mesh::check_faces() found in the faces of
+    // the last read_mesh(), empty after set_mesh()
+    const surface_mesh::Face_report& get_face_report() const { return face_report_; }
+    void set_mesh(const Mesh& mesh);
+    // writes the current positions and normals, the format follows the
+    // extension; .off files are written as OFF BINARY if binary_off is set
+    bool save_mesh(const string& filename, const bool binary_off = false);
+    // the positions, valences and curvatures of the vertices and, if the
+    // mesh has its positions at load time, their deviations as the columns
+    // of an Arrow IPC file, see surface_mesh::write_arrow()
+    bool save_vertex_columns(const string& filename);
+    // renumber vertices, edges and faces for memory locality, see
+    // surface_mesh::reorder(); the original positions are renumbered alike
+    void reorder_mesh(const surface_mesh::Reorder_method method);
+    // merges the vertices closer than tolerance, see
+    // surface_mesh::weld_vertices(); the welded mesh replaces the current
+    // one like set_mesh(), false if no vertex was merged
+    bool weld_vertices(const float tolerance);
+    // levels of Loop or sqrt(3) subdivision, see surface_mesh::subdivide();
+    // the refined mesh replaces the current one like set_mesh(), false if
+    // it is no triangle mesh
+    bool subdivide(const surface_mesh::Subdivision_method method, const unsigned int levels = 1);
+    // quadric error edge collapses, see mesh_processing::decimate(); the
+    // simplified mesh replaces the current one like set_mesh(), false if
+    // nothing was collapsed
+    bool decimate(const DecimationOptions& options);
+    // isotropic remeshing, see mesh_processing::remesh(); the result
+    // replaces the current mesh like set_mesh(), false if nothing was done
+    bool remesh(const RemeshingOptions& options);
+    // drops the cached attributes, acceleration structures and
+    // factorizations and shrinks the property arrays to their size; the
+    // views returned by the getters are invalidated, the eigenbasis is kept
+    void compact();
+    // marks the attributes dirty and records the positions for undo, call
+    // after changing the mesh; if only a few vertices moved, the attributes
+    // are recomputed on their two-ring only
     void compute_mesh_properties();
+    // brings the curvatures and, unless principal is false, the principal
+    // curvatures up to date, which the getters otherwise compute on first
+    // use; lets a caller pay for them ahead of time, e.g. on a worker thread
+    // after the first frame
+    void compute_attributes(const bool principal = true);
+    // step through the recorded positions, false if there is no such step
+    bool undo();
+    bool redo();
+    bool can_undo() const { return history_.can_undo(); }
+    bool can_redo() const { return history_.can_redo(); }
+    // memory for the undo steps in bytes, the oldest steps are dropped first
+    void set_history_budget(const size_t bytes) { history_.set_budget(bytes); }
 
+    // p + coefficient * (p - smooth(p)) after iterations smoothing steps,
+    // the extrapolation is fused with the last step
     void uniform_laplacian_enhance_feature(const unsigned int iterations,
-                                           const unsigned int coefficient);
+                                           const float coefficient);
     void laplace_beltrami_enhance_feature(const unsigned int iterations,
-                                          const unsigned int coefficient);
+                                          const float coefficient);
     void uniform_smooth(const unsigned int iterations);
+    // uniform_smooth(iterations) for hundreds of iterations at the cost of
+    // a few dozen: the coarse levels of the multigrid hierarchy are smoothed
+    // first, an iteration there moves the vertices about as far as two on
+    // the level below. The displacement of every level is carried to the
+    // next finer one, which then runs 20 iterations of its own, so the low
+    // frequencies go as with the full count and the finest detail as after
+    // a few dozen iterations. Fewer than 60 iterations run uniform_smooth().
+    void multiresolution_smooth(const unsigned int iterations);
+    // iterations of Taubin's lambda|mu smoothing with the uniform
+    // Laplacian, lambda 0.5 and mu -0.53: smooths like uniform_smooth()
+    // without shrinking the mesh, at the cost of two explicit steps per
+    // iteration and no solve; stops early like the other smoothing
+    // operators
+    void taubin_smooth(const unsigned int iterations);
+    // the one-rings smooth() and uniform_smooth() iterate over, with the cotan
+    // weights of the current positions in the weight slots if cotan and
+    // weights of 1 otherwise, for running the iterations elsewhere
+    const OneRingAdjacency& smoothing_stencil(const bool cotan);
+    // overwrites the positions, call compute_mesh_properties() afterwards
+    void set_points(const Eigen::Matrix3Xf& points);
+    // the next shape of a series with the connectivity of this one, e.g. a
+    // registered scan: the positions, the initial positions and the undo
+    // history start over from points, the eigenbasis, pins and region are
+    // dropped. What only depends on the connectivity, the one-rings, SoA
+    // stencils and the symbolic factorizations, is kept; false if the
+    // vertex count differs
+    bool replace_positions(const std::vector<surface_mesh::Point>& points);
     void implicit_smoothing(const double timestep = 1e-4);//1e-5);
-    void minimal_surface();
+    // implicit_smoothing() for a total diffusion time in steps of
+    // total_time / 2^k, at most max_timestep: a step whose RMS displacement
+    // over get_dist_max(), or on closed meshes whose relative volume change,
+    // exceeds tolerance is undone and taken again at half the size, one far
+    // below it lets the next step double while the steps still add up to
+    // total_time and enough of them remain to pay for the new factors. The
+    // cotan weights and mass of the starting positions are kept for the
+    // whole run, so a repeated step size reuses its factors.
+    // get_smoothing_iterations() returns the accepted steps; false if a
+    // solve failed or was cancelled.
+    bool adaptive_implicit_smoothing(const double total_time, const double tolerance = 1e-3,
+                                     const double max_timestep = 1e-4);
+    // the cotan or uniform Laplacian of the current positions with its
+    // lumped mass, assembled on first use and kept until the positions, the
+    // connectivity or the cotan bound change; the solvers and the eigenbasis
+    // all use this one. The reference stays valid, its contents change with
+    // the next call after such a change. Without assemble only the edge
+    // weights and the mass are guaranteed, the matrix may be empty.
+    const LaplaceOperator& laplace_operator(const bool cotan = true, const bool assemble = true);
+    // (mass_scale * M + laplace_scale * L) X = B with the cotan operator, the
+    // selected solver and the pins of set_constraint(), X being the warm
+    // start of the CG backends; the factors are kept while the operator and
+    // the scales stay the same, e.g. for M + dt L when several timesteps are
+    // tried from one state with undo in between. False if the solve failed
+    // or was cancelled.
+    bool solve_laplace(const double mass_scale, const double laplace_scale,
+                       const Eigen::MatrixXd& B, Eigen::MatrixXd& X);
+    // linear solver for implicit_smoothing and minimal_surface, tolerance
+    // and max_iterations apply to the CG backends and the refinement steps
+    // of DIRECT_LDLT_FLOAT; an unavailable type falls back to DIRECT_LDLT
+    void set_solver(const SOLVER_TYPE type, const double tolerance = 1e-8,
+                    const int max_iterations = 1000);
+    // fill-reducing ordering of the DIRECT_LDLT and DIRECT_LDLT_FLOAT
+    // factors: AMD, COLAMD, METIS nested dissection or the Morton curve of
+    // the vertex positions. ORDERING_AUTO analyzes each pattern with all of
+    // them and keeps the one with the fewest entries in L, which pays off on
+    // long, thin meshes; the symbolic cache keeps the winner with the
+    // analysis. METIS is only there if CMake found it, see
+    // ordering_available(); an unavailable ordering falls back to AMD, as
+    // do the systems that are split into components
+    enum FILL_ORDERING : int { ORDERING_AMD = 0, ORDERING_COLAMD = 1, ORDERING_METIS = 2,
+                               ORDERING_MORTON = 3, ORDERING_AUTO = 4 };
+    static bool ordering_available(const FILL_ORDERING ordering);
+    void set_fill_ordering(const FILL_ORDERING ordering);
+    FILL_ORDERING fill_ordering() const { return fill_ordering_; }
+    // reduce_boundary solves the SPD interior system with the selected solver,
+    // otherwise boundary rows are kept as identity rows and solved with SparseLU.
+    // keep_weights reuses the cotan weights and the factorization of the
+    // previous reduced solve with the same connectivity, so that only the
+    // boundary positions enter the new solve, e.g. while dragging a boundary
+    // curve; without it they are reused only if no vertex moved
+    void minimal_surface(const bool reduce_boundary = true, const bool keep_weights = false);
+    // disk parameterization for texturing: the boundary loop goes to the
+    // circle inscribed in [0, 1]^2 by arc length, the interior vertices to
+    // the harmonic map, which solves the reduced system of minimal_surface
+    // with the circle as boundary values. The weights and factors are
+    // shared with minimal_surface, so after one with the same positions or
+    // keep_weights the map costs one back-substitution. The result goes to
+    // v:texcoord, which the OFF and PLY writers export; false unless the
+    // mesh has a single boundary loop or if the solve failed
+    bool harmonic_parameterization(const bool keep_weights = false);
+    // moves the boundary vertex v to p, where minimal_surface keeps it;
+    // false if v is not a boundary vertex
+    bool set_boundary_position(const Mesh::Vertex v, const surface_mesh::Point& p);
+    // pins of implicit_smoothing and the reduced minimal_surface: the solves
+    // keep vertex v at p, e.g. the picked vertex while it is dragged. The
+    // Schur complement of the pins is cached with the factorization, a new
+    // pin costs one solve with the cached factors, moving pins O(n) each
+    void set_constraint(const Mesh::Vertex v, const surface_mesh::Point& p);
+    bool remove_constraint(const Mesh::Vertex v);
+    void clear_constraints();
+    int get_number_of_constraints() const { return int(constraint_vertices_.size()); }
+    // vertex nearest to the selection
+    Mesh::Vertex get_selected_vertex();
+    // geodesic distance of every vertex from the nearest of sources by the
+    // heat method: heat diffused from the sources for timestep_scale times
+    // the squared mean edge length, (M + t L) u = delta, and the distance
+    // whose gradient best fits the normalized -grad u, (eps M + L) phi =
+    // div X with a tiny eps for the null space. Both systems keep their
+    // factors like solve_laplace() while the positions stay the same, so
+    // queries from new sources only cost the back-substitutions; the CG
+    // solver types are not accurate enough and use DIRECT_LDLT. The
+    // minimum is shifted to 0; on components without a source the values
+    // mean nothing. False if a solve failed or there is no source.
+    bool geodesic_distances(const std::vector<Mesh::Vertex>& sources,
+                            std::vector<float>& distances, const double timestep_scale = 1.0);
+    // geodesic_distances() from get_selected_vertex()
+    bool geodesic_distances(std::vector<float>& distances);
+    // region of interest of the region_* operators: they only move its
+    // vertices and keep the ring around it fixed, so their cost scales with
+    // the region instead of the mesh; kept until the connectivity changes
+    void set_region(const std::vector<Mesh::Vertex>& vertices);
+    // the vertices within distance radius of center along the edges
+    void set_region_ball(const Mesh::Vertex center, const float radius);
+    void clear_region();
+    int get_region_size() const { return int(region_.vertices.size()); }
+    // the vertex selection of the brush and the lasso, the bool vertex
+    // property v:selected that follows the vertices through edits. The
+    // queries project the vertices with mvp, model to clip space, into a
+    // viewport of size pixels with y down like the mouse; with visible_only
+    // the vertices hidden from eye by other triangles are left out, tested
+    // as one batch of BVH rays for all the vertices under the brush or
+    // lasso. They return the number of vertices whose selection changed.
+    enum SELECTION_MODE { SELECT_REPLACE, SELECT_ADD, SELECT_REMOVE };
+    struct SelectionView {
+        Eigen::Matrix4f mvp;
+        Eigen::Vector2f viewport;
+        Eigen::Vector3f eye;  // in model coordinates
+        bool visible_only = true;
+    };
+    int select_brush(const SelectionView& view, const Eigen::Vector2f& center,
+                     const float radius, const SELECTION_MODE mode);
+    // the vertices inside the closed polygon, by the even-odd rule
+    int select_lasso(const SelectionView& view, const std::vector<Eigen::Vector2f>& polygon,
+                     const SELECTION_MODE mode);
+    void clear_vertex_selection();
+    int get_vertex_selection_size() const;
+    void get_selected_vertices(std::vector<Mesh::Vertex>& vertices) const;
+    // counts the changes of the vertex selection
+    unsigned int get_selection_revision() const { return selection_revision_; }
+    // the vertices [first, first + count) outside of which the selection is
+    // the same as in revision since; false if it may differ anywhere, e.g.
+    // after the connectivity changed
+    bool get_selection_changes(const unsigned int since, int& first, int& count) const;
+    // mask[i] = 1 if vertex first + i is selected
+    void get_selection_mask(const int first, const int count, std::vector<unsigned char>& mask) const;
+    // set_region() of the selected vertices
+    void set_region_to_selection();
+    // implicit_smoothing and the reduced minimal_surface on the region, the
+    // positions of the ring are the boundary values; pins inside the region
+    // are kept
+    void region_implicit_smoothing(const double timestep = 1e-4);
+    void region_minimal_surface();
     void smooth(const unsigned int iterations);
-    void calc_mean_curvature();
+    // smooth() that keeps sharp edges: the feature edges of the positions
+    // before the first iteration are detected once, the vertices on them
+    // stay fixed while the surface between them is smoothed
+    void feature_preserving_smooth(const unsigned int iterations,
+                                   const float feature_angle = 30.0f);
+    // e:feature 1 for the edges whose dihedral angle exceeds feature_angle
+    // degrees, 0 for the others
+    void detect_features(const float feature_angle);
+    // first k eigenpairs of the cotan Laplacian at the current positions,
+    // the basis of the spectral operators below; kept until the
+    // connectivity changes, false if the factorization failed
+    bool compute_eigenbasis(const unsigned int k);
+    // cache the basis next to the mesh; load fails if the file does not
+    // match the vertex count
+    bool save_eigenbasis(const string& filename) const;
+    bool load_eigenbasis(const string& filename);
+    // number of cached eigenpairs, 0 after a connectivity change
+    int get_eigenbasis_size();
+    // positions projected onto the first components eigenvectors, O(nk)
+    // per call; needs compute_eigenbasis() or load_eigenbasis()
+    void spectral_smoothing(const unsigned int components);
+    // amplifies what spectral_smoothing removes, like enhance_feature
+    void spectral_enhance_feature(const unsigned int components,
+                                  const float coefficient);
+    // cotan weights of smooth() and laplace_beltrami_enhance_feature are
+    // recomputed every interval iterations and frozen in between, the
+    // default 1 is the exact curvature flow
+    void set_weight_update_interval(const unsigned int interval) {
+        weight_update_interval_ = std::max(interval, 1u);
+    }
+    unsigned int get_weight_update_interval() const { return weight_update_interval_; }
+    // the smoothing and enhance_feature operators stop before their
+    // iteration count once the RMS displacement of an iteration is below
+    // tolerance times the one of the first iteration, 0 runs all iterations
+    void set_smoothing_tolerance(const float tolerance) { smoothing_tolerance_ = tolerance; }
+    float get_smoothing_tolerance() const { return smoothing_tolerance_; }
+    // Chebyshev acceleration of uniform_smooth() after a few plain
+    // iterations: converges in fewer iterations where the smoothing has a
+    // fixed point, e.g. with a fixed boundary, and shrinks closed meshes
+    // faster. The cotan weights change with the positions, which the
+    // semi-iteration does not allow for, so smooth() is not accelerated.
+    void set_chebyshev_smoothing(const bool enabled) { chebyshev_smoothing_ = enabled; }
+    bool get_chebyshev_smoothing() const { return chebyshev_smoothing_; }
+    // uniform_smooth() and smooth() update the positions in place, one
+    // color of a vertex coloring after the other, and move every vertex
+    // all the way to the mean of its neighbors, see
+    // OneRingAdjacency::gauss_seidel_step(): an iteration takes the low
+    // frequencies down about as far as four of the damped Jacobi
+    // iterations and needs no scratch copy of the positions. Takes the
+    // place of the Chebyshev acceleration; the enhancements stay Jacobi
+    // steps.
+    void set_gauss_seidel_smoothing(const bool enabled) { gauss_seidel_smoothing_ = enabled; }
+    bool get_gauss_seidel_smoothing() const { return gauss_seidel_smoothing_; }
+    // implicit_smoothing(), adaptive_implicit_smoothing() and the explicit
+    // smoothing operators, but not enhance_feature and taubin_smooth(),
+    // which keeps the volume by itself, scale their result about
+    // get_mesh_center() to the signed volume of the positions before, as
+    // seen from the center; the scale is applied while the result is copied
+    // back, it costs one reduction over the faces before and after
+    void set_volume_preservation(const bool enabled) { volume_preservation_ = enabled; }
+    bool get_volume_preservation() const { return volume_preservation_; }
+    // every corner cotangent of the weights and the solves is clamped to
+    // [-max_cotan, max_cotan], which keeps degenerate triangles from putting
+    // infinities into the matrices; infinity disables the clamping except
+    // for the 0 / 0 of coincident vertices
+    void set_max_cotan(const float max_cotan);
+    float get_max_cotan() const { return max_cotan_; }
+    // iterations the last smoothing or enhance_feature operator ran
+    unsigned int get_smoothing_iterations() const { return smoothing_iterations_; }
+    // the weight kernels run over a structure-of-arrays copy of the
+    // positions, false selects the per-element scalar loops
+    void set_soa_kernels(const bool enabled) {
+        use_soa_kernels_ = enabled;
+        update_soa();
+    }
+    // the one-rings of the cotan smoothers and of the matrix-free solver
+    // keep every neighbor next to the weight of its edge, see
+    // OneRingAdjacency::set_interleaved(), at 8 more bytes per halfedge;
+    // off by default, the separate arrays stream as well on the meshes
+    // measured and are cheaper to fill
+    void set_interleaved_one_rings(const bool enabled) {
+        interleaved_one_rings_ = enabled;
+        one_ring_.set_interleaved(enabled);
+    }
+    // bytes held by the mesh and the state derived from it
+    struct MemoryReport {
+        Mesh::Memory_report mesh;
+        size_t mirrors = 0;       // Eigen copies: index buffer, selection
+        size_t points_init = 0;   // positions at load time
+        size_t history = 0;       // undo steps and their current state
+        size_t acceleration = 0;  // BVH, one-ring, SoA copies, eigenbasis, LOD
+        size_t solver = 0;        // factorizations kept between calls
+        size_t workspace = 0;     // matrix, rhs and solution buffers, cached L
+        // largest working set of a linear solve: matrix, rhs, solution and
+        // factorization, since load or reset_peak_memory()
+        size_t peak_solver = 0;
+        size_t total() const {
+            return mesh.reserved() + mirrors + points_init + history + acceleration + solver +
+                   workspace;
+        }
+    };
+    MemoryReport memory_report() const;
+    void reset_peak_memory() { peak_solver_memory_ = 0; }
+
+    // distances between the current surface and the original one, that of
+    // the positions at load time on the same connectivity: forward from the
+    // current vertices to the original surface, backward from the original
+    // vertices to the current surface, and their maxima and means
+    struct DeviationReport {
+        double forward_max = 0.0;
+        double forward_mean = 0.0;
+        double backward_max = 0.0;
+        double backward_mean = 0.0;
+        // the symmetric Hausdorff distance, estimated at the vertices
+        double hausdorff() const { return std::max(forward_max, backward_max); }
+    };
+    // the one-sided distances use the BVH of the picking refit to either
+    // positions, every vertex starting from the distance to its other
+    // position; symmetric adds the backward direction. The deviation of
+    // every vertex, the larger of both directions if symmetric, is kept as
+    // the scalar SCALAR_DEVIATION
+    DeviationReport deviation(const bool symmetric = true);
+
+    // faces that cross other faces of the mesh, which a large
+    // implicit_smoothing() timestep or enhance_feature coefficient can
+    // cause: the crossing pairs of triangles in the BVH of the picking,
+    // see TriangleBVH::self_intersections(). The faces are marked in the
+    // bool face property f:self_intersection, their vertices are 1 and all
+    // others 0 in the scalar SCALAR_SELF_INTERSECTION. Computed again only
+    // after the geometry or the connectivity changed, so it may be called
+    // after every operation.
+    struct SelfIntersectionReport {
+        int faces = 0;  // faces crossing at least one other
+        int pairs = 0;  // crossing pairs of faces
+    };
+    SelfIntersectionReport self_intersections();
+
+    // long-running operations report to progress and stop early once it is
+    // cancelled or its time budget ran out, nullptr disables reporting. The
+    // smoothers check every iteration, the CG solvers every iteration of
+    // their solve, the direct solvers before and after the factorization,
+    // which itself runs to its end. A stopped explicit smoother, decimation
+    // or remeshing keeps its last iteration; a stopped CG solve keeps its
+    // iterate if the budget ran out and changes nothing if it was cancelled,
+    // and an expired direct solve whose factors are ready still solves.
+    void set_progress(JobProgress* progress) { progress_ = progress; }
+    bool cancelled() const { return progress_ && progress_->cancelled(); }
+    bool expired() const { return progress_ && progress_->expired(); }
+    bool stopped() const { return progress_ && progress_->stopped(); }
+    // the explicit smoothers publish their positions to snapshots every
+    // snapshots->interval() iterations while they run, for a viewer to
+    // show the progress; nullptr for none
+    void set_snapshots(PositionSnapshots* snapshots) { snapshots_ = snapshots; }
+    // workspace of calc_weights(), one per concurrent call; reusing it
+    // across calls keeps its storage
+    struct CotanWeights {
+        // cotan weight per edge and 0.5 over a third of the area of the
+        // faces around each vertex, indexed like the edges and vertices
+        surface_mesh::Property_vector<surface_mesh::Scalar> edge, vertex;
+        // cotangent of the corner opposite to each halfedge, 0 on the
+        // boundary
+        surface_mesh::Property_vector<surface_mesh::Scalar> halfedge;
+        // angle of the corner opposite to each halfedge, unclamped and
+        // unused on the boundary; set by calc_corner_angles() only
+        surface_mesh::Property_vector<surface_mesh::Scalar> angle;
+        // the positions as read by the SoA kernels
+        SoAGeometry::Positions positions;
+    };
+    // cotan edge weights and inverse vertex areas of the current positions
+    void calc_weights(CotanWeights& weights) const;
+    void calc_mean_curvature(const CotanWeights& weights);
     void calc_uniform_mean_curvature();
-    void calc_gauss_curvature();
+    // angle defect over the vertex area, with the angles of
+    // calc_corner_angles() in the weights
+    void calc_gauss_curvature(const CotanWeights& weights);
+    // CotanWeights::angle of the faces around the given vertices or of all
+    void calc_corner_angles(CotanWeights& weights, const std::vector<int>* vertices = nullptr) const;
 
 private:
-    void calc_weights();
-    void calc_edges_weights();
-    void calc_vertices_weights();
+    // derived state of a new mesh_: bounding sphere, original positions,
+    // history and attributes
+    // bounds are those the reader gathered, nullptr computes them
+    void mesh_changed(const surface_mesh::Vertex_bounds* bounds = nullptr);
+    // mesh_center_, bbox_min_ and bbox_max_ from the vertices
+    void compute_bounds();
+    void minimal_surface_interior(const bool keep_weights);
+    // one implicit_smoothing() step, false if the solve failed
+    bool implicit_step(const double timestep);
+    // L_II and L_IB of interior_ from the cotan operator unless they are
+    // up to date or keep_weights, see minimal_surface()
+    void update_interior_system(const bool keep_weights);
+    // A(index[i], index[i]) = diag[i] + scale * sum_j w_ij and
+    // A(index[i], index[j]) = -scale * w_ij with the edge weights cotan of
+    // calc_weights(), written straight into compressed column storage;
+    // vertices with index[i] < 0 are left out of the system
+    void assemble_cotan_system(const surface_mesh::Property_vector<surface_mesh::Scalar>& cotan,
+                               const std::vector<int>& index, const int n_rows,
+                               const std::vector<double>& diag, const double scale,
+                               Eigen::SparseMatrix<double>& A) const;
+    // raise peak_solver_memory_ to the working set of a solve
+    void note_solver_memory(const Eigen::SparseMatrix<double>& A, const Eigen::MatrixXd& B,
+                            const Eigen::MatrixXd& X, const size_t factor_bytes);
+    // edge-collapse hierarchy of mesh_ for CG_MULTIGRID, rebuilt when the
+    // connectivity changed
+    const MultigridHierarchy& multigrid_hierarchy();
+    // one-rings of the coarse levels of multigrid_hierarchy(), level l + 1
+    // at index l
+    const std::vector<OneRingAdjacency>& coarse_one_rings();
+    // coordinate bisection of mesh_ into subdomains for CG_SCHWARZ, one per
+    // OpenMP thread, rebuilt when the connectivity changed
+    const std::vector<int>& subdomain_partition();
+    // connected component of every vertex, see connected_components(),
+    // recomputed when the connectivity changed
+    const std::vector<int>& vertex_components(int& n_components);
+    // direct factorizations of one of the SPD systems, the symbolic analysis
+    // is kept while the connectivity stays the same
+    struct SpdFactorization {
+        PersistentLDLT<double> ldlt;
+        PersistentLDLT<float> ldlt_float;
+        // DIRECT_LDLT of a system over several connected components, one
+        // factorization per component or group of small ones
+        BlockDiagonalLDLT blocks;
+        // CHOLMOD, Pardiso, cuSOLVER or AmgX, created on first use
+        std::unique_ptr<SpdBackend> backend;
+        SOLVER_TYPE backend_type = DIRECT_LDLT;
+        bool analyzed = false;
+        bool analyzed_float = false;
+        bool analyzed_backend = false;
+        // blocks holds the components of the rows, which may be a single one
+        bool analyzed_blocks = false;
+        // the factors of factorized_type match the values of the matrix;
+        // callers clear it when they change the values
+        bool factorized = false;
+        SOLVER_TYPE factorized_type = DIRECT_LDLT;
+        // counts the changes of the values, the pin columns belong to one
+        unsigned int generation = 0;
+        // A^-1 e_r for the pinned rows r and the Schur complement C A^-1 C^T
+        struct Pins {
+            std::vector<int> rows;
+            Eigen::MatrixXd Z;
+            Eigen::LDLT<Eigen::MatrixXd> S;
+            unsigned int generation = 0;
+        };
+        Pins pins;
+        unsigned int revision = 0;
+        FILL_ORDERING ordering = ORDERING_AMD;
+        // forgets the analysis if the topology revision changed
+        void set_revision(const unsigned int topology_revision);
+        // forgets the analysis and the factors if the ordering changed
+        void set_ordering(const FILL_ORDERING fill_ordering);
+        size_t memory() const;
+        // drops the factors
+        void release();
+    };
+    // A = mass_scale * M + laplace_scale * L of a LaplaceOperator over all
+    // vertices, which CG_MATRIX_FREE applies without assembling it
+    struct MatrixFreeSystem {
+        const LaplaceOperator* op;
+        double mass_scale;
+        double laplace_scale;
+    };
+    // index[v] is the row of vertex v in A, -1 if it is not part of it; with
+    // matrix_free and CG_MATRIX_FREE, A may be empty
+    bool solve_spd_system(const Eigen::SparseMatrix<double>& A,
+                          const Eigen::MatrixXd& B, Eigen::MatrixXd& X,
+                          const std::vector<int>& index, SpdFactorization& factorization,
+                          const MatrixFreeSystem* matrix_free = nullptr);
+    // solve_spd_system with the rows of the pinned vertices held at their
+    // positions
+    bool solve_pinned_system(const Eigen::SparseMatrix<double>& A,
+                             const Eigen::MatrixXd& B, Eigen::MatrixXd& X,
+                             const std::vector<int>& index, SpdFactorization& factorization,
+                             const MatrixFreeSystem* matrix_free = nullptr);
+    // solve_laplace() with the given factors and the scales they were
+    // computed for, with the pins of set_constraint() if pinned
+    bool solve_laplace(const double mass_scale, const double laplace_scale,
+                       const Eigen::MatrixXd& B, Eigen::MatrixXd& X,
+                       SpdFactorization& factorization, double* factor_scales,
+                       const bool pinned);
+    // analyzePattern() with the fill ordering or the record of the symbolic
+    // cache; index as for solve_spd_system(), for ORDERING_MORTON
+    template <typename T>
+    void analyze_pattern(PersistentLDLT<T>& ldlt, const Eigen::SparseMatrix<T>& A,
+                         const std::vector<int>& index);
+    // analyzes A with fill_ordering_, each ordering for ORDERING_AUTO; the
+    // ordering the analysis has
+    template <typename T>
+    FILL_ORDERING order_pattern(PersistentLDLT<T>& ldlt, const Eigen::SparseMatrix<T>& A,
+                                const std::vector<int>& index);
+    // the rows of A in the given ordering other than AMD, false if it is
+    // not available for A
+    template <typename T>
+    bool fill_order(const Eigen::SparseMatrix<T>& A, const std::vector<int>& index,
+                    const FILL_ORDERING ordering, std::vector<int>& order);
+    // x = A^-1 b with the float factors, refined against A in double
+    bool solve_mixed_precision(const Eigen::SparseMatrix<double>& A,
+                               const Eigen::MatrixXd& B, Eigen::MatrixXd& X,
+                               const std::vector<int>& index,
+                               SpdFactorization& factorization);
+    // false if the running job was cancelled
+    bool report_progress(const float fraction) {
+        return progress_ == nullptr || progress_->report(fraction);
+    }
+    // points to snapshots_ after iteration iter, if it is due
+    void publish_snapshot(const unsigned int iter, const surface_mesh::Point* points);
+    // shared loop of the smoothing and the two enhance_feature operators,
+    // with cotan or uniform weights, restricted to the e:feature creases if
+    // features
+    void smooth_iterations(const unsigned int iterations, const bool cotan,
+                           const bool features, const bool enhance = false,
+                           const float coefficient = 0.0f);
+    // CSR one-rings of mesh_, rebuilt when the connectivity changed
+    OneRingAdjacency& one_ring();
+    // builds the SoA stencils of mesh_ if the SoA kernels are enabled and
+    // the connectivity changed; the operators call it, the getters don't
+    void update_soa();
+    // the stencils with the current positions loaded into weights, nullptr
+    // if they are disabled or out of date, the scalar loops are used then
+    const SoAGeometry* soa_kernels(CotanWeights& weights) const;
+    // the edge or the vertex half of calc_weights()
+    void calc_edges_weights(CotanWeights& weights) const;
+    void calc_vertices_weights(CotanWeights& weights) const;
+    // fused one-ring pass: valence, mean curvatures, Gaussian curvature and
+    // vertex normals from the weights of calc_weights() and the angles of
+    // calc_corner_angles(), of the given vertices or all
+    void calc_vertex_properties(const CotanWeights& weights,
+                                const std::vector<int>* vertices = nullptr);
+    // the weights calc_vertex_properties() reads for vertices, bit for bit
+    // as calc_weights(); the other entries are left as they are
+    void calc_local_weights(const std::vector<int>& vertices, CotanWeights& weights) const;
+    void update_curvatures();
+    // signed principal curvatures and directions from the curvature tensor
+    // of each vertex, of the given vertices or all, with the normals of
+    // calc_vertex_properties()
+    void calc_principal_curvatures(const std::vector<int>* vertices = nullptr);
+    void update_principal_curvatures();
+    // marks the attributes dirty after the positions changed, only on the
+    // two-ring of moved if that is small
+    void geometry_changed(const std::vector<int>* moved = nullptr);
+    ConstMatrix4Xu8Map update_color(const unsigned int flag, const string& scalar_name,
+                                    const string& color_name, const int bound);
 
 
 private:
+    // without garbage between operations: mesh_changed() collects it,
+    // decimate() and remesh() collect their own
     Mesh mesh_;
-    Mesh mesh_init_;
+    // positions at load time, indexed like the vertices of mesh_; the
+    // boundary positions of minimal_surface
+    surface_mesh::Property_vector<surface_mesh::Point> points_init_;
+    PositionHistory history_;
+    surface_mesh::Face_report face_report_;
+    bool mesh_cache_ = false;
+    unsigned int read_attributes_ = surface_mesh::READ_ALL;
+    bool from_cache_ = false;
     surface_mesh::Point mesh_center_ = surface_mesh::Point(0.0f, 0.0f, 0.0f);
-    float dist_max_ = 0.0f;
+    float dist_max_ = -1.0f;  // not computed yet if negative
+    surface_mesh::Point bbox_min_ = surface_mesh::Point(0.0f, 0.0f, 0.0f);
+    surface_mesh::Point bbox_max_ = surface_mesh::Point(0.0f, 0.0f, 0.0f);
 
-    Eigen::MatrixXf points_;
 	Eigen::MatrixXf selection_;
     MatrixXu indices_;
-    Eigen::MatrixXf normals_;
-    Eigen::MatrixXf color_valence_;
-    Eigen::MatrixXf color_unicurvature_;
-    Eigen::MatrixXf color_gaussian_curv_;
-    Eigen::MatrixXf color_curvature_;
+    unsigned int indices_revision_ = 0;
+
+    // attributes that are out of date with respect to mesh_
+    enum DIRTY_FLAG : unsigned int {
+        DIRTY_NORMALS = 1 << 0,
+        DIRTY_CURVATURES = 1 << 1,
+        DIRTY_COLOR_VALENCE = 1 << 2,
+        DIRTY_COLOR_UNICURVATURE = 1 << 3,
+        DIRTY_COLOR_CURVATURE = 1 << 4,
+        DIRTY_COLOR_GAUSSIAN_CURV = 1 << 5,
+        DIRTY_PRINCIPAL_CURVATURES = 1 << 6,
+        DIRTY_ALL = (1 << 7) - 1
+    };
+    unsigned int dirty_ = DIRTY_ALL;
+    // attributes that are out of date on the vertices in stale_ only, those
+    // of a local edit; stale_ is sorted
+    unsigned int local_dirty_ = 0;
+    std::vector<int> stale_;
+    unsigned int attributes_topology_revision_ = 0;
+    // weights of the local curvature updates, allocated on first use
+    CotanWeights local_weights_;
+    // bounds the colors were mapped with, by dirty flag
+    std::map<unsigned int, std::pair<surface_mesh::Scalar, surface_mesh::Scalar> > color_ranges_;
+    // get_scalars() of half precision properties, as floats
+    std::vector<float> scalar_buffer_;
+    unsigned int geometry_revision_ = 0;
+    // of get_mesh_hash(), for the revisions it was computed at
+    MeshHash mesh_hash_;
+    unsigned int hash_topology_revision_ = 0;
+    unsigned int hash_geometry_revision_ = 0;
+    bool hashed_ = false;
+    // since changed_revision_ only vertices in [changed_begin_, changed_end_)
+    // changed, see get_changed_vertices()
+    unsigned int changed_revision_ = 0;
+    int changed_begin_ = 0;
+    int changed_end_ = 0;
+    JobProgress* progress_ = nullptr;
+    PositionSnapshots* snapshots_ = nullptr;
+
+    // picking structure, rebuilt per topology and refit per geometry revision
+    TriangleBVH bvh_;
+    unsigned int bvh_topology_revision_ = 0;
+    unsigned int bvh_geometry_revision_ = 0;
+    // bvh_ for the current mesh
+    void update_bvh();
+    // of deviation(), until the geometry or the connectivity changes
+    DeviationReport deviation_;
+    unsigned int deviation_topology_revision_ = 0;
+    bool deviation_symmetric_ = false;
+    bool deviation_valid_ = false;
+    // of self_intersections(), until the geometry or the connectivity changes
+    SelfIntersectionReport self_intersections_;
+    unsigned int self_intersections_topology_revision_ = 0;
+    bool self_intersections_valid_ = false;
+    // applies mode to the vertices whose window position is inside(), see
+    // select_brush()
+    template <typename Inside>
+    int select_vertices(const SelectionView& view, const Inside& inside,
+                        const SELECTION_MODE mode);
+    // the last change of the vertex selection covered
+    // [selection_changed_begin_, selection_changed_end_), see
+    // get_selection_changes()
+    void note_selection_change(const int begin, const int end);
+    unsigned int selection_revision_ = 0;
+    unsigned int selection_changed_revision_ = 0;
+    int selection_changed_begin_ = 0;
+    int selection_changed_end_ = 0;
+    unsigned int selection_topology_revision_ = 0;
+    LodHierarchy lod_;
+    unsigned int lod_topology_revision_ = 0;
+    unsigned int lod_geometry_revision_ = 0;
+    DrawClusters draw_clusters_;
+    unsigned int draw_clusters_topology_revision_ = 0;
+    unsigned int draw_clusters_geometry_revision_ = 0;
+
+    unsigned int weight_update_interval_ = 1;
+    float smoothing_tolerance_ = 0.0f;
+    float max_cotan_ = DEFAULT_MAX_COTAN;
+    bool chebyshev_smoothing_ = false;
+    bool gauss_seidel_smoothing_ = false;
+    bool volume_preservation_ = false;
+    unsigned int smoothing_iterations_ = 0;
+
+    bool use_soa_kernels_ = true;
+    bool interleaved_one_rings_ = false;
+    SoAGeometry soa_;
+    unsigned int soa_revision_ = 0;
+
+    OneRingAdjacency one_ring_;
+    unsigned int one_ring_revision_ = 0;
+
+    // factors reused across solve_laplace and minimal_surface calls
+    SpdFactorization laplace_factorization_;
+    SpdFactorization interior_factorization_;
+    SymbolicCache symbolic_cache_;
+    bool symbolic_cache_enabled_ = false;
+
+    // buffers of the linear solves, kept across calls so that repeated
+    // steps on the same mesh reuse their storage; released per mesh
+    struct SolverWorkspace {
+        Eigen::SparseMatrix<double> A;
+        Eigen::MatrixXd B, X;
+        std::vector<int> index;
+        std::vector<double> diag;
+        std::vector< Eigen::Triplet<double> > triplets;
+        // single precision copy of A and the residuals of DIRECT_LDLT_FLOAT
+        Eigen::SparseMatrix<float> A_float;
+        Eigen::MatrixXd R;
+        Eigen::MatrixXf R_float, X_float;
+        // interleaved x y z of the triangular solves
+        std::vector<double> xyz;
+        std::vector<float> xyz_float;
+        size_t memory() const;
+    };
+    SolverWorkspace workspace_;
+
+    // pinned vertices and their positions, for the connectivity of revision
+    std::vector<int> constraint_vertices_;
+    std::vector<surface_mesh::Point> constraint_positions_;
+    unsigned int constraints_revision_ = 0;
+
+    // the operators of laplace_operator(); a new timestep only recombines
+    // the cotan one on its pattern. The scales of the factors of
+    // laplace_factorization_, which are dropped when the operator changes.
+    LaplaceOperator cotan_laplace_;
+    LaplaceOperator uniform_laplace_;
+    double laplace_factor_scales_[2] = { 0.0, 0.0 };
+    // laplace_operator() keeps the cotan operator when only the positions
+    // changed, set during adaptive_implicit_smoothing()
+    bool laplace_frozen_ = false;
+    // the heat and the Poisson system of geodesic_distances() with the
+    // scales of their factors, kept apart from those of implicit_smoothing
+    struct GeodesicSystems {
+        SpdFactorization heat, poisson;
+        double heat_scales[2] = { 0.0, 0.0 };
+        double poisson_scales[2] = { 0.0, 0.0 };
+    };
+    GeodesicSystems geodesic_;
+
+    // interior numbering of minimal_surface per topology revision and the
+    // reduced system L_II with the couplings L_IB to the fixed boundary; a
+    // solve with the same weights only rebuilds the rhs from the boundary
+    struct InteriorSystem {
+        std::vector<int> index;  // row of a vertex, -1 on the boundary
+        int n_interior = 0;
+        unsigned int topology_revision = 0;
+        bool indexed = false;
+        Eigen::SparseMatrix<double> L;
+        // boundary neighbours and weights of row r in [start[r], start[r + 1])
+        std::vector<int> coupling_start, coupling_vertex;
+        std::vector<double> coupling_weight;
+        // of the cotan operator the system was taken from
+        uint64_t positions_key = 0;
+        // L holds the lower triangle only, for the solver it was taken for
+        bool lower = false;
+        bool assembled = false;
+        size_t memory() const;
+    };
+    InteriorSystem interior_;
+
+    // vertices of the region of interest, index is the row of a vertex in
+    // the region solves during a solve and -1 otherwise, sized for the mesh
+    // once so that a solve only touches the region
+    struct RegionOfInterest {
+        std::vector<int> vertices;
+        std::vector<int> index;
+        unsigned int topology_revision = 0;
+        // counts the region changes, keys the analysis of the factorization
+        unsigned int generation = 0;
+    };
+    RegionOfInterest region_;
+    SpdFactorization region_factorization_;
+    // shared body of the region operators, minimal keeps the mesh boundary
+    // fixed and solves L x = 0
+    void solve_region(const double timestep, const bool minimal);
+    // interior_.index for the current connectivity
+    const std::vector<int>& interior_index();
+
+    SOLVER_TYPE solver_type_ = DIRECT_LDLT;
+    FILL_ORDERING fill_ordering_ = ORDERING_AMD;
+    double solver_tolerance_ = 1e-8;
+    int solver_max_iterations_ = 1000;
+    size_t peak_solver_memory_ = 0;
+    Eigen::ConjugateGradient< Eigen::SparseMatrix<double>, Eigen::Lower,
+                              Eigen::DiagonalPreconditioner<double> > cg_jacobi_solver_;
+    Eigen::ConjugateGradient< Eigen::SparseMatrix<double>, Eigen::Lower,
+                              IncompleteCholeskyPreconditioner > cg_ichol_solver_;
+    Eigen::ConjugateGradient< Eigen::SparseMatrix<double>, Eigen::Lower,
+                              MultigridPreconditioner > cg_multigrid_solver_;
+    MultigridHierarchy multigrid_;
+    unsigned int multigrid_revision_ = 0;
+    std::vector<OneRingAdjacency> coarse_rings_;
+    unsigned int coarse_rings_revision_ = 0;
+    Eigen::ConjugateGradient< Eigen::SparseMatrix<double>, Eigen::Lower,
+                              SchwarzPreconditioner > cg_schwarz_solver_;
+    std::vector<int> subdomains_;
+    unsigned int subdomains_revision_ = 0;
+    std::vector<int> components_;
+    int n_components_ = 0;
+    unsigned int components_revision_ = 0;
+
+    // low frequencies of the cotan Laplacian for the spectral operators
+    LaplacianEigenbasis eigenbasis_;
+    unsigned int eigenbasis_revision_ = 0;
 
-    void color_coding(Mesh::Vertex_property<surface_mesh::Scalar> prop,
+    // values at the 1/bound and 1 - 1/bound quantiles
+    void color_bounds(Mesh::Vertex_property<DisplayScalar> prop, int bound,
+                      surface_mesh::Scalar& min_value, surface_mesh::Scalar& max_value);
+    // colors of the given vertices or all, min_value and max_value map to
+    // blue and red
+    void color_coding(Mesh::Vertex_property<DisplayScalar> prop,
                       Mesh *mesh,
-                      Mesh::Vertex_property<surface_mesh::Color> color_prop,
-                      int bound = 20);
-    void set_color(Mesh::Vertex v, const surface_mesh::Color& col,
-                   Mesh::Vertex_property<surface_mesh::Color> color_prop);
-    surface_mesh::Color value_to_color(surface_mesh::Scalar value,
-                                       surface_mesh::Scalar min_value,
-                                       surface_mesh::Scalar max_value);
+                      Mesh::Vertex_property<surface_mesh::Color8> color_prop,
+                      surface_mesh::Scalar min_value, surface_mesh::Scalar max_value,
+                      const std::vector<int>* vertices = nullptr);
+    surface_mesh::Color8 value_to_color(surface_mesh::Scalar value,
+                                        surface_mesh::Scalar min_value,
+                                        surface_mesh::Scalar max_value);
     };
 
 }
@@ -0,0 +1,144 @@
+#include "mesh_shaders.h"
+
+// the mesh shader, also linked into the viewer's shader of the LOD index buffer
+const char* const MESH_VERTEX_SHADER =
+    "#version 330\n"
+    PACKED_ATTRIBUTES
+    "uniform mat4 MV;\n"
+    "uniform mat4 P;\n"
+    "uniform int color_mode;\n"
+    "uniform vec3 intensity;\n"
+    "uniform vec2 scalar_decode;\n"
+
+    "in float scalar;\n"
+
+    "out vec3 vcolor;\n"
+    "out float vscalar;\n"
+    "out vec3 vnormal;\n"
+    "out vec3 vview_dir;\n"
+    "out vec3 vlight_dir;\n"
+
+    "void main() {\n"
+    "    vec4 vpoint_mv = MV * vec4(unpack_position(), 1.0);\n"
+    "    gl_Position = P * vpoint_mv;\n"
+    "    vcolor = intensity;\n"
+    "    vscalar = scalar_decode.x + scalar_decode.y * scalar;\n"
+    "    vnormal = mat3(transpose(inverse(MV))) * unpack_normal();\n"
+    "    vlight_dir = vec3(0.0, 3.0, 3.0) - vpoint_mv.xyz;\n"
+    "    vview_dir = -vpoint_mv.xyz;\n"
+    "}";
+
+// passes the triangles through with barycentric coordinates, the fragment
+// shader draws the wireframe from them in the same pass
+const char* const MESH_GEOMETRY_SHADER =
+    "#version 330\n"
+    "layout(triangles) in;\n"
+    "layout(triangle_strip, max_vertices = 3) out;\n"
+
+    "in vec3 vcolor[];\n"
+    "in float vscalar[];\n"
+    "in vec3 vnormal[];\n"
+    "in vec3 vview_dir[];\n"
+    "in vec3 vlight_dir[];\n"
+
+    "out vec3 fcolor;\n"
+    "out float fscalar;\n"
+    "out vec3 fnormal;\n"
+    "out vec3 view_dir;\n"
+    "out vec3 light_dir;\n"
+    "noperspective out vec3 barycentric;\n"
+
+    "void main() {\n"
+    "    for (int i = 0; i < 3; i++) {\n"
+    "        gl_Position = gl_in[i].gl_Position;\n"
+    "        fcolor = vcolor[i];\n"
+    "        fscalar = vscalar[i];\n"
+    "        fnormal = vnormal[i];\n"
+    "        view_dir = vview_dir[i];\n"
+    "        light_dir = vlight_dir[i];\n"
+    "        barycentric = vec3(0.0);\n"
+    "        barycentric[i] = 1.0;\n"
+    "        EmitVertex();\n"
+    "    }\n"
+    "    EndPrimitive();\n"
+    "}";
+
+const char* const MESH_FRAGMENT_SHADER =
+    "#version 330\n"
+    "uniform int color_mode;\n"
+    "uniform vec3 intensity;\n"
+    "uniform vec2 scalar_range;\n"
+    "uniform int wireframe;\n"
+    "uniform vec3 wire_intensity;\n"
+
+    "in vec3 fcolor;\n"
+    "in float fscalar;\n"
+    "in vec3 fnormal;\n"
+    "in vec3 view_dir;\n"
+    "in vec3 light_dir;\n"
+    "noperspective in vec3 barycentric;\n"
+    "uniform int splat;\n"
+
+    "out vec4 color;\n"
+
+    "void main() {\n"
+    "    // round point splats\n"
+    "    if (splat != 0 && dot(gl_PointCoord - 0.5, gl_PointCoord - 0.5) > 0.25) {\n"
+    "        discard;\n"
+    "    }\n"
+    "    vec3 c = vec3(0.0);\n"
+    "    if (color_mode == 0) {\n"
+    "        c += vec3(1.0)*vec3(0.18, 0.1, 0.1);\n"
+    "        vec3 n = normalize(fnormal);\n"
+    "        vec3 v = normalize(view_dir);\n"
+    "        vec3 l = normalize(light_dir);\n"
+    "        float lambert = dot(n,l);\n"
+    "        if(lambert > 0.0) {\n"
+    "            c += vec3(1.0)*vec3(0.9, 0.5, 0.5)*lambert;\n"
+    "            vec3 v = normalize(view_dir);\n"
+    "            vec3 r = reflect(-l,n);\n"
+    "            c += vec3(1.0)*vec3(0.8, 0.8, 0.8)*pow(max(dot(r,v), 0.0), 90.0);\n"
+    "        }\n"
+    "        vec3 tint = fcolor;\n"
+    "        if (wireframe != 0) {\n"
+    "            // about a pixel wide lines, antialiased by smoothstep\n"
+    "            vec3 d = fwidth(barycentric);\n"
+    "            vec3 a = smoothstep(vec3(0.0), 1.5 * d, barycentric);\n"
+    "            tint = mix(wire_intensity, fcolor, min(min(a.x, a.y), a.z));\n"
+    "        }\n"
+    "        c *= tint;\n"
+    "    } else {\n"
+    "        // same ramp as MeshProcessing::value_to_color, blue - cyan -\n"
+    "        // green - yellow - red over four segments of scalar_range\n"
+    "        float range = scalar_range.y - scalar_range.x;\n"
+    "        float t = range > 0.0 ? (fscalar - scalar_range.x) * 4.0 / range : 0.0;\n"
+    "        c = vec3(clamp(t - 2.0, 0.0, 1.0),\n"
+    "                 clamp(t, 0.0, 1.0) - clamp(t - 3.0, 0.0, 1.0),\n"
+    "                 1.0 - clamp(t - 1.0, 0.0, 1.0));\n"
+    "    }\n"
+    "    if (intensity == vec3(0.0)) {\n"
+    "        c = intensity;\n"
+    "    }\n"
+    "    color = vec4(c, 1.0);\n"
+    "}";
+
+const char* const NORMAL_VERTEX_SHADER =
+    "#version 330\n\n"
+    PACKED_ATTRIBUTES
+    "uniform mat4 MV;\n"
+    "uniform mat4 P;\n"
+    "void main() {\n"
+    "    vec4 point_mv = MV * vec4(unpack_position(), 1.0);\n"
+    "    // the model transformation scales uniformly\n"
+    "    if (gl_VertexID == 1) {\n"
+    "        point_mv.xyz += 0.035 * normalize(mat3(MV) * unpack_normal());\n"
+    "    }\n"
+    "    gl_Position = P * point_mv;\n"
+    "}";
+
+const char* const NORMAL_FRAGMENT_SHADER =
+    "#version 330\n\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "   frag_color = vec4(0.0, 1.0, 0.0, 1.0);\n"
+    "}";
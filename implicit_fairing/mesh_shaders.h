@@ -0,0 +1,43 @@
+#ifndef MESH_SHADERS_H
+#define MESH_SHADERS_H
+
+// The GLSL sources of the viewer's mesh and normal shaders, defined in
+// mesh_shaders.cpp and linked by the batch thumbnails and the render
+// benchmark as well. The vertex shaders decode the attributes of
+// vertex_packing.h: position, normal and scalar, with the uniforms box_min,
+// box_extent and scalar_decode; MV and P are the camera. color_mode 0
+// shades with intensity and an optional wireframe, any other maps the
+// scalar over scalar_range to the colors of MeshProcessing::value_to_color.
+// The attributes may be floats in the same box coordinates as well, as the
+// GPU smoothing uploads them.
+
+// decoding of the vertex attributes of vertex_packing.h, box_min and
+// box_extent are set by the uploader
+#define PACKED_ATTRIBUTES \
+    "uniform vec3 box_min;\n" \
+    "uniform vec3 box_extent;\n" \
+    "in vec3 position;\n" \
+    "in vec2 normal;\n" \
+    "vec3 unpack_position() {\n" \
+    "    return box_min + position * box_extent;\n" \
+    "}\n" \
+    "vec3 unpack_normal() {\n" \
+    "    vec3 n = vec3(normal, 1.0 - abs(normal.x) - abs(normal.y));\n" \
+    "    if (n.z < 0.0) {\n" \
+    "        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n" \
+    "    }\n" \
+    "    return normalize(n);\n" \
+    "}\n"
+
+extern const char* const MESH_VERTEX_SHADER;
+// passes the triangles through with the barycentric coordinates of the
+// wireframe
+extern const char* const MESH_GEOMETRY_SHADER;
+extern const char* const MESH_FRAGMENT_SHADER;
+
+// a line along the normal of every vertex, drawn as glDrawArraysInstanced(
+// GL_LINES, 0, 2, vertices) with position and normal advancing per instance
+extern const char* const NORMAL_VERTEX_SHADER;
+extern const char* const NORMAL_FRAGMENT_SHADER;
+
+#endif // MESH_SHADERS_H
@@ -0,0 +1,233 @@
+#include "metrics.h"
+#include "resident_memory.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace mesh_processing {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const double duration_bounds[] = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30, 60, 300 };
+const double vertex_bounds[] = { 1e3, 1e4, 1e5, 1e6, 1e7, 1e8 };
+const double iteration_bounds[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 5000 };
+const double residual_bounds[] = { 1e-12, 1e-10, 1e-8, 1e-6, 1e-4, 1e-2, 1 };
+
+struct Histogram {
+    template <size_t N>
+    explicit Histogram(const double (&b)[N]) : bounds(b, b + N), counts(N + 1, 0) {}
+    void observe(const double value) {
+        size_t i = 0;
+        while (i < bounds.size() && value > bounds[i]) ++i;
+        ++counts[i];
+        sum += value;
+        ++count;
+    }
+    std::vector<double> bounds;
+    // per bucket, the last one above all bounds; cumulated on export
+    std::vector<unsigned long long> counts;
+    double sum = 0.0;
+    unsigned long long count = 0;
+};
+
+struct OperationSeries {
+    Histogram duration = Histogram(duration_bounds);
+    Histogram vertices = Histogram(vertex_bounds);
+    unsigned long long failures = 0;
+    size_t peak_resident = 0;
+};
+
+struct SolveSeries {
+    Histogram iterations = Histogram(iteration_bounds);
+    Histogram residual = Histogram(residual_bounds);
+};
+
+struct CacheSeries {
+    unsigned long long hits = 0, misses = 0;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::map<std::string, OperationSeries> operations;
+    std::map<std::string, SolveSeries> solves;
+    std::map<std::string, CacheSeries> caches;
+    // operations in flight
+    int running = 0;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+std::atomic<bool> metrics_enabled(false);
+
+// exact for the sums, short for the bucket bounds
+std::string number(const double value, const bool exact = true) {
+    char text[32];
+    snprintf(text, sizeof(text), exact ? "%.17g" : "%g", value);
+    return text;
+}
+
+void family(std::string& out, const char* name, const char* type, const char* unit,
+            const char* help) {
+    out += std::string("# TYPE ") + name + " " + type + "\n";
+    if (unit) out += std::string("# UNIT ") + name + " " + unit + "\n";
+    out += std::string("# HELP ") + name + " " + help + "\n";
+}
+
+// label="value" with the value escaped as the format wants
+std::string label(const char* name, const std::string& value) {
+    std::string text = std::string(name) + "=\"";
+    for (const char c : value) {
+        if (c == '\\' || c == '"') text += '\\';
+        if (c == '\n') {
+            text += "\\n";
+            continue;
+        }
+        text += c;
+    }
+    return text + "\"";
+}
+
+void histogram(std::string& out, const char* name, const std::string& labels,
+               const Histogram& h) {
+    unsigned long long cumulative = 0;
+    for (size_t i = 0; i <= h.bounds.size(); ++i) {
+        cumulative += h.counts[i];
+        const std::string le = i < h.bounds.size() ? number(h.bounds[i], false) : "+Inf";
+        out += std::string(name) + "_bucket{" + labels + ",le=\"" + le + "\"} " +
+               std::to_string(cumulative) + "\n";
+    }
+    out += std::string(name) + "_count{" + labels + "} " + std::to_string(h.count) + "\n";
+    out += std::string(name) + "_sum{" + labels + "} " + number(h.sum) + "\n";
+}
+
+}
+
+void Metrics::enable(const bool on) { metrics_enabled.store(on, std::memory_order_relaxed); }
+
+bool Metrics::enabled() { return metrics_enabled.load(std::memory_order_relaxed); }
+
+Metrics::Operation::Operation(const char* name, const size_t vertices)
+    : name_(name), vertices_(vertices) {
+    if (!enabled()) return;
+    active_ = true;
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    // the heap is not trimmed, that would cost more than small operations
+    if (r.running++ == 0) reset_peak_resident_memory(false);
+    begin_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 Clock::now().time_since_epoch()).count();
+}
+
+Metrics::Operation::~Operation() {
+    if (!active_) return;
+    const long long end = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              Clock::now().time_since_epoch()).count();
+    const size_t peak = peak_resident_memory();
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    --r.running;
+    OperationSeries& series = r.operations[name_];
+    series.duration.observe((end - begin_) * 1e-9);
+    series.vertices.observe(double(vertices_));
+    series.failures += failed_;
+    series.peak_resident = std::max(series.peak_resident, peak);
+}
+
+void Metrics::record_solve(const char* solver, const int iterations, const double residual) {
+    if (!enabled()) return;
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    SolveSeries& series = r.solves[solver];
+    series.iterations.observe(iterations);
+    series.residual.observe(residual);
+}
+
+void Metrics::record_cache(const char* cache, const bool hit) {
+    if (!enabled()) return;
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    CacheSeries& series = r.caches[cache];
+    ++(hit ? series.hits : series.misses);
+}
+
+std::string Metrics::openmetrics() {
+    const size_t resident = resident_memory();
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::string out;
+    family(out, "gp_operation_duration_seconds", "histogram", "seconds",
+           "Wall time of the operations.");
+    for (const auto& s : r.operations) {
+        histogram(out, "gp_operation_duration_seconds", label("operation", s.first),
+                  s.second.duration);
+    }
+    family(out, "gp_operation_vertices", "histogram", nullptr,
+           "Vertices of the meshes the operations ran on.");
+    for (const auto& s : r.operations) {
+        histogram(out, "gp_operation_vertices", label("operation", s.first), s.second.vertices);
+    }
+    family(out, "gp_operation_failures", "counter", nullptr, "Operations that failed.");
+    for (const auto& s : r.operations) {
+        out += "gp_operation_failures_total{" + label("operation", s.first) + "} " +
+               std::to_string(s.second.failures) + "\n";
+    }
+    family(out, "gp_operation_peak_resident_bytes", "gauge", "bytes",
+           "Largest resident memory of the process while an operation ran.");
+    for (const auto& s : r.operations) {
+        out += "gp_operation_peak_resident_bytes{" + label("operation", s.first) + "} " +
+               std::to_string(s.second.peak_resident) + "\n";
+    }
+    family(out, "gp_solver_iterations", "histogram", nullptr,
+           "Iterations of the iterative solves.");
+    for (const auto& s : r.solves) {
+        histogram(out, "gp_solver_iterations", label("solver", s.first), s.second.iterations);
+    }
+    family(out, "gp_solver_residual", "histogram", nullptr,
+           "Relative residual the iterative solves ended with.");
+    for (const auto& s : r.solves) {
+        histogram(out, "gp_solver_residual", label("solver", s.first), s.second.residual);
+    }
+    family(out, "gp_cache_lookups", "counter", nullptr, "Lookups of the caches by result.");
+    for (const auto& s : r.caches) {
+        const std::string cache = label("cache", s.first);
+        out += "gp_cache_lookups_total{" + cache + ",result=\"hit\"} " +
+               std::to_string(s.second.hits) + "\n";
+        out += "gp_cache_lookups_total{" + cache + ",result=\"miss\"} " +
+               std::to_string(s.second.misses) + "\n";
+    }
+    family(out, "gp_process_resident_bytes", "gauge", "bytes",
+           "Resident memory of the process.");
+    out += "gp_process_resident_bytes " + std::to_string(resident) + "\n";
+    out += "# EOF\n";
+    return out;
+}
+
+bool Metrics::write_openmetrics(const std::string& filename) {
+    const std::string text = openmetrics();
+    const std::string temporary = filename + ".tmp";
+    {
+        std::ofstream file(temporary.c_str(), std::ios::binary);
+        file << text;
+        if (!file) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+#if defined(_WIN32)
+    // rename() does not replace there
+    std::remove(filename.c_str());
+#endif
+    return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+}
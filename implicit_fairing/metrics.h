@@ -0,0 +1,63 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstddef>
+#include <string>
+
+namespace mesh_processing {
+
+// Aggregated metrics of a long-running process for monitoring across runs
+// and machines, where a trace per run is too much: latency histograms,
+// mesh sizes, failures and peak resident memory of the operations, CG
+// iterations and residuals, cache hits and misses. Exported in the
+// OpenMetrics text format that Prometheus scrapes, by the server on its
+// metrics port and by a batch into a file for a textfile collector.
+//
+// Off until enable(); off, every record is one relaxed load. On, it takes
+// a mutex and a map lookup, which is fine for events per operation and per
+// solve, not per element. Names are lower case identifiers, the metric
+// families are prefixed with gp_.
+class Metrics {
+public:
+    static void enable(const bool on = true);
+    static bool enabled();
+
+    // one run of an operation on a mesh of vertices vertices, recorded when
+    // it goes out of scope: its duration, the size and the high-water mark
+    // of the resident memory while it ran. The mark is reset at the start
+    // unless other operations are running, it is then an upper bound.
+    class Operation {
+    public:
+        Operation(const char* name, const size_t vertices);
+        ~Operation();
+        // counted as a failure, e.g. after a bad request
+        void fail() { failed_ = true; }
+
+    private:
+        Operation(const Operation&) = delete;
+        Operation& operator=(const Operation&) = delete;
+        const char* name_;
+        size_t vertices_;
+        long long begin_ = 0;
+        bool failed_ = false;
+        bool active_ = false;
+    };
+
+    // an iterative solve that took iterations iterations to the relative
+    // residual residual
+    static void record_solve(const char* solver, const int iterations, const double residual);
+    // a lookup of cache, e.g. kept meshes or factors
+    static void record_cache(const char* cache, const bool hit);
+
+    // everything recorded so far, the process memory at the time of the
+    // call, ended by "# EOF"
+    static std::string openmetrics();
+    // openmetrics() into filename through a temporary file and a rename,
+    // so that a collector never reads half a file; false if it cannot be
+    // written
+    static bool write_openmetrics(const std::string& filename);
+};
+
+}
+
+#endif // METRICS_H
@@ -0,0 +1,173 @@
+#include "multigrid.h"
+
+namespace mesh_processing {
+
+typedef surface_mesh::Surface_mesh Mesh;
+
+void MultigridHierarchy::build(const Mesh& mesh, const int coarse_size) {
+    n_vertices_.assign(1, mesh.vertices_size());
+    parents_.clear();
+    if (!mesh.is_triangle_mesh()) return;
+
+    // only the connectivity is needed, the positions come along
+    Mesh level;
+    level.assign(mesh);
+    auto id = level.add_vertex_property<int>("v:multigrid_id");
+    while (int(level.n_vertices()) > coarse_size) {
+        const int n = level.vertices_size();
+        for (int i = 0; i < n; ++i) id[Mesh::Vertex(i)] = i;
+
+        // collapse a matching: every vertex takes part in at most one
+        // collapse, boundary vertices stay where they are
+        std::vector<int> target(n, -1);
+        std::vector<unsigned char> locked(n, 0);
+        int removed = 0;
+        for (auto e: level.edges()) {
+            if (level.is_deleted(e)) continue;
+            const Mesh::Halfedge h = level.halfedge(e, 0);
+            const Mesh::Vertex v0 = level.from_vertex(h), v1 = level.to_vertex(h);
+            if (locked[v0.idx()] || locked[v1.idx()]) continue;
+            if (level.is_boundary(v0) || level.is_boundary(v1)) continue;
+            if (!level.is_collapse_ok(h)) continue;
+            level.collapse(h);
+            target[v0.idx()] = v1.idx();
+            locked[v0.idx()] = locked[v1.idx()] = 1;
+            ++removed;
+        }
+        // stalled, e.g. only boundary vertices left
+        if (removed < n / 8) break;
+
+        // garbage collection renumbers the vertices, id keeps the old index
+        level.garbage_collection();
+        std::vector<int> new_index(n, -1);
+        for (auto v: level.vertices()) new_index[id[v]] = v.idx();
+        std::vector<int> parent(n);
+        for (int i = 0; i < n; ++i) {
+            parent[i] = new_index[target[i] >= 0 ? target[i] : i];
+        }
+        parents_.push_back(parent);
+        n_vertices_.push_back(level.n_vertices());
+    }
+}
+
+size_t MultigridHierarchy::memory_usage() const {
+    size_t bytes = n_vertices_.capacity() * sizeof(int);
+    for (const auto& parent: parents_) bytes += parent.capacity() * sizeof(int);
+    return bytes;
+}
+
+void MultigridPreconditioner::set_hierarchy(const MultigridHierarchy& hierarchy,
+                                            const std::vector<int>& index) {
+    levels_.clear();
+    fine_ = nullptr;
+    levels_.push_back(Level());
+
+    // rows of the vertices of the current level, an aggregate gets a row if
+    // one of its vertices has one
+    std::vector<int> rows = index;
+    for (int l = 0; l + 1 < hierarchy.n_levels(); ++l) {
+        const std::vector<int>& parent = hierarchy.parent(l);
+        std::vector<int> coarse_rows(hierarchy.n_vertices(l + 1), -1);
+        std::vector< Eigen::Triplet<double> > triplets;
+        int n_fine = 0, n_coarse = 0;
+        for (size_t v = 0; v < rows.size(); ++v) {
+            if (rows[v] < 0) continue;
+            ++n_fine;
+            int& c = coarse_rows[parent[v]];
+            if (c < 0) c = n_coarse++;
+            triplets.push_back(Eigen::Triplet<double>(rows[v], c, 1.0));
+        }
+        if (n_coarse == n_fine) break;
+
+        levels_.back().P.resize(n_fine, n_coarse);
+        levels_.back().P.setFromTriplets(triplets.begin(), triplets.end());
+        levels_.push_back(Level());
+        rows.swap(coarse_rows);
+    }
+}
+
+void MultigridPreconditioner::factorize(const Eigen::SparseMatrix<double>& A) {
+    fine_ = &A;
+    if (levels_.empty()) levels_.push_back(Level());
+
+    // Galerkin operators of the coarse levels
+    for (size_t l = 0; l < levels_.size(); ++l) {
+        Level& level = levels_[l];
+        const Eigen::SparseMatrix<double>& Al = l == 0 ? A : level.A;
+        level.inv_diag = Al.diagonal().cwiseInverse();
+        if (l + 1 < levels_.size()) {
+            const Eigen::SparseMatrix<double> AP = Al * level.P;
+            levels_[l + 1].A = level.P.transpose() * AP;
+        }
+    }
+
+    coarse_solver_.compute(levels_.size() == 1 ? A : levels_.back().A);
+    info_ = coarse_solver_.info();
+}
+
+// r = b - A x without temporaries
+static void residual(const Eigen::SparseMatrix<double>& A, const Eigen::VectorXd& b,
+                     const Eigen::VectorXd& x, Eigen::VectorXd& r) {
+    r.noalias() = A * x;
+    r = b - r;
+}
+
+void MultigridPreconditioner::cycle(const int l, const Eigen::VectorXd& b,
+                                    Eigen::VectorXd& x) const {
+    const Level& level = levels_[l];
+    if (l + 1 == int(levels_.size())) {
+        x = coarse_solver_.solve(b);
+        return;
+    }
+
+    // weighted Jacobi, the same sweeps before and after the coarse
+    // correction keep the cycle symmetric as CG needs it
+    const Eigen::SparseMatrix<double>& A = l == 0 ? *fine_ : level.A;
+    const double omega = 2.0 / 3.0;
+    const int sweeps = 2;
+    x = omega * level.inv_diag.cwiseProduct(b);
+    for (int k = 1; k < sweeps; ++k) {
+        residual(A, b, x, level.r);
+        x += omega * level.inv_diag.cwiseProduct(level.r);
+    }
+
+    residual(A, b, x, level.r);
+    level.b_coarse.noalias() = level.P.transpose() * level.r;
+    cycle(l + 1, level.b_coarse, level.x_coarse);
+    x.noalias() += level.P * level.x_coarse;
+
+    for (int k = 0; k < sweeps; ++k) {
+        residual(A, b, x, level.r);
+        x += omega * level.inv_diag.cwiseProduct(level.r);
+    }
+}
+
+Eigen::VectorXd MultigridPreconditioner::solve(const Eigen::VectorXd& b) const {
+    Eigen::VectorXd x;
+    cycle(0, b, x);
+    return x;
+}
+
+size_t MultigridPreconditioner::memory_usage() const {
+    size_t bytes = 0;
+    for (const Level& level: levels_) {
+        bytes += size_t(level.A.nonZeros() + level.P.nonZeros()) * (sizeof(double) + sizeof(int)) +
+                 size_t(level.A.outerSize() + level.P.outerSize()) * sizeof(int) +
+                 size_t(level.inv_diag.size() + level.r.size() + level.b_coarse.size() +
+                        level.x_coarse.size()) * sizeof(double);
+    }
+    if (info_ == Eigen::Success && !levels_.empty() && fine_) {
+        bytes += size_t(coarse_solver_.matrixL().nestedExpression().nonZeros()) *
+                     (sizeof(double) + sizeof(int)) +
+                 size_t(coarse_solver_.vectorD().size()) * sizeof(double);
+    }
+    return bytes;
+}
+
+void MultigridPreconditioner::clear() {
+    levels_.clear();
+    fine_ = nullptr;
+    coarse_solver_.compute(Eigen::SparseMatrix<double>());
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <Eigen/Sparse>
+#include <vector>
+
+namespace mesh_processing {
+
+// Coarsening hierarchy of a triangle mesh for geometric multigrid. Every
+// level collapses a matching of interior edges with Surface_mesh::collapse,
+// so about half of the vertices remain; parent(l)[v] is the vertex of level
+// l + 1 that vertex v of level l was merged into. Only depends on the
+// connectivity, build() once per topology.
+class MultigridHierarchy {
+
+public:
+    // coarsen until at most coarse_size vertices are left or a level
+    // removes too few; a non-triangle mesh gets no coarse level
+    void build(const surface_mesh::Surface_mesh& mesh, const int coarse_size = 1000);
+    bool empty() const { return n_vertices_.empty(); }
+    // number of levels including the input mesh
+    int n_levels() const { return int(n_vertices_.size()); }
+    int n_vertices(const int level) const { return n_vertices_[level]; }
+    const std::vector<int>& parent(const int level) const { return parents_[level]; }
+    // bytes reserved by the parent maps
+    size_t memory_usage() const;
+
+private:
+    std::vector<int> n_vertices_;
+    std::vector< std::vector<int> > parents_;
+};
+
+// Multigrid V-cycle for SPD systems on the vertices of a mesh, usable as
+// the preconditioner of Eigen::ConjugateGradient. The prolongations are
+// the aggregations of a MultigridHierarchy, the coarse operators the
+// Galerkin products P^T A P, smoothed with weighted Jacobi and solved
+// directly on the coarsest level. Call set_hierarchy() before compute().
+class MultigridPreconditioner {
+
+public:
+    MultigridPreconditioner() : info_(Eigen::Success) {}
+
+    // index[v] is the row of vertex v of the finest level in A, -1 if the
+    // vertex is not part of the system
+    void set_hierarchy(const MultigridHierarchy& hierarchy, const std::vector<int>& index);
+
+    void analyzePattern(const Eigen::SparseMatrix<double>& A) {}
+    void factorize(const Eigen::SparseMatrix<double>& A);
+    void compute(const Eigen::SparseMatrix<double>& A) { factorize(A); }
+
+    // one V-cycle for A*x = b starting from x = 0
+    Eigen::VectorXd solve(const Eigen::VectorXd& b) const;
+
+    Eigen::ComputationInfo info() const { return info_; }
+    int n_levels() const { return int(levels_.size()); }
+    // bytes of the operators, prolongations and the coarse factorization
+    size_t memory_usage() const;
+    // drops the levels
+    void clear();
+
+private:
+    void cycle(const int level, const Eigen::VectorXd& b, Eigen::VectorXd& x) const;
+
+    struct Level {
+        // Galerkin operator, the finest level uses the matrix of factorize()
+        Eigen::SparseMatrix<double> A;
+        // aggregation to the next coarser level, rows x rows of that level
+        Eigen::SparseMatrix<double> P;
+        Eigen::VectorXd inv_diag;
+        // work vectors of the cycle
+        mutable Eigen::VectorXd r, b_coarse, x_coarse;
+    };
+    // the matrix is referenced like the one in Eigen's iterative solvers
+    const Eigen::SparseMatrix<double>* fine_ = nullptr;
+    std::vector<Level> levels_;
+    Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > coarse_solver_;
+    Eigen::ComputationInfo info_;
+};
+
+}
+
+#endif // MULTIGRID_H
@@ -0,0 +1,132 @@
+#include "offscreen_context.h"
+#if defined(GP_HAVE_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(GP_HAVE_OSMESA)
+#include <GL/osmesa.h>
+#endif
+
+namespace mesh_processing {
+
+#if defined(GP_HAVE_EGL)
+
+// an initialized display: the default one, which needs a window system on
+// some drivers, else the first device, a GPU without X, else Mesa's
+// surfaceless platform
+static EGLDisplay open_display() {
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) return display;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!get_platform_display) return EGL_NO_DISPLAY;
+    PFNEGLQUERYDEVICESEXTPROC query_devices =
+        (PFNEGLQUERYDEVICESEXTPROC) eglGetProcAddress("eglQueryDevicesEXT");
+    EGLDeviceEXT device;
+    EGLint devices = 0;
+    if (query_devices && query_devices(1, &device, &devices) && devices > 0) {
+        display = get_platform_display(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) return display;
+    }
+    display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) return display;
+    return EGL_NO_DISPLAY;
+}
+
+bool OffscreenContext::create(std::string& error) {
+    release();
+    EGLDisplay display = open_display();
+    if (display == EGL_NO_DISPLAY) {
+        error = "no EGL display";
+        return false;
+    }
+    display_ = display;
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        error = "EGL without desktop OpenGL";
+        release();
+        return false;
+    }
+    // no surface is drawn to, a config is only chosen where the display
+    // has one, EGL_KHR_no_config_context does without
+    const EGLint config_attributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = nullptr;
+    EGLint configs = 0;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &configs) || configs == 0) {
+        config = nullptr;
+    }
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT) {
+        error = "no EGL OpenGL 3.3 core context";
+        release();
+        return false;
+    }
+    context_ = context;
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        error = "EGL context without surfaces";
+        release();
+        return false;
+    }
+    return true;
+}
+
+void OffscreenContext::release() {
+    if (display_) {
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context_) eglDestroyContext(display_, context_);
+        eglTerminate(display_);
+    }
+    display_ = nullptr;
+    context_ = nullptr;
+}
+
+bool OffscreenContext::available() { return true; }
+
+#elif defined(GP_HAVE_OSMESA)
+
+bool OffscreenContext::create(std::string& error) {
+    release();
+    const int attributes[] = {
+        OSMESA_FORMAT, OSMESA_RGBA, OSMESA_DEPTH_BITS, 24,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 3, OSMESA_CONTEXT_MINOR_VERSION, 3, 0
+    };
+    OSMesaContext context = OSMesaCreateContextAttribs(attributes, nullptr);
+    if (!context) {
+        error = "no OSMesa OpenGL 3.3 core context";
+        return false;
+    }
+    context_ = context;
+    buffer_.assign(4, 0);
+    if (!OSMesaMakeCurrent(context, buffer_.data(), GL_UNSIGNED_BYTE, 1, 1)) {
+        error = "OSMesa context cannot be made current";
+        release();
+        return false;
+    }
+    return true;
+}
+
+void OffscreenContext::release() {
+    if (context_) OSMesaDestroyContext((OSMesaContext) context_);
+    context_ = nullptr;
+    buffer_.clear();
+}
+
+bool OffscreenContext::available() { return true; }
+
+#else
+
+bool OffscreenContext::create(std::string& error) {
+    error = "built without an offscreen context, see GP_OFFSCREEN";
+    return false;
+}
+
+void OffscreenContext::release() {}
+
+bool OffscreenContext::available() { return false; }
+
+#endif
+
+}
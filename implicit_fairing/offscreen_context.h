@@ -0,0 +1,36 @@
+#ifndef OFFSCREEN_CONTEXT_H
+#define OFFSCREEN_CONTEXT_H
+
+#include <string>
+#include <vector>
+
+namespace mesh_processing {
+
+// An OpenGL 3.3 core context without a window, for drawing into
+// framebuffer objects in the batch mode: EGL with GP_HAVE_EGL, on the
+// default display, the first GPU device or Mesa's surfaceless platform,
+// whichever initializes, or OSMesa with GP_HAVE_OSMESA. The context is
+// current on the thread that created it.
+class OffscreenContext {
+
+public:
+    ~OffscreenContext() { release(); }
+
+    // false and a message if the build has no backend or it has no context
+    bool create(std::string& error);
+    void release();
+    bool valid() const { return context_ != nullptr; }
+    // true if the build has a backend at all
+    static bool available();
+
+private:
+    void* display_ = nullptr;
+    void* context_ = nullptr;
+    // the color buffer OSMesa insists on, the framebuffer objects are drawn
+    // into instead
+    std::vector<unsigned char> buffer_;
+};
+
+}
+
+#endif // OFFSCREEN_CONTEXT_H
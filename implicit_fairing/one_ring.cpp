@@ -0,0 +1,468 @@
+#include "one_ring.h"
+#include "reduction.h"
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+using surface_mesh::Property_vector;
+typedef surface_mesh::Surface_mesh Mesh;
+
+void OneRingAdjacency::build(const Mesh& mesh) {
+    const int n = mesh.vertices_size();
+    offsets_.assign(n + 1, 0);
+    interior_.assign(n, 0);
+
+    for (int i = 0; i < n; ++i) {
+        Mesh::Vertex v(i);
+        if (!mesh.is_deleted(v) && !mesh.is_isolated(v)) {
+            interior_[i] = !mesh.is_boundary(v);
+            offsets_[i + 1] = mesh.valence(v);
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        offsets_[i + 1] += offsets_[i];
+    }
+    closed_ = std::find(interior_.begin(), interior_.end(), 0) == interior_.end();
+
+    neighbors_.resize(offsets_[n]);
+    edges_.resize(offsets_[n]);
+    weights_.assign(offsets_[n], 1.0f);
+    color_offsets_.clear();
+    color_vertices_.clear();
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        int k = offsets_[i];
+        if (k == offsets_[i + 1]) continue;
+        for (auto h: mesh.halfedges(Mesh::Vertex(i))) {
+            neighbors_[k] = mesh.to_vertex(h).idx();
+            edges_[k] = mesh.edge(h).idx();
+            ++k;
+        }
+    }
+    interleave();
+}
+
+void OneRingAdjacency::build_coarse(const OneRingAdjacency& fine, const std::vector<int>& parent,
+                                    const int n_coarse) {
+    // the fine vertices of every aggregate
+    std::vector<int> first(n_coarse + 1, 0), members(parent.size());
+    for (size_t v = 0; v < parent.size(); ++v) {
+        if (parent[v] >= 0) ++first[parent[v] + 1];
+    }
+    for (int c = 0; c < n_coarse; ++c) first[c + 1] += first[c];
+    std::vector<int> next(first.begin(), first.end() - 1);
+    for (size_t v = 0; v < parent.size(); ++v) {
+        if (parent[v] >= 0) members[next[parent[v]]++] = int(v);
+    }
+
+    // the neighboring aggregates of every aggregate, sorted
+    std::vector< std::vector<int> > rings(n_coarse);
+    interior_.assign(n_coarse, 0);
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < n_coarse; ++c) {
+        std::vector<int>& ring = rings[c];
+        bool interior = first[c] < first[c + 1];
+        for (int j = first[c]; j < first[c + 1]; ++j) {
+            const int v = members[j];
+            interior = interior && fine.interior_[v];
+            for (int k = fine.offsets_[v]; k < fine.offsets_[v + 1]; ++k) {
+                const int p = parent[fine.neighbors_[k]];
+                if (p >= 0 && p != c) ring.push_back(p);
+            }
+        }
+        std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+        interior_[c] = interior && !ring.empty();
+    }
+    closed_ = std::find(interior_.begin(), interior_.end(), 0) == interior_.end();
+
+    offsets_.assign(n_coarse + 1, 0);
+    for (int c = 0; c < n_coarse; ++c) offsets_[c + 1] = offsets_[c] + int(rings[c].size());
+    neighbors_.resize(offsets_[n_coarse]);
+    edges_.assign(offsets_[n_coarse], -1);
+    weights_.assign(offsets_[n_coarse], 1.0f);
+    for (int c = 0; c < n_coarse; ++c) {
+        std::copy(rings[c].begin(), rings[c].end(), neighbors_.begin() + offsets_[c]);
+    }
+    interleave();
+}
+
+void OneRingAdjacency::set_interleaved(const bool interleaved) {
+    if (interleaved == interleaved_) return;
+    interleaved_ = interleaved;
+    if (interleaved_) interleave();
+    else std::vector<Entry>().swap(entries_);
+}
+
+void OneRingAdjacency::interleave() {
+    if (!interleaved_) return;
+    const int n = int(neighbors_.size());
+    entries_.resize(n);
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n; ++k) {
+        entries_[k].neighbor = neighbors_[k];
+        entries_[k].weight = weights_[k];
+    }
+}
+
+void OneRingAdjacency::gather_entries(const Property_vector<Scalar>& weight,
+                                      std::vector<Entry>& entries) const {
+    const int n = int(edges_.size());
+    entries.resize(n);
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n; ++k) {
+        entries[k].neighbor = neighbors_[k];
+        entries[k].weight = weight[edges_[k]];
+    }
+}
+
+void OneRingAdjacency::prolongate(const Point* coarse, const std::vector<int>& parent,
+                                  Point* fine) const {
+    const int n = n_vertices();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        if (parent[i] < 0) continue;
+        if (!interior_[i]) {
+            fine[i] += coarse[parent[i]];
+            continue;
+        }
+        Point sum = coarse[parent[i]];
+        int count = 1;
+        for (int k = offsets_[i]; k < offsets_[i + 1]; ++k) {
+            const int p = parent[neighbors_[k]];
+            if (p < 0) continue;
+            sum += coarse[p];
+            ++count;
+        }
+        fine[i] += sum / Scalar(count);
+    }
+}
+
+size_t OneRingAdjacency::memory_usage() const {
+    return (offsets_.capacity() + neighbors_.capacity() + edges_.capacity()) * sizeof(int) +
+           weights_.capacity() * sizeof(Scalar) + interior_.capacity() +
+           entries_.capacity() * sizeof(Entry) +
+           (color_offsets_.capacity() + color_vertices_.capacity()) * sizeof(int);
+}
+
+void OneRingAdjacency::gather_edge_weights(const Property_vector<Scalar>& weight) {
+    const int n = edges_.size();
+    Entry* entries = interleaved_ ? entries_.data() : nullptr;
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < n; ++k) {
+        weights_[k] = weight[edges_[k]];
+        if (entries) entries[k].weight = weights_[k];
+    }
+}
+
+void OneRingAdjacency::reset_weights() {
+    std::fill(weights_.begin(), weights_.end(), 1.0f);
+    for (Entry& entry : entries_) entry.weight = 1.0f;
+}
+
+void OneRingAdjacency::restrict_to_features(const Mesh::Edge_property<Scalar>& feature) {
+    const int n = n_vertices();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        const int begin = offsets_[i], end = offsets_[i + 1];
+        bool on_feature = false;
+        for (int k = begin; k < end; ++k) {
+            if (feature[Mesh::Edge(edges_[k])] != 0.0f) on_feature = true;
+        }
+        if (!on_feature) continue;
+        std::fill(weights_.begin() + begin, weights_.begin() + end, 0.0f);
+        if (interleaved_) {
+            for (int k = begin; k < end; ++k) entries_[k].weight = 0.0f;
+        }
+    }
+}
+
+// The smoothing kernel is compiled once per weight and boundary policy, the
+// steps pick the instance once per call instead of branching per vertex.
+// The weight policies sum the ring of a vertex into laplace and return the
+// sum of its weights: uniform weights read no weight stream at all, the
+// others the weight slots, which also hold the feature restriction, or their
+// interleaved copy.
+namespace {
+
+struct UniformWeights {
+    const int* neighbors;
+    Scalar ring(const Point* in, const Point& p, const int begin, const int end,
+                Point& laplace) const {
+        for (int k = begin; k < end; ++k) {
+            laplace += (in[neighbors[k]] - p);
+        }
+        return Scalar(end - begin);
+    }
+};
+
+struct SlotWeights {
+    const int* neighbors;
+    const Scalar* weights;
+    Scalar ring(const Point* in, const Point& p, const int begin, const int end,
+                Point& laplace) const {
+        Scalar ww = 0;
+        for (int k = begin; k < end; ++k) {
+            const Scalar w = weights[k];
+            ww += w;
+            laplace += w * (in[neighbors[k]] - p);
+        }
+        return ww;
+    }
+};
+
+struct EntryWeights {
+    const OneRingAdjacency::Entry* entries;
+    Scalar ring(const Point* in, const Point& p, const int begin, const int end,
+                Point& laplace) const {
+        Scalar ww = 0;
+        for (int k = begin; k < end; ++k) {
+            const OneRingAdjacency::Entry& entry = entries[k];
+            ww += entry.weight;
+            laplace += entry.weight * (in[entry.neighbor] - p);
+        }
+        return ww;
+    }
+};
+
+// the boundary policies tell the vertices that move; on closed() rings all
+// of them do and the lookup goes away
+struct FixedBoundary {
+    const unsigned char* interior;
+    bool moves(const int i) const { return interior[i] != 0; }
+};
+
+struct NoBoundary {
+    bool moves(const int) const { return true; }
+};
+
+// vertex i of smooth_step()
+template <typename Weights, typename Boundary>
+struct Smoother {
+    const int* offsets;
+    Weights weights;
+    Boundary boundary;
+
+    Point operator()(const Point* in, const int i, const Scalar damping) const {
+        const Point& p = in[i];
+        if (!boundary.moves(i)) return p;
+        Point laplace(0.0);
+        const Scalar ww = weights.ring(in, p, offsets[i], offsets[i + 1], laplace);
+        if (ww != 0) laplace /= ww;
+        laplace *= damping;
+        return p + laplace;
+    }
+};
+
+template <typename Weights, typename Boundary>
+Smoother<Weights, Boundary> make_smoother(const int* offsets, const Weights& weights,
+                                          const Boundary& boundary) {
+    Smoother<Weights, Boundary> smoother = { offsets, weights, boundary };
+    return smoother;
+}
+
+// step(smoother) with the smoother of ring for weighted
+template <typename Boundary, typename Step>
+typename Step::Result with_weights(const OneRingAdjacency& ring, const bool weighted,
+                                   const Boundary& boundary, const Step& step) {
+    const int* offsets = ring.offsets().data();
+    const int* neighbors = ring.neighbors().data();
+    if (!weighted) {
+        const UniformWeights weights = { neighbors };
+        return step(make_smoother(offsets, weights, boundary));
+    }
+    if (ring.interleaved()) {
+        const EntryWeights weights = { ring.entries().data() };
+        return step(make_smoother(offsets, weights, boundary));
+    }
+    const SlotWeights weights = { neighbors, ring.weights().data() };
+    return step(make_smoother(offsets, weights, boundary));
+}
+
+template <typename Step>
+typename Step::Result with_smoother(const OneRingAdjacency& ring, const bool weighted,
+                                    const Step& step) {
+    if (ring.closed()) return with_weights(ring, weighted, NoBoundary(), step);
+    const FixedBoundary boundary = { ring.interior().data() };
+    return with_weights(ring, weighted, boundary, step);
+}
+
+// the steps as functors of the smoother
+struct SmoothStep {
+    typedef double Result;
+    int n;
+    const Point* in;
+    Point* out;
+    Scalar damping;
+
+    template <typename Smoother>
+    double operator()(const Smoother& smoothed) const {
+        // summed in a fixed order, the convergence tests stop after the same
+        // iteration on any number of threads
+        return deterministic_sum(n, 0.0, [&](const int i) {
+            out[i] = smoothed(in, i, damping);
+            return double(sqrnorm(out[i] - in[i]));
+        });
+    }
+};
+
+struct AcceleratedStep {
+    typedef double Result;
+    int n;
+    const Point* in;
+    const Point* previous;
+    Point* out;
+    Scalar damping;
+    Scalar omega;
+
+    template <typename Smoother>
+    double operator()(const Smoother& smoothed) const {
+        return deterministic_sum(n, 0.0, [&](const int i) {
+            const Point p = previous[i];
+            out[i] = p + (smoothed(in, i, damping) - p) * omega;
+            return double(sqrnorm(out[i] - in[i]));
+        });
+    }
+};
+
+struct EnhanceStep {
+    typedef void Result;
+    int n;
+    const Point* in;
+    const Point* original;
+    Point* out;
+    Scalar damping;
+    Scalar coefficient;
+
+    template <typename Smoother>
+    void operator()(const Smoother& smoothed) const {
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; ++i) {
+            const Point p = original[i];
+            out[i] = p + (p - smoothed(in, i, damping)) * coefficient;
+        }
+    }
+};
+
+struct TaubinStep {
+    typedef double Result;
+    int n;
+    const Point* in;
+    Point* scratch;
+    Point* out;
+    Scalar lambda;
+    Scalar mu;
+
+    template <typename Smoother>
+    double operator()(const Smoother& smoothed) const {
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; ++i) scratch[i] = smoothed(in, i, lambda);
+        // the mu pass only reads in at its own vertex
+        return deterministic_sum(n, 0.0, [&](const int i) {
+            const Point p = smoothed(scratch, i, mu);
+            const double moved = sqrnorm(p - in[i]);
+            out[i] = p;
+            return moved;
+        });
+    }
+};
+
+struct GaussSeidelStep {
+    typedef double Result;
+    int n_colors;
+    const int* color_offsets;
+    const int* color_vertices;
+    Point* points;
+    Scalar damping;
+
+    template <typename Smoother>
+    double operator()(const Smoother& smoothed) const {
+        double moved = 0.0;
+        for (int c = 0; c < n_colors; ++c) {
+            const int* vertices = color_vertices + color_offsets[c];
+            moved += deterministic_sum(color_offsets[c + 1] - color_offsets[c], 0.0,
+                                       [&](const int j) {
+                const int i = vertices[j];
+                const Point p = smoothed(points, i, damping);
+                const double d = sqrnorm(p - points[i]);
+                points[i] = p;
+                return d;
+            });
+        }
+        return moved;
+    }
+};
+
+}
+
+double OneRingAdjacency::smooth_step(const Point* in, Point* out, const Scalar damping,
+                                     const bool weighted) const {
+    const SmoothStep step = { n_vertices(), in, out, damping };
+    return with_smoother(*this, weighted, step);
+}
+
+double OneRingAdjacency::accelerated_step(const Point* in, const Point* previous, Point* out,
+                                          const Scalar damping, const bool weighted,
+                                          const double omega) const {
+    const AcceleratedStep step = { n_vertices(), in, previous, out, damping, Scalar(omega) };
+    return with_smoother(*this, weighted, step);
+}
+
+void OneRingAdjacency::enhance_step(const Point* in, const Point* original, Point* out,
+                                    const Scalar damping, const bool weighted,
+                                    const Scalar coefficient) const {
+    const EnhanceStep step = { n_vertices(), in, original, out, damping, coefficient };
+    with_smoother(*this, weighted, step);
+}
+
+double OneRingAdjacency::taubin_step(const Point* in, Point* scratch, Point* out,
+                                     const Scalar lambda, const Scalar mu,
+                                     const bool weighted) const {
+    const TaubinStep step = { n_vertices(), in, scratch, out, lambda, mu };
+    return with_smoother(*this, weighted, step);
+}
+
+void OneRingAdjacency::build_colors() {
+    const int n = n_vertices();
+    std::vector<int> color(n, -1);
+    // last_seen[c] == i if a neighbor of i has color c
+    std::vector<int> last_seen;
+    int n_colors = 0;
+    for (int i = 0; i < n; ++i) {
+        if (!interior_[i]) continue;
+        for (int k = offsets_[i]; k < offsets_[i + 1]; ++k) {
+            const int c = color[neighbors_[k]];
+            if (c >= 0) last_seen[c] = i;
+        }
+        int c = 0;
+        while (c < n_colors && last_seen[c] == i) ++c;
+        if (c == n_colors) {
+            ++n_colors;
+            last_seen.push_back(-1);
+        }
+        color[i] = c;
+    }
+
+    // bucket the vertices by color, in index order within a color
+    color_offsets_.assign(n_colors + 1, 0);
+    for (int i = 0; i < n; ++i) {
+        if (color[i] >= 0) ++color_offsets_[color[i] + 1];
+    }
+    for (int c = 0; c < n_colors; ++c) color_offsets_[c + 1] += color_offsets_[c];
+    color_vertices_.resize(color_offsets_[n_colors]);
+    std::vector<int> next(color_offsets_.begin(), color_offsets_.end() - 1);
+    for (int i = 0; i < n; ++i) {
+        if (color[i] >= 0) color_vertices_[next[color[i]]++] = i;
+    }
+}
+
+double OneRingAdjacency::gauss_seidel_step(Point* points, const Scalar damping,
+                                           const bool weighted) const {
+    const GaussSeidelStep step = { n_colors(), color_offsets_.data(), color_vertices_.data(),
+                                   points, damping };
+    return with_smoother(*this, weighted, step);
+}
+
+}
@@ -0,0 +1,141 @@
+#ifndef ONE_RING_H
+#define ONE_RING_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <algorithm>
+#include <vector>
+
+namespace mesh_processing {
+
+// One-rings of a Surface_mesh in compressed sparse row layout: the neighbors
+// of vertex i are neighbors()[offsets()[i] .. offsets()[i+1]) in circulator
+// order, together with the edge to each neighbor and one weight slot per
+// entry. build() once per connectivity, the smoothing steps then run over
+// flat arrays instead of chasing halfedges.
+class OneRingAdjacency {
+
+public:
+    // a neighbor with the weight of the edge to it
+    struct Entry {
+        int neighbor;
+        surface_mesh::Scalar weight;
+    };
+
+    void build(const surface_mesh::Surface_mesh& mesh);
+    // the one-rings of the aggregates of fine, parent[v] being the coarse
+    // vertex of fine vertex v or -1: coarse vertices are neighbors if two of
+    // their fine vertices are, and interior if all of their fine vertices
+    // are. The edge slots are -1, the weights 1.
+    void build_coarse(const OneRingAdjacency& fine, const std::vector<int>& parent,
+                      const int n_coarse);
+    bool empty() const { return offsets_.empty(); }
+    int n_vertices() const { return int(offsets_.size()) - 1; }
+
+    // keeps an interleaved copy of the neighbors and the weight slots, which
+    // the weighted steps read instead: one 8-byte stream per entry in place
+    // of two 4-byte ones, so a vertex of valence 6 touches one cache line
+    // where it touched two. The separate arrays stay, the unweighted steps,
+    // the coarse levels and the GPU upload read them. Costs 8 bytes per
+    // entry and a second write when the weights change.
+    void set_interleaved(const bool interleaved);
+    bool interleaved() const { return interleaved_; }
+    // the interleaved entries, empty unless interleaved()
+    const std::vector<Entry>& entries() const { return entries_; }
+    // entries in ring order with the given per-edge weights, for operators
+    // that keep weights of their own
+    void gather_entries(const surface_mesh::Property_vector<surface_mesh::Scalar>& weight,
+                        std::vector<Entry>& entries) const;
+
+    // fill the weight slots from per-edge weights
+    void gather_edge_weights(const surface_mesh::Property_vector<surface_mesh::Scalar>& weight);
+    // all weight slots 1
+    void reset_weights();
+    // fine_i += the mean of coarse over the aggregates of vertex i and its
+    // neighbors, parent as in build_coarse() of the next coarser level;
+    // vertices that are not interior get the value of their own aggregate,
+    // so a fixed boundary stays fixed
+    void prolongate(const surface_mesh::Point* coarse, const std::vector<int>& parent,
+                    surface_mesh::Point* fine) const;
+    // no weights for the vertices on an edge with a nonzero feature value,
+    // so the weighted steps keep them where they are. Moving them along the
+    // crease instead folds the slivers of scanned meshes, whose noise is
+    // detected as short creases.
+    void restrict_to_features(const surface_mesh::Surface_mesh::Edge_property<surface_mesh::Scalar>& feature);
+
+    // out_i = in_i + damping * sum_k w_k (in_k - in_i) / sum_k w_k over the
+    // neighbors k of interior vertices, with the weight slots or w_k = 1 if
+    // not weighted; boundary and deleted vertices are copied, as are
+    // vertices whose weights sum to 0. Returns sum_i |out_i - in_i|^2.
+    // The steps share one kernel, compiled for each of the uniform, slot
+    // and interleaved weights and for closed() rings or not.
+    double smooth_step(const surface_mesh::Point* in, surface_mesh::Point* out,
+                       const surface_mesh::Scalar damping, const bool weighted) const;
+    // out_i = previous_i + omega * (s_i - previous_i), s being the
+    // smooth_step() of in: a step of the Chebyshev semi-iteration with
+    // previous the iterate before in; out may alias previous, not in.
+    // Returns the displacement like smooth_step().
+    double accelerated_step(const surface_mesh::Point* in, const surface_mesh::Point* previous,
+                            surface_mesh::Point* out, const surface_mesh::Scalar damping,
+                            const bool weighted, const double omega) const;
+    // out_i = original_i + coefficient * (original_i - s_i) in the same pass,
+    // s being the smooth_step() of in; out may alias original, not in
+    void enhance_step(const surface_mesh::Point* in, const surface_mesh::Point* original,
+                      surface_mesh::Point* out, const surface_mesh::Scalar damping,
+                      const bool weighted, const surface_mesh::Scalar coefficient) const;
+    // out_i = t_i + mu * L(t)_i with t_i = in_i + lambda * L(in)_i, the
+    // lambda|mu pair of Taubin's smoothing with L the Laplacian of
+    // smooth_step(): lambda > 0 smooths, mu < -lambda grows the low
+    // frequencies back, so the shape keeps its volume. The two passes run
+    // back to back over scratch; out may alias in, not scratch. Returns
+    // sum_i |out_i - in_i|^2.
+    double taubin_step(const surface_mesh::Point* in, surface_mesh::Point* scratch,
+                       surface_mesh::Point* out, const surface_mesh::Scalar lambda,
+                       const surface_mesh::Scalar mu, const bool weighted) const;
+
+    // greedy coloring of the interior vertices in index order, no two
+    // neighbors share a color; valence 6 meshes need 4 to 7 colors. build()
+    // drops it.
+    void build_colors();
+    int n_colors() const { return color_offsets_.empty() ? 0 : int(color_offsets_.size()) - 1; }
+    // smooth_step() in place, one color after the other: a vertex sees the
+    // new positions of the neighbors of the colors before its own. With
+    // damping 1 that takes the low frequencies down about twice as fast per
+    // sweep as the Jacobi step with damping 1, and needs no second buffer;
+    // damping it gives most of that away. The vertices of a color are
+    // independent, so the result does not depend on the number of threads.
+    // Needs build_colors(). Returns the displacement like smooth_step().
+    double gauss_seidel_step(surface_mesh::Point* points, const surface_mesh::Scalar damping,
+                             const bool weighted) const;
+
+    const std::vector<int>& offsets() const { return offsets_; }
+    const std::vector<int>& neighbors() const { return neighbors_; }
+    const std::vector<int>& edges() const { return edges_; }
+    const std::vector<surface_mesh::Scalar>& weights() const { return weights_; }
+    // 1 for the vertices smooth_step() moves
+    const std::vector<unsigned char>& interior() const { return interior_; }
+    // every vertex is interior: no boundary, deleted or isolated vertices
+    bool closed() const { return closed_; }
+    // bytes reserved by the arrays
+    size_t memory_usage() const;
+
+private:
+    // entries_ from neighbors_ and weights_ if interleaved_
+    void interleave();
+
+    std::vector<int> offsets_;
+    std::vector<int> neighbors_;
+    std::vector<int> edges_;
+    std::vector<surface_mesh::Scalar> weights_;
+    // interior vertices are smoothed, the others keep their position
+    std::vector<unsigned char> interior_;
+    bool closed_ = false;
+    bool interleaved_ = false;
+    std::vector<Entry> entries_;
+    // the vertices of color c are
+    // color_vertices_[color_offsets_[c] .. color_offsets_[c+1])
+    std::vector<int> color_offsets_, color_vertices_;
+};
+
+}
+
+#endif // ONE_RING_H
@@ -0,0 +1,185 @@
+#include "pipeline.h"
+#include <surface_mesh/Trace.h>
+
+namespace mesh_processing {
+
+Pipeline& Pipeline::add(const Stage::TYPE type, const unsigned int iterations,
+                        const double timestep, const float coefficient) {
+    Stage stage = { type, iterations, timestep, coefficient, POSITIONS, POSITIONS, nullptr };
+    stages_.push_back(stage);
+    return *this;
+}
+
+Pipeline& Pipeline::uniform_smooth(const unsigned int iterations) {
+    return add(Stage::UNIFORM_SMOOTH, iterations);
+}
+
+Pipeline& Pipeline::smooth(const unsigned int iterations) {
+    return add(Stage::SMOOTH, iterations);
+}
+
+Pipeline& Pipeline::feature_preserving_smooth(const unsigned int iterations) {
+    return add(Stage::FEATURE_SMOOTH, iterations);
+}
+
+Pipeline& Pipeline::multiresolution_smooth(const unsigned int iterations) {
+    return add(Stage::MULTIRESOLUTION_SMOOTH, iterations);
+}
+
+Pipeline& Pipeline::taubin_smooth(const unsigned int iterations) {
+    return add(Stage::TAUBIN_SMOOTH, iterations);
+}
+
+Pipeline& Pipeline::implicit_smoothing(const double timestep) {
+    return add(Stage::IMPLICIT_SMOOTHING, 1, timestep);
+}
+
+Pipeline& Pipeline::minimal_surface() {
+    return add(Stage::MINIMAL_SURFACE, 1);
+}
+
+Pipeline& Pipeline::uniform_enhance(const unsigned int iterations, const float coefficient) {
+    return add(Stage::UNIFORM_ENHANCE, iterations, 0.0, coefficient);
+}
+
+Pipeline& Pipeline::laplace_beltrami_enhance(const unsigned int iterations,
+                                             const float coefficient) {
+    return add(Stage::LAPLACE_BELTRAMI_ENHANCE, iterations, 0.0, coefficient);
+}
+
+Pipeline& Pipeline::custom(const unsigned int reads, const unsigned int writes,
+                           const std::function<void(MeshProcessing&)>& task) {
+    Stage stage = { Stage::CUSTOM, 0, 0.0, 0.0f, reads, writes, task };
+    stages_.push_back(stage);
+    return *this;
+}
+
+// true if a followed by b moves the vertices like one call with the
+// iterations of both. The tolerance is relative to the first iteration of
+// a call and the volume is restored after every call, so neither merges
+static bool mergeable(const Pipeline::Stage& a, const Pipeline::Stage& b,
+                      const MeshProcessing& mesh) {
+    if (a.type != b.type) return false;
+    if (mesh.get_smoothing_tolerance() > 0.0f || mesh.get_volume_preservation()) return false;
+    switch (a.type) {
+    case Pipeline::Stage::UNIFORM_SMOOTH:
+        // the Chebyshev steps follow from the iteration count
+        return !mesh.get_chebyshev_smoothing();
+    case Pipeline::Stage::TAUBIN_SMOOTH:
+        return true;
+    case Pipeline::Stage::SMOOTH:
+        // b starts with a weight update, which the merged call has to do at
+        // the same iteration
+        return a.iterations % mesh.get_weight_update_interval() == 0;
+    default:
+        // the features and the levels are set up per call, the solves and
+        // the enhancements are no sequence of equal steps
+        return false;
+    }
+}
+
+std::vector<Pipeline::Stage> Pipeline::plan(const MeshProcessing& mesh) const {
+    std::vector<Stage> stages;
+    for (const Stage& stage : stages_) {
+        if (!stages.empty() && mergeable(stages.back(), stage, mesh)) {
+            stages.back().iterations += stage.iterations;
+        } else {
+            stages.push_back(stage);
+        }
+    }
+    return stages;
+}
+
+// the attributes of data up to date with the positions, each computed once
+// per geometry change by the lazy getters
+static void update(MeshProcessing& mesh, const unsigned int data) {
+    if (data & Pipeline::NORMALS) mesh.get_normals();
+    if (data & (Pipeline::CURVATURES | Pipeline::PRINCIPAL_CURVATURES)) {
+        mesh.compute_attributes((data & Pipeline::PRINCIPAL_CURVATURES) != 0);
+    }
+}
+
+static void execute(MeshProcessing& mesh, const Pipeline::Stage& stage) {
+    switch (stage.type) {
+    case Pipeline::Stage::UNIFORM_SMOOTH:
+        mesh.uniform_smooth(stage.iterations);
+        break;
+    case Pipeline::Stage::SMOOTH:
+        mesh.smooth(stage.iterations);
+        break;
+    case Pipeline::Stage::FEATURE_SMOOTH:
+        mesh.feature_preserving_smooth(stage.iterations);
+        break;
+    case Pipeline::Stage::MULTIRESOLUTION_SMOOTH:
+        mesh.multiresolution_smooth(stage.iterations);
+        break;
+    case Pipeline::Stage::TAUBIN_SMOOTH:
+        mesh.taubin_smooth(stage.iterations);
+        break;
+    case Pipeline::Stage::IMPLICIT_SMOOTHING:
+        mesh.implicit_smoothing(stage.timestep);
+        break;
+    case Pipeline::Stage::MINIMAL_SURFACE:
+        mesh.minimal_surface();
+        break;
+    case Pipeline::Stage::UNIFORM_ENHANCE:
+        mesh.uniform_laplacian_enhance_feature(stage.iterations, stage.coefficient);
+        break;
+    case Pipeline::Stage::LAPLACE_BELTRAMI_ENHANCE:
+        mesh.laplace_beltrami_enhance_feature(stage.iterations, stage.coefficient);
+        break;
+    case Pipeline::Stage::CUSTOM:
+        stage.task(mesh);
+        break;
+    }
+}
+
+void Pipeline::run(MeshProcessing& mesh, const unsigned int outputs) const {
+    SURFACE_MESH_TRACE_ZONE("pipeline");
+    static const unsigned int ATTRIBUTES = NORMALS | CURVATURES | PRINCIPAL_CURVATURES;
+    const std::vector<Stage> stages = plan(mesh);
+    const size_t n = stages.size();
+    // the positions changed since the last compute_mesh_properties()
+    bool moved = false;
+    for (size_t i = 0; i < n; ) {
+        // custom stages that leave the vertices alone join the group of
+        // their predecessors while they do not conflict with them
+        size_t end = i + 1;
+        unsigned int reads = stages[i].reads, writes = stages[i].writes;
+        if (stages[i].type == Stage::CUSTOM && !(writes & POSITIONS)) {
+            while (end < n && stages[end].type == Stage::CUSTOM &&
+                   !(stages[end].writes & (POSITIONS | reads | writes)) &&
+                   !(stages[end].reads & writes)) {
+                reads |= stages[end].reads;
+                writes |= stages[end].writes;
+                ++end;
+            }
+        }
+
+        // the attributes the group reads, before it runs, so that its
+        // stages only read the mesh
+        if (reads & ATTRIBUTES) {
+            if (moved) mesh.compute_mesh_properties();
+            moved = false;
+            update(mesh, reads);
+        }
+
+        const int width = int(end - i);
+        if (width == 1) {
+            execute(mesh, stages[i]);
+        } else {
+#pragma omp parallel for schedule(dynamic, 1) num_threads(width)
+            for (int k = 0; k < width; ++k) {
+                stages[i + k].task(mesh);
+            }
+        }
+        if (writes & POSITIONS) moved = true;
+        if (mesh.stopped()) break;
+        i = end;
+    }
+
+    if (moved) mesh.compute_mesh_properties();
+    update(mesh, outputs);
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "mesh_processing.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mesh_processing {
+
+// A recipe of MeshProcessing operations that runs as one unit instead of a
+// chain of calls with compute_mesh_properties() after each. Every stage
+// declares the data it reads and writes; run()
+//  - merges neighbouring runs of the same smoothing operator into one call,
+//    where that gives the same positions, so its buffers, weights and
+//    reductions are set up once,
+//  - marks the attributes dirty and records the undo step once at the end,
+//    and only brings the attributes up to date that a later stage reads or
+//    the caller asks for,
+//  - runs neighbouring custom stages side by side when neither writes what
+//    the other reads or writes.
+// The operators all move the vertices, so only custom stages, e.g. exports
+// and measurements, run concurrently.
+class Pipeline {
+
+public:
+    // what a stage reads and writes
+    enum DATA : unsigned int {
+        POSITIONS = 1 << 0,
+        NORMALS = 1 << 1,
+        CURVATURES = 1 << 2,            // the scalars of the curvature colorings
+        PRINCIPAL_CURVATURES = 1 << 3,  // and their directions
+        // per-stage data of custom stages, never touched by the operators
+        USER = 1 << 8
+    };
+
+    struct Stage {
+        enum TYPE : int { UNIFORM_SMOOTH, SMOOTH, FEATURE_SMOOTH, MULTIRESOLUTION_SMOOTH,
+                          TAUBIN_SMOOTH, IMPLICIT_SMOOTHING, MINIMAL_SURFACE, UNIFORM_ENHANCE,
+                          LAPLACE_BELTRAMI_ENHANCE, CUSTOM };
+        TYPE type;
+        unsigned int iterations;
+        double timestep;     // IMPLICIT_SMOOTHING
+        float coefficient;   // the enhancements
+        unsigned int reads;
+        unsigned int writes;
+        // CUSTOM, called with the mesh whose reads are up to date
+        std::function<void(MeshProcessing&)> task;
+    };
+
+    Pipeline& uniform_smooth(const unsigned int iterations);
+    Pipeline& smooth(const unsigned int iterations);
+    Pipeline& feature_preserving_smooth(const unsigned int iterations);
+    Pipeline& multiresolution_smooth(const unsigned int iterations);
+    Pipeline& taubin_smooth(const unsigned int iterations);
+    Pipeline& implicit_smoothing(const double timestep);
+    Pipeline& minimal_surface();
+    Pipeline& uniform_enhance(const unsigned int iterations, const float coefficient);
+    Pipeline& laplace_beltrami_enhance(const unsigned int iterations, const float coefficient);
+    // a stage of the caller; a task that writes POSITIONS moves the vertices
+    // through MeshProcessing::get_mesh(), reads and writes of USER bits
+    // order the custom stages among each other
+    Pipeline& custom(const unsigned int reads, const unsigned int writes,
+                     const std::function<void(MeshProcessing&)>& task);
+
+    const std::vector<Stage>& stages() const { return stages_; }
+    bool empty() const { return stages_.empty(); }
+
+    // the stages run() executes for mesh, after merging
+    std::vector<Stage> plan(const MeshProcessing& mesh) const;
+    // runs the stages on mesh and leaves the outputs up to date, any of
+    // NORMALS, CURVATURES and PRINCIPAL_CURVATURES; stops after the stage
+    // during which the progress of the mesh was cancelled or expired
+    void run(MeshProcessing& mesh, const unsigned int outputs = 0) const;
+
+private:
+    Pipeline& add(const Stage::TYPE type, const unsigned int iterations,
+                  const double timestep = 0.0, const float coefficient = 0.0f);
+
+    std::vector<Stage> stages_;
+};
+
+}
+
+#endif // PIPELINE_H
@@ -0,0 +1,157 @@
+#include "position_history.h"
+#include <cstring>
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Property_vector;
+
+// float words per position
+static const size_t WORDS = sizeof(Point) / sizeof(uint32_t);
+
+static void put_varint(uint32_t value, std::vector<uint8_t>& out) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+static uint32_t get_varint(const uint8_t*& p) {
+    uint32_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        const uint8_t byte = *p++;
+        value |= uint32_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+}
+
+void PositionHistory::reset(const Property_vector<Point>& points) {
+    state_.resize(points.size() * WORDS);
+    if (!points.empty()) memcpy(&state_[0], &points[0], state_.size() * sizeof(uint32_t));
+    undo_.clear();
+    redo_.clear();
+    memory_ = 0;
+}
+
+bool PositionHistory::push(const Property_vector<Point>& points, std::vector<int>* moved) {
+    if (points.size() * WORDS != state_.size()) {
+        // a different mesh, the steps do not apply to it anymore
+        reset(points);
+        return false;
+    }
+
+    Delta delta;
+    encode(points, delta);
+    if (delta.empty()) return false;
+
+    apply(delta);
+    if (moved) changed_positions(delta, *moved);
+    for (size_t i = 0; i < redo_.size(); ++i) memory_ -= redo_[i].size();
+    redo_.clear();
+    memory_ += delta.size();
+    undo_.push_back(Delta());
+    undo_.back().swap(delta);
+    enforce_budget();
+    return true;
+}
+
+bool PositionHistory::undo(Property_vector<Point>& points, std::vector<int>* moved) {
+    if (undo_.empty()) return false;
+    apply(undo_.back());
+    if (moved) changed_positions(undo_.back(), *moved);
+    redo_.push_back(Delta());
+    redo_.back().swap(undo_.back());
+    undo_.pop_back();
+    get_state(points);
+    return true;
+}
+
+bool PositionHistory::redo(Property_vector<Point>& points, std::vector<int>* moved) {
+    if (redo_.empty()) return false;
+    apply(redo_.back());
+    if (moved) changed_positions(redo_.back(), *moved);
+    undo_.push_back(Delta());
+    undo_.back().swap(redo_.back());
+    redo_.pop_back();
+    get_state(points);
+    return true;
+}
+
+void PositionHistory::set_budget(const size_t budget) {
+    budget_ = budget;
+    enforce_budget();
+}
+
+// a nonzero word is written as its varint, a run of zero words as a zero
+// byte followed by the run length; a step without changes is empty
+void PositionHistory::encode(const Property_vector<Point>& points, Delta& delta) const {
+    const size_t n = state_.size();
+    delta.clear();
+    if (n == 0) return;
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(&points[0]);
+
+    delta.reserve(n);
+    bool changed = false;
+    for (size_t i = 0; i < n; ) {
+        const uint32_t x = state_[i] ^ words[i];
+        if (x != 0) {
+            put_varint(x, delta);
+            changed = true;
+            ++i;
+            continue;
+        }
+        size_t run = 1;
+        while (i + run < n && state_[i + run] == words[i + run] && run < 0xffffffffu) ++run;
+        delta.push_back(0);
+        put_varint(uint32_t(run), delta);
+        i += run;
+    }
+    if (!changed) delta.clear();
+    Delta(delta).swap(delta);
+}
+
+void PositionHistory::apply(const Delta& delta) {
+    const uint8_t* p = delta.empty() ? nullptr : &delta[0];
+    const uint8_t* end = p + delta.size();
+    size_t i = 0;
+    while (p != end) {
+        if (*p == 0) {
+            ++p;
+            i += get_varint(p);
+        } else {
+            state_[i++] ^= get_varint(p);
+        }
+    }
+}
+
+void PositionHistory::changed_positions(const Delta& delta, std::vector<int>& moved) {
+    moved.clear();
+    const uint8_t* p = delta.empty() ? nullptr : &delta[0];
+    const uint8_t* end = p + delta.size();
+    size_t i = 0;
+    while (p != end) {
+        if (*p == 0) {
+            ++p;
+            i += get_varint(p);
+        } else {
+            get_varint(p);
+            const int v = int(i++ / WORDS);
+            if (moved.empty() || moved.back() != v) moved.push_back(v);
+        }
+    }
+}
+
+void PositionHistory::get_state(Property_vector<Point>& points) const {
+    points.resize(state_.size() / WORDS);
+    if (!points.empty()) memcpy(&points[0], &state_[0], state_.size() * sizeof(uint32_t));
+}
+
+void PositionHistory::enforce_budget() {
+    while (memory_ > budget_ && !undo_.empty()) {
+        memory_ -= undo_.front().size();
+        undo_.pop_front();
+    }
+}
+
+}
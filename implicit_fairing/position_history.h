@@ -0,0 +1,66 @@
+#ifndef POSITION_HISTORY_H
+#define POSITION_HISTORY_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace mesh_processing {
+
+// Undo/redo history of the vertex positions of a mesh whose connectivity does
+// not change. Only the current state is stored in full, every step keeps the
+// XOR of the float bits of two consecutive states. Positions that did not
+// move give zero words, and small moves leave the sign, exponent and upper
+// mantissa bits equal, so the steps are encoded as varints with run lengths
+// for zeros. The XOR of a step undoes and redoes it alike, nothing is lost.
+class PositionHistory {
+
+public:
+    // the oldest steps are dropped once the steps use more than budget bytes
+    explicit PositionHistory(const size_t budget = size_t(256) << 20)
+        : budget_(budget), memory_(0) {}
+
+    // forget all steps, points becomes the current state
+    void reset(const surface_mesh::Property_vector<surface_mesh::Point>& points);
+    // record points as the new current state, clears the redo steps;
+    // returns false if nothing changed. moved, if given, receives the
+    // ascending indices of the positions that changed
+    bool push(const surface_mesh::Property_vector<surface_mesh::Point>& points,
+              std::vector<int>* moved = nullptr);
+    // step back or forward, points receives the new current state and
+    // moved the indices as for push()
+    bool undo(surface_mesh::Property_vector<surface_mesh::Point>& points,
+              std::vector<int>* moved = nullptr);
+    bool redo(surface_mesh::Property_vector<surface_mesh::Point>& points,
+              std::vector<int>* moved = nullptr);
+
+    bool can_undo() const { return !undo_.empty(); }
+    bool can_redo() const { return !redo_.empty(); }
+    void set_budget(const size_t budget);
+    // bytes used by the encoded steps
+    size_t memory_usage() const { return memory_; }
+    // bytes of the copy of the current state
+    size_t state_memory() const { return state_.capacity() * sizeof(uint32_t); }
+
+private:
+    typedef std::vector<uint8_t> Delta;
+
+    void encode(const surface_mesh::Property_vector<surface_mesh::Point>& points, Delta& delta) const;
+    // XORs delta into state_
+    void apply(const Delta& delta);
+    // the positions with nonzero words in delta
+    static void changed_positions(const Delta& delta, std::vector<int>& moved);
+    void get_state(surface_mesh::Property_vector<surface_mesh::Point>& points) const;
+    void enforce_budget();
+
+    std::vector<uint32_t> state_;
+    std::deque<Delta> undo_;
+    std::vector<Delta> redo_;
+    size_t budget_;
+    size_t memory_;
+};
+
+}
+
+#endif // POSITION_HISTORY_H
@@ -0,0 +1,108 @@
+#include "progressive_buffers.h"
+#include "vertex_packing.h"
+
+namespace mesh_processing {
+
+bool ProgressiveBuffers::open(const std::string& filename) {
+    close();
+    file_.open(filename.c_str(), std::ios::binary);
+    return file_.is_open();
+}
+
+void ProgressiveBuffers::close() {
+    if (buffers_[POSITIONS] != 0) glDeleteBuffers(N_BUFFERS, buffers_);
+    buffers_[POSITIONS] = buffers_[INDICES] = 0;
+    file_.close();
+    file_.clear();
+    decoder_.clear();
+    std::vector<char>().swap(chunk_);
+}
+
+size_t ProgressiveBuffers::bytes() const {
+    if (buffers_[POSITIONS] == 0) return 0;
+    return size_t(decoder_.total_vertices()) * 3 * sizeof(uint16_t) +
+           size_t(decoder_.total_faces()) * 3 * sizeof(uint32_t);
+}
+
+bool ProgressiveBuffers::poll(const size_t bytes) {
+    if (!file_.is_open() || decoder_.complete() || decoder_.failed()) return false;
+    chunk_.resize(bytes);
+    file_.read(chunk_.data(), std::streamsize(bytes));
+    const size_t n = size_t(file_.gcount());
+    // at the end for now, the next poll tries again
+    if (!file_) file_.clear();
+    if (n == 0 || !decoder_.consume(chunk_.data(), n) || !decoder_.has_base()) return false;
+    upload();
+    return true;
+}
+
+// consecutive entries of the sorted list as (first, count), then the range
+// from end on
+template <class Upload>
+static void upload_runs(const std::vector<uint32_t>& list, const int end, const int size,
+                        const Upload& upload) {
+    for (size_t i = 0; i < list.size();) {
+        size_t j = i + 1;
+        while (j < list.size() && list[j] == list[j - 1] + 1) ++j;
+        upload(int(list[i]), int(list[j - 1] - list[i]) + 1);
+        i = j;
+    }
+    if (size > end) upload(end, size - end);
+}
+
+void ProgressiveBuffers::upload() {
+    decoder_.take_changes(changes_);
+    // written through the copy target, which leaves the element array of
+    // the bound vertex array alone
+    if (buffers_[POSITIONS] == 0) {
+        const surface_mesh::Point& min = decoder_.box_min();
+        const surface_mesh::Point& max = decoder_.box_max();
+        box_min_ = Eigen::Vector3f(min[0], min[1], min[2]);
+        box_extent_ = Eigen::Vector3f(max[0], max[1], max[2]) - box_min_;
+        glGenBuffers(N_BUFFERS, buffers_);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers_[POSITIONS]);
+        glBufferData(GL_COPY_WRITE_BUFFER, size_t(decoder_.total_vertices()) * 3 * sizeof(uint16_t),
+                     nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers_[INDICES]);
+        glBufferData(GL_COPY_WRITE_BUFFER, size_t(decoder_.total_faces()) * 3 * sizeof(uint32_t),
+                     nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    const std::vector<float>& positions = decoder_.positions();
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers_[POSITIONS]);
+    PackedPositions packed;
+    upload_runs(changes_.vertices, changes_.first_vertex, decoder_.n_vertices(),
+                [&](const int first, const int count) {
+        const Eigen::Map<const Eigen::Matrix3Xf> points(&positions[3 * size_t(first)], 3, count);
+        pack_positions_in_box(points, box_min_, box_extent_, packed);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(first) * 3 * sizeof(uint16_t),
+                        size_t(count) * 3 * sizeof(uint16_t), packed.data());
+    });
+
+    const std::vector<uint32_t>& indices = decoder_.indices();
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers_[INDICES]);
+    upload_runs(changes_.faces, changes_.first_face, decoder_.n_faces(),
+                [&](const int first, const int count) {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(first) * 3 * sizeof(uint32_t),
+                        size_t(count) * 3 * sizeof(uint32_t), &indices[3 * size_t(first)]);
+    });
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void ProgressiveBuffers::draw(nanogui::GLShader& shader) {
+    if (buffers_[POSITIONS] == 0 || decoder_.n_faces() == 0) return;
+    // the packed positions as uploadAttrib() declares them
+    const GLint position = shader.attrib("position", false);
+    if (position >= 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers_[POSITIONS]);
+        glEnableVertexAttribArray(position);
+        glVertexAttribPointer(position, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers_[INDICES]);
+    shader.setUniform("box_min", box_min_);
+    shader.setUniform("box_extent", box_extent_);
+    glDrawElements(GL_TRIANGLES, GLsizei(decoder_.n_faces()) * 3, GL_UNSIGNED_INT, 0);
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef PROGRESSIVE_BUFFERS_H
+#define PROGRESSIVE_BUFFERS_H
+
+#include <nanogui/glutil.h>
+#include <Eigen/Core>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "progressive_mesh.h"
+
+namespace mesh_processing {
+
+// A progressive mesh file drawn while it is read: every poll() decodes the
+// next bytes, the base is drawn as soon as it arrived and refined by the
+// splits that came in since. The vertex and index buffers are allocated for
+// the full mesh from the header and the positions packed against the bounds
+// of all positions in the file, so a poll uploads the appended vertices and
+// faces as one range each and rewrites only the few earlier ones the splits
+// changed. There are no normals, the shader shades the faces flat. Needs a
+// current GL context for all calls but the accessors.
+class ProgressiveBuffers {
+
+public:
+    ~ProgressiveBuffers() { close(); }
+
+    // false if filename cannot be opened
+    bool open(const std::string& filename);
+    // frees the buffers and closes the file
+    void close();
+    bool is_open() const { return file_.is_open(); }
+
+    // reads up to bytes more of the file and uploads what they changed;
+    // true if the mesh to draw changed. A file that ends early is read on
+    // from there by the next poll, e.g. one that is still being copied.
+    bool poll(const size_t bytes);
+    const ProgressiveMeshDecoder& decoder() const { return decoder_; }
+    // bytes of the vertex and index buffers on the GPU
+    size_t bytes() const;
+
+    // the mesh decoded so far with shader, which is bound and has the
+    // uniforms but box_min and box_extent set
+    void draw(nanogui::GLShader& shader);
+
+private:
+    enum { POSITIONS = 0, INDICES = 1, N_BUFFERS = 2 };
+
+    // the changes of the decoder into the buffers
+    void upload();
+
+    std::ifstream file_;
+    std::vector<char> chunk_;
+    ProgressiveMeshDecoder decoder_;
+    ProgressiveMeshDecoder::Changes changes_;
+    Eigen::Vector3f box_min_ = Eigen::Vector3f::Zero();
+    Eigen::Vector3f box_extent_ = Eigen::Vector3f::Zero();
+    // 0 until the base arrived
+    GLuint buffers_[N_BUFFERS] = { 0, 0 };
+};
+
+}
+
+#endif // PROGRESSIVE_BUFFERS_H
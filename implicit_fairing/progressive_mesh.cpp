@@ -0,0 +1,336 @@
+#include "progressive_mesh.h"
+#include "decimation.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+typedef surface_mesh::Surface_mesh Mesh;
+
+static const char progressive_magic[8] = { 'G', 'P', 'P', 'R', 'O', 'G', '0', '1' };
+
+// followed by the base positions, 3 floats per vertex, the base faces, 3
+// uint32 per face, and the splits
+struct ProgressiveHeader {
+    char magic[8];
+    uint32_t base_vertices, base_faces;
+    uint32_t n_vertices, n_faces, n_splits;
+    float box_min[3], box_max[3];
+};
+
+// followed by 3 uint32 vertex indices per added face and a uint32 face
+// index per moved face; the new vertex is the next one, the added faces are
+// the next ones
+struct SplitHeader {
+    // the vertex that is split, it moves back to position
+    uint32_t vertex;
+    uint32_t n_added, n_moved;
+    float position[3];
+    float new_position[3];
+};
+
+// one collapse replayed on the face list, in the numbering of the mesh
+struct Split {
+    int kept, removed;
+    Point kept_position, removed_position;
+    // the faces the collapse removed and their corners in face order
+    std::vector<int> added, added_corners;
+    // the faces it rewrote from removed to kept
+    std::vector<int> moved;
+};
+
+bool write_progressive_mesh(const Mesh& mesh, const std::string& filename,
+                            const unsigned int base_faces) {
+    if (!mesh.is_triangle_mesh()) return false;
+    Mesh base;
+    base.assign(mesh);
+    DecimationOptions options;
+    options.target_faces = base_faces;
+    std::vector<EdgeCollapse> collapses;
+    decimate(base, options, nullptr, &collapses);
+
+    // the faces every collapse removed and those it rewrote from removed to
+    // kept, from the collapses again on the face list
+    const int nv = mesh.vertices_size(), nf = mesh.faces_size();
+    std::vector<Point> positions(mesh.points().begin(), mesh.points().end());
+    std::vector<int> corners(3 * size_t(nf), -1);
+    std::vector<std::vector<int> > vertex_faces(nv);
+    for (auto f: mesh.faces()) {
+        int k = 0;
+        for (auto v: mesh.vertices(f)) {
+            corners[3 * f.idx() + k++] = v.idx();
+            vertex_faces[v.idx()].push_back(f.idx());
+        }
+    }
+    std::vector<Split> splits(collapses.size());
+    for (size_t i = 0; i < collapses.size(); ++i) {
+        const EdgeCollapse& c = collapses[i];
+        Split& split = splits[i];
+        split.kept = c.kept;
+        split.removed = c.removed;
+        split.kept_position = positions[c.kept];
+        split.removed_position = positions[c.removed];
+        // the faces of removed are those it was given, none of kept twice
+        for (const int f: vertex_faces[c.removed]) {
+            int* face = &corners[3 * size_t(f)];
+            if (face[0] < 0) continue;
+            if (face[0] == c.kept || face[1] == c.kept || face[2] == c.kept) {
+                split.added.push_back(f);
+                split.added_corners.insert(split.added_corners.end(), face, face + 3);
+                face[0] = face[1] = face[2] = -1;
+            }
+            else {
+                std::replace(face, face + 3, c.removed, c.kept);
+                split.moved.push_back(f);
+                vertex_faces[c.kept].push_back(f);
+            }
+        }
+        if (split.added.empty() || split.added.size() > 2) return false;
+        std::vector<int>().swap(vertex_faces[c.removed]);
+        positions[c.kept] = c.position;
+    }
+
+    // the base in the order of the mesh, then the vertex and the faces of
+    // every split in the order the splits are applied
+    std::vector<uint32_t> vertex_id(nv, 0), face_id(nf, 0);
+    std::vector<char> removed(nv, 0);
+    for (const Split& split: splits) removed[split.removed] = 1;
+    std::vector<float> base_positions;
+    std::vector<uint32_t> base_indices;
+    uint32_t n_vertices = 0, n_faces = 0;
+    Point box_min(std::numeric_limits<float>::max());
+    Point box_max(-std::numeric_limits<float>::max());
+    for (auto v: mesh.vertices()) {
+        if (removed[v.idx()]) continue;
+        vertex_id[v.idx()] = n_vertices++;
+        const Point& p = positions[v.idx()];
+        base_positions.insert(base_positions.end(), p.data(), p.data() + 3);
+        box_min.minimize(p);
+        box_max.maximize(p);
+    }
+    for (auto f: mesh.faces()) {
+        const int* face = &corners[3 * size_t(f.idx())];
+        if (face[0] < 0) continue;
+        face_id[f.idx()] = n_faces++;
+        for (int k = 0; k < 3; ++k) base_indices.push_back(vertex_id[face[k]]);
+    }
+
+    ProgressiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, progressive_magic, sizeof(header.magic));
+    header.base_vertices = n_vertices;
+    header.base_faces = n_faces;
+    header.n_splits = uint32_t(splits.size());
+    std::vector<char> records;
+    for (size_t i = splits.size(); i-- > 0;) {
+        const Split& split = splits[i];
+        vertex_id[split.removed] = n_vertices++;
+        for (const Point& p: { split.kept_position, split.removed_position }) {
+            box_min.minimize(p);
+            box_max.maximize(p);
+        }
+        SplitHeader record;
+        record.vertex = vertex_id[split.kept];
+        record.n_added = uint32_t(split.added.size());
+        record.n_moved = uint32_t(split.moved.size());
+        std::copy(split.kept_position.data(), split.kept_position.data() + 3, record.position);
+        std::copy(split.removed_position.data(), split.removed_position.data() + 3,
+                  record.new_position);
+        // the moved faces are there before the split, the vertices of the
+        // added ones as well but for the new vertex
+        std::vector<uint32_t> ids;
+        for (const int v: split.added_corners) ids.push_back(vertex_id[v]);
+        for (const int f: split.moved) ids.push_back(face_id[f]);
+        for (const int f: split.added) face_id[f] = n_faces++;
+        const char* bytes = reinterpret_cast<const char*>(&record);
+        records.insert(records.end(), bytes, bytes + sizeof(record));
+        bytes = reinterpret_cast<const char*>(ids.data());
+        records.insert(records.end(), bytes, bytes + ids.size() * sizeof(uint32_t));
+    }
+    header.n_vertices = n_vertices;
+    header.n_faces = n_faces;
+    if (n_vertices == 0) box_min = box_max = Point(0.0f);
+    std::copy(box_min.data(), box_min.data() + 3, header.box_min);
+    std::copy(box_max.data(), box_max.data() + 3, header.box_max);
+
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(base_positions.data(), sizeof(float), base_positions.size(), file) ==
+                  base_positions.size() &&
+              std::fwrite(base_indices.data(), sizeof(uint32_t), base_indices.size(), file) ==
+                  base_indices.size() &&
+              std::fwrite(records.data(), 1, records.size(), file) == records.size();
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
+
+bool read_progressive_mesh(Mesh& mesh, const std::string& filename) {
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in) return false;
+    ProgressiveMeshDecoder decoder;
+    std::vector<char> buffer(1 << 20);
+    while (in) {
+        in.read(buffer.data(), std::streamsize(buffer.size()));
+        if (!decoder.consume(buffer.data(), size_t(in.gcount()))) return false;
+    }
+    if (!decoder.complete()) return false;
+    decoder.get_mesh(mesh);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void ProgressiveMeshDecoder::clear() {
+    pending_.clear();
+    failed_ = has_header_ = has_base_ = false;
+    base_vertices_ = base_faces_ = 0;
+    total_vertices_ = total_faces_ = total_splits_ = 0;
+    n_splits_ = 0;
+    box_min_ = box_max_ = Point(0.0f);
+    positions_.clear();
+    indices_.clear();
+    changes_ = Changes();
+}
+
+bool ProgressiveMeshDecoder::consume(const char* data, const size_t size) {
+    if (failed_) return false;
+    // the bytes that did not make a record last time first
+    if (!pending_.empty()) {
+        pending_.insert(pending_.end(), data, data + size);
+        data = pending_.data();
+    }
+    const size_t end = pending_.empty() ? size : pending_.size();
+    size_t offset = 0;
+    while (!failed_ && !complete()) {
+        const size_t used = has_base_ ? decode_split(data + offset, end - offset)
+                                      : decode_base(data + offset, end - offset);
+        if (used == 0) break;
+        offset += used;
+    }
+    if (failed_) return false;
+    // trailing bytes after the last split are ignored
+    if (complete()) offset = end;
+    std::vector<char> rest(data + offset, data + end);
+    pending_.swap(rest);
+    return true;
+}
+
+size_t ProgressiveMeshDecoder::decode_base(const char* data, const size_t size) {
+    if (size < sizeof(ProgressiveHeader)) return 0;
+    ProgressiveHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, progressive_magic, sizeof(header.magic)) != 0 ||
+        header.base_vertices > header.n_vertices || header.base_faces > header.n_faces ||
+        header.n_vertices - header.base_vertices != header.n_splits ||
+        header.n_vertices > uint32_t(std::numeric_limits<int>::max() / 3) ||
+        header.n_faces > uint32_t(std::numeric_limits<int>::max() / 3)) {
+        failed_ = true;
+        return 0;
+    }
+    if (!has_header_) {
+        has_header_ = true;
+        base_vertices_ = int(header.base_vertices);
+        base_faces_ = int(header.base_faces);
+        total_vertices_ = int(header.n_vertices);
+        total_faces_ = int(header.n_faces);
+        total_splits_ = int(header.n_splits);
+        box_min_ = Point(header.box_min[0], header.box_min[1], header.box_min[2]);
+        box_max_ = Point(header.box_max[0], header.box_max[1], header.box_max[2]);
+        // the full mesh, the splits never reallocate
+        positions_.reserve(3 * size_t(total_vertices_));
+        indices_.reserve(3 * size_t(total_faces_));
+    }
+    const size_t position_bytes = 3 * sizeof(float) * size_t(base_vertices_);
+    const size_t index_bytes = 3 * sizeof(uint32_t) * size_t(base_faces_);
+    const size_t bytes = sizeof(header) + position_bytes + index_bytes;
+    if (size < bytes) return 0;
+
+    positions_.resize(3 * size_t(base_vertices_));
+    indices_.resize(3 * size_t(base_faces_));
+    memcpy(positions_.data(), data + sizeof(header), position_bytes);
+    memcpy(indices_.data(), data + sizeof(header) + position_bytes, index_bytes);
+    for (const uint32_t v: indices_) {
+        if (v >= uint32_t(base_vertices_)) {
+            failed_ = true;
+            positions_.clear();
+            indices_.clear();
+            return 0;
+        }
+    }
+    has_base_ = true;
+    return bytes;
+}
+
+size_t ProgressiveMeshDecoder::decode_split(const char* data, const size_t size) {
+    if (size < sizeof(SplitHeader)) return 0;
+    SplitHeader record;
+    memcpy(&record, data, sizeof(record));
+    const uint32_t new_vertex = uint32_t(n_vertices());
+    if (record.vertex >= new_vertex || record.n_added < 1 || record.n_added > 2 ||
+        record.n_moved > uint32_t(n_faces()) ||
+        n_faces() + int(record.n_added) > total_faces_) {
+        failed_ = true;
+        return 0;
+    }
+    const size_t n_ids = 3 * size_t(record.n_added) + record.n_moved;
+    const size_t bytes = sizeof(record) + n_ids * sizeof(uint32_t);
+    if (size < bytes) return 0;
+    std::vector<uint32_t> ids(n_ids);
+    memcpy(ids.data(), data + sizeof(record), n_ids * sizeof(uint32_t));
+    const uint32_t* added = ids.data();
+    const uint32_t* moved = added + 3 * record.n_added;
+    for (uint32_t k = 0; k < 3 * record.n_added; ++k) {
+        failed_ = failed_ || added[k] > new_vertex;
+    }
+    for (uint32_t k = 0; k < record.n_moved; ++k) {
+        const uint32_t* face = moved[k] < uint32_t(n_faces()) ? &indices_[3 * size_t(moved[k])] : nullptr;
+        failed_ = failed_ || !face ||
+                  (face[0] != record.vertex && face[1] != record.vertex && face[2] != record.vertex);
+    }
+    if (failed_) return 0;
+
+    // the split vertex and the moved faces are rewritten, unless they were
+    // appended since the last take_changes() anyway
+    positions_.insert(positions_.end(), record.new_position, record.new_position + 3);
+    std::copy(record.position, record.position + 3, &positions_[3 * size_t(record.vertex)]);
+    if (int(record.vertex) < changes_.first_vertex) changes_.vertices.push_back(record.vertex);
+    for (uint32_t k = 0; k < record.n_moved; ++k) {
+        uint32_t* face = &indices_[3 * size_t(moved[k])];
+        std::replace(face, face + 3, record.vertex, new_vertex);
+        if (int(moved[k]) < changes_.first_face) changes_.faces.push_back(moved[k]);
+    }
+    indices_.insert(indices_.end(), added, added + 3 * record.n_added);
+    ++n_splits_;
+    return bytes;
+}
+
+void ProgressiveMeshDecoder::take_changes(Changes& changes) {
+    for (std::vector<uint32_t>* list: { &changes_.vertices, &changes_.faces }) {
+        std::sort(list->begin(), list->end());
+        list->erase(std::unique(list->begin(), list->end()), list->end());
+    }
+    changes = changes_;
+    changes_.first_vertex = n_vertices();
+    changes_.first_face = n_faces();
+    changes_.vertices.clear();
+    changes_.faces.clear();
+}
+
+void ProgressiveMeshDecoder::get_mesh(Mesh& mesh) const {
+    mesh.clear();
+    mesh.reserve(n_vertices(), n_vertices() + n_faces(), n_faces());
+    for (int i = 0; i < n_vertices(); ++i) {
+        const float* p = &positions_[3 * size_t(i)];
+        mesh.add_vertex(Point(p[0], p[1], p[2]));
+    }
+    const std::vector<unsigned int> indices(indices_.begin(), indices_.end());
+    const std::vector<unsigned int> valences(n_faces(), 3u);
+    mesh.add_faces(indices, valences);
+}
+
+}
@@ -0,0 +1,106 @@
+#ifndef PROGRESSIVE_MESH_H
+#define PROGRESSIVE_MESH_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mesh_processing {
+
+// Progressive mesh files (Hoppe): the coarse base mesh of decimate()
+// followed by the vertex splits that undo its edge collapses, the last
+// collapse first. Every prefix of the file that holds the base is a valid
+// triangle mesh, so a reader shows the base as soon as it arrived and
+// refines it split by split while the rest comes in. A split appends one
+// vertex and the one or two faces the collapse removed, moves one vertex
+// back and points some faces of its ring at the new vertex; the vertices
+// and faces are never renumbered and only ever appended.
+//
+// The header holds the counts of the base and of the full mesh and the
+// bounds of all positions in the file, so that a reader can allocate and
+// quantize for the full mesh up front. Native byte order, like the other
+// binary caches of this directory.
+
+// decimates a copy of mesh down to base_faces faces and writes the base and
+// the splits back to mesh; false if mesh is not a triangle mesh or the file
+// cannot be written
+bool write_progressive_mesh(const surface_mesh::Surface_mesh& mesh, const std::string& filename,
+                            const unsigned int base_faces);
+
+// the full mesh of a progressive mesh file, false if it is none or it ends
+// early
+bool read_progressive_mesh(surface_mesh::Surface_mesh& mesh, const std::string& filename);
+
+// Decodes a progressive mesh file from pieces of any size, as they arrive.
+class ProgressiveMeshDecoder {
+
+public:
+    // what changed since the last take_changes(): the vertices from
+    // first_vertex and the faces from first_face on were appended, the ones
+    // before that listed in vertices and faces were rewritten, in ascending
+    // order
+    struct Changes {
+        int first_vertex = 0;
+        int first_face = 0;
+        std::vector<uint32_t> vertices;
+        std::vector<uint32_t> faces;
+    };
+
+    ProgressiveMeshDecoder() { clear(); }
+
+    // decodes the next bytes of the file and keeps an incomplete record for
+    // the next call; false once the data is no progressive mesh, the mesh
+    // decoded up to there stays
+    bool consume(const char* data, const size_t size);
+    void clear();
+
+    bool failed() const { return failed_; }
+    // the header and the base arrived, the mesh can be drawn
+    bool has_base() const { return has_base_; }
+    // all splits are applied, the mesh is the full one
+    bool complete() const { return has_base_ && n_splits_ == total_splits_; }
+
+    // counts of the full mesh and of the splits, from the header
+    int total_vertices() const { return total_vertices_; }
+    int total_faces() const { return total_faces_; }
+    int total_splits() const { return total_splits_; }
+    int n_splits() const { return n_splits_; }
+    // bounds of all positions the file holds
+    const surface_mesh::Point& box_min() const { return box_min_; }
+    const surface_mesh::Point& box_max() const { return box_max_; }
+
+    int n_vertices() const { return int(positions_.size() / 3); }
+    int n_faces() const { return int(indices_.size() / 3); }
+    // 3 floats per vertex and 3 vertex indices per triangle
+    const std::vector<float>& positions() const { return positions_; }
+    const std::vector<uint32_t>& indices() const { return indices_; }
+
+    void take_changes(Changes& changes);
+
+    // the mesh decoded so far
+    void get_mesh(surface_mesh::Surface_mesh& mesh) const;
+
+private:
+    // the base or one split from the start of data, 0 if size is too short
+    // for it, failed_ if it is damaged
+    size_t decode_base(const char* data, const size_t size);
+    size_t decode_split(const char* data, const size_t size);
+
+    std::vector<char> pending_;
+    bool failed_;
+    bool has_header_;
+    bool has_base_;
+    int base_vertices_, base_faces_;
+    int total_vertices_, total_faces_, total_splits_;
+    int n_splits_;
+    surface_mesh::Point box_min_, box_max_;
+    std::vector<float> positions_;
+    std::vector<uint32_t> indices_;
+    Changes changes_;
+};
+
+}
+
+#endif // PROGRESSIVE_MESH_H
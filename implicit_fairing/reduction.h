@@ -0,0 +1,48 @@
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+#include <algorithm>
+#include <vector>
+
+namespace mesh_processing {
+
+// indices per block of deterministic_reduce(), combined in index order
+const int REDUCTION_BLOCK = 1024;
+
+// combine(... combine(combine(identity, term(0)), term(1)) ..., term(n - 1))
+// regrouped so that it runs in parallel and still gives the same bits on
+// any number of threads: the terms are combined in index order within
+// fixed blocks of REDUCTION_BLOCK indices, the block results pairwise in a
+// fixed tree. term is called once per index, possibly from several threads
+// at a time, so it may also write the result of index i; combine needs to
+// be associative up to rounding, as a sum.
+template <class T, class Term, class Combine>
+T deterministic_reduce(const int n, const T& identity, const Term& term, const Combine& combine) {
+    const int n_blocks = (std::max(n, 0) + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+    if (n_blocks == 0) return identity;
+    std::vector<T> blocks(n_blocks, identity);
+#pragma omp parallel for schedule(static)
+    for (int b = 0; b < n_blocks; ++b) {
+        const int end = std::min(n, (b + 1) * REDUCTION_BLOCK);
+        T value = identity;
+        for (int i = b * REDUCTION_BLOCK; i < end; ++i) value = combine(value, term(i));
+        blocks[b] = value;
+    }
+    for (int stride = 1; stride < n_blocks; stride *= 2) {
+        for (int b = 0; b + stride < n_blocks; b += 2 * stride) {
+            blocks[b] = combine(blocks[b], blocks[b + stride]);
+        }
+    }
+    return blocks[0];
+}
+
+// sum of term(i) over [0, n), the pairwise sum of deterministic_reduce();
+// beyond a block its rounding error grows with log n instead of n
+template <class T, class Term>
+T deterministic_sum(const int n, const T& zero, const Term& term) {
+    return deterministic_reduce(n, zero, term, [](const T& a, const T& b) { return a + b; });
+}
+
+}
+
+#endif // REDUCTION_H
@@ -0,0 +1,300 @@
+#include "remeshing.h"
+#include "async_job.h"
+#include "bvh.h"
+#include "independent_edges.h"
+#include "one_ring.h"
+#include "reduction.h"
+#include <surface_mesh/Trace.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+typedef surface_mesh::Surface_mesh Mesh;
+
+// damping of the tangential smoothing step
+static const Scalar RELAXATION = 0.5f;
+
+// cost bits above the edge index, so edges are ordered by cost and then
+// by index
+static uint64_t edge_key(const float cost, const int e) {
+    uint32_t bits;
+    std::memcpy(&bits, &cost, sizeof(bits));
+    return (uint64_t(bits) << 32) | uint32_t(e);
+}
+
+class Remesher {
+
+public:
+    Remesher(Mesh& mesh, const RemeshingOptions& options) : mesh_(mesh), options_(options) {}
+
+    unsigned int run(JobProgress* progress);
+
+private:
+    void split_long_edges();
+    void collapse_short_edges();
+    void equalize_valences();
+    void relax();
+
+    // the key of the collapse of edge e into h, NO_EDGE_KEY if it would
+    // remove a boundary vertex, make an edge longer than high_ or turn a
+    // face over
+    uint64_t collapse_key(const int e, Mesh::Halfedge& h) const;
+    bool collapse_ok(const Mesh::Halfedge h) const;
+    // the key of the flip of edge e, by the decrease of the valence
+    // deviation; NO_EDGE_KEY if it does not decrease or the faces fold
+    uint64_t flip_key(const int e) const;
+    int target_valence(const Mesh::Vertex v) const { return mesh_.is_boundary(v) ? 4 : 6; }
+
+    Mesh& mesh_;
+    const RemeshingOptions& options_;
+    Scalar low_ = 0.0f, high_ = 0.0f;
+    // the input surface the vertices are projected onto
+    Mesh reference_;
+    TriangleBVH bvh_;
+    IndependentEdges independent_;
+    std::vector<uint64_t> keys_;
+    std::vector<unsigned char> dirty_;
+};
+
+bool Remesher::collapse_ok(const Mesh::Halfedge h) const {
+    const Mesh::Vertex removed = mesh_.from_vertex(h), kept = mesh_.to_vertex(h);
+    if (!mesh_.is_collapse_ok(h)) return false;
+    const Point& position = mesh_.position(kept);
+    for (auto g: mesh_.halfedges(removed)) {
+        const Mesh::Vertex a = mesh_.to_vertex(g);
+        if (distance(position, mesh_.position(a)) > high_) return false;
+        if (mesh_.is_boundary(g)) continue;
+        const Mesh::Vertex b = mesh_.to_vertex(mesh_.next_halfedge(g));
+        // the two faces of the edge are removed
+        if (a == kept || b == kept) continue;
+        const Point& p = mesh_.position(removed);
+        const Point& pa = mesh_.position(a);
+        const Point& pb = mesh_.position(b);
+        if (dot(cross(pa - p, pb - p), cross(pa - position, pb - position)) <= 0.0f) return false;
+    }
+    return true;
+}
+
+uint64_t Remesher::collapse_key(const int e, Mesh::Halfedge& h) const {
+    const Mesh::Edge edge(e);
+    if (mesh_.is_deleted(edge)) return NO_EDGE_KEY;
+    const Scalar length = mesh_.edge_length(edge);
+    if (length >= low_) return NO_EDGE_KEY;
+    const Mesh::Halfedge h0 = mesh_.halfedge(edge, 0), h1 = mesh_.halfedge(edge, 1);
+    const bool boundary0 = mesh_.is_boundary(mesh_.from_vertex(h0));
+    const bool boundary1 = mesh_.is_boundary(mesh_.to_vertex(h0));
+    if (boundary0 && boundary1) return NO_EDGE_KEY;
+    // the boundary vertex is kept, otherwise either one
+    if (!boundary0 && collapse_ok(h0)) {
+        h = h0;
+    } else if (!boundary1 && collapse_ok(h1)) {
+        h = h1;
+    } else {
+        return NO_EDGE_KEY;
+    }
+    return edge_key(length, e);
+}
+
+uint64_t Remesher::flip_key(const int e) const {
+    const Mesh::Edge edge(e);
+    if (mesh_.is_deleted(edge) || mesh_.is_boundary(edge)) return NO_EDGE_KEY;
+    const Mesh::Halfedge h0 = mesh_.halfedge(edge, 0), h1 = mesh_.halfedge(edge, 1);
+    const Mesh::Vertex a = mesh_.from_vertex(h0), b = mesh_.to_vertex(h0);
+    const Mesh::Vertex c = mesh_.to_vertex(mesh_.next_halfedge(h0));
+    const Mesh::Vertex d = mesh_.to_vertex(mesh_.next_halfedge(h1));
+
+    // the flip takes one edge from a and b and gives one to c and d
+    const Mesh::Vertex v[4] = { a, b, c, d };
+    const int change[4] = { -1, -1, 1, 1 };
+    int before = 0, after = 0;
+    for (int k = 0; k < 4; ++k) {
+        const int deviation = int(mesh_.valence(v[k])) - target_valence(v[k]);
+        before += deviation * deviation;
+        after += (deviation + change[k]) * (deviation + change[k]);
+    }
+    if (after >= before || !mesh_.is_flip_ok(edge)) return NO_EDGE_KEY;
+
+    // the faces (a, b, c) and (b, a, d) become (a, d, c) and (d, b, c),
+    // both have to face the same side as before
+    const Point& pa = mesh_.position(a);
+    const Point& pb = mesh_.position(b);
+    const Point& pc = mesh_.position(c);
+    const Point& pd = mesh_.position(d);
+    const Point normal = cross(pb - pa, pc - pa) + cross(pa - pb, pd - pb);
+    if (dot(cross(pd - pa, pc - pa), normal) <= 0.0f ||
+        dot(cross(pb - pd, pc - pd), normal) <= 0.0f) {
+        return NO_EDGE_KEY;
+    }
+    // larger decreases first
+    return edge_key(1.0f / float(before - after), e);
+}
+
+void Remesher::split_long_edges() {
+    SURFACE_MESH_TRACE_ZONE("remesh split");
+    // a split does not change the lengths of the other edges, so the long
+    // ones are found in parallel and split in order; the new edges are
+    // tested in the next pass
+    std::vector<unsigned char> split;
+    for (;;) {
+        const int n_edges = mesh_.edges_size();
+        split.resize(n_edges);
+#pragma omp parallel for schedule(static)
+        for (int e = 0; e < n_edges; ++e) {
+            const Mesh::Edge edge(e);
+            split[e] = !mesh_.is_deleted(edge) && mesh_.edge_length(edge) > high_;
+        }
+        bool any = false;
+        for (int e = 0; e < n_edges; ++e) {
+            if (!split[e]) continue;
+            const Mesh::Edge edge(e);
+            const Point midpoint = 0.5f * (mesh_.position(mesh_.vertex(edge, 0)) +
+                                           mesh_.position(mesh_.vertex(edge, 1)));
+            mesh_.split(edge, midpoint);
+            any = true;
+        }
+        if (!any) break;
+    }
+}
+
+void Remesher::collapse_short_edges() {
+    SURFACE_MESH_TRACE_ZONE("remesh collapse");
+    const int n_edges = mesh_.edges_size();
+    keys_.assign(n_edges, NO_EDGE_KEY);
+    dirty_.assign(mesh_.vertices_size(), 1);
+    std::vector<Mesh::Halfedge> halfedges(n_edges);
+    for (;;) {
+        // keys of the edges at changed vertices
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int e = 0; e < n_edges; ++e) {
+            const Mesh::Edge edge(e);
+            if (mesh_.is_deleted(edge)) {
+                keys_[e] = NO_EDGE_KEY;
+            } else if (dirty_[mesh_.vertex(edge, 0).idx()] || dirty_[mesh_.vertex(edge, 1).idx()]) {
+                keys_[e] = collapse_key(e, halfedges[e]);
+            }
+        }
+        std::fill(dirty_.begin(), dirty_.end(), 0);
+
+        const std::vector<int>& collapses = independent_.select(mesh_, keys_);
+        if (collapses.empty()) break;
+        // the boundary halfedges are repaired once per round
+        mesh_.begin_topology_batch();
+        for (const int e: collapses) {
+            const Mesh::Vertex kept = mesh_.to_vertex(halfedges[e]);
+            mesh_.collapse(halfedges[e]);
+            all_of_closed_ring(mesh_, kept, [&](const Mesh::Vertex u) { dirty_[u.idx()] = 1; return true; });
+        }
+        mesh_.end_topology_batch();
+    }
+}
+
+void Remesher::equalize_valences() {
+    SURFACE_MESH_TRACE_ZONE("remesh flip");
+    const int n_edges = mesh_.edges_size();
+    keys_.assign(n_edges, NO_EDGE_KEY);
+    dirty_.assign(mesh_.vertices_size(), 1);
+    // every flip decreases the summed squared valence deviation
+    for (;;) {
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int e = 0; e < n_edges; ++e) {
+            const Mesh::Edge edge(e);
+            if (mesh_.is_deleted(edge)) {
+                keys_[e] = NO_EDGE_KEY;
+            } else if (dirty_[mesh_.vertex(edge, 0).idx()] || dirty_[mesh_.vertex(edge, 1).idx()]) {
+                keys_[e] = flip_key(e);
+            }
+        }
+        std::fill(dirty_.begin(), dirty_.end(), 0);
+
+        const std::vector<int>& flips = independent_.select(mesh_, keys_);
+        if (flips.empty()) break;
+        for (const int e: flips) {
+            const Mesh::Edge edge(e);
+            const Mesh::Vertex ends[2] = { mesh_.vertex(edge, 0), mesh_.vertex(edge, 1) };
+            mesh_.flip(edge);
+            // the valences of the four vertices changed
+            for (const Mesh::Vertex v: ends) {
+                all_of_closed_ring(mesh_, v, [&](const Mesh::Vertex u) { dirty_[u.idx()] = 1; return true; });
+            }
+        }
+    }
+}
+
+void Remesher::relax() {
+    SURFACE_MESH_TRACE_ZONE("remesh relax");
+    OneRingAdjacency rings;
+    rings.build(mesh_);
+    const int n_vertices = mesh_.vertices_size();
+    Point* points = mesh_.points().data();
+    std::vector<Point> smoothed(n_vertices);
+    rings.smooth_step(points, smoothed.data(), RELAXATION, false);
+
+    const std::vector<unsigned char>& interior = rings.interior();
+    std::vector<Point> moved(smoothed);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < n_vertices; ++i) {
+        if (!interior[i]) continue;
+        // the step in the tangent plane, then onto the input along the normal
+        const Point n = mesh_.compute_vertex_normal(Mesh::Vertex(i));
+        Point p = smoothed[i] - dot(smoothed[i] - points[i], n) * n;
+        Mesh::Face face;
+        Scalar t, nearest = high_;
+        Point projected = p;
+        for (const Scalar side: { 1.0f, -1.0f }) {
+            if (bvh_.intersect(reference_, p, side * n, face, t) && t < nearest) {
+                nearest = t;
+                projected = p + side * t * n;
+            }
+        }
+        moved[i] = projected;
+    }
+    std::copy(moved.begin(), moved.end(), points);
+}
+
+unsigned int Remesher::run(JobProgress* progress) {
+    SURFACE_MESH_TRACE_ZONE("remesh");
+    const int n_edges = mesh_.edges_size();
+    if (mesh_.n_edges() == 0 || options_.iterations == 0) return 0;
+
+    Scalar target = options_.target_edge_length;
+    if (!(target > 0.0f)) {
+        const double sum = deterministic_sum(n_edges, 0.0, [&](const int e) {
+            const Mesh::Edge edge(e);
+            return mesh_.is_deleted(edge) ? 0.0 : double(mesh_.edge_length(edge));
+        });
+        target = Scalar(sum / mesh_.n_edges());
+    }
+    if (!(target > 0.0f)) return 0;
+    low_ = 0.8f * target;
+    high_ = 4.0f / 3.0f * target;
+
+    reference_ = mesh_;
+    bvh_.build(reference_);
+
+    unsigned int iter = 0;
+    while (iter < options_.iterations) {
+        split_long_edges();
+        collapse_short_edges();
+        equalize_valences();
+        relax();
+        ++iter;
+        if (progress && !progress->report(float(iter) / options_.iterations)) break;
+    }
+
+    mesh_.garbage_collection();
+    if (mesh_.get_vertex_property<Point>("v:normal")) mesh_.update_vertex_normals();
+    return iter;
+}
+
+unsigned int remesh(Mesh& mesh, const RemeshingOptions& options, JobProgress* progress) {
+    if (!mesh.is_triangle_mesh()) return 0;
+    Remesher remesher(mesh, options);
+    return remesher.run(progress);
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef REMESHING_H
+#define REMESHING_H
+
+#include <surface_mesh/Surface_mesh.h>
+
+namespace mesh_processing {
+
+class JobProgress;
+
+struct RemeshingOptions {
+    // edge length to aim for, 0 for the mean edge length of the input
+    float target_edge_length = 0.0f;
+    unsigned int iterations = 5;
+};
+
+// Isotropic remeshing of a triangle mesh (Botsch and Kobbelt): every
+// iteration splits the edges longer than 4/3 of the target length,
+// collapses those shorter than 4/5 of it, flips edges towards valence 6
+// (4 on the boundary) and moves the vertices by a tangential uniform
+// Laplacian step, projected back onto the input surface. Collapses and
+// flips run in rounds of edges with disjoint one-rings, see
+// IndependentEdges; the boundary vertices stay where they are, boundary
+// edges are only split.
+//
+// The deleted elements are removed by garbage_collection() at the end,
+// vertex properties other than the positions are not interpolated and
+// v:normal is recomputed if there is one. Returns the number of
+// iterations done, 0 for a mesh that is not a triangle mesh. Cancelled
+// through progress, the mesh is valid then.
+unsigned int remesh(surface_mesh::Surface_mesh& mesh, const RemeshingOptions& options,
+                    JobProgress* progress = nullptr);
+
+}
+
+#endif // REMESHING_H
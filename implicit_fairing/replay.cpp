@@ -0,0 +1,378 @@
+#include "replay.h"
+#include "eigen_interop.h"
+#include "mesh_processing.h"
+#include "pipeline.h"
+#include <surface_mesh/Reorder.h>
+#include <surface_mesh/Trace.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+namespace mesh_processing {
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using surface_mesh::Trace;
+
+bool ActionRecorder::open(const string& filename) {
+    close();
+    file_ = std::fopen(filename.c_str(), "w");
+    if (!file_) return false;
+    std::fputs("# viewer actions, run with --replay\n", file_);
+    std::fflush(file_);
+    return true;
+}
+
+void ActionRecorder::close() {
+    if (file_) std::fclose(file_);
+    file_ = nullptr;
+}
+
+void ActionRecorder::record(const char* action, const std::vector<double>& parameters) {
+    if (!file_) return;
+    std::fputs(action, file_);
+    // exact, the replay runs on the same numbers
+    for (const double p : parameters) std::fprintf(file_, " %.17g", p);
+    std::fputc('\n', file_);
+    std::fflush(file_);
+}
+
+void ActionRecorder::record(const char* action, const char* argument) {
+    if (!file_) return;
+    std::fprintf(file_, "%s %s\n", action, argument);
+    std::fflush(file_);
+}
+
+void ActionRecorder::record_vertices(const char* action, const std::vector<int>& vertices) {
+    if (!file_) return;
+    std::fputs(action, file_);
+    for (const int v : vertices) std::fprintf(file_, " %d", v);
+    std::fputc('\n', file_);
+    std::fflush(file_);
+}
+
+namespace {
+
+// the parameters of an action, -1 for any number
+struct ActionSpec {
+    const char* name;
+    int parameters;
+};
+
+const ActionSpec action_specs[] = {
+    { "load", 1 }, { "reorder", 1 }, { "subdivide", 1 }, { "decimate", 1 }, { "remesh", 0 },
+    { "uniform-smooth", 1 }, { "smooth", 1 }, { "taubin-smooth", 1 },
+    { "uniform-smooth-converged", 0 }, { "multires-smooth", 1 }, { "feature-smooth", 1 },
+    { "implicit", 1 }, { "pick", 3 }, { "region-implicit", -1 }, { "spectral", 1 },
+    { "uniform-enhance", 2 }, { "laplace-beltrami-enhance", 2 }, { "minimal-surface", 0 },
+    { "pin", 0 }, { "clear-pins", 0 }, { "undo", 0 }, { "redo", 0 }
+};
+
+struct Action {
+    int line;
+    string name;
+    // the file of load, the method of reorder and subdivide
+    string argument;
+    std::vector<double> parameters;
+    // what the tables print
+    string text;
+};
+
+bool parse_number(const string& text, double& value) {
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0';
+}
+
+// the actions of the log, false and a message with the line on error
+bool parse_log(const string& filename, std::vector<Action>& actions, string& error) {
+    std::ifstream file(filename.c_str());
+    if (!file) {
+        error = filename + ": cannot open";
+        return false;
+    }
+    string line;
+    for (int number = 1; std::getline(file, line); ++number) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        const size_t first = line.find_first_not_of(" \t");
+        if (first == string::npos || line[first] == '#') continue;
+        const string where = filename + ":" + std::to_string(number) + ": ";
+        std::istringstream words(line.substr(first));
+        Action action;
+        action.line = number;
+        words >> action.name;
+        const ActionSpec* spec = nullptr;
+        for (const ActionSpec& s : action_specs) {
+            if (action.name == s.name) spec = &s;
+        }
+        if (!spec) {
+            error = where + "unknown action " + action.name;
+            return false;
+        }
+        std::vector<string> values;
+        if (action.name == "load") {
+            // the rest of the line, file names may have spaces
+            std::getline(words >> std::ws, action.argument);
+            if (!action.argument.empty()) values.push_back(action.argument);
+        } else {
+            for (string word; words >> word;) values.push_back(word);
+        }
+        if (spec->parameters >= 0 && int(values.size()) != spec->parameters) {
+            error = where + action.name + " expects " + std::to_string(spec->parameters) +
+                    " value(s)";
+            return false;
+        }
+        if (action.name == "reorder") {
+            action.argument = values[0];
+            if (action.argument != "hilbert" && action.argument != "morton" &&
+                action.argument != "rcm") {
+                error = where + "unknown reordering " + action.argument;
+                return false;
+            }
+        } else if (action.name == "subdivide") {
+            action.argument = values[0];
+            if (action.argument != "loop" && action.argument != "sqrt3") {
+                error = where + "unknown subdivision " + action.argument;
+                return false;
+            }
+        } else if (action.name != "load") {
+            for (const string& value : values) {
+                double p;
+                if (!parse_number(value, p)) {
+                    error = where + "invalid value " + value;
+                    return false;
+                }
+                action.parameters.push_back(p);
+            }
+        }
+        if (actions.empty() && action.name != "load") {
+            error = where + action.name + " before the first load";
+            return false;
+        }
+        action.text = line.substr(first);
+        // a region of many vertices would not fit the table
+        if (action.name == "region-implicit" && values.size() > 1) {
+            action.text = "region-implicit (" + std::to_string(values.size()) + " vertices)";
+        }
+        actions.push_back(action);
+    }
+    if (actions.empty()) {
+        error = filename + ": no actions";
+        return false;
+    }
+    return true;
+}
+
+// runs action on mesh like the viewer does, with the attributes the
+// viewer draws after it up to date; false and a message if it failed
+bool run_action(std::unique_ptr<MeshProcessing>& mesh, const Action& action) {
+    const string& name = action.name;
+    const std::vector<double>& p = action.parameters;
+    const auto count = [&](const size_t i) { return (unsigned int) std::max(p[i], 0.0); };
+    if (name == "load") {
+        // what the loader of the viewer computes before the mesh is shown
+        mesh.reset(new MeshProcessing());
+        if (!mesh->read_mesh(action.argument)) {
+            cerr << action.argument << ": cannot read" << endl;
+            return false;
+        }
+        mesh->get_indices();
+        mesh->get_normals();
+        mesh->get_dist_max();
+        return true;
+    }
+    MeshProcessing& m = *mesh;
+    // the Pipeline stages leave the normals up to date themselves
+    if (name == "uniform-smooth") {
+        Pipeline().uniform_smooth(count(0)).run(m, Pipeline::NORMALS);
+        return true;
+    }
+    if (name == "smooth") {
+        Pipeline().smooth(count(0)).run(m, Pipeline::NORMALS);
+        return true;
+    }
+    if (name == "taubin-smooth") {
+        Pipeline().taubin_smooth(count(0)).run(m, Pipeline::NORMALS);
+        return true;
+    }
+    if (name == "pick") {
+        m.set_selection(Eigen::Vector3f(float(p[0]), float(p[1]), float(p[2])));
+        return true;
+    }
+    if (name == "pin") {
+        const Mesh::Vertex v = m.get_selected_vertex();
+        if (v.is_valid()) m.set_constraint(v, to_point(m.get_points().col(v.idx())));
+        return true;
+    }
+    if (name == "clear-pins") {
+        m.clear_constraints();
+        return true;
+    }
+
+    if (name == "reorder") {
+        m.reorder_mesh(action.argument == "hilbert" ? surface_mesh::REORDER_HILBERT :
+                       action.argument == "morton" ? surface_mesh::REORDER_MORTON :
+                                                     surface_mesh::REORDER_RCM);
+    } else if (name == "subdivide") {
+        if (!m.subdivide(action.argument == "loop" ? surface_mesh::SUBDIVISION_LOOP :
+                                                     surface_mesh::SUBDIVISION_SQRT3)) {
+            return true;
+        }
+    } else if (name == "decimate") {
+        DecimationOptions options;
+        options.target_faces = count(0);
+        if (!m.decimate(options)) return true;
+    } else if (name == "remesh") {
+        if (!m.remesh(RemeshingOptions())) return true;
+    } else if (name == "uniform-smooth-converged") {
+        m.set_smoothing_tolerance(1e-3f);
+        m.set_chebyshev_smoothing(true);
+        m.uniform_smooth(10000);
+        m.set_smoothing_tolerance(0.0f);
+        m.set_chebyshev_smoothing(false);
+    } else if (name == "multires-smooth") {
+        m.multiresolution_smooth(count(0));
+    } else if (name == "feature-smooth") {
+        m.feature_preserving_smooth(count(0));
+    } else if (name == "implicit") {
+        m.implicit_smoothing(p[0]);
+    } else if (name == "region-implicit") {
+        if (p.empty()) {
+            m.set_region_ball(m.get_selected_vertex(), 0.1f * m.get_dist_max());
+        } else {
+            std::vector<Mesh::Vertex> region;
+            for (const double v : p) {
+                if (v < 0.0 || v >= m.get_number_of_vertices()) {
+                    cerr << "vertex " << v << " out of range" << endl;
+                    return false;
+                }
+                region.push_back(Mesh::Vertex(int(v)));
+            }
+            m.set_region(region);
+        }
+        m.region_implicit_smoothing();
+    } else if (name == "spectral") {
+        if (m.get_eigenbasis_size() < int(count(0)) && !m.compute_eigenbasis(count(0))) {
+            cerr << "eigenbasis failed" << endl;
+            return false;
+        }
+        m.spectral_smoothing(count(0));
+    } else if (name == "uniform-enhance") {
+        m.uniform_laplacian_enhance_feature(count(0), float(p[1]));
+    } else if (name == "laplace-beltrami-enhance") {
+        m.laplace_beltrami_enhance_feature(count(0), float(p[1]));
+    } else if (name == "minimal-surface") {
+        m.minimal_surface();
+    } else if (name == "undo") {
+        if (!m.undo()) return true;
+    } else if (name == "redo") {
+        if (!m.redo()) return true;
+    }
+    m.compute_mesh_properties();
+    return true;
+}
+
+}
+
+bool is_replay_command(int argc, char** argv) {
+    return argc > 1 && strcmp(argv[1], "--replay") == 0;
+}
+
+bool parse_replay_options(int argc, char** argv, ReplayOptions& options, string& error) {
+    if (argc < 3) {
+        error = "--replay expects 1 value(s)";
+        return false;
+    }
+    options.log = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        const string arg = argv[i];
+        if (i + 1 >= argc) {
+            error = arg == "--repeat" || arg == "--output"
+                  ? arg + " expects 1 value(s)" : "unknown option " + arg;
+            return false;
+        }
+        if (arg == "--repeat") {
+            char* end = nullptr;
+            const long n = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || n < 1) {
+                error = "invalid repetitions " + string(argv[i]);
+                return false;
+            }
+            options.repeat = (unsigned int) n;
+        } else if (arg == "--output") {
+            options.output = argv[++i];
+        } else {
+            error = "unknown option " + arg;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool run_replay(const ReplayOptions& options) {
+    std::vector<Action> actions;
+    string error;
+    if (!parse_log(options.log, actions, error)) {
+        cerr << error << endl;
+        return false;
+    }
+    // milliseconds of every action in every pass
+    const size_t n = actions.size();
+    std::vector<double> fastest(n, 0.0), total(n, 0.0);
+    std::vector<unsigned int> vertices(n, 0);
+    std::unique_ptr<MeshProcessing> mesh;
+    for (unsigned int pass = 0; pass < options.repeat; ++pass) {
+        for (size_t i = 0; i < n; ++i) {
+            const long long begin = Trace::now();
+            if (!run_action(mesh, actions[i])) {
+                cerr << options.log << ":" << actions[i].line << ": " << actions[i].name
+                     << " failed" << endl;
+                return false;
+            }
+            const double ms = (Trace::now() - begin) * 1e-6;
+            fastest[i] = pass == 0 ? ms : std::min(fastest[i], ms);
+            total[i] += ms;
+            vertices[i] = mesh->get_number_of_vertices();
+        }
+    }
+    if (!options.output.empty() && !mesh->save_mesh(options.output)) {
+        cerr << options.output << ": cannot write" << endl;
+        return false;
+    }
+
+    char text[256];
+    snprintf(text, sizeof(text), "%6s  %-32s %10s %12s %12s", "line", "action", "vertices",
+             "min ms", "mean ms");
+    cout << text << endl;
+    double sum_fastest = 0.0, sum_total = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(text, sizeof(text), "%6d  %-32s %10u %12.2f %12.2f", actions[i].line,
+                 actions[i].text.substr(0, 32).c_str(), vertices[i], fastest[i],
+                 total[i] / options.repeat);
+        cout << text << endl;
+        sum_fastest += fastest[i];
+        sum_total += total[i];
+    }
+    snprintf(text, sizeof(text), "%6s  %-32s %10s %12.2f %12.2f", "", "total", "", sum_fastest,
+             sum_total / options.repeat);
+    cout << text << endl;
+    return true;
+}
+
+void print_replay_usage(const char* program) {
+    cerr << "usage: " << program << " --replay LOG [options]\n"
+         << "runs the viewer actions a viewer started with --record LOG wrote and\n"
+         << "prints the time of every action, see replay.h for the actions\n"
+         << "options:\n"
+         << "  --repeat N     run the log N times, the table has the fastest and the\n"
+         << "                 mean time of every action (1)\n"
+         << "  --output FILE  write the mesh after the last action" << endl;
+}
+
+}
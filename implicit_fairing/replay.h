@@ -0,0 +1,81 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace mesh_processing {
+
+// A log of the viewer actions that change the mesh, one per line: the
+// action and its parameters separated by spaces, e.g.
+//
+//   load ../data/bunny.off
+//   smooth 10
+//   laplace-beltrami-enhance 10 2
+//   implicit 0.0001
+//   minimal-surface
+//
+// written by the viewer started with --record FILE and run headless by
+// --replay FILE, which times every action, so that the sessions of users
+// become benchmarks. Lines starting with # are comments. The actions are:
+//
+//   load FILE                          read a mesh, the viewer's mesh cache aside
+//   reorder hilbert|morton|rcm
+//   subdivide loop|sqrt3               one level
+//   decimate F                         down to F faces
+//   remesh
+//   uniform-smooth N, smooth N, taubin-smooth N
+//                                      the Pipeline stages of the viewer
+//   uniform-smooth-converged           Chebyshev uniform smoothing to 1e-3
+//   multires-smooth N, feature-smooth N
+//   implicit DT
+//   pick X Y Z                         the point the selected vertex is nearest to
+//   region-implicit [V...]             implicit smoothing of the vertices V, of
+//                                      the ball around the picked vertex if none
+//   spectral K
+//   uniform-enhance N C, laplace-beltrami-enhance N C
+//   minimal-surface
+//   pin, clear-pins                    pin the picked vertex where it is
+//   undo, redo
+//
+// GPU smoothing is recorded as the CPU operator of the same iterations, a
+// job that was cancelled or ran out of its time budget as if it completed.
+class ActionRecorder {
+public:
+    ~ActionRecorder() { close(); }
+    // truncates filename, false if it cannot be written
+    bool open(const std::string& filename);
+    void close();
+    bool is_open() const { return file_ != nullptr; }
+    // a line of action and parameters, written through at once so that a
+    // crashed session keeps its log; ignored unless open
+    void record(const char* action, const std::vector<double>& parameters = {});
+    void record(const char* action, const char* argument);
+    // an action whose parameters are vertex indices
+    void record_vertices(const char* action, const std::vector<int>& vertices);
+
+private:
+    std::FILE* file_ = nullptr;
+};
+
+struct ReplayOptions {
+    std::string log;
+    // passes over the log, every one from the first load
+    unsigned int repeat = 1;
+    // the mesh after the last pass, not written if empty
+    std::string output;
+};
+
+// true if argv asks for a replay, i.e. starts with --replay
+bool is_replay_command(int argc, char** argv);
+// parses --replay LOG and the options after it, false and a message on error
+bool parse_replay_options(int argc, char** argv, ReplayOptions& options, std::string& error);
+// runs the log and prints the time of every action, the fastest and the
+// mean of the passes; false if the log is malformed or an action failed
+bool run_replay(const ReplayOptions& options);
+void print_replay_usage(const char* program);
+
+}
+
+#endif // REPLAY_H
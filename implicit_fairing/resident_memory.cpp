@@ -0,0 +1,42 @@
+#include "resident_memory.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace mesh_processing {
+
+namespace {
+
+size_t proc_status(const char* key) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    const size_t length = strlen(key);
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, key) == 0) return size_t(atoll(line.c_str() + length)) * 1024;
+    }
+    return 0;
+}
+
+}
+
+size_t resident_memory() { return proc_status("VmRSS:"); }
+
+size_t peak_resident_memory() { return proc_status("VmHWM:"); }
+
+bool reset_peak_resident_memory(const bool release_heap) {
+#ifdef __GLIBC__
+    // the freed heap goes back first, so that what the next call takes from
+    // it counts towards its peak
+    if (release_heap) malloc_trim(0);
+#endif
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+    clear.flush();
+    return bool(clear);
+}
+
+}
@@ -0,0 +1,20 @@
+#ifndef RESIDENT_MEMORY_H
+#define RESIDENT_MEMORY_H
+
+#include <cstddef>
+
+namespace mesh_processing {
+
+// The resident memory of the process from /proc/self/status, in bytes, 0
+// where /proc does not tell.
+size_t resident_memory();
+// the high-water mark since reset_peak_resident_memory()
+size_t peak_resident_memory();
+// the high-water mark starts over at the current resident size, false
+// where it cannot be reset (before Linux 4.0 and off Linux); release_heap
+// first returns the free heap to the system, which can take milliseconds
+bool reset_peak_resident_memory(const bool release_heap = true);
+
+}
+
+#endif // RESIDENT_MEMORY_H
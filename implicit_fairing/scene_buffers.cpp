@@ -0,0 +1,176 @@
+#include "scene_buffers.h"
+#include <algorithm>
+
+namespace mesh_processing {
+
+// area weighted vertex normals of the triangles
+static void vertex_normals(const Eigen::Map<const Eigen::Matrix3Xf>& points,
+                           const SceneBuffers::Indices& indices, Eigen::Matrix3Xf& normals) {
+    normals.setZero(3, points.cols());
+    for (int j = 0; j < int(indices.cols()); ++j) {
+        const uint32_t a = indices(0, j), b = indices(1, j), c = indices(2, j);
+        const Eigen::Vector3f n = (points.col(b) - points.col(a)).cross(points.col(c) - points.col(a));
+        normals.col(a) += n;
+        normals.col(b) += n;
+        normals.col(c) += n;
+    }
+    for (int i = 0; i < int(normals.cols()); ++i) {
+        const float length = normals.col(i).norm();
+        if (length > 0.0f) normals.col(i) /= length;
+    }
+}
+
+int SceneBuffers::add(const std::string& name, const Eigen::Map<const Eigen::Matrix3Xf>& points,
+                      const std::shared_ptr<const Indices>& indices, const uint64_t topology,
+                      const Eigen::Vector3f& offset) {
+    Topology& shared = topologies_[topology];
+    if (!shared.indices) {
+        shared.indices = indices;
+        shared.buffer = 0;
+    }
+
+    Mesh mesh;
+    mesh.name = name;
+    mesh.offset = offset;
+    mesh.visible = true;
+    mesh.topology = topology;
+    pack_positions(points, mesh.positions, mesh.box_min, mesh.box_extent);
+    Eigen::Matrix3Xf normals;
+    vertex_normals(points, *shared.indices, normals);
+    pack_normals(Eigen::Map<const Eigen::Matrix3Xf>(normals.data(), 3, normals.cols()), mesh.normals);
+    std::fill(mesh.buffers, mesh.buffers + N_BUFFERS, 0);
+    mesh.drawn = frame_;
+    meshes_.push_back(mesh);
+    return int(meshes_.size()) - 1;
+}
+
+void SceneBuffers::clear() {
+    for (Mesh& mesh : meshes_) evict(mesh);
+    for (auto& topology : topologies_) {
+        if (topology.second.buffer != 0) glDeleteBuffers(1, &topology.second.buffer);
+    }
+    meshes_.clear();
+    topologies_.clear();
+    bytes_ = 0;
+}
+
+void SceneBuffers::set_visible(const int mesh, const bool visible) {
+    meshes_[mesh].visible = visible;
+    if (!visible) trim();
+}
+
+void SceneBuffers::set_budget(const size_t bytes) {
+    budget_ = bytes;
+    trim();
+}
+
+void SceneBuffers::set_live_topology(const uint64_t topology) {
+    live_ = topology;
+    has_live_ = true;
+    trim();
+}
+
+size_t SceneBuffers::vertex_bytes(const Mesh& mesh) {
+    return size_t(mesh.positions.size()) * sizeof(uint16_t) + size_t(mesh.normals.size()) * sizeof(int16_t);
+}
+
+void SceneBuffers::make_resident(Mesh& mesh) {
+    if (mesh.buffers[POSITIONS] == 0) {
+        glGenBuffers(N_BUFFERS, mesh.buffers);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[POSITIONS]);
+        glBufferData(GL_ARRAY_BUFFER, mesh.positions.size() * sizeof(uint16_t), mesh.positions.data(),
+                     GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[NORMALS]);
+        glBufferData(GL_ARRAY_BUFFER, mesh.normals.size() * sizeof(int16_t), mesh.normals.data(),
+                     GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        bytes_ += vertex_bytes(mesh);
+    }
+    Topology& topology = topologies_[mesh.topology];
+    if (topology.buffer == 0 && !(has_live_ && mesh.topology == live_)) {
+        // bound to the vertex array of the caller's shader anyway
+        glGenBuffers(1, &topology.buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, topology.buffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, topology.indices->size() * sizeof(uint32_t),
+                     topology.indices->data(), GL_STATIC_DRAW);
+        bytes_ += size_t(topology.indices->size()) * sizeof(uint32_t);
+    }
+}
+
+void SceneBuffers::evict(Mesh& mesh) {
+    if (mesh.buffers[POSITIONS] == 0) return;
+    glDeleteBuffers(N_BUFFERS, mesh.buffers);
+    std::fill(mesh.buffers, mesh.buffers + N_BUFFERS, 0);
+    bytes_ -= vertex_bytes(mesh);
+}
+
+void SceneBuffers::trim() {
+    while (bytes_ > budget_) {
+        Mesh* oldest = nullptr;
+        for (Mesh& mesh : meshes_) {
+            if (mesh.visible || mesh.buffers[POSITIONS] == 0) continue;
+            if (!oldest || mesh.drawn < oldest->drawn) oldest = &mesh;
+        }
+        if (!oldest) break;
+        evict(*oldest);
+    }
+    // index buffers only stay for resident meshes, and not for the live
+    // topology, which draws from the shader's
+    for (auto& topology : topologies_) {
+        Topology& shared = topology.second;
+        if (shared.buffer == 0) continue;
+        bool used = !(has_live_ && topology.first == live_);
+        if (used) {
+            used = false;
+            for (const Mesh& mesh : meshes_) {
+                used = used || (mesh.topology == topology.first && mesh.buffers[POSITIONS] != 0);
+            }
+        }
+        if (!used) {
+            glDeleteBuffers(1, &shared.buffer);
+            shared.buffer = 0;
+            bytes_ -= size_t(shared.indices->size()) * sizeof(uint32_t);
+        }
+    }
+}
+
+void SceneBuffers::draw(nanogui::GLShader& shader, const nanogui::GLShader& live, const Eigen::Matrix4f& mv) {
+    ++frame_;
+    const GLint position = shader.attrib("position", false);
+    const GLint normal = shader.attrib("normal", false);
+    for (Mesh& mesh : meshes_) {
+        if (!mesh.visible) continue;
+        make_resident(mesh);
+        mesh.drawn = frame_;
+
+        // the packed attributes as uploadAttrib() declares them
+        if (position >= 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[POSITIONS]);
+            glEnableVertexAttribArray(position);
+            glVertexAttribPointer(position, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0, 0);
+        }
+        if (normal >= 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[NORMALS]);
+            glEnableVertexAttribArray(normal);
+            glVertexAttribPointer(normal, 2, GL_SHORT, GL_TRUE, 0, 0);
+        }
+        const Topology& topology = topologies_[mesh.topology];
+        if (topology.buffer != 0) {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, topology.buffer);
+        }
+        else {
+            shader.shareAttrib(live, "indices");
+        }
+
+        Eigen::Matrix4f moved = mv;
+        moved.block<3, 1>(0, 3) += mv.block<3, 3>(0, 0) * mesh.offset;
+        shader.setUniform("MV", moved);
+        shader.setUniform("box_min", mesh.box_min);
+        shader.setUniform("box_extent", mesh.box_extent);
+        glDrawElements(GL_TRIANGLES, GLsizei(topology.indices->size()), GL_UNSIGNED_INT, 0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    trim();
+}
+
+}
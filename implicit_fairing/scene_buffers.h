@@ -0,0 +1,107 @@
+#ifndef SCENE_BUFFERS_H
+#define SCENE_BUFFERS_H
+
+#include <nanogui/glutil.h>
+#include <Eigen/Core>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "vertex_packing.h"
+
+namespace mesh_processing {
+
+// The GPU buffers of the meshes the viewer draws next to its current mesh,
+// e.g. a snapshot before an operation, the positions at load time or other
+// scans side by side. Every mesh keeps its packed attributes on the CPU and
+// uploads its positions and normals once, when it is first drawn. Meshes
+// with the same topology key share one index buffer, the key of the current
+// mesh draws from the index buffer of the viewer's mesh shader, which the
+// scene does not own. While the buffers exceed the budget, those of hidden
+// meshes are freed, least recently drawn first, and uploaded again when the
+// mesh is shown. Needs a current GL context for all calls but the accessors.
+class SceneBuffers {
+
+public:
+    typedef Eigen::Matrix<uint32_t, Eigen::Dynamic, Eigen::Dynamic> Indices;
+
+    ~SceneBuffers() { clear(); }
+
+    // a mesh of points and triangles, 3 vertex indices per column, whose
+    // connectivity is identified by topology, e.g. topology_hash(); the
+    // indices of the first mesh of a topology are kept for all of them.
+    // Drawn moved by offset, visible; returns its index.
+    int add(const std::string& name, const Eigen::Map<const Eigen::Matrix3Xf>& points,
+            const std::shared_ptr<const Indices>& indices, const uint64_t topology,
+            const Eigen::Vector3f& offset);
+    // frees all buffers and forgets the meshes
+    void clear();
+
+    int size() const { return int(meshes_.size()); }
+    bool empty() const { return meshes_.empty(); }
+    const std::string& name(const int mesh) const { return meshes_[mesh].name; }
+    bool visible(const int mesh) const { return meshes_[mesh].visible; }
+    void set_visible(const int mesh, const bool visible);
+
+    // bytes of vertex and index buffers the scene owns on the GPU at most,
+    // the visible meshes are kept beyond it
+    void set_budget(const size_t bytes);
+    size_t budget() const { return budget_; }
+    // bytes of vertex and index buffers the scene owns on the GPU
+    size_t bytes() const { return bytes_; }
+
+    // meshes of topology draw from the index buffer of the shader passed
+    // to draw(), the owned buffer of that key is freed
+    void set_live_topology(const uint64_t topology);
+
+    // the visible meshes with shader, which is bound and has the uniforms
+    // but MV, box_min and box_extent set; mv is moved by the offset of
+    // every mesh. live holds the index buffer of the live topology.
+    void draw(nanogui::GLShader& shader, const nanogui::GLShader& live, const Eigen::Matrix4f& mv);
+
+private:
+    enum { POSITIONS = 0, NORMALS = 1, N_BUFFERS = 2 };
+
+    struct Mesh {
+        std::string name;
+        Eigen::Vector3f offset;
+        bool visible;
+        uint64_t topology;
+        PackedPositions positions;
+        PackedNormals normals;
+        Eigen::Vector3f box_min;
+        Eigen::Vector3f box_extent;
+        // 0 while not resident
+        GLuint buffers[N_BUFFERS];
+        // the draw() call it was last drawn in
+        long long drawn;
+    };
+
+    struct Topology {
+        std::shared_ptr<const Indices> indices;
+        // 0 while not resident
+        GLuint buffer;
+    };
+
+    // uploads what mesh needs but has no buffer for
+    void make_resident(Mesh& mesh);
+    void evict(Mesh& mesh);
+    // frees hidden meshes until the budget is met, and index buffers no
+    // resident mesh draws from
+    void trim();
+    static size_t vertex_bytes(const Mesh& mesh);
+
+    std::vector<Mesh> meshes_;
+    std::map<uint64_t, Topology> topologies_;
+    uint64_t live_ = 0;
+    bool has_live_ = false;
+    size_t budget_ = size_t(256) << 20;
+    size_t bytes_ = 0;
+    long long frame_ = 0;
+};
+
+}
+
+#endif // SCENE_BUFFERS_H
@@ -0,0 +1,150 @@
+#include "schwarz.h"
+#include <algorithm>
+#include <numeric>
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Surface_mesh;
+
+// assigns the parts [first_part, first_part + n_parts) to the vertices
+// [first, last) of order
+static void bisect(const surface_mesh::Property_vector<Point>& points, std::vector<int>& order,
+                   const int first, const int last, const int first_part, const int n_parts,
+                   std::vector<int>& part) {
+    if (n_parts == 1 || last - first <= 1) {
+        for (int i = first; i < last; ++i) part[order[i]] = first_part;
+        return;
+    }
+    Point lo = points[order[first]], hi = lo;
+    for (int i = first + 1; i < last; ++i) {
+        lo.minimize(points[order[i]]);
+        hi.maximize(points[order[i]]);
+    }
+    const Point extent = hi - lo;
+    const int axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 :
+                     extent[1] >= extent[2] ? 1 : 2;
+
+    // the vertex counts follow the part counts, also for odd n_parts
+    const int left_parts = n_parts / 2;
+    const int middle = first + int((long long)(last - first) * left_parts / n_parts);
+    std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+                     [&](const int a, const int b) { return points[a][axis] < points[b][axis]; });
+    bisect(points, order, first, middle, first_part, left_parts, part);
+    bisect(points, order, middle, last, first_part + left_parts, n_parts - left_parts, part);
+}
+
+std::vector<int> partition_vertices(const Surface_mesh& mesh, const int n_parts) {
+    const int n = mesh.n_vertices();
+    Surface_mesh::Vertex_property<Point> position =
+        mesh.get_vertex_property<Point>("v:point");
+    std::vector<int> part(n, 0);
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    bisect(position.vector(), order, 0, n, 0, std::max(1, n_parts), part);
+    return part;
+}
+
+void SchwarzPreconditioner::set_partition(const std::vector<int>& part,
+                                          const std::vector<int>& index, const int overlap) {
+    int n_rows = 0;
+    for (const int row: index) n_rows = std::max(n_rows, row + 1);
+    row_part_.assign(n_rows, 0);
+    n_parts_ = 0;
+    for (size_t v = 0; v < index.size() && v < part.size(); ++v) {
+        if (index[v] < 0) continue;
+        row_part_[index[v]] = part[v];
+        n_parts_ = std::max(n_parts_, part[v] + 1);
+    }
+    overlap_ = std::max(0, overlap);
+}
+
+void SchwarzPreconditioner::factorize(const Eigen::SparseMatrix<double>& A) {
+    const int n = A.rows();
+    // without a partition of these rows, one block: a direct solve
+    if (int(row_part_.size()) != n) {
+        row_part_.assign(n, 0);
+        n_parts_ = 1;
+    }
+    blocks_.resize(n_parts_);
+    for (Block& block: blocks_) block.rows.clear();
+    for (int r = 0; r < n; ++r) blocks_[row_part_[r]].rows.push_back(r);
+
+    std::vector<char> failed(blocks_.size(), 0);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int b = 0; b < int(blocks_.size()); ++b) {
+        Block& block = blocks_[b];
+        if (block.rows.empty()) continue;
+        // local[r] is the row of r in the block, -1 outside
+        std::vector<int> local(n, -1);
+        for (size_t i = 0; i < block.rows.size(); ++i) local[block.rows[i]] = int(i);
+        size_t frontier = 0;
+        for (int layer = 0; layer < overlap_; ++layer) {
+            const size_t end = block.rows.size();
+            for (size_t i = frontier; i < end; ++i) {
+                for (Eigen::SparseMatrix<double>::InnerIterator it(A, block.rows[i]); it; ++it) {
+                    if (local[it.row()] < 0) {
+                        local[it.row()] = int(block.rows.size());
+                        block.rows.push_back(it.row());
+                    }
+                }
+            }
+            frontier = end;
+        }
+
+        std::vector< Eigen::Triplet<double> > triplets;
+        for (size_t i = 0; i < block.rows.size(); ++i) {
+            for (Eigen::SparseMatrix<double>::InnerIterator it(A, block.rows[i]); it; ++it) {
+                if (local[it.row()] >= 0) {
+                    triplets.push_back(Eigen::Triplet<double>(local[it.row()], int(i), it.value()));
+                }
+            }
+        }
+        const int m = int(block.rows.size());
+        Eigen::SparseMatrix<double> sub(m, m);
+        sub.setFromTriplets(triplets.begin(), triplets.end());
+        if (!block.ldlt) block.ldlt.reset(new Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> >());
+        block.ldlt->compute(sub);
+        failed[b] = block.ldlt->info() != Eigen::Success;
+    }
+    info_ = std::count(failed.begin(), failed.end(), 1) ? Eigen::NumericalIssue : Eigen::Success;
+}
+
+Eigen::VectorXd SchwarzPreconditioner::solve(const Eigen::VectorXd& b) const {
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < int(blocks_.size()); ++k) {
+        const Block& block = blocks_[k];
+        if (block.rows.empty()) continue;
+        block.b.resize(block.rows.size());
+        for (size_t i = 0; i < block.rows.size(); ++i) block.b(i) = b(block.rows[i]);
+        block.x = block.ldlt->solve(block.b);
+    }
+    Eigen::VectorXd x = Eigen::VectorXd::Zero(b.size());
+    for (const Block& block: blocks_) {
+        if (block.rows.empty()) continue;
+        for (size_t i = 0; i < block.rows.size(); ++i) x(block.rows[i]) += block.x(i);
+    }
+    return x;
+}
+
+size_t SchwarzPreconditioner::memory_usage() const {
+    size_t bytes = row_part_.capacity() * sizeof(int);
+    for (const Block& block: blocks_) {
+        bytes += block.rows.capacity() * sizeof(int) +
+                 size_t(block.b.size() + block.x.size()) * sizeof(double);
+        if (block.ldlt && block.ldlt->info() == Eigen::Success && !block.rows.empty()) {
+            bytes += size_t(block.ldlt->matrixL().nestedExpression().nonZeros()) *
+                         (sizeof(double) + sizeof(int)) +
+                     size_t(block.ldlt->vectorD().size()) * sizeof(double);
+        }
+    }
+    return bytes;
+}
+
+void SchwarzPreconditioner::clear() {
+    blocks_.clear();
+    row_part_.clear();
+    n_parts_ = 0;
+}
+
+}
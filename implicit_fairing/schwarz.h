@@ -0,0 +1,65 @@
+#ifndef SCHWARZ_H
+#define SCHWARZ_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <Eigen/Sparse>
+#include <memory>
+#include <vector>
+
+namespace mesh_processing {
+
+// part[v] in [0, n_parts) for every vertex, by recursive coordinate
+// bisection: the vertices are split at the median along the longest axis
+// of their bounding box until there are n_parts blocks of equal size. A
+// geometric stand-in for a graph partitioner, on surface meshes the cuts
+// are about as short.
+std::vector<int> partition_vertices(const surface_mesh::Surface_mesh& mesh, const int n_parts);
+
+// Additive Schwarz preconditioner for SPD systems on the vertices of a
+// mesh, usable with Eigen::ConjugateGradient. Every block of the partition
+// is grown by overlap layers of neighbours in the graph of A and its
+// principal submatrix factorized with LDLT; an application solves all
+// blocks independently, in parallel over the blocks, and sums the local
+// solutions. The blocks are the unit a distributed solver would place on
+// its nodes. Call set_partition() before compute().
+class SchwarzPreconditioner {
+
+public:
+    SchwarzPreconditioner() : info_(Eigen::Success), overlap_(1) {}
+
+    // part[v] is the block of vertex v, index[v] its row in A or -1
+    void set_partition(const std::vector<int>& part, const std::vector<int>& index,
+                       const int overlap = 1);
+
+    void analyzePattern(const Eigen::SparseMatrix<double>& A) {}
+    void factorize(const Eigen::SparseMatrix<double>& A);
+    void compute(const Eigen::SparseMatrix<double>& A) { factorize(A); }
+
+    // sum of the block solutions of A*x = b
+    Eigen::VectorXd solve(const Eigen::VectorXd& b) const;
+
+    Eigen::ComputationInfo info() const { return info_; }
+    int n_blocks() const { return int(blocks_.size()); }
+    // bytes of the block factors and row lists
+    size_t memory_usage() const;
+    // drops the blocks
+    void clear();
+
+private:
+    struct Block {
+        // rows of A in the block, the owned ones and the overlap
+        std::vector<int> rows;
+        std::unique_ptr< Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > > ldlt;
+        mutable Eigen::VectorXd b, x;
+    };
+    // block of each row of A, from set_partition()
+    std::vector<int> row_part_;
+    int n_parts_ = 0;
+    std::vector<Block> blocks_;
+    Eigen::ComputationInfo info_;
+    int overlap_;
+};
+
+}
+
+#endif // SCHWARZ_H
@@ -0,0 +1,466 @@
+#include "server.h"
+#include "mesh_processing.h"
+#include "metrics.h"
+#include <surface_mesh/IO.h>
+#include <surface_mesh/Trace.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace mesh_processing {
+
+using std::cerr;
+using std::endl;
+using std::string;
+using surface_mesh::Surface_mesh;
+
+#if defined(_WIN32)
+typedef SOCKET Socket;
+static const Socket invalid_socket = INVALID_SOCKET;
+static void close_socket(const Socket s) { closesocket(s); }
+#else
+typedef int Socket;
+static const Socket invalid_socket = -1;
+static void close_socket(const Socket s) { ::close(s); }
+#endif
+
+// larger requests are refused, their connection is closed
+static const uint64_t MAX_REQUEST_SIZE = uint64_t(1) << 30;
+
+struct RequestHeader {
+    char magic[4];
+    uint32_t id;
+    uint32_t operation;
+    uint32_t format;
+    uint32_t parameter;
+    float timestep;
+    uint64_t size;
+};
+
+struct ResponseHeader {
+    char magic[4];
+    uint32_t id;
+    uint32_t status;
+    uint32_t n_vertices;
+    uint64_t size;
+};
+
+static_assert(sizeof(RequestHeader) == 32 && sizeof(ResponseHeader) == 24,
+              "the headers are part of the protocol");
+
+// false if the peer went away before n bytes were transferred
+static bool receive_all(const Socket s, void* data, size_t n) {
+    char* p = static_cast<char*>(data);
+    while (n > 0) {
+        const int chunk = int(std::min(n, size_t(1) << 30));
+        const int got = (int) recv(s, p, chunk, 0);
+        if (got <= 0) return false;
+        p += got;
+        n -= size_t(got);
+    }
+    return true;
+}
+
+static bool send_all(const Socket s, const void* data, size_t n) {
+    const char* p = static_cast<const char*>(data);
+    while (n > 0) {
+        const int chunk = int(std::min(n, size_t(1) << 30));
+        const int sent = (int) send(s, p, chunk, 0);
+        if (sent <= 0) return false;
+        p += sent;
+        n -= size_t(sent);
+    }
+    return true;
+}
+
+// one client, kept alive by its reader thread and its requests in flight;
+// the responses of several batches may be sent at the same time
+class Connection {
+public:
+    explicit Connection(const Socket s) : socket_(s) {}
+    ~Connection() { close_socket(socket_); }
+    Socket socket() const { return socket_; }
+    void respond(const ResponseHeader& header, const void* data) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (send_all(socket_, &header, sizeof(header)) && header.size > 0) {
+            send_all(socket_, data, size_t(header.size));
+        }
+    }
+
+private:
+    Socket socket_;
+    std::mutex mutex_;
+};
+
+struct Request {
+    std::shared_ptr<Connection> connection;
+    RequestHeader header;
+    std::vector<char> payload;
+    // the decoded mesh and the hash of its connectivity
+    Surface_mesh mesh;
+    uint64_t key = 0;
+    bool decoded = false;
+};
+
+static void decode(Request& request) {
+    const RequestHeader& header = request.header;
+    const char* data = request.payload.data();
+    const size_t size = request.payload.size();
+    bool ok = false;
+    if (header.operation <= ServerRequest::CURVATURE && size > 0) {
+        if (header.format == ServerRequest::POLY) {
+            ok = surface_mesh::read_poly(request.mesh, data, size);
+        } else if (header.format == ServerRequest::SMC) {
+            ok = surface_mesh::read_smc(request.mesh, data, size);
+        }
+    }
+    request.decoded = ok && request.mesh.n_vertices() > 0 && !request.mesh.has_garbage();
+    if (request.decoded) request.key = topology_hash(request.mesh);
+    std::vector<char>().swap(request.payload);
+}
+
+// the MeshProcessing of the recent connectivities, the least recently used
+// is dropped first; one MeshProcessing serves one request at a time, the
+// dispatcher runs the requests of a connectivity one after the other
+class MeshCache {
+public:
+    explicit MeshCache(const size_t capacity) : capacity_(std::max(capacity, size_t(1))) {}
+
+    // the MeshProcessing of key with the positions of mesh, built from mesh
+    // if it is not kept
+    std::shared_ptr<MeshProcessing> acquire(const uint64_t key, const Surface_mesh& mesh) {
+        std::shared_ptr<MeshProcessing> found;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                if (it->first != key) continue;
+                found = it->second;
+                entries_.splice(entries_.begin(), entries_, it);
+                break;
+            }
+        }
+        // the faces are compared in case two connectivities share the hash
+        if (found && found->get_number_of_face() == mesh.n_faces()) {
+            const std::vector<surface_mesh::Point> points(mesh.points().begin(), mesh.points().end());
+            if (found->replace_positions(points)) {
+                Metrics::record_cache("mesh", true);
+                return found;
+            }
+        }
+        Metrics::record_cache("mesh", false);
+        found = std::make_shared<MeshProcessing>(mesh);
+        // a server has no use for undo, the symbolic analyses stay in memory
+        found->set_history_budget(0);
+        found->set_symbolic_cache(true);
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.remove_if([&](const Entry& e) { return e.first == key; });
+        entries_.emplace_front(key, found);
+        if (entries_.size() > capacity_) entries_.pop_back();
+        return found;
+    }
+
+private:
+    typedef std::pair<uint64_t, std::shared_ptr<MeshProcessing> > Entry;
+    std::list<Entry> entries_;
+    size_t capacity_;
+    std::mutex mutex_;
+};
+
+// the operation label of the metrics
+static const char* operation_name(const uint32_t operation) {
+    switch (operation) {
+    case ServerRequest::IMPLICIT_SMOOTHING: return "implicit_smoothing";
+    case ServerRequest::MINIMAL_SURFACE: return "minimal_surface";
+    case ServerRequest::CURVATURE: return "curvature";
+    default: return "unknown";
+    }
+}
+
+static void process(Request& request, MeshCache& cache) {
+    SURFACE_MESH_TRACE_ZONE("request");
+    const RequestHeader& header = request.header;
+    Metrics::Operation operation(operation_name(header.operation),
+                                 request.decoded ? request.mesh.n_vertices() : 0);
+    ResponseHeader response = { { 'G', 'P', 'R', 'S' }, header.id, ServerResponse::OK, 0, 0 };
+    std::vector<float> result;
+    if (!request.decoded) {
+        response.status = ServerResponse::BAD_REQUEST;
+    } else if (header.operation == ServerRequest::CURVATURE &&
+               header.parameter > MeshProcessing::SCALAR_MIN_CURVATURE) {
+        response.status = ServerResponse::BAD_REQUEST;
+    } else {
+        std::shared_ptr<MeshProcessing> mesh = cache.acquire(request.key, request.mesh);
+        response.n_vertices = mesh->get_number_of_vertices();
+        switch (header.operation) {
+        case ServerRequest::IMPLICIT_SMOOTHING:
+            if (!(header.timestep > 0.0f)) {
+                response.status = ServerResponse::BAD_REQUEST;
+                break;
+            }
+            for (uint32_t k = 0; k < std::max(header.parameter, 1u); ++k) {
+                mesh->implicit_smoothing(header.timestep);
+            }
+            break;
+        case ServerRequest::MINIMAL_SURFACE:
+            mesh->minimal_surface();
+            break;
+        }
+        if (response.status == ServerResponse::OK) {
+            if (header.operation == ServerRequest::CURVATURE) {
+                float min_value, max_value;
+                const ConstRowXfMap scalars = mesh->get_scalars(
+                    MeshProcessing::SCALAR_TYPE(header.parameter), min_value, max_value);
+                result.assign(scalars.data(), scalars.data() + scalars.size());
+            } else {
+                const ConstMatrix3XfMap points = mesh->get_points();
+                result.assign(points.data(), points.data() + points.size());
+            }
+        }
+    }
+    if (response.status != ServerResponse::OK) operation.fail();
+    response.size = result.size() * sizeof(float);
+    request.connection->respond(response, result.data());
+}
+
+class Server {
+public:
+    explicit Server(const ServerOptions& options) : cache_(options.cache_size) {}
+
+    // reads the requests of connection until it is closed
+    void serve(const std::shared_ptr<Connection>& connection) {
+        for (;;) {
+            std::unique_ptr<Request> request(new Request);
+            RequestHeader& header = request->header;
+            if (!receive_all(connection->socket(), &header, sizeof(header))) return;
+            if (memcmp(header.magic, "GPRQ", 4) != 0 || header.size > MAX_REQUEST_SIZE) {
+                const ResponseHeader response = { { 'G', 'P', 'R', 'S' }, header.id,
+                                                  ServerResponse::BAD_REQUEST, 0, 0 };
+                connection->respond(response, nullptr);
+                return;
+            }
+            request->connection = connection;
+            request->payload.resize(size_t(header.size));
+            if (header.size > 0 &&
+                !receive_all(connection->socket(), request->payload.data(), size_t(header.size))) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(request));
+            queued_.notify_one();
+        }
+    }
+
+    // takes what is queued as one batch, over and over
+    void dispatch() {
+        for (;;) {
+            std::vector<std::unique_ptr<Request> > batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                queued_.wait(lock, [&] { return !queue_.empty(); });
+                batch.swap(queue_);
+            }
+            run(batch);
+        }
+    }
+
+private:
+    void run(std::vector<std::unique_ptr<Request> >& batch) {
+        SURFACE_MESH_TRACE_ZONE("batch");
+        const int n = int(batch.size());
+#pragma omp parallel for schedule(dynamic, 1) if (n > 1)
+        for (int i = 0; i < n; ++i) {
+            decode(*batch[i]);
+        }
+
+        // the requests of one connectivity share a MeshProcessing and run
+        // one after the other, in the order they arrived
+        std::vector<std::vector<Request*> > groups;
+        std::unordered_map<uint64_t, size_t> group_of;
+        for (const std::unique_ptr<Request>& request : batch) {
+            if (!request->decoded) {
+                groups.push_back(std::vector<Request*>(1, request.get()));
+                continue;
+            }
+            auto it = group_of.find(request->key);
+            if (it == group_of.end()) {
+                it = group_of.emplace(request->key, groups.size()).first;
+                groups.push_back(std::vector<Request*>());
+            }
+            groups[it->second].push_back(request.get());
+        }
+
+        // one group per thread; a single group runs outside of the parallel
+        // region, so that its solves and loops have all threads
+        const int n_groups = int(groups.size());
+#pragma omp parallel for schedule(dynamic, 1) if (n_groups > 1)
+        for (int g = 0; g < n_groups; ++g) {
+            for (Request* request : groups[g]) {
+                process(*request, cache_);
+            }
+        }
+    }
+
+    MeshCache cache_;
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::vector<std::unique_ptr<Request> > queue_;
+};
+
+bool is_server_command(int argc, char** argv) {
+    return argc > 1 && strcmp(argv[1], "--serve") == 0;
+}
+
+bool parse_server_options(int argc, char** argv, ServerOptions& options, string& error) {
+    for (int i = 2; i < argc; ++i) {
+        const string arg = argv[i];
+        if (i + 1 >= argc) {
+            error = arg == "--port" || arg == "--host" || arg == "--cache" ||
+                    arg == "--metrics-port"
+                  ? arg + " expects 1 value(s)" : "unknown option " + arg;
+            return false;
+        }
+        char* end = nullptr;
+        if (arg == "--host") {
+            options.host = argv[++i];
+        } else if (arg == "--port" || arg == "--metrics-port") {
+            const long port = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || port < 1 || port > 65535) {
+                error = "invalid port " + string(argv[i]);
+                return false;
+            }
+            (arg == "--port" ? options.port : options.metrics_port) = (unsigned int) port;
+        } else if (arg == "--cache") {
+            const long n = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || n < 1) {
+                error = "invalid cache size " + string(argv[i]);
+                return false;
+            }
+            options.cache_size = (unsigned int) n;
+        } else {
+            error = "unknown option " + arg;
+            return false;
+        }
+    }
+    return true;
+}
+
+// a socket listening on host:port, invalid_socket and a message if it
+// cannot be bound
+static Socket open_listener(const string& host, const unsigned int port) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short) port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        cerr << host << ": not an IPv4 address" << endl;
+        return invalid_socket;
+    }
+    const Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == invalid_socket) return invalid_socket;
+    const int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*) &yes, sizeof(yes));
+    if (bind(listener, (const sockaddr*) &address, sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        cerr << host << ":" << port << ": cannot listen" << endl;
+        close_socket(listener);
+        return invalid_socket;
+    }
+    return listener;
+}
+
+// answers every connection with the metrics as an HTTP/1.0 response and
+// closes it; whatever the scraper asked for is read up to the end of its
+// headers and ignored
+static void serve_metrics(const Socket listener) {
+    for (;;) {
+        const Socket s = accept(listener, nullptr, nullptr);
+        if (s == invalid_socket) continue;
+        string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == string::npos && request.size() < 65536) {
+            const int n = int(recv(s, buffer, sizeof(buffer), 0));
+            if (n <= 0) break;
+            request.append(buffer, size_t(n));
+        }
+        const string body = Metrics::openmetrics();
+        const string response =
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        send_all(s, response.data(), response.size());
+        close_socket(s);
+    }
+}
+
+bool run_server(const ServerOptions& options) {
+#if defined(_WIN32)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+#else
+    // a client that goes away must not end the server
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    const Socket listener = open_listener(options.host, options.port);
+    if (listener == invalid_socket) return false;
+    cerr << "serving on " << options.host << ":" << options.port << endl;
+    if (options.metrics_port != 0) {
+        const Socket metrics = open_listener(options.host, options.metrics_port);
+        if (metrics == invalid_socket) {
+            close_socket(listener);
+            return false;
+        }
+        Metrics::enable();
+        std::thread(serve_metrics, metrics).detach();
+        cerr << "metrics on " << options.host << ":" << options.metrics_port << endl;
+    }
+
+    Server server(options);
+    std::thread(&Server::dispatch, &server).detach();
+    const int yes = 1;
+    for (;;) {
+        const Socket s = accept(listener, nullptr, nullptr);
+        if (s == invalid_socket) continue;
+        // the responses are small and wanted at once
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*) &yes, sizeof(yes));
+        std::shared_ptr<Connection> connection = std::make_shared<Connection>(s);
+        std::thread(&Server::serve, &server, connection).detach();
+    }
+}
+
+void print_server_usage(const char* program) {
+    cerr << "usage: " << program << " --serve [options]\n"
+         << "serves implicit smoothing, minimal surfaces and curvatures over TCP,\n"
+         << "see server.h for the protocol\n"
+         << "options:\n"
+         << "  --host ADDR    IPv4 address to listen on (127.0.0.1)\n"
+         << "  --port N       port to listen on (7878)\n"
+         << "  --cache N      connectivities whose meshes and factorizations are\n"
+         << "                 kept (16)\n"
+         << "  --metrics-port N\n"
+         << "                 serves the metrics in the OpenMetrics text format over\n"
+         << "                 HTTP on port N of the same address (off)" << endl;
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstdint>
+#include <string>
+
+namespace mesh_processing {
+
+// A long-lived process that smooths meshes for clients over TCP, so that
+// small meshes do not pay for a process start each. Every connection sends
+// requests and receives one response per request, in the order they finish.
+//
+// A request, in host byte order like the poly files:
+//
+//   char[4]   "GPRQ"
+//   uint32    id, echoed by the response
+//   uint32    operation, see ServerRequest::OPERATION
+//   uint32    format of the mesh, see ServerRequest::FORMAT
+//   uint32    implicit steps, or the MeshProcessing::SCALAR_TYPE of CURVATURE
+//   float     time step of IMPLICIT_SMOOTHING
+//   uint64    size of the mesh in bytes, followed by the mesh
+//
+// A response:
+//
+//   char[4]   "GPRS"
+//   uint32    id of the request
+//   uint32    status, see ServerResponse::STATUS
+//   uint32    number of vertices
+//   uint64    size of the result in bytes, followed by the result: 3 floats
+//             per vertex for the smoothing operations, 1 per vertex for
+//             CURVATURE, in the vertex order of the mesh as it was decoded
+//
+// The meshes of recent requests are kept by the hash of their connectivity,
+// together with what the solves derived from it; a request with a kept
+// connectivity only replaces the positions. The requests that arrive while
+// others run are taken as one batch, its meshes one per thread, a batch of
+// one mesh with all threads.
+struct ServerRequest {
+    enum OPERATION : uint32_t { IMPLICIT_SMOOTHING = 0, MINIMAL_SURFACE = 1, CURVATURE = 2 };
+    // POLY as written by surface_mesh::write_poly(), SMC compressed by
+    // surface_mesh::write_smc()
+    enum FORMAT : uint32_t { POLY = 0, SMC = 1 };
+};
+
+struct ServerResponse {
+    enum STATUS : uint32_t { OK = 0, BAD_REQUEST = 1, FAILED = 2 };
+};
+
+struct ServerOptions {
+    // the server only listens on the loopback interface unless told otherwise
+    std::string host = "127.0.0.1";
+    unsigned int port = 7878;
+    // connectivities whose meshes and factorizations are kept
+    unsigned int cache_size = 16;
+    // port of the HTTP endpoint that Prometheus scrapes, see Metrics; 0 for
+    // none
+    unsigned int metrics_port = 0;
+};
+
+// true if argv asks for the server, i.e. starts with --serve
+bool is_server_command(int argc, char** argv);
+// parses the arguments after --serve, false and a message on error
+bool parse_server_options(int argc, char** argv, ServerOptions& options, std::string& error);
+// serves until the process is stopped, false if the port cannot be bound
+bool run_server(const ServerOptions& options);
+void print_server_usage(const char* program);
+
+}
+
+#endif // SERVER_H
@@ -0,0 +1,203 @@
+#include "soa_geometry.h"
+#include "geometry_kernels.h"
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+using surface_mesh::Property_vector;
+typedef surface_mesh::Surface_mesh Mesh;
+
+void SoAGeometry::build(const Mesh& mesh) {
+    const int n_halfedges = mesh.halfedges_size();
+    halfedge_to_.assign(n_halfedges, 0);
+    halfedge_corner_.assign(n_halfedges, 0);
+
+    // the edge of halfedge h is h >> 1 and its opposite h ^ 1
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_halfedges; ++i) {
+        if (mesh.is_deleted(Mesh::Edge(i >> 1))) continue;
+
+        Mesh::Halfedge h(i);
+        halfedge_to_[i] = mesh.to_vertex(h).idx();
+        halfedge_corner_[i] = mesh.is_boundary(h)
+                                  ? mesh.to_vertex(Mesh::Halfedge(i & ~1)).idx()
+                                  : mesh.to_vertex(mesh.next_halfedge(h)).idx();
+    }
+
+    const int n_faces = mesh.faces_size();
+    for (int k = 0; k < 3; ++k) {
+        face_h_[k].assign(n_faces, -1);
+        face_v_[k].assign(n_faces, 0);
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_faces; ++i) {
+        Mesh::Face f(i);
+        if (mesh.is_deleted(f)) continue;
+
+        Mesh::Halfedge h = mesh.halfedge(f);
+        for (int k = 0; k < 3; ++k) {
+            face_h_[k][i] = h.idx();
+            face_v_[k][i] = mesh.to_vertex(h).idx();
+            h = mesh.next_halfedge(h);
+        }
+    }
+
+    const int n_vertices = mesh.vertices_size();
+    vertex_offsets_.assign(n_vertices + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i) {
+        Mesh::Vertex v(i);
+        if (mesh.is_deleted(v)) continue;
+        int count = 0;
+        for (auto f: mesh.faces(v)) {
+            (void) f;
+            ++count;
+        }
+        vertex_offsets_[i + 1] = count;
+    }
+    for (int i = 0; i < n_vertices; ++i) vertex_offsets_[i + 1] += vertex_offsets_[i];
+    vertex_faces_.resize(vertex_offsets_[n_vertices]);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i) {
+        if (vertex_offsets_[i] == vertex_offsets_[i + 1]) continue;
+        int k = vertex_offsets_[i];
+        for (auto f: mesh.faces(Mesh::Vertex(i))) vertex_faces_[k++] = f.idx();
+    }
+}
+
+size_t SoAGeometry::memory_usage() const {
+    size_t bytes = (halfedge_to_.capacity() + halfedge_corner_.capacity()) * sizeof(int);
+    for (int k = 0; k < 3; ++k) {
+        bytes += (face_h_[k].capacity() + face_v_[k].capacity()) * sizeof(int);
+    }
+    bytes += (vertex_offsets_.capacity() + vertex_faces_.capacity()) * sizeof(int);
+    return bytes;
+}
+
+void SoAGeometry::load(const Property_vector<Point>& points, Positions& positions) {
+    const int n = points.size();
+    positions.x.resize(n);
+    positions.y.resize(n);
+    positions.z.resize(n);
+    float* x = positions.x.data();
+    float* y = positions.y.data();
+    float* z = positions.z.data();
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        x[i] = points[i][0];
+        y[i] = points[i][1];
+        z[i] = points[i][2];
+    }
+}
+
+void SoAGeometry::edge_cotan_weights(const Positions& positions, const float max_cotan,
+                                     Property_vector<Scalar>& weights) const {
+    const int n_edges = halfedge_to_.size() / 2;
+    const float* x = positions.x.data();
+    const float* y = positions.y.data();
+    const float* z = positions.z.data();
+    Scalar* w = weights.data();
+
+    geometry_kernels().edge_cotan_weights(n_edges, x, y, z, halfedge_to_.data(),
+                                          halfedge_corner_.data(), max_cotan, w);
+}
+
+void SoAGeometry::face_areas(const Positions& positions, std::vector<Scalar>& areas) const {
+    const int n_faces = face_v_[0].size();
+    const float* x = positions.x.data();
+    const float* y = positions.y.data();
+    const float* z = positions.z.data();
+    const int* f0 = face_v_[0].data();
+    const int* f1 = face_v_[1].data();
+    const int* f2 = face_v_[2].data();
+    Scalar* area = areas.data();
+
+    geometry_kernels().face_areas(n_faces, x, y, z, f0, f1, f2, area);
+}
+
+void SoAGeometry::face_areas_cotans(const Positions& positions, const float max_cotan,
+                                    std::vector<Scalar>& areas,
+                                    Property_vector<Scalar>& halfedge_cotans) const {
+    const int n_faces = face_v_[0].size();
+    const float* x = positions.x.data();
+    const float* y = positions.y.data();
+    const float* z = positions.z.data();
+    const int* f0 = face_v_[0].data();
+    const int* f1 = face_v_[1].data();
+    const int* f2 = face_v_[2].data();
+    Scalar* area = areas.data();
+    std::vector<float> cot0(n_faces), cot1(n_faces), cot2(n_faces);
+    float* c0 = cot0.data();
+    float* c1 = cot1.data();
+    float* c2 = cot2.data();
+
+    // vectorized over faces, the cotangents are scattered to the halfedges
+    // in a second pass
+    geometry_kernels().face_areas_cotans(n_faces, x, y, z, f0, f1, f2, max_cotan, area,
+                                         c0, c1, c2);
+
+    const int* h0 = face_h_[0].data();
+    const int* h1 = face_h_[1].data();
+    const int* h2 = face_h_[2].data();
+    Scalar* cot = halfedge_cotans.data();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_faces; ++i) {
+        if (h0[i] < 0) continue;
+        cot[h0[i]] = c0[i];
+        cot[h1[i]] = c1[i];
+        cot[h2[i]] = c2[i];
+    }
+}
+
+void SoAGeometry::corner_angles(const Positions& positions,
+                                Property_vector<Scalar>& halfedge_angles) const {
+    const int n_faces = face_v_[0].size();
+    const float* x = positions.x.data();
+    const float* y = positions.y.data();
+    const float* z = positions.z.data();
+    const int* f0 = face_v_[0].data();
+    const int* f1 = face_v_[1].data();
+    const int* f2 = face_v_[2].data();
+    std::vector<float> angle0(n_faces), angle1(n_faces), angle2(n_faces);
+    float* a0 = angle0.data();
+    float* a1 = angle1.data();
+    float* a2 = angle2.data();
+
+    geometry_kernels().corner_angles(n_faces, x, y, z, f0, f1, f2, a0, a1, a2);
+
+    const int* h0 = face_h_[0].data();
+    const int* h1 = face_h_[1].data();
+    const int* h2 = face_h_[2].data();
+    Scalar* angle = halfedge_angles.data();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_faces; ++i) {
+        if (h0[i] < 0) continue;
+        angle[h0[i]] = a0[i];
+        angle[h1[i]] = a1[i];
+        angle[h2[i]] = a2[i];
+    }
+}
+
+void SoAGeometry::vertex_weights(const std::vector<Scalar>& areas,
+                                 Property_vector<Scalar>& weights) const {
+    const int n_vertices = int(vertex_offsets_.size()) - 1;
+    const int* offsets = vertex_offsets_.data();
+    const int* faces = vertex_faces_.data();
+    const Scalar* area = areas.data();
+    Scalar* w = weights.data();
+
+    // summed in circulator order, as the halfedge loop
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n_vertices; ++i) {
+        const int begin = offsets[i], end = offsets[i + 1];
+        if (begin == end) continue;
+        Scalar sum = 0.0;
+        for (int k = begin; k < end; ++k) sum += area[faces[k]] * 0.3333f;
+        w[i] = 0.5 / sum;
+    }
+}
+
+}
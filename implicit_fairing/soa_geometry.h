@@ -0,0 +1,94 @@
+#ifndef SOA_GEOMETRY_H
+#define SOA_GEOMETRY_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <algorithm>
+#include <vector>
+
+namespace mesh_processing {
+
+// bound of the corner cotangents unless set otherwise, about the cotangent
+// of a 0.0006 degree angle; well-shaped meshes stay far below
+const float DEFAULT_MAX_COTAN = 1e5f;
+
+// a corner cotangent clamped to [-max_cotan, max_cotan]: the corner of a
+// degenerate triangle gets the bound for an infinite cotangent and 0 for
+// 0 / 0, so that the weights and the systems built from them stay finite
+inline float clamp_cotan(const float cot, const float max_cotan) {
+    return cot == cot ? std::min(std::max(cot, -max_cotan), max_cotan) : 0.0f;
+}
+
+// Structure-of-arrays mirror of the vertex positions with flat vertex
+// stencils per halfedge and per face, and the faces around every vertex. It is
+// the triangle mesh view of the halfedge structure: a face is three indexed
+// array lookups instead of a circulator loop. The weight kernels run over unit-stride
+// index arrays and separate x/y/z arrays, so the compiler turns them into
+// vector code; on x86 they are dispatched at runtime to AVX2 or AVX-512
+// variants where the host has them, see geometry_kernels.h.
+// build() once per connectivity; the positions are loaded into a Positions
+// of the caller per kernel call, so the kernels only read the stencils and
+// can run concurrently. The arithmetic follows the scalar Vector code step by step, results are
+// bitwise equal as long as the compiler does not contract into FMAs.
+class SoAGeometry {
+
+public:
+    void build(const surface_mesh::Surface_mesh& mesh);
+    bool empty() const { return halfedge_to_.empty() && face_h_[0].empty(); }
+
+    // bytes reserved by the arrays
+    size_t memory_usage() const;
+
+    // the x/y/z arrays of the positions the kernels read
+    struct Positions {
+        std::vector<float> x, y, z;
+        size_t memory_usage() const {
+            return (x.capacity() + y.capacity() + z.capacity()) * sizeof(float);
+        }
+    };
+    // copy the positions into the x/y/z arrays
+    static void load(const surface_mesh::Property_vector<surface_mesh::Point>& points,
+                     Positions& positions);
+
+    // cotan weight of every edge, as MeshProcessing::calc_edges_weights,
+    // with the corners clamped to max_cotan; one pass over the halfedge
+    // pairs
+    void edge_cotan_weights(const Positions& positions, const float max_cotan,
+                            surface_mesh::Property_vector<surface_mesh::Scalar>& weights) const;
+
+    // area of the first triangle of every face and the cotangent of the
+    // corner opposite to each of its halfedges, as MeshProcessing::calc_weights
+    void face_areas(const Positions& positions, std::vector<surface_mesh::Scalar>& areas) const;
+    void face_areas_cotans(const Positions& positions, const float max_cotan,
+                           std::vector<surface_mesh::Scalar>& areas,
+                           surface_mesh::Property_vector<surface_mesh::Scalar>& halfedge_cotans) const;
+    // angle of the corner opposite to each halfedge of the faces, the
+    // atan2 of the cross and the dot product of its edges, indexed like the
+    // cotangents above; exact down to degenerate corners, which get 0
+    void corner_angles(const Positions& positions,
+                       surface_mesh::Property_vector<surface_mesh::Scalar>& halfedge_angles) const;
+    // vertex weights of MeshProcessing::calc_weights from the areas above, 0.5 over
+    // a third of the area of the faces around each vertex; isolated and
+    // deleted vertices keep their weight
+    void vertex_weights(const std::vector<surface_mesh::Scalar>& areas,
+                        surface_mesh::Property_vector<surface_mesh::Scalar>& weights) const;
+
+private:
+    // halfedge h points to halfedge_to_[h], halfedge_corner_[h] is the
+    // corner opposite to it in its face. Edge i is the halfedge pair 2i,
+    // 2i + 1, so the stencil of an edge is read in one contiguous block;
+    // a boundary halfedge has its corner set to halfedge_to_[h & ~1], a
+    // deleted edge is all vertex 0
+    std::vector<int> halfedge_to_, halfedge_corner_;
+
+    // the first three halfedges of every face and their target vertices,
+    // deleted faces have halfedges -1 and point to vertex 0
+    std::vector<int> face_h_[3], face_v_[3];
+
+    // the faces around vertex i in circulator order are
+    // vertex_faces_[vertex_offsets_[i] .. vertex_offsets_[i+1])
+    std::vector<int> vertex_offsets_, vertex_faces_;
+};
+
+}
+
+#endif // SOA_GEOMETRY_H
@@ -0,0 +1,344 @@
+
+#include "solver_backend.h"
+#ifdef GP_HAVE_CHOLMOD
+#include <Eigen/CholmodSupport>
+#endif
+#ifdef GP_HAVE_PARDISO
+#include <Eigen/PardisoSupport>
+#endif
+#ifdef GP_HAVE_CUSOLVER
+#include <cuda_runtime.h>
+#include <cusolverSp.h>
+#include <cusolverSp_LOWLEVEL_PREVIEW.h>
+#include <cusparse.h>
+#endif
+#ifdef GP_HAVE_AMGX
+#include <amgx_c.h>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#endif
+
+namespace mesh_processing {
+
+#ifdef GP_HAVE_CHOLMOD
+// CHOLMOD supernodal Cholesky, the BLAS-3 kernels run on the threads of the
+// linked BLAS
+class CholmodBackend : public SpdBackend {
+public:
+    const char* name() const { return "CHOLMOD supernodal"; }
+    void analyze(const Eigen::SparseMatrix<double>& A) { solver_.analyzePattern(A); }
+    bool factorize(const Eigen::SparseMatrix<double>& A) {
+        solver_.factorize(A);
+        return solver_.info() == Eigen::Success;
+    }
+    void solve(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) { X = solver_.solve(B); }
+    size_t memory() const {
+        // the factor is the bulk of what CHOLMOD holds
+        return const_cast<Solver&>(solver_).cholmod().memory_inuse;
+    }
+
+private:
+    typedef Eigen::CholmodSupernodalLLT< Eigen::SparseMatrix<double>, Eigen::Lower > Solver;
+    Solver solver_;
+};
+#endif
+
+#ifdef GP_HAVE_PARDISO
+// MKL Pardiso for symmetric positive definite matrices, multi-threaded
+// through the MKL runtime
+class PardisoBackend : public SpdBackend {
+public:
+    const char* name() const { return "MKL Pardiso"; }
+    void analyze(const Eigen::SparseMatrix<double>& A) { solver_.analyzePattern(A); }
+    bool factorize(const Eigen::SparseMatrix<double>& A) {
+        solver_.factorize(A);
+        return solver_.info() == Eigen::Success;
+    }
+    void solve(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) { X = solver_.solve(B); }
+    size_t memory() const {
+        // the factorization reports the nonzeros of the factor in iparm[17]
+        const long nonzeros = const_cast<Solver&>(solver_).pardisoParameterArray()[17];
+        return nonzeros > 0 ? size_t(nonzeros) * (sizeof(double) + sizeof(int)) : 0;
+    }
+
+private:
+    typedef Eigen::PardisoLLT< Eigen::SparseMatrix<double>, Eigen::Lower > Solver;
+    Solver solver_;
+};
+#endif
+
+#ifdef GP_HAVE_CUSOLVER
+// device memory that only grows, so that repeated solves reuse it
+class DeviceBuffer {
+public:
+    DeviceBuffer() {}
+    ~DeviceBuffer() {
+        if (data_) cudaFree(data_);
+    }
+    void* reserve(const size_t bytes) {
+        if (bytes <= bytes_) return data_;
+        if (data_) cudaFree(data_);
+        data_ = nullptr;
+        bytes_ = 0;
+        if (cudaMalloc(&data_, bytes) == cudaSuccess) bytes_ = bytes;
+        return data_;
+    }
+    template <typename T>
+    T* upload(const T* data, const size_t n) {
+        T* device = static_cast<T*>(reserve(n * sizeof(T)));
+        if (device) cudaMemcpy(device, data, n * sizeof(T), cudaMemcpyHostToDevice);
+        return device;
+    }
+    size_t bytes() const { return bytes_; }
+
+private:
+    DeviceBuffer(const DeviceBuffer&) = delete;
+    DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+    void* data_ = nullptr;
+    size_t bytes_ = 0;
+};
+
+// sparse Cholesky of cuSOLVER on the device: the analysis of the pattern,
+// the factor of the values and the triangular solves, every one kept
+// there until the next call that needs it again
+class CusolverBackend : public SpdBackend {
+public:
+    CusolverBackend() {
+        cusolverSpCreate(&handle_);
+        cusparseCreateMatDescr(&descr_);
+        cusparseSetMatType(descr_, CUSPARSE_MATRIX_TYPE_GENERAL);
+        cusparseSetMatIndexBase(descr_, CUSPARSE_INDEX_BASE_ZERO);
+    }
+    ~CusolverBackend() {
+        if (info_) cusolverSpDestroyCsrcholInfo(info_);
+        cusparseDestroyMatDescr(descr_);
+        cusolverSpDestroy(handle_);
+    }
+    const char* name() const { return "cuSOLVER sparse Cholesky"; }
+    void analyze(const Eigen::SparseMatrix<double>& A) {
+        const Eigen::SparseMatrix<double>& C = compressed(A);
+        n_ = int(C.rows());
+        nnz_ = int(C.nonZeros());
+        // the compressed columns of the symmetric matrix are its rows
+        rows_.upload(C.outerIndexPtr(), size_t(n_) + 1);
+        columns_.upload(C.innerIndexPtr(), size_t(nnz_));
+        if (info_) cusolverSpDestroyCsrcholInfo(info_);
+        info_ = nullptr;
+        analyzed_ = cusolverSpCreateCsrcholInfo(&info_) == CUSOLVER_STATUS_SUCCESS &&
+                    cusolverSpXcsrcholAnalysis(handle_, n_, nnz_, descr_, device_rows(),
+                                               device_columns(), info_) == CUSOLVER_STATUS_SUCCESS;
+    }
+    bool factorize(const Eigen::SparseMatrix<double>& A) {
+        if (!analyzed_) return false;
+        const double* values = values_.upload(compressed(A).valuePtr(), size_t(nnz_));
+        size_t internal = 0, workspace = 0;
+        if (!values ||
+            cusolverSpDcsrcholBufferInfo(handle_, n_, nnz_, descr_, values, device_rows(),
+                                         device_columns(), info_, &internal,
+                                         &workspace) != CUSOLVER_STATUS_SUCCESS) {
+            return false;
+        }
+        internal_bytes_ = internal;
+        void* buffer = workspace_.reserve(workspace);
+        if (!buffer ||
+            cusolverSpDcsrcholFactor(handle_, n_, nnz_, descr_, values, device_rows(),
+                                     device_columns(), info_, buffer) != CUSOLVER_STATUS_SUCCESS) {
+            return false;
+        }
+        // the row of the first pivot below the tolerance, -1 if there is none
+        int singular = -1;
+        cusolverSpDcsrcholZeroPivot(handle_, info_, 1e-14, &singular);
+        return singular < 0;
+    }
+    void solve(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+        // the right-hand sides go over at once, the columns are solved one
+        // after the other with the same factor
+        const size_t size = size_t(B.size());
+        double* b = rhs_.upload(B.data(), size);
+        double* x = static_cast<double*>(solution_.reserve(size * sizeof(double)));
+        X.resize(B.rows(), B.cols());
+        if (!b || !x) return;
+        for (int k = 0; k < int(B.cols()); ++k) {
+            cusolverSpDcsrcholSolve(handle_, n_, b + size_t(k) * n_, x + size_t(k) * n_, info_,
+                                    workspace_.reserve(0));
+        }
+        cudaMemcpy(X.data(), x, size * sizeof(double), cudaMemcpyDeviceToHost);
+    }
+    size_t memory() const {
+        return internal_bytes_ + workspace_.bytes() + rows_.bytes() + columns_.bytes() +
+               values_.bytes() + rhs_.bytes() + solution_.bytes();
+    }
+
+private:
+    // A itself unless it has free space between its columns
+    const Eigen::SparseMatrix<double>& compressed(const Eigen::SparseMatrix<double>& A) {
+        if (A.isCompressed()) return A;
+        compressed_ = A;
+        compressed_.makeCompressed();
+        return compressed_;
+    }
+    int* device_rows() { return static_cast<int*>(rows_.reserve(0)); }
+    int* device_columns() { return static_cast<int*>(columns_.reserve(0)); }
+
+    cusolverSpHandle_t handle_ = nullptr;
+    cusparseMatDescr_t descr_ = nullptr;
+    csrcholInfo_t info_ = nullptr;
+    bool analyzed_ = false;
+    int n_ = 0, nnz_ = 0;
+    size_t internal_bytes_ = 0;
+    DeviceBuffer rows_, columns_, values_, workspace_, rhs_, solution_;
+    Eigen::SparseMatrix<double> compressed_;
+};
+#endif
+
+#ifdef GP_HAVE_AMGX
+// CG preconditioned by the aggregation AMG of AmgX on the device. The
+// matrix and the vectors are AmgX objects that stay on the device, new
+// values of the same pattern replace the coefficients and set up the
+// hierarchy again
+class AmgxBackend : public SpdBackend {
+public:
+    AmgxBackend() {
+        // once per process, finalized with it
+        static std::once_flag initialized;
+        std::call_once(initialized, []() { AMGX_initialize(); });
+        AMGX_config_create(&config_, configuration().c_str());
+        AMGX_resources_create_simple(&resources_, config_);
+        AMGX_matrix_create(&matrix_, resources_, AMGX_mode_dDDI);
+        AMGX_vector_create(&rhs_, resources_, AMGX_mode_dDDI);
+        AMGX_vector_create(&solution_, resources_, AMGX_mode_dDDI);
+    }
+    ~AmgxBackend() {
+        if (solver_) AMGX_solver_destroy(solver_);
+        AMGX_vector_destroy(solution_);
+        AMGX_vector_destroy(rhs_);
+        AMGX_matrix_destroy(matrix_);
+        AMGX_resources_destroy(resources_);
+        AMGX_config_destroy(config_);
+    }
+    const char* name() const { return "AmgX AMG-CG"; }
+    void set_tolerance(const double tolerance, const int max_iterations) {
+        if (tolerance == tolerance_ && max_iterations == max_iterations_) return;
+        tolerance_ = tolerance;
+        max_iterations_ = max_iterations;
+        // the solver reads its configuration when it is created
+        if (solver_) AMGX_solver_destroy(solver_);
+        solver_ = nullptr;
+        AMGX_config_destroy(config_);
+        AMGX_config_create(&config_, configuration().c_str());
+    }
+    void analyze(const Eigen::SparseMatrix<double>& A) {
+        n_ = int(A.rows());
+        nnz_ = int(A.nonZeros());
+        uploaded_ = false;
+    }
+    bool factorize(const Eigen::SparseMatrix<double>& A) {
+        Eigen::SparseMatrix<double> copy;
+        const Eigen::SparseMatrix<double>* C = &A;
+        if (!A.isCompressed()) {
+            copy = A;
+            copy.makeCompressed();
+            C = &copy;
+        }
+        // the compressed columns of the symmetric matrix are its rows
+        const AMGX_RC rc = uploaded_
+            ? AMGX_matrix_replace_coefficients(matrix_, n_, nnz_, C->valuePtr(), nullptr)
+            : AMGX_matrix_upload_all(matrix_, n_, nnz_, 1, 1, C->outerIndexPtr(),
+                                     C->innerIndexPtr(), C->valuePtr(), nullptr);
+        if (rc != AMGX_RC_OK) return false;
+        uploaded_ = true;
+        if (!solver_ && AMGX_solver_create(&solver_, resources_, AMGX_mode_dDDI, config_) !=
+                        AMGX_RC_OK) {
+            solver_ = nullptr;
+            return false;
+        }
+        return AMGX_solver_setup(solver_, matrix_) == AMGX_RC_OK;
+    }
+    void solve(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+        // the last solution is the initial guess, like the CG backends
+        const bool guess = X.rows() == B.rows() && X.cols() == B.cols();
+        X.resize(B.rows(), B.cols());
+        iterations_ = 0;
+        for (int k = 0; k < int(B.cols()); ++k) {
+            AMGX_vector_upload(rhs_, n_, 1, B.col(k).data());
+            if (guess) AMGX_vector_upload(solution_, n_, 1, X.col(k).data());
+            else AMGX_vector_set_zero(solution_, n_, 1);
+            AMGX_solver_solve(solver_, rhs_, solution_);
+            AMGX_vector_download(solution_, X.col(k).data());
+            int iterations = 0;
+            AMGX_solver_get_iterations_number(solver_, &iterations);
+            iterations_ += iterations;
+            AMGX_SOLVE_STATUS status;
+            AMGX_solver_get_status(solver_, &status);
+            if (status != AMGX_SOLVE_SUCCESS) printf("AmgX did not converge.\n");
+        }
+    }
+    int iterations() const { return iterations_; }
+
+private:
+    // PCG with one V-cycle of aggregation AMG and a DILU smoother, stopped
+    // at the tolerance relative to the residual of the initial guess
+    std::string configuration() const {
+        char text[512];
+        snprintf(text, sizeof(text),
+                 "config_version=2, solver(main)=PCG, main:max_iters=%d, main:tolerance=%g, "
+                 "main:convergence=RELATIVE_INI_CORE, main:norm=L2, main:monitor_residual=1, "
+                 "main:preconditioner(amg)=AMG, amg:algorithm=AGGREGATION, amg:selector=SIZE_2, "
+                 "amg:smoother(smoother)=MULTICOLOR_DILU, smoother:max_iters=1, "
+                 "amg:presweeps=1, amg:postsweeps=1, amg:cycle=V, amg:max_iters=1, "
+                 "amg:max_levels=50",
+                 max_iterations_, tolerance_);
+        return text;
+    }
+
+    AMGX_config_handle config_ = nullptr;
+    AMGX_resources_handle resources_ = nullptr;
+    AMGX_matrix_handle matrix_ = nullptr;
+    AMGX_vector_handle rhs_ = nullptr, solution_ = nullptr;
+    AMGX_solver_handle solver_ = nullptr;
+    double tolerance_ = 1e-8;
+    int max_iterations_ = 1000;
+    int n_ = 0, nnz_ = 0;
+    bool uploaded_ = false;
+    int iterations_ = 0;
+};
+#endif
+
+bool spd_backend_available(const SpdBackendKind kind) {
+    switch (kind) {
+#ifdef GP_HAVE_CHOLMOD
+    case SPD_CHOLMOD_SUPERNODAL: return true;
+#endif
+#ifdef GP_HAVE_PARDISO
+    case SPD_PARDISO: return true;
+#endif
+#ifdef GP_HAVE_CUSOLVER
+    case SPD_CUSOLVER: return true;
+#endif
+#ifdef GP_HAVE_AMGX
+    case SPD_AMGX: return true;
+#endif
+    default: return false;
+    }
+}
+
+std::unique_ptr<SpdBackend> make_spd_backend(const SpdBackendKind kind) {
+    switch (kind) {
+#ifdef GP_HAVE_CHOLMOD
+    case SPD_CHOLMOD_SUPERNODAL: return std::unique_ptr<SpdBackend>(new CholmodBackend());
+#endif
+#ifdef GP_HAVE_PARDISO
+    case SPD_PARDISO: return std::unique_ptr<SpdBackend>(new PardisoBackend());
+#endif
+#ifdef GP_HAVE_CUSOLVER
+    case SPD_CUSOLVER: return std::unique_ptr<SpdBackend>(new CusolverBackend());
+#endif
+#ifdef GP_HAVE_AMGX
+    case SPD_AMGX: return std::unique_ptr<SpdBackend>(new AmgxBackend());
+#endif
+    default: return std::unique_ptr<SpdBackend>();
+    }
+}
+
+}
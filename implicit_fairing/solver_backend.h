@@ -0,0 +1,47 @@
+#ifndef SOLVER_BACKEND_H
+#define SOLVER_BACKEND_H
+
+#include <Eigen/Sparse>
+#include <memory>
+
+namespace mesh_processing {
+
+// Solvers for the SPD systems from external libraries, compiled in when
+// CMake found them (GP_WITH_CHOLMOD, GP_WITH_PARDISO, GP_WITH_CUSOLVER,
+// GP_WITH_AMGX). CHOLMOD and Pardiso factorize supernodally with
+// multi-threaded BLAS, cuSOLVER factorizes on a CUDA GPU and AmgX runs CG
+// preconditioned by algebraic multigrid there; the Eigen LDLT stays the
+// fallback. The GPU backends keep the pattern, the values and the
+// right-hand side buffers on the device across calls, a factorization of
+// new values only uploads those.
+class SpdBackend {
+public:
+    virtual ~SpdBackend() {}
+    virtual const char* name() const = 0;
+    // symbolic analysis, needed once per sparsity pattern
+    virtual void analyze(const Eigen::SparseMatrix<double>& A) = 0;
+    // numerical factorization of a matrix with the analyzed pattern, the
+    // multigrid hierarchy of an iterative backend; false if it failed
+    virtual bool factorize(const Eigen::SparseMatrix<double>& A) = 0;
+    // an iterative backend starts from X if it has the shape of B
+    virtual void solve(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) = 0;
+    // the relative residual and the iteration limit of an iterative backend,
+    // taken by the next factorize()
+    virtual void set_tolerance(const double /*tolerance*/, const int /*max_iterations*/) {}
+    // iterations of the last solve() over all columns, -1 for a direct one
+    virtual int iterations() const { return -1; }
+    // bytes held by the factorization, 0 if the library does not tell
+    virtual size_t memory() const { return 0; }
+};
+
+enum SpdBackendKind : int { SPD_CHOLMOD_SUPERNODAL = 0, SPD_PARDISO = 1, SPD_CUSOLVER = 2,
+                            SPD_AMGX = 3 };
+
+// false if the library was not available at configure time
+bool spd_backend_available(const SpdBackendKind kind);
+// nullptr if the backend is not available
+std::unique_ptr<SpdBackend> make_spd_backend(const SpdBackendKind kind);
+
+}
+
+#endif // SOLVER_BACKEND_H
@@ -0,0 +1,172 @@
+#include "spectral_basis.h"
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+namespace mesh_processing {
+
+static const char eigenbasis_magic[8] = { 'G', 'P', 'E', 'I', 'G', 'E', 'N', '1' };
+
+bool LaplacianEigenbasis::compute(const Eigen::SparseMatrix<double>& L,
+                                  const Eigen::VectorXd& mass, const int k,
+                                  const double tolerance, const JobProgress* progress) {
+    clear();
+    const int n = L.rows();
+    const int nev = std::min(k, n);
+    if (nev <= 0) return true;
+
+    // the shift keeps L + sigma M definite on closed meshes, where the
+    // constants are in the kernel; tiny against the first nonzero
+    // eigenvalue, which is about the largest one over n
+    Eigen::SparseMatrix<double> K = L;
+    double max_ratio = 0.0;
+    for (int j = 0; j < n; ++j) {
+        max_ratio = std::max(max_ratio, L.coeff(j, j) / mass(j));
+    }
+    const double sigma = 1e-10 * max_ratio;
+    for (int j = 0; j < n; ++j) {
+        for (Eigen::SparseMatrix<double>::InnerIterator it(K, j); it; ++it) {
+            if (it.row() == j) it.valueRef() += sigma * mass(j);
+        }
+    }
+    Eigen::SimplicialLDLT< Eigen::SparseMatrix<double> > ldlt(K);
+    if (ldlt.info() != Eigen::Success) return false;
+    if (progress && progress->stopped()) return false;
+    const Eigen::VectorXd sqrt_mass = mass.cwiseSqrt();
+
+    // Lanczos basis, grown on demand up to max_steps columns
+    const int max_steps = std::min(n, 4 * nev + 100);
+    Eigen::MatrixXd V(n, std::min(max_steps, 2 * nev + 20));
+    std::vector<double> alpha, beta;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    Eigen::VectorXd w(n), h;
+    for (int i = 0; i < n; ++i) w(i) = uniform(rng);
+    V.col(0) = w.normalized();
+
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> ritz;
+    int steps = 0, next_check = nev, converged = 0;
+    while (true) {
+        // a truncated basis would filter with the wrong frequencies
+        if (progress && progress->stopped()) return false;
+        const int j = steps++;
+        w = sqrt_mass.cwiseProduct(ldlt.solve(sqrt_mass.cwiseProduct(V.col(j))));
+        alpha.push_back(V.col(j).dot(w));
+        // classical Gram-Schmidt against the whole basis, twice is enough
+        for (int pass = 0; pass < 2; ++pass) {
+            h.noalias() = V.leftCols(steps).transpose() * w;
+            w.noalias() -= V.leftCols(steps) * h;
+        }
+        double b = w.norm();
+        // an invariant subspace, e.g. one per connected component: go on
+        // with a new random direction
+        if (b <= 1e-12 * std::abs(alpha.back()) && steps < max_steps) {
+            for (int i = 0; i < n; ++i) w(i) = uniform(rng);
+            for (int pass = 0; pass < 2; ++pass) {
+                h.noalias() = V.leftCols(steps).transpose() * w;
+                w.noalias() -= V.leftCols(steps) * h;
+            }
+            b = 0.0;
+        }
+        beta.push_back(b);
+
+        if (steps >= next_check || steps == max_steps) {
+            // Ritz values of the tridiagonal matrix, the residual of a pair
+            // is beta times the last component of its vector
+            Eigen::MatrixXd T = Eigen::MatrixXd::Zero(steps, steps);
+            for (int i = 0; i < steps; ++i) {
+                T(i, i) = alpha[i];
+                if (i + 1 < steps) T(i, i + 1) = T(i + 1, i) = beta[i];
+            }
+            ritz.compute(T);
+            converged = 0;
+            for (int i = steps - 1; i >= steps - nev; --i) {
+                const double theta = ritz.eigenvalues()(i);
+                if (std::abs(b * ritz.eigenvectors()(steps - 1, i)) > tolerance * std::abs(theta)) {
+                    break;
+                }
+                ++converged;
+            }
+            if (converged == nev || steps == max_steps) break;
+            next_check = steps + std::max(10, steps / 4);
+        }
+
+        if (steps == V.cols()) {
+            V.conservativeResize(n, std::min(max_steps, steps + steps / 2));
+        }
+        V.col(steps) = b > 0.0 ? Eigen::VectorXd(w / b) : w.normalized();
+    }
+    if (converged < nev) {
+        fprintf(stderr, "eigenbasis: %d of %d eigenpairs converged\n", converged, nev);
+    }
+
+    // the largest Ritz values of the inverse are the smallest eigenvalues
+    eigenvalues_.resize(nev);
+    eigenvectors_.resize(n, nev);
+    for (int i = 0; i < nev; ++i) {
+        const int c = steps - 1 - i;
+        eigenvalues_(i) = 1.0 / ritz.eigenvalues()(c) - sigma;
+        eigenvectors_.col(i).noalias() = V.leftCols(steps) * ritz.eigenvectors().col(c);
+        eigenvectors_.col(i).array() /= sqrt_mass.array();
+    }
+    mass_ = mass;
+    return true;
+}
+
+void LaplacianEigenbasis::low_pass(const Eigen::MatrixXd& X, const int components,
+                                   Eigen::MatrixXd& Y) const {
+    const int m = std::max(0, std::min(components, size()));
+    const Eigen::MatrixXd C = eigenvectors_.leftCols(m).transpose() * (mass_.asDiagonal() * X);
+    Y.noalias() = eigenvectors_.leftCols(m) * C;
+}
+
+bool LaplacianEigenbasis::save(const std::string& filename) const {
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    if (!file) return false;
+    const int32_t sizes[2] = { int32_t(n_rows()), int32_t(size()) };
+    file.write(eigenbasis_magic, sizeof(eigenbasis_magic));
+    file.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    file.write(reinterpret_cast<const char*>(eigenvalues_.data()), size() * sizeof(double));
+    file.write(reinterpret_cast<const char*>(mass_.data()), mass_.size() * sizeof(double));
+    file.write(reinterpret_cast<const char*>(eigenvectors_.data()),
+               eigenvectors_.size() * sizeof(double));
+    return bool(file);
+}
+
+bool LaplacianEigenbasis::load(const std::string& filename, const int n_rows) {
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    char magic[sizeof(eigenbasis_magic)];
+    int32_t sizes[2];
+    if (!file.read(magic, sizeof(magic)) ||
+        memcmp(magic, eigenbasis_magic, sizeof(magic)) != 0 ||
+        !file.read(reinterpret_cast<char*>(sizes), sizeof(sizes)) ||
+        sizes[0] != n_rows || sizes[1] < 0 || sizes[1] > n_rows) {
+        return false;
+    }
+    Eigen::VectorXd eigenvalues(sizes[1]), mass(sizes[0]);
+    Eigen::MatrixXd eigenvectors(sizes[0], sizes[1]);
+    file.read(reinterpret_cast<char*>(eigenvalues.data()), eigenvalues.size() * sizeof(double));
+    file.read(reinterpret_cast<char*>(mass.data()), mass.size() * sizeof(double));
+    file.read(reinterpret_cast<char*>(eigenvectors.data()), eigenvectors.size() * sizeof(double));
+    if (!file) return false;
+    eigenvalues_.swap(eigenvalues);
+    mass_.swap(mass);
+    eigenvectors_.swap(eigenvectors);
+    return true;
+}
+
+size_t LaplacianEigenbasis::memory_usage() const {
+    return size_t(eigenvalues_.size() + eigenvectors_.size() + mass_.size()) * sizeof(double);
+}
+
+void LaplacianEigenbasis::clear() {
+    eigenvalues_.resize(0);
+    eigenvectors_.resize(0, 0);
+    mass_.resize(0);
+}
+
+}
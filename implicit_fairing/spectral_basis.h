@@ -0,0 +1,52 @@
+#ifndef SPECTRAL_BASIS_H
+#define SPECTRAL_BASIS_H
+
+#include <Eigen/Sparse>
+#include <string>
+#include "async_job.h"
+
+namespace mesh_processing {
+
+// First eigenpairs of L phi = lambda M phi for the cotan Laplacian L and
+// the lumped mass M, the low frequencies of a mesh. Computed by Lanczos
+// with full reorthogonalization on the shift-inverted operator
+// M^1/2 (L + sigma M)^-1 M^1/2, which resolves the small eigenvalues in a
+// few steps beyond k. The eigenvectors are M-orthonormal, so the
+// coefficients of a signal X are Phi^T M X and filtering them costs O(nk).
+class LaplacianEigenbasis {
+
+public:
+    // L symmetric positive semi-definite, mass the diagonal of M; false if
+    // the factorization failed or progress stopped it. Pairs that did not
+    // converge within the step limit are kept and reported on stderr
+    bool compute(const Eigen::SparseMatrix<double>& L, const Eigen::VectorXd& mass,
+                 const int k, const double tolerance = 1e-8,
+                 const JobProgress* progress = nullptr);
+    bool empty() const { return eigenvalues_.size() == 0; }
+    int size() const { return int(eigenvalues_.size()); }
+    int n_rows() const { return int(eigenvectors_.rows()); }
+    // ascending
+    const Eigen::VectorXd& eigenvalues() const { return eigenvalues_; }
+    // n x k, column i belongs to eigenvalue i
+    const Eigen::MatrixXd& eigenvectors() const { return eigenvectors_; }
+
+    // X with only the first components eigenvectors, X is n x d
+    void low_pass(const Eigen::MatrixXd& X, const int components, Eigen::MatrixXd& Y) const;
+
+    // raw binary file: the sizes, eigenvalues, mass and eigenvectors in
+    // double precision; load() fails if the file's row count is not n_rows
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename, const int n_rows);
+    size_t memory_usage() const;
+    void clear();
+
+private:
+    Eigen::VectorXd eigenvalues_;
+    Eigen::MatrixXd eigenvectors_;
+    // M of compute(), the inner product of the projections
+    Eigen::VectorXd mass_;
+};
+
+}
+
+#endif // SPECTRAL_BASIS_H
@@ -0,0 +1,319 @@
+#include "streaming_mesh.h"
+#include "soa_geometry.h"
+#include <surface_mesh/IO_format.h>
+#include <surface_mesh/Reorder.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace mesh_processing {
+
+using surface_mesh::Point;
+using surface_mesh::Scalar;
+typedef surface_mesh::Surface_mesh Mesh;
+
+static const char streaming_magic[8] = { 'G', 'P', 'S', 'T', 'R', 'M', '0', '1' };
+
+// file offsets in bytes, every section starts at a multiple of 8
+struct StreamingMesh::Header {
+    char magic[8];
+    uint64_t n_vertices, n_faces, n_clusters;
+    // largest number of owned plus halo vertices of a cluster
+    uint64_t max_local;
+    uint64_t clusters;      // Cluster per cluster
+    uint64_t ring_offsets;  // uint64 per vertex and one more, into ring
+    uint64_t ring;          // uint32 local neighbour indices in circulator order
+    uint64_t halo;          // uint32 vertex indices, the halos one after another
+    uint64_t interior;      // uint8 per vertex, 0 for boundary vertices
+    uint64_t faces;         // 3 uint32 per triangle
+};
+
+// vertices [begin, end) and their halo [halo_begin, halo_end); local index
+// i < end - begin is vertex begin + i, the others are halo entries
+struct StreamingMesh::Cluster {
+    uint64_t begin, end, halo_begin, halo_end;
+};
+
+static uint64_t aligned(const uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+// appends bytes at the given offset of file, padding up to it
+static bool write_section(std::FILE* file, uint64_t& offset, const void* data,
+                          const size_t bytes, uint64_t& section) {
+    static const char zeros[8] = { 0 };
+    section = aligned(offset);
+    if (std::fwrite(zeros, 1, section - offset, file) != section - offset) return false;
+    offset = section + bytes;
+    return bytes == 0 || std::fwrite(data, 1, bytes, file) == bytes;
+}
+
+bool StreamingMesh::write(const Mesh& mesh, const std::string& path, const int cluster_size) {
+    if (!mesh.is_triangle_mesh() || cluster_size <= 0) return false;
+
+    // Hilbert order: the clusters are compact and their halos small
+    Mesh sorted;
+    sorted.assign(mesh);
+    surface_mesh::reorder(sorted, surface_mesh::REORDER_HILBERT);
+    const int n = sorted.n_vertices();
+    const int n_clusters = (n + cluster_size - 1) / cluster_size;
+
+    std::vector<Cluster> clusters(n_clusters);
+    std::vector<uint64_t> ring_offsets(n + 1, 0);
+    std::vector<uint32_t> ring, halo;
+    std::vector<uint8_t> interior(n, 0);
+    uint64_t max_local = 0;
+    for (int c = 0; c < n_clusters; ++c) {
+        Cluster& cluster = clusters[c];
+        cluster.begin = uint64_t(c) * cluster_size;
+        cluster.end = std::min<uint64_t>(cluster.begin + cluster_size, n);
+        cluster.halo_begin = halo.size();
+        const uint64_t owned = cluster.end - cluster.begin;
+        std::unordered_map<int, uint32_t> local;
+        for (uint64_t i = cluster.begin; i < cluster.end; ++i) {
+            const Mesh::Vertex v(i);
+            interior[i] = !sorted.is_boundary(v);
+            for (auto h: sorted.halfedges(v)) {
+                const uint64_t nb = sorted.to_vertex(h).idx();
+                if (nb >= cluster.begin && nb < cluster.end) {
+                    ring.push_back(uint32_t(nb - cluster.begin));
+                    continue;
+                }
+                auto it = local.find(int(nb));
+                if (it == local.end()) {
+                    it = local.insert(std::make_pair(int(nb), uint32_t(owned + local.size()))).first;
+                    halo.push_back(uint32_t(nb));
+                }
+                ring.push_back(it->second);
+            }
+            ring_offsets[i + 1] = ring.size();
+        }
+        cluster.halo_end = halo.size();
+        max_local = std::max<uint64_t>(max_local, owned + local.size());
+    }
+    std::vector<uint32_t> faces;
+    faces.reserve(3 * size_t(sorted.n_faces()));
+    for (auto f: sorted.faces()) {
+        for (auto v: sorted.vertices(f)) faces.push_back(v.idx());
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, streaming_magic, sizeof(header.magic));
+    header.n_vertices = n;
+    header.n_faces = sorted.n_faces();
+    header.n_clusters = n_clusters;
+    header.max_local = max_local;
+    uint64_t offset = sizeof(Header);
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              write_section(file, offset, clusters.data(), clusters.size() * sizeof(Cluster),
+                            header.clusters) &&
+              write_section(file, offset, ring_offsets.data(),
+                            ring_offsets.size() * sizeof(uint64_t), header.ring_offsets) &&
+              write_section(file, offset, ring.data(), ring.size() * sizeof(uint32_t),
+                            header.ring) &&
+              write_section(file, offset, halo.data(), halo.size() * sizeof(uint32_t),
+                            header.halo) &&
+              write_section(file, offset, interior.data(), interior.size(), header.interior) &&
+              write_section(file, offset, faces.data(), faces.size() * sizeof(uint32_t),
+                            header.faces);
+    // the header again, now with the section offsets
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0 &&
+         std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) return false;
+
+    // positions, in the new vertex order
+    file = std::fopen((path + ".xyz").c_str(), "wb");
+    if (!file) return false;
+    const surface_mesh::Property_vector<Point>& points = sorted.get_vertex_property<Point>("v:point").vector();
+    ok = std::fwrite(points.data(), sizeof(Point), n, file) == size_t(n);
+    return std::fclose(file) == 0 && ok;
+}
+
+bool StreamingMesh::open(const std::string& path) {
+    close();
+    if (!connectivity_.open(path) || connectivity_.size() < sizeof(Header)) return false;
+    const Header* header = reinterpret_cast<const Header*>(connectivity_.begin());
+    if (memcmp(header->magic, streaming_magic, sizeof(streaming_magic)) != 0 ||
+        header->faces + 3 * header->n_faces * sizeof(uint32_t) > connectivity_.size() ||
+        !positions_.open(path + ".xyz") ||
+        positions_.size() != header->n_vertices * sizeof(Point)) {
+        close();
+        return false;
+    }
+    path_ = path;
+    header_ = header;
+    return true;
+}
+
+void StreamingMesh::close() {
+    connectivity_.close();
+    positions_.close();
+    header_ = nullptr;
+}
+
+int StreamingMesh::n_vertices() const { return header_ ? int(header_->n_vertices) : 0; }
+int StreamingMesh::n_faces() const { return header_ ? int(header_->n_faces) : 0; }
+int StreamingMesh::n_clusters() const { return header_ ? int(header_->n_clusters) : 0; }
+
+const char* StreamingMesh::section(const uint64_t offset) const {
+    return connectivity_.begin() + offset;
+}
+
+const StreamingMesh::Cluster* StreamingMesh::clusters() const {
+    return reinterpret_cast<const Cluster*>(section(header_->clusters));
+}
+
+size_t StreamingMesh::cluster_memory() const {
+    if (!header_) return 0;
+    // gathered positions, new positions and the weights of one vertex
+    uint64_t owned = 0;
+    for (uint64_t c = 0; c < header_->n_clusters; ++c) {
+        owned = std::max(owned, clusters()[c].end - clusters()[c].begin);
+    }
+    return size_t(header_->max_local + owned) * sizeof(Point);
+}
+
+// cot of the corner at c opposite to the edge (a, b), as in
+// SoAGeometry::edge_cotan_weights with the default clamping
+static inline float corner_cotan(const Point& a, const Point& b, const Point& c) {
+    const float d0x = a[0] - c[0], d0y = a[1] - c[1], d0z = a[2] - c[2];
+    const float d1x = b[0] - c[0], d1y = b[1] - c[1], d1z = b[2] - c[2];
+    const float cx = d0y*d1z - d0z*d1y, cy = d0z*d1x - d0x*d1z, cz = d0x*d1y - d0y*d1x;
+    float s = d0x*d1x; s += d0y*d1y; s += d0z*d1z;
+    float n = cx*cx; n += cy*cy; n += cz*cz;
+    return clamp_cotan(s / std::sqrt(n), DEFAULT_MAX_COTAN);
+}
+
+bool StreamingMesh::smooth_step(const bool cotan) {
+    const std::string tmp = path_ + ".xyz.tmp";
+    std::FILE* out = std::fopen(tmp.c_str(), "wb");
+    if (!out) return false;
+
+    const Point* in = reinterpret_cast<const Point*>(positions_.begin());
+    const uint64_t* ring_offsets = reinterpret_cast<const uint64_t*>(section(header_->ring_offsets));
+    const uint32_t* ring = reinterpret_cast<const uint32_t*>(section(header_->ring));
+    const uint32_t* halo = reinterpret_cast<const uint32_t*>(section(header_->halo));
+    const uint8_t* interior = reinterpret_cast<const uint8_t*>(section(header_->interior));
+    const Scalar damping = 0.5f;
+
+    std::vector<Point> local, result;
+    local.reserve(header_->max_local);
+    bool ok = true;
+    for (uint64_t c = 0; c < header_->n_clusters && ok; ++c) {
+        // gather the cluster and its halo
+        const Cluster& cluster = clusters()[c];
+        const int owned = int(cluster.end - cluster.begin);
+        const int n_halo = int(cluster.halo_end - cluster.halo_begin);
+        local.resize(owned + n_halo);
+        std::copy(in + cluster.begin, in + cluster.end, local.begin());
+        for (int k = 0; k < n_halo; ++k) local[owned + k] = in[halo[cluster.halo_begin + k]];
+        result.resize(owned);
+
+        // the step of OneRingAdjacency::smooth_step; the one-ring of an
+        // interior vertex is a closed fan, so the corners opposite to the
+        // edge to neighbour k are the neighbours k - 1 and k + 1
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < owned; ++i) {
+            const uint64_t v = cluster.begin + i;
+            const Point& p = local[i];
+            Point laplace(0.0);
+            if (interior[v]) {
+                const uint32_t* nb = ring + ring_offsets[v];
+                const int m = int(ring_offsets[v + 1] - ring_offsets[v]);
+                if (cotan) {
+                    Scalar ww = 0;
+                    for (int k = 0; k < m; ++k) {
+                        const Point& q = local[nb[k]];
+                        Scalar w = 0.0f;
+                        w += corner_cotan(p, q, local[nb[(k + m - 1) % m]]);
+                        w += corner_cotan(p, q, local[nb[(k + 1) % m]]);
+                        ww += w;
+                        laplace += w * (q - p);
+                    }
+                    laplace /= ww;
+                } else {
+                    for (int k = 0; k < m; ++k) laplace += (local[nb[k]] - p);
+                    laplace /= Scalar(m);
+                }
+                laplace *= damping;
+            }
+            result[i] = p + laplace;
+        }
+        ok = std::fwrite(result.data(), sizeof(Point), owned, out) == size_t(owned);
+    }
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+    // the new positions replace the old ones
+    const std::string xyz = path_ + ".xyz";
+    positions_.close();
+#if defined(_WIN32)
+    std::remove(xyz.c_str());
+#endif
+    ok = std::rename(tmp.c_str(), xyz.c_str()) == 0;
+    return positions_.open(xyz) && ok;
+}
+
+bool StreamingMesh::smooth(const unsigned int iterations, const bool cotan) {
+    if (!header_) return false;
+    for (unsigned int iter = 0; iter < iterations; ++iter) {
+        if (!smooth_step(cotan)) return false;
+    }
+    return true;
+}
+
+bool StreamingMesh::write_off(const std::string& filename) const {
+    if (!header_) return false;
+    std::FILE* out = std::fopen(filename.c_str(), "wb");
+    if (!out) return false;
+    setvbuf(out, nullptr, _IONBF, 0);
+
+    // the same formatting as surface_mesh's write_off
+    using surface_mesh::format_float;
+    using surface_mesh::format_uint;
+    char header[64];
+    const int header_size = snprintf(header, sizeof(header), "OFF\n%d %d 0\n", n_vertices(), n_faces());
+    bool ok = fwrite(header, 1, header_size, out) == size_t(header_size);
+    const Point* points = reinterpret_cast<const Point*>(positions_.begin());
+    ok = ok && surface_mesh::write_chunks(out, n_vertices(), 16384,
+                                          [&](size_t begin, size_t end, std::string& text) {
+        char line[3 * (surface_mesh::max_float_chars + 1)];
+        for (size_t i = begin; i < end; ++i) {
+            char* p = format_float(line, points[i][0]);
+            *p++ = ' ';
+            p = format_float(p, points[i][1]);
+            *p++ = ' ';
+            p = format_float(p, points[i][2]);
+            *p++ = '\n';
+            text.append(line, p - line);
+        }
+    });
+    const uint32_t* faces = reinterpret_cast<const uint32_t*>(section(header_->faces));
+    ok = ok && surface_mesh::write_chunks(out, n_faces(), 16384,
+                                          [&](size_t begin, size_t end, std::string& text) {
+        char line[2 + 3 * (surface_mesh::max_int_chars + 1)];
+        for (size_t f = begin; f < end; ++f) {
+            char* p = line;
+            *p++ = '3';
+            for (int k = 0; k < 3; ++k) {
+                *p++ = ' ';
+                p = format_uint(p, faces[3 * f + k]);
+            }
+            *p++ = '\n';
+            text.append(line, p - line);
+        }
+    });
+    return std::fclose(out) == 0 && ok;
+}
+
+}
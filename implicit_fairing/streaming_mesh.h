@@ -0,0 +1,67 @@
+#ifndef STREAMING_MESH_H
+#define STREAMING_MESH_H
+
+#include <surface_mesh/Surface_mesh.h>
+#include <surface_mesh/Mapped_file.h>
+#include <cstdint>
+#include <string>
+
+namespace mesh_processing {
+
+// Out-of-core copy of a triangle mesh for the explicit smoothing of meshes
+// that do not fit in memory as a Surface_mesh. write() renumbers the
+// vertices along a Hilbert curve and cuts them into clusters of
+// consecutive vertices; every cluster stores the one-rings of its vertices
+// against a local numbering that lists the halo, the neighbours owned by
+// other clusters, after its own vertices. The connectivity lives in <path>
+// and the positions in <path>.xyz, both memory-mapped; a smoothing
+// iteration gathers one cluster and its halo at a time and streams the new
+// positions to a second file, so the working set is bounded by the cluster
+// size instead of the mesh size.
+class StreamingMesh {
+
+public:
+    StreamingMesh() : header_(nullptr) {}
+
+    // the conversion itself runs in core, once per mesh; false if mesh is
+    // not a triangle mesh or a file cannot be written
+    static bool write(const surface_mesh::Surface_mesh& mesh, const std::string& path,
+                      const int cluster_size = 1 << 16);
+
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return header_ != nullptr; }
+
+    int n_vertices() const;
+    int n_faces() const;
+    int n_clusters() const;
+
+    // iterations of MeshProcessing::uniform_smooth or, with cotan, of
+    // MeshProcessing::smooth with the weights updated every iteration;
+    // false on an I/O error, the positions are then unchanged
+    bool smooth(const unsigned int iterations, const bool cotan);
+
+    // positions and faces as OFF, streamed from the mapped files
+    bool write_off(const std::string& filename) const;
+
+    // bytes allocated while one cluster is smoothed, the largest cluster
+    size_t cluster_memory() const;
+
+    struct Header;
+    struct Cluster;
+
+private:
+    const Cluster* clusters() const;
+    const char* section(const uint64_t offset) const;
+    // one iteration from the mapped positions into <path>.xyz.tmp
+    bool smooth_step(const bool cotan);
+
+    std::string path_;
+    surface_mesh::Mapped_file connectivity_;
+    surface_mesh::Mapped_file positions_;
+    const Header* header_;
+};
+
+}
+
+#endif // STREAMING_MESH_H
@@ -0,0 +1,237 @@
+#include "symbolic_analysis.h"
+#include <cstring>
+#include <fstream>
+#ifdef GP_HAVE_METIS
+#include <Eigen/MetisSupport>
+#endif
+
+namespace mesh_processing {
+
+static const char symbolic_magic[8] = { 'G', 'P', 'S', 'Y', 'M', 'B', 'L', '2' };
+
+template <typename T>
+uint64_t sparsity_key(const Eigen::SparseMatrix<T>& A) {
+    uint64_t h = 14695981039346656037ull;
+    const auto mix = [&h](const uint64_t word) { h = (h ^ word) * 1099511628211ull; };
+    mix(uint64_t(A.rows()));
+    for (int k = 0; k < A.outerSize(); ++k) {
+        // the column length, also for uncompressed matrices
+        int count = 0;
+        for (typename Eigen::SparseMatrix<T>::InnerIterator it(A, k); it; ++it) {
+            mix(uint64_t(it.index()));
+            ++count;
+        }
+        mix(uint64_t(count) << 32);
+    }
+    return h;
+}
+
+template <typename T>
+void PersistentLDLT<T>::export_analysis(SymbolicAnalysis& analysis) const {
+    const int n = int(this->m_parent.size());
+    analysis.n = n;
+    analysis.permutation.assign(this->m_P.indices().data(),
+                                this->m_P.indices().data() + this->m_P.size());
+    analysis.parent.assign(this->m_parent.data(), this->m_parent.data() + n);
+    analysis.column_counts.assign(this->m_nonZerosPerCol.data(),
+                                  this->m_nonZerosPerCol.data() + n);
+}
+
+template <typename T>
+void PersistentLDLT<T>::import_analysis(const SymbolicAnalysis& analysis) {
+    const int n = analysis.n;
+    if (analysis.permutation.empty()) {
+        this->m_P.resize(0);
+        this->m_Pinv.resize(0);
+    } else {
+        this->m_P.resize(n);
+        for (int i = 0; i < n; ++i) this->m_P.indices()[i] = analysis.permutation[i];
+        this->m_Pinv = this->m_P.inverse();
+    }
+    this->m_parent = Eigen::Map<const Eigen::VectorXi>(analysis.parent.data(), n);
+    this->m_nonZerosPerCol = Eigen::Map<const Eigen::VectorXi>(analysis.column_counts.data(), n);
+
+    // the storage of L as analyzePattern_preordered() lays it out for LDLT
+    this->m_matrix.resize(n, n);
+    auto* Lp = this->m_matrix.outerIndexPtr();
+    Lp[0] = 0;
+    for (int k = 0; k < n; ++k) Lp[k + 1] = Lp[k] + analysis.column_counts[k];
+    this->m_matrix.resizeNonZeros(Lp[n]);
+
+    this->m_isInitialized = true;
+    this->m_info = Eigen::Success;
+    this->m_analysisIsOk = true;
+    this->m_factorizationIsOk = false;
+}
+
+template <typename T>
+void PersistentLDLT<T>::analyze_ordered(const Eigen::SparseMatrix<T>& A,
+                                        const std::vector<int>& order) {
+    const int n = int(A.rows());
+    this->m_Pinv.resize(n);
+    for (int k = 0; k < n; ++k) this->m_Pinv.indices()[k] = order[k];
+    this->m_P = this->m_Pinv.inverse();
+
+    // the steps of analyzePattern() after its AMD call
+    Eigen::SparseMatrix<T> ap(n, n);
+    ap.template selfadjointView<Eigen::Upper>() =
+            A.template selfadjointView<Eigen::Lower>().twistedBy(this->m_P);
+    this->analyzePattern_preordered(ap, true);
+}
+
+template <typename T>
+int64_t PersistentLDLT<T>::factor_nonzeros() const {
+    int64_t nonzeros = 0;
+    for (int k = 0; k < int(this->m_nonZerosPerCol.size()); ++k) {
+        nonzeros += this->m_nonZerosPerCol[k];
+    }
+    return nonzeros;
+}
+
+template <typename T>
+void colamd_order(const Eigen::SparseMatrix<T>& A, std::vector<int>& order) {
+    Eigen::SparseMatrix<T> full;
+    full = A.template selfadjointView<Eigen::Lower>();
+    full.makeCompressed();
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> perm;
+    Eigen::COLAMDOrdering<int>()(full, perm);
+    // perm maps a column to its position
+    order.resize(full.cols());
+    for (int i = 0; i < int(full.cols()); ++i) order[perm.indices()[i]] = i;
+}
+
+template <typename T>
+bool metis_order(const Eigen::SparseMatrix<T>& A, std::vector<int>& order) {
+#ifdef GP_HAVE_METIS
+    Eigen::SparseMatrix<T> full;
+    full = A.template selfadjointView<Eigen::Lower>();
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> perm;
+    Eigen::MetisOrdering<int>()(full, perm);
+    order.assign(perm.indices().data(), perm.indices().data() + perm.size());
+    return true;
+#else
+    (void)A;
+    order.clear();
+    return false;
+#endif
+}
+
+bool metis_available() {
+#ifdef GP_HAVE_METIS
+    return true;
+#else
+    return false;
+#endif
+}
+
+template uint64_t sparsity_key<double>(const Eigen::SparseMatrix<double>&);
+template uint64_t sparsity_key<float>(const Eigen::SparseMatrix<float>&);
+template class PersistentLDLT<double>;
+template class PersistentLDLT<float>;
+template void colamd_order<double>(const Eigen::SparseMatrix<double>&, std::vector<int>&);
+template void colamd_order<float>(const Eigen::SparseMatrix<float>&, std::vector<int>&);
+template bool metis_order<double>(const Eigen::SparseMatrix<double>&, std::vector<int>&);
+template bool metis_order<float>(const Eigen::SparseMatrix<float>&, std::vector<int>&);
+
+const SymbolicAnalysis* SymbolicCache::find(const uint64_t key, const int n,
+                                            const int ordering) const {
+    for (const SymbolicAnalysis& analysis : analyses_) {
+        if (analysis.pattern_key == key && analysis.n == n && analysis.ordering == ordering) {
+            return &analysis;
+        }
+    }
+    return nullptr;
+}
+
+void SymbolicCache::add(SymbolicAnalysis&& analysis) {
+    analyses_.push_back(std::move(analysis));
+    modified_ = true;
+}
+
+bool SymbolicCache::save(const std::string& filename) {
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    if (!file) return false;
+    const int32_t count = int32_t(analyses_.size());
+    file.write(symbolic_magic, sizeof(symbolic_magic));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const SymbolicAnalysis& analysis : analyses_) {
+        const int32_t sizes[4] = { int32_t(analysis.n), int32_t(analysis.permutation.size()),
+                                   int32_t(analysis.ordering), int32_t(analysis.chosen) };
+        file.write(reinterpret_cast<const char*>(&analysis.pattern_key), sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+        file.write(reinterpret_cast<const char*>(analysis.permutation.data()),
+                   analysis.permutation.size() * sizeof(int));
+        file.write(reinterpret_cast<const char*>(analysis.parent.data()), analysis.n * sizeof(int));
+        file.write(reinterpret_cast<const char*>(analysis.column_counts.data()),
+                   analysis.n * sizeof(int));
+    }
+    if (!file) return false;
+    modified_ = false;
+    return true;
+}
+
+// a damaged file must not reach the factorization, which trusts the tree
+static bool valid(const SymbolicAnalysis& analysis) {
+    const int n = analysis.n;
+    std::vector<char> seen(analysis.permutation.size(), 0);
+    for (const int p : analysis.permutation) {
+        if (p < 0 || p >= n || seen[p]) return false;
+        seen[p] = 1;
+    }
+    for (int k = 0; k < n; ++k) {
+        if (analysis.parent[k] != -1 && (analysis.parent[k] <= k || analysis.parent[k] >= n)) {
+            return false;
+        }
+        if (analysis.column_counts[k] < 0 || analysis.column_counts[k] >= n - k) return false;
+    }
+    return true;
+}
+
+bool SymbolicCache::load(const std::string& filename) {
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    char magic[sizeof(symbolic_magic)];
+    int32_t count;
+    if (!file.read(magic, sizeof(magic)) ||
+        memcmp(magic, symbolic_magic, sizeof(magic)) != 0 ||
+        !file.read(reinterpret_cast<char*>(&count), sizeof(count)) || count < 0) {
+        return false;
+    }
+    std::vector<SymbolicAnalysis> analyses(count);
+    for (SymbolicAnalysis& analysis : analyses) {
+        int32_t sizes[4];
+        if (!file.read(reinterpret_cast<char*>(&analysis.pattern_key), sizeof(uint64_t)) ||
+            !file.read(reinterpret_cast<char*>(sizes), sizeof(sizes)) || sizes[0] < 0 ||
+            (sizes[1] != 0 && sizes[1] != sizes[0])) {
+            return false;
+        }
+        analysis.n = sizes[0];
+        analysis.ordering = sizes[2];
+        analysis.chosen = sizes[3];
+        analysis.permutation.resize(sizes[1]);
+        analysis.parent.resize(sizes[0]);
+        analysis.column_counts.resize(sizes[0]);
+        file.read(reinterpret_cast<char*>(analysis.permutation.data()), sizes[1] * sizeof(int));
+        file.read(reinterpret_cast<char*>(analysis.parent.data()), sizes[0] * sizeof(int));
+        file.read(reinterpret_cast<char*>(analysis.column_counts.data()), sizes[0] * sizeof(int));
+        if (!file || !valid(analysis)) return false;
+    }
+    analyses_.swap(analyses);
+    modified_ = false;
+    return true;
+}
+
+size_t SymbolicCache::memory_usage() const {
+    size_t bytes = 0;
+    for (const SymbolicAnalysis& analysis : analyses_) {
+        bytes += (analysis.permutation.capacity() + analysis.parent.capacity() +
+                  analysis.column_counts.capacity()) * sizeof(int);
+    }
+    return bytes;
+}
+
+void SymbolicCache::clear() {
+    analyses_.clear();
+    modified_ = false;
+}
+
+}
@@ -0,0 +1,82 @@
+#ifndef SYMBOLIC_ANALYSIS_H
+#define SYMBOLIC_ANALYSIS_H
+
+#include <Eigen/Sparse>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mesh_processing {
+
+// What Eigen::SimplicialLDLT::analyzePattern() computes from the sparsity
+// pattern alone: the fill-reducing ordering, the elimination tree and the
+// column counts of L. Kept by the hash of the pattern and the ordering it
+// was asked for, the analysis of a double matrix serves its float copy as
+// well.
+struct SymbolicAnalysis {
+    uint64_t pattern_key = 0;
+    int n = 0;
+    // the MeshProcessing::FILL_ORDERING asked for and the one it resolved
+    // to, which differ for ORDERING_AUTO
+    int ordering = 0;
+    int chosen = 0;
+    std::vector<int> permutation;  // fill-reducing ordering, empty for none
+    std::vector<int> parent;
+    std::vector<int> column_counts;
+};
+
+// FNV-1a over the size, the column starts and the row indices of A
+template <typename T>
+uint64_t sparsity_key(const Eigen::SparseMatrix<T>& A);
+
+// SimplicialLDLT whose analysis can be taken out and put back, e.g. from
+// a file of an earlier run; usable wherever a SimplicialLDLT is
+template <typename T>
+class PersistentLDLT : public Eigen::SimplicialLDLT< Eigen::SparseMatrix<T> > {
+public:
+    // needs analyzePattern() or import_analysis() first
+    void export_analysis(SymbolicAnalysis& analysis) const;
+    // as analyzePattern() of a matrix with the pattern of analysis
+    void import_analysis(const SymbolicAnalysis& analysis);
+    // analyzePattern() with the given ordering instead of AMD: order[k] is
+    // the row of A (lower triangle) eliminated k-th
+    void analyze_ordered(const Eigen::SparseMatrix<T>& A, const std::vector<int>& order);
+    // entries of L below the diagonal of the analysis
+    int64_t factor_nonzeros() const;
+};
+
+// the row orders of the other fill-reducing orderings for analyze_ordered(),
+// from the lower triangle of A. COLAMD orders the columns of the full
+// symmetric matrix, METIS is nested dissection and only there if CMake
+// found it; metis_order() is false without it
+template <typename T>
+void colamd_order(const Eigen::SparseMatrix<T>& A, std::vector<int>& order);
+template <typename T>
+bool metis_order(const Eigen::SparseMatrix<T>& A, std::vector<int>& order);
+bool metis_available();
+
+// the analyses of the patterns a mesh solved with, saved next to the mesh
+// so that a later run with the same connectivity skips analyzePattern()
+class SymbolicCache {
+public:
+    // the analysis of the pattern key of an n x n matrix with ordering,
+    // nullptr if none
+    const SymbolicAnalysis* find(const uint64_t key, const int n, const int ordering) const;
+    void add(SymbolicAnalysis&& analysis);
+    bool empty() const { return analyses_.empty(); }
+    // true if add() was called since the last save() or load()
+    bool modified() const { return modified_; }
+    // raw binary file of all analyses; load() replaces them
+    bool save(const std::string& filename);
+    bool load(const std::string& filename);
+    size_t memory_usage() const;
+    void clear();
+
+private:
+    std::vector<SymbolicAnalysis> analyses_;
+    bool modified_ = false;
+};
+
+}
+
+#endif // SYMBOLIC_ANALYSIS_H
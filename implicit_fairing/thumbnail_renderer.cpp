@@ -0,0 +1,250 @@
+#include "thumbnail_renderer.h"
+#include "camera.h"
+#include "mesh_shaders.h"
+#include <surface_mesh/Trace.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__GNUC__)
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wunused-function"
+#  pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#if defined(__GNUC__)
+#  pragma GCC diagnostic pop
+#endif
+
+namespace mesh_processing {
+
+bool ThumbnailRenderer::start(std::string& error) {
+    thread_ = std::thread(&ThumbnailRenderer::run, this);
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return started_; });
+    if (ready_) return true;
+    error = error_;
+    lock.unlock();
+    thread_.join();
+    return false;
+}
+
+void ThumbnailRenderer::render(MeshProcessing& mesh, const std::string& path) {
+    if (!ready_ || mesh.get_number_of_face() == 0) return;
+    SURFACE_MESH_TRACE_ZONE("pack thumbnail");
+    Job job;
+    job.path = path;
+    pack_positions(mesh.get_points(), job.positions, job.box_min, job.box_extent);
+    pack_normals(mesh.get_normals(), job.normals);
+    float min_value, max_value;
+    const ConstRowXfMap values = mesh.get_scalars(MeshProcessing::SCALAR_CURVATURE,
+                                                  min_value, max_value);
+    pack_scalars(values, min_value, max_value, job.scalars);
+    job.scalar_range = Eigen::Vector2f(min_value, max_value);
+    job.indices = *mesh.get_indices();
+    const surface_mesh::Point center = mesh.get_mesh_center();
+    job.center = Eigen::Vector3f(center.x, center.y, center.z);
+    job.radius = mesh.get_dist_max();
+    if (!(job.radius > 0.0f)) job.radius = 1.0f;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return queue_.size() < QUEUED || closed_; });
+    if (closed_) return;
+    queue_.push_back(std::move(job));
+    changed_.notify_all();
+}
+
+int ThumbnailRenderer::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    return failed_;
+}
+
+void ThumbnailRenderer::run() {
+    std::string error;
+    const bool ok = context_.create(error) && init_gl();
+    if (!ok && error.empty()) error = "the thumbnail shader or framebuffer is not supported";
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        started_ = true;
+        ready_ = ok;
+        error_ = error;
+    }
+    changed_.notify_all();
+    if (!ok) {
+        free_gl();
+        context_.release();
+        return;
+    }
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (queue_.empty()) {
+                // nothing to draw meanwhile, the pictures in flight are
+                // written rather than kept waiting for the next mesh
+                lock.unlock();
+                for (int i = 0; i < READBACKS; ++i) write(readbacks_[(next_ + i) % READBACKS]);
+                lock.lock();
+            }
+            changed_.wait(lock, [&] { return !queue_.empty() || closed_; });
+            if (queue_.empty()) break;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        changed_.notify_all();
+        draw(job);
+    }
+    for (int i = 0; i < READBACKS; ++i) write(readbacks_[(next_ + i) % READBACKS]);
+    free_gl();
+    context_.release();
+}
+
+bool ThumbnailRenderer::init_gl() {
+    if (!shader_.init("thumbnail_shader", MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER,
+                      MESH_GEOMETRY_SHADER)) {
+        return false;
+    }
+    // 4x multisampling, the wireframe is off but the silhouettes of a
+    // small picture need it
+    glGenFramebuffers(1, &framebuffer_);
+    glGenRenderbuffers(1, &color_);
+    glGenRenderbuffers(1, &depth_);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_RGBA8, size_, size_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT24, size_, size_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glGenFramebuffers(1, &resolved_);
+    glGenRenderbuffers(1, &resolvedColor_);
+    glBindRenderbuffer(GL_RENDERBUFFER, resolvedColor_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size_, size_);
+    glBindFramebuffer(GL_FRAMEBUFFER, resolved_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolvedColor_);
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    const size_t bytes = size_t(size_) * size_ * 4;
+    for (Readback& slot : readbacks_) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    pixels_.resize(bytes);
+    return complete;
+}
+
+void ThumbnailRenderer::free_gl() {
+    for (Readback& slot : readbacks_) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.buffer != 0) glDeleteBuffers(1, &slot.buffer);
+        slot = Readback();
+    }
+    if (framebuffer_ != 0) {
+        glDeleteFramebuffers(1, &framebuffer_);
+        glDeleteRenderbuffers(1, &color_);
+        glDeleteRenderbuffers(1, &depth_);
+        glDeleteFramebuffers(1, &resolved_);
+        glDeleteRenderbuffers(1, &resolvedColor_);
+        framebuffer_ = color_ = depth_ = resolved_ = resolvedColor_ = 0;
+    }
+    shader_.free();
+}
+
+void ThumbnailRenderer::draw(const Job& job) {
+    SURFACE_MESH_TRACE_ZONE("draw thumbnail");
+    // the slot of the picture before last is needed again
+    Readback& slot = readbacks_[next_];
+    next_ = (next_ + 1) % READBACKS;
+    write(slot);
+
+    // the viewer's camera after refresh_trackball_center()
+    const Eigen::Vector2i size(size_, size_);
+    CameraParameters camera;
+    center_camera(camera, size, job.center, job.radius);
+    Eigen::Matrix4f model, view, proj;
+    camera_matrices(camera, size, model, view, proj);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, size_, size_);
+    // the background of the viewer
+    glClearColor(0.3f, 0.3f, 0.32f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+
+    shader_.bind();
+    shader_.uploadAttrib("indices", job.indices);
+    shader_.uploadAttrib("position", job.positions);
+    shader_.uploadAttrib("normal", job.normals);
+    shader_.uploadAttrib("scalar", job.scalars);
+    shader_.setUniform("box_min", job.box_min);
+    shader_.setUniform("box_extent", job.box_extent);
+    shader_.setUniform("MV", Eigen::Matrix4f(view * model));
+    shader_.setUniform("P", proj);
+    shader_.setUniform("color_mode", 1);
+    shader_.setUniform("scalar_range", job.scalar_range);
+    shader_.setUniform("scalar_decode",
+        Eigen::Vector2f(job.scalar_range[0], job.scalar_range[1] - job.scalar_range[0]));
+    shader_.setUniform("intensity", Eigen::Vector3f(1.0f, 1.5f, 1.0f));
+    shader_.setUniform("wire_intensity", Eigen::Vector3f(0.5f, 0.7f, 0.5f));
+    shader_.setUniform("wireframe", 0);
+    shader_.setUniform("splat", 0);
+    shader_.drawIndexed(GL_TRIANGLES, 0, uint32_t(job.indices.cols()));
+
+    // resolved and read into the slot's buffer, which returns at once; the
+    // fence tells when the pixels are there
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolved_);
+    glBlitFramebuffer(0, 0, size_, size_, 0, 0, size_, size_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolved_);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, size_, size_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.path = job.path;
+    glFlush();
+}
+
+void ThumbnailRenderer::write(Readback& slot) {
+    if (!slot.fence) return;
+    SURFACE_MESH_TRACE_ZONE("write thumbnail");
+    glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(60) * 1000000000);
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    const size_t row = size_t(size_) * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const unsigned char* pixels = (const unsigned char*) glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, row * size_, GL_MAP_READ_BIT);
+    bool ok = pixels != nullptr;
+    if (ok) {
+        // GL's rows go bottom up, those of PNG top down
+        for (int y = 0; y < size_; ++y) {
+            std::memcpy(pixels_.data() + row * y, pixels + row * (size_ - 1 - y), row);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ok = ok && stbi_write_png(slot.path.c_str(), size_, size_, 4, pixels_.data(), int(row)) != 0;
+    if (!ok) {
+        std::cerr << slot.path << ": cannot write" << std::endl;
+        ++failed_;
+    }
+    slot.path.clear();
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef THUMBNAIL_RENDERER_H
+#define THUMBNAIL_RENDERER_H
+
+#include <nanogui/glutil.h>
+#include <Eigen/Core>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "batch.h"
+#include "offscreen_context.h"
+#include "vertex_packing.h"
+
+namespace mesh_processing {
+
+// The --thumbnails of the batch mode: pictures of the results drawn with
+// the viewer's mesh shader and camera, colored by the mean curvature, on
+// one thread that owns an OffscreenContext for all of them. render() packs
+// the attributes like the viewer uploads them and queues them, the meshes
+// that are processed side by side take turns. Every picture is read back
+// into a pixel buffer object of a small ring and written as PNG once its
+// fence passed, while the next meshes are drawn, so the GPU does not stall
+// on the readback.
+class ThumbnailRenderer : public BatchThumbnails {
+
+public:
+    explicit ThumbnailRenderer(const unsigned int size) : size_(int(size)) {}
+    ~ThumbnailRenderer() { finish(); }
+
+    // starts the render thread and its context; false and a message if
+    // there is none
+    bool start(std::string& error);
+    void render(MeshProcessing& mesh, const std::string& path) override;
+    // draws and writes what is queued and stops the thread; returns the
+    // number of pictures that could not be written
+    int finish();
+
+private:
+    // the attributes of one mesh, packed by render()
+    struct Job {
+        std::string path;
+        PackedPositions positions;
+        PackedNormals normals;
+        PackedScalars scalars;
+        Eigen::Matrix<uint32_t, Eigen::Dynamic, Eigen::Dynamic> indices;
+        Eigen::Vector3f box_min, box_extent;
+        Eigen::Vector2f scalar_range;
+        Eigen::Vector3f center;
+        float radius;
+    };
+
+    // a picture on its way back from the GPU
+    struct Readback {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        std::string path;
+    };
+
+    // meshes waiting for the render thread, beyond that render() waits
+    enum { QUEUED = 2, READBACKS = 3 };
+
+    void run();
+    bool init_gl();
+    void free_gl();
+    void draw(const Job& job);
+    // waits for the readback of slot, if any, and writes its picture
+    void write(Readback& slot);
+
+    const int size_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Job> queue_;
+    bool closed_ = false;
+    bool started_ = false;
+    bool ready_ = false;
+    std::string error_;
+    int failed_ = 0;
+
+    // owned by the render thread
+    OffscreenContext context_;
+    nanogui::GLShader shader_;
+    // multisampled target, resolved into the single sampled one that is
+    // read back
+    GLuint framebuffer_ = 0, color_ = 0, depth_ = 0;
+    GLuint resolved_ = 0, resolvedColor_ = 0;
+    Readback readbacks_[READBACKS];
+    int next_ = 0;
+    std::vector<unsigned char> pixels_;
+};
+
+}
+
+#endif // THUMBNAIL_RENDERER_H
@@ -0,0 +1,78 @@
+#include "vertex_packing.h"
+#include "geometry_kernels.h"
+#include <algorithm>
+#include <cmath>
+
+namespace mesh_processing {
+
+// round to nearest of x in [0, 1] times max
+static inline int quantize(const float x, const float max) {
+    return int(std::min(std::max(x, 0.0f), 1.0f) * max + 0.5f);
+}
+
+void pack_positions(const Eigen::Map<const Eigen::Matrix3Xf>& points, PackedPositions& packed,
+                    Eigen::Vector3f& min, Eigen::Vector3f& extent) {
+    const int n = int(points.cols());
+    packed.resize(3, n);
+    if (n == 0) {
+        min.setZero();
+        extent.setZero();
+        return;
+    }
+    min = points.rowwise().minCoeff();
+    extent = points.rowwise().maxCoeff() - min;
+    pack_positions_in_box(points, min, extent, packed);
+}
+
+void pack_positions_in_box(const Eigen::Map<const Eigen::Matrix3Xf>& points,
+                           const Eigen::Vector3f& min, const Eigen::Vector3f& extent,
+                           PackedPositions& packed) {
+    const int n = int(points.cols());
+    packed.resize(3, n);
+    Eigen::Vector3f scale;
+    for (int k = 0; k < 3; ++k) scale[k] = extent[k] > 0.0f ? 1.0f / extent[k] : 0.0f;
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            packed(k, i) = uint16_t(quantize((points(k, i) - min[k]) * scale[k], 65535.0f));
+        }
+    }
+}
+
+void pack_normals(const Eigen::Map<const Eigen::Matrix3Xf>& normals, PackedNormals& packed) {
+    const int n = int(normals.cols());
+    packed.resize(2, n);
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower
+        // half over the diagonals
+        const float l1 = std::abs(normals(0, i)) + std::abs(normals(1, i)) + std::abs(normals(2, i));
+        float x = 0.0f, y = 0.0f;
+        if (l1 > 0.0f) {
+            x = normals(0, i) / l1;
+            y = normals(1, i) / l1;
+            if (normals(2, i) < 0.0f) {
+                const float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+                const float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+                x = fx;
+                y = fy;
+            }
+        }
+        packed(0, i) = int16_t(quantize(0.5f * (x + 1.0f), 65534.0f) - 32767);
+        packed(1, i) = int16_t(quantize(0.5f * (y + 1.0f), 65534.0f) - 32767);
+    }
+}
+
+void pack_scalars(const Eigen::Map<const Eigen::Matrix<float, 1, Eigen::Dynamic> >& values,
+                  const float min_value, const float max_value, PackedScalars& packed) {
+    const int n = int(values.cols());
+    packed.resize(1, n);
+    const float range = max_value - min_value;
+    const float scale = range > 0.0f ? 1.0f / range : 0.0f;
+
+    geometry_kernels().pack_scalars(n, values.data(), min_value, scale, packed.data());
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <Eigen/Core>
+#include <cstdint>
+
+namespace mesh_processing {
+
+// Compact vertex attributes for the GPU, uploaded as normalized integers
+// and decoded in the vertex shaders: 6 bytes per position, 4 per normal and
+// 1 per scalar instead of 12, 12 and 4.
+
+typedef Eigen::Matrix<uint16_t, 3, Eigen::Dynamic> PackedPositions;
+typedef Eigen::Matrix<int16_t, 2, Eigen::Dynamic> PackedNormals;
+typedef Eigen::Matrix<uint8_t, 1, Eigen::Dynamic> PackedScalars;
+// RGBA8 colors, the storage of a Color8 vertex property is already in this
+// layout and uploads as normalized vec4 without packing
+typedef Eigen::Matrix<uint8_t, 4, Eigen::Dynamic> PackedColors;
+
+// points as 16 bit fractions of their bounding box, which is returned in
+// min and extent: a point is min + packed / 65535 * extent
+void pack_positions(const Eigen::Map<const Eigen::Matrix3Xf>& points, PackedPositions& packed,
+                    Eigen::Vector3f& min, Eigen::Vector3f& extent);
+// points as fractions of a given box, e.g. a part of the points packed
+// before; points outside are clamped
+void pack_positions_in_box(const Eigen::Map<const Eigen::Matrix3Xf>& points,
+                           const Eigen::Vector3f& min, const Eigen::Vector3f& extent,
+                           PackedPositions& packed);
+
+// unit normals in octahedral encoding with 16 bit per coordinate, a zero
+// normal decodes to (0, 0, 1)
+void pack_normals(const Eigen::Map<const Eigen::Matrix3Xf>& normals, PackedNormals& packed);
+
+// values as 8 bit fractions of [min_value, max_value], values outside are
+// clamped
+void pack_scalars(const Eigen::Map<const Eigen::Matrix<float, 1, Eigen::Dynamic> >& values,
+                  const float min_value, const float max_value, PackedScalars& packed);
+
+}
+
+#endif // VERTEX_PACKING_H
@@ -1,7 +1,17 @@
 
 #include "viewer.h"
+#include "mesh_shaders.h"
+#include <surface_mesh/Trace.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include <fstream>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
 
 void Viewer::select_point(const Eigen::Vector2i & pixel) {
+	if (job_.running()) return;
+	sync_gpu_smoothing();
 	Eigen::Matrix4f model, view, projection;
 	computeCameraMatrices(model, view, projection);
 	Matrix4f MVP = projection * view * model;
@@ -11,8 +21,46 @@ void Viewer::select_point(const Eigen::Vector2i & pixel) {
 	Eigen::Vector3f endpoint = nanogui::unproject(Eigen::Vector3f(pixel[0], pixel[1], 1), view * model, projection, mSize);
 	Eigen::Vector3f direction = (endpoint - origin) / (endpoint - origin).norm();
 
-	Eigen::Vector3f closest_vertex = mesh_->get_closest_vertex(origin, direction);
+	Eigen::Vector3f closest_vertex;
+	if (!gpu_picking_ || !pick_gpu(pixel, closest_vertex)) {
+		closest_vertex = mesh_->get_closest_vertex(origin, direction);
+	}
 	mesh_->set_selection(closest_vertex);
+	recorder_.record("pick", { closest_vertex.x(), closest_vertex.y(), closest_vertex.z() });
+}
+
+mesh_processing::MeshProcessing::SelectionView Viewer::selection_view() {
+	Eigen::Matrix4f model, view, proj;
+	computeCameraMatrices(model, view, proj);
+	mesh_processing::MeshProcessing::SelectionView selection;
+	selection.mvp = proj * view * model;
+	selection.viewport = mSize.cast<float>();
+	// the camera position in model coordinates
+	selection.eye = (view * model).inverse().block<3, 1>(0, 3);
+	return selection;
+}
+
+void Viewer::select_vertices(const Vector2i & p, const bool finish) {
+	if (job_.running()) return;
+	const Vector2f position = p.cast<float>();
+	const mesh_processing::MeshProcessing::SELECTION_MODE mode = deselecting_ ?
+		mesh_processing::MeshProcessing::SELECT_REMOVE : mesh_processing::MeshProcessing::SELECT_ADD;
+	if (selectionTool_ == TOOL_LASSO) {
+		// the polygon grows while the button is down and selects once
+		if (lasso_.empty() || (position - lasso_.back()).norm() >= 2.0f) {
+			lasso_.push_back(position);
+		}
+		if (!finish) return;
+		sync_gpu_smoothing();
+		mesh_->select_lasso(selection_view(), lasso_, mode);
+		lasso_.clear();
+	}
+	else {
+		if (finish) return;
+		sync_gpu_smoothing();
+		mesh_->select_brush(selection_view(), position, float(max(brushRadiusBox_->value(), 1)), mode);
+	}
+	upload_selection();
 }
 
 bool Viewer::keyboardEvent(int key, int scancode, int action, int modifiers) {
@@ -23,12 +71,43 @@ bool Viewer::keyboardEvent(int key, int scancode, int action, int modifiers) {
 		setVisible(false);
 		return true;
 	}
+	if (key == GLFW_KEY_N && action == GLFW_PRESS) {
+		const string next = mesh_processing::next_mesh_file(meshFile_);
+		if (!next.empty()) open_mesh(next);
+		return true;
+	}
 	return false;
 }
 
 void Viewer::draw(NVGcontext *ctx) {
+	if (hud_->visible()) update_hud();
+
 	/* Draw the user interface */
 	Screen::draw(ctx);
+
+	// the lasso being drawn and the outline of the brush
+	if (lasso_.size() > 1) {
+		nvgBeginPath(ctx);
+		nvgMoveTo(ctx, lasso_[0].x(), lasso_[0].y());
+		for (size_t i = 1; i < lasso_.size(); ++i) {
+			nvgLineTo(ctx, lasso_[i].x(), lasso_[i].y());
+		}
+		nvgStrokeColor(ctx, nvgRGBA(230, 130, 30, 255));
+		nvgStrokeWidth(ctx, 1.5f);
+		nvgStroke(ctx);
+	}
+	if (selecting_ && selectionTool_ == TOOL_BRUSH) {
+		const Vector2i pos = mousePos();
+		nvgBeginPath(ctx);
+		nvgCircle(ctx, pos.x(), pos.y(), float(max(brushRadiusBox_->value(), 1)));
+		nvgStrokeColor(ctx, nvgRGBA(230, 130, 30, 255));
+		nvgStrokeWidth(ctx, 1.5f);
+		nvgStroke(ctx);
+	}
+
+	// drawContents() and the widgets, exponentially smoothed
+	const double ms = (Trace::now() - frameBegin_) * 1e-6;
+	cpuFrameMs_ = cpuFrameMs_ == 0.0 ? ms : 0.9 * cpuFrameMs_ + 0.1 * ms;
 }
 
 Vector2f Viewer::getScreenCoord() {
@@ -39,6 +118,28 @@ Vector2f Viewer::getScreenCoord() {
 
 void Viewer::drawContents() {
 	using namespace nanogui;
+	frameBegin_ = Trace::now();
+
+	// collect a finished job and upload its result on the GL thread
+	if (job_.poll_finished()) {
+		finish_job();
+	}
+	// a loaded mesh replaces mesh_ once no job uses it anymore
+	if (!job_.running() && openLoader_->poll_finished()) {
+		finish_loading();
+	}
+	if (sharedMesh_.is_open() && !job_.running() && !openLoader_->running()) {
+		poll_shared_mesh();
+	}
+	if (!pendingScans_.empty() && !job_.running() && !openLoader_->running()) {
+		poll_scans();
+	}
+	if (job_.running()) {
+		upload_snapshot();
+	}
+	const bool loading = openLoader_->running();
+	progressBar_->setValue(job_.running() ? job_.progress() :
+		loading ? openLoader_->progress() : 0.0f);
 
 	/* Draw the window contents using OpenGL */
 	shader_.bind();
@@ -49,45 +150,77 @@ void Viewer::drawContents() {
 	Matrix4f mv = view*model;
 	Matrix4f p = proj;
 
+	// the old mesh is hidden while the new one is read
+	if (loading) {
+		if (!draw_progressive(mv, p)) draw_loading_box(mv, p);
+		return;
+	}
+
+	// frames that only change the widgets, e.g. progress updates during a
+	// job, copy the mesh passes of the last frame
+	if (sceneValid_ && sceneSize_ == mFBSize && sceneMV_ == mv && sceneP_ == p) {
+		blit_scene();
+		return;
+	}
+	const bool cached = bind_scene_framebuffer();
+
+	// a mesh with more triangles than pixels as point splats; otherwise the
+	// clusters of the LOD hierarchy at the level the camera needs; the
+	// running job owns the mesh, the full buffers are drawn meanwhile
+	int splatStride = 1;
+	float splatSize = 1.0f;
+	const bool splats = splat_layout(mv, p, splatStride, splatSize);
+	const bool lod = !splats && lod_ && !job_.running() && refresh_lod();
+	GLShader& meshShader = splats ? shaderSplat_ : lod ? shaderLod_ : shader_;
+	if (splats || lod) {
+		meshShader.bind();
+		meshShader.setUniform("scalar_range", scalar_range_);
+		meshShader.setUniform("scalar_decode", scalar_decode_);
+	}
+	if (lod) {
+		mesh_->get_lod().select(mv, p, float(mFBSize.y()), 1.0f, lodRanges_);
+	}
 	/* MVP uniforms */
-	shader_.setUniform("MV", mv);
-	shader_.setUniform("P", p);
+	meshShader.setUniform("MV", mv);
+	meshShader.setUniform("P", p);
 
 	// Setup OpenGL (making sure the GUI doesn't disable these
 	glEnable(GL_DEPTH_TEST);
 	glDisable(GL_CULL_FACE);
 
-	// Render everything
-	if (wireframe_) {
-		glEnable(GL_POLYGON_OFFSET_FILL);
-		glPolygonOffset(1.0, 1.0);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	// Render everything, the wireframe in the same pass
+	meshShader.setUniform("intensity", Vector3f(1.0, 1.5, 1.0));
+	meshShader.setUniform("wire_intensity", Vector3f(0.5, 0.7, 0.5));
+	meshShader.setUniform("wireframe", int(wireframe_));
+	meshShader.setUniform("color_mode", int(color_mode));
+	begin_gpu_timer();
+	if (splats) {
+		draw_splats(splatStride, splatSize);
 	}
-
-	Vector3f colors(1.0, 1.5, 1.0);
-	shader_.setUniform("intensity", colors);
-	if (color_mode == CURVATURE) {
-		shader_.setUniform("color_mode", int(curvature_type));
+	else if (lod) {
+		draw_ranges(lodRanges_);
 	}
-	else {
-		shader_.setUniform("color_mode", int(color_mode));
+	else if (!job_.running() && !gpuPositions_) {
+		// the runs of the index buffer in the view frustum; the bounds are
+		// those of mesh_, not of GPU smoothed positions
+		mesh_->get_draw_clusters().select(mv, p, drawRanges_);
+		draw_ranges(drawRanges_);
 	}
-	shader_.drawIndexed(GL_TRIANGLES, 0, mesh_->get_number_of_face());
-
-	if (wireframe_) {
-		glDisable(GL_POLYGON_OFFSET_FILL);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		colors << 0.5, 0.7, 0.5;
-		shader_.setUniform("intensity", colors);
+	else {
 		shader_.drawIndexed(GL_TRIANGLES, 0, mesh_->get_number_of_face());
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	}
+	draw_scene(mv, p);
 
 	if (normals_) {
-		shaderNormals_.bind();
-		shaderNormals_.setUniform("MV", mv);
-		shaderNormals_.setUniform("P", p);
-		shaderNormals_.drawIndexed(GL_TRIANGLES, 0, mesh_->get_number_of_face());
+		draw_normals(mv, p);
+	}
+	if (selectedCount_ > 0) {
+		shaderSelected_.bind();
+		shaderSelected_.setUniform("MV", mv);
+		shaderSelected_.setUniform("P", p);
+		glEnable(GL_PROGRAM_POINT_SIZE);
+		shaderSelected_.drawArray(GL_POINTS, 0, selectionVertices_);
+		glDisable(GL_PROGRAM_POINT_SIZE);
 	}
 	selection_ = true;
 	if (selection_) {
@@ -98,6 +231,427 @@ void Viewer::drawContents() {
 		shaderSelection_.drawIndexed(GL_POINTS, 0, mesh_->get_number_of_face());
 		glDisable(GL_PROGRAM_POINT_SIZE);		
 	}
+	end_gpu_timer();
+
+	if (cached) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		sceneValid_ = true;
+		sceneMV_ = mv;
+		sceneP_ = p;
+		blit_scene();
+	}
+}
+
+bool Viewer::bind_scene_framebuffer() {
+	// (re)allocate the color and depth targets at framebuffer resolution
+	if (sceneFramebuffer_ == 0) {
+		glGenFramebuffers(1, &sceneFramebuffer_);
+		glGenRenderbuffers(1, &sceneColor_);
+		glGenRenderbuffers(1, &sceneDepth_);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer_);
+	if (sceneSize_ != mFBSize) {
+		sceneSize_ = mFBSize;
+		glBindRenderbuffer(GL_RENDERBUFFER, sceneColor_);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, mFBSize.x(), mFBSize.y());
+		glBindRenderbuffer(GL_RENDERBUFFER, sceneDepth_);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mFBSize.x(), mFBSize.y());
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, sceneColor_);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sceneDepth_);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		// drawn uncached then
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return false;
+	}
+	glViewport(0, 0, mFBSize.x(), mFBSize.y());
+	glClearColor(mBackground[0], mBackground[1], mBackground[2], mBackground[3]);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	return true;
+}
+
+void Viewer::blit_scene() {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer_);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, sceneSize_.x(), sceneSize_.y(), 0, 0, sceneSize_.x(), sceneSize_.y(),
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Viewer::drawAll() {
+	// the main loop draws on every event and on its refresh events every
+	// 50 ms; a frame is only drawn while a job or a load runs, and for a
+	// second after the last input so that tooltips and highlights settle;
+	// an attached segment is polled on every refresh
+	if (!job_.pending() && !openLoader_->pending() && !sharedMesh_.is_open() &&
+		pendingScans_.empty() && glfwGetTime() - mLastInteraction > 1.0) return;
+	Screen::drawAll();
+}
+
+float Viewer::projected_area(const Matrix4f& mv, const Matrix4f& p) const {
+	const Vector3f center = boxMin_ + 0.5f * boxExtent_;
+	const float radius = 0.5f * boxExtent_.norm() * mv.block<3, 1>(0, 0).norm();
+	const float depth = -(mv.block<3, 3>(0, 0) * center + mv.block<3, 1>(0, 3)).z();
+	float area = float(mFBSize.x()) * mFBSize.y();
+	if (depth > radius) {
+		const float r = 0.5f * mFBSize.y() * p(1, 1) * radius / depth;
+		area = min(area, float(M_PI) * r * r);
+	}
+	return area;
+}
+
+// points the bound attributes of shader at every stride-th vertex of their
+// shared buffers, which hold packed integers or the floats of gpuSmoother_
+static void stride_attributes(GLShader& shader, std::initializer_list<const char*> names,
+	const int stride, const GLuint divisor) {
+	for (const char* name : names) {
+		const GLint location = shader.attrib(name, false);
+		if (location < 0) continue;
+		GLint buffer = 0, size = 0, type = 0, normalized = 0;
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &normalized);
+		const GLsizei element = type == GL_FLOAT ? sizeof(float) :
+			type == GL_UNSIGNED_BYTE || type == GL_BYTE ? 1 : sizeof(uint16_t);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glVertexAttribPointer(location, size, type, normalized, size * element * stride, 0);
+		glVertexAttribDivisor(location, divisor);
+	}
+}
+
+void Viewer::draw_normals(const Matrix4f& mv, const Matrix4f& p) {
+	const int n = int(uploaded_vertices_);
+	if (n == 0) return;
+
+	// with sparse normals, about one per SPARSE_NORMAL_SPACING^2 pixels of
+	// the projected bounding sphere, every stride-th vertex of the buffers
+	const float SPARSE_NORMAL_SPACING = 6.0f;
+	int stride = 1;
+	if (sparseNormals_) {
+		const float area = projected_area(mv, p);
+		const float budget = std::max(1.0f, area / (SPARSE_NORMAL_SPACING * SPARSE_NORMAL_SPACING));
+		stride = std::max(1, int(std::ceil(n / budget)));
+	}
+
+	shaderNormals_.bind();
+	shaderNormals_.setUniform("MV", mv);
+	shaderNormals_.setUniform("P", p);
+	// the shared buffers advance once per instance, by stride vertices
+	stride_attributes(shaderNormals_, { "position", "normal" }, stride, 1);
+	glDrawArraysInstanced(GL_LINES, 0, 2, (n + stride - 1) / stride);
+}
+
+void Viewer::draw_ranges(const vector<mesh_processing::LodHierarchy::Range>& ranges) {
+	if (ranges.empty()) return;
+	// one call for all ranges of the bound index buffer
+	multiDrawCounts_.resize(ranges.size());
+	multiDrawOffsets_.resize(ranges.size());
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		multiDrawCounts_[i] = GLsizei(3 * ranges[i].count);
+		multiDrawOffsets_[i] = (const void*)(3 * size_t(ranges[i].first) * sizeof(uint32_t));
+	}
+	glMultiDrawElements(GL_TRIANGLES, multiDrawCounts_.data(), GL_UNSIGNED_INT,
+		multiDrawOffsets_.data(), GLsizei(ranges.size()));
+}
+
+bool Viewer::splat_layout(const Matrix4f& mv, const Matrix4f& p, int& stride, float& size) const {
+	// triangles smaller than about half a pixel are not worth rasterizing
+	const float SPLAT_TRIANGLES_PER_PIXEL = 2.0f;
+	const int n = int(uploaded_vertices_);
+	if (!splats_ || wireframe_ || n == 0) return false;
+	const float area = std::max(1.0f, projected_area(mv, p));
+	if (mesh_->get_number_of_face() < SPLAT_TRIANGLES_PER_PIXEL * area) return false;
+
+	// about one splat per pixel on the front half of the surface, sized to
+	// close the gaps between them
+	const float budget = 2.0f * area;
+	stride = std::max(1, int(std::ceil(n / budget)));
+	const float spacing = std::sqrt(2.0f * area / std::max(1, n / stride));
+	size = std::min(16.0f, std::max(1.0f, std::ceil(1.5f * spacing)));
+	return true;
+}
+
+void Viewer::draw_splats(const int stride, const float size) {
+	const int n = int(uploaded_vertices_);
+	shaderSplat_.setUniform("splat", 1);
+	shaderSplat_.setUniform("point_size", size);
+	stride_attributes(shaderSplat_, { "position", "normal", "scalar" }, stride, 0);
+	glEnable(GL_PROGRAM_POINT_SIZE);
+	glDrawArrays(GL_POINTS, 0, (n + stride - 1) / stride);
+	glDisable(GL_PROGRAM_POINT_SIZE);
+}
+
+void Viewer::gpu_smooth(const int iterations, const bool cotan) {
+	if (job_.running()) return;
+	if (!gpuSmoother_.init()) {
+		cerr << "GPU smoothing unavailable, smoothing on the CPU" << endl;
+		if (run_job("Smooth", [this, iterations, cotan](JobProgress&) {
+			if (cotan) mesh_->smooth(iterations);
+			else mesh_->uniform_smooth(iterations);
+		})) {
+			recorder_.record(cotan ? "smooth" : "uniform-smooth", { double(iterations) });
+		}
+		return;
+	}
+	SURFACE_MESH_TRACE_ZONE("gpu smooth");
+	// the stencil is uploaded once per weighting, the positions then stay on
+	// the GPU until the mesh is needed on the CPU
+	if (gpuPositions_ && gpuCotan_ != cotan) sync_gpu_smoothing();
+	if (!gpuPositions_) {
+		gpuSmoother_.upload(mesh_->smoothing_stencil(cotan), mesh_->get_points(), boxMin_, boxExtent_);
+		if (gpuSmoother_.empty()) return;
+		gpuCotan_ = cotan;
+	}
+	gpuSmoother_.smooth(iterations, 0.5f);
+	gpuPositions_ = true;
+	recorder_.record(cotan ? "smooth" : "uniform-smooth", { double(iterations) });
+	if (color_mode == CURVATURE) upload_gpu_curvatures();
+	// the principal curvatures, the deviation and the self-intersections
+	// need the positions back on the CPU
+	if (color_mode == PRINCIPAL || color_mode == DEVIATION || color_mode == INTERSECTION) {
+		sync_gpu_smoothing();
+		return;
+	}
+
+	// the mesh shaders draw from the smoothed buffers, as floats in the
+	// same box coordinates the packed positions use
+	for (GLShader* shader : { &shader_, &shaderLod_, &shaderSplat_, &shaderNormals_, &shaderPick_,
+	                          &shaderSelected_ }) {
+		shader->bind();
+		const GLint position = shader->attrib("position", false);
+		if (position >= 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, gpuSmoother_.positions());
+			glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		}
+		const GLint normal = shader->attrib("normal", false);
+		if (normal >= 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, gpuSmoother_.normals());
+			glVertexAttribPointer(normal, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		}
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	sceneValid_ = false;
+}
+
+void Viewer::upload_gpu_curvatures() {
+	SURFACE_MESH_TRACE_ZONE("gpu curvatures");
+	sceneValid_ = false;
+	gpuSmoother_.compute_curvatures();
+	// the color bounds are quantiles, they need the values on the CPU
+	const int curvature = int(curvature_type) - int(UNIMEAN);
+	std::vector<float> values;
+	gpuSmoother_.download_curvatures(curvature, values);
+	mesh_processing::MeshProcessing::get_scalar_bounds(
+		mesh_processing::MeshProcessing::SCALAR_TYPE(curvature_type - VALENCE_COLOR),
+		values, scalar_range_[0], scalar_range_[1]);
+	// plain floats, the next upload_colors() points the shaders back
+	scalar_decode_ = Vector2f(0.0f, 1.0f);
+	uploaded_scalar_ = -1;
+	for (GLShader* shader : { &shader_, &shaderLod_, &shaderSplat_ }) {
+		shader->bind();
+		const GLint scalar = shader->attrib("scalar", false);
+		if (scalar >= 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, gpuSmoother_.curvatures(curvature));
+			glVertexAttribPointer(scalar, 1, GL_FLOAT, GL_FALSE, 0, 0);
+		}
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	shader_.bind();
+	shader_.setUniform("scalar_range", scalar_range_);
+	shader_.setUniform("scalar_decode", scalar_decode_);
+}
+
+void Viewer::sync_gpu_smoothing() {
+	if (!gpuPositions_) return;
+	gpuPositions_ = false;
+	SURFACE_MESH_TRACE_ZONE("gpu smooth download");
+	Eigen::Matrix3Xf points;
+	gpuSmoother_.download(points);
+	mesh_->set_points(points);
+	mesh_->compute_mesh_properties();
+	// uploads positions and normals again and points the shaders back
+	refresh_mesh();
+}
+
+void Viewer::draw_loading_box(const Matrix4f& mv, const Matrix4f& p) {
+	Point min, max;
+	if (!openLoader_->get_bounding_box(min, max)) return;
+	if (!boxCentered_) {
+		center_trackball(0.5f * (min + max), 0.5f * norm(max - min));
+		boxCentered_ = true;
+
+		// the 8 corners, bit i of the column picks min or max along axis i
+		Eigen::MatrixXf corners(3, 8);
+		for (int i = 0; i < 8; ++i) {
+			corners.col(i) << (i & 1 ? max : min)[0], (i & 2 ? max : min)[1], (i & 4 ? max : min)[2];
+		}
+		Eigen::Matrix<uint32_t, Eigen::Dynamic, Eigen::Dynamic> edges(2, 12);
+		edges << 0, 2, 4, 6, 0, 1, 4, 5, 0, 1, 2, 3,
+		         1, 3, 5, 7, 2, 3, 6, 7, 4, 5, 6, 7;
+		shaderBox_.bind();
+		shaderBox_.uploadIndices(edges);
+		shaderBox_.uploadAttrib("position", corners);
+		// the matrices above still fit the previous mesh
+		Eigen::Matrix4f model, view, proj;
+		computeCameraMatrices(model, view, proj);
+		shaderBox_.setUniform("MV", Matrix4f(view * model));
+		shaderBox_.setUniform("P", proj);
+	} else {
+		shaderBox_.bind();
+		shaderBox_.setUniform("MV", mv);
+		shaderBox_.setUniform("P", p);
+	}
+	glEnable(GL_DEPTH_TEST);
+	shaderBox_.drawIndexed(GL_LINES, 0, 12);
+}
+
+// bytes of a progressive mesh decoded per frame, a few milliseconds
+static const size_t PROGRESSIVE_BYTES_PER_FRAME = size_t(4) << 20;
+
+bool Viewer::draw_progressive(const Matrix4f& mv, const Matrix4f& p) {
+	if (!progressive_.is_open()) return false;
+	progressive_.poll(PROGRESSIVE_BYTES_PER_FRAME);
+	const mesh_processing::ProgressiveMeshDecoder& decoder = progressive_.decoder();
+	if (!decoder.has_base()) return false;
+	Matrix4f modelView = mv, projection = p;
+	if (!boxCentered_) {
+		const Point min = decoder.box_min(), max = decoder.box_max();
+		center_trackball(0.5f * (min + max), 0.5f * norm(max - min));
+		boxCentered_ = true;
+		// the matrices above still fit the previous mesh
+		Eigen::Matrix4f model, view, proj;
+		computeCameraMatrices(model, view, proj);
+		modelView = view * model;
+		projection = proj;
+	}
+	shaderProgressive_.bind();
+	shaderProgressive_.setUniform("MV", modelView);
+	shaderProgressive_.setUniform("P", projection);
+	shaderProgressive_.setUniform("intensity", Vector3f(1.0, 1.5, 1.0));
+	shaderProgressive_.setUniform("wire_intensity", Vector3f(0.5, 0.7, 0.5));
+	shaderProgressive_.setUniform("wireframe", int(wireframe_));
+	shaderProgressive_.setUniform("color_mode", int(NORMAL));
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	progressive_.draw(shaderProgressive_);
+	return true;
+}
+
+uint64_t Viewer::live_topology() {
+	return mesh_->get_mesh_hash().topology;
+}
+
+void Viewer::add_to_scene(const string& name, const ConstMatrix3XfMap& points,
+	const std::shared_ptr<const mesh_processing::SceneBuffers::Indices>& indices,
+	const uint64_t topology, const Point& center) {
+	// along x, a bounding sphere diameter of mesh_ and a gap apart
+	const float spacing = 2.5f * mesh_->get_dist_max();
+	const Point target = mesh_->get_mesh_center();
+	const Vector3f offset(target.x - center.x + spacing * (sceneBuffers_.size() + 1),
+		target.y - center.y, target.z - center.z);
+	const int mesh = sceneBuffers_.add(name, points, indices, topology, offset);
+	sceneBuffers_.set_live_topology(live_topology());
+
+	Button* b = new Button(scenePanel_, name);
+	b->setFlags(Button::ToggleButton);
+	b->setPushed(true);
+	b->setChangeCallback([this, mesh](bool visible) {
+		this->sceneBuffers_.set_visible(mesh, visible);
+		this->sceneValid_ = false;
+	});
+	performLayout();
+	sceneValid_ = false;
+}
+
+void Viewer::add_mesh_to_scene(const bool original) {
+	if (job_.running() || openLoader_->running()) return;
+	sync_gpu_smoothing();
+	if (mesh_->get_number_of_face() == 0) return;
+	const ConstMatrix3XfMap points = original ? mesh_->get_points_init() : mesh_->get_points();
+	if (points.cols() != mesh_->get_points().cols()) return;
+	// the indices of a topology that is in the scene already are dropped
+	const auto indices = std::make_shared<const mesh_processing::SceneBuffers::Indices>(*mesh_->get_indices());
+	const string name = original ? string("Original") : "Snapshot " + to_string(sceneBuffers_.size() + 1);
+	add_to_scene(name, points, indices, live_topology(), mesh_->get_mesh_center());
+}
+
+void Viewer::add_scan(const string& filename) {
+	PendingScan scan;
+	scan.name = filename.substr(filename.find_last_of("/\\") + 1);
+	scan.mesh.reset(new Surface_mesh());
+	scan.read = read_mesh_async(*scan.mesh, filename, NULL, READ_GEOMETRY);
+	pendingScans_.push_back(std::move(scan));
+}
+
+void Viewer::poll_scans() {
+	for (size_t i = 0; i < pendingScans_.size();) {
+		PendingScan& scan = pendingScans_[i];
+		if (scan.read.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++i;
+			continue;
+		}
+		const Surface_mesh& mesh = *scan.mesh;
+		if (scan.read.get() && mesh.n_faces() > 0) {
+			// polygons as triangle fans
+			vector<uint32_t> triangles;
+			vector<uint32_t> face;
+			for (auto f : mesh.faces()) {
+				face.clear();
+				for (auto v : mesh.vertices(f)) face.push_back(uint32_t(v.idx()));
+				for (size_t k = 2; k < face.size(); ++k) {
+					triangles.insert(triangles.end(), { face[0], face[k - 1], face[k] });
+				}
+			}
+			const auto indices = std::make_shared<const mesh_processing::SceneBuffers::Indices>(
+				Eigen::Map<const mesh_processing::SceneBuffers::Indices>(triangles.data(), 3, triangles.size() / 3));
+			const ConstMatrix3XfMap points = mesh_processing::as_const_eigen(mesh.points());
+			const Vector3f center = 0.5f * (points.rowwise().minCoeff() + points.rowwise().maxCoeff());
+			add_to_scene(scan.name, points, indices, mesh_processing::topology_hash(mesh),
+				Point(center.x(), center.y(), center.z()));
+		}
+		else {
+			cerr << "could not read " << scan.name << endl;
+		}
+		pendingScans_.erase(pendingScans_.begin() + i);
+	}
+}
+
+void Viewer::draw_scene(const Matrix4f& mv, const Matrix4f& p) {
+	if (sceneBuffers_.empty()) return;
+	shaderScene_.bind();
+	shaderScene_.setUniform("P", p);
+	// a second tint, so that they are told apart from mesh_
+	shaderScene_.setUniform("intensity", Vector3f(0.8, 1.1, 1.6));
+	shaderScene_.setUniform("wire_intensity", Vector3f(0.5, 0.7, 0.5));
+	shaderScene_.setUniform("wireframe", int(wireframe_));
+	shaderScene_.setUniform("color_mode", int(NORMAL));
+	sceneBuffers_.draw(shaderScene_, shader_, mv);
+}
+
+void Viewer::begin_gpu_timer() {
+	if (!hud_->visible()) return;
+	if (gpuQueries_[0] == 0) glGenQueries(2, gpuQueries_);
+	glBeginQuery(GL_TIME_ELAPSED, gpuQueries_[gpuFrame_]);
+}
+
+void Viewer::end_gpu_timer() {
+	if (!hud_->visible()) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	gpuQueryPending_[gpuFrame_] = true;
+
+	// the other query was issued a frame ago and is usually done by now
+	gpuFrame_ = 1 - gpuFrame_;
+	if (!gpuQueryPending_[gpuFrame_]) return;
+	gpuQueryPending_[gpuFrame_] = false;
+	GLint available = 0;
+	glGetQueryObjectiv(gpuQueries_[gpuFrame_], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) return;   // still busy, drop the sample rather than stall
+	GLuint64 ns = 0;
+	glGetQueryObjectui64v(gpuQueries_[gpuFrame_], GL_QUERY_RESULT, &ns);
+	const double ms = ns * 1e-6;
+	gpuFrameMs_ = gpuFrameMs_ == 0.0 ? ms : 0.9 * gpuFrameMs_ + 0.1 * ms;
 }
 
 bool Viewer::scrollEvent(const Vector2i &p, const Vector2f &rel) {
@@ -111,7 +665,10 @@ bool Viewer::mouseMotionEvent(const Vector2i &p, const Vector2i &rel,
 	int button, int modifiers) {
 
 	if (!Screen::mouseMotionEvent(p, rel, button, modifiers)) {
-		if (camera_.arcball.motion(p)) {
+		if (selecting_) {
+			select_vertices(p, false);
+		}
+		else if (camera_.arcball.motion(p)) {
 			//
 		}
 		else if (translate_) {
@@ -145,11 +702,24 @@ bool Viewer::mouseButtonEvent(const Vector2i &p, int button, bool down, int modi
 			translate_ = true;
 			translateStart_ = p;
 		}
+		else if (button == GLFW_MOUSE_BUTTON_1 && selectionTool_ != TOOL_POINT &&
+			(modifiers & GLFW_MOD_CONTROL)) {
+			if (down) {
+				selecting_ = true;
+				deselecting_ = (modifiers & GLFW_MOD_SHIFT) != 0;
+				lasso_.clear();
+				select_vertices(p, false);
+			}
+		}
 		else if (button == GLFW_MOUSE_BUTTON_1 && modifiers == GLFW_MOD_CONTROL) {
 			select_point(Eigen::Vector2i(p.x(), mSize.y() - p.y()));
 			refresh_selection();
 		}
 	}
+	if (button == GLFW_MOUSE_BUTTON_1 && !down && selecting_) {
+		select_vertices(p, true);
+		selecting_ = false;
+	}
 	if (button == GLFW_MOUSE_BUTTON_1 && !down) {
 		camera_.arcball.button(p, false);
 	}
@@ -159,158 +729,242 @@ bool Viewer::mouseButtonEvent(const Vector2i &p, int button, bool down, int modi
 	return true;
 }
 
-void Viewer::initShaders() {
-	// Shaders
-	shader_.init(
-		"a_simple_shader",
+// the mesh geometry shader with the face normals, for meshes without
+// vertex normals; the view directions are the negated eye positions
+static const char* FLAT_GEOMETRY_SHADER =
+	"#version 330\n"
+	"layout(triangles) in;\n"
+	"layout(triangle_strip, max_vertices = 3) out;\n"
+
+	"in vec3 vcolor[];\n"
+	"in float vscalar[];\n"
+	"in vec3 vnormal[];\n"
+	"in vec3 vview_dir[];\n"
+	"in vec3 vlight_dir[];\n"
+
+	"out vec3 fcolor;\n"
+	"out float fscalar;\n"
+	"out vec3 fnormal;\n"
+	"out vec3 view_dir;\n"
+	"out vec3 light_dir;\n"
+	"noperspective out vec3 barycentric;\n"
 
-		/* Vertex shader */
-		"#version 330\n"
-		"uniform mat4 MV;\n"
-		"uniform mat4 P;\n"
-		"uniform int color_mode;\n"
-		"uniform vec3 intensity;\n"
+	"void main() {\n"
+	"    vec3 n = cross(vview_dir[1] - vview_dir[0], vview_dir[2] - vview_dir[0]);\n"
+	"    for (int i = 0; i < 3; i++) {\n"
+	"        gl_Position = gl_in[i].gl_Position;\n"
+	"        fcolor = vcolor[i];\n"
+	"        fscalar = vscalar[i];\n"
+	"        fnormal = n;\n"
+	"        view_dir = vview_dir[i];\n"
+	"        light_dir = vlight_dir[i];\n"
+	"        barycentric = vec3(0.0);\n"
+	"        barycentric[i] = 1.0;\n"
+	"        EmitVertex();\n"
+	"    }\n"
+	"    EndPrimitive();\n"
+	"}";
+
+// the mesh vertex shader for point splats, see draw_splats(): the outputs
+// are the inputs of the mesh fragment shader directly, without a wireframe
+static const char* SPLAT_VERTEX_SHADER =
+	"#version 330\n"
+	PACKED_ATTRIBUTES
+	"uniform mat4 MV;\n"
+	"uniform mat4 P;\n"
+	"uniform vec3 intensity;\n"
+	"uniform vec2 scalar_decode;\n"
+	"uniform float point_size;\n"
 
-		"in vec3 position;\n"
-		"in vec3 valence_color;\n"
-		"in vec3 unicruvature_color;\n"
-		"in vec3 curvature_color;\n"
-		"in vec3 gaussian_curv_color;\n"
-		"in vec3 normal;\n"
+	"in float scalar;\n"
 
-		"out vec3 fcolor;\n"
-		"out vec3 fnormal;\n"
-		"out vec3 view_dir;\n"
-		"out vec3 light_dir;\n"
+	"out vec3 fcolor;\n"
+	"out float fscalar;\n"
+	"out vec3 fnormal;\n"
+	"out vec3 view_dir;\n"
+	"out vec3 light_dir;\n"
+	"noperspective out vec3 barycentric;\n"
 
-		"void main() {\n"
-		"    vec4 vpoint_mv = MV * vec4(position, 1.0);\n"
-		"    gl_Position = P * vpoint_mv;\n"
-		"    if (color_mode == 1) {\n"
-		"        fcolor = valence_color;\n"
-		"    } else if (color_mode == 2) {\n"
-		"        fcolor = unicruvature_color;\n"
-		"    } else if (color_mode == 3) {\n"
-		"        fcolor = curvature_color;\n"
-		"    } else if (color_mode == 4) {\n"
-		"        fcolor = gaussian_curv_color;\n"
-		"    } else {\n"
-		"        fcolor = intensity;\n"
-		"    }\n"
-		"    fnormal = mat3(transpose(inverse(MV))) * normal;\n"
-		"    light_dir = vec3(0.0, 3.0, 3.0) - vpoint_mv.xyz;\n"
-		"    view_dir = -vpoint_mv.xyz;\n"
-		"}",
+	"void main() {\n"
+	"    vec4 vpoint_mv = MV * vec4(unpack_position(), 1.0);\n"
+	"    gl_Position = P * vpoint_mv;\n"
+	"    gl_PointSize = point_size;\n"
+	"    fcolor = intensity;\n"
+	"    fscalar = scalar_decode.x + scalar_decode.y * scalar;\n"
+	"    fnormal = mat3(transpose(inverse(MV))) * unpack_normal();\n"
+	"    light_dir = vec3(0.0, 3.0, 3.0) - vpoint_mv.xyz;\n"
+	"    view_dir = -vpoint_mv.xyz;\n"
+	"    barycentric = vec3(1.0);\n"
+	"}";
 
-		/* Fragment shader */
-		"#version 330\n"
-		"uniform int color_mode;\n"
-		"uniform vec3 intensity;\n"
+void Viewer::initShaders() {
+	// Shaders
+	shader_.init("a_simple_shader", MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER, MESH_GEOMETRY_SHADER);
+	shaderLod_.init("lod_shader", MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER, MESH_GEOMETRY_SHADER);
+	shaderSplat_.init("splat_shader", SPLAT_VERTEX_SHADER, MESH_FRAGMENT_SHADER);
+	shaderScene_.init("scene_shader", MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER, MESH_GEOMETRY_SHADER);
+	shaderProgressive_.init("progressive_shader", MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER, FLAT_GEOMETRY_SHADER);
 
-		"in vec3 fcolor;\n"
-		"in vec3 fnormal;\n"
-		"in vec3 view_dir;\n"
-		"in vec3 light_dir;\n"
+	// one instance of a two vertex line per mesh vertex, see draw_normals()
+	shaderNormals_.init("normal_shader", NORMAL_VERTEX_SHADER, NORMAL_FRAGMENT_SHADER);
 
-		"out vec4 color;\n"
+	shaderSelection_.init(
+	"selection_shader",
 
-		"void main() {\n"
-		"    vec3 c = vec3(0.0);\n"
-		"    if (color_mode == 0) {\n"
-		"        c += vec3(1.0)*vec3(0.18, 0.1, 0.1);\n"
-		"        vec3 n = normalize(fnormal);\n"
-		"        vec3 v = normalize(view_dir);\n"
-		"        vec3 l = normalize(light_dir);\n"
-		"        float lambert = dot(n,l);\n"
-		"        if(lambert > 0.0) {\n"
-		"            c += vec3(1.0)*vec3(0.9, 0.5, 0.5)*lambert;\n"
-		"            vec3 v = normalize(view_dir);\n"
-		"            vec3 r = reflect(-l,n);\n"
-		"            c += vec3(1.0)*vec3(0.8, 0.8, 0.8)*pow(max(dot(r,v), 0.0), 90.0);\n"
-		"        }\n"
-		"        c *= fcolor;\n"
-		"    } else {\n"
-		"       c = fcolor;\n"
-		"    }\n"
-		"    if (intensity == vec3(0.0)) {\n"
-		"        c = intensity;\n"
-		"    }\n"
-		"    color = vec4(c, 1.0);\n"
-		"}"
+	"#version 330\n"
+	"in vec3 position;\n"
+	"uniform mat4 MV;\n"
+	"uniform mat4 P;\n"
+	"void main() {\n"
+	"    vec4 vpoint_mv = MV * vec4(position, 1.0);\n"
+	"    gl_Position = P * vpoint_mv;\n"
+	"    gl_PointSize = 10.0;\n"
+	"}",
+
+	"#version 330\n"
+	"out vec4 color;\n"
+	"void main() {\n"
+	"    color = vec4(0.7, 0.0, 0.2, 1.0);\n"
+	"}"
 	);
 
-	shaderNormals_.init(
-		"normal_shader",
+	shaderSelected_.init(
+		"selected_shader",
 		/* Vertex shader */
 		"#version 330\n\n"
-		"in vec3 position;\n"
-		"in vec3 normal;\n"
+		PACKED_ATTRIBUTES
+		"in float selected;\n"
 		"uniform mat4 MV;\n"
 		"uniform mat4 P;\n"
-		"uniform int normal_selector;\n"
-		"out VS_OUT {\n"
-		"    mat3 normal_mat;\n"
-		"    vec3 normal;\n"
-		"} vs_out;\n"
 		"void main() {\n"
-		"  gl_Position = vec4(position, 1.0);\n"
-		"    vs_out.normal = normal;\n"
-		"    vs_out.normal_mat = mat3(transpose(inverse(MV)));\n"
+		"    // the other vertices are moved out of the clip volume\n"
+		"    gl_Position = selected > 0.5 ? P * (MV * vec4(unpack_position(), 1.0))\n"
+		"                                 : vec4(2.0, 2.0, 2.0, 1.0);\n"
+		"    gl_PointSize = 5.0;\n"
 		"}",
 		/* Fragment shader */
 		"#version 330\n\n"
 		"out vec4 frag_color;\n"
 		"void main() {\n"
-		"   frag_color = vec4(0.0, 1.0, 0.0, 1.0);\n"
-		"}",
-		/* Geometry shader */
-		"#version 330\n\n"
-		"layout (triangles) in;\n"
-		"layout (line_strip, max_vertices = 6) out;\n"
-		"uniform mat4 MV;\n"
-		"uniform mat4 P;\n"
-		"in VS_OUT {\n"
-		"    mat3 normal_mat;\n"
-		"    vec3 normal;\n"
-		"} gs_in[];\n"
-		"void createline(int index) {\n"
-		"   gl_Position = P * MV * gl_in[index].gl_Position;\n"
-		"   EmitVertex();\n"
-		"   vec4 normal_mv = vec4(normalize(gs_in[index].normal_mat *\n"
-		"                                   gs_in[index].normal), 1.0f);\n"
-		"   gl_Position = P * (MV * gl_in[index].gl_Position\n"
-		"                      + normal_mv * 0.035f);\n"
-		"   EmitVertex();\n"
-		"   EndPrimitive();\n"
-		"}\n"
-		"void main() {\n"
-		"   createline(0);\n"
-		"   createline(1);\n"
-		"   createline(2);\n"
+		"    frag_color = vec4(0.9, 0.5, 0.1, 1.0);\n"
 		"}"
 	);
 
-	shaderSelection_.init(
-	"selection_shader",
+	// bounding box placeholder of a mesh that is being loaded
+	shaderBox_.init(
+	"box_shader",
 
 	"#version 330\n"
 	"in vec3 position;\n"
 	"uniform mat4 MV;\n"
 	"uniform mat4 P;\n"
 	"void main() {\n"
-	"    vec4 vpoint_mv = MV * vec4(position, 1.0);\n"
-	"    gl_Position = P * vpoint_mv;\n"
-	"    gl_PointSize = 10.0;\n"
+	"    gl_Position = P * MV * vec4(position, 1.0);\n"
 	"}",
 
 	"#version 330\n"
 	"out vec4 color;\n"
 	"void main() {\n"
-	"    color = vec4(0.7, 0.0, 0.2, 1.0);\n"
+	"    color = vec4(0.8, 0.8, 0.8, 1.0);\n"
+	"}"
+	);
+
+	// writes the triangle index + 1 into an integer target, 0 is background
+	shaderPick_.init(
+	"pick_shader",
+
+	"#version 330\n"
+	PACKED_ATTRIBUTES
+	"uniform mat4 MV;\n"
+	"uniform mat4 P;\n"
+	"void main() {\n"
+	"    gl_Position = P * MV * vec4(unpack_position(), 1.0);\n"
+	"}",
+
+	"#version 330\n"
+	"out uint id;\n"
+	"void main() {\n"
+	"    id = uint(gl_PrimitiveID) + 1u;\n"
 	"}"
 	);
 }
 
+bool Viewer::pick_gpu(const Eigen::Vector2i & pixel, Eigen::Vector3f & vertex) {
+	// (re)allocate the id and depth targets at framebuffer resolution
+	if (pickFramebuffer_ == 0) {
+		glGenFramebuffers(1, &pickFramebuffer_);
+		glGenRenderbuffers(1, &pickColor_);
+		glGenRenderbuffers(1, &pickDepth_);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, pickFramebuffer_);
+	if (pickSize_ != mFBSize) {
+		pickSize_ = mFBSize;
+		glBindRenderbuffer(GL_RENDERBUFFER, pickColor_);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, mFBSize.x(), mFBSize.y());
+		glBindRenderbuffer(GL_RENDERBUFFER, pickDepth_);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mFBSize.x(), mFBSize.y());
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, pickColor_);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, pickDepth_);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return false;
+	}
+
+	Eigen::Matrix4f model, view, proj;
+	computeCameraMatrices(model, view, proj);
+
+	glViewport(0, 0, mFBSize.x(), mFBSize.y());
+	const GLuint background[4] = { 0, 0, 0, 0 };
+	glClearBufferuiv(GL_COLOR, 0, background);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
+	shaderPick_.bind();
+	shaderPick_.setUniform("MV", Matrix4f(view * model));
+	shaderPick_.setUniform("P", proj);
+	shaderPick_.drawIndexed(GL_TRIANGLES, 0, mesh_->get_number_of_face());
+
+	// read back the single pixel under the cursor
+	const int x = pixel.x() * mFBSize.x() / mSize.x();
+	const int y = pixel.y() * mFBSize.y() / mSize.y();
+	GLuint id = 0;
+	GLfloat depth = 1.0f;
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &id);
+	glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, mFBSize.x(), mFBSize.y());
+	if (id == 0) return false;
+
+	Eigen::Vector3f hit = nanogui::unproject(Eigen::Vector3f(pixel[0], pixel[1], depth),
+		view * model, proj, mSize);
+	vertex = mesh_->get_closest_vertex_of_triangle(id - 1, hit);
+	return true;
+}
+
+// the per-user cache directory of the viewer, created on demand; empty if
+// there is none
+static string shader_cache_directory() {
+#if defined(_WIN32)
+	const char* base = getenv("LOCALAPPDATA");
+	if (!base) return "";
+	const string directory = string(base) + "\\implicit_fairing";
+	_mkdir(directory.c_str());
+#else
+	string base;
+	if (const char* xdg = getenv("XDG_CACHE_HOME")) base = xdg;
+	else if (const char* home = getenv("HOME")) base = string(home) + "/.cache";
+	else return "";
+	mkdir(base.c_str(), 0755);
+	const string directory = base + "/implicit_fairing";
+	mkdir(directory.c_str(), 0755);
+#endif
+	struct stat info;
+	if (stat(directory.c_str(), &info) != 0 || !(info.st_mode & S_IFDIR)) return "";
+	return directory;
+}
+
 Viewer::Viewer() : nanogui::Screen(Eigen::Vector2i(1024, 768), "DGP Viewer") {
 
 	window_ = new Window(this, "Controls");
@@ -323,15 +977,11 @@ Viewer::Viewer() : nanogui::Screen(Eigen::Vector2i(1024, 768), "DGP Viewer") {
 
 	Button* b = new Button(popup, "Bunny");
 	b->setCallback([this]() {
-		mesh_->load_mesh("../data/bunny.off");
-		this->refresh_mesh();
-		this->refresh_trackball_center();
+		this->open_mesh("../data/bunny.off");
 	});
 	b = new Button(popup, "Max-Planck");
 	b->setCallback([this]() {
-		mesh_->load_mesh("../data/max.off");
-		this->refresh_mesh();
-		this->refresh_trackball_center();
+		this->open_mesh("../data/max.off");
 	});
 
 	b = new Button(popup, "Open mesh ...");
@@ -339,14 +989,98 @@ Viewer::Viewer() : nanogui::Screen(Eigen::Vector2i(1024, 768), "DGP Viewer") {
 		string filename = nanogui::file_dialog({ { "obj", "Wavefront OBJ" },
 		{ "ply", "Stanford PLY" },
 		{ "aln", "Aligned point cloud" },
-		{ "off", "Object File Format" }
+		{ "off", "Object File Format" },
+		{ "stl", "Stereolithography" },
+		{ "poly", "Surface_mesh binary" },
+		{ "smc", "Compressed triangle mesh" },
+		{ "pm", "Progressive mesh" }
 		}, false);
 		if (filename != "") {
-			mesh_->load_mesh(filename);
-			this->refresh_mesh();
-			this->refresh_trackball_center();
+			this->open_mesh(filename);
+		}
+	});
+
+	// the mesh state and the camera, to continue after a restart
+	b = new Button(popup, "Save session ...");
+	b->setCallback([this]() {
+		string filename = nanogui::file_dialog({ { "session", "Viewer session" } }, true);
+		if (filename != "") {
+			this->save_session(filename);
 		}
 	});
+	b = new Button(popup, "Open session ...");
+	b->setCallback([this]() {
+		string filename = nanogui::file_dialog({ { "session", "Viewer session" } }, false);
+		if (filename != "") {
+			this->load_session(filename);
+		}
+	});
+
+	// the next file of the directory, usually prefetched already
+	b = new Button(popup, "Next mesh (N)", ENTYPO_ICON_FORWARD);
+	b->setCallback([this]() {
+		const string next = mesh_processing::next_mesh_file(this->meshFile_);
+		if (!next.empty()) this->open_mesh(next);
+	});
+
+	b = new Button(popup, "Reorder (Hilbert)");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		mesh_->reorder_mesh(surface_mesh::REORDER_HILBERT);
+		this->recorder_.record("reorder", "hilbert");
+		this->refresh_mesh();
+	});
+	b = new Button(popup, "Reorder (Morton)");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		mesh_->reorder_mesh(surface_mesh::REORDER_MORTON);
+		this->recorder_.record("reorder", "morton");
+		this->refresh_mesh();
+	});
+	b = new Button(popup, "Reorder (RCM)");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		mesh_->reorder_mesh(surface_mesh::REORDER_RCM);
+		this->recorder_.record("reorder", "rcm");
+		this->refresh_mesh();
+	});
+	b = new Button(popup, "Subdivide (Loop)");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		if (!mesh_->subdivide(surface_mesh::SUBDIVISION_LOOP)) return;
+		this->recorder_.record("subdivide", "loop");
+		this->refresh_mesh();
+	});
+	b = new Button(popup, "Subdivide (sqrt 3)");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		if (!mesh_->subdivide(surface_mesh::SUBDIVISION_SQRT3)) return;
+		this->recorder_.record("subdivide", "sqrt3");
+		this->refresh_mesh();
+	});
+	b = new Button(popup, "Decimate (half)");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		mesh_processing::DecimationOptions options;
+		options.target_faces = mesh_->get_number_of_face() / 2;
+		if (!mesh_->decimate(options)) return;
+		this->recorder_.record("decimate", { double(options.target_faces) });
+		this->refresh_mesh();
+	});
+	b = new Button(popup, "Remesh (isotropic)");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		if (!mesh_->remesh(mesh_processing::RemeshingOptions())) return;
+		this->recorder_.record("remesh");
+		this->refresh_mesh();
+	});
 
 	new Label(window_, "Display Control", "sans-bold");
 
@@ -354,12 +1088,77 @@ Viewer::Viewer() : nanogui::Screen(Eigen::Vector2i(1024, 768), "DGP Viewer") {
 	b->setFlags(Button::ToggleButton);
 	b->setChangeCallback([this](bool wireframe) {
 		this->wireframe_ = !this->wireframe_;
+		this->sceneValid_ = false;
 	});
 	b = new Button(window_, "Normals");
 	b->setFlags(Button::ToggleButton);
 	b->setChangeCallback([this](bool normals) {
 		this->normals_ = !this->normals_;
+		this->sceneValid_ = false;
+	});
+	b = new Button(window_, "Sparse normals");
+	b->setFlags(Button::ToggleButton);
+	b->setPushed(sparseNormals_);
+	b->setChangeCallback([this](bool sparse) {
+		this->sparseNormals_ = sparse;
+		this->sceneValid_ = false;
+	});
+	b = new Button(window_, "Level of detail");
+	b->setFlags(Button::ToggleButton);
+	b->setChangeCallback([this](bool lod) {
+		this->lod_ = lod;
+		this->sceneValid_ = false;
 	});
+	b = new Button(window_, "Point splats");
+	b->setFlags(Button::ToggleButton);
+	b->setPushed(splats_);
+	b->setChangeCallback([this](bool splats) {
+		this->splats_ = splats;
+		this->sceneValid_ = false;
+	});
+	b = new Button(window_, "Performance");
+	b->setFlags(Button::ToggleButton);
+	b->setChangeCallback([this](bool shown) {
+		this->hud_->setVisible(shown);
+	});
+	b = new Button(window_, "GPU picking");
+	b->setFlags(Button::ToggleButton);
+	b->setChangeCallback([this](bool gpu_picking) {
+		this->gpu_picking_ = gpu_picking;
+	});
+
+	// meshes side by side with the current one, a toggle per mesh shows it
+	popupBtn = new PopupButton(window_, "Scene");
+	popup = popupBtn->popup();
+	popup->setLayout(new GroupLayout());
+	b = new Button(popup, "Add snapshot");
+	b->setCallback([this]() {
+		this->add_mesh_to_scene(false);
+	});
+	b = new Button(popup, "Add original");
+	b->setCallback([this]() {
+		this->add_mesh_to_scene(true);
+	});
+	b = new Button(popup, "Add scan ...");
+	b->setCallback([this]() {
+		string filename = nanogui::file_dialog({ { "obj", "Wavefront OBJ" },
+		{ "off", "Object File Format" }, { "ply", "Polygon File Format" },
+		{ "stl", "Stereolithography" } }, false);
+		if (filename != "") {
+			this->add_scan(filename);
+		}
+	});
+	b = new Button(popup, "Clear");
+	b->setCallback([this]() {
+		this->sceneBuffers_.clear();
+		while (this->scenePanel_->childCount() > 0) {
+			this->scenePanel_->removeChild(this->scenePanel_->childCount() - 1);
+		}
+		this->performLayout();
+		this->sceneValid_ = false;
+	});
+	scenePanel_ = new Widget(popup);
+	scenePanel_->setLayout(new BoxLayout(Orientation::Vertical, Alignment::Fill, 0, 4));
 
 	b = new Button(window_, "Valence");
 	b->setFlags(Button::ToggleButton);
@@ -371,12 +1170,16 @@ Viewer::Viewer() : nanogui::Screen(Eigen::Vector2i(1024, 768), "DGP Viewer") {
 			this->color_mode = NORMAL;
 		}
 		this->popupCurvature->setPushed(false);
+		this->popupPrincipal->setPushed(false);
+		this->refresh_colors();
 	});
 
 	popupCurvature = new PopupButton(window_, "Curvature");
 	popup = popupCurvature->popup();
 	popupCurvature->setCallback([this]() {
 		this->color_mode = CURVATURE;
+		this->popupPrincipal->setPushed(false);
+		this->refresh_colors();
 	});
 	popup->setLayout(new GroupLayout());
 	new Label(popup, "Curvature Type", "sans-bold");
@@ -385,16 +1188,66 @@ Viewer::Viewer() : nanogui::Screen(Eigen::Vector2i(1024, 768), "DGP Viewer") {
 	b->setPushed(true);
 	b->setCallback([this]() {
 		this->curvature_type = UNIMEAN;
+		this->refresh_colors();
 	});
 	b = new Button(popup, "Laplace-Beltrami");
 	b->setFlags(Button::RadioButton);
 	b->setCallback([this]() {
 		this->curvature_type = LAPLACEBELTRAMI;
+		this->refresh_colors();
 	});
 	b = new Button(popup, "Gaussian");
 	b->setFlags(Button::RadioButton);
 	b->setCallback([this]() {
 		this->curvature_type = GAUSS;
+		this->refresh_colors();
+	});
+
+	// signed, from the curvature tensors of the vertices
+	popupPrincipal = new PopupButton(window_, "Principal curvature");
+	popup = popupPrincipal->popup();
+	popupPrincipal->setCallback([this]() {
+		this->color_mode = PRINCIPAL;
+		this->popupCurvature->setPushed(false);
+		this->refresh_colors();
+	});
+	popup->setLayout(new GroupLayout());
+	new Label(popup, "Principal Curvature", "sans-bold");
+	b = new Button(popup, "Maximum");
+	b->setFlags(Button::RadioButton);
+	b->setPushed(true);
+	b->setCallback([this]() {
+		this->principal_type = MAXIMUM;
+		this->refresh_colors();
+	});
+	b = new Button(popup, "Minimum");
+	b->setFlags(Button::RadioButton);
+	b->setCallback([this]() {
+		this->principal_type = MINIMUM;
+		this->refresh_colors();
+	});
+
+	// distance to the surface at load time, from none in blue to the
+	// Hausdorff distance in red
+	Button* deviation = new Button(window_, "Deviation");
+	deviation->setFlags(Button::ToggleButton);
+	// the faces crossing others in red, checked again after every
+	// operation while shown
+	Button* intersections = new Button(window_, "Self-intersections");
+	intersections->setFlags(Button::ToggleButton);
+	deviation->setChangeCallback([this, intersections](bool pushed) {
+		this->color_mode = pushed ? DEVIATION : NORMAL;
+		this->popupCurvature->setPushed(false);
+		this->popupPrincipal->setPushed(false);
+		intersections->setPushed(false);
+		this->refresh_colors();
+	});
+	intersections->setChangeCallback([this, deviation](bool pushed) {
+		this->color_mode = pushed ? INTERSECTION : NORMAL;
+		this->popupCurvature->setPushed(false);
+		this->popupPrincipal->setPushed(false);
+		deviation->setPushed(false);
+		this->refresh_colors();
 	});
 
 	new Label(window_, "Smoothing", "sans-bold");
@@ -403,21 +1256,99 @@ Viewer::Viewer() : nanogui::Screen(Eigen::Vector2i(1024, 768), "DGP Viewer") {
 	popup->setLayout(new GroupLayout());
 	b = new Button(popup, "Uniform Laplacian");
 	b->setCallback([this]() {
-		mesh_->uniform_smooth(10);
-		mesh_->compute_mesh_properties();
-		this->refresh_mesh();
+		if (this->run_pipeline("Uniform smooth", mesh_processing::Pipeline().uniform_smooth(10))) {
+			this->recorder_.record("uniform-smooth", { 10.0 });
+		}
 	});
 	b = new Button(popup, "Laplace-Beltrami");
 	b->setCallback([this]() {
-		mesh_->smooth(10);
-		this->refresh_mesh();
+		if (this->run_pipeline("Laplace-Beltrami smooth", mesh_processing::Pipeline().smooth(10))) {
+			this->recorder_.record("smooth", { 10.0 });
+		}
+	});
+	b = new Button(popup, "Uniform Laplacian (converged)");
+	b->setCallback([this]() {
+		if (this->run_job("Uniform smooth to convergence", [this](JobProgress&) {
+			mesh_->set_smoothing_tolerance(1e-3f);
+			mesh_->set_chebyshev_smoothing(true);
+			mesh_->uniform_smooth(10000);
+			mesh_->set_smoothing_tolerance(0.0f);
+			mesh_->set_chebyshev_smoothing(false);
+		})) {
+			this->recorder_.record("uniform-smooth-converged");
+		}
+	});
+	b = new Button(popup, "Uniform Laplacian (multiresolution, 500)");
+	b->setCallback([this]() {
+		if (this->run_job("Multiresolution smooth", [this](JobProgress&) {
+			mesh_->multiresolution_smooth(500);
+		})) {
+			this->recorder_.record("multires-smooth", { 500.0 });
+		}
+	});
+	b = new Button(popup, "Taubin (non-shrinking)");
+	b->setCallback([this]() {
+		if (this->run_pipeline("Taubin smooth", mesh_processing::Pipeline().taubin_smooth(10))) {
+			this->recorder_.record("taubin-smooth", { 10.0 });
+		}
+	});
+	b = new Button(popup, "Feature preserving");
+	b->setCallback([this]() {
+		if (this->run_job("Feature preserving smooth", [this](JobProgress&) {
+			mesh_->feature_preserving_smooth(10);
+		})) {
+			this->recorder_.record("feature-smooth", { 10.0 });
+		}
 	});
+	b = new Button(popup, "Uniform Laplacian (GPU, 100)");
+	b->setCallback([this]() { this->gpu_smooth(100, false); });
+	b = new Button(popup, "Laplace-Beltrami (GPU, 100)");
+	b->setCallback([this]() { this->gpu_smooth(100, true); });
 
 	b = new Button(popup, "Implicit Smoothing");
 	b->setCallback([this]() {
-		mesh_->implicit_smoothing();
-		mesh_->compute_mesh_properties();
-		this->refresh_mesh();
+		// the default time step, written out for the log
+		const double timestep = 1e-4;
+		if (this->run_job("Implicit smoothing", [this, timestep](JobProgress&) {
+			mesh_->implicit_smoothing(timestep);
+		})) {
+			this->recorder_.record("implicit", { timestep });
+		}
+	});
+
+	// the brush or lasso selection, otherwise a ball around the selected
+	// vertex; the rest of the mesh stays put
+	b = new Button(popup, "Implicit (selection region)");
+	b->setCallback([this]() {
+		// the log has the selected vertices, the ball follows from the pick
+		std::vector<int> region;
+		if (this->recorder_.is_open() && !this->job_.pending()) {
+			std::vector<Mesh::Vertex> selected;
+			mesh_->get_selected_vertices(selected);
+			for (const Mesh::Vertex v : selected) region.push_back(v.idx());
+		}
+		if (this->run_job("Region smoothing", [this](JobProgress&) {
+			if (mesh_->get_vertex_selection_size() > 0) {
+				mesh_->set_region_to_selection();
+			}
+			else {
+				mesh_->set_region_ball(mesh_->get_selected_vertex(), 0.1f * mesh_->get_dist_max());
+			}
+			mesh_->region_implicit_smoothing();
+		})) {
+			this->recorder_.record_vertices("region-implicit", region);
+		}
+	});
+
+	// the eigenvectors are computed on first use, later projections are O(nk)
+	b = new Button(popup, "Spectral (100 modes)");
+	b->setCallback([this]() {
+		if (this->run_job("Spectral smoothing", [this](JobProgress&) {
+			if (mesh_->get_eigenbasis_size() < 100 && !mesh_->compute_eigenbasis(100)) return;
+			mesh_->spectral_smoothing(100);
+		})) {
+			this->recorder_.record("spectral", { 100.0 });
+		}
 	});
 
 	popupBtn = new PopupButton(window_, "Enhancement");
@@ -430,17 +1361,23 @@ Viewer::Viewer() : nanogui::Screen(Eigen::Vector2i(1024, 768), "DGP Viewer") {
 
 	b = new Button(panel, "Uniform Laplacian");
 	b->setCallback([this]() {
-		mesh_->uniform_laplacian_enhance_feature(this->iterationTextBox->value(),
-			this->coefTextBox->value());
-		mesh_->compute_mesh_properties();
-		this->refresh_mesh();
+		const int iterations = this->iterationTextBox->value();
+		const float coefficient = this->coefTextBox->value();
+		if (this->run_job("Uniform enhancement", [this, iterations, coefficient](JobProgress&) {
+			mesh_->uniform_laplacian_enhance_feature(iterations, coefficient);
+		})) {
+			this->recorder_.record("uniform-enhance", { double(iterations), coefficient });
+		}
 	});
 	b = new Button(panel, "Laplace-Beltrami");
 	b->setCallback([this]() {
-		mesh_->laplace_beltrami_enhance_feature(this->iterationTextBox->value(),
-			this->coefTextBox->value());
-		mesh_->compute_mesh_properties();
-		this->refresh_mesh();
+		const int iterations = this->iterationTextBox->value();
+		const float coefficient = this->coefTextBox->value();
+		if (this->run_job("Laplace-Beltrami enhancement", [this, iterations, coefficient](JobProgress&) {
+			mesh_->laplace_beltrami_enhance_feature(iterations, coefficient);
+		})) {
+			this->recorder_.record("laplace-beltrami-enhance", { double(iterations), coefficient });
+		}
 	});
 
 	panel = new Widget(popup);
@@ -466,49 +1403,615 @@ Viewer::Viewer() : nanogui::Screen(Eigen::Vector2i(1024, 768), "DGP Viewer") {
 
 	b = new Button(window_, "Minimal Surface");
 	b->setCallback([this]() {
-		mesh_->minimal_surface();
-		mesh_->compute_mesh_properties();
+		if (this->run_job("Minimal surface", [this](JobProgress&) { mesh_->minimal_surface(); })) {
+			this->recorder_.record("minimal-surface");
+		}
+	});
+
+	// the selected vertex stays where it is in the following solves
+	panel = new Widget(window_);
+	panel->setLayout(new BoxLayout(Orientation::Horizontal, Alignment::Middle, 0, 6));
+	b = new Button(panel, "Pin selection");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		const Mesh::Vertex v = mesh_->get_selected_vertex();
+		if (!v.is_valid()) return;
+		mesh_->set_constraint(v, mesh_processing::to_point(mesh_->get_points().col(v.idx())));
+		this->recorder_.record("pin");
+	});
+	b = new Button(panel, "Clear pins");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		mesh_->clear_constraints();
+		this->recorder_.record("clear-pins");
+	});
+
+	// the tool of Ctrl + left button
+	panel = new Widget(window_);
+	panel->setLayout(new BoxLayout(Orientation::Horizontal, Alignment::Middle, 0, 6));
+	const char* tools[] = { "Point", "Brush", "Lasso" };
+	for (int tool = TOOL_POINT; tool <= TOOL_LASSO; ++tool) {
+		b = new Button(panel, tools[tool]);
+		b->setFlags(Button::RadioButton);
+		b->setPushed(tool == selectionTool_);
+		b->setChangeCallback([this, tool](bool pushed) {
+			if (pushed) this->selectionTool_ = SELECTION_TOOL(tool);
+		});
+	}
+	b = new Button(panel, "Clear");
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		mesh_->clear_vertex_selection();
+		this->upload_selection();
+	});
+	panel = new Widget(window_);
+	panel->setLayout(new BoxLayout(Orientation::Horizontal, Alignment::Middle, 0, 6));
+	new Label(panel, "Brush radius (pixels):", "sans-bold");
+	brushRadiusBox_ = new IntBox<int>(panel, 20);
+	brushRadiusBox_->setEditable(true);
+	brushRadiusBox_->setFixedSize(Vector2i(50, 20));
+	brushRadiusBox_->setDefaultValue("20");
+	brushRadiusBox_->setFontSize(16);
+	brushRadiusBox_->setFormat("[0-9]+");
+
+	panel = new Widget(window_);
+	panel->setLayout(new BoxLayout(Orientation::Horizontal, Alignment::Middle, 0, 6));
+	b = new Button(panel, "Undo", ENTYPO_ICON_CCW);
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		if (!mesh_->undo()) return;
+		this->recorder_.record("undo");
+		this->refresh_mesh();
+	});
+	b = new Button(panel, "Redo", ENTYPO_ICON_CW);
+	b->setCallback([this]() {
+		if (this->job_.running()) return;
+		this->sync_gpu_smoothing();
+		if (!mesh_->redo()) return;
+		this->recorder_.record("redo");
 		this->refresh_mesh();
 	});
 
+	progressBar_ = new ProgressBar(window_);
+	cancelButton_ = new Button(window_, "Cancel");
+	cancelButton_->setEnabled(false);
+	cancelButton_->setCallback([this]() {
+		this->job_.cancel();
+		this->openLoader_->cancel();
+	});
+	panel = new Widget(window_);
+	panel->setLayout(new BoxLayout(Orientation::Horizontal, Alignment::Middle, 0, 6));
+	new Label(panel, "Time budget (s):", "sans-bold");
+	timeBudgetBox_ = new FloatBox<float>(panel, 0.0f);
+	timeBudgetBox_->setEditable(true);
+	timeBudgetBox_->setFixedSize(Vector2i(50, 20));
+	timeBudgetBox_->setDefaultValue("0");
+	timeBudgetBox_->setFontSize(16);
+	timeBudgetBox_->setFormat("[0-9]*\\.?[0-9]+");
+	panel = new Widget(window_);
+	panel->setLayout(new BoxLayout(Orientation::Horizontal, Alignment::Middle, 0, 6));
+	new Label(panel, "Live every (iterations):", "sans-bold");
+	liveIntervalBox_ = new IntBox<int>(panel, 0);
+	liveIntervalBox_->setEditable(true);
+	liveIntervalBox_->setFixedSize(Vector2i(50, 20));
+	liveIntervalBox_->setDefaultValue("0");
+	liveIntervalBox_->setFontSize(16);
+	liveIntervalBox_->setFormat("[0-9]+");
+
+	init_hud();
 	performLayout();
 
+	// linked programs of earlier runs, compiled again after driver updates
+	const string shaderCache = shader_cache_directory();
+	if (!shaderCache.empty()) GLShader::setProgramCache(shaderCache);
 	initShaders();
-	mesh_ = new mesh_processing::MeshProcessing("../data/max.off");
+	// the first frames show the loading box, the mesh follows with its
+	// normals and the curvatures are computed after it is on screen
+	meshFile_ = "../data/max.off";
+	mesh_ = new mesh_processing::MeshProcessing();
+	openLoader_->load(meshFile_);
+	const string next = mesh_processing::next_mesh_file(meshFile_);
+	if (!next.empty()) prefetchLoader_->load(next);
+}
+
+void Viewer::open_mesh(const string& filename) {
+	if (prefetchLoader_->filename() == filename) {
+		// running or done, drawContents() collects it either way; a load
+		// that was still running is dropped
+		openLoader_->cancel();
+		std::swap(openLoader_, prefetchLoader_);
+	}
+	else {
+		openLoader_->load(filename);
+		// shown while the loader reads it, which needs all of the file
+		const size_t dot = filename.rfind('.');
+		if (dot != string::npos && (filename.compare(dot, string::npos, ".pm") == 0 ||
+			filename.compare(dot, string::npos, ".PM") == 0)) {
+			progressive_.open(filename);
+		}
+	}
+	boxCentered_ = false;
+	cancelButton_->setEnabled(true);
+}
+
+void Viewer::finish_loading() {
+	cancelButton_->setEnabled(job_.running());
+	progressive_.close();
+	std::unique_ptr<mesh_processing::MeshProcessing> mesh = openLoader_->take();
+	if (!mesh) {
+		if (mesh_->get_number_of_vertices() == 0) {
+			// the startup mesh, there is nothing to go back to
+			cerr << "Mesh not found, exiting." << endl;
+			exit(-1);
+		}
+		// cancelled or unreadable, back to the last mesh
+		cerr << openLoader_->filename() << ": not loaded" << endl;
+		this->refresh_trackball_center();
+		return;
+	}
+	delete mesh_;
+	mesh_ = mesh.release();
+	gpuPositions_ = false;
+	// revisions start over with the new mesh
+	shader_.invalidateAttribs();
+	shaderLod_.invalidateAttribs();
+	shaderSelected_.invalidateAttribs();
+	meshFile_ = openLoader_->filename();
+	recorder_.record("load", meshFile_.c_str());
 	this->refresh_mesh();
 	this->refresh_trackball_center();
+
+	const string next = mesh_processing::next_mesh_file(meshFile_);
+	if (!next.empty() && next != prefetchLoader_->filename()) prefetchLoader_->load(next);
+
+	// the loader brought the normals, the rest is ready before the user
+	// switches the colors, unless a button starts a job first
+	this->run_job("Attributes", [this](JobProgress&) { mesh_->compute_attributes(); }, false);
+}
+
+bool Viewer::attach(const string& name) {
+	return sharedMesh_.open(name);
+}
+
+void Viewer::poll_shared_mesh() {
+	Surface_mesh mesh;
+	bool topology_changed = false;
+	if (!sharedMesh_.update(mesh, &topology_changed)) return;
+	const vector<Point> points(mesh.points().begin(), mesh.points().end());
+	if (topology_changed || !mesh_->replace_positions(points)) {
+		mesh_->set_mesh(mesh);
+		shader_.invalidateAttribs();
+		shaderLod_.invalidateAttribs();
+		shaderSelected_.invalidateAttribs();
+		meshFile_.clear();
+		topology_changed = true;
+	}
+	gpuPositions_ = false;
+	this->refresh_mesh();
+	// the camera stays while the positions of the same mesh change
+	if (topology_changed) this->refresh_trackball_center();
+}
+
+void Viewer::save_session(const string& filename) {
+	// the running job owns the mesh
+	if (job_.pending()) return;
+	sync_gpu_smoothing();
+	if (!mesh_->save_session(filename)) {
+		cerr << filename << ": cannot write" << endl;
+		return;
+	}
+	std::ofstream view(filename + ".view");
+	const Quaternionf& q = camera_.arcball.state();
+	view << meshFile_ << "\n"
+		<< q.x() << " " << q.y() << " " << q.z() << " " << q.w() << "\n"
+		<< camera_.zoom << " " << camera_.modelZoom << " "
+		<< camera_.modelTranslation.x() << " " << camera_.modelTranslation.y() << " "
+		<< camera_.modelTranslation.z() << "\n";
+	if (!view) cerr << filename << ".view: cannot write" << endl;
+}
+
+void Viewer::load_session(const string& filename) {
+	if (job_.pending() || openLoader_->running()) return;
+	// the current mesh stays if filename is no session
+	std::unique_ptr<mesh_processing::MeshProcessing> mesh(new mesh_processing::MeshProcessing());
+	if (!mesh->load_session(filename)) {
+		cerr << filename << ": not loaded" << endl;
+		return;
+	}
+	delete mesh_;
+	mesh_ = mesh.release();
+	gpuPositions_ = false;
+	shader_.invalidateAttribs();
+	shaderLod_.invalidateAttribs();
+	shaderSelected_.invalidateAttribs();
+	this->refresh_mesh();
+
+	// without the camera the mesh is centered as after a load
+	std::ifstream view(filename + ".view");
+	string meshFile;
+	Quaternionf q;
+	float zoom, modelZoom;
+	Vector3f translation;
+	if (std::getline(view, meshFile) &&
+		view >> q.x() >> q.y() >> q.z() >> q.w() >> zoom >> modelZoom
+			>> translation.x() >> translation.y() >> translation.z()) {
+		meshFile_ = meshFile;
+		camera_.arcball = Arcball();
+		camera_.arcball.setSize(mSize);
+		camera_.arcball.setState(q);
+		camera_.zoom = zoom;
+		camera_.modelZoom = modelZoom;
+		camera_.modelTranslation = translation;
+	}
+	else {
+		meshFile_ = filename;
+		this->refresh_trackball_center();
+	}
+}
+
+bool Viewer::run_job(const string& name, const AsyncJob::Task& task, const bool changes_mesh) {
+	// a job that is running or not collected yet keeps the mesh
+	if (job_.pending() || mesh_->get_number_of_vertices() == 0) return false;
+	sync_gpu_smoothing();
+	// the GPU buffers keep showing the last mesh while the job runs
+	const double budget = timeBudgetBox_->value();
+	snapshots_.set_interval((unsigned int) std::max(liveIntervalBox_->value(), 0));
+	snapshotVertices_ = int(mesh_->get_points().cols());
+	if (!job_.start([this, task, budget](JobProgress& progress) {
+		jobBegin_ = Trace::now();
+		const Perf_counters::Sample counters = Perf_counters::read();
+		const Allocation_tracker::Counts allocations = Allocation_tracker::read();
+		progress.set_time_budget(budget);
+		mesh_->set_progress(&progress);
+		mesh_->set_snapshots(&snapshots_);
+		task(progress);
+		mesh_->set_snapshots(nullptr);
+		mesh_->set_progress(nullptr);
+		jobExpired_ = progress.expired() && !progress.cancelled();
+		jobAllocations_ = Allocation_tracker::read() - allocations;
+		jobCounters_ = Perf_counters::read() - counters;
+		jobEnd_ = Trace::now();
+	})) {
+		return false;
+	}
+	jobName_ = name;
+	jobChangesMesh_ = changes_mesh;
+	cancelButton_->setEnabled(true);
+	return true;
+}
+
+void Viewer::upload_snapshot() {
+	if (!snapshots_.take()) return;
+	const std::vector<float>& snapshot = snapshots_.front();
+	if (int(snapshot.size()) != 3 * snapshotVertices_) return;
+	SURFACE_MESH_TRACE_ZONE("upload snapshot");
+	// packed in the box of the last upload, smoothing stays inside of it;
+	// no version, so that finish_job() sends the result in full
+	mesh_processing::PackedPositions positions;
+	mesh_processing::pack_positions_in_box(ConstMatrix3XfMap(snapshot.data(), 3, snapshotVertices_),
+		boxMin_, boxExtent_, positions);
+	shader_.bind();
+	shader_.uploadAttribRange("position", 0, positions);
+	sceneValid_ = false;
+}
+
+bool Viewer::run_pipeline(const string& name, const mesh_processing::Pipeline& pipeline) {
+	using mesh_processing::Pipeline;
+	const unsigned int outputs = Pipeline::NORMALS |
+		(color_mode == CURVATURE ? Pipeline::CURVATURES : 0u) |
+		(color_mode == PRINCIPAL ? Pipeline::PRINCIPAL_CURVATURES : 0u);
+	// the pipeline marks the attributes dirty itself, before computing them
+	return this->run_job(name, [this, pipeline, outputs](JobProgress&) {
+		pipeline.run(*mesh_, outputs);
+	}, false);
+}
+
+void Viewer::finish_job() {
+	cancelButton_->setEnabled(openLoader_->running());
+	// marking the attributes dirty would drop what a computing job made
+	if (jobChangesMesh_) mesh_->compute_mesh_properties();
+	this->refresh_mesh();
+
+	// latency of the job, its phases are the trace zones it recorded
+	char text[128];
+	snprintf(text, sizeof(text), "%s: %.1f ms%s, upload %.1f ms", jobName_.c_str(),
+		(jobEnd_ - jobBegin_) * 1e-6, jobExpired_ ? " (budget)" : "",
+		(Trace::now() - jobEnd_) * 1e-6);
+	hudOperation_->setCaption(text);
+	const bool counting = Perf_counters::is_open();
+	hudCounters_->setCaption(counting ? "  " + Perf_counters::format(jobCounters_) : "");
+	hudCounters_->setVisible(counting);
+	if (Allocation_tracker::enabled()) {
+		snprintf(text, sizeof(text), "  %lld allocations, %.1f MB", jobAllocations_.allocations,
+			jobAllocations_.bytes / (1024.0 * 1024.0));
+		hudAllocations_->setCaption(text);
+	}
+	while (hudPhases_->childCount() > 0) {
+		hudPhases_->removeChild(0);
+	}
+#ifdef SURFACE_MESH_TRACING
+	vector<Trace::Total> phases;
+	Trace::totals(jobBegin_, Trace::now(), phases);
+	for (const Trace::Total& phase : phases) {
+		snprintf(text, sizeof(text), "  %s: %.2f ms", phase.name.c_str(), phase.milliseconds);
+		string caption = text;
+		if (Allocation_tracker::enabled()) {
+			snprintf(text, sizeof(text), ", %lld allocations", phase.allocations.allocations);
+			caption += text;
+		}
+		if (Trace::counting()) caption += ", " + Perf_counters::format(phase.counters);
+		new Label(hudPhases_, caption);
+	}
+	if (hudOwnsTrace_) Trace::clear();
+#else
+	new Label(hudPhases_, "  phases need a GP_TRACING build");
+#endif
+	performLayout();
+}
+
+void Viewer::init_hud() {
+	hud_ = new Window(this, "Performance");
+	hud_->setPosition(Vector2i(mSize.x() - 300, 15));
+	hud_->setLayout(new GroupLayout());
+	hudCpu_ = new Label(hud_, "");
+	hudGpu_ = new Label(hud_, "");
+	hudMesh_ = new Label(hud_, "");
+	hudMemory_ = new Label(hud_, "");
+	new Label(hud_, "Last operation", "sans-bold");
+	hudOperation_ = new Label(hud_, "none");
+	hudCounters_ = new Label(hud_, "");
+	hudCounters_->setVisible(false);
+	// operator new calls of the job, in GP_ALLOCATION_TRACKING builds
+	hudAllocations_ = new Label(hud_, "");
+	hudAllocations_->setVisible(Allocation_tracker::enabled());
+	hudPhases_ = new Widget(hud_);
+	hudPhases_->setLayout(new BoxLayout(Orientation::Vertical, Alignment::Minimum));
+	// cache, TLB and branch misses of the jobs and of their phases, where
+	// perf_event has a PMU to count with
+	Button* counters = new Button(hud_, "Hardware counters");
+	counters->setFlags(Button::ToggleButton);
+	counters->setChangeCallback([this, counters](bool on) {
+		if (!on) {
+			Trace::stop_counting();
+			Perf_counters::close();
+		} else if (!Trace::start_counting()) {
+			counters->setPushed(false);
+			counters->setTooltip("perf_event has no counters here");
+		}
+	});
+	hud_->setVisible(false);
+
+#ifdef SURFACE_MESH_TRACING
+	// the phases of the jobs come from the trace zones
+	if (!Trace::recording()) {
+		Trace::start();
+		hudOwnsTrace_ = true;
+	}
+#endif
+}
+
+void Viewer::update_hud() {
+	char text[128];
+	snprintf(text, sizeof(text), "CPU frame: %.2f ms", cpuFrameMs_);
+	hudCpu_->setCaption(text);
+	snprintf(text, sizeof(text), "GPU mesh draws: %.2f ms", gpuFrameMs_);
+	hudGpu_->setCaption(text);
+	snprintf(text, sizeof(text), "%u vertices, %u faces",
+		mesh_->get_number_of_vertices(), mesh_->get_number_of_face());
+	hudMesh_->setCaption(text);
+
+	// shaderNormals_ and shaderPick_ only share buffers of shader_, the
+	// selected vertices add a byte per vertex
+	size_t bytes = shader_.bufferSize() + shaderSelection_.bufferSize() + shaderLod_.bufferSize() +
+		size_t(selectionVertices_) + sceneBuffers_.bytes() + progressive_.bytes();
+	if (pickFramebuffer_ != 0) {
+		// R32UI ids and 24 bit depth, padded to 32
+		bytes += size_t(pickSize_.x()) * pickSize_.y() * 8;
+	}
+	if (sceneFramebuffer_ != 0) {
+		// RGBA8 color and 24 bit depth, padded to 32
+		bytes += size_t(sceneSize_.x()) * sceneSize_.y() * 8;
+	}
+	snprintf(text, sizeof(text), "VRAM buffers: %.1f MB", bytes / (1024.0 * 1024.0));
+	hudMemory_->setCaption(text);
 }
 
 void Viewer::refresh_trackball_center() {
 	// Re-center the mesh
-	Point mesh_center = mesh_->get_mesh_center();
-	camera_.arcball = Arcball();
-	camera_.arcball.setSize(mSize);
-	camera_.modelZoom = 2 / mesh_->get_dist_max();
-	camera_.modelTranslation = -Vector3f(mesh_center.x, mesh_center.y, mesh_center.z);
+	center_trackball(mesh_->get_mesh_center(), mesh_->get_dist_max());
+}
+
+void Viewer::center_trackball(const Point& center, const float radius) {
+	mesh_processing::center_camera(camera_, mSize, Vector3f(center.x, center.y, center.z), radius);
 }
 
 void Viewer::refresh_mesh() {
+	SURFACE_MESH_TRACE_ZONE("upload");
+	sceneValid_ = false;
 	shader_.bind();
-	shader_.uploadIndices(*(mesh_->get_indices()));
-	shader_.uploadAttrib("position", *(mesh_->get_points()));
-	shader_.uploadAttrib("valence_color", *(mesh_->get_colors_valence()));
-	shader_.uploadAttrib("unicruvature_color", *(mesh_->get_colors_unicurvature()));
-	shader_.uploadAttrib("curvature_color", *(mesh_->get_color_curvature()));
-	shader_.uploadAttrib("gaussian_curv_color", *(mesh_->get_colors_gaussian_curv()));
-	shader_.uploadAttrib("normal", *(mesh_->get_normals()));
+	// buffers carry the mesh revision they were uploaded from, only out of
+	// date buffers are sent again
+	const int topology = mesh_->get_topology_revision();
+	const int geometry = mesh_->get_geometry_revision();
+	if (shader_.attribVersion("indices") != topology) {
+		shader_.uploadAttrib("indices", *(mesh_->get_indices()), topology);
+	}
+	if (shader_.attribVersion("position") != geometry) {
+		const ConstMatrix3XfMap points = mesh_->get_points();
+		const ConstMatrix3XfMap normals = mesh_->get_normals();
+		// after a local edit only the vertices it changed are sent, as long
+		// as the box the positions are packed in stays the same
+		int first = 0, count = 0;
+		bool partial = shader_.attribVersion("normal") == shader_.attribVersion("position") &&
+			mesh_->get_changed_vertices(shader_.attribVersion("position"), first, count);
+		if (partial && points.cols() > 0) {
+			const Vector3f min = points.rowwise().minCoeff();
+			partial = min == boxMin_ && points.rowwise().maxCoeff() - min == boxExtent_;
+		}
+		if (partial) {
+			mesh_processing::PackedPositions positions;
+			mesh_processing::pack_positions_in_box(
+				ConstMatrix3XfMap(points.data() + 3 * first, 3, count), boxMin_, boxExtent_, positions);
+			mesh_processing::PackedNormals packed_normals;
+			mesh_processing::pack_normals(ConstMatrix3XfMap(normals.data() + 3 * first, 3, count),
+			                              packed_normals);
+			partial = shader_.uploadAttribRange("position", first, positions, geometry) &&
+			          shader_.uploadAttribRange("normal", first, packed_normals, geometry);
+		}
+		if (!partial) {
+			mesh_processing::PackedPositions positions;
+			mesh_processing::pack_positions(points, positions, boxMin_, boxExtent_);
+			shader_.uploadAttrib("position", positions, geometry);
+			mesh_processing::PackedNormals packed_normals;
+			mesh_processing::pack_normals(normals, packed_normals);
+			shader_.uploadAttrib("normal", packed_normals, geometry);
+		}
+	}
+	shader_.setUniform("box_min", boxMin_);
+	shader_.setUniform("box_extent", boxExtent_);
+	// the scalar buffer is refreshed when it is displayed, but must match
+	// the vertex count of the mesh in every color mode
+	if (mesh_->get_number_of_vertices() != uploaded_vertices_) {
+		uploaded_vertices_ = mesh_->get_number_of_vertices();
+		if (color_mode == NORMAL) {
+			// not displayed, the scalars would compute the curvatures of a
+			// mesh that was just loaded; upload_colors() fills it later
+			const mesh_processing::PackedScalars zeros = mesh_processing::PackedScalars::Zero(1, uploaded_vertices_);
+			shader_.uploadAttrib("scalar", zeros, mesh_->get_geometry_revision());
+			uploaded_scalar_ = -1;
+		}
+		else {
+			upload_colors(color_slot());
+		}
+	}
+	refresh_colors();
 	shader_.setUniform("color_mode", int(color_mode));
 	shader_.setUniform("intensity", Vector3f(0.98, 0.59, 0.04));
 
 	shaderNormals_.bind();
-	shaderNormals_.shareAttrib(shader_, "indices");
 	shaderNormals_.shareAttrib(shader_, "position");
 	shaderNormals_.shareAttrib(shader_, "normal");
+	shaderNormals_.setUniform("box_min", boxMin_);
+	shaderNormals_.setUniform("box_extent", boxExtent_);
+
+	shaderPick_.bind();
+	shaderPick_.shareAttrib(shader_, "indices");
+	shaderPick_.shareAttrib(shader_, "position");
+	shaderPick_.setUniform("box_min", boxMin_);
+	shaderPick_.setUniform("box_extent", boxExtent_);
+
+	shaderLod_.bind();
+	shaderLod_.shareAttrib(shader_, "position");
+	shaderLod_.shareAttrib(shader_, "normal");
+	shaderLod_.shareAttrib(shader_, "scalar");
+	shaderLod_.setUniform("box_min", boxMin_);
+	shaderLod_.setUniform("box_extent", boxExtent_);
+
+	shaderSplat_.bind();
+	shaderSplat_.shareAttrib(shader_, "position");
+	shaderSplat_.shareAttrib(shader_, "normal");
+	shaderSplat_.shareAttrib(shader_, "scalar");
+	shaderSplat_.setUniform("box_min", boxMin_);
+	shaderSplat_.setUniform("box_extent", boxExtent_);
+
+	shaderSelected_.bind();
+	shaderSelected_.shareAttrib(shader_, "position");
+	shaderSelected_.setUniform("box_min", boxMin_);
+	shaderSelected_.setUniform("box_extent", boxExtent_);
+	upload_selection();
+
+	// scene meshes of the topology of mesh_ draw from its index buffer
+	if (!sceneBuffers_.empty()) {
+		sceneBuffers_.set_live_topology(live_topology());
+	}
 
 	refresh_selection();
 }
 
+bool Viewer::refresh_lod() {
+	const mesh_processing::LodHierarchy& lod = mesh_->get_lod();
+	if (lod.empty()) return false;
+	const int topology = mesh_->get_topology_revision();
+	shaderLod_.bind();
+	if (shaderLod_.attribVersion("indices") != topology) {
+		SURFACE_MESH_TRACE_ZONE("upload lod");
+		// all levels in one buffer, select() picks the ranges
+		shaderLod_.uploadAttrib("indices", Eigen::Map<const Eigen::Matrix<uint32_t, Eigen::Dynamic, Eigen::Dynamic> >(
+			lod.indices().data(), 3, lod.indices().size() / 3), topology);
+	}
+	return true;
+}
+
+void Viewer::refresh_colors() {
+	// color_mode may have changed even if the buffers wait for the job
+	sceneValid_ = false;
+	// the running job owns the mesh, colors follow when it finished
+	if (job_.running()) return;
+	// curvatures of GPU smoothed positions are computed there, the valence
+	// only depends on the connectivity
+	if (gpuPositions_ && color_mode == CURVATURE) {
+		upload_gpu_curvatures();
+		return;
+	}
+	if (gpuPositions_ && (color_mode == PRINCIPAL || color_mode == DEVIATION ||
+	                      color_mode == INTERSECTION)) {
+		// uploads the colors again once the positions are back
+		sync_gpu_smoothing();
+		return;
+	}
+	shader_.bind();
+	if (color_mode != NORMAL) {
+		upload_colors(color_slot());
+	}
+}
+
+int Viewer::color_slot() const {
+	if (color_mode == CURVATURE) return curvature_type;
+	if (color_mode == PRINCIPAL) return principal_type;
+	if (color_mode == DEVIATION) return DEVIATION_COLOR;
+	if (color_mode == INTERSECTION) return INTERSECTION_COLOR;
+	return VALENCE_COLOR;
+}
+
+void Viewer::upload_colors(const int type) {
+	SURFACE_MESH_TRACE_ZONE("upload colors");
+	// one float per vertex, mapped to colors in the fragment shader
+	const int geometry = mesh_->get_geometry_revision();
+	if (shader_.attribVersion("scalar") != geometry || uploaded_scalar_ != type) {
+		Vector2f range;
+		const ConstRowXfMap values = mesh_->get_scalars(
+			mesh_processing::MeshProcessing::SCALAR_TYPE(type - VALENCE_COLOR),
+			range[0], range[1]);
+		// the values of a local edit that kept the bounds are sent alone; the
+		// deviation and the self-intersections of a vertex also change when
+		// others moved close to it
+		int first = 0, count = 0;
+		bool partial = uploaded_scalar_ == type && type != DEVIATION_COLOR &&
+			type != INTERSECTION_COLOR &&
+			range == scalar_range_ &&
+			mesh_->get_changed_vertices(shader_.attribVersion("scalar"), first, count);
+		mesh_processing::PackedScalars scalars;
+		if (partial) {
+			mesh_processing::pack_scalars(ConstRowXfMap(values.data() + first, count),
+			                              range[0], range[1], scalars);
+			partial = shader_.uploadAttribRange("scalar", first, scalars, geometry);
+		}
+		if (!partial) {
+			mesh_processing::pack_scalars(values, range[0], range[1], scalars);
+			shader_.uploadAttrib("scalar", scalars, geometry);
+		}
+		uploaded_scalar_ = type;
+		scalar_range_ = range;
+		scalar_decode_ = Vector2f(range[0], range[1] - range[0]);
+	}
+	shader_.setUniform("scalar_range", scalar_range_);
+	shader_.setUniform("scalar_decode", scalar_decode_);
+}
+
 void Viewer::refresh_selection() {
+	sceneValid_ = false;
 	shaderSelection_.bind();
 	Eigen::Matrix<uint32_t, Eigen::Dynamic, Eigen::Dynamic> indices = Eigen::Matrix<uint32_t, Eigen::Dynamic, Eigen::Dynamic>(1, 1);
 	indices << 0;
@@ -517,23 +2020,64 @@ void Viewer::refresh_selection() {
 	shaderSelection_.uploadAttrib("position", selection);
 }
 
+void Viewer::upload_selection() {
+	sceneValid_ = false;
+	const int n = mesh_->get_mesh().vertices_size();
+	const int topology = mesh_->get_topology_revision();
+	const int revision = mesh_->get_selection_revision();
+	shaderSelected_.bind();
+	// a brush stroke only sends the vertices it changed
+	int first = 0, count = 0;
+	bool partial = selectionVertices_ == n && selectionTopology_ == topology &&
+		shaderSelected_.attribVersion("selected") >= 0 &&
+		mesh_->get_selection_changes(shaderSelected_.attribVersion("selected"), first, count);
+	if (partial && count > 0) {
+		mesh_->get_selection_mask(first, count, selectionMask_);
+		partial = shaderSelected_.uploadAttribRange("selected", first,
+			Eigen::Map<const Eigen::Matrix<uint8_t, 1, Eigen::Dynamic> >(selectionMask_.data(), count), revision);
+	}
+	if (!partial) {
+		mesh_->get_selection_mask(0, n, selectionMask_);
+		shaderSelected_.uploadAttrib("selected",
+			Eigen::Map<const Eigen::Matrix<uint8_t, 1, Eigen::Dynamic> >(selectionMask_.data(), n), revision);
+	}
+	selectionVertices_ = n;
+	selectionTopology_ = topology;
+	selectedCount_ = mesh_->get_vertex_selection_size();
+}
+
 void Viewer::computeCameraMatrices(Eigen::Matrix4f &model,
 	Eigen::Matrix4f &view,
 	Eigen::Matrix4f &proj) {
 
-	view = nanogui::lookAt(camera_.eye, camera_.center, camera_.up);
-
-	float fH = std::tan(camera_.viewAngle / 360.0f * M_PI) * camera_.dnear;
-	float fW = fH * (float)mSize.x() / (float)mSize.y();
-
-	proj = nanogui::frustum(-fW, fW, -fH, fH, camera_.dnear, camera_.dfar);
-	model = camera_.arcball.matrix();
-
-	model = nanogui::scale(model, Eigen::Vector3f::Constant(camera_.zoom * camera_.modelZoom));
-	model = nanogui::translate(model, camera_.modelTranslation);
+	mesh_processing::camera_matrices(camera_, mSize, model, view, proj);
 }
 
 Viewer::~Viewer() {
+	job_.cancel_and_wait();
 	shader_.free();
 	shaderNormals_.free();
+	shaderPick_.free();
+	shaderBox_.free();
+	shaderLod_.free();
+	shaderSplat_.free();
+	shaderSelected_.free();
+	shaderScene_.free();
+	sceneBuffers_.clear();
+	shaderProgressive_.free();
+	progressive_.close();
+	gpuSmoother_.release();
+	if (gpuQueries_[0] != 0) {
+		glDeleteQueries(2, gpuQueries_);
+	}
+	if (pickFramebuffer_ != 0) {
+		glDeleteFramebuffers(1, &pickFramebuffer_);
+		glDeleteRenderbuffers(1, &pickColor_);
+		glDeleteRenderbuffers(1, &pickDepth_);
+	}
+	if (sceneFramebuffer_ != 0) {
+		glDeleteFramebuffers(1, &sceneFramebuffer_);
+		glDeleteRenderbuffers(1, &sceneColor_);
+		glDeleteRenderbuffers(1, &sceneDepth_);
+	}
 }
@@ -9,7 +9,23 @@
 #include <nanogui/button.h>
 #include <nanogui/textbox.h>
 #include <nanogui/tabwidget.h>
+#include <nanogui/progressbar.h>
 #include "mesh_processing.h"
+#include "mesh_loader.h"
+#include "pipeline.h"
+#include "replay.h"
+#include <surface_mesh/Allocation_tracker.h>
+#include <surface_mesh/Perf_counters.h>
+#include <surface_mesh/Shared_mesh.h>
+#include "vertex_packing.h"
+#include "gpu_smoothing.h"
+#include "scene_buffers.h"
+#include "progressive_buffers.h"
+#include "mesh_hash.h"
+#include "camera.h"
+#include <surface_mesh/IO_async.h>
+#include <future>
+#include <memory>
 
 #if defined(__GNUC__)
 #  pragma GCC diagnostic ignored "-Wmissing-field-initializers"
@@ -40,13 +56,28 @@ using std::min;
 using std::max;
 using namespace surface_mesh;
 using namespace nanogui;
+using mesh_processing::AsyncJob;
+using mesh_processing::JobProgress;
+using mesh_processing::MeshLoader;
 
 class Viewer : public nanogui::Screen {
 public:
 	void select_point(const Eigen::Vector2i & pixel);
+	// renders triangle ids offscreen and reads back the one under pixel,
+	// false if the background was hit
+	bool pick_gpu(const Eigen::Vector2i & pixel, Eigen::Vector3f & vertex);
     void refresh_mesh();
+	void refresh_colors();
+	// uploads the LOD index buffer if the topology changed, false if the
+	// mesh has no triangles
+	bool refresh_lod();
 	void refresh_selection();
+    // sends the changes of the vertex selection since the last upload, all
+    // of it after the connectivity changed
+    void upload_selection();
     void refresh_trackball_center();
+    // fits the view to a sphere around center
+    void center_trackball(const Point& center, const float radius);
     Viewer();
     ~Viewer();
 
@@ -54,6 +85,15 @@ public:
     virtual void draw(NVGcontext *ctx);
     Vector2f getScreenCoord();
     virtual void drawContents();
+    // skips frames while nothing changes
+    virtual void drawAll();
+    // follows the segment a batch run publishes to with --share, the
+    // current mesh is replaced by every new generation; false if the
+    // segment does not exist
+    bool attach(const string& name);
+    // logs the actions that change the mesh to filename from now on, see
+    // mesh_processing::ActionRecorder; false if it cannot be written
+    bool record(const string& filename) { return recorder_.open(filename); }
 
     bool scrollEvent(const Vector2i &p, const Vector2f &rel);
     bool mouseMotionEvent(const Vector2i &p, const Vector2i &rel, int button, int modifiers);
@@ -61,23 +101,97 @@ public:
 
 private:
     void initShaders();
+    // the camera of this frame for the selection queries of mesh_
+    mesh_processing::MeshProcessing::SelectionView selection_view();
+    // a brush step or a lasso point at window position p, finish selects
+    // the vertices in the lasso
+    void select_vertices(const Vector2i& p, const bool finish);
+    void upload_colors(const int type);
+    // the scalar slot color_mode shows
+    int color_slot() const;
+    // runs a MeshProcessing operation on the worker thread, ignored while
+    // another one is running; name labels it in the performance HUD, a job
+    // that only computes attributes passes changes_mesh = false; false if it
+    // was ignored
+    bool run_job(const string& name, const AsyncJob::Task& task, const bool changes_mesh = true);
+    // upload the newest snapshot of the running job, if one arrived
+    void upload_snapshot();
+    void finish_job();
+    // runs pipeline as a job, which leaves the attributes the current
+    // coloring shows up to date
+    bool run_pipeline(const string& name, const mesh_processing::Pipeline& pipeline);
+    // loads filename in the background, the current mesh is replaced once
+    // it is ready; a prefetched file is taken over
+    void open_mesh(const string& filename);
+    // swaps in the mesh of a finished load and prefetches the next file of
+    // its directory
+    void finish_loading();
+    // takes a new generation of sharedMesh_, the positions only if the
+    // connectivity stayed
+    void poll_shared_mesh();
+    // the mesh state of MeshProcessing::save_session() in filename, the
+    // camera and the mesh file name in filename + ".view"
+    void save_session(const string& filename);
+    // replaces the mesh and the camera by a saved session, ignored while a
+    // job or a load is running
+    void load_session(const string& filename);
+    // iterations of smooth() or uniform_smooth() on the GPU, drawn from the
+    // GPU buffers right away; mesh_ gets the result in sync_gpu_smoothing()
+    void gpu_smooth(const int iterations, const bool cotan);
+    // copies GPU smoothed positions back into mesh_, before anything reads
+    // or changes the mesh on the CPU
+    void sync_gpu_smoothing();
+    // the curvature of curvature_type of the GPU smoothed positions into
+    // the scalar attribute, computed on the GPU; the principal curvatures
+    // are computed on the CPU only
+    void upload_gpu_curvatures();
+    // a line along the normal of every vertex, or of a subset that keeps
+    // them a few pixels apart on screen if sparseNormals_
+    void draw_normals(const Matrix4f& mv, const Matrix4f& p);
+    // adds points on the triangles of indices to the scene, next to the
+    // meshes there; center is moved onto the center of mesh_
+    void add_to_scene(const string& name, const ConstMatrix3XfMap& points,
+                      const std::shared_ptr<const mesh_processing::SceneBuffers::Indices>& indices,
+                      const uint64_t topology, const Point& center);
+    // the current positions or those at load time of mesh_ to the scene
+    void add_mesh_to_scene(const bool original);
+    // reads filename into the scene in the background
+    void add_scan(const string& filename);
+    // adds the scans that were read
+    void poll_scans();
+    // topology_hash() of mesh_, the key of the index buffer of shader_
+    uint64_t live_topology();
+    void draw_scene(const Matrix4f& mv, const Matrix4f& p);
+    // pixels covered by the projected bounding sphere of the mesh
+    float projected_area(const Matrix4f& mv, const Matrix4f& p) const;
+    // true if the mesh has more triangles than pixels on screen and is
+    // better drawn as splats of size pixels on every stride-th vertex
+    bool splat_layout(const Matrix4f& mv, const Matrix4f& p, int& stride, float& size) const;
+    // the ranges of triangles of the index buffer of the bound shader
+    void draw_ranges(const vector<mesh_processing::LodHierarchy::Range>& ranges);
+    // the vertex buffers of shader_ as round points through shaderSplat_,
+    // whose uniforms are set
+    void draw_splats(const int stride, const float size);
+    // the bounding box of the mesh being loaded, instead of the old mesh
+    void draw_loading_box(const Matrix4f& mv, const Matrix4f& p);
+    // the part of a progressive mesh file that arrived, while the loader
+    // reads all of it; false if there is none yet
+    bool draw_progressive(const Matrix4f& mv, const Matrix4f& p);
+    // the offscreen target of the mesh passes, false if it is unusable and
+    // the passes go to the window directly
+    bool bind_scene_framebuffer();
+    // copies the cached mesh passes to the window
+    void blit_scene();
+    void init_hud();
+    void update_hud();
+    // GL_TIME_ELAPSED query around the mesh draw calls of this frame
+    void begin_gpu_timer();
+    void end_gpu_timer();
     void computeCameraMatrices(Eigen::Matrix4f &model,
                                Eigen::Matrix4f &view,
                                Eigen::Matrix4f &proj);
 
-    struct CameraParameters {
-        nanogui::Arcball arcball;
-        float zoom = 1.0f, viewAngle = 45.0f;
-        float dnear = 0.05f, dfar = 100.0f;
-        Eigen::Vector3f eye = Eigen::Vector3f(0.0f, 0.0f, 5.0f);
-        Eigen::Vector3f center = Eigen::Vector3f(0.0f, 0.0f, 0.0f);
-        Eigen::Vector3f up = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
-        Eigen::Vector3f modelTranslation = Eigen::Vector3f::Zero();
-        Eigen::Vector3f modelTranslation_start = Eigen::Vector3f::Zero();
-        float modelZoom = 1.0f;
-    };
-
-    CameraParameters camera_;
+    mesh_processing::CameraParameters camera_;
     bool translate_ = false;
     Vector2i translateStart_ = Vector2i(0, 0);
 
@@ -85,22 +199,171 @@ private:
     nanogui::GLShader shader_;
     nanogui::GLShader shaderNormals_;
 	nanogui::GLShader shaderSelection_;
+    // the selected vertices as points, on the vertex buffers of shader_; the
+    // selected attribute carries the selection revision of mesh_ and only
+    // its changed range is sent again
+    nanogui::GLShader shaderSelected_;
+    int selectionTopology_ = -1;
+    int selectionVertices_ = 0;
+    // selected vertices, none are drawn if 0
+    int selectedCount_ = 0;
+    vector<unsigned char> selectionMask_;
+    nanogui::GLShader shaderPick_;
+    nanogui::GLShader shaderBox_;
+    // the program of shader_ on the index buffer of all LOD levels, the
+    // vertex buffers are those of shader_
+    nanogui::GLShader shaderLod_;
+    vector<mesh_processing::LodHierarchy::Range> lodRanges_;
+    // the visible runs of the index buffer of shader_ in this frame
+    vector<mesh_processing::DrawClusters::Range> drawRanges_;
+    // glMultiDrawElements arguments of draw_ranges()
+    vector<GLsizei> multiDrawCounts_;
+    vector<const void*> multiDrawOffsets_;
+    // the vertex buffers of shader_ as points, see splat_layout()
+    nanogui::GLShader shaderSplat_;
+    GLuint pickFramebuffer_ = 0;
+    GLuint pickColor_ = 0;
+    GLuint pickDepth_ = 0;
+    Vector2i pickSize_ = Vector2i(0, 0);
+    // the mesh passes of the last frame, reused while the camera and the
+    // uploaded buffers are unchanged
+    GLuint sceneFramebuffer_ = 0;
+    GLuint sceneColor_ = 0;
+    GLuint sceneDepth_ = 0;
+    Vector2i sceneSize_ = Vector2i(0, 0);
+    bool sceneValid_ = false;
+    Matrix4f sceneMV_;
+    Matrix4f sceneP_;
+    // the meshes drawn next to mesh_, with the program of shader_ on their
+    // own vertex buffers; a toggle button per mesh in scenePanel_
+    mesh_processing::SceneBuffers sceneBuffers_;
+    nanogui::GLShader shaderScene_;
+    Widget* scenePanel_;
+    uint64_t liveTopology_ = 0;
+    int liveTopologyRevision_ = -1;
+    // scans read by add_scan()
+    struct PendingScan {
+        string name;
+        std::unique_ptr<Surface_mesh> mesh;
+        std::future<bool> read;
+    };
+    vector<PendingScan> pendingScans_;
     nanogui::Window *window_;
 
     mesh_processing::MeshProcessing* mesh_;
+    AsyncJob job_;
+    // the file of mesh_; one loader reads the file that is being opened, the
+    // other one the next file of the directory, they swap roles when the
+    // prefetched file is opened
+    string meshFile_;
+    MeshLoader loaders_[2];
+    MeshLoader* openLoader_ = &loaders_[0];
+    MeshLoader* prefetchLoader_ = &loaders_[1];
+    // the camera was fitted to the bounds of the mesh being loaded
+    bool boxCentered_ = false;
+    // a .pm file being opened, streamed a little more every frame
+    mesh_processing::ProgressiveBuffers progressive_;
+    nanogui::GLShader shaderProgressive_;
+    // the segment of attach()
+    surface_mesh::Shared_mesh_reader sharedMesh_;
+    // the action log of record()
+    mesh_processing::ActionRecorder recorder_;
 
-    enum COLOR_MODE : int { NORMAL = 0, VALENCE = 1, CURVATURE = 2 };
+    enum COLOR_MODE : int { NORMAL = 0, VALENCE = 1, CURVATURE = 2, PRINCIPAL = 3,
+                            DEVIATION = 4, INTERSECTION = 5 };
     enum CURVATURE_TYPE : int { UNIMEAN = 2, LAPLACEBELTRAMI = 3, GAUSS = 4 };
+    enum PRINCIPAL_TYPE : int { MAXIMUM = 5, MINIMUM = 6 };
+    // scalar slots of the valence, deviation and self-intersection
+    // colorings, around the CURVATURE_TYPEs and PRINCIPAL_TYPEs; the slots
+    // minus VALENCE_COLOR are the MeshProcessing::SCALAR_TYPEs
+    enum { VALENCE_COLOR = 1, DEVIATION_COLOR = 7, INTERSECTION_COLOR = 8 };
 
     // Boolean for the viewer
     bool wireframe_ = false;
     bool normals_ = false;
+    bool sparseNormals_ = true;
 	bool selection_ = false;
+    // Ctrl + left button picks one vertex with the point tool, paints the
+    // vertex selection with the brush or draws a lasso around vertices;
+    // with Shift the brush and the lasso remove vertices
+    enum SELECTION_TOOL : int { TOOL_POINT = 0, TOOL_BRUSH = 1, TOOL_LASSO = 2 };
+    SELECTION_TOOL selectionTool_ = TOOL_POINT;
+    bool selecting_ = false;
+    bool deselecting_ = false;
+    // window positions of the lasso being drawn
+    vector<Vector2f> lasso_;
+    bool gpu_picking_ = false;
+    bool lod_ = false;
+    bool splats_ = true;
 
     CURVATURE_TYPE curvature_type = UNIMEAN;
+    PRINCIPAL_TYPE principal_type = MAXIMUM;
     COLOR_MODE color_mode = NORMAL;
 
+    mesh_processing::GpuSmoother gpuSmoother_;
+    // the shaders draw gpuSmoother_'s positions, mesh_ lags behind
+    bool gpuPositions_ = false;
+    bool gpuCotan_ = false;
+    // bounding box the uploaded positions are quantized to
+    Vector3f boxMin_ = Vector3f::Zero();
+    Vector3f boxExtent_ = Vector3f::Zero();
+    // vertex count, slot and color bounds of the uploaded scalar buffer
+    unsigned int uploaded_vertices_ = 0;
+    int uploaded_scalar_ = 0;
+    Vector2f scalar_range_ = Vector2f(0.0f, 0.0f);
+    // offset and scale from the scalar attribute to the scalar, the bounds
+    // for the packed scalars, (0, 1) for floats
+    Vector2f scalar_decode_ = Vector2f(0.0f, 0.0f);
+
     PopupButton *popupCurvature;
+    PopupButton *popupPrincipal;
     FloatBox<float>* coefTextBox;
     IntBox<int>* iterationTextBox;
+    ProgressBar* progressBar_;
+    Button* cancelButton_;
+    // seconds after which a job stops with what it reached, 0 for none
+    FloatBox<float>* timeBudgetBox_;
+    // iterations between the positions a running smoother shows, 0 for
+    // none; the snapshots are uploaded as they arrive, with the normals of
+    // before the job
+    IntBox<int>* liveIntervalBox_;
+    // radius of the selection brush in pixels
+    IntBox<int>* brushRadiusBox_;
+    mesh_processing::PositionSnapshots snapshots_;
+    // vertices of mesh_ when the job started, the size a snapshot must have
+    int snapshotVertices_ = 0;
+
+    // performance HUD
+    nanogui::Window* hud_;
+    Label* hudCpu_;
+    Label* hudGpu_;
+    Label* hudMesh_;
+    Label* hudMemory_;
+    Label* hudOperation_;
+    Label* hudCounters_;
+    Label* hudAllocations_;
+    Widget* hudPhases_;
+    // two queries alternate, the result of the last frame is read while the
+    // current one is measured, so the CPU never waits for the GPU
+    GLuint gpuQueries_[2] = { 0, 0 };
+    bool gpuQueryPending_[2] = { false, false };
+    int gpuFrame_ = 0;
+    // smoothed milliseconds per frame
+    double cpuFrameMs_ = 0.0;
+    double gpuFrameMs_ = 0.0;
+    long long frameBegin_ = 0;
+    // the last job in Trace::now() time, written by the worker thread
+    string jobName_;
+    bool jobChangesMesh_ = true;
+    long long jobBegin_ = 0;
+    long long jobEnd_ = 0;
+    // the job ran out of its time budget
+    bool jobExpired_ = false;
+    // hardware counters over the last job while the HUD counts them
+    surface_mesh::Perf_counters::Sample jobCounters_;
+    // operator new calls of the last job, see Allocation_tracker
+    surface_mesh::Allocation_tracker::Counts jobAllocations_;
+    // the viewer started recording zones for the HUD, not for a trace file,
+    // and drops them after every job
+    bool hudOwnsTrace_ = false;
 };
@@ -0,0 +1,315 @@
+// Python bindings of Surface_mesh and MeshProcessing, the module
+// mesh_processing:
+//
+//   import numpy, mesh_processing
+//   mp = mesh_processing.MeshProcessing()
+//   mp.read_mesh("data/max.off")
+//   mp.implicit_smoothing(1e-5)
+//   points = numpy.asarray(mp.points())    # n x 3 float32, no copy
+//
+// The property arrays are exported through the buffer protocol, so
+// numpy.asarray() or memoryview() of a PropertyView alias the storage of
+// the mesh: scalars as 1-D arrays, vectors and colors as n x k, handles as
+// indices. A view looks its property up by name whenever an array is taken
+// from it and keeps the mesh alive, but an array taken before the mesh was
+// resized, reloaded, decimated or compacted points to freed storage, take
+// a new one after such calls. Positions written through an array need
+// compute_mesh_properties(), like MeshProcessing::set_points().
+//
+// The solves, the smoothing iterations and the readers and writers release
+// the GIL, other Python threads run meanwhile but must not touch the mesh.
+// Configure with -DGP_BUILD_PYTHON=ON, the module is written to python/ in
+// the build directory.
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <surface_mesh/Surface_mesh.h>
+#include "mesh_processing.h"
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace py = pybind11;
+using surface_mesh::Surface_mesh;
+using mesh_processing::MeshProcessing;
+
+namespace {
+
+// a property array of a mesh by element kind 'v', 'h', 'e' or 'f' and name
+struct PropertyView {
+    Surface_mesh* mesh;
+    char kind;
+    std::string name;
+};
+
+// an array the bindings computed, e.g. the triangles, owned by Python
+struct IndexArray {
+    std::vector<surface_mesh::Index_type> indices;
+    size_t columns;
+};
+
+template <class T> void* array_data(Surface_mesh& mesh, const char kind, const std::string& name,
+                                    size_t& size) {
+    surface_mesh::Property_vector<T>* vector = nullptr;
+    switch (kind) {
+    case 'v': if (auto p = mesh.get_vertex_property<T>(name)) vector = &p.vector(); break;
+    case 'h': if (auto p = mesh.get_halfedge_property<T>(name)) vector = &p.vector(); break;
+    case 'e': if (auto p = mesh.get_edge_property<T>(name)) vector = &p.vector(); break;
+    case 'f': if (auto p = mesh.get_face_property<T>(name)) vector = &p.vector(); break;
+    }
+    if (!vector) return nullptr;
+    size = vector->size();
+    return vector->data();
+}
+
+static_assert(sizeof(Surface_mesh::Vertex) == sizeof(surface_mesh::Index_type),
+              "handles must be plain indices");
+const char* const index_format = sizeof(surface_mesh::Index_type) == 8 ? "Q" : "I";
+
+// the property types with a buffer layout: components scalars of the
+// struct format each per element
+struct Element {
+    const std::type_info& type;
+    const char* format;
+    size_t itemsize;
+    size_t components;
+    void* (*data)(Surface_mesh&, const char, const std::string&, size_t&);
+};
+
+const Element elements[] = {
+    { typeid(float), "f", 4, 1, &array_data<float> },
+    { typeid(double), "d", 8, 1, &array_data<double> },
+    { typeid(int), "i", 4, 1, &array_data<int> },
+    { typeid(unsigned int), "I", 4, 1, &array_data<unsigned int> },
+    { typeid(unsigned char), "B", 1, 1, &array_data<unsigned char> },
+    { typeid(surface_mesh::Half), "e", 2, 1, &array_data<surface_mesh::Half> },
+    { typeid(surface_mesh::Vec2f), "f", 4, 2, &array_data<surface_mesh::Vec2f> },
+    { typeid(surface_mesh::Vec3f), "f", 4, 3, &array_data<surface_mesh::Vec3f> },
+    { typeid(surface_mesh::Vec4f), "f", 4, 4, &array_data<surface_mesh::Vec4f> },
+    { typeid(surface_mesh::Vec3d), "d", 8, 3, &array_data<surface_mesh::Vec3d> },
+    { typeid(surface_mesh::Color8), "B", 1, 4, &array_data<surface_mesh::Color8> },
+    { typeid(Surface_mesh::Vertex), index_format, sizeof(surface_mesh::Index_type), 1,
+      &array_data<Surface_mesh::Vertex> },
+    { typeid(Surface_mesh::Halfedge), index_format, sizeof(surface_mesh::Index_type), 1,
+      &array_data<Surface_mesh::Halfedge> },
+    { typeid(Surface_mesh::Edge), index_format, sizeof(surface_mesh::Index_type), 1,
+      &array_data<Surface_mesh::Edge> },
+    { typeid(Surface_mesh::Face), index_format, sizeof(surface_mesh::Index_type), 1,
+      &array_data<Surface_mesh::Face> },
+};
+
+const std::type_info& property_type(Surface_mesh& mesh, const char kind, const std::string& name) {
+    switch (kind) {
+    case 'v': return mesh.get_vertex_property_type(name);
+    case 'h': return mesh.get_halfedge_property_type(name);
+    case 'e': return mesh.get_edge_property_type(name);
+    default: return mesh.get_face_property_type(name);
+    }
+}
+
+// nullptr if there is no such property or its type has no layout
+const Element* find_element(const PropertyView& view) {
+    const std::type_info& type = property_type(*view.mesh, view.kind, view.name);
+    for (const Element& e : elements) {
+        if (e.type == type) return &e;
+    }
+    return nullptr;
+}
+
+PropertyView property_view(Surface_mesh& mesh, const char kind, const std::string& name) {
+    const PropertyView view = { &mesh, kind, name };
+    if (property_type(mesh, kind, name) == typeid(void)) throw py::key_error(name);
+    if (!find_element(view)) {
+        throw py::value_error(name + " has no array layout, e.g. bool or connectivity");
+    }
+    return view;
+}
+
+py::buffer_info property_buffer(PropertyView& view) {
+    // a property removed since the view was made is empty
+    const Element* e = find_element(view);
+    size_t size = 0;
+    void* data = e ? e->data(*view.mesh, view.kind, view.name, size) : nullptr;
+    if (!data) return py::buffer_info(nullptr, 1, "B", 0);
+    if (e->components == 1) return py::buffer_info(data, e->itemsize, e->format, size);
+    return py::buffer_info(data, e->itemsize, e->format, 2, { size, e->components },
+                           { e->itemsize * e->components, e->itemsize });
+}
+
+// the vertices of every face, faces x 3 for triangle meshes; a copy
+IndexArray triangles(Surface_mesh& mesh) {
+    if (mesh.has_garbage()) mesh.garbage_collection();
+    IndexArray array;
+    array.columns = 3;
+    array.indices.reserve(3 * size_t(mesh.n_faces()));
+    for (auto f : mesh.faces()) {
+        if (mesh.valence(f) != 3) throw py::value_error("not a triangle mesh");
+        for (auto v : mesh.vertices(f)) array.indices.push_back(v.idx());
+    }
+    return array;
+}
+
+}
+
+PYBIND11_PLUGIN(mesh_processing) {
+    py::module m("mesh_processing", "Surface_mesh and MeshProcessing with NumPy views of "
+                                    "the property arrays");
+
+    py::class_<PropertyView>(m, "PropertyView")
+        .def_buffer(&property_buffer)
+        .def_property_readonly("name", [](const PropertyView& v) { return v.name; })
+        .def_property_readonly("kind", [](const PropertyView& v) { return std::string(1, v.kind); })
+        .def("__len__", [](PropertyView& v) {
+            size_t size = 0;
+            const Element* e = find_element(v);
+            if (e) e->data(*v.mesh, v.kind, v.name, size);
+            return size;
+        })
+        .def("__repr__", [](const PropertyView& v) {
+            return "<PropertyView " + std::string(1, v.kind) + " " + v.name + ">";
+        });
+
+    py::class_<IndexArray>(m, "IndexArray")
+        .def_buffer([](IndexArray& a) {
+            const size_t itemsize = sizeof(surface_mesh::Index_type);
+            return py::buffer_info(a.indices.data(), itemsize, index_format, 2,
+                                   { a.indices.size() / a.columns, a.columns },
+                                   { itemsize * a.columns, itemsize });
+        })
+        .def("__len__", [](const IndexArray& a) { return a.indices.size() / a.columns; });
+
+    py::class_<Surface_mesh>(m, "SurfaceMesh")
+        .def(py::init<>())
+        .def("read", [](Surface_mesh& mesh, const std::string& filename) {
+            py::gil_scoped_release release;
+            return mesh.read(filename);
+        }, py::arg("filename"))
+        .def("write", [](const Surface_mesh& mesh, const std::string& filename) {
+            py::gil_scoped_release release;
+            return mesh.write(filename);
+        }, py::arg("filename"))
+        .def("n_vertices", &Surface_mesh::n_vertices)
+        .def("n_halfedges", &Surface_mesh::n_halfedges)
+        .def("n_edges", &Surface_mesh::n_edges)
+        .def("n_faces", &Surface_mesh::n_faces)
+        .def("has_garbage", &Surface_mesh::has_garbage)
+        .def("garbage_collection", &Surface_mesh::garbage_collection)
+        .def("vertex_properties", &Surface_mesh::vertex_properties)
+        .def("halfedge_properties", &Surface_mesh::halfedge_properties)
+        .def("edge_properties", &Surface_mesh::edge_properties)
+        .def("face_properties", &Surface_mesh::face_properties)
+        .def("vertex_property", [](Surface_mesh& mesh, const std::string& name) {
+            return property_view(mesh, 'v', name);
+        }, py::arg("name"), py::keep_alive<0, 1>())
+        .def("halfedge_property", [](Surface_mesh& mesh, const std::string& name) {
+            return property_view(mesh, 'h', name);
+        }, py::arg("name"), py::keep_alive<0, 1>())
+        .def("edge_property", [](Surface_mesh& mesh, const std::string& name) {
+            return property_view(mesh, 'e', name);
+        }, py::arg("name"), py::keep_alive<0, 1>())
+        .def("face_property", [](Surface_mesh& mesh, const std::string& name) {
+            return property_view(mesh, 'f', name);
+        }, py::arg("name"), py::keep_alive<0, 1>())
+        .def("points", [](Surface_mesh& mesh) {
+            return property_view(mesh, 'v', "v:point");
+        }, py::keep_alive<0, 1>())
+        .def("triangles", &triangles);
+
+    py::enum_<MeshProcessing::SOLVER_TYPE>(m, "SolverType")
+        .value("DIRECT_LDLT", MeshProcessing::DIRECT_LDLT)
+        .value("CG_JACOBI", MeshProcessing::CG_JACOBI)
+        .value("CG_INCOMPLETE_CHOLESKY", MeshProcessing::CG_INCOMPLETE_CHOLESKY)
+        .value("DIRECT_LDLT_FLOAT", MeshProcessing::DIRECT_LDLT_FLOAT)
+        .value("DIRECT_CHOLMOD", MeshProcessing::DIRECT_CHOLMOD)
+        .value("DIRECT_PARDISO", MeshProcessing::DIRECT_PARDISO)
+        .value("CG_MULTIGRID", MeshProcessing::CG_MULTIGRID)
+        .value("CG_SCHWARZ", MeshProcessing::CG_SCHWARZ)
+        .value("CG_MATRIX_FREE", MeshProcessing::CG_MATRIX_FREE)
+        .value("DIRECT_CUSOLVER", MeshProcessing::DIRECT_CUSOLVER)
+        .value("CG_AMGX", MeshProcessing::CG_AMGX);
+
+    py::class_<MeshProcessing>(m, "MeshProcessing")
+        .def(py::init<>())
+        .def(py::init<const Mesh&>(), py::arg("mesh"))
+        .def("read_mesh", [](MeshProcessing& mp, const std::string& filename) {
+            py::gil_scoped_release release;
+            return mp.read_mesh(filename);
+        }, py::arg("filename"))
+        .def("save_mesh", [](MeshProcessing& mp, const std::string& filename, const bool binary_off) {
+            py::gil_scoped_release release;
+            return mp.save_mesh(filename, binary_off);
+        }, py::arg("filename"), py::arg("binary_off") = false)
+        .def("mesh", &MeshProcessing::get_mesh, py::return_value_policy::reference_internal)
+        .def("points", [](MeshProcessing& mp) {
+            return property_view(mp.get_mesh(), 'v', "v:point");
+        }, py::keep_alive<0, 1>())
+        .def("normals", [](MeshProcessing& mp) {
+            // brings v:normal up to date first
+            mp.get_normals();
+            return property_view(mp.get_mesh(), 'v', "v:normal");
+        }, py::keep_alive<0, 1>())
+        .def("compute_mesh_properties", &MeshProcessing::compute_mesh_properties)
+        .def("set_solver", &MeshProcessing::set_solver, py::arg("type"),
+             py::arg("tolerance") = 1e-8, py::arg("max_iterations") = 1000)
+        .def("implicit_smoothing", [](MeshProcessing& mp, const double timestep) {
+            py::gil_scoped_release release;
+            mp.implicit_smoothing(timestep);
+        }, py::arg("timestep") = 1e-4)
+        .def("adaptive_implicit_smoothing", [](MeshProcessing& mp, const double total_time,
+                                               const double tolerance, const double max_timestep) {
+            py::gil_scoped_release release;
+            return mp.adaptive_implicit_smoothing(total_time, tolerance, max_timestep);
+        }, py::arg("total_time"), py::arg("tolerance") = 1e-3, py::arg("max_timestep") = 1e-4)
+        .def("smooth", [](MeshProcessing& mp, const unsigned int iterations) {
+            py::gil_scoped_release release;
+            mp.smooth(iterations);
+        }, py::arg("iterations"))
+        .def("uniform_smooth", [](MeshProcessing& mp, const unsigned int iterations) {
+            py::gil_scoped_release release;
+            mp.uniform_smooth(iterations);
+        }, py::arg("iterations"))
+        .def("feature_preserving_smooth", [](MeshProcessing& mp, const unsigned int iterations,
+                                             const float feature_angle) {
+            py::gil_scoped_release release;
+            mp.feature_preserving_smooth(iterations, feature_angle);
+        }, py::arg("iterations"), py::arg("feature_angle") = 30.0f)
+        .def("minimal_surface", [](MeshProcessing& mp, const bool reduce_boundary,
+                                   const bool keep_weights) {
+            py::gil_scoped_release release;
+            mp.minimal_surface(reduce_boundary, keep_weights);
+        }, py::arg("reduce_boundary") = true, py::arg("keep_weights") = false)
+        .def("weld_vertices", [](MeshProcessing& mp, const float tolerance) {
+            py::gil_scoped_release release;
+            return mp.weld_vertices(tolerance);
+        }, py::arg("tolerance") = 0.0f)
+        // the v:deviation property holds the distance of every vertex
+        .def("deviation", [](MeshProcessing& mp, const bool symmetric) {
+            MeshProcessing::DeviationReport d;
+            {
+                py::gil_scoped_release release;
+                d = mp.deviation(symmetric);
+            }
+            py::dict report;
+            report["hausdorff"] = d.hausdorff();
+            report["forward_max"] = d.forward_max;
+            report["forward_mean"] = d.forward_mean;
+            report["backward_max"] = d.backward_max;
+            report["backward_mean"] = d.backward_mean;
+            return report;
+        }, py::arg("symmetric") = true)
+        .def("decimate", [](MeshProcessing& mp, const unsigned int target_faces,
+                            const float max_error, const float max_normal_angle) {
+            mesh_processing::DecimationOptions options;
+            options.target_faces = target_faces;
+            options.max_error = max_error;
+            options.max_normal_angle = max_normal_angle;
+            py::gil_scoped_release release;
+            return mp.decimate(options);
+        }, py::arg("target_faces"), py::arg("max_error") = std::numeric_limits<float>::max(),
+           py::arg("max_normal_angle") = 60.0f)
+        .def("undo", &MeshProcessing::undo)
+        .def("redo", &MeshProcessing::redo)
+        .def("compact", &MeshProcessing::compact);
+
+    return m.ptr();
+}